@@ -0,0 +1,194 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   NT Atom Table Plugin
+ *
+ * Copyright (C) 2015 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "main.h"
+
+#define ATOM_TABLE_INFORMATION_MAXIMUM_SIZE \
+    (FIELD_OFFSET(ATOM_TABLE_INFORMATION, Atoms) + 0x10000 * sizeof(RTL_ATOM))
+
+/**
+ * Enumerates the global atom table.
+ *
+ * \param AtomTable A buffer to reuse, or NULL. It is reallocated when the table does
+ * not fit. The caller frees it with PhFree.
+ * \param BufferSize The size of \a AtomTable in bytes.
+ */
+NTSTATUS EnumAtomTable(
+    _Inout_ PATOM_TABLE_INFORMATION *AtomTable,
+    _Inout_ PULONG BufferSize
+    )
+{
+    NTSTATUS status;
+    PATOM_TABLE_INFORMATION buffer = *AtomTable;
+    ULONG bufferSize = *BufferSize;
+
+    if (!buffer)
+    {
+        bufferSize = 0x1000;
+        buffer = PhAllocate(bufferSize);
+    }
+
+    while (TRUE)
+    {
+        ULONG returnLength = 0;
+        ULONG capacity;
+
+        status = NtQueryInformationAtom(
+            RTL_ATOM_INVALID_ATOM,
+            AtomTableInformation,
+            buffer,
+            bufferSize,
+            &returnLength
+            );
+
+        capacity = (bufferSize - FIELD_OFFSET(ATOM_TABLE_INFORMATION, Atoms)) / sizeof(RTL_ATOM);
+
+        // Depending on the version the call either fails or quietly fills in as many
+        // atoms as fit, so also check the count it reports.
+        if (status == STATUS_INFO_LENGTH_MISMATCH || status == STATUS_BUFFER_TOO_SMALL ||
+            (NT_SUCCESS(status) && buffer->NumberOfAtoms > capacity))
+        {
+            if (bufferSize >= ATOM_TABLE_INFORMATION_MAXIMUM_SIZE)
+            {
+                status = STATUS_INSUFFICIENT_RESOURCES;
+                break;
+            }
+
+            bufferSize = max(bufferSize * 2, returnLength);
+            bufferSize = min(bufferSize, ATOM_TABLE_INFORMATION_MAXIMUM_SIZE);
+
+            PhFree(buffer);
+            buffer = PhAllocate(bufferSize);
+            continue;
+        }
+
+        break;
+    }
+
+    *AtomTable = buffer;
+    *BufferSize = bufferSize;
+
+    return status;
+}
+
+/**
+ * Queries an atom into a caller buffer.
+ *
+ * \param Atom The atom.
+ * \param Buffer A buffer large enough for the longest atom name.
+ * \param Name A variable which receives the name. It points into \a Buffer.
+ */
+NTSTATUS QueryAtomTableEntry(
+    _In_ RTL_ATOM Atom,
+    _Out_ PATOM_INFORMATION_BUFFER Buffer,
+    _Out_ PPH_STRINGREF Name
+    )
+{
+    NTSTATUS status;
+
+    status = NtQueryInformationAtom(
+        Atom,
+        AtomBasicInformation,
+        Buffer,
+        sizeof(ATOM_INFORMATION_BUFFER),
+        NULL
+        );
+
+    if (!NT_SUCCESS(status))
+        return status;
+
+    Name->Buffer = Buffer->Basic.Name;
+    Name->Length = min(Buffer->Basic.NameLength, ATOM_MAXIMUM_NAME_LENGTH * sizeof(WCHAR)) & ~1;
+
+    return status;
+}
+
+/**
+ * Queries every atom in the global atom table.
+ *
+ * \param Entries A variable which receives an array of atoms. Free it with
+ * FreeAtomEntries.
+ * \param Count A variable which receives the number of atoms.
+ */
+NTSTATUS QueryAtomEntries(
+    _Out_ PATOM_ENTRY *Entries,
+    _Out_ PULONG Count
+    )
+{
+    NTSTATUS status;
+    PATOM_TABLE_INFORMATION atomTable = NULL;
+    ULONG atomTableSize = 0;
+    ATOM_INFORMATION_BUFFER buffer;
+    PATOM_ENTRY entries;
+
+    if (!NT_SUCCESS(status = EnumAtomTable(&atomTable, &atomTableSize)))
+    {
+        PhFree(atomTable);
+        return status;
+    }
+
+    entries = PhAllocate(max(atomTable->NumberOfAtoms, 1) * sizeof(ATOM_ENTRY));
+    memset(entries, 0, max(atomTable->NumberOfAtoms, 1) * sizeof(ATOM_ENTRY));
+
+    for (ULONG i = 0; i < atomTable->NumberOfAtoms; i++)
+    {
+        PATOM_ENTRY entry = &entries[i];
+        PH_STRINGREF name;
+
+        entry->Atom = atomTable->Atoms[i];
+        swprintf_s(entry->AtomString, ARRAYSIZE(entry->AtomString), L"0x%x", entry->Atom);
+
+        if (NT_SUCCESS(entry->Status = QueryAtomTableEntry(entry->Atom, &buffer, &name)))
+        {
+            entry->UsageCount = buffer.Basic.UsageCount;
+            entry->Flags = buffer.Basic.Flags;
+            PhPrintUInt32(entry->UsageCountString, entry->UsageCount);
+
+            if ((entry->Flags & RTL_ATOM_PINNED) == RTL_ATOM_PINNED)
+                entry->Name = PhFormatString(L"%.*s (Pinned)", (ULONG)(name.Length / sizeof(WCHAR)), name.Buffer);
+            else
+                entry->Name = PhCreateString2(&name);
+        }
+        else
+        {
+            entry->Name = PhFormatString(L"(Error) #%lu", i);
+        }
+    }
+
+    *Entries = entries;
+    *Count = atomTable->NumberOfAtoms;
+
+    PhFree(atomTable);
+
+    return STATUS_SUCCESS;
+}
+
+VOID FreeAtomEntries(
+    _In_ PATOM_ENTRY Entries,
+    _In_ ULONG Count
+    )
+{
+    for (ULONG i = 0; i < Count; i++)
+        PhClearReference(&Entries[i].Name);
+
+    PhFree(Entries);
+}
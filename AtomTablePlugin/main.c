@@ -20,273 +20,233 @@
  * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#define CINTERFACE
-#define COBJMACROS
-#include <phdk.h>
-#include <phappresource.h>
-#include <settings.h>
-#include "resource.h"
-
-#define ATOM_TABLE_MENUITEM 1000
-#define PLUGIN_NAME L"dmex.AtomTablePlugin"
-#define SETTING_NAME_WINDOW_POSITION (PLUGIN_NAME L".WindowPosition")
-#define SETTING_NAME_WINDOW_SIZE (PLUGIN_NAME L".WindowSize")
-#define SETTING_NAME_LISTVIEW_COLUMNS (PLUGIN_NAME L".ListViewColumns")
+#include "main.h"
 
+#define ATOM_PRESSURE_TIMER_ID 1
+#define ATOM_PRESSURE_TIMER_INTERVAL 2000
+
+static PH_CALLBACK_REGISTRATION PluginLoadCallbackRegistration;
+static PH_CALLBACK_REGISTRATION PluginUnloadCallbackRegistration;
 static PH_CALLBACK_REGISTRATION PluginMenuItemCallbackRegistration;
 static PH_CALLBACK_REGISTRATION MainMenuInitializingCallbackRegistration;
 static PH_CALLBACK_REGISTRATION PluginShowOptionsCallbackRegistration;
 static HWND ListViewWndHandle;
 static PH_LAYOUT_MANAGER LayoutManager;
-static PPH_PLUGIN PluginInstance;
+static PATOM_ENTRY AtomEntries = NULL;
+static ULONG AtomEntryCount = 0;
+static ULONG SortColumn = 0;
+static PH_SORT_ORDER SortOrder = NoSortOrder;
+PPH_PLUGIN PluginInstance;
+
+#define BEGIN_SORT_FUNCTION(Column) static int __cdecl AtomEntryCompare##Column( \
+    _In_ void *_context, \
+    _In_ const void *_elem1, \
+    _In_ const void *_elem2 \
+    ) \
+{ \
+    PATOM_ENTRY entry1 = (PATOM_ENTRY)_elem1; \
+    PATOM_ENTRY entry2 = (PATOM_ENTRY)_elem2; \
+    int sortResult = 0;
+
+#define END_SORT_FUNCTION \
+    if (sortResult == 0) \
+        sortResult = uintcmp(entry1->Atom, entry2->Atom); \
+    \
+    return PhModifySort(sortResult, SortOrder); \
+}
 
-NTSTATUS EnumAtomTable(
-    _Out_ PATOM_TABLE_INFORMATION* AtomTable
-    )
+#define SORT_FUNCTION(Column) AtomEntryCompare##Column
+
+BEGIN_SORT_FUNCTION(Name)
 {
-    NTSTATUS status;
-    PVOID buffer;
-    ULONG bufferSize = 0x1000;
-
-    buffer = PhAllocate(bufferSize);
-    memset(buffer, 0, bufferSize);
-
-    status = NtQueryInformationAtom(
-        RTL_ATOM_INVALID_ATOM,
-        AtomTableInformation,
-        buffer,
-        bufferSize,
-        &bufferSize // Not used...
-        );
+    sortResult = PhCompareString(entry1->Name, entry2->Name, TRUE);
+}
+END_SORT_FUNCTION
+
+BEGIN_SORT_FUNCTION(UsageCount)
+{
+    sortResult = uintcmp(entry1->UsageCount, entry2->UsageCount);
+}
+END_SORT_FUNCTION
+
+BEGIN_SORT_FUNCTION(Atom)
+{
+    NOTHING;
+}
+END_SORT_FUNCTION
 
-    if (!NT_SUCCESS(status))
+VOID SortAtomTable(VOID)
+{
+    static PVOID sortFunctions[] =
     {
-        PhFree(buffer);
-        return status;
-    }
+        SORT_FUNCTION(Name),
+        SORT_FUNCTION(UsageCount),
+        SORT_FUNCTION(Atom)
+    };
 
-    *AtomTable = buffer;
+    // Atoms are listed in table order until a column is clicked.
+    if (SortOrder == NoSortOrder || SortColumn >= ARRAYSIZE(sortFunctions))
+        return;
 
-    return status;
+    if (AtomEntryCount != 0)
+        qsort_s(AtomEntries, AtomEntryCount, sizeof(ATOM_ENTRY), sortFunctions[SortColumn], NULL);
 }
 
-NTSTATUS QueryAtomTableEntry(
-    _In_ RTL_ATOM Atom,
-    _Out_ PATOM_BASIC_INFORMATION* AtomInfo
+VOID UpdateAtomPressure(
+    _In_ HWND hwndDlg
     )
 {
-    NTSTATUS status;
-    PVOID buffer;
-    ULONG bufferSize = 0x1000;
-
-    buffer = PhAllocate(bufferSize);
-    memset(buffer, 0, bufferSize);
-
-    status = NtQueryInformationAtom(
-        Atom,
-        AtomBasicInformation,
-        buffer,
-        bufferSize,
-        &bufferSize // Not used...
-        );
+    PPH_STRING summary;
 
-    if (!NT_SUCCESS(status))
+    if (summary = AtomPressureGetSummary())
     {
-        PhFree(buffer);
-        return status;
+        SetDlgItemText(hwndDlg, IDC_PRESSURE, summary->Buffer);
+        PhDereferenceObject(summary);
     }
-
-    *AtomInfo = buffer;
-
-    return status;
 }
 
 VOID LoadAtomTable(VOID)
 {
-    PATOM_TABLE_INFORMATION atomTable = NULL;
+    PATOM_ENTRY entries;
+    ULONG count;
 
-    if (!NT_SUCCESS(EnumAtomTable(&atomTable)))
+    if (!NT_SUCCESS(QueryAtomEntries(&entries, &count)))
         return;
 
-    ExtendedListView_SetRedraw(ListViewWndHandle, FALSE);
-    ListView_DeleteAllItems(ListViewWndHandle);
-
-    for (ULONG i = 0; i < atomTable->NumberOfAtoms; i++)
-    {
-        PATOM_BASIC_INFORMATION atomInfo = NULL;
-
-        if (!NT_SUCCESS(QueryAtomTableEntry(atomTable->Atoms[i], &atomInfo)))
-        {
-            PhAddListViewItem(ListViewWndHandle, MAXINT, PhaFormatString(L"(Error) #%lu", i)->Buffer, NULL);
-            continue;
-        }
-
-        if ((atomInfo->Flags & RTL_ATOM_PINNED) == RTL_ATOM_PINNED)
-        {
-            INT index = PhAddListViewItem(
-                ListViewWndHandle,
-                MAXINT,
-                PhaFormatString(L"%s (Pinned)", atomInfo->Name)->Buffer,
-                NULL
-                );
-            PhSetListViewSubItem(
-                ListViewWndHandle,
-                index,
-                1,
-                PhaFormatString(L"%u", atomInfo->UsageCount)->Buffer
-                );
-        }
-        else
-        {
-            INT index = PhAddListViewItem(
-                ListViewWndHandle,
-                MAXINT,
-                atomInfo->Name,
-                NULL
-                );
-            PhSetListViewSubItem(
-                ListViewWndHandle,
-                index,
-                1,
-                PhaFormatString(L"%u", atomInfo->UsageCount)->Buffer
-                );
-        }
+    ListView_SetItemCountEx(ListViewWndHandle, 0, 0);
 
-        PhFree(atomInfo);
-    }
+    if (AtomEntries)
+        FreeAtomEntries(AtomEntries, AtomEntryCount);
 
-    ExtendedListView_SetRedraw(ListViewWndHandle, TRUE);
+    AtomEntries = entries;
+    AtomEntryCount = count;
+    SortAtomTable();
 
-    PhFree(atomTable);
+    ListView_SetItemCountEx(ListViewWndHandle, AtomEntryCount, 0);
+    InvalidateRect(ListViewWndHandle, NULL, FALSE);
 }
 
-PPH_STRING PhGetSelectedListViewItemText(
-    _In_ HWND hWnd
-    )
+VOID FreeAtomTable(VOID)
 {
-    INT index = PhFindListViewItemByFlags(
-        hWnd,
-        -1,
-        LVNI_SELECTED
-        );
+    ListView_SetItemCountEx(ListViewWndHandle, 0, 0);
 
-    if (index != -1)
+    if (AtomEntries)
     {
-        WCHAR buffer[DOS_MAX_PATH_LENGTH] = L"";
-
-        LVITEM item;
-        item.mask = LVIF_TEXT;
-        item.iItem = index;
-        item.iSubItem = 0;
-        item.pszText = buffer;
-        item.cchTextMax = ARRAYSIZE(buffer);
-
-        if (ListView_GetItem(hWnd, &item))
-            return PhCreateString(buffer);
+        FreeAtomEntries(AtomEntries, AtomEntryCount);
+        AtomEntries = NULL;
+        AtomEntryCount = 0;
     }
-
-    return NULL;
 }
 
-VOID ShowStatusMenu(
-    _In_ HWND hwndDlg
+VOID RemoveAtomTableEntry(
+    _In_ HWND hwndDlg,
+    _In_ PATOM_ENTRY Entry
     )
 {
-    PPH_STRING cacheEntryName;
-        
-    cacheEntryName = PhGetSelectedListViewItemText(ListViewWndHandle);
+    ATOM_INFORMATION_BUFFER buffer;
+    PH_STRINGREF name;
+    NTSTATUS status;
+    USHORT usageCount;
 
-    if (cacheEntryName)
+    // Pinned atoms never lose their references, so deleting them would never finish.
+    if (Entry->Flags & RTL_ATOM_PINNED)
     {
-        POINT cursorPos;
-        PPH_EMENU menu;
-        PPH_EMENU_ITEM selectedItem;
-
-        GetCursorPos(&cursorPos);
-
-        menu = PhCreateEMenu();
-        PhInsertEMenuItem(menu, PhCreateEMenuItem(0, 1, L"Remove", NULL, NULL), -1);
+        PhShowError(hwndDlg, L"%s cannot be removed because it is pinned.", Entry->Name->Buffer);
+        return;
+    }
 
-        selectedItem = PhShowEMenu(
-            menu,
-            ListViewWndHandle,
-            PH_EMENU_SHOW_LEFTRIGHT,
-            PH_ALIGN_LEFT | PH_ALIGN_TOP,
-            cursorPos.x,
-            cursorPos.y
-            );
+    if (PhGetIntegerSetting(L"EnableWarnings") && !PhShowConfirmMessage(
+        hwndDlg,
+        L"remove",
+        Entry->Name->Buffer,
+        NULL,
+        FALSE
+        ))
+    {
+        return;
+    }
 
-        if (selectedItem && selectedItem->Id != -1)
-        {
-            switch (selectedItem->Id)
-            {
-            case 1:
-                {
-                    INT lvItemIndex = PhFindListViewItemByFlags(
-                        ListViewWndHandle,
-                        -1,
-                        LVNI_SELECTED
-                        );
+    if (!NT_SUCCESS(QueryAtomTableEntry(Entry->Atom, &buffer, &name)))
+    {
+        LoadAtomTable();
+        return;
+    }
 
-                    if (lvItemIndex != -1)
-                    {
-                        if (!PhGetIntegerSetting(L"EnableWarnings") || PhShowConfirmMessage(
-                            hwndDlg,
-                            L"remove",
-                            cacheEntryName->Buffer,
-                            NULL,
-                            FALSE
-                            ))
-                        {
-                            PATOM_TABLE_INFORMATION atomTable = NULL;
+    // The atom may have been pinned since the list was loaded.
+    if (buffer.Basic.Flags & RTL_ATOM_PINNED)
+    {
+        PhShowError(hwndDlg, L"%s cannot be removed because it is pinned.", Entry->Name->Buffer);
+        LoadAtomTable();
+        return;
+    }
 
-                            if (!NT_SUCCESS(EnumAtomTable(&atomTable)))
-                                return;
+    // Drop every reference so the atom is actually deleted. Stop as soon as a delete
+    // does not plainly succeed or does not release a reference, so that an atom
+    // which cannot be deleted never keeps this loop spinning.
+    usageCount = buffer.Basic.UsageCount;
 
-                            for (ULONG i = 0; i < atomTable->NumberOfAtoms; i++)
-                            {
-                                PATOM_BASIC_INFORMATION atomInfo = NULL;
+    while (usageCount != 0)
+    {
+        status = NtDeleteAtom(Entry->Atom);
 
-                                if (!NT_SUCCESS(QueryAtomTableEntry(atomTable->Atoms[i], &atomInfo)))
-                                    continue;
+        if (status != STATUS_SUCCESS)
+            break;
 
-                                if (!PhEqualStringZ(atomInfo->Name, cacheEntryName->Buffer, TRUE))
-                                    continue;
+        if (!NT_SUCCESS(QueryAtomTableEntry(Entry->Atom, &buffer, &name)))
+            break; // the atom is gone
 
-                                do
-                                {
-                                    if (!NT_SUCCESS(NtDeleteAtom(atomTable->Atoms[i])))
-                                    {
-                                        break;
-                                    }
+        if (buffer.Basic.UsageCount >= usageCount)
+            break;
 
-                                    PhFree(atomInfo);
-                                    atomInfo = NULL;
+        usageCount = buffer.Basic.UsageCount;
+    }
 
-                                    if (!NT_SUCCESS(QueryAtomTableEntry(atomTable->Atoms[i], &atomInfo)))
-                                        break;
+    LoadAtomTable();
+}
 
-                                } while (atomInfo->UsageCount >= 1);
+VOID ShowStatusMenu(
+    _In_ HWND hwndDlg
+    )
+{
+    INT index = ListView_GetNextItem(ListViewWndHandle, -1, LVNI_SELECTED);
+    POINT cursorPos;
+    PPH_EMENU menu;
+    PPH_EMENU_ITEM selectedItem;
 
-                                ListView_DeleteItem(ListViewWndHandle, lvItemIndex);
+    if (index == -1 || (ULONG)index >= AtomEntryCount)
+        return;
 
-                                if (atomInfo)
-                                {
-                                    PhFree(atomInfo);
-                                }
-                            }
+    GetCursorPos(&cursorPos);
+
+    menu = PhCreateEMenu();
+    PhInsertEMenuItem(menu, PhCreateEMenuItem(
+        (AtomEntries[index].Flags & RTL_ATOM_PINNED) ? PH_EMENU_DISABLED : 0,
+        1,
+        L"Remove",
+        NULL,
+        NULL
+        ), -1);
+
+    selectedItem = PhShowEMenu(
+        menu,
+        ListViewWndHandle,
+        PH_EMENU_SHOW_LEFTRIGHT,
+        PH_ALIGN_LEFT | PH_ALIGN_TOP,
+        cursorPos.x,
+        cursorPos.y
+        );
 
-                            PhFree(atomTable);
-                        }
-                    }
-                }
-                break;
-            }
+    if (selectedItem && selectedItem->Id != -1)
+    {
+        switch (selectedItem->Id)
+        {
+        case 1:
+            RemoveAtomTableEntry(hwndDlg, &AtomEntries[index]);
+            break;
         }
-
-        PhDestroyEMenu(menu);
-        PhDereferenceObject(cacheEntryName);
     }
+
+    PhDestroyEMenu(menu);
 }
 
 INT_PTR CALLBACK MainWindowDlgProc(
@@ -306,6 +266,7 @@ INT_PTR CALLBACK MainWindowDlgProc(
             PhInitializeLayoutManager(&LayoutManager, hwndDlg);
             PhAddLayoutItem(&LayoutManager, ListViewWndHandle, NULL, PH_ANCHOR_ALL);
             PhAddLayoutItem(&LayoutManager, GetDlgItem(hwndDlg, IDRETRY), NULL, PH_ANCHOR_BOTTOM | PH_ANCHOR_LEFT);
+            PhAddLayoutItem(&LayoutManager, GetDlgItem(hwndDlg, IDC_PRESSURE), NULL, PH_ANCHOR_BOTTOM | PH_ANCHOR_LEFT | PH_ANCHOR_RIGHT);
             PhAddLayoutItem(&LayoutManager, GetDlgItem(hwndDlg, IDOK), NULL, PH_ANCHOR_BOTTOM | PH_ANCHOR_RIGHT);
 
             PhRegisterDialog(hwndDlg);
@@ -315,20 +276,30 @@ INT_PTR CALLBACK MainWindowDlgProc(
             PhSetControlTheme(ListViewWndHandle, L"explorer");
             PhAddListViewColumn(ListViewWndHandle, 0, 0, 0, LVCFMT_LEFT, 370, L"Atom Name");
             PhAddListViewColumn(ListViewWndHandle, 1, 1, 1, LVCFMT_LEFT, 70, L"Ref Count");
-            PhSetExtendedListView(ListViewWndHandle);
+            PhAddListViewColumn(ListViewWndHandle, 2, 2, 2, LVCFMT_LEFT, 60, L"Atom");
             PhLoadListViewColumnsFromSetting(SETTING_NAME_LISTVIEW_COLUMNS, ListViewWndHandle);
 
             LoadAtomTable();
+            UpdateAtomPressure(hwndDlg);
+            SetTimer(hwndDlg, ATOM_PRESSURE_TIMER_ID, ATOM_PRESSURE_TIMER_INTERVAL, NULL);
         }
         break;
     case WM_SIZE:
         PhLayoutManagerLayout(&LayoutManager);
         break;
+    case WM_TIMER:
+        {
+            if (wParam == ATOM_PRESSURE_TIMER_ID)
+                UpdateAtomPressure(hwndDlg);
+        }
+        break;
     case WM_DESTROY:
+        KillTimer(hwndDlg, ATOM_PRESSURE_TIMER_ID);
         PhSaveWindowPlacementToSetting(SETTING_NAME_WINDOW_POSITION, SETTING_NAME_WINDOW_SIZE, hwndDlg);
         PhSaveListViewColumnsToSetting(SETTING_NAME_LISTVIEW_COLUMNS, ListViewWndHandle);
         PhDeleteLayoutManager(&LayoutManager);
         PhUnregisterDialog(hwndDlg);
+        FreeAtomTable();
         break;
     case WM_COMMAND:
         {
@@ -356,6 +327,57 @@ INT_PTR CALLBACK MainWindowDlgProc(
                         ShowStatusMenu(hwndDlg);
                 }
                 break;
+            case LVN_GETDISPINFO:
+                {
+                    NMLVDISPINFO* dispInfo = (NMLVDISPINFO*)hdr;
+                    PATOM_ENTRY entry;
+
+                    if ((ULONG)dispInfo->item.iItem >= AtomEntryCount)
+                        break;
+
+                    entry = &AtomEntries[dispInfo->item.iItem];
+
+                    if (dispInfo->item.mask & LVIF_TEXT)
+                    {
+                        PWSTR text = NULL;
+
+                        switch (dispInfo->item.iSubItem)
+                        {
+                        case 0:
+                            text = entry->Name->Buffer;
+                            break;
+                        case 1:
+                            text = entry->UsageCountString;
+                            break;
+                        case 2:
+                            text = entry->AtomString;
+                            break;
+                        }
+
+                        if (text)
+                            wcsncpy_s(dispInfo->item.pszText, dispInfo->item.cchTextMax, text, _TRUNCATE);
+                    }
+                }
+                break;
+            case LVN_COLUMNCLICK:
+                {
+                    LPNMLISTVIEW listView = (LPNMLISTVIEW)hdr;
+
+                    if ((ULONG)listView->iSubItem == SortColumn && SortOrder == AscendingSortOrder)
+                    {
+                        SortOrder = DescendingSortOrder;
+                    }
+                    else
+                    {
+                        SortColumn = listView->iSubItem;
+                        SortOrder = AscendingSortOrder;
+                    }
+
+                    PhSetHeaderSortIcon(ListView_GetHeader(ListViewWndHandle), SortColumn, SortOrder);
+                    SortAtomTable();
+                    InvalidateRect(ListViewWndHandle, NULL, FALSE);
+                }
+                break;
             }
         }
         break;
@@ -364,6 +386,22 @@ INT_PTR CALLBACK MainWindowDlgProc(
     return FALSE;
 }
 
+VOID NTAPI LoadCallback(
+    _In_opt_ PVOID Parameter,
+    _In_opt_ PVOID Context
+    )
+{
+    AtomPressureStartSampler();
+}
+
+VOID NTAPI UnloadCallback(
+    _In_opt_ PVOID Parameter,
+    _In_opt_ PVOID Context
+    )
+{
+    AtomPressureStopSampler();
+}
+
 VOID NTAPI MainMenuInitializingCallback(
     _In_opt_ PVOID Parameter,
     _In_opt_ PVOID Context
@@ -420,7 +458,9 @@ LOGICAL DllMain(
             {
                 { IntegerPairSettingType, SETTING_NAME_WINDOW_POSITION, L"350,350" },
                 { ScalableIntegerPairSettingType, SETTING_NAME_WINDOW_SIZE, L"@96|510,380" },
-                { StringSettingType, SETTING_NAME_LISTVIEW_COLUMNS, L"" }
+                { StringSettingType, SETTING_NAME_LISTVIEW_COLUMNS, L"" },
+                { IntegerSettingType, SETTING_NAME_SAMPLE_INTERVAL, L"a" }, // seconds, 0 disables the sampler
+                { IntegerSettingType, SETTING_NAME_WARNING_THRESHOLD, L"4b" } // percent of capacity, 0 disables the warning
             };
 
             PluginInstance = PhRegisterPlugin(PLUGIN_NAME, Instance, &info);
@@ -430,9 +470,21 @@ LOGICAL DllMain(
 
             info->Author = L"dmex";
             info->DisplayName = L"Global Atom Table";
-            info->Description = L"Plugin for viewing the Global Atom Table via the Tools menu.";
+            info->Description = L"Plugin for viewing the Global Atom Table via the Tools menu and warning when it is close to full.";
             info->HasOptions = FALSE;
 
+            PhRegisterCallback(
+                PhGetPluginCallback(PluginInstance, PluginCallbackLoad),
+                LoadCallback,
+                NULL,
+                &PluginLoadCallbackRegistration
+                );
+            PhRegisterCallback(
+                PhGetPluginCallback(PluginInstance, PluginCallbackUnload),
+                UnloadCallback,
+                NULL,
+                &PluginUnloadCallbackRegistration
+                );
             PhRegisterCallback(
                 PhGetGeneralCallback(GeneralCallbackMainMenuInitializing),
                 MainMenuInitializingCallback,
@@ -0,0 +1,102 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   NT Atom Table Plugin
+ *
+ * Copyright (C) 2015 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ATOM_H
+#define _ATOM_H
+
+#define CINTERFACE
+#define COBJMACROS
+#include <phdk.h>
+#include <phappresource.h>
+#include <settings.h>
+#include "resource.h"
+
+#define ATOM_TABLE_MENUITEM 1000
+#define PLUGIN_NAME L"dmex.AtomTablePlugin"
+#define SETTING_NAME_WINDOW_POSITION (PLUGIN_NAME L".WindowPosition")
+#define SETTING_NAME_WINDOW_SIZE (PLUGIN_NAME L".WindowSize")
+#define SETTING_NAME_LISTVIEW_COLUMNS (PLUGIN_NAME L".ListViewColumns")
+#define SETTING_NAME_SAMPLE_INTERVAL (PLUGIN_NAME L".SampleInterval")
+#define SETTING_NAME_WARNING_THRESHOLD (PLUGIN_NAME L".WarningThreshold")
+
+// String atoms use the values 0xc000 to 0xffff, so the global table holds at most
+// this many of them.
+#define ATOM_TABLE_CAPACITY 0x4000
+#define ATOM_MAXIMUM_NAME_LENGTH 255
+
+extern PPH_PLUGIN PluginInstance;
+
+// atoms.c
+
+typedef union _ATOM_INFORMATION_BUFFER
+{
+    ATOM_BASIC_INFORMATION Basic;
+    UCHAR Buffer[FIELD_OFFSET(ATOM_BASIC_INFORMATION, Name) + (ATOM_MAXIMUM_NAME_LENGTH + 1) * sizeof(WCHAR)];
+} ATOM_INFORMATION_BUFFER, *PATOM_INFORMATION_BUFFER;
+
+typedef struct _ATOM_ENTRY
+{
+    RTL_ATOM Atom;
+    USHORT UsageCount;
+    USHORT Flags;
+    NTSTATUS Status;
+    PPH_STRING Name;
+    WCHAR AtomString[PH_INT32_STR_LEN_1];
+    WCHAR UsageCountString[PH_INT32_STR_LEN_1];
+} ATOM_ENTRY, *PATOM_ENTRY;
+
+NTSTATUS EnumAtomTable(
+    _Inout_ PATOM_TABLE_INFORMATION *AtomTable,
+    _Inout_ PULONG BufferSize
+    );
+
+NTSTATUS QueryAtomTableEntry(
+    _In_ RTL_ATOM Atom,
+    _Out_ PATOM_INFORMATION_BUFFER Buffer,
+    _Out_ PPH_STRINGREF Name
+    );
+
+NTSTATUS QueryAtomEntries(
+    _Out_ PATOM_ENTRY *Entries,
+    _Out_ PULONG Count
+    );
+
+VOID FreeAtomEntries(
+    _In_ PATOM_ENTRY Entries,
+    _In_ ULONG Count
+    );
+
+// pressure.c
+
+VOID AtomPressureStartSampler(
+    VOID
+    );
+
+VOID AtomPressureStopSampler(
+    VOID
+    );
+
+PPH_STRING AtomPressureGetSummary(
+    VOID
+    );
+
+#endif
@@ -0,0 +1,321 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   NT Atom Table Plugin
+ *
+ * Copyright (C) 2015 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "main.h"
+
+#define ATOM_PREFIX_MAXIMUM_LENGTH 32
+#define ATOM_PRESSURE_TOP_PREFIXES 3
+#define ATOM_PRESSURE_WARNING_HYSTERESIS 5
+
+// Atoms are grouped by name prefix so a leak shows up as one group that keeps
+// growing. The prefix is the leading run of letters ("ControlOfs", "Delphi",
+// "WindowsForms"), or the first character when the name does not start with one.
+typedef struct _ATOM_PREFIX_ENTRY
+{
+    PH_STRINGREF Prefix;
+    PPH_STRING PrefixString;
+    ULONG Count;
+    ULONG BaselineCount; // count in the first sample
+    ULONG Generation; // last sample that saw the prefix
+} ATOM_PREFIX_ENTRY, *PATOM_PREFIX_ENTRY;
+
+static HANDLE AtomPressureStopEvent = NULL;
+static PH_QUEUED_LOCK AtomPressureSummaryLock = PH_QUEUED_LOCK_INIT;
+static PPH_STRING AtomPressureSummary = NULL;
+
+// Owned by the sampler thread.
+static PPH_HASHTABLE AtomPrefixHashtable = NULL;
+static PATOM_TABLE_INFORMATION AtomPressureTable = NULL;
+static ULONG AtomPressureTableSize = 0;
+static ULONG AtomPressureGeneration = 0;
+static BOOLEAN AtomPressureWarned = FALSE;
+
+static BOOLEAN NTAPI AtomPrefixEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    PATOM_PREFIX_ENTRY entry1 = *(PATOM_PREFIX_ENTRY *)Entry1;
+    PATOM_PREFIX_ENTRY entry2 = *(PATOM_PREFIX_ENTRY *)Entry2;
+
+    return PhEqualStringRef(&entry1->Prefix, &entry2->Prefix, FALSE);
+}
+
+static ULONG NTAPI AtomPrefixHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    PATOM_PREFIX_ENTRY entry = *(PATOM_PREFIX_ENTRY *)Entry;
+
+    return PhHashBytes((PUCHAR)entry->Prefix.Buffer, entry->Prefix.Length);
+}
+
+static VOID AtomGetNamePrefix(
+    _In_ PPH_STRINGREF Name,
+    _Out_ PPH_STRINGREF Prefix
+    )
+{
+    SIZE_T count = Name->Length / sizeof(WCHAR);
+    SIZE_T length = 0;
+
+    while (length < count && length < ATOM_PREFIX_MAXIMUM_LENGTH)
+    {
+        WCHAR c = Name->Buffer[length];
+
+        if (!((c >= L'a' && c <= L'z') || (c >= L'A' && c <= L'Z')))
+            break;
+
+        length++;
+    }
+
+    if (length == 0 && count != 0)
+        length = 1;
+
+    Prefix->Buffer = Name->Buffer;
+    Prefix->Length = length * sizeof(WCHAR);
+}
+
+static VOID AtomPressureCountAtom(
+    _In_ PPH_STRINGREF Name
+    )
+{
+    ATOM_PREFIX_ENTRY lookupEntry;
+    PATOM_PREFIX_ENTRY lookupEntryPtr = &lookupEntry;
+    PATOM_PREFIX_ENTRY *entryPtr;
+    PATOM_PREFIX_ENTRY entry;
+
+    AtomGetNamePrefix(Name, &lookupEntry.Prefix);
+
+    if (entryPtr = PhFindEntryHashtable(AtomPrefixHashtable, &lookupEntryPtr))
+    {
+        entry = *entryPtr;
+    }
+    else
+    {
+        entry = PhAllocate(sizeof(ATOM_PREFIX_ENTRY));
+        memset(entry, 0, sizeof(ATOM_PREFIX_ENTRY));
+        entry->PrefixString = PhCreateString2(&lookupEntry.Prefix);
+        entry->Prefix = entry->PrefixString->sr;
+        entry->Generation = AtomPressureGeneration;
+        PhAddEntryHashtable(AtomPrefixHashtable, &entry);
+    }
+
+    if (entry->Generation != AtomPressureGeneration)
+    {
+        entry->Count = 0;
+        entry->Generation = AtomPressureGeneration;
+    }
+
+    entry->Count++;
+}
+
+static VOID AtomPressureSample(
+    VOID
+    )
+{
+    ATOM_INFORMATION_BUFFER buffer;
+    PATOM_PREFIX_ENTRY topEntries[ATOM_PRESSURE_TOP_PREFIXES] = { 0 };
+    PPH_LIST removedEntries;
+    PH_HASHTABLE_ENUM_CONTEXT enumContext;
+    PATOM_PREFIX_ENTRY *entryPtr;
+    PH_STRING_BUILDER sb;
+    PPH_STRING summary;
+    ULONG numberOfAtoms;
+    ULONG percent;
+    ULONG threshold;
+    BOOLEAN firstSample;
+
+    if (!NT_SUCCESS(EnumAtomTable(&AtomPressureTable, &AtomPressureTableSize)))
+        return;
+
+    numberOfAtoms = AtomPressureTable->NumberOfAtoms;
+    firstSample = AtomPressureGeneration == 0;
+    AtomPressureGeneration++;
+
+    // The query buffer and the prefix table are reused, so a sample only allocates
+    // for prefixes it has not seen before.
+    for (ULONG i = 0; i < numberOfAtoms; i++)
+    {
+        PH_STRINGREF name;
+
+        if (NT_SUCCESS(QueryAtomTableEntry(AtomPressureTable->Atoms[i], &buffer, &name)))
+            AtomPressureCountAtom(&name);
+    }
+
+    removedEntries = PhCreateList(4);
+    PhBeginEnumHashtable(AtomPrefixHashtable, &enumContext);
+
+    while (entryPtr = PhNextEnumHashtable(&enumContext))
+    {
+        PATOM_PREFIX_ENTRY entry = *entryPtr;
+
+        if (entry->Generation != AtomPressureGeneration)
+            entry->Count = 0;
+
+        if (firstSample)
+            entry->BaselineCount = entry->Count;
+
+        if (entry->Count == 0 && entry->BaselineCount == 0)
+        {
+            PhAddItemList(removedEntries, entry);
+            continue;
+        }
+
+        if (entry->Count <= entry->BaselineCount)
+            continue;
+
+        // Keep the prefixes that grew the most since the first sample.
+        for (ULONG j = 0; j < ATOM_PRESSURE_TOP_PREFIXES; j++)
+        {
+            if (!topEntries[j] || entry->Count - entry->BaselineCount > topEntries[j]->Count - topEntries[j]->BaselineCount)
+            {
+                memmove(&topEntries[j + 1], &topEntries[j], (ATOM_PRESSURE_TOP_PREFIXES - j - 1) * sizeof(PATOM_PREFIX_ENTRY));
+                topEntries[j] = entry;
+                break;
+            }
+        }
+    }
+
+    for (ULONG i = 0; i < removedEntries->Count; i++)
+    {
+        PATOM_PREFIX_ENTRY entry = removedEntries->Items[i];
+
+        PhRemoveEntryHashtable(AtomPrefixHashtable, &entry);
+        PhDereferenceObject(entry->PrefixString);
+        PhFree(entry);
+    }
+
+    PhDereferenceObject(removedEntries);
+
+    percent = numberOfAtoms * 100 / ATOM_TABLE_CAPACITY;
+
+    PhInitializeStringBuilder(&sb, 0x100);
+    PhAppendFormatStringBuilder(&sb, L"%lu of %lu atoms in use (%lu%%)", numberOfAtoms, ATOM_TABLE_CAPACITY, percent);
+
+    for (ULONG i = 0; i < ATOM_PRESSURE_TOP_PREFIXES && topEntries[i]; i++)
+    {
+        PhAppendStringBuilder2(&sb, i == 0 ? L". Growing: " : L", ");
+        PhAppendStringBuilder(&sb, &topEntries[i]->Prefix);
+        PhAppendFormatStringBuilder(&sb, L" +%lu", topEntries[i]->Count - topEntries[i]->BaselineCount);
+    }
+
+    summary = PhFinalStringBuilderString(&sb);
+
+    PhAcquireQueuedLockExclusive(&AtomPressureSummaryLock);
+    PhSetReference(&AtomPressureSummary, summary);
+    PhReleaseQueuedLockExclusive(&AtomPressureSummaryLock);
+
+    threshold = PhGetIntegerSetting(SETTING_NAME_WARNING_THRESHOLD);
+
+    if (threshold != 0 && percent >= threshold && !AtomPressureWarned)
+    {
+        AtomPressureWarned = TRUE;
+        PhShowIconNotification(L"Global atom table", summary->Buffer, NIIF_WARNING);
+    }
+    else if (percent + ATOM_PRESSURE_WARNING_HYSTERESIS < threshold)
+    {
+        AtomPressureWarned = FALSE;
+    }
+
+    PhDereferenceObject(summary);
+}
+
+static NTSTATUS AtomPressureSamplerThreadStart(
+    _In_ PVOID Parameter
+    )
+{
+    PH_HASHTABLE_ENUM_CONTEXT enumContext;
+    PATOM_PREFIX_ENTRY *entryPtr;
+    ULONG interval;
+    LARGE_INTEGER timeout;
+
+    AtomPrefixHashtable = PhCreateHashtable(
+        sizeof(PATOM_PREFIX_ENTRY),
+        AtomPrefixEqualFunction,
+        AtomPrefixHashFunction,
+        0x40
+        );
+
+    interval = max(PhGetIntegerSetting(SETTING_NAME_SAMPLE_INTERVAL), 1) * 1000;
+
+    do
+    {
+        AtomPressureSample();
+    } while (NtWaitForSingleObject(
+        AtomPressureStopEvent,
+        FALSE,
+        PhTimeoutFromMilliseconds(&timeout, interval)
+        ) == STATUS_TIMEOUT);
+
+    PhBeginEnumHashtable(AtomPrefixHashtable, &enumContext);
+
+    while (entryPtr = PhNextEnumHashtable(&enumContext))
+    {
+        PhDereferenceObject((*entryPtr)->PrefixString);
+        PhFree(*entryPtr);
+    }
+
+    PhDereferenceObject(AtomPrefixHashtable);
+    PhFree(AtomPressureTable);
+
+    return STATUS_SUCCESS;
+}
+
+VOID AtomPressureStartSampler(
+    VOID
+    )
+{
+    if (PhGetIntegerSetting(SETTING_NAME_SAMPLE_INTERVAL) == 0)
+        return;
+
+    if (!NT_SUCCESS(NtCreateEvent(&AtomPressureStopEvent, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE)))
+        return;
+
+    PhCreateThread2(AtomPressureSamplerThreadStart, NULL);
+}
+
+VOID AtomPressureStopSampler(
+    VOID
+    )
+{
+    if (AtomPressureStopEvent)
+        NtSetEvent(AtomPressureStopEvent, NULL);
+}
+
+/**
+ * Gets the text of the last sample, or NULL if the sampler is not running.
+ */
+PPH_STRING AtomPressureGetSummary(
+    VOID
+    )
+{
+    PPH_STRING summary;
+
+    PhAcquireQueuedLockShared(&AtomPressureSummaryLock);
+
+    if (summary = AtomPressureSummary)
+        PhReferenceObject(summary);
+
+    PhReleaseQueuedLockShared(&AtomPressureSummaryLock);
+
+    return summary;
+}
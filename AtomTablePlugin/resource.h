@@ -4,6 +4,7 @@
 //
 #define IDD_ATOMDIALOG                  101
 #define IDC_ATOMLIST                    1001
+#define IDC_PRESSURE                    1002
 
 // Next default values for new objects
 // 
@@ -11,7 +12,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        103
 #define _APS_NEXT_COMMAND_VALUE         40006
-#define _APS_NEXT_CONTROL_VALUE         1002
+#define _APS_NEXT_CONTROL_VALUE         1003
 #define _APS_NEXT_SYMED_VALUE           103
 #endif
 #endif
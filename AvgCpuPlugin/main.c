@@ -22,35 +22,271 @@
 
 #include <phdk.h>
 #include <settings.h>
+#include <math.h>
+#include "winstat.h"
 #include "resource.h"
 
-#define COLUMN_ID_AVGCPU10 1
-#define COLUMN_ID_AVGCPU60 2
-#define HISTORY_SIZE 60
+#define PLUGIN_NAME L"wj32.AvgCpuPlugin"
+#define SETTING_NAME_WINDOW1 (PLUGIN_NAME L".Window1")
+#define SETTING_NAME_WINDOW2 (PLUGIN_NAME L".Window2")
+#define SETTING_NAME_WINDOW3 (PLUGIN_NAME L".Window3")
+#define SETTING_NAME_LOAD_PERIOD (PLUGIN_NAME L".LoadAveragePeriod")
+
+// Column IDs 1 and 2 are kept from the old fixed 10/60 interval columns so saved
+// column layouts still apply.
+typedef enum _AVGCPU_COLUMN_ID
+{
+    COLUMN_ID_AVGCPU_WINDOW1 = 1,
+    COLUMN_ID_AVGCPU_WINDOW2,
+    COLUMN_ID_AVGCPU_WINDOW3,
+    COLUMN_ID_AVGCPU_LOAD,
+    COLUMN_ID_AVGCPU_MAXIMUM,
+    COLUMN_ID_AVGCPU_PERCENTILE,
+    COLUMN_ID_AVGIO_AVERAGE,
+    COLUMN_ID_AVGIO_MAXIMUM,
+    COLUMN_ID_AVGIO_PERCENTILE,
+    COLUMN_ID_AVGPAGEFAULTS_AVERAGE,
+    COLUMN_ID_AVGPRIVATEBYTES_GROWTH,
+    COLUMN_ID_MAXIMUM
+} AVGCPU_COLUMN_ID;
+
+#define AVGCPU_COLUMN_COUNT (COLUMN_ID_MAXIMUM - 1)
+
+typedef enum _AVGCPU_SERIES
+{
+    AVGCPU_SERIES_CPU,
+    AVGCPU_SERIES_IO,
+    AVGCPU_SERIES_PAGEFAULTS,
+    AVGCPU_SERIES_PRIVATEBYTES,
+    AVGCPU_SERIES_COUNT
+} AVGCPU_SERIES;
+
+#define AVGCPU_WINDOW_COUNT 3
+// Window used for the min/max/percentile and non-CPU columns.
+#define AVGCPU_DETAIL_WINDOW 0
+#define AVGCPU_MAX_WINDOW_SAMPLES 3600
+#define AVGCPU_INITIAL_SLOT_CAPACITY 256
+
+// Fixed-point scales for the packed samples.
+#define AVGCPU_CPU_SCALE 10000 // fraction of total CPU time
+#define AVGCPU_BYTES_SHIFT 6 // bytes per second, in units of 64 bytes
 
 typedef struct _PROCESS_EXTENSION
 {
-    LIST_ENTRY ListEntry;
     PPH_PROCESS_ITEM ProcessItem;
-
-    FLOAT CpuHistory[HISTORY_SIZE];
-    ULONG CpuHistoryCount;
-    ULONG CpuHistoryPosition;
-
-    FLOAT Avg10CpuUsage;
-    FLOAT Avg60CpuUsage;
-    WCHAR Avg10CpuUsageText[PH_INT32_STR_LEN_1];
-    WCHAR Avg60CpuUsageText[PH_INT32_STR_LEN_1];
+    ULONG SlotIndex;
+
+    FLOAT AvgCpuUsage[AVGCPU_WINDOW_COUNT];
+    FLOAT LoadAverage;
+    ULONG64 AvgIoRate;
+    FLOAT AvgPageFaults;
+    LONG64 AvgPrivateBytesGrowth;
+
+    // Computed on demand by AvgCpuUpdateDetails for the columns that are shown.
+    ULONG CpuDetailsRunCount;
+    ULONG IoDetailsRunCount;
+    FLOAT MaxCpuUsage;
+    FLOAT P95CpuUsage;
+    ULONG64 MaxIoRate;
+    ULONG64 P95IoRate;
+
+    WCHAR ColumnText[AVGCPU_COLUMN_COUNT][PH_INT64_STR_LEN_1];
 } PROCESS_EXTENSION, *PPROCESS_EXTENSION;
 
 PPH_PLUGIN PluginInstance;
+PH_CALLBACK_REGISTRATION PluginLoadCallbackRegistration;
 PH_CALLBACK_REGISTRATION TreeNewMessageCallbackRegistration;
 PH_CALLBACK_REGISTRATION ProcessTreeNewInitializingCallbackRegistration;
 PH_CALLBACK_REGISTRATION ProcessAddedCallbackRegistration;
 PH_CALLBACK_REGISTRATION ProcessRemovedCallbackRegistration;
 PH_CALLBACK_REGISTRATION ProcessesUpdatedCallbackRegistration;
 
-LIST_ENTRY ProcessListHead = { &ProcessListHead, &ProcessListHead };
+// The provider thread adds samples; the UI thread reads the detail windows when a
+// column needs them. AvgCpuRunCount is advanced once per provider tick.
+WINSTAT_TABLE AvgCpuTable;
+PH_QUEUED_LOCK AvgCpuTableLock = PH_QUEUED_LOCK_INIT;
+volatile ULONG AvgCpuRunCount = 0;
+ULONG AvgCpuUpdateInterval = 1000;
+FLOAT AvgCpuLoadDecay = 0;
+PPH_STRING AvgCpuWindowText[AVGCPU_WINDOW_COUNT];
+
+VOID NTAPI LoadCallback(
+    _In_opt_ PVOID Parameter,
+    _In_opt_ PVOID Context
+    )
+{
+    static PWSTR windowSettings[AVGCPU_WINDOW_COUNT] =
+    {
+        SETTING_NAME_WINDOW1,
+        SETTING_NAME_WINDOW2,
+        SETTING_NAME_WINDOW3
+    };
+    // Only CPU usage is shown over every window; the other series only need the
+    // detail window, so their rings stay short.
+    static ULONG windowMask[AVGCPU_SERIES_COUNT] =
+    {
+        (1 << AVGCPU_WINDOW_COUNT) - 1,
+        1 << AVGCPU_DETAIL_WINDOW,
+        1 << AVGCPU_DETAIL_WINDOW,
+        1 << AVGCPU_DETAIL_WINDOW
+    };
+    ULONG windowLength[AVGCPU_WINDOW_COUNT];
+    ULONG loadPeriod;
+    ULONG i;
+
+    AvgCpuUpdateInterval = PhGetIntegerSetting(L"UpdateInterval");
+
+    if (AvgCpuUpdateInterval == 0)
+        AvgCpuUpdateInterval = 1000;
+
+    // Window lengths are configured in seconds and converted to a number of samples
+    // using the refresh interval that is active at startup.
+
+    for (i = 0; i < AVGCPU_WINDOW_COUNT; i++)
+    {
+        ULONG seconds;
+        ULONG length;
+
+        seconds = PhGetIntegerSetting(windowSettings[i]);
+
+        if (seconds == 0)
+            seconds = 1;
+
+        length = (ULONG)(((ULONG64)seconds * 1000) / AvgCpuUpdateInterval);
+
+        if (length == 0)
+            length = 1;
+        if (length > AVGCPU_MAX_WINDOW_SAMPLES)
+            length = AVGCPU_MAX_WINDOW_SAMPLES;
+
+        windowLength[i] = length;
+
+        if (seconds >= 60 && seconds % 60 == 0)
+            AvgCpuWindowText[i] = PhFormatString(L"%lu min", seconds / 60);
+        else
+            AvgCpuWindowText[i] = PhFormatString(L"%lu s", seconds);
+    }
+
+    loadPeriod = PhGetIntegerSetting(SETTING_NAME_LOAD_PERIOD);
+
+    if (loadPeriod == 0)
+        loadPeriod = 60;
+
+    AvgCpuLoadDecay = expf(-(FLOAT)AvgCpuUpdateInterval / (loadPeriod * 1000.0f));
+
+    WinStatInitializeTable(
+        &AvgCpuTable,
+        AVGCPU_SERIES_COUNT,
+        AVGCPU_WINDOW_COUNT,
+        windowLength,
+        windowMask,
+        AVGCPU_INITIAL_SLOT_CAPACITY
+        );
+}
+
+FORCEINLINE WINSTAT_SAMPLE AvgCpuPackRate(
+    _In_ LONG64 PerTick,
+    _In_ ULONG Shift
+    )
+{
+    LONG64 perSecond = PerTick * 1000 / (LONG64)AvgCpuUpdateInterval;
+
+    if (perSecond >= 0)
+        perSecond >>= Shift;
+    else
+        perSecond = -(-perSecond >> Shift);
+
+    if (perSecond > MAXLONG)
+        return MAXLONG;
+    if (perSecond < MINLONG)
+        return MINLONG;
+
+    return (WINSTAT_SAMPLE)perSecond;
+}
+
+VOID AvgCpuFormatSizeRate(
+    _In_ LONG64 Rate,
+    _Inout_ PPH_STRINGREF Text,
+    _Out_writes_(PH_INT64_STR_LEN_1) PWCHAR Buffer
+    )
+{
+    PH_FORMAT format[3];
+    ULONG count = 0;
+    SIZE_T returnLength;
+
+    if (Rate < 0)
+    {
+        PhInitFormatC(&format[count++], L'-');
+        Rate = -Rate;
+    }
+
+    PhInitFormatSize(&format[count++], (ULONG64)Rate);
+    PhInitFormatS(&format[count++], L"/s");
+
+    if (PhFormatToBuffer(format, count, Buffer, PH_INT64_STR_LEN_1 * sizeof(WCHAR), &returnLength))
+    {
+        Text->Buffer = Buffer;
+        Text->Length = (USHORT)(returnLength - sizeof(WCHAR)); // minus null terminator
+    }
+}
+
+/**
+ * Computes the min/max/percentile statistics for a process, at most once per tick.
+ * These need a pass over the whole detail window, so they are only computed for
+ * columns that are actually displayed or sorted.
+ */
+VOID AvgCpuUpdateDetails(
+    _Inout_ PPROCESS_EXTENSION Extension,
+    _In_ ULONG SubId
+    )
+{
+    ULONG runCount = AvgCpuRunCount;
+    WINSTAT_STATISTICS statistics;
+
+    switch (SubId)
+    {
+    case COLUMN_ID_AVGCPU_MAXIMUM:
+    case COLUMN_ID_AVGCPU_PERCENTILE:
+        {
+            if (Extension->CpuDetailsRunCount == runCount)
+                return;
+
+            PhAcquireQueuedLockExclusive(&AvgCpuTableLock);
+
+            if (Extension->SlotIndex != ULONG_MAX)
+            {
+                WinStatQueryStatistics(&AvgCpuTable, Extension->SlotIndex, AVGCPU_SERIES_CPU, AVGCPU_DETAIL_WINDOW, &statistics);
+                Extension->MaxCpuUsage = (FLOAT)statistics.Maximum / AVGCPU_CPU_SCALE;
+                Extension->P95CpuUsage = (FLOAT)statistics.Percentile95 / AVGCPU_CPU_SCALE;
+            }
+
+            PhReleaseQueuedLockExclusive(&AvgCpuTableLock);
+
+            Extension->CpuDetailsRunCount = runCount;
+        }
+        break;
+    case COLUMN_ID_AVGIO_MAXIMUM:
+    case COLUMN_ID_AVGIO_PERCENTILE:
+        {
+            if (Extension->IoDetailsRunCount == runCount)
+                return;
+
+            PhAcquireQueuedLockExclusive(&AvgCpuTableLock);
+
+            if (Extension->SlotIndex != ULONG_MAX)
+            {
+                WinStatQueryStatistics(&AvgCpuTable, Extension->SlotIndex, AVGCPU_SERIES_IO, AVGCPU_DETAIL_WINDOW, &statistics);
+                Extension->MaxIoRate = (ULONG64)statistics.Maximum << AVGCPU_BYTES_SHIFT;
+                Extension->P95IoRate = (ULONG64)statistics.Percentile95 << AVGCPU_BYTES_SHIFT;
+            }
+
+            PhReleaseQueuedLockExclusive(&AvgCpuTableLock);
+
+            Extension->IoDetailsRunCount = runCount;
+        }
+        break;
+    }
+}
 
 VOID TreeNewMessageCallback(
     _In_opt_ PVOID Parameter,
@@ -66,28 +302,36 @@ VOID TreeNewMessageCallback(
             PPH_TREENEW_GET_CELL_TEXT getCellText = message->Parameter1;
             PPH_PROCESS_NODE node;
             PPROCESS_EXTENSION extension;
+            PWCHAR buffer;
 
             node = (PPH_PROCESS_NODE)getCellText->Node;
             extension = PhPluginGetObjectExtension(PluginInstance, node->ProcessItem, EmProcessItemType);
 
+            if (message->SubId < COLUMN_ID_AVGCPU_WINDOW1 || message->SubId >= COLUMN_ID_MAXIMUM)
+                break;
+
+            buffer = extension->ColumnText[message->SubId - COLUMN_ID_AVGCPU_WINDOW1];
+            AvgCpuUpdateDetails(extension, message->SubId);
+
             switch (message->SubId)
             {
-            case COLUMN_ID_AVGCPU10:
-            case COLUMN_ID_AVGCPU60:
+            case COLUMN_ID_AVGCPU_WINDOW1:
+            case COLUMN_ID_AVGCPU_WINDOW2:
+            case COLUMN_ID_AVGCPU_WINDOW3:
+            case COLUMN_ID_AVGCPU_LOAD:
+            case COLUMN_ID_AVGCPU_MAXIMUM:
+            case COLUMN_ID_AVGCPU_PERCENTILE:
                 {
                     FLOAT cpuUsage;
-                    PWCHAR buffer;
 
-                    if (message->SubId == COLUMN_ID_AVGCPU10)
-                    {
-                        cpuUsage = extension->Avg10CpuUsage * 100;
-                        buffer = extension->Avg10CpuUsageText;
-                    }
+                    if (message->SubId == COLUMN_ID_AVGCPU_LOAD)
+                        cpuUsage = extension->LoadAverage * 100;
+                    else if (message->SubId == COLUMN_ID_AVGCPU_MAXIMUM)
+                        cpuUsage = extension->MaxCpuUsage * 100;
+                    else if (message->SubId == COLUMN_ID_AVGCPU_PERCENTILE)
+                        cpuUsage = extension->P95CpuUsage * 100;
                     else
-                    {
-                        cpuUsage = extension->Avg60CpuUsage * 100;
-                        buffer = extension->Avg60CpuUsageText;
-                    }
+                        cpuUsage = extension->AvgCpuUsage[message->SubId - COLUMN_ID_AVGCPU_WINDOW1] * 100;
 
                     if (cpuUsage >= 0.01)
                     {
@@ -96,7 +340,7 @@ VOID TreeNewMessageCallback(
 
                         PhInitFormatF(&format, cpuUsage, 2);
 
-                        if (PhFormatToBuffer(&format, 1, buffer, PH_INT32_STR_LEN_1 * sizeof(WCHAR), &returnLength))
+                        if (PhFormatToBuffer(&format, 1, buffer, PH_INT64_STR_LEN_1 * sizeof(WCHAR), &returnLength))
                         {
                             getCellText->Text.Buffer = buffer;
                             getCellText->Text.Length = (USHORT)(returnLength - sizeof(WCHAR)); // minus null terminator
@@ -108,6 +352,46 @@ VOID TreeNewMessageCallback(
                     }
                 }
                 break;
+            case COLUMN_ID_AVGIO_AVERAGE:
+            case COLUMN_ID_AVGIO_MAXIMUM:
+            case COLUMN_ID_AVGIO_PERCENTILE:
+                {
+                    ULONG64 ioRate;
+
+                    if (message->SubId == COLUMN_ID_AVGIO_AVERAGE)
+                        ioRate = extension->AvgIoRate;
+                    else if (message->SubId == COLUMN_ID_AVGIO_MAXIMUM)
+                        ioRate = extension->MaxIoRate;
+                    else
+                        ioRate = extension->P95IoRate;
+
+                    if (ioRate != 0)
+                        AvgCpuFormatSizeRate(ioRate, &getCellText->Text, buffer);
+                }
+                break;
+            case COLUMN_ID_AVGPAGEFAULTS_AVERAGE:
+                {
+                    if (extension->AvgPageFaults >= 0.01)
+                    {
+                        PH_FORMAT format;
+                        SIZE_T returnLength;
+
+                        PhInitFormatF(&format, extension->AvgPageFaults, 2);
+
+                        if (PhFormatToBuffer(&format, 1, buffer, PH_INT64_STR_LEN_1 * sizeof(WCHAR), &returnLength))
+                        {
+                            getCellText->Text.Buffer = buffer;
+                            getCellText->Text.Length = (USHORT)(returnLength - sizeof(WCHAR)); // minus null terminator
+                        }
+                    }
+                }
+                break;
+            case COLUMN_ID_AVGPRIVATEBYTES_GROWTH:
+                {
+                    if (extension->AvgPrivateBytesGrowth != 0)
+                        AvgCpuFormatSizeRate(extension->AvgPrivateBytesGrowth, &getCellText->Text, buffer);
+                }
+                break;
             }
         }
         break;
@@ -127,17 +411,55 @@ LONG NTAPI AvgCpuSortFunction(
     PPROCESS_EXTENSION extension1 = PhPluginGetObjectExtension(PluginInstance, node1->ProcessItem, EmProcessItemType);
     PPROCESS_EXTENSION extension2 = PhPluginGetObjectExtension(PluginInstance, node2->ProcessItem, EmProcessItemType);
 
+    AvgCpuUpdateDetails(extension1, SubId);
+    AvgCpuUpdateDetails(extension2, SubId);
+
     switch (SubId)
     {
-    case COLUMN_ID_AVGCPU10:
-        return singlecmp(extension1->Avg10CpuUsage, extension2->Avg10CpuUsage);
-    case COLUMN_ID_AVGCPU60:
-        return singlecmp(extension1->Avg60CpuUsage, extension2->Avg60CpuUsage);
+    case COLUMN_ID_AVGCPU_WINDOW1:
+    case COLUMN_ID_AVGCPU_WINDOW2:
+    case COLUMN_ID_AVGCPU_WINDOW3:
+        return singlecmp(
+            extension1->AvgCpuUsage[SubId - COLUMN_ID_AVGCPU_WINDOW1],
+            extension2->AvgCpuUsage[SubId - COLUMN_ID_AVGCPU_WINDOW1]
+            );
+    case COLUMN_ID_AVGCPU_LOAD:
+        return singlecmp(extension1->LoadAverage, extension2->LoadAverage);
+    case COLUMN_ID_AVGCPU_MAXIMUM:
+        return singlecmp(extension1->MaxCpuUsage, extension2->MaxCpuUsage);
+    case COLUMN_ID_AVGCPU_PERCENTILE:
+        return singlecmp(extension1->P95CpuUsage, extension2->P95CpuUsage);
+    case COLUMN_ID_AVGIO_AVERAGE:
+        return uint64cmp(extension1->AvgIoRate, extension2->AvgIoRate);
+    case COLUMN_ID_AVGIO_MAXIMUM:
+        return uint64cmp(extension1->MaxIoRate, extension2->MaxIoRate);
+    case COLUMN_ID_AVGIO_PERCENTILE:
+        return uint64cmp(extension1->P95IoRate, extension2->P95IoRate);
+    case COLUMN_ID_AVGPAGEFAULTS_AVERAGE:
+        return singlecmp(extension1->AvgPageFaults, extension2->AvgPageFaults);
+    case COLUMN_ID_AVGPRIVATEBYTES_GROWTH:
+        return int64cmp(extension1->AvgPrivateBytesGrowth, extension2->AvgPrivateBytesGrowth);
     }
 
     return 0;
 }
 
+VOID AvgCpuAddColumn(
+    _In_ PVOID CmData,
+    _Inout_ PPH_TREENEW_COLUMN Column,
+    _In_ ULONG SubId,
+    _In_ PWSTR Name,
+    _In_ ULONG Window
+    )
+{
+    PPH_STRING text;
+
+    // Column text must remain valid for the lifetime of the tree.
+    text = PhFormatString(L"%s (%s)", Name, AvgCpuWindowText[Window]->Buffer);
+    Column->Text = text->Buffer;
+    PhPluginAddTreeNewColumn(PluginInstance, CmData, Column, SubId, NULL, AvgCpuSortFunction);
+}
+
 VOID ProcessTreeNewInitializingCallback(
     _In_opt_ PVOID Parameter,
     _In_opt_ PVOID Context
@@ -145,17 +467,29 @@ VOID ProcessTreeNewInitializingCallback(
 {
     PPH_PLUGIN_TREENEW_INFORMATION info = Parameter;
     PH_TREENEW_COLUMN column;
+    ULONG i;
 
     memset(&column, 0, sizeof(PH_TREENEW_COLUMN));
     column.SortDescending = TRUE;
-    column.Text = L"CPU Average (10)";
     column.Width = 45;
     column.Alignment = PH_ALIGN_RIGHT;
     column.TextFlags = DT_RIGHT;
-    PhPluginAddTreeNewColumn(PluginInstance, info->CmData, &column, COLUMN_ID_AVGCPU10, NULL, AvgCpuSortFunction);
 
-    column.Text = L"CPU Average (60)";
-    PhPluginAddTreeNewColumn(PluginInstance, info->CmData, &column, COLUMN_ID_AVGCPU60, NULL, AvgCpuSortFunction);
+    for (i = 0; i < AVGCPU_WINDOW_COUNT; i++)
+        AvgCpuAddColumn(info->CmData, &column, COLUMN_ID_AVGCPU_WINDOW1 + i, L"CPU Average", i);
+
+    column.Text = L"CPU Load Average";
+    PhPluginAddTreeNewColumn(PluginInstance, info->CmData, &column, COLUMN_ID_AVGCPU_LOAD, NULL, AvgCpuSortFunction);
+
+    AvgCpuAddColumn(info->CmData, &column, COLUMN_ID_AVGCPU_MAXIMUM, L"CPU Maximum", AVGCPU_DETAIL_WINDOW);
+    AvgCpuAddColumn(info->CmData, &column, COLUMN_ID_AVGCPU_PERCENTILE, L"CPU 95th Percentile", AVGCPU_DETAIL_WINDOW);
+
+    column.Width = 70;
+    AvgCpuAddColumn(info->CmData, &column, COLUMN_ID_AVGIO_AVERAGE, L"I/O Rate Average", AVGCPU_DETAIL_WINDOW);
+    AvgCpuAddColumn(info->CmData, &column, COLUMN_ID_AVGIO_MAXIMUM, L"I/O Rate Maximum", AVGCPU_DETAIL_WINDOW);
+    AvgCpuAddColumn(info->CmData, &column, COLUMN_ID_AVGIO_PERCENTILE, L"I/O Rate 95th Percentile", AVGCPU_DETAIL_WINDOW);
+    AvgCpuAddColumn(info->CmData, &column, COLUMN_ID_AVGPAGEFAULTS_AVERAGE, L"Page Faults Average", AVGCPU_DETAIL_WINDOW);
+    AvgCpuAddColumn(info->CmData, &column, COLUMN_ID_AVGPRIVATEBYTES_GROWTH, L"Private Bytes Growth", AVGCPU_DETAIL_WINDOW);
 }
 
 VOID ProcessItemCreateCallback(
@@ -169,6 +503,7 @@ VOID ProcessItemCreateCallback(
 
     memset(extension, 0, sizeof(PROCESS_EXTENSION));
     extension->ProcessItem = processItem;
+    extension->SlotIndex = ULONG_MAX;
 }
 
 VOID ProcessAddedHandler(
@@ -179,7 +514,9 @@ VOID ProcessAddedHandler(
     PPH_PROCESS_ITEM processItem = Parameter;
     PPROCESS_EXTENSION extension = PhPluginGetObjectExtension(PluginInstance, processItem, EmProcessItemType);
 
-    InsertTailList(&ProcessListHead, &extension->ListEntry);
+    PhAcquireQueuedLockExclusive(&AvgCpuTableLock);
+    extension->SlotIndex = WinStatAllocateSlot(&AvgCpuTable, extension);
+    PhReleaseQueuedLockExclusive(&AvgCpuTableLock);
 }
 
 VOID ProcessRemovedHandler(
@@ -190,7 +527,15 @@ VOID ProcessRemovedHandler(
     PPH_PROCESS_ITEM processItem = Parameter;
     PPROCESS_EXTENSION extension = PhPluginGetObjectExtension(PluginInstance, processItem, EmProcessItemType);
 
-    RemoveEntryList(&extension->ListEntry);
+    PhAcquireQueuedLockExclusive(&AvgCpuTableLock);
+
+    if (extension->SlotIndex != ULONG_MAX)
+    {
+        WinStatFreeSlot(&AvgCpuTable, extension->SlotIndex);
+        extension->SlotIndex = ULONG_MAX;
+    }
+
+    PhReleaseQueuedLockExclusive(&AvgCpuTableLock);
 }
 
 VOID ProcessesUpdatedHandler(
@@ -202,81 +547,65 @@ VOID ProcessesUpdatedHandler(
 
     if (runCount != 0)
     {
-        PLIST_ENTRY listEntry;
+        ULONG i;
 
-        listEntry = ProcessListHead.Flink;
+        PhAcquireQueuedLockExclusive(&AvgCpuTableLock);
 
-        while (listEntry != &ProcessListHead)
+        for (i = 0; i < AvgCpuTable.SlotCount; i++)
         {
-            PPROCESS_EXTENSION extension = CONTAINING_RECORD(listEntry, PROCESS_EXTENSION, ListEntry);
-            PPH_PROCESS_ITEM processItem = extension->ProcessItem;
-            FLOAT sum;
-            ULONG i;
-            ULONG total;
-            ULONG count;
-
-            if (extension->CpuHistoryPosition != 0)
-                extension->CpuHistoryPosition--;
-            else
-                extension->CpuHistoryPosition = HISTORY_SIZE - 1;
-
-            extension->CpuHistory[extension->CpuHistoryPosition] = processItem->CpuUsage;
-
-            if (extension->CpuHistoryCount < HISTORY_SIZE)
-                extension->CpuHistoryCount++;
+            PPROCESS_EXTENSION extension = WinStatGetSlotContext(&AvgCpuTable, i);
+            PPH_PROCESS_ITEM processItem;
+            FLOAT cpuUsage;
+            ULONG w;
 
-            // Calculate the 10 interval average.
+            if (!extension)
+                continue;
 
-            sum = 0;
-            i = extension->CpuHistoryPosition;
-            total = 10;
-
-            if (total > extension->CpuHistoryCount)
-                total = extension->CpuHistoryCount;
-
-            count = total;
-
-            do
-            {
-                sum += extension->CpuHistory[i];
-                i++;
+            processItem = extension->ProcessItem;
+            cpuUsage = processItem->CpuUsage;
 
-                if (i == HISTORY_SIZE)
-                    i = 0;
-            } while (--count != 0);
+            if (cpuUsage < 0)
+                cpuUsage = 0;
+            if (cpuUsage > 1)
+                cpuUsage = 1;
 
-            extension->Avg10CpuUsage = sum / total;
-
-            // Calculate the 60 interval average.
-
-            if (extension->CpuHistoryCount > 10)
-            {
-                total = 50;
-
-                if (total > extension->CpuHistoryCount - 10)
-                    total = extension->CpuHistoryCount - 10;
-
-                count = total;
-
-                do
-                {
-                    sum += extension->CpuHistory[i];
-                    i++;
-
-                    if (i == HISTORY_SIZE)
-                        i = 0;
-                } while (--count != 0);
-
-                extension->Avg60CpuUsage = sum / (total + 10);
-            }
+            // Exponentially weighted moving average, similar to the Unix load average.
+            if (WinStatGetSeries(&AvgCpuTable, i, AVGCPU_SERIES_CPU)->Count != 0)
+                extension->LoadAverage = extension->LoadAverage * AvgCpuLoadDecay + cpuUsage * (1 - AvgCpuLoadDecay);
             else
-            {
-                // Not enough samples.
-                extension->Avg60CpuUsage = extension->Avg10CpuUsage;
-            }
-
-            listEntry = listEntry->Flink;
+                extension->LoadAverage = cpuUsage;
+
+            WinStatAddSample(&AvgCpuTable, i, AVGCPU_SERIES_CPU,
+                (WINSTAT_SAMPLE)(cpuUsage * AVGCPU_CPU_SCALE + 0.5f));
+            WinStatAddSample(&AvgCpuTable, i, AVGCPU_SERIES_IO, AvgCpuPackRate(
+                processItem->IoReadDelta.Delta + processItem->IoWriteDelta.Delta + processItem->IoOtherDelta.Delta,
+                AVGCPU_BYTES_SHIFT
+                ));
+            WinStatAddSample(&AvgCpuTable, i, AVGCPU_SERIES_PAGEFAULTS, AvgCpuPackRate(
+                processItem->PageFaultsDelta.Delta,
+                0
+                ));
+            WinStatAddSample(&AvgCpuTable, i, AVGCPU_SERIES_PRIVATEBYTES, AvgCpuPackRate(
+                (LONG_PTR)processItem->PrivateBytesDelta.Delta,
+                AVGCPU_BYTES_SHIFT
+                ));
+
+            // Means come straight from the running sums. Min/max/percentile need a pass
+            // over the detail window and are left to AvgCpuUpdateDetails.
+
+            for (w = 0; w < AVGCPU_WINDOW_COUNT; w++)
+                extension->AvgCpuUsage[w] = (FLOAT)(WinStatGetMean(&AvgCpuTable, i, AVGCPU_SERIES_CPU, w) / AVGCPU_CPU_SCALE);
+
+            extension->AvgIoRate = (ULONG64)(WinStatGetMean(&AvgCpuTable, i, AVGCPU_SERIES_IO, AVGCPU_DETAIL_WINDOW) * (1 << AVGCPU_BYTES_SHIFT));
+
+            extension->AvgPageFaults = (FLOAT)WinStatGetMean(&AvgCpuTable, i, AVGCPU_SERIES_PAGEFAULTS, AVGCPU_DETAIL_WINDOW);
+            extension->AvgPrivateBytesGrowth = (LONG64)(WinStatGetMean(&AvgCpuTable, i, AVGCPU_SERIES_PRIVATEBYTES, AVGCPU_DETAIL_WINDOW) * (1 << AVGCPU_BYTES_SHIFT));
         }
+
+        PhReleaseQueuedLockExclusive(&AvgCpuTableLock);
+
+        // Invalidates the cached detail statistics.
+        InterlockedIncrement((volatile LONG *)&AvgCpuRunCount);
     }
 
     runCount++;
@@ -291,16 +620,25 @@ LOGICAL DllMain(
     if (Reason == DLL_PROCESS_ATTACH)
     {
         PPH_PLUGIN_INFORMATION info;
+        PH_SETTING_CREATE settings[] =
+        {
+            { IntegerSettingType, SETTING_NAME_WINDOW1, L"3c" }, // 1 min
+            { IntegerSettingType, SETTING_NAME_WINDOW2, L"12c" }, // 5 min
+            { IntegerSettingType, SETTING_NAME_WINDOW3, L"384" }, // 15 min
+            { IntegerSettingType, SETTING_NAME_LOAD_PERIOD, L"3c" }
+        };
 
-        PluginInstance = PhRegisterPlugin(L"wj32.AvgCpuPlugin", Instance, &info);
+        PluginInstance = PhRegisterPlugin(PLUGIN_NAME, Instance, &info);
 
         if (!PluginInstance)
             return FALSE;
 
         info->DisplayName = L"Average CPU";
-        info->Description = L"Adds a column to display average CPU times.";
+        info->Description = L"Adds columns to display average CPU usage, I/O rate, page faults and private bytes growth.";
         info->Author = L"wj32";
 
+        PhRegisterCallback(PhGetPluginCallback(PluginInstance, PluginCallbackLoad),
+            LoadCallback, NULL, &PluginLoadCallbackRegistration);
         PhRegisterCallback(PhGetPluginCallback(PluginInstance, PluginCallbackTreeNewMessage),
             TreeNewMessageCallback, NULL, &TreeNewMessageCallbackRegistration);
         PhRegisterCallback(PhGetGeneralCallback(GeneralCallbackProcessTreeNewInitializing),
@@ -311,6 +649,8 @@ LOGICAL DllMain(
 
         PhPluginSetObjectExtension(PluginInstance, EmProcessItemType, sizeof(PROCESS_EXTENSION),
             ProcessItemCreateCallback, NULL);
+
+        PhAddSettings(settings, ARRAYSIZE(settings));
     }
 
     return TRUE;
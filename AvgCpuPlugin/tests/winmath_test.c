@@ -0,0 +1,234 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Average CPU Plugin
+ *
+ * Copyright (C) 2011-2019 wj32
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Tests for the window statistics math. Random sample streams are added to rings
+// of several shapes, and every window is checked against a direct computation over
+// the whole stream after each sample. They are not part of the plugin build.
+//
+//   gcc -g -O1 -fsanitize=address,undefined -I.. winmath_test.c ../winmath.c -o winmath_test
+//   ./winmath_test
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "winmath.h"
+
+static int TestFailures = 0;
+
+#define CHECK(Expression) \
+    do { if (!(Expression)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #Expression); TestFailures++; } } while (0)
+
+#define TEST_MAX_SAMPLES 2000
+
+static uint64_t TestRandomState = 0xd1b54a32d192ed03;
+
+static uint32_t TestRandom(
+    void
+    )
+{
+    TestRandomState ^= TestRandomState << 13;
+    TestRandomState ^= TestRandomState >> 7;
+    TestRandomState ^= TestRandomState << 17;
+
+    return (uint32_t)TestRandomState;
+}
+
+static int TestCompareSamples(
+    const void *Sample1,
+    const void *Sample2
+    )
+{
+    WINSTAT_SAMPLE sample1 = *(const WINSTAT_SAMPLE *)Sample1;
+    WINSTAT_SAMPLE sample2 = *(const WINSTAT_SAMPLE *)Sample2;
+
+    return (sample1 > sample2) - (sample1 < sample2);
+}
+
+static WINSTAT_SAMPLE TestNextSample(
+    uint32_t Kind
+    )
+{
+    switch (Kind)
+    {
+    case 0:
+        return (WINSTAT_SAMPLE)(TestRandom() % 10001); // CPU usage
+    case 1:
+        return (WINSTAT_SAMPLE)(TestRandom() % 5) - 2; // many equal values
+    default:
+        return (WINSTAT_SAMPLE)TestRandom(); // the full range, including INT32_MIN
+    }
+}
+
+// Checks every window of a series against the samples added so far, newest last.
+static void TestCheckWindows(
+    const WINSTAT_SERIES *Series,
+    const WINSTAT_SAMPLE *History,
+    uint32_t HistoryLength,
+    const uint32_t *WindowLength,
+    uint32_t WindowMask,
+    const WINSTAT_SAMPLE *Samples,
+    uint32_t SampleCount,
+    PWINSTAT_SAMPLE Scratch
+    )
+{
+    static WINSTAT_SAMPLE sorted[TEST_MAX_SAMPLES];
+
+    CHECK(Series->Count == (SampleCount < HistoryLength ? SampleCount : HistoryLength));
+    CHECK(Series->Position == SampleCount % HistoryLength);
+
+    for (uint32_t w = 0; w < WINSTAT_MAX_WINDOWS; w++)
+    {
+        uint32_t count = SampleCount < WindowLength[w] ? SampleCount : WindowLength[w];
+        WINSTAT_STATISTICS statistics;
+        int64_t sum = 0;
+
+        if (!(WindowMask & (1 << w)))
+            continue;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            sorted[i] = Samples[SampleCount - 1 - i];
+            sum += sorted[i];
+        }
+
+        qsort(sorted, count, sizeof(WINSTAT_SAMPLE), TestCompareSamples);
+
+        CHECK(Series->Sum[w] == sum);
+        CHECK(WinMathGetMean(Series, w, WindowLength[w]) == (count ? (double)sum / count : 0));
+
+        WinMathQueryStatistics(Series, History, HistoryLength, w, WindowLength[w], Scratch, &statistics);
+        CHECK(statistics.Count == count);
+        CHECK(statistics.Sum == sum);
+
+        if (count != 0)
+        {
+            // Nearest rank: the smallest sample with at least 95% of the window at or
+            // below it.
+            uint32_t rank = (count * 95 + 99) / 100;
+
+            CHECK(statistics.Minimum == sorted[0]);
+            CHECK(statistics.Maximum == sorted[count - 1]);
+            CHECK(statistics.Percentile95 == sorted[rank - 1]);
+            CHECK((uint64_t)rank * 100 >= (uint64_t)count * 95);
+            CHECK(rank == 1 || (uint64_t)(rank - 1) * 100 < (uint64_t)count * 95);
+        }
+        else
+        {
+            CHECK(statistics.Minimum == 0 && statistics.Maximum == 0 && statistics.Percentile95 == 0);
+        }
+    }
+}
+
+static void TestRing(
+    const uint32_t *WindowLength,
+    uint32_t WindowMask,
+    uint32_t SampleCount,
+    uint32_t Kind
+    )
+{
+    static WINSTAT_SAMPLE samples[TEST_MAX_SAMPLES];
+    WINSTAT_SERIES series;
+    PWINSTAT_SAMPLE history;
+    PWINSTAT_SAMPLE scratch;
+    uint32_t historyLength = 1;
+
+    // As winstat.c does: the ring is only as long as the longest window it keeps.
+    for (uint32_t w = 0; w < WINSTAT_MAX_WINDOWS; w++)
+    {
+        if ((WindowMask & (1 << w)) && historyLength < WindowLength[w])
+            historyLength = WindowLength[w];
+    }
+
+    memset(&series, 0, sizeof(WINSTAT_SERIES));
+    history = calloc(historyLength, sizeof(WINSTAT_SAMPLE));
+    scratch = calloc(historyLength, sizeof(WINSTAT_SAMPLE));
+
+    TestCheckWindows(&series, history, historyLength, WindowLength, WindowMask, samples, 0, scratch);
+
+    for (uint32_t i = 0; i < SampleCount; i++)
+    {
+        samples[i] = TestNextSample(Kind);
+        WinMathAddSample(&series, history, historyLength, WindowLength, WindowMask, samples[i]);
+        TestCheckWindows(&series, history, historyLength, WindowLength, WindowMask, samples, i + 1, scratch);
+    }
+
+    free(scratch);
+    free(history);
+}
+
+static void TestFixedRings(
+    void
+    )
+{
+    static const uint32_t windows[WINSTAT_MAX_WINDOWS] = { 60, 300, 900, 1 };
+    uint32_t windowLength[WINSTAT_MAX_WINDOWS];
+
+    // The AvgCpu layout: CPU usage keeps every window, the other series only the first.
+    TestRing(windows, 0x7, 1000, 0);
+    TestRing(windows, 0x1, 200, 2);
+    // A single sample window, and a ring that is shorter than an unused window.
+    TestRing(windows, 0x8, 10, 2);
+    TestRing(windows, 0x9, 100, 1);
+
+    // All windows the same length as the ring.
+    for (uint32_t w = 0; w < WINSTAT_MAX_WINDOWS; w++)
+        windowLength[w] = 7;
+
+    TestRing(windowLength, 0xf, 50, 1);
+}
+
+static void TestRandomRings(
+    void
+    )
+{
+    for (uint32_t run = 0; run < 200; run++)
+    {
+        uint32_t windowLength[WINSTAT_MAX_WINDOWS];
+        uint32_t windowMask;
+
+        for (uint32_t w = 0; w < WINSTAT_MAX_WINDOWS; w++)
+            windowLength[w] = 1 + TestRandom() % 40;
+
+        if (!(windowMask = TestRandom() % 16))
+            windowMask = 1;
+
+        TestRing(windowLength, windowMask, TestRandom() % 120, run % 3);
+    }
+}
+
+int main(
+    void
+    )
+{
+    TestFixedRings();
+    TestRandomRings();
+
+    if (TestFailures)
+    {
+        printf("%d check(s) failed\n", TestFailures);
+        return 1;
+    }
+
+    printf("all tests passed\n");
+
+    return 0;
+}
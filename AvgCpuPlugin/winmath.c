@@ -0,0 +1,208 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Average CPU Plugin
+ *
+ * Copyright (C) 2011-2019 wj32
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "winmath.h"
+
+/**
+ * Adds a sample to a ring and updates the running sum of each window.
+ *
+ * \param Series The state of the ring.
+ * \param History The ring, \a HistoryLength samples.
+ * \param HistoryLength The length of the ring. It must not be shorter than any of
+ * the windows in \a WindowMask.
+ * \param WindowLength The length of each window, in samples.
+ * \param WindowMask The windows that keep a running sum, one bit per window.
+ * \param Sample The sample.
+ */
+void WinMathAddSample(
+    PWINSTAT_SERIES Series,
+    PWINSTAT_SAMPLE History,
+    uint32_t HistoryLength,
+    const uint32_t *WindowLength,
+    uint32_t WindowMask,
+    WINSTAT_SAMPLE Sample
+    )
+{
+    uint32_t position = Series->Position;
+
+    // Each window keeps a running sum: add the new sample and subtract the one that
+    // just fell out of the window. The oldest sample of the longest window is the one
+    // about to be overwritten, so it is read before the store below.
+
+    for (uint32_t i = 0; i < WINSTAT_MAX_WINDOWS; i++)
+    {
+        uint32_t length = WindowLength[i];
+
+        if (!(WindowMask & (1 << i)))
+            continue;
+
+        if (Series->Count >= length)
+        {
+            if (position >= length)
+                Series->Sum[i] -= History[position - length];
+            else
+                Series->Sum[i] -= History[position + HistoryLength - length];
+        }
+
+        Series->Sum[i] += Sample;
+    }
+
+    History[position] = Sample;
+
+    if (++position == HistoryLength)
+        position = 0;
+
+    Series->Position = position;
+
+    if (Series->Count < HistoryLength)
+        Series->Count++;
+}
+
+double WinMathGetMean(
+    const WINSTAT_SERIES *Series,
+    uint32_t Window,
+    uint32_t WindowLength
+    )
+{
+    uint32_t count = Series->Count < WindowLength ? Series->Count : WindowLength;
+
+    if (count == 0)
+        return 0;
+
+    return (double)Series->Sum[Window] / count;
+}
+
+static WINSTAT_SAMPLE WinMathpSelect(
+    PWINSTAT_SAMPLE Samples,
+    uint32_t Count,
+    uint32_t Rank
+    )
+{
+    uint32_t left = 0;
+    uint32_t right = Count - 1;
+
+    // Hoare's selection algorithm; partially orders Samples so that Samples[Rank]
+    // holds the Rank-th smallest value.
+
+    while (left < right)
+    {
+        WINSTAT_SAMPLE pivot = Samples[left + (right - left) / 2];
+        uint32_t i = left;
+        uint32_t j = right;
+
+        while (i <= j)
+        {
+            while (Samples[i] < pivot)
+                i++;
+            while (Samples[j] > pivot)
+                j--;
+
+            if (i <= j)
+            {
+                WINSTAT_SAMPLE temp = Samples[i];
+
+                Samples[i] = Samples[j];
+                Samples[j] = temp;
+                i++;
+
+                if (j == 0)
+                    break;
+
+                j--;
+            }
+        }
+
+        if (Rank <= j)
+            right = j;
+        else if (Rank >= i)
+            left = i;
+        else
+            break;
+    }
+
+    return Samples[Rank];
+}
+
+/**
+ * Computes the statistics of the newest samples of a ring.
+ *
+ * \param Series The state of the ring.
+ * \param History The ring.
+ * \param HistoryLength The length of the ring.
+ * \param Window The window whose running sum is used. It must be kept by the ring.
+ * \param WindowLength The length of the window, in samples.
+ * \param Scratch A buffer of at least min(Count, \a WindowLength) samples.
+ * \param Statistics The statistics. All fields are zero if the ring is empty.
+ */
+void WinMathQueryStatistics(
+    const WINSTAT_SERIES *Series,
+    const WINSTAT_SAMPLE *History,
+    uint32_t HistoryLength,
+    uint32_t Window,
+    uint32_t WindowLength,
+    PWINSTAT_SAMPLE Scratch,
+    PWINSTAT_STATISTICS Statistics
+    )
+{
+    uint32_t count = Series->Count < WindowLength ? Series->Count : WindowLength;
+    uint32_t index;
+    WINSTAT_SAMPLE minimum;
+    WINSTAT_SAMPLE maximum;
+
+    memset(Statistics, 0, sizeof(WINSTAT_STATISTICS));
+
+    if (count == 0)
+        return;
+
+    Statistics->Count = count;
+    Statistics->Sum = Series->Sum[Window];
+    Statistics->Mean = (double)Series->Sum[Window] / count;
+
+    // Min, max and the percentile need the samples themselves. Copy the window into
+    // the scratch buffer (newest first) so the selection can reorder it.
+
+    index = Series->Position;
+    minimum = INT32_MAX;
+    maximum = INT32_MIN;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        WINSTAT_SAMPLE sample;
+
+        if (index == 0)
+            index = HistoryLength;
+
+        sample = History[--index];
+        Scratch[i] = sample;
+
+        if (minimum > sample)
+            minimum = sample;
+        if (maximum < sample)
+            maximum = sample;
+    }
+
+    Statistics->Minimum = minimum;
+    Statistics->Maximum = maximum;
+    // Nearest-rank 95th percentile.
+    Statistics->Percentile95 = WinMathpSelect(Scratch, count, (count * 95 + 99) / 100 - 1);
+}
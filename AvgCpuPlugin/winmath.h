@@ -0,0 +1,82 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Average CPU Plugin
+ *
+ * Copyright (C) 2011-2019 wj32
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _WINMATH_H_
+#define _WINMATH_H_
+
+// Running-sum windows over a ring of samples. This unit only depends on the C
+// runtime so that it can be built and tested on its own (see tests\winmath_test.c);
+// winstat.c keeps the rings of every process in a table.
+
+#include <stdint.h>
+
+#define WINSTAT_MAX_WINDOWS 4
+
+// Samples are packed fixed-point values. Each series chooses its own scale; the
+// engine only deals with integers so running sums are exact.
+typedef int32_t WINSTAT_SAMPLE, *PWINSTAT_SAMPLE;
+
+// Sum[i] is the sum of the newest min(Count, length of window i) samples. Only the
+// windows in the series' window mask are kept.
+typedef struct _WINSTAT_SERIES
+{
+    uint32_t Count;
+    uint32_t Position;
+    int64_t Sum[WINSTAT_MAX_WINDOWS];
+} WINSTAT_SERIES, *PWINSTAT_SERIES;
+
+typedef struct _WINSTAT_STATISTICS
+{
+    uint32_t Count;
+    int64_t Sum;
+    double Mean;
+    WINSTAT_SAMPLE Minimum;
+    WINSTAT_SAMPLE Maximum;
+    WINSTAT_SAMPLE Percentile95;
+} WINSTAT_STATISTICS, *PWINSTAT_STATISTICS;
+
+void WinMathAddSample(
+    PWINSTAT_SERIES Series,
+    PWINSTAT_SAMPLE History,
+    uint32_t HistoryLength,
+    const uint32_t *WindowLength,
+    uint32_t WindowMask,
+    WINSTAT_SAMPLE Sample
+    );
+
+double WinMathGetMean(
+    const WINSTAT_SERIES *Series,
+    uint32_t Window,
+    uint32_t WindowLength
+    );
+
+void WinMathQueryStatistics(
+    const WINSTAT_SERIES *Series,
+    const WINSTAT_SAMPLE *History,
+    uint32_t HistoryLength,
+    uint32_t Window,
+    uint32_t WindowLength,
+    PWINSTAT_SAMPLE Scratch,
+    PWINSTAT_STATISTICS Statistics
+    );
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Average CPU Plugin
+ *
+ * Copyright (C) 2011-2019 wj32
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <phdk.h>
+#include "winstat.h"
+
+static PWINSTAT_SAMPLE WinStatpGetHistory(
+    _In_ PWINSTAT_TABLE Table,
+    _In_ ULONG Slot,
+    _In_ ULONG Series
+    )
+{
+    return &Table->History[(SIZE_T)Slot * Table->SlotHistoryLength + Table->HistoryOffset[Series]];
+}
+
+/**
+ * Initializes a table.
+ *
+ * \param Table The table.
+ * \param SeriesCount The number of series in each slot.
+ * \param WindowCount The number of windows.
+ * \param WindowLength The length of each window, in samples.
+ * \param WindowMask The windows that each series keeps, one bit per window. A series
+ * only stores as many samples as its longest window needs, so series that are only
+ * shown over a short window stay small.
+ * \param InitialCapacity The initial number of slots.
+ */
+VOID WinStatInitializeTable(
+    _Out_ PWINSTAT_TABLE Table,
+    _In_ ULONG SeriesCount,
+    _In_ ULONG WindowCount,
+    _In_reads_(WindowCount) PULONG WindowLength,
+    _In_reads_(SeriesCount) PULONG WindowMask,
+    _In_ ULONG InitialCapacity
+    )
+{
+    ULONG scratchLength = 1;
+    ULONG i;
+    ULONG j;
+
+    assert(WindowCount != 0 && WindowCount <= WINSTAT_MAX_WINDOWS);
+    assert(SeriesCount != 0 && SeriesCount <= WINSTAT_MAX_SERIES);
+
+    memset(Table, 0, sizeof(WINSTAT_TABLE));
+    Table->SeriesCount = SeriesCount;
+    Table->WindowCount = WindowCount;
+    Table->FreeSlot = ULONG_MAX;
+
+    for (i = 0; i < WindowCount; i++)
+        Table->WindowLength[i] = max(WindowLength[i], 1);
+
+    for (i = 0; i < SeriesCount; i++)
+    {
+        Table->WindowMask[i] = WindowMask[i] & ((1 << WindowCount) - 1);
+        Table->HistoryLength[i] = 1;
+
+        for (j = 0; j < WindowCount; j++)
+        {
+            if ((Table->WindowMask[i] & (1 << j)) && Table->HistoryLength[i] < Table->WindowLength[j])
+                Table->HistoryLength[i] = Table->WindowLength[j];
+        }
+
+        Table->HistoryOffset[i] = Table->SlotHistoryLength;
+        Table->SlotHistoryLength += Table->HistoryLength[i];
+
+        if (scratchLength < Table->HistoryLength[i])
+            scratchLength = Table->HistoryLength[i];
+    }
+
+    Table->SlotCapacity = max(InitialCapacity, 1);
+    Table->SlotContext = PhAllocate(Table->SlotCapacity * sizeof(PVOID));
+    Table->Series = PhAllocate((SIZE_T)Table->SlotCapacity * SeriesCount * sizeof(WINSTAT_SERIES));
+    Table->History = PhAllocate((SIZE_T)Table->SlotCapacity * Table->SlotHistoryLength * sizeof(WINSTAT_SAMPLE));
+    Table->Scratch = PhAllocate(scratchLength * sizeof(WINSTAT_SAMPLE));
+}
+
+VOID WinStatDeleteTable(
+    _Inout_ PWINSTAT_TABLE Table
+    )
+{
+    PhFree(Table->Scratch);
+    PhFree(Table->History);
+    PhFree(Table->Series);
+    PhFree(Table->SlotContext);
+
+    memset(Table, 0, sizeof(WINSTAT_TABLE));
+}
+
+ULONG WinStatAllocateSlot(
+    _Inout_ PWINSTAT_TABLE Table,
+    _In_ PVOID Context
+    )
+{
+    ULONG slot;
+
+    if (Table->FreeSlot != ULONG_MAX)
+    {
+        // Free slots are chained through their Position field.
+        slot = Table->FreeSlot;
+        Table->FreeSlot = WinStatGetSeries(Table, slot, 0)->Position;
+    }
+    else
+    {
+        if (Table->SlotCount == Table->SlotCapacity)
+        {
+            Table->SlotCapacity *= 2;
+            Table->SlotContext = PhReAllocate(Table->SlotContext, Table->SlotCapacity * sizeof(PVOID));
+            Table->Series = PhReAllocate(Table->Series, (SIZE_T)Table->SlotCapacity * Table->SeriesCount * sizeof(WINSTAT_SERIES));
+            Table->History = PhReAllocate(Table->History, (SIZE_T)Table->SlotCapacity * Table->SlotHistoryLength * sizeof(WINSTAT_SAMPLE));
+        }
+
+        slot = Table->SlotCount++;
+    }
+
+    Table->SlotContext[slot] = Context;
+    memset(WinStatGetSeries(Table, slot, 0), 0, Table->SeriesCount * sizeof(WINSTAT_SERIES));
+
+    return slot;
+}
+
+VOID WinStatFreeSlot(
+    _Inout_ PWINSTAT_TABLE Table,
+    _In_ ULONG Slot
+    )
+{
+    Table->SlotContext[Slot] = NULL;
+    WinStatGetSeries(Table, Slot, 0)->Position = Table->FreeSlot;
+    Table->FreeSlot = Slot;
+}
+
+VOID WinStatAddSample(
+    _Inout_ PWINSTAT_TABLE Table,
+    _In_ ULONG Slot,
+    _In_ ULONG Series,
+    _In_ WINSTAT_SAMPLE Sample
+    )
+{
+    WinMathAddSample(
+        WinStatGetSeries(Table, Slot, Series),
+        WinStatpGetHistory(Table, Slot, Series),
+        Table->HistoryLength[Series],
+        Table->WindowLength,
+        Table->WindowMask[Series],
+        Sample
+        );
+}
+
+ULONG WinStatGetCount(
+    _In_ PWINSTAT_TABLE Table,
+    _In_ ULONG Slot,
+    _In_ ULONG Series,
+    _In_ ULONG Window
+    )
+{
+    return min(WinStatGetSeries(Table, Slot, Series)->Count, Table->WindowLength[Window]);
+}
+
+DOUBLE WinStatGetMean(
+    _In_ PWINSTAT_TABLE Table,
+    _In_ ULONG Slot,
+    _In_ ULONG Series,
+    _In_ ULONG Window
+    )
+{
+    assert(Table->WindowMask[Series] & (1 << Window));
+
+    return WinMathGetMean(WinStatGetSeries(Table, Slot, Series), Window, Table->WindowLength[Window]);
+}
+
+VOID WinStatQueryStatistics(
+    _Inout_ PWINSTAT_TABLE Table,
+    _In_ ULONG Slot,
+    _In_ ULONG Series,
+    _In_ ULONG Window,
+    _Out_ PWINSTAT_STATISTICS Statistics
+    )
+{
+    assert(Table->WindowMask[Series] & (1 << Window));
+
+    WinMathQueryStatistics(
+        WinStatGetSeries(Table, Slot, Series),
+        WinStatpGetHistory(Table, Slot, Series),
+        Table->HistoryLength[Series],
+        Window,
+        Table->WindowLength[Window],
+        Table->Scratch,
+        Statistics
+        );
+}
@@ -0,0 +1,123 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Average CPU Plugin
+ *
+ * Copyright (C) 2011-2019 wj32
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _WINSTAT_H_
+#define _WINSTAT_H_
+
+#include "winmath.h"
+
+#define WINSTAT_MAX_SERIES 8
+
+// A table of slots, each holding one sample ring per series. All slots share the
+// same window lengths. A series only keeps the windows in its window mask, and its
+// ring is as long as the longest of those. Rings are stored contiguously by slot so
+// a pass over every slot walks memory in order.
+typedef struct _WINSTAT_TABLE
+{
+    ULONG SeriesCount;
+    ULONG WindowCount;
+    uint32_t WindowLength[WINSTAT_MAX_WINDOWS];
+    uint32_t WindowMask[WINSTAT_MAX_SERIES];
+    uint32_t HistoryLength[WINSTAT_MAX_SERIES]; // ring length of each series
+    ULONG HistoryOffset[WINSTAT_MAX_SERIES]; // ring offset of each series within a slot
+    ULONG SlotHistoryLength; // all rings of a slot
+
+    ULONG SlotCount;
+    ULONG SlotCapacity;
+    ULONG FreeSlot;
+
+    PVOID *SlotContext;
+    PWINSTAT_SERIES Series;
+    PWINSTAT_SAMPLE History;
+    PWINSTAT_SAMPLE Scratch;
+} WINSTAT_TABLE, *PWINSTAT_TABLE;
+
+VOID WinStatInitializeTable(
+    _Out_ PWINSTAT_TABLE Table,
+    _In_ ULONG SeriesCount,
+    _In_ ULONG WindowCount,
+    _In_reads_(WindowCount) PULONG WindowLength,
+    _In_reads_(SeriesCount) PULONG WindowMask,
+    _In_ ULONG InitialCapacity
+    );
+
+VOID WinStatDeleteTable(
+    _Inout_ PWINSTAT_TABLE Table
+    );
+
+ULONG WinStatAllocateSlot(
+    _Inout_ PWINSTAT_TABLE Table,
+    _In_ PVOID Context
+    );
+
+VOID WinStatFreeSlot(
+    _Inout_ PWINSTAT_TABLE Table,
+    _In_ ULONG Slot
+    );
+
+FORCEINLINE PVOID WinStatGetSlotContext(
+    _In_ PWINSTAT_TABLE Table,
+    _In_ ULONG Slot
+    )
+{
+    return Table->SlotContext[Slot];
+}
+
+FORCEINLINE PWINSTAT_SERIES WinStatGetSeries(
+    _In_ PWINSTAT_TABLE Table,
+    _In_ ULONG Slot,
+    _In_ ULONG Series
+    )
+{
+    return &Table->Series[(SIZE_T)Slot * Table->SeriesCount + Series];
+}
+
+VOID WinStatAddSample(
+    _Inout_ PWINSTAT_TABLE Table,
+    _In_ ULONG Slot,
+    _In_ ULONG Series,
+    _In_ WINSTAT_SAMPLE Sample
+    );
+
+ULONG WinStatGetCount(
+    _In_ PWINSTAT_TABLE Table,
+    _In_ ULONG Slot,
+    _In_ ULONG Series,
+    _In_ ULONG Window
+    );
+
+DOUBLE WinStatGetMean(
+    _In_ PWINSTAT_TABLE Table,
+    _In_ ULONG Slot,
+    _In_ ULONG Series,
+    _In_ ULONG Window
+    );
+
+VOID WinStatQueryStatistics(
+    _Inout_ PWINSTAT_TABLE Table,
+    _In_ ULONG Slot,
+    _In_ ULONG Series,
+    _In_ ULONG Window,
+    _Out_ PWINSTAT_STATISTICS Statistics
+    );
+
+#endif
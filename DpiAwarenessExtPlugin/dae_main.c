@@ -21,57 +21,39 @@
  */
 
 #include <phdk.h>
-#include <mapimg.h>
 #include "resource.h"
 #include "dae_utils.h"
+#include "dae_prober.h"
 
 #define DAE_DPIAWARENESSEXT_COLUMN_ID 1
 
-#define DAE_DPI_AWARENESS_UNKNOWN 0
-#define DAE_DPI_AWARENESS_UNAWARE 1
-#define DAE_DPI_AWARENESS_SYSTEM 2
-#define DAE_DPI_AWARENESS_PER_MONITOR 3
-
-#define DAE_TRIS_UNKNOWN 0
-#define DAE_TRIS_FALSE 1
-#define DAE_TRIS_TRUE 2
-
 #define DAE_TRIS_STR(x) ((x) == DAE_TRIS_UNKNOWN ? L"?" : ((x) == DAE_TRIS_TRUE ? L"+" : L"-"))
 
  /*#define DAE_DPI_AWARENESS_LOCKED 0x8
 #define DAE_DPI_AWARENESS_PERTHREAD 0x10*/
 
-// Some flags in CLIENTINFO.CI_flags
-#define CI_INITTHREAD        0x00000008
-// This is not in any symbol file so is probably not what Microsoft calls it.
-#define CI_FORCEDPIAWARE 0x20000000
-
-// The offset of ((PCLIENTINFO)TEB->Win32ClientInfo)->CI_flags (which is TEB->Win32ClientInfo[0])
-#define CI_FLAGS_TEB64_OFFSET 0x800
-#define CI_FLAGS_TEB32_OFFSET 0x6CC
-#ifdef _WIN64
-#define CI_FLAGS_TEB_OFFSET CI_FLAGS_TEB64_OFFSET
-#else
-#define CI_FLAGS_TEB_OFFSET CI_FLAGS_TEB32_OFFSET
-#endif
-
 typedef struct _PROCESS_EXTENSION
 {
     LIST_ENTRY ListEntry;
     ULONG ValidAwareness : 1;
     ULONG ValidForced : 1;
     ULONG ValidDescription : 1;
-    ULONG ValidSpare : 29;
+    ULONG ProbeQueued : 1;
+    ULONG ValidSpare : 28;
 
     ULONG DpiAwareness : 2;
     ULONG DpiAwarenessForced : 2;
     ULONG DpiAwarenessExtSpare : 28;
     PPH_PROCESS_ITEM ProcessItem;
-    PSYSTEM_PROCESS_INFORMATION ExtProcessInfo;
+    // Set by the UI thread when the column is shown for this process, and cleared
+    // once a probe for it has completed.
+    volatile BOOLEAN ProbeWanted;
+    // Written by the provider thread under DescriptionLock.
     WCHAR DpiAwarenessExtDescription[32];
+    // The UI thread's copy of the description, which the tree draws from.
+    WCHAR CellText[32];
 } PROCESS_EXTENSION, *PPROCESS_EXTENSION;
 
-static VOID DaepUpdateDpiAwareness(PPH_PROCESS_ITEM ProcessItem, PPROCESS_EXTENSION Extension);
 static VOID DaepUpdateDpiAwarenessDescription(_In_ PPROCESS_EXTENSION Extension);
 
 static PPH_PLUGIN PluginInstance;
@@ -81,17 +63,14 @@ static PH_CALLBACK_REGISTRATION ProcessAddedCallbackRegistration;
 static PH_CALLBACK_REGISTRATION ProcessRemovedCallbackRegistration;
 static PH_CALLBACK_REGISTRATION ProcessesUpdatedCallbackRegistration;
 
+static PH_QUEUED_LOCK DescriptionLock = PH_QUEUED_LOCK_INIT;
 static LIST_ENTRY ProcessListHead = { &ProcessListHead, &ProcessListHead };
-static PVOID ExtendedProcesses;
+// Covers PIDs below 0x10000; the rest go to ProcessInfoOutliers.
+#define DAEP_MAX_PROCESS_INFO_INDEX 0x4000
 
-static BOOL (WINAPI *getProcessDpiAwarenessInternal)(
-    _In_ HANDLE hprocess,
-    _Out_ ULONG *value
-    );
-static ULONG_PTR gfDPIAwareOffset;
-#ifdef _WIN64
-static ULONG_PTR gfDPIAwareOffset32;
-#endif
+static PSYSTEM_PROCESS_INFORMATION *ProcessInfoIndex;
+static ULONG ProcessInfoIndexSize;
+static PPH_HASHTABLE ProcessInfoOutliers;
 
 static VOID DaepTreeNewMessageCallback(
     _In_opt_ PVOID Parameter,
@@ -116,9 +95,14 @@ static VOID DaepTreeNewMessageCallback(
                     PPROCESS_EXTENSION extension;
 
                     extension = PhPluginGetObjectExtension(PluginInstance, node->ProcessItem, EmProcessItemType);
-                    DaepUpdateDpiAwareness(node->ProcessItem, extension);
-                    DaepUpdateDpiAwarenessDescription(extension);
-                    PhInitializeStringRef(&getCellText->Text, extension->DpiAwarenessExtDescription);
+                    // Never probe from here; the next provider update queues it for the prober.
+                    extension->ProbeWanted = TRUE;
+
+                    PhAcquireQueuedLockShared(&DescriptionLock);
+                    memcpy(extension->CellText, extension->DpiAwarenessExtDescription, sizeof(extension->CellText));
+                    PhReleaseQueuedLockShared(&DescriptionLock);
+
+                    PhInitializeStringRef(&getCellText->Text, extension->CellText);
                 }
                 break;
             }
@@ -130,13 +114,16 @@ static VOID DaepTreeNewMessageCallback(
 static VOID DaepUpdateDpiAwarenessDescription(_In_ PPROCESS_EXTENSION Extension)
 {
     PWSTR awarenessDesc, forcedState;
+    WCHAR description[RTL_NUMBER_OF(Extension->DpiAwarenessExtDescription)];
     if (Extension->ValidDescription)
         return;
 
     switch (Extension->DpiAwareness)
     {
     case DAE_DPI_AWARENESS_UNKNOWN:
+        PhAcquireQueuedLockExclusive(&DescriptionLock);
         Extension->DpiAwarenessExtDescription[0] = L'\0';
+        PhReleaseQueuedLockExclusive(&DescriptionLock);
         Extension->ValidDescription = TRUE;
         return;
     case DAE_DPI_AWARENESS_UNAWARE:
@@ -151,8 +138,13 @@ static VOID DaepUpdateDpiAwarenessDescription(_In_ PPROCESS_EXTENSION Extension)
     }
     forcedState = DAE_TRIS_STR(Extension->DpiAwarenessForced);
 
-    swprintf(Extension->DpiAwarenessExtDescription, sizeof(Extension->DpiAwarenessExtDescription) / sizeof(WCHAR),
-        L"%s (F%s)", awarenessDesc, forcedState);
+    // Format outside the lock; the UI thread copies the text out for every cell it draws.
+    swprintf(description, RTL_NUMBER_OF(description), L"%s (F%s)", awarenessDesc, forcedState);
+
+    PhAcquireQueuedLockExclusive(&DescriptionLock);
+    memcpy(Extension->DpiAwarenessExtDescription, description, sizeof(description));
+    PhReleaseQueuedLockExclusive(&DescriptionLock);
+
     Extension->ValidDescription = TRUE;
 }
 
@@ -170,8 +162,8 @@ static LONG NTAPI DaepDpiAwarenessExtSortFunction(
     PPROCESS_EXTENSION extension1 = PhPluginGetObjectExtension(PluginInstance, node1->ProcessItem, EmProcessItemType);
     PPROCESS_EXTENSION extension2 = PhPluginGetObjectExtension(PluginInstance, node2->ProcessItem, EmProcessItemType);
 
-    DaepUpdateDpiAwareness(node1->ProcessItem, extension1);
-    DaepUpdateDpiAwareness(node2->ProcessItem, extension2);
+    extension1->ProbeWanted = TRUE;
+    extension2->ProbeWanted = TRUE;
 
     cmp1 = uintcmp(
         extension1->DpiAwareness,
@@ -233,359 +225,233 @@ VOID DaepProcessRemovedHandler(
     RemoveEntryList(&extension->ListEntry);
 }
 
-static int __cdecl DaepProcessInfoPidCompare(
-    _In_ const void *elem1,
-    _In_ const void *elem2
-)
+static BOOLEAN NTAPI DaepProcessInfoEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
 {
-    const SYSTEM_PROCESS_INFORMATION **pi1 = elem1;
-    const SYSTEM_PROCESS_INFORMATION **pi2 = elem2;
-
-    return uintptrcmp((ULONG_PTR)(*pi1)->UniqueProcessId, (ULONG_PTR)(*pi2)->UniqueProcessId);
+    return (*(PSYSTEM_PROCESS_INFORMATION *)Entry1)->UniqueProcessId == (*(PSYSTEM_PROCESS_INFORMATION *)Entry2)->UniqueProcessId;
 }
 
-static PSYSTEM_PROCESS_INFORMATION DaepLookupProcessInfo(
-    _In_ PSYSTEM_PROCESS_INFORMATION *OrderedProcesses,
-    _In_ HANDLE ProcessId,
-    _In_ ULONG ProcessCount)
+static ULONG NTAPI DaepProcessInfoHashFunction(
+    _In_ PVOID Entry
+    )
 {
-    PSYSTEM_PROCESS_INFORMATION proc;
-    ULONG startIdx = 0, endIdx = ProcessCount - 1;
-    ULONG mid;
-
-    while (endIdx >= startIdx)
-    {
-        mid = (startIdx + endIdx) / 2;
-        proc = OrderedProcesses[mid];
-        if (proc->UniqueProcessId == ProcessId)
-            return proc;
-        else if (startIdx == endIdx)
-            break;
-        else if (proc->UniqueProcessId > ProcessId)
-            endIdx = mid;
-        else
-            startIdx = mid + 1;
-    }
-    return NULL;
+    return HandleToUlong((*(PSYSTEM_PROCESS_INFORMATION *)Entry)->UniqueProcessId) / 4;
 }
 
-static VOID DaepProcessesUpdatedHandler(
-    _In_opt_ PVOID Parameter,
-    _In_opt_ PVOID Context
+/*
+ * Direct-indexed PID view over an extended process snapshot. PIDs are multiples of
+ * 4, so a table indexed by PID / 4 stays small and is filled in linear time. The
+ * table stops at DAEP_MAX_PROCESS_INFO_INDEX so that one large PID cannot pin a
+ * large allocation; processes above it are kept in a hashtable instead.
+ */
+static VOID DaepIndexProcessInfo(
+    _In_ PVOID Processes
 )
 {
-    PVOID processes;
-    PSYSTEM_PROCESS_INFORMATION *orderedProcesses;
-    ULONG processCount = 0;
-    ULONG processIdx;
-    if (!NT_SUCCESS(PhEnumProcessesEx(&processes, SystemExtendedProcessInformation)))
-        return;
-
-    for (PSYSTEM_PROCESS_INFORMATION process = PH_FIRST_PROCESS(processes); process; process = PH_NEXT_PROCESS(process))
-    {
-        processCount++;
-    }
-    orderedProcesses = calloc(processCount, sizeof(PSYSTEM_PROCESS_INFORMATION));
-    if (!orderedProcesses)
-    {
-        PhFree(processes);
-        return;
-    }
-    processIdx = 0;
-    for (PSYSTEM_PROCESS_INFORMATION process = PH_FIRST_PROCESS(processes); process; (process = PH_NEXT_PROCESS(process)), processIdx++)
+    for (PSYSTEM_PROCESS_INFORMATION process = PH_FIRST_PROCESS(Processes); process; process = PH_NEXT_PROCESS(process))
     {
-        orderedProcesses[processIdx] = process;
-    }
+        ULONG index = HandleToUlong(process->UniqueProcessId) / 4;
 
-    qsort(orderedProcesses, processCount, sizeof(PSYSTEM_PROCESS_INFORMATION), DaepProcessInfoPidCompare);
+        if (index >= DAEP_MAX_PROCESS_INFO_INDEX)
+        {
+            if (!ProcessInfoOutliers)
+            {
+                ProcessInfoOutliers = PhCreateHashtable(
+                    sizeof(PSYSTEM_PROCESS_INFORMATION),
+                    DaepProcessInfoEqualFunction,
+                    DaepProcessInfoHashFunction,
+                    64
+                    );
+            }
 
-    if (ExtendedProcesses)
-        PhFree(ExtendedProcesses);
-    ExtendedProcesses = processes;
+            PhAddEntryHashtable(ProcessInfoOutliers, &process);
+            continue;
+        }
 
-    for (PLIST_ENTRY listEntry = ProcessListHead.Flink; listEntry != &ProcessListHead; listEntry = listEntry->Flink)
-    {
-        PPROCESS_EXTENSION extension = CONTAINING_RECORD(listEntry, PROCESS_EXTENSION, ListEntry);
-        PSYSTEM_PROCESS_INFORMATION procInfo = DaepLookupProcessInfo(orderedProcesses, extension->ProcessItem->ProcessId, processCount);
-        extension->ExtProcessInfo = procInfo;
+        if (index >= ProcessInfoIndexSize)
+        {
+            ULONG newSize = min(max(index + 1, ProcessInfoIndexSize * 2), DAEP_MAX_PROCESS_INFO_INDEX);
+
+            if (ProcessInfoIndex)
+                ProcessInfoIndex = PhReAllocate(ProcessInfoIndex, newSize * sizeof(PSYSTEM_PROCESS_INFORMATION));
+            else
+                ProcessInfoIndex = PhAllocate(newSize * sizeof(PSYSTEM_PROCESS_INFORMATION));
+            memset(ProcessInfoIndex + ProcessInfoIndexSize, 0, (newSize - ProcessInfoIndexSize) * sizeof(PSYSTEM_PROCESS_INFORMATION));
+            ProcessInfoIndexSize = newSize;
+        }
 
-        // The DPI awareness defaults to unaware if not set or declared in the manifest in which case
-        // it can be changed once, so we can only be sure that it won't be changed again if it is different
-        // from Unaware.
-        if (extension->DpiAwareness == DAE_DPI_AWARENESS_UNKNOWN ||
-            (extension->DpiAwareness == DAE_DPI_AWARENESS_UNAWARE && extension->DpiAwarenessForced != DAE_TRIS_TRUE))
-            extension->ValidAwareness = FALSE;
+        ProcessInfoIndex[index] = process;
     }
-
-    free(orderedProcesses);
 }
 
-static ULONG DaepGetGfDPIAwareOffset32(
-    /* user32VBase is the base the offset in the movzx is relative to,
-     * either the current load address if relocations are performed, or
-     * the default base if not. */
-    _In_ ULONG User32VBase,
-    _In_ PBYTE IsProcessDPIAware32)
+static VOID DaepClearProcessInfoIndex(
+    _In_ PVOID Processes
+)
 {
-    // 0FB605xxxxxxxx    movzx eax, gfDPIAware
-    // C3                ret
-    __try
-    {
-        if (IsProcessDPIAware32[0] == 0x0F && IsProcessDPIAware32[1] == 0xB6 &&
-            IsProcessDPIAware32[2] == 0x05 && IsProcessDPIAware32[7] == 0xC3)
-        {
-            return *(PULONG)(IsProcessDPIAware32 + 3) - User32VBase;
-        }
-    }
-    __except (EXCEPTION_EXECUTE_HANDLER)
+    for (PSYSTEM_PROCESS_INFORMATION process = PH_FIRST_PROCESS(Processes); process; process = PH_NEXT_PROCESS(process))
     {
-        return 0;
+        ULONG index = HandleToUlong(process->UniqueProcessId) / 4;
+
+        if (index < ProcessInfoIndexSize)
+            ProcessInfoIndex[index] = NULL;
     }
-    return 0;
+
+    if (ProcessInfoOutliers)
+        PhClearHashtable(ProcessInfoOutliers);
 }
 
-static ULONG_PTR DaepGetGfDPIAwareOffset64(
-    _In_ PBYTE User32Base,
-    _In_ PBYTE IsProcessDPIAware64)
+static PSYSTEM_PROCESS_INFORMATION DaepLookupProcessInfo(
+    _In_ HANDLE ProcessId
+)
 {
-    // 0FB605xxxxxxxx    movzx eax,byte [rel gfDPIAware]
-    // C3                ret
-    __try
-    {
-        if (IsProcessDPIAware64[0] == 0x0F && IsProcessDPIAware64[1] == 0xB6 &&
-            IsProcessDPIAware64[2] == 0x05 && IsProcessDPIAware64[7] == 0xC3)
-        {
-            /* NB: x86_64 relative addressing is relative to start
-                   of the following instruction, hence the + 7 */
-            PBYTE gfDPIAwareOffsetAddr =
-                PTR_ADD_OFFSET(
-                    PTR_ADD_OFFSET(IsProcessDPIAware64, *(PULONG)(IsProcessDPIAware64 + 3)),
-                    7);
-            return gfDPIAwareOffsetAddr - User32Base;
-        }
-    }
-    __except (EXCEPTION_EXECUTE_HANDLER)
+    ULONG index = HandleToUlong(ProcessId) / 4;
+
+    if (index >= DAEP_MAX_PROCESS_INFO_INDEX)
     {
-        return 0;
+        SYSTEM_PROCESS_INFORMATION lookupProcess;
+        PSYSTEM_PROCESS_INFORMATION lookupProcessPtr = &lookupProcess;
+        PSYSTEM_PROCESS_INFORMATION *entry;
+
+        if (!ProcessInfoOutliers)
+            return NULL;
+
+        lookupProcess.UniqueProcessId = ProcessId;
+        entry = PhFindEntryHashtable(ProcessInfoOutliers, &lookupProcessPtr);
+
+        return entry ? *entry : NULL;
     }
-    return 0;
-}
 
-static void DaepInitGfDPIAwareOffset32WoW(_Out_ PULONG_PTR GfDPIAwareOffset32)
-{
-    PBYTE isProcessDPIAware32;
-    PH_STRINGREF systemRoot;
-    PPH_STRING user32FileName;
-    PH_MAPPED_IMAGE mappedImage;
-    PH_MAPPED_IMAGE_EXPORTS exports;
-    PH_MAPPED_IMAGE_EXPORT_FUNCTION isProcessDPIAwareFun;
-    NTSTATUS status;
-
-    *GfDPIAwareOffset32 = 0;
-
-    PhGetSystemRoot(&systemRoot);
-    user32FileName = PhConcatStringRefZ(&systemRoot, L"\\SysWow64\\user32.dll");
-    status = PhLoadMappedImage(user32FileName->Buffer, NULL, TRUE, &mappedImage);
-    PhDereferenceObject(user32FileName);
-    if (!NT_SUCCESS(status))
-        return;
+    if (index < ProcessInfoIndexSize && ProcessInfoIndex[index] && ProcessInfoIndex[index]->UniqueProcessId == ProcessId)
+        return ProcessInfoIndex[index];
 
-    if (!NT_SUCCESS(PhGetMappedImageExports(&exports, &mappedImage)))
-        goto CleanupExit;
-
-    if (!NT_SUCCESS(PhGetMappedImageExportFunction(
-        &exports,
-        "IsProcessDPIAware",
-        0,
-        &isProcessDPIAwareFun
-        )) || !isProcessDPIAwareFun.Function)
-        goto CleanupExit;
-    isProcessDPIAware32 = PhMappedImageRvaToVa(
-        &mappedImage,
-        PtrToUlong(isProcessDPIAwareFun.Function),
-        NULL);
-    if (isProcessDPIAware32)
-        *GfDPIAwareOffset32 = DaepGetGfDPIAwareOffset32(
-            mappedImage.NtHeaders32->OptionalHeader.ImageBase,
-            isProcessDPIAware32);
-
-CleanupExit:
-    PhUnloadMappedImage(&mappedImage);
+    return NULL;
 }
 
-#ifdef _WIN64
-#define DaepGetGfDPIAwareOffset DaepGetGfDPIAwareOffset64
-#else
-#define DaepGetGfDPIAwareOffset(user32Base, isProcessDPIAware) DaepGetGfDPIAwareOffset32((ULONG)(user32Base), isProcessDPIAware)
-#endif
-
-static void DaepInitDpiAwarenessValues(
-    _Out_ PVOID* GetProcessDpiAwarenessInternal,
-#ifdef _WIN64
-    _Out_ PULONG_PTR GfDPIAwareOffset32,
-#endif
-    _Out_ PULONG_PTR GfDPIAwareOffset
-    )
+static VOID DaepApplyCompletedProbes(VOID)
 {
-    PBYTE isProcessDPIAware = 0;
-    PVOID user32Base;
+    LIST_ENTRY completedListHead;
+    PLIST_ENTRY listEntry;
 
-    *GfDPIAwareOffset = 0;
-    user32Base = PhGetDllHandle(L"user32.dll");
-    if (!user32Base)
+    if (!DaeGetCompletedProbeRequests(&completedListHead))
         return;
-    if (*GetProcessDpiAwarenessInternal =
-        PhGetProcedureAddress(user32Base, "GetProcessDpiAwarenessInternal", 0))
-        return;
-    isProcessDPIAware = PhGetProcedureAddress(user32Base, "IsProcessDPIAware", 0);
-
-    if (isProcessDPIAware)
-        *GfDPIAwareOffset = DaepGetGfDPIAwareOffset(user32Base, isProcessDPIAware);
-
-#ifdef _WIN64
-    DaepInitGfDPIAwareOffset32WoW(GfDPIAwareOffset32);
-#endif
-}
 
-static ULONG DaepGetDpiAwareness(_In_ PPH_PROCESS_ITEM ProcessItem, _Inout_ PHANDLE VmReadHandle)
-{
-    ULONG dpiAwareness = DAE_DPI_AWARENESS_UNKNOWN;
-    if (getProcessDpiAwarenessInternal)
-    {
-        ULONG winDpiAwareness;
-        if (getProcessDpiAwarenessInternal(ProcessItem->QueryHandle, &winDpiAwareness))
-            dpiAwareness = winDpiAwareness + 1;
-    }
-    else
+    while ((listEntry = RemoveHeadList(&completedListHead)) != &completedListHead)
     {
-        ULONG_PTR curOffset;
-#ifdef _WIN64
-        if (ProcessItem->IsWow64)
-            curOffset = gfDPIAwareOffset32;
-        else
-#endif
-            curOffset = gfDPIAwareOffset;
-        PH_STRINGREF user32sr = PH_STRINGREF_INIT(L"user32.dll");
-        PVOID user32Base;
-        BOOLEAN gfDPIAware;
+        PDAE_PROBE_REQUEST request = CONTAINING_RECORD(listEntry, DAE_PROBE_REQUEST, ListEntry);
+        PPROCESS_EXTENSION extension = request->Context;
 
-        if (!*VmReadHandle)
+        if (request->ProbeAwareness)
         {
-            if (!NT_SUCCESS(PhOpenProcess(VmReadHandle, PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_VM_READ, ProcessItem->ProcessId)))
-                return DAE_DPI_AWARENESS_UNKNOWN;
+            extension->ValidDescription = extension->ValidDescription && extension->DpiAwareness == request->DpiAwareness;
+            extension->DpiAwareness = request->DpiAwareness;
+            extension->ValidAwareness = TRUE;
         }
-        if (!NT_SUCCESS(
-            DaeGetDllBaseRemote(
-                *VmReadHandle,
-                &user32sr,
-                &user32Base)) || !user32Base)
-            return DAE_DPI_AWARENESS_UNKNOWN;
-        if (!NT_SUCCESS(
-            NtReadVirtualMemory(
-                *VmReadHandle,
-                PTR_ADD_OFFSET(user32Base, curOffset),
-                &gfDPIAware,
-                sizeof(BOOLEAN),
-                NULL)))
-            return DAE_DPI_AWARENESS_UNKNOWN;
-        dpiAwareness = !!gfDPIAware + 1;
+
+        if (request->ProbeForced)
+        {
+            extension->ValidDescription = extension->ValidDescription && extension->DpiAwarenessForced == request->DpiAwarenessForced;
+            extension->DpiAwarenessForced = request->DpiAwarenessForced;
+            extension->ValidForced = TRUE;
+        }
+
+        // Probe again only if the column still shows the process.
+        extension->ProbeQueued = FALSE;
+        extension->ProbeWanted = FALSE;
+        DaepUpdateDpiAwarenessDescription(extension);
+        DaeFreeProbeRequest(request);
     }
-    return dpiAwareness;
 }
 
-static ULONG DaepGetDpiAwarenessForced(_In_ PPROCESS_EXTENSION Extension, _Inout_ PHANDLE VmReadHandle)
+static BOOLEAN DaepNeedsProbe(
+    _In_ PPROCESS_EXTENSION Extension
+)
 {
-    PSYSTEM_PROCESS_INFORMATION procInfo = Extension->ExtProcessInfo;
-    if (!procInfo || procInfo->NumberOfThreads == 0)
-        return DAE_TRIS_UNKNOWN;
+    if (!Extension->ProbeWanted || Extension->ProbeQueued)
+        return FALSE;
 
-    if (!*VmReadHandle)
-    {
-        if (!NT_SUCCESS(PhOpenProcess(VmReadHandle, PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_VM_READ, Extension->ProcessItem->ProcessId)))
-            return DAE_TRIS_UNKNOWN;
-    }
+    return !Extension->ValidAwareness || !Extension->ValidForced;
+}
 
-    for (ULONG i = 0; i < procInfo->NumberOfThreads; i++)
+static VOID DaepQueueProbe(
+    _In_ PPROCESS_EXTENSION Extension,
+    _In_opt_ PSYSTEM_PROCESS_INFORMATION ProcessInfo
+)
+{
+    PDAE_PROBE_REQUEST request;
+
+    if (!Extension->ProcessItem->QueryHandle)
     {
-        ULONG ciFlags = 0;
-        PSYSTEM_EXTENDED_THREAD_INFORMATION threadInfo = (PSYSTEM_EXTENDED_THREAD_INFORMATION)procInfo->Threads + i;
-        if (!threadInfo->TebBase)
-            continue;
-        if (!NT_SUCCESS(NtReadVirtualMemory(
-                *VmReadHandle,
-                PTR_ADD_OFFSET(threadInfo->TebBase, CI_FLAGS_TEB_OFFSET),
-                &ciFlags,
-                sizeof(ciFlags),
-                NULL)))
-            continue;
-        if (ciFlags & CI_INITTHREAD)
-            return (ciFlags & CI_FORCEDPIAWARE) ? DAE_TRIS_TRUE : DAE_TRIS_FALSE;
+        // Nothing we can read; show the process as unknown.
+        Extension->ValidAwareness = TRUE;
+        Extension->ValidForced = TRUE;
+        Extension->ProbeWanted = FALSE;
+        DaepUpdateDpiAwarenessDescription(Extension);
+        return;
     }
-    return DAE_TRIS_UNKNOWN;
+
+    request = DaeCreateProbeRequest(Extension->ProcessItem, ProcessInfo, Extension);
+    request->ProbeAwareness = !Extension->ValidAwareness;
+    request->ProbeForced = !Extension->ValidForced;
+    Extension->ProbeQueued = TRUE;
+    DaeQueueProbeRequest(request);
 }
 
-static VOID DaepUpdateDpiAwareness(_In_ PPH_PROCESS_ITEM ProcessItem, _In_opt_ PPROCESS_EXTENSION Extension)
+static VOID DaepProcessesUpdatedHandler(
+    _In_opt_ PVOID Parameter,
+    _In_opt_ PVOID Context
+)
 {
-    static PH_INITONCE initOnce = PH_INITONCE_INIT;
-    BOOL query_gfDPIAware32 = FALSE;
-    BOOL query_gfDPIAware64 = FALSE;
-    HANDLE vmReadHandle = NULL;
+    PVOID processes = NULL;
+    BOOLEAN needThreads = FALSE;
 
-    if (!Extension)
-        Extension = PhPluginGetObjectExtension(PluginInstance, ProcessItem, EmProcessItemType);
+    DaepApplyCompletedProbes();
 
-    if (PhBeginInitOnce(&initOnce))
+    for (PLIST_ENTRY listEntry = ProcessListHead.Flink; listEntry != &ProcessListHead; listEntry = listEntry->Flink)
     {
-        DaepInitDpiAwarenessValues(
-            (PVOID*)&getProcessDpiAwarenessInternal,
-#ifdef _WIN64
-            &gfDPIAwareOffset32,
-#endif
-            &gfDPIAwareOffset
-        );
-        PhEndInitOnce(&initOnce);
+        PPROCESS_EXTENSION extension = CONTAINING_RECORD(listEntry, PROCESS_EXTENSION, ListEntry);
+
+        // The DPI awareness defaults to unaware if not set or declared in the manifest in which case
+        // it can be changed once, so we can only be sure that it won't be changed again if it is different
+        // from Unaware.
+        if (extension->DpiAwareness == DAE_DPI_AWARENESS_UNKNOWN ||
+            (extension->DpiAwareness == DAE_DPI_AWARENESS_UNAWARE && extension->DpiAwarenessForced != DAE_TRIS_TRUE))
+            extension->ValidAwareness = FALSE;
+
+        if (DaepNeedsProbe(extension) && !extension->ValidForced && extension->ProcessItem->QueryHandle)
+            needThreads = TRUE;
     }
 
-    if (!getProcessDpiAwarenessInternal)
+    // Only the forced state needs the thread list, and it is read once per process, so most
+    // updates get by without a snapshot of their own.
+    if (needThreads)
     {
-#ifdef _WIN64
-        query_gfDPIAware32 = ProcessItem->IsWow64 &&
-            gfDPIAwareOffset32;
-        query_gfDPIAware64 = !ProcessItem->IsWow64 &&
-            gfDPIAwareOffset;
-#else
-        query_gfDPIAware32 = gfDPIAwareOffset;
-#endif
-        if (!query_gfDPIAware32 && !query_gfDPIAware64)
-            return;
+        if (NT_SUCCESS(PhEnumProcessesEx(&processes, SystemExtendedProcessInformation)))
+            DaepIndexProcessInfo(processes);
+        else
+            processes = NULL;
     }
 
-    if (!Extension->ValidAwareness)
+    for (PLIST_ENTRY listEntry = ProcessListHead.Flink; listEntry != &ProcessListHead; listEntry = listEntry->Flink)
     {
-        ULONG oldDpiAwareness = Extension->DpiAwareness;
-        if (ProcessItem->QueryHandle)
-        {
-            Extension->DpiAwareness = DaepGetDpiAwareness(ProcessItem, &vmReadHandle);
-        }
+        PPROCESS_EXTENSION extension = CONTAINING_RECORD(listEntry, PROCESS_EXTENSION, ListEntry);
 
-        Extension->ValidAwareness = TRUE;
-        Extension->ValidDescription = Extension->ValidDescription && oldDpiAwareness == Extension->DpiAwareness;
-    }
+        if (!DaepNeedsProbe(extension))
+            continue;
 
-    if (!Extension->ValidForced)
-    {
-        ULONG oldDpiAwarenessForced = Extension->DpiAwarenessForced;
-        if (ProcessItem->QueryHandle)
-        {
-            Extension->DpiAwarenessForced = DaepGetDpiAwarenessForced(Extension, &vmReadHandle);
-        }
+        // Without a snapshot, leave the forced state for the next update.
+        if (!extension->ValidForced && needThreads && !processes)
+            continue;
 
-        Extension->ValidForced = TRUE;
-        Extension->ValidDescription = Extension->ValidDescription && oldDpiAwarenessForced == Extension->DpiAwarenessForced;
+        DaepQueueProbe(extension, processes ? DaepLookupProcessInfo(extension->ProcessItem->ProcessId) : NULL);
     }
 
-    if (vmReadHandle)
-        NtClose(vmReadHandle);
+    if (processes)
+    {
+        DaepClearProcessInfoIndex(processes);
+        PhFree(processes);
+    }
 }
 
 LOGICAL DllMain(
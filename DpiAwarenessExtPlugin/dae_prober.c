@@ -0,0 +1,471 @@
+/*
+ * Process Hacker Extra Plugins -
+ *  DPI Awareness Extras Plugin
+ *
+ * Copyright (C) 2018 poizan42
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <phdk.h>
+#include <mapimg.h>
+#include "dae_utils.h"
+#include "dae_prober.h"
+
+// Some flags in CLIENTINFO.CI_flags
+#define CI_INITTHREAD        0x00000008
+// This is not in any symbol file so is probably not what Microsoft calls it.
+#define CI_FORCEDPIAWARE 0x20000000
+
+// The offset of ((PCLIENTINFO)TEB->Win32ClientInfo)->CI_flags (which is TEB->Win32ClientInfo[0])
+#define CI_FLAGS_TEB64_OFFSET 0x800
+#define CI_FLAGS_TEB32_OFFSET 0x6CC
+#ifdef _WIN64
+#define CI_FLAGS_TEB_OFFSET CI_FLAGS_TEB64_OFFSET
+#else
+#define CI_FLAGS_TEB_OFFSET CI_FLAGS_TEB32_OFFSET
+#endif
+
+typedef struct _DAE_USER32_BASE_ENTRY
+{
+    ULONG SessionId;
+    BOOLEAN IsWow64;
+    PVOID User32Base;
+} DAE_USER32_BASE_ENTRY, *PDAE_USER32_BASE_ENTRY;
+
+static PH_QUEUED_LOCK DaepProbeListLock = PH_QUEUED_LOCK_INIT;
+static LIST_ENTRY DaepPendingProbeListHead = { &DaepPendingProbeListHead, &DaepPendingProbeListHead };
+static LIST_ENTRY DaepCompletedProbeListHead = { &DaepCompletedProbeListHead, &DaepCompletedProbeListHead };
+static HANDLE DaepProbeEvent;
+
+// Owned by the prober thread.
+static PPH_HASHTABLE DaepUser32BaseHashtable;
+
+static BOOL (WINAPI *getProcessDpiAwarenessInternal)(
+    _In_ HANDLE hprocess,
+    _Out_ ULONG *value
+    );
+static ULONG_PTR gfDPIAwareOffset;
+#ifdef _WIN64
+static ULONG_PTR gfDPIAwareOffset32;
+#endif
+
+static ULONG DaepGetGfDPIAwareOffset32(
+    /* user32VBase is the base the offset in the movzx is relative to,
+     * either the current load address if relocations are performed, or
+     * the default base if not. */
+    _In_ ULONG User32VBase,
+    _In_ PBYTE IsProcessDPIAware32)
+{
+    // 0FB605xxxxxxxx    movzx eax, gfDPIAware
+    // C3                ret
+    __try
+    {
+        if (IsProcessDPIAware32[0] == 0x0F && IsProcessDPIAware32[1] == 0xB6 &&
+            IsProcessDPIAware32[2] == 0x05 && IsProcessDPIAware32[7] == 0xC3)
+        {
+            return *(PULONG)(IsProcessDPIAware32 + 3) - User32VBase;
+        }
+    }
+    __except (EXCEPTION_EXECUTE_HANDLER)
+    {
+        return 0;
+    }
+    return 0;
+}
+
+static ULONG_PTR DaepGetGfDPIAwareOffset64(
+    _In_ PBYTE User32Base,
+    _In_ PBYTE IsProcessDPIAware64)
+{
+    // 0FB605xxxxxxxx    movzx eax,byte [rel gfDPIAware]
+    // C3                ret
+    __try
+    {
+        if (IsProcessDPIAware64[0] == 0x0F && IsProcessDPIAware64[1] == 0xB6 &&
+            IsProcessDPIAware64[2] == 0x05 && IsProcessDPIAware64[7] == 0xC3)
+        {
+            /* NB: x86_64 relative addressing is relative to start
+                   of the following instruction, hence the + 7 */
+            PBYTE gfDPIAwareOffsetAddr =
+                PTR_ADD_OFFSET(
+                    PTR_ADD_OFFSET(IsProcessDPIAware64, *(PULONG)(IsProcessDPIAware64 + 3)),
+                    7);
+            return gfDPIAwareOffsetAddr - User32Base;
+        }
+    }
+    __except (EXCEPTION_EXECUTE_HANDLER)
+    {
+        return 0;
+    }
+    return 0;
+}
+
+static void DaepInitGfDPIAwareOffset32WoW(_Out_ PULONG_PTR GfDPIAwareOffset32)
+{
+    PBYTE isProcessDPIAware32;
+    PH_STRINGREF systemRoot;
+    PPH_STRING user32FileName;
+    PH_MAPPED_IMAGE mappedImage;
+    PH_MAPPED_IMAGE_EXPORTS exports;
+    PH_MAPPED_IMAGE_EXPORT_FUNCTION isProcessDPIAwareFun;
+    NTSTATUS status;
+
+    *GfDPIAwareOffset32 = 0;
+
+    PhGetSystemRoot(&systemRoot);
+    user32FileName = PhConcatStringRefZ(&systemRoot, L"\\SysWow64\\user32.dll");
+    status = PhLoadMappedImage(user32FileName->Buffer, NULL, TRUE, &mappedImage);
+    PhDereferenceObject(user32FileName);
+    if (!NT_SUCCESS(status))
+        return;
+
+    if (!NT_SUCCESS(PhGetMappedImageExports(&exports, &mappedImage)))
+        goto CleanupExit;
+
+    if (!NT_SUCCESS(PhGetMappedImageExportFunction(
+        &exports,
+        "IsProcessDPIAware",
+        0,
+        &isProcessDPIAwareFun
+        )) || !isProcessDPIAwareFun.Function)
+        goto CleanupExit;
+    isProcessDPIAware32 = PhMappedImageRvaToVa(
+        &mappedImage,
+        PtrToUlong(isProcessDPIAwareFun.Function),
+        NULL);
+    if (isProcessDPIAware32)
+        *GfDPIAwareOffset32 = DaepGetGfDPIAwareOffset32(
+            mappedImage.NtHeaders32->OptionalHeader.ImageBase,
+            isProcessDPIAware32);
+
+CleanupExit:
+    PhUnloadMappedImage(&mappedImage);
+}
+
+#ifdef _WIN64
+#define DaepGetGfDPIAwareOffset DaepGetGfDPIAwareOffset64
+#else
+#define DaepGetGfDPIAwareOffset(user32Base, isProcessDPIAware) DaepGetGfDPIAwareOffset32((ULONG)(user32Base), isProcessDPIAware)
+#endif
+
+static void DaepInitDpiAwarenessValues(
+    _Out_ PVOID* GetProcessDpiAwarenessInternal,
+#ifdef _WIN64
+    _Out_ PULONG_PTR GfDPIAwareOffset32,
+#endif
+    _Out_ PULONG_PTR GfDPIAwareOffset
+    )
+{
+    PBYTE isProcessDPIAware = 0;
+    PVOID user32Base;
+
+    *GfDPIAwareOffset = 0;
+    user32Base = PhGetDllHandle(L"user32.dll");
+    if (!user32Base)
+        return;
+    if (*GetProcessDpiAwarenessInternal =
+        PhGetProcedureAddress(user32Base, "GetProcessDpiAwarenessInternal", 0))
+        return;
+    isProcessDPIAware = PhGetProcedureAddress(user32Base, "IsProcessDPIAware", 0);
+
+    if (isProcessDPIAware)
+        *GfDPIAwareOffset = DaepGetGfDPIAwareOffset(user32Base, isProcessDPIAware);
+
+#ifdef _WIN64
+    DaepInitGfDPIAwareOffset32WoW(GfDPIAwareOffset32);
+#endif
+}
+
+static BOOLEAN NTAPI DaepUser32BaseEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+)
+{
+    PDAE_USER32_BASE_ENTRY entry1 = Entry1;
+    PDAE_USER32_BASE_ENTRY entry2 = Entry2;
+
+    return entry1->SessionId == entry2->SessionId && entry1->IsWow64 == entry2->IsWow64;
+}
+
+static ULONG NTAPI DaepUser32BaseHashFunction(
+    _In_ PVOID Entry
+)
+{
+    PDAE_USER32_BASE_ENTRY entry = Entry;
+
+    return (entry->SessionId << 1) | entry->IsWow64;
+}
+
+/*
+ * user32 is mapped at the same address in every process of a session with the
+ * same bitness, so the loader list only has to be walked once per (session,
+ * bitness). A process that does not have user32 loaded at the cached address
+ * gets a walk of its own.
+ */
+static PVOID DaepGetUser32Base(
+    _In_ PPH_PROCESS_ITEM ProcessItem,
+    _In_ HANDLE VmReadHandle,
+    _In_ BOOLEAN Refresh
+)
+{
+    static PH_STRINGREF user32sr = PH_STRINGREF_INIT(L"user32.dll");
+    DAE_USER32_BASE_ENTRY lookupEntry;
+    PDAE_USER32_BASE_ENTRY entry;
+    PVOID user32Base;
+
+    lookupEntry.SessionId = ProcessItem->SessionId;
+    lookupEntry.IsWow64 = !!ProcessItem->IsWow64;
+
+    if (!Refresh && (entry = PhFindEntryHashtable(DaepUser32BaseHashtable, &lookupEntry)))
+        return entry->User32Base;
+
+    if (!NT_SUCCESS(DaeGetDllBaseRemote(VmReadHandle, &user32sr, &user32Base)) || !user32Base)
+        return NULL;
+
+    lookupEntry.User32Base = user32Base;
+
+    if (entry = PhFindEntryHashtable(DaepUser32BaseHashtable, &lookupEntry))
+        entry->User32Base = user32Base;
+    else
+        PhAddEntryHashtable(DaepUser32BaseHashtable, &lookupEntry);
+
+    return user32Base;
+}
+
+static BOOLEAN DaepReadGfDPIAware(
+    _In_ PPH_PROCESS_ITEM ProcessItem,
+    _In_ HANDLE VmReadHandle,
+    _In_ BOOLEAN Refresh,
+    _Out_ PBOOLEAN GfDPIAware
+)
+{
+    ULONG_PTR curOffset;
+    PVOID user32Base;
+
+#ifdef _WIN64
+    if (ProcessItem->IsWow64)
+        curOffset = gfDPIAwareOffset32;
+    else
+#endif
+        curOffset = gfDPIAwareOffset;
+
+    if (!(user32Base = DaepGetUser32Base(ProcessItem, VmReadHandle, Refresh)))
+        return FALSE;
+
+    return NT_SUCCESS(NtReadVirtualMemory(
+        VmReadHandle,
+        PTR_ADD_OFFSET(user32Base, curOffset),
+        GfDPIAware,
+        sizeof(BOOLEAN),
+        NULL));
+}
+
+static ULONG DaepGetDpiAwareness(_In_ PPH_PROCESS_ITEM ProcessItem, _Inout_ PHANDLE VmReadHandle)
+{
+    ULONG dpiAwareness = DAE_DPI_AWARENESS_UNKNOWN;
+    if (getProcessDpiAwarenessInternal)
+    {
+        ULONG winDpiAwareness;
+        if (getProcessDpiAwarenessInternal(ProcessItem->QueryHandle, &winDpiAwareness))
+            dpiAwareness = winDpiAwareness + 1;
+    }
+    else
+    {
+        BOOLEAN gfDPIAware;
+
+#ifdef _WIN64
+        if (ProcessItem->IsWow64 ? !gfDPIAwareOffset32 : !gfDPIAwareOffset)
+#else
+        if (!gfDPIAwareOffset)
+#endif
+            return DAE_DPI_AWARENESS_UNKNOWN;
+
+        if (!*VmReadHandle)
+        {
+            if (!NT_SUCCESS(PhOpenProcess(VmReadHandle, PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_VM_READ, ProcessItem->ProcessId)))
+                return DAE_DPI_AWARENESS_UNKNOWN;
+        }
+        if (!DaepReadGfDPIAware(ProcessItem, *VmReadHandle, FALSE, &gfDPIAware) &&
+            !DaepReadGfDPIAware(ProcessItem, *VmReadHandle, TRUE, &gfDPIAware))
+            return DAE_DPI_AWARENESS_UNKNOWN;
+        dpiAwareness = !!gfDPIAware + 1;
+    }
+    return dpiAwareness;
+}
+
+static ULONG DaepGetDpiAwarenessForced(_In_ PDAE_PROBE_REQUEST Request, _Inout_ PHANDLE VmReadHandle)
+{
+    if (Request->NumberOfThreads == 0)
+        return DAE_TRIS_UNKNOWN;
+
+    if (!*VmReadHandle)
+    {
+        if (!NT_SUCCESS(PhOpenProcess(VmReadHandle, PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_VM_READ, Request->ProcessItem->ProcessId)))
+            return DAE_TRIS_UNKNOWN;
+    }
+
+    for (ULONG i = 0; i < Request->NumberOfThreads; i++)
+    {
+        ULONG ciFlags = 0;
+        if (!Request->TebBases[i])
+            continue;
+        if (!NT_SUCCESS(NtReadVirtualMemory(
+                *VmReadHandle,
+                PTR_ADD_OFFSET(Request->TebBases[i], CI_FLAGS_TEB_OFFSET),
+                &ciFlags,
+                sizeof(ciFlags),
+                NULL)))
+            continue;
+        if (ciFlags & CI_INITTHREAD)
+            return (ciFlags & CI_FORCEDPIAWARE) ? DAE_TRIS_TRUE : DAE_TRIS_FALSE;
+    }
+    return DAE_TRIS_UNKNOWN;
+}
+
+static VOID DaepProbe(_Inout_ PDAE_PROBE_REQUEST Request)
+{
+    HANDLE vmReadHandle = NULL;
+
+    if (Request->ProbeAwareness)
+        Request->DpiAwareness = DaepGetDpiAwareness(Request->ProcessItem, &vmReadHandle);
+    if (Request->ProbeForced)
+        Request->DpiAwarenessForced = DaepGetDpiAwarenessForced(Request, &vmReadHandle);
+
+    if (vmReadHandle)
+        NtClose(vmReadHandle);
+}
+
+static NTSTATUS DaepProberThreadStart(
+    _In_ PVOID Parameter
+)
+{
+    DaepInitDpiAwarenessValues(
+        (PVOID*)&getProcessDpiAwarenessInternal,
+#ifdef _WIN64
+        &gfDPIAwareOffset32,
+#endif
+        &gfDPIAwareOffset
+    );
+    DaepUser32BaseHashtable = PhCreateHashtable(
+        sizeof(DAE_USER32_BASE_ENTRY),
+        DaepUser32BaseEqualFunction,
+        DaepUser32BaseHashFunction,
+        4);
+
+    while (NT_SUCCESS(NtWaitForSingleObject(DaepProbeEvent, FALSE, NULL)))
+    {
+        while (TRUE)
+        {
+            PLIST_ENTRY listEntry;
+            PDAE_PROBE_REQUEST request;
+
+            PhAcquireQueuedLockExclusive(&DaepProbeListLock);
+            listEntry = RemoveHeadList(&DaepPendingProbeListHead);
+            PhReleaseQueuedLockExclusive(&DaepProbeListLock);
+
+            if (listEntry == &DaepPendingProbeListHead)
+                break;
+
+            request = CONTAINING_RECORD(listEntry, DAE_PROBE_REQUEST, ListEntry);
+            DaepProbe(request);
+
+            PhAcquireQueuedLockExclusive(&DaepProbeListLock);
+            InsertTailList(&DaepCompletedProbeListHead, &request->ListEntry);
+            PhReleaseQueuedLockExclusive(&DaepProbeListLock);
+        }
+    }
+
+    return STATUS_SUCCESS;
+}
+
+PDAE_PROBE_REQUEST DaeCreateProbeRequest(
+    _In_ PPH_PROCESS_ITEM ProcessItem,
+    _In_opt_ PSYSTEM_PROCESS_INFORMATION ProcessInfo,
+    _In_opt_ PVOID Context
+)
+{
+    PDAE_PROBE_REQUEST request;
+    ULONG numberOfThreads = ProcessInfo ? ProcessInfo->NumberOfThreads : 0;
+
+    request = PhAllocate(FIELD_OFFSET(DAE_PROBE_REQUEST, TebBases) + max(numberOfThreads, 1) * sizeof(PVOID));
+    memset(request, 0, FIELD_OFFSET(DAE_PROBE_REQUEST, TebBases));
+    PhReferenceObject(ProcessItem);
+    request->ProcessItem = ProcessItem;
+    request->Context = Context;
+    request->NumberOfThreads = numberOfThreads;
+
+    for (ULONG i = 0; i < numberOfThreads; i++)
+        request->TebBases[i] = ((PSYSTEM_EXTENDED_THREAD_INFORMATION)ProcessInfo->Threads + i)->TebBase;
+
+    return request;
+}
+
+VOID DaeFreeProbeRequest(
+    _In_ PDAE_PROBE_REQUEST Request
+)
+{
+    PhDereferenceObject(Request->ProcessItem);
+    PhFree(Request);
+}
+
+VOID DaeQueueProbeRequest(
+    _In_ PDAE_PROBE_REQUEST Request
+)
+{
+    static PH_INITONCE initOnce = PH_INITONCE_INIT;
+
+    if (PhBeginInitOnce(&initOnce))
+    {
+        if (NT_SUCCESS(NtCreateEvent(&DaepProbeEvent, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE)))
+            PhCreateThread2(DaepProberThreadStart, NULL);
+        PhEndInitOnce(&initOnce);
+    }
+
+    PhAcquireQueuedLockExclusive(&DaepProbeListLock);
+    InsertTailList(&DaepPendingProbeListHead, &Request->ListEntry);
+    PhReleaseQueuedLockExclusive(&DaepProbeListLock);
+
+    if (DaepProbeEvent)
+        NtSetEvent(DaepProbeEvent, NULL);
+}
+
+/*
+ * Moves the requests the prober has finished to ListHead. Returns FALSE if there
+ * are none.
+ */
+BOOLEAN DaeGetCompletedProbeRequests(
+    _Out_ PLIST_ENTRY ListHead
+)
+{
+    InitializeListHead(ListHead);
+
+    PhAcquireQueuedLockExclusive(&DaepProbeListLock);
+
+    if (!IsListEmpty(&DaepCompletedProbeListHead))
+    {
+        // Splice the whole list over.
+        ListHead->Flink = DaepCompletedProbeListHead.Flink;
+        ListHead->Blink = DaepCompletedProbeListHead.Blink;
+        ListHead->Flink->Blink = ListHead;
+        ListHead->Blink->Flink = ListHead;
+        InitializeListHead(&DaepCompletedProbeListHead);
+    }
+
+    PhReleaseQueuedLockExclusive(&DaepProbeListLock);
+
+    return !IsListEmpty(ListHead);
+}
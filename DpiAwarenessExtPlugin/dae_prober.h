@@ -0,0 +1,72 @@
+/*
+ * Process Hacker Extra Plugins -
+ *  DPI Awareness Extras Plugin
+ *
+ * Copyright (C) 2018 poizan42
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <phdk.h>
+
+#define DAE_DPI_AWARENESS_UNKNOWN 0
+#define DAE_DPI_AWARENESS_UNAWARE 1
+#define DAE_DPI_AWARENESS_SYSTEM 2
+#define DAE_DPI_AWARENESS_PER_MONITOR 3
+
+#define DAE_TRIS_UNKNOWN 0
+#define DAE_TRIS_FALSE 1
+#define DAE_TRIS_TRUE 2
+
+/*
+ * A request to read the DPI awareness of a process on the prober thread. The
+ * thread list is copied in when the request is created, since the process
+ * snapshot it comes from is freed as soon as the requests are queued.
+ */
+typedef struct _DAE_PROBE_REQUEST
+{
+    LIST_ENTRY ListEntry;
+    PPH_PROCESS_ITEM ProcessItem;
+    PVOID Context;
+
+    BOOLEAN ProbeAwareness;
+    BOOLEAN ProbeForced;
+    ULONG DpiAwareness;
+    ULONG DpiAwarenessForced;
+
+    ULONG NumberOfThreads;
+    PVOID TebBases[1];
+} DAE_PROBE_REQUEST, *PDAE_PROBE_REQUEST;
+
+PDAE_PROBE_REQUEST DaeCreateProbeRequest(
+    _In_ PPH_PROCESS_ITEM ProcessItem,
+    _In_opt_ PSYSTEM_PROCESS_INFORMATION ProcessInfo,
+    _In_opt_ PVOID Context
+);
+
+VOID DaeFreeProbeRequest(
+    _In_ PDAE_PROBE_REQUEST Request
+);
+
+VOID DaeQueueProbeRequest(
+    _In_ PDAE_PROBE_REQUEST Request
+);
+
+BOOLEAN DaeGetCompletedProbeRequests(
+    _Out_ PLIST_ENTRY ListHead
+);
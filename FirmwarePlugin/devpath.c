@@ -0,0 +1,99 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Firmware Plugin
+ *
+ * Copyright (C) 2016-2017 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <phdk.h>
+#include "dpdecode.h"
+#include "devpath.h"
+
+static VOID EfiAppendDecodedText(
+    _In_ PVOID Context,
+    _In_reads_(Count) const uint16_t *Text,
+    _In_ size_t Count
+    )
+{
+    PhAppendStringBuilderEx(Context, (PWCHAR)Text, Count * sizeof(WCHAR));
+}
+
+/**
+ * Appends the text form of a device path, e.g.
+ * "PciRoot(0x0)/Pci(0x1d,0x0)/NVMe(0x1,...)/HD(1,GPT,...)/\EFI\BOOT\BOOTX64.EFI".
+ *
+ * \param StringBuilder The string builder.
+ * \param DevicePath The device path. It may hold several instances.
+ * \param Length The size of \a DevicePath in bytes. Decoding stops at the end of
+ * the buffer even if there is no end node.
+ */
+VOID EfiAppendDevicePath(
+    _Inout_ PPH_STRING_BUILDER StringBuilder,
+    _In_reads_bytes_(Length) PVOID DevicePath,
+    _In_ ULONG Length
+    )
+{
+    EFI_DP_OUTPUT output;
+
+    output.Append = EfiAppendDecodedText;
+    output.Context = StringBuilder;
+
+    EfiDpDecodeDevicePath(&output, DevicePath, Length);
+}
+
+PPH_STRING EfiFormatDevicePath(
+    _In_reads_bytes_(Length) PVOID DevicePath,
+    _In_ ULONG Length
+    )
+{
+    PH_STRING_BUILDER sb;
+
+    PhInitializeStringBuilder(&sb, 0x100);
+    EfiAppendDevicePath(&sb, DevicePath, Length);
+
+    return PhFinalStringBuilderString(&sb);
+}
+
+/**
+ * Formats a load option as its description followed by its device path.
+ *
+ * \return A string, or NULL if the load option is malformed.
+ */
+PPH_STRING EfiFormatLoadOption(
+    _In_reads_bytes_(Length) PVOID Buffer,
+    _In_ ULONG Length
+    )
+{
+    EFI_DP_LOAD_OPTION loadOption;
+    PH_STRING_BUILDER sb;
+
+    if (!EfiDpParseLoadOption(Buffer, Length, &loadOption))
+        return NULL;
+
+    PhInitializeStringBuilder(&sb, 0x100);
+    PhAppendStringBuilderEx(&sb, (PWCHAR)loadOption.Description, loadOption.DescriptionLength);
+
+    if (loadOption.FilePathListLength != 0)
+    {
+        PhAppendStringBuilder2(&sb, L" (");
+        EfiAppendDevicePath(&sb, (PVOID)loadOption.FilePathList, (ULONG)loadOption.FilePathListLength);
+        PhAppendCharStringBuilder(&sb, L')');
+    }
+
+    return PhFinalStringBuilderString(&sb);
+}
@@ -0,0 +1,46 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Firmware Plugin
+ *
+ * Copyright (C) 2016-2017 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DEVPATH_H
+#define _DEVPATH_H
+
+// Decoding of EFI device paths and load options into phlib strings. Values come
+// straight from NVRAM and are not trusted; the byte-level decoder in dpdecode.c
+// checks every read against the buffer length and does not modify the buffer.
+
+VOID EfiAppendDevicePath(
+    _Inout_ PPH_STRING_BUILDER StringBuilder,
+    _In_reads_bytes_(Length) PVOID DevicePath,
+    _In_ ULONG Length
+    );
+
+PPH_STRING EfiFormatDevicePath(
+    _In_reads_bytes_(Length) PVOID DevicePath,
+    _In_ ULONG Length
+    );
+
+PPH_STRING EfiFormatLoadOption(
+    _In_reads_bytes_(Length) PVOID Buffer,
+    _In_ ULONG Length
+    );
+
+#endif
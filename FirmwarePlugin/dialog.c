@@ -21,144 +21,6 @@
  */
 
 #include "main.h"
-#include "efi_guid_list.h"
-
-PPH_STRING FirmwareAttributeToString(
-    _In_ ULONG Attribute
-    )
-{
-    PH_STRING_BUILDER sb;
-
-    PhInitializeStringBuilder(&sb, 0x100);
-
-    if (Attribute & EFI_VARIABLE_NON_VOLATILE)
-        PhAppendStringBuilder2(&sb, L"Non Volatile, ");
-
-    if (Attribute & EFI_VARIABLE_BOOTSERVICE_ACCESS)
-        PhAppendStringBuilder2(&sb, L"Boot Service, ");
-
-    if (Attribute & EFI_VARIABLE_RUNTIME_ACCESS)
-        PhAppendStringBuilder2(&sb, L"Runtime Access, ");
-
-    if (Attribute & EFI_VARIABLE_HARDWARE_ERROR_RECORD)
-        PhAppendStringBuilder2(&sb, L"Hardware Error Record, ");
-
-    if (Attribute & EFI_VARIABLE_AUTHENTICATED_WRITE_ACCESS)
-        PhAppendStringBuilder2(&sb, L"Authenticated Write Access, ");
-
-    if (Attribute & EFI_VARIABLE_TIME_BASED_AUTHENTICATED_WRITE_ACCESS)
-        PhAppendStringBuilder2(&sb, L"Authenticated Write Access (Time Based), ");
-
-    if (Attribute & EFI_VARIABLE_APPEND_WRITE)
-        PhAppendStringBuilder2(&sb, L"Append Write, ");
-
-    if (PhEndsWithStringRef2(&sb.String->sr, L", ", FALSE))
-        PhRemoveEndStringBuilder(&sb, 2);
-
-    return PhFinalStringBuilderString(&sb);
-}
-
-PWSTR FirmwareGuidToNameString(
-    _In_ PGUID VendorGuid
-    )
-{
-    for (ULONG i = 0; i < ARRAYSIZE(table); i++)
-    {
-        if (IsEqualGUID(VendorGuid, &table[i].Guid))
-            return table[i].Name;
-    }
-
-    return L"";
-}
-
-VOID FreeListViewFirmwareEntries(
-    _In_ PUEFI_WINDOW_CONTEXT Context
-    )
-{
-    ULONG index = -1;
-
-    while ((index = PhFindListViewItemByFlags(
-        Context->ListViewHandle,
-        index,
-        LVNI_ALL
-        )) != -1)
-    {
-        PEFI_ENTRY param;
-
-        if (PhGetListViewItemParam(Context->ListViewHandle, index, &param))
-        {
-            PhClearReference(&param->Name);
-            PhClearReference(&param->GuidString);
-            PhFree(param);
-        }
-    }
-}
-
-NTSTATUS EnumerateFirmwareEntries(
-    _In_ PUEFI_WINDOW_CONTEXT Context
-    )
-{
-    NTSTATUS status;
-    PVOID variables;
-
-    ExtendedListView_SetRedraw(Context->ListViewHandle, FALSE);
-    FreeListViewFirmwareEntries(Context);
-    ListView_DeleteAllItems(Context->ListViewHandle);
-
-    if (NT_SUCCESS(status = EnumerateFirmwareValues(&variables)))
-    {
-        PVARIABLE_NAME_AND_VALUE i;
-
-        for (i = PH_FIRST_EFI_VARIABLE(variables); i; i = PH_NEXT_EFI_VARIABLE(i))
-        {       
-            INT index;
-            PEFI_ENTRY entry;
-            
-            entry = PhAllocate(sizeof(EFI_ENTRY));
-            entry->Length = i->ValueLength;
-            entry->Name = PhCreateString(i->Name);
-            entry->GuidString = PhFormatGuid(&i->VendorGuid);
-            
-            index = PhAddListViewItem(
-                Context->ListViewHandle,
-                MAXINT,
-                PhGetStringOrEmpty(entry->Name),
-                entry
-                );
-            PhSetListViewSubItem(
-                Context->ListViewHandle,
-                index,
-                1,
-                FirmwareAttributeToString(i->Attributes)->Buffer
-                );
-            PhSetListViewSubItem(
-                Context->ListViewHandle,
-                index,
-                2,
-                FirmwareGuidToNameString(&i->VendorGuid)
-                );
-            PhSetListViewSubItem(
-                Context->ListViewHandle,
-                index,
-                3,
-                PhGetStringOrEmpty(entry->GuidString)
-                );
-            PhSetListViewSubItem(
-                Context->ListViewHandle,
-                index,
-                4, 
-                PhaFormatSize(entry->Length, -1)->Buffer
-                );
-        }
-
-        PhFree(variables);
-    }
-
-    ExtendedListView_SortItems(Context->ListViewHandle);
-    ExtendedListView_SetRedraw(Context->ListViewHandle, TRUE);
-
-    return status;
-}
 
 PPH_STRING PhGetSelectedListViewItemText(
     _In_ HWND hWnd
@@ -201,30 +63,6 @@ VOID ShowBootEntryMenu(
     }
 }
 
-INT NTAPI FirmwareNameCompareFunction(
-    _In_ PVOID Item1,
-    _In_ PVOID Item2,
-    _In_opt_ PVOID Context
-    )
-{
-    PEFI_ENTRY item1 = Item1;
-    PEFI_ENTRY item2 = Item2;
-
-    return PhCompareStringZ(PhGetStringOrEmpty(item1->Name), PhGetStringOrEmpty(item2->Name), TRUE);
-}
-
-INT NTAPI FirmwareEntryLengthCompareFunction(
-    _In_ PVOID Item1,
-    _In_ PVOID Item2,
-    _In_opt_ PVOID Context
-    )
-{
-    PEFI_ENTRY item1 = Item1;
-    PEFI_ENTRY item2 = Item2;
-
-    return uintcmp(item1->Length, item2->Length);
-}
-
 INT_PTR CALLBACK UefiEntriesDlgProc(
     _In_ HWND hwndDlg,
     _In_ UINT uMsg,
@@ -247,7 +85,13 @@ INT_PTR CALLBACK UefiEntriesDlgProc(
 
         if (uMsg == WM_DESTROY)
         {
-            FreeListViewFirmwareEntries(context);
+            MSG message;
+
+            while (PeekMessage(&message, hwndDlg, WM_FIRMWARE_DETAILS_COMPLETE, WM_FIRMWARE_DETAILS_COMPLETE, PM_REMOVE))
+                DestroyFirmwareDetailsRequest((PEFI_DETAILS_REQUEST)message.lParam);
+
+            FreeFirmwareEntries(context);
+            PhDereferenceObject(context->PendingDetails);
 
             PhSaveListViewColumnsToSetting(SETTING_NAME_LISTVIEW_COLUMNS, context->ListViewHandle);
             PhSaveWindowPlacementToSetting(SETTING_NAME_WINDOW_POSITION, SETTING_NAME_WINDOW_SIZE, hwndDlg);
@@ -279,33 +123,49 @@ INT_PTR CALLBACK UefiEntriesDlgProc(
             PhAddListViewColumn(context->ListViewHandle, 2, 2, 2, LVCFMT_LEFT, 140, L"Guid Name");
             PhAddListViewColumn(context->ListViewHandle, 3, 3, 3, LVCFMT_LEFT, 140, L"Guid");
             PhAddListViewColumn(context->ListViewHandle, 4, 4, 4, LVCFMT_LEFT, 50, L"Data Length");
-            PhSetExtendedListView(context->ListViewHandle);
-
-            //ExtendedListView_SetSortFast(context->ListViewHandle, TRUE);
-            ExtendedListView_SetCompareFunction(context->ListViewHandle, 0, FirmwareNameCompareFunction);
-            ExtendedListView_SetCompareFunction(context->ListViewHandle, 1, FirmwareNameCompareFunction);
-            ExtendedListView_SetCompareFunction(context->ListViewHandle, 4, FirmwareEntryLengthCompareFunction);
+            PhAddListViewColumn(context->ListViewHandle, 5, 5, 5, LVCFMT_LEFT, 70, L"Hash");
+            PhAddListViewColumn(context->ListViewHandle, 6, 6, 6, LVCFMT_LEFT, 200, L"Summary");
             PhLoadListViewColumnsFromSetting(SETTING_NAME_LISTVIEW_COLUMNS, context->ListViewHandle);
 
+            context->SortColumn = 0;
+            context->SortOrder = AscendingSortOrder;
+            context->PendingDetails = PhCreateList(32);
+            PhSetHeaderSortIcon(ListView_GetHeader(context->ListViewHandle), context->SortColumn, context->SortOrder);
+
             PhInitializeLayoutManager(&context->LayoutManager, hwndDlg);
             PhAddLayoutItem(&context->LayoutManager, context->ListViewHandle, NULL, PH_ANCHOR_ALL);
             PhAddLayoutItem(&context->LayoutManager, GetDlgItem(hwndDlg, IDC_BOOT_REFRESH), NULL, PH_ANCHOR_BOTTOM | PH_ANCHOR_LEFT);
             PhAddLayoutItem(&context->LayoutManager, GetDlgItem(hwndDlg, IDOK), NULL, PH_ANCHOR_BOTTOM | PH_ANCHOR_RIGHT);
             PhLoadWindowPlacementFromSetting(SETTING_NAME_WINDOW_POSITION, SETTING_NAME_WINDOW_SIZE, hwndDlg);
             
-            EnumerateFirmwareEntries(context);
+            RefreshFirmwareEntries(context);
         }
         break;
     case WM_SIZE:
         PhLayoutManagerLayout(&context->LayoutManager);
         break;
+    case WM_FIRMWARE_FLUSH_DETAILS:
+        {
+            context->DetailsFlushPosted = FALSE;
+            FlushFirmwareEntryDetails(context, hwndDlg);
+        }
+        break;
+    case WM_FIRMWARE_DETAILS_COMPLETE:
+        {
+            PEFI_DETAILS_REQUEST request = (PEFI_DETAILS_REQUEST)lParam;
+
+            ApplyFirmwareEntryDetails(context, request);
+            DestroyFirmwareDetailsRequest(request);
+            InvalidateRect(context->ListViewHandle, NULL, FALSE);
+        }
+        break;
     case WM_COMMAND:
         {
             switch (LOWORD(wParam))
             {
             case IDC_BOOT_REFRESH:
                 {
-                    EnumerateFirmwareEntries(context);
+                    RefreshFirmwareEntries(context);
                 }
                 break;
             case IDCANCEL:
@@ -333,15 +193,107 @@ INT_PTR CALLBACK UefiEntriesDlgProc(
                 {
                     if (hdr->hwndFrom == context->ListViewHandle)
                     {
-                        PEFI_ENTRY entry;
+                        INT row = ListView_GetNextItem(context->ListViewHandle, -1, LVNI_SELECTED);
+
+                        if (row != -1 && (ULONG)row < context->EntryCount)
+                        {
+                            ShowUefiEditorDialog(&context->Entries[context->EntryOrder[row]]);
+                        }
+                    }
+                }
+                break;
+            case LVN_GETDISPINFO:
+                {
+                    NMLVDISPINFO* dispInfo = (NMLVDISPINFO*)hdr;
+                    PEFI_ENTRY entry;
+                    ULONG index;
+
+                    if ((ULONG)dispInfo->item.iItem >= context->EntryCount)
+                        break;
+
+                    index = context->EntryOrder[dispInfo->item.iItem];
+                    entry = &context->Entries[index];
+
+                    if (dispInfo->item.mask & LVIF_TEXT)
+                    {
+                        PWSTR text = NULL;
 
-                        if (entry = PhGetSelectedListViewItemParam(context->ListViewHandle))
+                        switch (dispInfo->item.iSubItem)
                         {
-                            ShowUefiEditorDialog(entry);
+                        case 0:
+                            text = entry->Name.Buffer;
+                            break;
+                        case 1:
+                            text = FirmwareAttributeToString(entry->Variable->Attributes)->Buffer;
+                            break;
+                        case 2:
+                            text = entry->GuidName;
+                            break;
+                        case 3:
+                            {
+                                if (!entry->GuidString)
+                                    entry->GuidString = PhFormatGuid(&entry->Variable->VendorGuid);
+
+                                text = entry->GuidString->Buffer;
+                            }
+                            break;
+                        case 4:
+                            {
+                                if (!entry->SizeString)
+                                    entry->SizeString = PhFormatSize(entry->Variable->ValueLength, -1);
+
+                                text = entry->SizeString->Buffer;
+                            }
+                            break;
+                        case 5:
+                        case 6:
+                            {
+                                // Only rows that are drawn are hashed; requests are batched
+                                // until the list has finished painting.
+                                if (!entry->DetailsQueued)
+                                {
+                                    QueueFirmwareEntryDetails(context, index);
+
+                                    if (!context->DetailsFlushPosted)
+                                    {
+                                        context->DetailsFlushPosted = TRUE;
+                                        PostMessage(hwndDlg, WM_FIRMWARE_FLUSH_DETAILS, 0, 0);
+                                    }
+                                }
+
+                                text = PhGetString(dispInfo->item.iSubItem == 5 ? entry->HashString : entry->Summary);
+                            }
+                            break;
                         }
+
+                        wcsncpy_s(
+                            dispInfo->item.pszText,
+                            dispInfo->item.cchTextMax,
+                            text ? text : L"",
+                            _TRUNCATE
+                            );
                     }
                 }
                 break;
+            case LVN_COLUMNCLICK:
+                {
+                    LPNMLISTVIEW listView = (LPNMLISTVIEW)hdr;
+
+                    if ((ULONG)listView->iSubItem == context->SortColumn)
+                    {
+                        context->SortOrder = context->SortOrder == AscendingSortOrder ? DescendingSortOrder : AscendingSortOrder;
+                    }
+                    else
+                    {
+                        context->SortColumn = listView->iSubItem;
+                        context->SortOrder = AscendingSortOrder;
+                    }
+
+                    PhSetHeaderSortIcon(ListView_GetHeader(context->ListViewHandle), context->SortColumn, context->SortOrder);
+                    SortFirmwareEntries(context);
+                    InvalidateRect(context->ListViewHandle, NULL, FALSE);
+                }
+                break;
             }
         }
         break;
@@ -0,0 +1,815 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Firmware Plugin
+ *
+ * Copyright (C) 2016-2017 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "Efi/EfiTypes.h"
+#ifndef ANYSIZE_ARRAY
+#define ANYSIZE_ARRAY 1
+#endif
+#include "Efi/EfiDevicePath.h"
+#include "dpdecode.h"
+
+// Newer messaging node types that Efi\EfiDevicePath.h predates.
+#define MSG_NVME_NAMESPACE_DP 0x17
+#define MSG_URI_DP 0x18
+
+// Limit on the data shown for nodes that are not decoded.
+#define EFI_DEVICE_PATH_MAX_RAW_DATA 64
+
+#define EFI_DP_HEADER_SIZE sizeof(EFI_DEVICE_PATH_PROTOCOL)
+
+#pragma pack(push, 1)
+
+typedef struct _EFI_LOAD_OPTION_HEADER
+{
+    uint32_t Attributes;
+    uint16_t FilePathListLength;
+    // CHAR16 Description[];
+    // EFI_DEVICE_PATH_PROTOCOL FilePathList[];
+    // UINT8 OptionalData[];
+} EFI_LOAD_OPTION_HEADER, *PEFI_LOAD_OPTION_HEADER;
+
+#pragma pack(pop)
+
+// A device path node. Field offsets used by the formatters include the 4 byte
+// header, as in the UEFI specification, and are always below MinimumLength.
+typedef struct _EFI_DP_NODE
+{
+    const uint8_t *Buffer;
+    size_t Length;
+} EFI_DP_NODE, *PEFI_DP_NODE;
+
+typedef const struct _EFI_DP_NODE_TYPE *PEFI_DP_NODE_TYPE;
+
+typedef void (*PEFI_DP_FORMAT_FUNCTION)(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    );
+
+typedef struct _EFI_DP_NODE_TYPE
+{
+    uint8_t Type;
+    uint8_t SubType;
+    uint16_t MinimumLength;
+    const char *Name;
+    PEFI_DP_FORMAT_FUNCTION Format;
+} EFI_DP_NODE_TYPE;
+
+static uint8_t EfiDpReadUInt8(
+    PEFI_DP_NODE Node,
+    size_t Offset
+    )
+{
+    return Node->Buffer[Offset];
+}
+
+static uint16_t EfiDpReadUInt16(
+    PEFI_DP_NODE Node,
+    size_t Offset
+    )
+{
+    uint16_t value;
+
+    memcpy(&value, Node->Buffer + Offset, sizeof(uint16_t));
+
+    return value;
+}
+
+static uint32_t EfiDpReadUInt32(
+    PEFI_DP_NODE Node,
+    size_t Offset
+    )
+{
+    uint32_t value;
+
+    memcpy(&value, Node->Buffer + Offset, sizeof(uint32_t));
+
+    return value;
+}
+
+static uint64_t EfiDpReadUInt64(
+    PEFI_DP_NODE Node,
+    size_t Offset
+    )
+{
+    uint64_t value;
+
+    memcpy(&value, Node->Buffer + Offset, sizeof(uint64_t));
+
+    return value;
+}
+
+static void EfiDpAppendChar(
+    PEFI_DP_OUTPUT Output,
+    uint16_t Character
+    )
+{
+    Output->Append(Output->Context, &Character, 1);
+}
+
+// ASCII text only; used for names and fixed parts of the output.
+static void EfiDpAppendText(
+    PEFI_DP_OUTPUT Output,
+    const char *Text
+    )
+{
+    uint16_t buffer[128];
+    size_t count = 0;
+
+    while (Text[count] && count < sizeof(buffer) / sizeof(buffer[0]))
+    {
+        buffer[count] = (uint8_t)Text[count];
+        count++;
+    }
+
+    Output->Append(Output->Context, buffer, count);
+}
+
+static void EfiDpPrint(
+    PEFI_DP_OUTPUT Output,
+    const char *Format,
+    ...
+    )
+{
+    char text[128];
+    va_list argptr;
+
+    va_start(argptr, Format);
+
+    if (vsnprintf(text, sizeof(text), Format, argptr) > 0)
+        EfiDpAppendText(Output, text);
+
+    va_end(argptr);
+}
+
+static void EfiDpAppendGuid(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE Node,
+    size_t Offset
+    )
+{
+    const uint8_t *bytes = Node->Buffer + Offset;
+
+    EfiDpPrint(
+        Output,
+        "%08x-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+        EfiDpReadUInt32(Node, Offset),
+        EfiDpReadUInt16(Node, Offset + 4),
+        EfiDpReadUInt16(Node, Offset + 6),
+        bytes[8], bytes[9], bytes[10], bytes[11], bytes[12], bytes[13], bytes[14], bytes[15]
+        );
+}
+
+static void EfiDpAppendHex(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE Node,
+    size_t Offset,
+    size_t Length
+    )
+{
+    size_t count = Length < EFI_DEVICE_PATH_MAX_RAW_DATA ? Length : EFI_DEVICE_PATH_MAX_RAW_DATA;
+
+    for (size_t i = 0; i < count; i++)
+        EfiDpPrint(Output, "%02x", Node->Buffer[Offset + i]);
+
+    if (count < Length)
+        EfiDpAppendText(Output, "...");
+}
+
+static void EfiDpAppendAnsiText(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE Node,
+    size_t Offset,
+    size_t Length
+    )
+{
+    for (size_t i = 0; i < Length; i++)
+    {
+        uint8_t character = Node->Buffer[Offset + i];
+
+        if (character == 0)
+            break;
+
+        EfiDpAppendChar(Output, character >= ' ' && character < 0x7f ? character : '?');
+    }
+}
+
+static void EfiDpAppendUnicodeText(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE Node,
+    size_t Offset,
+    size_t Length
+    )
+{
+    for (size_t i = 0; i + sizeof(uint16_t) <= Length; i += sizeof(uint16_t))
+    {
+        uint16_t character = EfiDpReadUInt16(Node, Offset + i);
+
+        if (character == 0)
+            break;
+
+        EfiDpAppendChar(Output, character);
+    }
+}
+
+static void EfiDpFormatRawNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpPrint(Output, "Path(%u,%u,", EfiDpReadUInt8(Node, 0), EfiDpReadUInt8(Node, 1));
+    EfiDpAppendHex(Output, Node, EFI_DP_HEADER_SIZE, Node->Length - EFI_DP_HEADER_SIZE);
+    EfiDpAppendChar(Output, ')');
+}
+
+static void EfiDpFormatPciNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpPrint(Output, "Pci(0x%x,0x%x)", EfiDpReadUInt8(Node, 5), EfiDpReadUInt8(Node, 4));
+}
+
+static void EfiDpFormatVendorNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpAppendText(Output, NodeType->Name);
+    EfiDpAppendChar(Output, '(');
+    EfiDpAppendGuid(Output, Node, 4);
+
+    if (Node->Length > 20)
+    {
+        EfiDpAppendChar(Output, ',');
+        EfiDpAppendHex(Output, Node, 20, Node->Length - 20);
+    }
+
+    EfiDpAppendChar(Output, ')');
+}
+
+static void EfiDpFormatGuidNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpAppendText(Output, NodeType->Name);
+    EfiDpAppendChar(Output, '(');
+    EfiDpAppendGuid(Output, Node, 4);
+    EfiDpAppendChar(Output, ')');
+}
+
+static void EfiDpFormatUInt32Node(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpPrint(Output, "%s(0x%x)", NodeType->Name, EfiDpReadUInt32(Node, 4));
+}
+
+static void EfiDpFormatAcpiNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    uint32_t hid = EfiDpReadUInt32(Node, 4);
+    uint32_t uid = EfiDpReadUInt32(Node, 8);
+
+    // Compressed EISA IDs keep "PNP" in the low word.
+    if ((hid & 0xffff) == 0x41d0)
+    {
+        switch (hid >> 16)
+        {
+        case 0x0a03:
+            EfiDpPrint(Output, "PciRoot(0x%x)", uid);
+            return;
+        case 0x0a08:
+            EfiDpPrint(Output, "PcieRoot(0x%x)", uid);
+            return;
+        }
+
+        EfiDpPrint(Output, "Acpi(PNP%04x,0x%x)", hid >> 16, uid);
+    }
+    else
+    {
+        EfiDpPrint(Output, "Acpi(0x%08x,0x%x)", hid, uid);
+    }
+}
+
+static void EfiDpFormatAcpiExtendedNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpPrint(
+        Output,
+        "AcpiEx(0x%08x,0x%08x,0x%x)",
+        EfiDpReadUInt32(Node, 4),
+        EfiDpReadUInt32(Node, 12),
+        EfiDpReadUInt32(Node, 8)
+        );
+}
+
+static void EfiDpFormatAtapiNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpPrint(
+        Output,
+        "Ata(%s,%s,0x%x)",
+        EfiDpReadUInt8(Node, 4) ? "Secondary" : "Primary",
+        EfiDpReadUInt8(Node, 5) ? "Slave" : "Master",
+        EfiDpReadUInt16(Node, 6)
+        );
+}
+
+static void EfiDpFormatScsiNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpPrint(Output, "Scsi(0x%x,0x%x)", EfiDpReadUInt16(Node, 4), EfiDpReadUInt16(Node, 6));
+}
+
+static void EfiDpFormatFibreChannelNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpPrint(Output, "Fibre(0x%" PRIx64 ",0x%" PRIx64 ")", EfiDpReadUInt64(Node, 8), EfiDpReadUInt64(Node, 16));
+}
+
+static void EfiDpFormat1394Node(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpPrint(Output, "I1394(0x%" PRIx64 ")", EfiDpReadUInt64(Node, 8));
+}
+
+static void EfiDpFormatUsbNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpPrint(Output, "USB(0x%x,0x%x)", EfiDpReadUInt8(Node, 4), EfiDpReadUInt8(Node, 5));
+}
+
+static void EfiDpFormatUsbClassNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpPrint(
+        Output,
+        "UsbClass(0x%x,0x%x,0x%x,0x%x,0x%x)",
+        EfiDpReadUInt16(Node, 4),
+        EfiDpReadUInt16(Node, 6),
+        EfiDpReadUInt8(Node, 8),
+        EfiDpReadUInt8(Node, 9),
+        EfiDpReadUInt8(Node, 10)
+        );
+}
+
+static void EfiDpFormatUsbWwidNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpPrint(
+        Output,
+        "UsbWwid(0x%x,0x%x,0x%x,\"",
+        EfiDpReadUInt16(Node, 6),
+        EfiDpReadUInt16(Node, 8),
+        EfiDpReadUInt16(Node, 4)
+        );
+    EfiDpAppendUnicodeText(Output, Node, 10, Node->Length - 10);
+    EfiDpAppendText(Output, "\")");
+}
+
+static void EfiDpFormatUInt8Node(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpPrint(Output, "%s(0x%x)", NodeType->Name, EfiDpReadUInt8(Node, 4));
+}
+
+static void EfiDpFormatSataNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpPrint(
+        Output,
+        "Sata(0x%x,0x%x,0x%x)",
+        EfiDpReadUInt16(Node, 4),
+        EfiDpReadUInt16(Node, 6),
+        EfiDpReadUInt16(Node, 8)
+        );
+}
+
+static void EfiDpFormatMacAddressNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    uint8_t interfaceType = EfiDpReadUInt8(Node, 36);
+
+    // Ethernet (0) and 802.3 (1) addresses are 6 bytes; the field is padded to 32.
+    EfiDpAppendText(Output, "MAC(");
+    EfiDpAppendHex(Output, Node, 4, interfaceType <= 1 ? 6 : 32);
+    EfiDpPrint(Output, ",0x%x)", interfaceType);
+}
+
+static void EfiDpFormatIpv4Node(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    const uint8_t *local = Node->Buffer + 4;
+    const uint8_t *remote = Node->Buffer + 8;
+
+    EfiDpPrint(
+        Output,
+        "IPv4(%u.%u.%u.%u:%u,%s,%u.%u.%u.%u:%u)",
+        remote[0], remote[1], remote[2], remote[3], EfiDpReadUInt16(Node, 14),
+        EfiDpReadUInt8(Node, 18) ? "Static" : "DHCP",
+        local[0], local[1], local[2], local[3], EfiDpReadUInt16(Node, 12)
+        );
+}
+
+static void EfiDpAppendIpv6Address(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE Node,
+    size_t Offset
+    )
+{
+    EfiDpAppendChar(Output, '[');
+
+    for (uint32_t i = 0; i < 16; i += 2)
+    {
+        if (i != 0)
+            EfiDpAppendChar(Output, ':');
+
+        EfiDpPrint(Output, "%x", (Node->Buffer[Offset + i] << 8) | Node->Buffer[Offset + i + 1]);
+    }
+
+    EfiDpAppendChar(Output, ']');
+}
+
+static void EfiDpFormatIpv6Node(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpAppendText(Output, "IPv6(");
+    EfiDpAppendIpv6Address(Output, Node, 20);
+    EfiDpPrint(Output, ":%u,", EfiDpReadUInt16(Node, 38));
+    EfiDpAppendIpv6Address(Output, Node, 4);
+    EfiDpPrint(Output, ":%u)", EfiDpReadUInt16(Node, 36));
+}
+
+static void EfiDpFormatUartNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    static const char parityCharacters[] = "DNEOMS";
+    uint8_t parity = EfiDpReadUInt8(Node, 17);
+
+    EfiDpPrint(
+        Output,
+        "Uart(%" PRIu64 ",%u,%c,%u)",
+        EfiDpReadUInt64(Node, 8),
+        EfiDpReadUInt8(Node, 16),
+        parity < sizeof(parityCharacters) - 1 ? parityCharacters[parity] : '?',
+        EfiDpReadUInt8(Node, 18)
+        );
+}
+
+static void EfiDpFormatIscsiNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpAppendText(Output, "iSCSI(");
+    EfiDpAppendAnsiText(Output, Node, 18, Node->Length - 18);
+    EfiDpPrint(Output, ",0x%x,0x%" PRIx64 ")", EfiDpReadUInt16(Node, 16), EfiDpReadUInt64(Node, 8));
+}
+
+static void EfiDpFormatNvmeNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    const uint8_t *eui = Node->Buffer + 8;
+
+    EfiDpPrint(
+        Output,
+        "NVMe(0x%x,%02x-%02x-%02x-%02x-%02x-%02x-%02x-%02x)",
+        EfiDpReadUInt32(Node, 4),
+        eui[0], eui[1], eui[2], eui[3], eui[4], eui[5], eui[6], eui[7]
+        );
+}
+
+static void EfiDpFormatUriNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpAppendText(Output, "Uri(");
+    EfiDpAppendAnsiText(Output, Node, 4, Node->Length - 4);
+    EfiDpAppendChar(Output, ')');
+}
+
+static void EfiDpFormatHardDriveNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpPrint(Output, "HD(%u,", EfiDpReadUInt32(Node, 4));
+
+    switch (EfiDpReadUInt8(Node, 41))
+    {
+    case SIGNATURE_TYPE_MBR:
+        EfiDpPrint(Output, "MBR,0x%08x", EfiDpReadUInt32(Node, 24));
+        break;
+    case SIGNATURE_TYPE_GUID:
+        EfiDpAppendText(Output, "GPT,");
+        EfiDpAppendGuid(Output, Node, 24);
+        break;
+    default:
+        EfiDpPrint(Output, "%u,0", EfiDpReadUInt8(Node, 41));
+        break;
+    }
+
+    EfiDpPrint(Output, ",0x%" PRIx64 ",0x%" PRIx64 ")", EfiDpReadUInt64(Node, 8), EfiDpReadUInt64(Node, 16));
+}
+
+static void EfiDpFormatCdromNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpPrint(
+        Output,
+        "CDROM(0x%x,0x%" PRIx64 ",0x%" PRIx64 ")",
+        EfiDpReadUInt32(Node, 4),
+        EfiDpReadUInt64(Node, 8),
+        EfiDpReadUInt64(Node, 16)
+        );
+}
+
+static void EfiDpFormatFilePathNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpAppendUnicodeText(Output, Node, 4, Node->Length - 4);
+}
+
+static void EfiDpFormatOffsetNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpPrint(Output, "Offset(0x%" PRIx64 ",0x%" PRIx64 ")", EfiDpReadUInt64(Node, 8), EfiDpReadUInt64(Node, 16));
+}
+
+static void EfiDpFormatBbsNode(
+    PEFI_DP_OUTPUT Output,
+    PEFI_DP_NODE_TYPE NodeType,
+    PEFI_DP_NODE Node
+    )
+{
+    EfiDpPrint(Output, "BBS(0x%x,\"", EfiDpReadUInt16(Node, 4));
+    EfiDpAppendAnsiText(Output, Node, 8, Node->Length - 8);
+    EfiDpPrint(Output, "\",0x%x)", EfiDpReadUInt16(Node, 6));
+}
+
+static const EFI_DP_NODE_TYPE EfiDevicePathNodeTypes[] =
+{
+    { HARDWARE_DEVICE_PATH, HW_PCI_DP, 6, "Pci", EfiDpFormatPciNode },
+    { HARDWARE_DEVICE_PATH, HW_PCCARD_DP, 5, "PcCard", EfiDpFormatUInt8Node },
+    { HARDWARE_DEVICE_PATH, HW_MEMMAP_DP, 24, "MemoryMapped", EfiDpFormatOffsetNode },
+    { HARDWARE_DEVICE_PATH, HW_VENDOR_DP, 20, "VenHw", EfiDpFormatVendorNode },
+    { HARDWARE_DEVICE_PATH, HW_CONTROLLER_DP, 8, "Ctrl", EfiDpFormatUInt32Node },
+    { ACPI_DEVICE_PATH, ACPI_DP, 12, "Acpi", EfiDpFormatAcpiNode },
+    { ACPI_DEVICE_PATH, ACPI_EXTENDED_DP, 16, "AcpiEx", EfiDpFormatAcpiExtendedNode },
+    { ACPI_DEVICE_PATH, ACPI_ADR_DP, 8, "AcpiAdr", EfiDpFormatUInt32Node },
+    { MESSAGING_DEVICE_PATH, MSG_ATAPI_DP, 8, "Ata", EfiDpFormatAtapiNode },
+    { MESSAGING_DEVICE_PATH, MSG_SCSI_DP, 8, "Scsi", EfiDpFormatScsiNode },
+    { MESSAGING_DEVICE_PATH, MSG_FIBRECHANNEL_DP, 24, "Fibre", EfiDpFormatFibreChannelNode },
+    { MESSAGING_DEVICE_PATH, MSG_1394_DP, 16, "I1394", EfiDpFormat1394Node },
+    { MESSAGING_DEVICE_PATH, MSG_USB_DP, 6, "USB", EfiDpFormatUsbNode },
+    { MESSAGING_DEVICE_PATH, MSG_I2O_DP, 8, "I2O", EfiDpFormatUInt32Node },
+    { MESSAGING_DEVICE_PATH, MSG_INFINIBAND_DP, 4, "Infiniband", EfiDpFormatRawNode },
+    { MESSAGING_DEVICE_PATH, MSG_VENDOR_DP, 20, "VenMsg", EfiDpFormatVendorNode },
+    { MESSAGING_DEVICE_PATH, MSG_MAC_ADDR_DP, 37, "MAC", EfiDpFormatMacAddressNode },
+    { MESSAGING_DEVICE_PATH, MSG_IPv4_DP, 19, "IPv4", EfiDpFormatIpv4Node },
+    { MESSAGING_DEVICE_PATH, MSG_IPv6_DP, 40, "IPv6", EfiDpFormatIpv6Node },
+    { MESSAGING_DEVICE_PATH, MSG_UART_DP, 19, "Uart", EfiDpFormatUartNode },
+    { MESSAGING_DEVICE_PATH, MSG_USB_CLASS_DP, 11, "UsbClass", EfiDpFormatUsbClassNode },
+    { MESSAGING_DEVICE_PATH, MSG_USB_WWID_DP, 10, "UsbWwid", EfiDpFormatUsbWwidNode },
+    { MESSAGING_DEVICE_PATH, MSG_DEVICE_LOGICAL_UNIT_DP, 5, "Unit", EfiDpFormatUInt8Node },
+    { MESSAGING_DEVICE_PATH, MSG_SATA_DP, 10, "Sata", EfiDpFormatSataNode },
+    { MESSAGING_DEVICE_PATH, MSG_ISCSI_DP, 18, "iSCSI", EfiDpFormatIscsiNode },
+    { MESSAGING_DEVICE_PATH, MSG_NVME_NAMESPACE_DP, 16, "NVMe", EfiDpFormatNvmeNode },
+    { MESSAGING_DEVICE_PATH, MSG_URI_DP, 4, "Uri", EfiDpFormatUriNode },
+    { MEDIA_DEVICE_PATH, MEDIA_HARDDRIVE_DP, 42, "HD", EfiDpFormatHardDriveNode },
+    { MEDIA_DEVICE_PATH, MEDIA_CDROM_DP, 24, "CDROM", EfiDpFormatCdromNode },
+    { MEDIA_DEVICE_PATH, MEDIA_VENDOR_DP, 20, "VenMedia", EfiDpFormatVendorNode },
+    { MEDIA_DEVICE_PATH, MEDIA_FILEPATH_DP, 4, "File", EfiDpFormatFilePathNode },
+    { MEDIA_DEVICE_PATH, MEDIA_PROTOCOL_DP, 20, "Media", EfiDpFormatGuidNode },
+    { MEDIA_DEVICE_PATH, MEDIA_FV_FILEPATH_DP, 20, "FvFile", EfiDpFormatGuidNode },
+    { MEDIA_DEVICE_PATH, MEDIA_FV_DP, 20, "Fv", EfiDpFormatGuidNode },
+    { MEDIA_DEVICE_PATH, MEDIA_RELATIVE_OFFSET_RANGE_DP, 24, "Offset", EfiDpFormatOffsetNode },
+    { BBS_DEVICE_PATH, BBS_BBS_DP, 8, "BBS", EfiDpFormatBbsNode },
+};
+
+static PEFI_DP_NODE_TYPE EfiDpFindNodeType(
+    uint8_t Type,
+    uint8_t SubType
+    )
+{
+    for (size_t i = 0; i < sizeof(EfiDevicePathNodeTypes) / sizeof(EfiDevicePathNodeTypes[0]); i++)
+    {
+        if (EfiDevicePathNodeTypes[i].Type == Type && EfiDevicePathNodeTypes[i].SubType == SubType)
+            return &EfiDevicePathNodeTypes[i];
+    }
+
+    return NULL;
+}
+
+/**
+ * Decodes a device path into its text form, e.g.
+ * "PciRoot(0x0)/Pci(0x1d,0x0)/NVMe(0x1,...)/HD(1,GPT,...)/\EFI\BOOT\BOOTX64.EFI".
+ *
+ * \param Output Receives the text.
+ * \param DevicePath The device path. It may hold several instances.
+ * \param Length The size of \a DevicePath in bytes. Decoding stops at the end of
+ * the buffer even if there is no end node.
+ */
+void EfiDpDecodeDevicePath(
+    PEFI_DP_OUTPUT Output,
+    const void *DevicePath,
+    size_t Length
+    )
+{
+    const uint8_t *buffer = DevicePath;
+    size_t offset = 0;
+    int separator = 0;
+
+    while (Length - offset >= EFI_DP_HEADER_SIZE)
+    {
+        EFI_DP_NODE node;
+        PEFI_DP_NODE_TYPE nodeType;
+        uint8_t type;
+        uint8_t subType;
+
+        node.Buffer = buffer + offset;
+        node.Length = node.Buffer[2] | (node.Buffer[3] << 8);
+        type = node.Buffer[0] & EFI_DP_TYPE_MASK;
+        subType = node.Buffer[1];
+
+        if (node.Length < EFI_DP_HEADER_SIZE || node.Length > Length - offset)
+        {
+            EfiDpAppendText(Output, separator ? "/<invalid>" : "<invalid>");
+            break;
+        }
+
+        if (type == END_DEVICE_PATH_TYPE)
+        {
+            if (subType == END_ENTIRE_DEVICE_PATH_SUBTYPE)
+                break;
+
+            // The end of one instance; another one follows.
+            EfiDpAppendChar(Output, ',');
+            separator = 0;
+            offset += node.Length;
+            continue;
+        }
+
+        if (separator)
+            EfiDpAppendChar(Output, '/');
+
+        nodeType = EfiDpFindNodeType(type, subType);
+
+        if (nodeType && node.Length >= nodeType->MinimumLength)
+            nodeType->Format(Output, nodeType, &node);
+        else
+            EfiDpFormatRawNode(Output, NULL, &node);
+
+        separator = 1;
+        offset += node.Length;
+    }
+}
+
+/**
+ * Splits an EFI_LOAD_OPTION (the value of a Boot#### or Driver#### variable) into
+ * its parts. The result points into \a Buffer.
+ *
+ * \return Zero if the load option is malformed.
+ */
+int EfiDpParseLoadOption(
+    const void *Buffer,
+    size_t Length,
+    PEFI_DP_LOAD_OPTION LoadOption
+    )
+{
+    const uint8_t *buffer = Buffer;
+    EFI_LOAD_OPTION_HEADER header;
+    size_t maximumCount;
+    size_t count;
+    size_t offset;
+
+    if (Length < sizeof(EFI_LOAD_OPTION_HEADER))
+        return 0;
+
+    memcpy(&header, buffer, sizeof(EFI_LOAD_OPTION_HEADER));
+
+    // The description is null terminated, but nothing guarantees the terminator
+    // is inside the value.
+    maximumCount = (Length - sizeof(EFI_LOAD_OPTION_HEADER)) / sizeof(uint16_t);
+
+    for (count = 0; count < maximumCount; count++)
+    {
+        uint16_t character;
+
+        memcpy(&character, buffer + sizeof(EFI_LOAD_OPTION_HEADER) + count * sizeof(uint16_t), sizeof(uint16_t));
+
+        if (character == 0)
+            break;
+    }
+
+    if (count == maximumCount)
+        return 0;
+
+    offset = sizeof(EFI_LOAD_OPTION_HEADER) + (count + 1) * sizeof(uint16_t);
+
+    if (header.FilePathListLength > Length - offset)
+        return 0;
+
+    LoadOption->Attributes = header.Attributes;
+    LoadOption->Description = buffer + sizeof(EFI_LOAD_OPTION_HEADER);
+    LoadOption->DescriptionLength = count * sizeof(uint16_t);
+    LoadOption->FilePathList = buffer + offset;
+    LoadOption->FilePathListLength = header.FilePathListLength;
+    offset += header.FilePathListLength;
+    LoadOption->OptionalData = buffer + offset;
+    LoadOption->OptionalDataLength = Length - offset;
+
+    return 1;
+}
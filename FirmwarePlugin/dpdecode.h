@@ -0,0 +1,70 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Firmware Plugin
+ *
+ * Copyright (C) 2016-2017 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DPDECODE_H
+#define _DPDECODE_H
+
+// Byte-level decoding of EFI device paths and load options. This unit only
+// depends on the C runtime so that it can be built and fuzzed on its own (see
+// fuzz\dpdecode_fuzz.c); devpath.c adapts it to phlib string builders.
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Receives decoded text as UTF-16 code units. Text is not null terminated.
+typedef void (*EFI_DP_APPEND_FUNCTION)(
+    void *Context,
+    const uint16_t *Text,
+    size_t Count
+    );
+
+typedef struct _EFI_DP_OUTPUT
+{
+    EFI_DP_APPEND_FUNCTION Append;
+    void *Context;
+} EFI_DP_OUTPUT, *PEFI_DP_OUTPUT;
+
+// The parts of an EFI_LOAD_OPTION. All pointers point into the decoded buffer.
+typedef struct _EFI_DP_LOAD_OPTION
+{
+    uint32_t Attributes;
+    const uint8_t *Description; // UTF-16, not null terminated
+    size_t DescriptionLength; // in bytes
+    const uint8_t *FilePathList;
+    size_t FilePathListLength;
+    const uint8_t *OptionalData;
+    size_t OptionalDataLength;
+} EFI_DP_LOAD_OPTION, *PEFI_DP_LOAD_OPTION;
+
+int EfiDpParseLoadOption(
+    const void *Buffer,
+    size_t Length,
+    PEFI_DP_LOAD_OPTION LoadOption
+    );
+
+void EfiDpDecodeDevicePath(
+    PEFI_DP_OUTPUT Output,
+    const void *DevicePath,
+    size_t Length
+    );
+
+#endif
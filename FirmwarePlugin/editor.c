@@ -367,8 +367,8 @@ VOID ShowUefiEditorDialog(
     context = PhAllocate(sizeof(EFI_EDITOR_CONTEXT));
     memset(context, 0, sizeof(EFI_EDITOR_CONTEXT));
 
-    context->Name = PhDuplicateString(Entry->Name);
-    context->GuidString = PhDuplicateString(Entry->GuidString);
+    context->Name = PhCreateString2(&Entry->Name);
+    context->GuidString = PhFormatGuid(&Entry->Variable->VendorGuid);
 
     PhCreateThread2(UefiEditorDialogThreadStart, context);
 }
@@ -23,6 +23,32 @@
 #include "main.h"
 #include "Efi\EfiTypes.h"
 #include "Efi\EfiDevicePath.h"
+#include "devpath.h"
+
+#pragma pack(push, 1)
+
+typedef struct _EFI_SIGNATURE_LIST
+{
+    GUID SignatureType;
+    UINT32 SignatureListSize;
+    UINT32 SignatureHeaderSize;
+    UINT32 SignatureSize;
+    // UINT8 SignatureHeader[SignatureHeaderSize];
+    // EFI_SIGNATURE_DATA Signatures[];
+} EFI_SIGNATURE_LIST, *PEFI_SIGNATURE_LIST;
+
+#pragma pack(pop)
+
+static GUID EfiGlobalVariableGuid = { 0x8be4df61, 0x93ca, 0x11d2, { 0xaa, 0x0d, 0x00, 0xe0, 0x98, 0x03, 0x2b, 0x8c } };
+static GUID EfiImageSecurityDatabaseGuid = { 0xd719b2cb, 0x3d3a, 0x4596, { 0xa3, 0xbc, 0xda, 0xd0, 0x0e, 0x67, 0x65, 0x6f } };
+
+static PH_STRINGREF EfiLoadOptionPrefixes[] =
+{
+    PH_STRINGREF_INIT(L"Boot"),
+    PH_STRINGREF_INIT(L"Driver"),
+    PH_STRINGREF_INIT(L"SysPrep"),
+    PH_STRINGREF_INIT(L"PlatformRecovery")
+};
 
 NTSTATUS EnumerateFirmwareValues(
     _Out_ PVOID *Values
@@ -143,3 +169,163 @@ BOOLEAN EfiSupported(
 
     return FALSE;
 }
+
+FORCEINLINE BOOLEAN EfiIsHexDigit(
+    _In_ WCHAR Character
+    )
+{
+    return (Character >= L'0' && Character <= L'9') || (Character >= L'A' && Character <= L'F');
+}
+
+static BOOLEAN EfiIsLoadOptionName(
+    _In_ PPH_STRINGREF Name
+    )
+{
+    for (ULONG i = 0; i < ARRAYSIZE(EfiLoadOptionPrefixes); i++)
+    {
+        PPH_STRINGREF prefix = &EfiLoadOptionPrefixes[i];
+        PH_STRINGREF suffix;
+
+        if (Name->Length != prefix->Length + 4 * sizeof(WCHAR) || !PhStartsWithStringRef(Name, prefix, FALSE))
+            continue;
+
+        suffix.Buffer = (PWCHAR)((PCHAR)Name->Buffer + prefix->Length);
+        suffix.Length = 4 * sizeof(WCHAR);
+
+        // The suffix is "####", four uppercase hexadecimal digits.
+        if (EfiIsHexDigit(suffix.Buffer[0]) && EfiIsHexDigit(suffix.Buffer[1]) &&
+            EfiIsHexDigit(suffix.Buffer[2]) && EfiIsHexDigit(suffix.Buffer[3]))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static PPH_STRING EfiFormatLoadOrder(
+    _In_ PPH_STRINGREF Prefix,
+    _In_reads_bytes_(Length) PUCHAR Value,
+    _In_ ULONG Length
+    )
+{
+    PH_STRING_BUILDER sb;
+
+    PhInitializeStringBuilder(&sb, 0x40);
+
+    for (ULONG i = 0; i + sizeof(UINT16) <= Length; i += sizeof(UINT16))
+    {
+        PhAppendStringBuilder(&sb, Prefix);
+        PhAppendFormatStringBuilder(&sb, L"%04X, ", *(UINT16 UNALIGNED *)(Value + i));
+    }
+
+    if (PhEndsWithStringRef2(&sb.String->sr, L", ", FALSE))
+        PhRemoveEndStringBuilder(&sb, 2);
+
+    return PhFinalStringBuilderString(&sb);
+}
+
+static PPH_STRING EfiFormatSignatureDatabase(
+    _In_reads_bytes_(Length) PUCHAR Value,
+    _In_ ULONG Length
+    )
+{
+    ULONG offset = 0;
+    ULONG listCount = 0;
+    ULONG signatureCount = 0;
+
+    while (Length - offset >= sizeof(EFI_SIGNATURE_LIST))
+    {
+        PEFI_SIGNATURE_LIST list = (PEFI_SIGNATURE_LIST)(Value + offset);
+        ULONG signaturesLength;
+
+        // The sizes are never added together, since that can wrap on 32-bit builds.
+        if (list->SignatureListSize > Length - offset)
+            break;
+        if (list->SignatureListSize < sizeof(EFI_SIGNATURE_LIST))
+            break;
+        if (list->SignatureHeaderSize > list->SignatureListSize - sizeof(EFI_SIGNATURE_LIST))
+            break;
+
+        signaturesLength = list->SignatureListSize - sizeof(EFI_SIGNATURE_LIST) - list->SignatureHeaderSize;
+
+        if (list->SignatureSize != 0)
+            signatureCount += signaturesLength / list->SignatureSize;
+
+        listCount++;
+        offset += list->SignatureListSize;
+    }
+
+    return PhFormatString(L"%lu signature(s) in %lu list(s)", signatureCount, listCount);
+}
+
+/**
+ * Creates a short description of the value of a variable, for variables with a
+ * well-known format.
+ *
+ * \return A string, or NULL if the variable has no known format.
+ */
+PPH_STRING EfiFormatVariableSummary(
+    _In_ PVARIABLE_NAME_AND_VALUE Variable
+    )
+{
+    static PH_STRINGREF bootCurrentName = PH_STRINGREF_INIT(L"BootCurrent");
+    static PH_STRINGREF bootNextName = PH_STRINGREF_INIT(L"BootNext");
+    static PH_STRINGREF orderSuffix = PH_STRINGREF_INIT(L"Order");
+    static PH_STRINGREF defaultSuffix = PH_STRINGREF_INIT(L"Default");
+    static PH_STRINGREF signatureDatabaseNames[] =
+    {
+        PH_STRINGREF_INIT(L"PK"),
+        PH_STRINGREF_INIT(L"KEK"),
+        PH_STRINGREF_INIT(L"db"),
+        PH_STRINGREF_INIT(L"dbx"),
+        PH_STRINGREF_INIT(L"dbt"),
+        PH_STRINGREF_INIT(L"dbr")
+    };
+    PUCHAR value = (PUCHAR)Variable + Variable->ValueOffset;
+    ULONG length = Variable->ValueLength;
+    PH_STRINGREF name;
+
+    PhInitializeStringRefLongHint(&name, Variable->Name);
+
+    if (IsEqualGUID(&Variable->VendorGuid, &EfiGlobalVariableGuid))
+    {
+        if (EfiIsLoadOptionName(&name))
+            return EfiFormatLoadOption(value, length);
+
+        if ((PhEqualStringRef(&name, &bootCurrentName, FALSE) || PhEqualStringRef(&name, &bootNextName, FALSE)) &&
+            length == sizeof(UINT16))
+        {
+            return PhFormatString(L"Boot%04X", *(UINT16 UNALIGNED *)value);
+        }
+
+        if (PhEndsWithStringRef(&name, &orderSuffix, FALSE))
+        {
+            PH_STRINGREF optionPrefix = name;
+
+            optionPrefix.Length -= orderSuffix.Length;
+
+            for (ULONG i = 0; i < ARRAYSIZE(EfiLoadOptionPrefixes); i++)
+            {
+                if (PhEqualStringRef(&optionPrefix, &EfiLoadOptionPrefixes[i], FALSE))
+                    return EfiFormatLoadOrder(&EfiLoadOptionPrefixes[i], value, length);
+            }
+        }
+    }
+
+    if (IsEqualGUID(&Variable->VendorGuid, &EfiGlobalVariableGuid) ||
+        IsEqualGUID(&Variable->VendorGuid, &EfiImageSecurityDatabaseGuid))
+    {
+        PH_STRINGREF databaseName = name;
+
+        // PKDefault, dbDefault, etc. hold the factory databases.
+        if (PhEndsWithStringRef(&databaseName, &defaultSuffix, FALSE))
+            databaseName.Length -= defaultSuffix.Length;
+
+        for (ULONG i = 0; i < ARRAYSIZE(signatureDatabaseNames); i++)
+        {
+            if (PhEqualStringRef(&databaseName, &signatureDatabaseNames[i], FALSE))
+                return EfiFormatSignatureDatabase(value, length);
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,139 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Firmware Plugin
+ *
+ * Copyright (C) 2016-2017 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <phdk.h>
+#include "efinames.h"
+#include "efi_guid_list.h"
+
+static PH_INITONCE FirmwareAttributeStringsInitOnce = PH_INITONCE_INIT;
+static PPH_STRING FirmwareAttributeStrings[EFI_VARIABLE_ATTRIBUTES_MASK + 1];
+static PH_INITONCE FirmwareGuidHashtableInitOnce = PH_INITONCE_INIT;
+static PPH_HASHTABLE FirmwareGuidHashtable = NULL;
+
+static PPH_STRING FirmwareCreateAttributeString(
+    _In_ ULONG Attribute
+    )
+{
+    PH_STRING_BUILDER sb;
+
+    PhInitializeStringBuilder(&sb, 0x100);
+
+    if (Attribute & EFI_VARIABLE_NON_VOLATILE)
+        PhAppendStringBuilder2(&sb, L"Non Volatile, ");
+
+    if (Attribute & EFI_VARIABLE_BOOTSERVICE_ACCESS)
+        PhAppendStringBuilder2(&sb, L"Boot Service, ");
+
+    if (Attribute & EFI_VARIABLE_RUNTIME_ACCESS)
+        PhAppendStringBuilder2(&sb, L"Runtime Access, ");
+
+    if (Attribute & EFI_VARIABLE_HARDWARE_ERROR_RECORD)
+        PhAppendStringBuilder2(&sb, L"Hardware Error Record, ");
+
+    if (Attribute & EFI_VARIABLE_AUTHENTICATED_WRITE_ACCESS)
+        PhAppendStringBuilder2(&sb, L"Authenticated Write Access, ");
+
+    if (Attribute & EFI_VARIABLE_TIME_BASED_AUTHENTICATED_WRITE_ACCESS)
+        PhAppendStringBuilder2(&sb, L"Authenticated Write Access (Time Based), ");
+
+    if (Attribute & EFI_VARIABLE_APPEND_WRITE)
+        PhAppendStringBuilder2(&sb, L"Append Write, ");
+
+    if (PhEndsWithStringRef2(&sb.String->sr, L", ", FALSE))
+        PhRemoveEndStringBuilder(&sb, 2);
+
+    return PhFinalStringBuilderString(&sb);
+}
+
+/**
+ * Gets the display text for a set of variable attributes.
+ *
+ * \return A shared string. Do not dereference it.
+ */
+PPH_STRING FirmwareAttributeToString(
+    _In_ ULONG Attribute
+    )
+{
+    // There are only 128 combinations of the attributes we display, so they are
+    // all formatted once.
+    if (PhBeginInitOnce(&FirmwareAttributeStringsInitOnce))
+    {
+        for (ULONG i = 0; i < ARRAYSIZE(FirmwareAttributeStrings); i++)
+            FirmwareAttributeStrings[i] = FirmwareCreateAttributeString(i);
+
+        PhEndInitOnce(&FirmwareAttributeStringsInitOnce);
+    }
+
+    return FirmwareAttributeStrings[Attribute & EFI_VARIABLE_ATTRIBUTES_MASK];
+}
+
+static BOOLEAN FirmwareGuidEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    return IsEqualGUID(&(*(PEFI_GUID_TABLE_ENTRY *)Entry1)->Guid, &(*(PEFI_GUID_TABLE_ENTRY *)Entry2)->Guid);
+}
+
+static ULONG FirmwareGuidHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    return PhHashBytes((PUCHAR)&(*(PEFI_GUID_TABLE_ENTRY *)Entry)->Guid, sizeof(GUID));
+}
+
+PWSTR FirmwareGuidToNameString(
+    _In_ PGUID VendorGuid
+    )
+{
+    EFI_GUID_TABLE_ENTRY lookupEntry;
+    PEFI_GUID_TABLE_ENTRY lookupEntryPtr = &lookupEntry;
+    PEFI_GUID_TABLE_ENTRY *entry;
+
+    if (PhBeginInitOnce(&FirmwareGuidHashtableInitOnce))
+    {
+        FirmwareGuidHashtable = PhCreateHashtable(
+            sizeof(PEFI_GUID_TABLE_ENTRY),
+            FirmwareGuidEqualFunction,
+            FirmwareGuidHashFunction,
+            ARRAYSIZE(table)
+            );
+
+        // The table has a few duplicate GUIDs; the first name wins, as it did
+        // with the linear search.
+        for (ULONG i = 0; i < ARRAYSIZE(table); i++)
+        {
+            PEFI_GUID_TABLE_ENTRY tableEntry = &table[i];
+
+            PhAddEntryHashtableEx(FirmwareGuidHashtable, &tableEntry, NULL);
+        }
+
+        PhEndInitOnce(&FirmwareGuidHashtableInitOnce);
+    }
+
+    lookupEntry.Guid = *VendorGuid;
+
+    if (entry = PhFindEntryHashtable(FirmwareGuidHashtable, &lookupEntryPtr))
+        return (*entry)->Name;
+
+    return L"";
+}
@@ -0,0 +1,46 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Firmware Plugin
+ *
+ * Copyright (C) 2016-2017 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _EFINAMES_H
+#define _EFINAMES_H
+
+// Display names for variable attributes and vendor GUIDs. This unit only depends on
+// phdk.h so that it can be tested with the shim (see tests\efinames_test.c).
+
+#define EFI_VARIABLE_NON_VOLATILE                             0x00000001
+#define EFI_VARIABLE_BOOTSERVICE_ACCESS                       0x00000002
+#define EFI_VARIABLE_RUNTIME_ACCESS                           0x00000004
+#define EFI_VARIABLE_HARDWARE_ERROR_RECORD                    0x00000008
+#define EFI_VARIABLE_AUTHENTICATED_WRITE_ACCESS               0x00000010
+#define EFI_VARIABLE_TIME_BASED_AUTHENTICATED_WRITE_ACCESS    0x00000020
+#define EFI_VARIABLE_APPEND_WRITE                             0x00000040
+#define EFI_VARIABLE_ATTRIBUTES_MASK                          0x0000007f
+
+PPH_STRING FirmwareAttributeToString(
+    _In_ ULONG Attribute
+    );
+
+PWSTR FirmwareGuidToNameString(
+    _In_ PGUID VendorGuid
+    );
+
+#endif
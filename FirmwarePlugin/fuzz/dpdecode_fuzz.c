@@ -0,0 +1,303 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Firmware Plugin
+ *
+ * Copyright (C) 2016-2017 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Fuzz harness for the EFI device path and load option decoder. It is not part
+// of the plugin build.
+//
+// corpus\ holds seed inputs: device paths from real boot entries (PciRoot/Pci,
+// NVMe and SATA disks with GPT and MBR partitions, file paths, USB, MAC/IPv4/URI
+// network boot, multiple instances, a truncated node) and Boot#### load options.
+//
+// libFuzzer:
+//   clang -g -O1 -fsanitize=fuzzer,address,undefined -I.. dpdecode_fuzz.c ../dpdecode.c -o dpdecode_fuzz
+//   ./dpdecode_fuzz corpus/
+//
+// Compilers without libFuzzer (define DPDECODE_FUZZ_STANDALONE); runs the given
+// files, then random inputs, generated inputs and mutations of the files:
+//   gcc -g -O1 -fsanitize=address,undefined -DDPDECODE_FUZZ_STANDALONE -I.. dpdecode_fuzz.c ../dpdecode.c -o dpdecode_fuzz
+//   ./dpdecode_fuzz [iterations] [corpus/*]
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dpdecode.h"
+
+typedef struct _FUZZ_OUTPUT_CONTEXT
+{
+    size_t Count;
+    uint16_t Last;
+} FUZZ_OUTPUT_CONTEXT;
+
+static void FuzzAppend(
+    void *Context,
+    const uint16_t *Text,
+    size_t Count
+    )
+{
+    FUZZ_OUTPUT_CONTEXT *context = Context;
+
+    // Touch every unit so the sanitizers see reads of uninitialized or freed text.
+    for (size_t i = 0; i < Count; i++)
+        context->Last ^= Text[i];
+
+    context->Count += Count;
+}
+
+int LLVMFuzzerTestOneInput(
+    const uint8_t *Data,
+    size_t Size
+    )
+{
+    FUZZ_OUTPUT_CONTEXT context = { 0 };
+    EFI_DP_OUTPUT output;
+    EFI_DP_LOAD_OPTION loadOption;
+    uint8_t *copy;
+
+    // Use an exact-size heap copy so that reads past the end are caught.
+    if (!(copy = malloc(Size ? Size : 1)))
+        return 0;
+
+    memcpy(copy, Data, Size);
+
+    output.Append = FuzzAppend;
+    output.Context = &context;
+
+    EfiDpDecodeDevicePath(&output, copy, Size);
+
+    if (EfiDpParseLoadOption(copy, Size, &loadOption))
+    {
+        if (loadOption.Description + loadOption.DescriptionLength > copy + Size ||
+            loadOption.FilePathList + loadOption.FilePathListLength > copy + Size ||
+            loadOption.OptionalData + loadOption.OptionalDataLength != copy + Size)
+        {
+            abort();
+        }
+
+        EfiDpDecodeDevicePath(&output, loadOption.FilePathList, loadOption.FilePathListLength);
+    }
+
+    free(copy);
+
+    return 0;
+}
+
+#ifdef DPDECODE_FUZZ_STANDALONE
+
+#include <stdio.h>
+
+static uint64_t FuzzRandomState = 0x9e3779b97f4a7c15;
+
+static uint32_t FuzzRandom(
+    void
+    )
+{
+    FuzzRandomState ^= FuzzRandomState << 13;
+    FuzzRandomState ^= FuzzRandomState >> 7;
+    FuzzRandomState ^= FuzzRandomState << 17;
+
+    return (uint32_t)FuzzRandomState;
+}
+
+// Builds a mostly well formed device path so that the node formatters are reached,
+// then damages it.
+static size_t FuzzGenerate(
+    uint8_t *Buffer,
+    size_t Size
+    )
+{
+    static const uint8_t types[] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x7f, 0xff };
+    size_t offset = 0;
+
+    if (FuzzRandom() % 2)
+    {
+        // Load option header and a short description.
+        size_t descriptionLength = FuzzRandom() % 8;
+
+        if (offset + 6 + (descriptionLength + 1) * 2 > Size)
+            return 0;
+
+        for (size_t i = 0; i < 4; i++)
+            Buffer[offset++] = (uint8_t)FuzzRandom();
+
+        Buffer[offset++] = (uint8_t)FuzzRandom();
+        Buffer[offset++] = (uint8_t)(FuzzRandom() % 2);
+
+        for (size_t i = 0; i < descriptionLength; i++)
+        {
+            Buffer[offset++] = 'A' + FuzzRandom() % 26;
+            Buffer[offset++] = 0;
+        }
+
+        Buffer[offset++] = 0;
+        Buffer[offset++] = 0;
+    }
+
+    while (offset + 4 <= Size && FuzzRandom() % 8)
+    {
+        size_t nodeLength = 4 + FuzzRandom() % 60;
+
+        if (offset + nodeLength > Size)
+            nodeLength = Size - offset;
+
+        Buffer[offset] = types[FuzzRandom() % sizeof(types)];
+        Buffer[offset + 1] = (uint8_t)(FuzzRandom() % 0x1a);
+        Buffer[offset + 2] = (uint8_t)nodeLength;
+        Buffer[offset + 3] = (uint8_t)(nodeLength >> 8);
+
+        for (size_t i = 4; i < nodeLength; i++)
+            Buffer[offset + i] = (uint8_t)FuzzRandom();
+
+        offset += nodeLength;
+    }
+
+    // Flip a few bytes, including the length fields.
+    for (uint32_t i = FuzzRandom() % 4; i != 0 && offset != 0; i--)
+        Buffer[FuzzRandom() % offset] = (uint8_t)FuzzRandom();
+
+    return offset;
+}
+
+#define FUZZ_MAX_SEEDS 256
+
+static uint8_t *FuzzSeeds[FUZZ_MAX_SEEDS];
+static size_t FuzzSeedSizes[FUZZ_MAX_SEEDS];
+static size_t FuzzSeedCount = 0;
+
+static int FuzzLoadSeed(
+    const char *FileName,
+    uint8_t *Buffer,
+    size_t Size
+    )
+{
+    FILE *file;
+    size_t length;
+
+    if (!(file = fopen(FileName, "rb")))
+    {
+        printf("cannot open %s\n", FileName);
+        return 0;
+    }
+
+    length = fread(Buffer, 1, Size, file);
+    fclose(file);
+
+    if (FuzzSeedCount < FUZZ_MAX_SEEDS && (FuzzSeeds[FuzzSeedCount] = malloc(length ? length : 1)))
+    {
+        memcpy(FuzzSeeds[FuzzSeedCount], Buffer, length);
+        FuzzSeedSizes[FuzzSeedCount++] = length;
+    }
+
+    LLVMFuzzerTestOneInput(Buffer, length);
+
+    return 1;
+}
+
+// Damages a seed: flips bytes, and sometimes cuts it short or inserts bytes.
+static size_t FuzzMutateSeed(
+    uint8_t *Buffer,
+    size_t Size
+    )
+{
+    size_t seed = FuzzRandom() % FuzzSeedCount;
+    size_t length = FuzzSeedSizes[seed];
+
+    if (length > Size)
+        length = Size;
+
+    memcpy(Buffer, FuzzSeeds[seed], length);
+
+    if (length == 0)
+        return 0;
+
+    for (uint32_t i = 1 + FuzzRandom() % 4; i != 0; i--)
+        Buffer[FuzzRandom() % length] = (uint8_t)FuzzRandom();
+
+    switch (FuzzRandom() % 4)
+    {
+    case 0:
+        length = FuzzRandom() % length;
+        break;
+    case 1:
+        if (length < Size)
+        {
+            size_t offset = FuzzRandom() % length;
+
+            memmove(&Buffer[offset + 1], &Buffer[offset], length - offset);
+            Buffer[offset] = (uint8_t)FuzzRandom();
+            length++;
+        }
+        break;
+    }
+
+    return length;
+}
+
+int main(
+    int argc,
+    char *argv[]
+    )
+{
+    static uint8_t buffer[0x1000];
+    unsigned long iterations = 1000000;
+    int argument = 1;
+
+    if (argc > argument && argv[argument][0] >= '0' && argv[argument][0] <= '9')
+        iterations = strtoul(argv[argument++], NULL, 10);
+
+    for (; argument < argc; argument++)
+    {
+        if (!FuzzLoadSeed(argv[argument], buffer, sizeof(buffer)))
+            return 1;
+    }
+
+    for (unsigned long i = 0; i < iterations; i++)
+    {
+        size_t size;
+
+        if (i % 4 == 0)
+        {
+            size = FuzzRandom() % 256;
+
+            for (size_t j = 0; j < size; j++)
+                buffer[j] = (uint8_t)FuzzRandom();
+        }
+        else if (i % 4 == 1 && FuzzSeedCount != 0)
+        {
+            size = FuzzMutateSeed(buffer, sizeof(buffer));
+        }
+        else
+        {
+            size = FuzzGenerate(buffer, FuzzRandom() % sizeof(buffer));
+        }
+
+        LLVMFuzzerTestOneInput(buffer, size);
+    }
+
+    printf("%zu seeds, %lu inputs\n", FuzzSeedCount, iterations);
+
+    for (size_t i = 0; i < FuzzSeedCount; i++)
+        free(FuzzSeeds[i]);
+
+    return 0;
+}
+
+#endif
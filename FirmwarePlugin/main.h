@@ -29,6 +29,9 @@
 #define SETTING_NAME_WINDOW_SIZE (PLUGIN_NAME L".WindowSize")
 #define SETTING_NAME_LISTVIEW_COLUMNS (PLUGIN_NAME L".ListViewColumns")
 
+#define WM_FIRMWARE_DETAILS_COMPLETE (WM_APP + 1)
+#define WM_FIRMWARE_FLUSH_DETAILS (WM_APP + 2)
+
 #define CINTERFACE
 #define COBJMACROS
 #define INITGUID
@@ -41,23 +44,49 @@
 #include <stdint.h>
 #include <cguid.h>
 
+#include "efinames.h"
 #include "resource.h"
 
 extern PPH_PLUGIN PluginInstance;
 
-typedef struct _UEFI_WINDOW_CONTEXT
+// A buffer returned by EnumerateFirmwareValues. List rows and background requests
+// point into it, so it is reference counted.
+typedef struct _EFI_SNAPSHOT
 {
-    HWND ListViewHandle;
-    PH_LAYOUT_MANAGER LayoutManager;
-} UEFI_WINDOW_CONTEXT, *PUEFI_WINDOW_CONTEXT;
+    volatile LONG RefCount;
+    PVOID Variables;
+} EFI_SNAPSHOT, *PEFI_SNAPSHOT;
 
+// A row of the variable list. The list view is owner-data; text is created when
+// the row is first drawn and kept across refreshes while the value is unchanged.
 typedef struct _EFI_ENTRY
 {
-    ULONG Length;
-    PPH_STRING Name;
+    struct _VARIABLE_NAME_AND_VALUE *Variable; // in the window's snapshot
+    PH_STRINGREF Name;
+    PWSTR GuidName;
     PPH_STRING GuidString;
+    PPH_STRING SizeString;
+    PPH_STRING HashString; // computed in the background
+    PPH_STRING Summary; // computed in the background
+    BOOLEAN DetailsQueued;
 } EFI_ENTRY, *PEFI_ENTRY;
 
+typedef struct _UEFI_WINDOW_CONTEXT
+{
+    HWND ListViewHandle;
+    PH_LAYOUT_MANAGER LayoutManager;
+
+    PEFI_SNAPSHOT Snapshot;
+    PEFI_ENTRY Entries; // in enumeration order
+    ULONG EntryCount;
+    PULONG EntryOrder; // entry index for each row
+    ULONG Generation; // changes whenever the entries are replaced
+    ULONG SortColumn;
+    PH_SORT_ORDER SortOrder;
+    PPH_LIST PendingDetails; // entry indices
+    BOOLEAN DetailsFlushPosted;
+} UEFI_WINDOW_CONTEXT, *PUEFI_WINDOW_CONTEXT;
+
 INT_PTR CALLBACK UefiEntriesDlgProc(
     _In_ HWND hwndDlg,
     _In_ UINT uMsg,
@@ -95,14 +124,6 @@ typedef struct _VARIABLE_NAME
     WCHAR Name[ANYSIZE_ARRAY];
 } VARIABLE_NAME, *PVARIABLE_NAME;
 
-#define EFI_VARIABLE_NON_VOLATILE                             0x00000001
-#define EFI_VARIABLE_BOOTSERVICE_ACCESS                       0x00000002
-#define EFI_VARIABLE_RUNTIME_ACCESS                           0x00000004
-#define EFI_VARIABLE_HARDWARE_ERROR_RECORD                    0x00000008
-#define EFI_VARIABLE_AUTHENTICATED_WRITE_ACCESS               0x00000010
-#define EFI_VARIABLE_TIME_BASED_AUTHENTICATED_WRITE_ACCESS    0x00000020
-#define EFI_VARIABLE_APPEND_WRITE                             0x00000040
-
 typedef struct _VARIABLE_NAME_AND_VALUE 
 {
     ULONG NextEntryOffset;
@@ -149,4 +170,64 @@ typedef struct _WINDOWS_OS_OPTIONS
     WCHAR OsLoadOptions[1];
 } WINDOWS_OS_OPTIONS, *PWINDOWS_OS_OPTIONS;
 
+// efi.c
+
+PPH_STRING EfiFormatVariableSummary(
+    _In_ PVARIABLE_NAME_AND_VALUE Variable
+    );
+
+// variables.c
+
+typedef struct _EFI_DETAILS_ITEM
+{
+    ULONG Index;
+    PVARIABLE_NAME_AND_VALUE Variable;
+    PPH_STRING HashString;
+    PPH_STRING Summary;
+} EFI_DETAILS_ITEM, *PEFI_DETAILS_ITEM;
+
+typedef struct _EFI_DETAILS_REQUEST
+{
+    HWND WindowHandle;
+    ULONG Generation;
+    PEFI_SNAPSHOT Snapshot;
+    ULONG Count;
+    EFI_DETAILS_ITEM Items[ANYSIZE_ARRAY];
+} EFI_DETAILS_REQUEST, *PEFI_DETAILS_REQUEST;
+
+NTSTATUS RefreshFirmwareEntries(
+    _Inout_ PUEFI_WINDOW_CONTEXT Context
+    );
+
+VOID FreeFirmwareEntries(
+    _Inout_ PUEFI_WINDOW_CONTEXT Context
+    );
+
+VOID SortFirmwareEntries(
+    _Inout_ PUEFI_WINDOW_CONTEXT Context
+    );
+
+VOID QueueFirmwareEntryDetails(
+    _Inout_ PUEFI_WINDOW_CONTEXT Context,
+    _In_ ULONG Index
+    );
+
+VOID FlushFirmwareEntryDetails(
+    _Inout_ PUEFI_WINDOW_CONTEXT Context,
+    _In_ HWND WindowHandle
+    );
+
+VOID ApplyFirmwareEntryDetails(
+    _Inout_ PUEFI_WINDOW_CONTEXT Context,
+    _In_ PEFI_DETAILS_REQUEST Request
+    );
+
+VOID DestroyFirmwareDetailsRequest(
+    _In_ PEFI_DETAILS_REQUEST Request
+    );
+
+NTSTATUS NTAPI FirmwareDetailsWorker(
+    _In_ PVOID Parameter
+    );
+
 #endif _BOOT_H_
\ No newline at end of file
@@ -0,0 +1,169 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Firmware Plugin
+ *
+ * Copyright (C) 2016-2017 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Tests for the attribute and vendor GUID names. Every GUID in efi_guid_list.h is
+// looked up and checked against a linear search of the table, and every attribute
+// value is checked against the expected text. They are not part of the plugin
+// build; the shim directory stands in for phdk.h.
+//
+//   gcc -g -O1 -fshort-wchar -fsanitize=address,undefined -I../../common/tests/shim -I.. efinames_test.c ../efinames.c -o efinames_test
+//   ./efinames_test
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <phdk.h>
+#include "efinames.h"
+#include "efi_guid_list.h"
+
+static int TestFailures = 0;
+
+#define CHECK(Expression) \
+    do { if (!(Expression)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #Expression); TestFailures++; } } while (0)
+
+static int TestEqualString(
+    PWSTR String1,
+    PWSTR String2
+    )
+{
+    while (*String1 && *String1 == *String2)
+    {
+        String1++;
+        String2++;
+    }
+
+    return *String1 == *String2;
+}
+
+// The name the old linear search returned: the first entry with the GUID.
+static PWSTR TestFindName(
+    PGUID Guid
+    )
+{
+    for (ULONG i = 0; i < ARRAYSIZE(table); i++)
+    {
+        if (IsEqualGUID(&table[i].Guid, Guid))
+            return table[i].Name;
+    }
+
+    return L"";
+}
+
+static void TestGuidNames(
+    void
+    )
+{
+    ULONG duplicateCount = 0;
+
+    for (ULONG i = 0; i < ARRAYSIZE(table); i++)
+    {
+        PWSTR expected = TestFindName(&table[i].Guid);
+
+        CHECK(TestEqualString(FirmwareGuidToNameString(&table[i].Guid), expected));
+
+        if (expected != table[i].Name)
+            duplicateCount++;
+    }
+
+    // The table has a few duplicates; the first name must win for those.
+    CHECK(duplicateCount != 0);
+
+    // GUIDs that differ from a known one in a single byte are not found.
+    for (ULONG i = 0; i < ARRAYSIZE(table); i += 7)
+    {
+        for (ULONG j = 0; j < sizeof(GUID); j += 5)
+        {
+            GUID guid = table[i].Guid;
+
+            ((PUCHAR)&guid)[j] ^= 0x5a;
+
+            CHECK(TestEqualString(FirmwareGuidToNameString(&guid), TestFindName(&guid)));
+        }
+    }
+}
+
+static void TestAttributeNames(
+    void
+    )
+{
+    static PWSTR names[] =
+    {
+        L"Non Volatile",
+        L"Boot Service",
+        L"Runtime Access",
+        L"Hardware Error Record",
+        L"Authenticated Write Access",
+        L"Authenticated Write Access (Time Based)",
+        L"Append Write"
+    };
+    static ULONG extraBits[] = { 0, 0x80, 0x100, 0x80000000, 0xffffff80 };
+
+    for (ULONG attribute = 0; attribute <= EFI_VARIABLE_ATTRIBUTES_MASK; attribute++)
+    {
+        WCHAR expected[0x100];
+        ULONG length = 0;
+        PPH_STRING string = FirmwareAttributeToString(attribute);
+
+        for (ULONG bit = 0; bit < ARRAYSIZE(names); bit++)
+        {
+            if (!(attribute & (1 << bit)))
+                continue;
+
+            if (length != 0)
+            {
+                expected[length++] = L',';
+                expected[length++] = L' ';
+            }
+
+            for (PWSTR name = names[bit]; *name; name++)
+                expected[length++] = *name;
+        }
+
+        expected[length] = 0;
+
+        CHECK(string->Length == length * sizeof(WCHAR));
+        CHECK(TestEqualString(string->Buffer, expected));
+
+        // Bits that are not displayed share the string of the displayed ones, and
+        // the strings are formatted once.
+        for (ULONG i = 0; i < ARRAYSIZE(extraBits); i++)
+            CHECK(FirmwareAttributeToString(attribute | extraBits[i]) == string);
+    }
+}
+
+int main(
+    void
+    )
+{
+    TestGuidNames();
+    TestAttributeNames();
+
+    if (TestFailures)
+    {
+        printf("%d check(s) failed\n", TestFailures);
+        return 1;
+    }
+
+    printf("all tests passed\n");
+
+    return 0;
+}
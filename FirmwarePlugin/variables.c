@@ -0,0 +1,490 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Firmware Plugin
+ *
+ * Copyright (C) 2016-2017 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "main.h"
+
+#define BEGIN_SORT_FUNCTION(Column) static int __cdecl FirmwareEntryCompare##Column( \
+    _In_ void *_context, \
+    _In_ const void *_elem1, \
+    _In_ const void *_elem2 \
+    ) \
+{ \
+    PUEFI_WINDOW_CONTEXT context = _context; \
+    PEFI_ENTRY entry1 = &context->Entries[*(PULONG)_elem1]; \
+    PEFI_ENTRY entry2 = &context->Entries[*(PULONG)_elem2]; \
+    int sortResult = 0;
+
+#define END_SORT_FUNCTION \
+    if (sortResult == 0) \
+        sortResult = PhCompareStringRef(&entry1->Name, &entry2->Name, TRUE); \
+    \
+    return PhModifySort(sortResult, context->SortOrder); \
+}
+
+#define SORT_FUNCTION(Column) FirmwareEntryCompare##Column
+
+static PEFI_SNAPSHOT CreateFirmwareSnapshot(
+    _In_ PVOID Variables
+    )
+{
+    PEFI_SNAPSHOT snapshot;
+
+    snapshot = PhAllocate(sizeof(EFI_SNAPSHOT));
+    snapshot->RefCount = 1;
+    snapshot->Variables = Variables;
+
+    return snapshot;
+}
+
+static VOID ReferenceFirmwareSnapshot(
+    _In_ PEFI_SNAPSHOT Snapshot
+    )
+{
+    InterlockedIncrement(&Snapshot->RefCount);
+}
+
+static VOID DereferenceFirmwareSnapshot(
+    _In_ PEFI_SNAPSHOT Snapshot
+    )
+{
+    if (InterlockedDecrement(&Snapshot->RefCount) == 0)
+    {
+        PhFree(Snapshot->Variables);
+        PhFree(Snapshot);
+    }
+}
+
+static BOOLEAN FirmwareEntryEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    PEFI_ENTRY entry1 = *(PEFI_ENTRY *)Entry1;
+    PEFI_ENTRY entry2 = *(PEFI_ENTRY *)Entry2;
+
+    // Variable names are case sensitive.
+    return IsEqualGUID(&entry1->Variable->VendorGuid, &entry2->Variable->VendorGuid) &&
+        PhEqualStringRef(&entry1->Name, &entry2->Name, FALSE);
+}
+
+static ULONG FirmwareEntryHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    PEFI_ENTRY entry = *(PEFI_ENTRY *)Entry;
+
+    return PhHashStringRef(&entry->Name, FALSE) ^ entry->Variable->VendorGuid.Data1;
+}
+
+static BOOLEAN FirmwareEntryValueEqual(
+    _In_ PEFI_ENTRY Entry1,
+    _In_ PEFI_ENTRY Entry2
+    )
+{
+    PVARIABLE_NAME_AND_VALUE variable1 = Entry1->Variable;
+    PVARIABLE_NAME_AND_VALUE variable2 = Entry2->Variable;
+
+    return variable1->Attributes == variable2->Attributes &&
+        variable1->ValueLength == variable2->ValueLength &&
+        memcmp(
+        (PUCHAR)variable1 + variable1->ValueOffset,
+        (PUCHAR)variable2 + variable2->ValueOffset,
+        variable1->ValueLength
+        ) == 0;
+}
+
+static VOID ClearFirmwareEntry(
+    _Inout_ PEFI_ENTRY Entry
+    )
+{
+    PhClearReference(&Entry->GuidString);
+    PhClearReference(&Entry->SizeString);
+    PhClearReference(&Entry->HashString);
+    PhClearReference(&Entry->Summary);
+}
+
+static VOID MoveFirmwareEntryText(
+    _Inout_ PEFI_ENTRY Entry,
+    _Inout_ PEFI_ENTRY OldEntry
+    )
+{
+    Entry->GuidString = OldEntry->GuidString;
+    OldEntry->GuidString = NULL;
+    Entry->SizeString = OldEntry->SizeString;
+    OldEntry->SizeString = NULL;
+
+    // Details that were still being computed are requested again.
+    if (OldEntry->HashString)
+    {
+        Entry->HashString = OldEntry->HashString;
+        OldEntry->HashString = NULL;
+        Entry->Summary = OldEntry->Summary;
+        OldEntry->Summary = NULL;
+        Entry->DetailsQueued = TRUE;
+    }
+}
+
+VOID FreeFirmwareEntries(
+    _Inout_ PUEFI_WINDOW_CONTEXT Context
+    )
+{
+    for (ULONG i = 0; i < Context->EntryCount; i++)
+        ClearFirmwareEntry(&Context->Entries[i]);
+
+    if (Context->Entries)
+    {
+        PhFree(Context->Entries);
+        Context->Entries = NULL;
+    }
+
+    if (Context->EntryOrder)
+    {
+        PhFree(Context->EntryOrder);
+        Context->EntryOrder = NULL;
+    }
+
+    if (Context->Snapshot)
+    {
+        DereferenceFirmwareSnapshot(Context->Snapshot);
+        Context->Snapshot = NULL;
+    }
+
+    Context->EntryCount = 0;
+
+    // Results of detail requests for the old entries are dropped.
+    Context->Generation++;
+    PhClearList(Context->PendingDetails);
+}
+
+/**
+ * Enumerates the variables again and updates the list. Rows whose variable did not
+ * change keep their text, and when no variable was added or removed only the
+ * changed rows are redrawn.
+ */
+NTSTATUS RefreshFirmwareEntries(
+    _Inout_ PUEFI_WINDOW_CONTEXT Context
+    )
+{
+    NTSTATUS status;
+    PVOID variables;
+    PVARIABLE_NAME_AND_VALUE variable;
+    PEFI_SNAPSHOT snapshot;
+    PEFI_ENTRY entries;
+    ULONG count;
+    PPH_HASHTABLE oldEntryHashtable;
+    PULONG oldEntryOrder;
+    PPH_LIST changedEntries;
+    BOOLEAN layoutChanged;
+
+    if (!NT_SUCCESS(status = EnumerateFirmwareValues(&variables)))
+        return status;
+
+    snapshot = CreateFirmwareSnapshot(variables);
+    count = 0;
+
+    for (variable = PH_FIRST_EFI_VARIABLE(variables); variable; variable = PH_NEXT_EFI_VARIABLE(variable))
+        count++;
+
+    entries = PhAllocate(max(count, 1) * sizeof(EFI_ENTRY));
+    memset(entries, 0, max(count, 1) * sizeof(EFI_ENTRY));
+
+    oldEntryHashtable = PhCreateHashtable(
+        sizeof(PEFI_ENTRY),
+        FirmwareEntryEqualFunction,
+        FirmwareEntryHashFunction,
+        max(Context->EntryCount, 1)
+        );
+
+    for (ULONG i = 0; i < Context->EntryCount; i++)
+    {
+        PEFI_ENTRY oldEntry = &Context->Entries[i];
+
+        PhAddEntryHashtable(oldEntryHashtable, &oldEntry);
+    }
+
+    changedEntries = PhCreateList(8);
+    layoutChanged = count != Context->EntryCount;
+    count = 0;
+
+    for (variable = PH_FIRST_EFI_VARIABLE(variables); variable; variable = PH_NEXT_EFI_VARIABLE(variable))
+    {
+        PEFI_ENTRY entry = &entries[count];
+        PEFI_ENTRY *oldEntry;
+
+        entry->Variable = variable;
+        PhInitializeStringRefLongHint(&entry->Name, variable->Name);
+        entry->GuidName = FirmwareGuidToNameString(&variable->VendorGuid);
+
+        if (oldEntry = PhFindEntryHashtable(oldEntryHashtable, &entry))
+        {
+            if (*oldEntry - Context->Entries != count)
+                layoutChanged = TRUE;
+
+            if (FirmwareEntryValueEqual(entry, *oldEntry))
+                MoveFirmwareEntryText(entry, *oldEntry);
+            else
+                PhAddItemList(changedEntries, UlongToPtr(count));
+        }
+        else
+        {
+            layoutChanged = TRUE;
+        }
+
+        count++;
+    }
+
+    PhDereferenceObject(oldEntryHashtable);
+
+    // The old order is kept to find out whether any row moved.
+    oldEntryOrder = Context->EntryOrder;
+    Context->EntryOrder = NULL;
+    FreeFirmwareEntries(Context);
+
+    Context->Snapshot = snapshot;
+    Context->Entries = entries;
+    Context->EntryCount = count;
+    SortFirmwareEntries(Context);
+
+    if (!layoutChanged && oldEntryOrder && count != 0 &&
+        memcmp(oldEntryOrder, Context->EntryOrder, count * sizeof(ULONG)) != 0)
+    {
+        layoutChanged = TRUE;
+    }
+
+    if (layoutChanged)
+    {
+        ListView_SetItemCountEx(Context->ListViewHandle, count, LVSICF_NOSCROLL);
+        InvalidateRect(Context->ListViewHandle, NULL, FALSE);
+    }
+    else
+    {
+        for (ULONG i = 0; i < changedEntries->Count; i++)
+        {
+            ULONG index = PtrToUlong(changedEntries->Items[i]);
+
+            for (ULONG row = 0; row < count; row++)
+            {
+                if (Context->EntryOrder[row] == index)
+                {
+                    ListView_RedrawItems(Context->ListViewHandle, row, row);
+                    break;
+                }
+            }
+        }
+    }
+
+    if (oldEntryOrder)
+        PhFree(oldEntryOrder);
+
+    PhDereferenceObject(changedEntries);
+
+    return status;
+}
+
+BEGIN_SORT_FUNCTION(Name)
+{
+    NOTHING;
+}
+END_SORT_FUNCTION
+
+BEGIN_SORT_FUNCTION(Attributes)
+{
+    sortResult = uintcmp(entry1->Variable->Attributes, entry2->Variable->Attributes);
+}
+END_SORT_FUNCTION
+
+BEGIN_SORT_FUNCTION(GuidName)
+{
+    sortResult = PhCompareStringZ(entry1->GuidName, entry2->GuidName, TRUE);
+}
+END_SORT_FUNCTION
+
+BEGIN_SORT_FUNCTION(Guid)
+{
+    sortResult = memcmp(&entry1->Variable->VendorGuid, &entry2->Variable->VendorGuid, sizeof(GUID));
+}
+END_SORT_FUNCTION
+
+BEGIN_SORT_FUNCTION(Length)
+{
+    sortResult = uintcmp(entry1->Variable->ValueLength, entry2->Variable->ValueLength);
+}
+END_SORT_FUNCTION
+
+BEGIN_SORT_FUNCTION(Hash)
+{
+    sortResult = PhCompareStringWithNull(entry1->HashString, entry2->HashString, TRUE);
+}
+END_SORT_FUNCTION
+
+BEGIN_SORT_FUNCTION(Summary)
+{
+    sortResult = PhCompareStringWithNull(entry1->Summary, entry2->Summary, TRUE);
+}
+END_SORT_FUNCTION
+
+/**
+ * Rebuilds the display order of the variable list. Entries are not moved, so indices
+ * held by detail requests stay valid.
+ */
+VOID SortFirmwareEntries(
+    _Inout_ PUEFI_WINDOW_CONTEXT Context
+    )
+{
+    static PVOID sortFunctions[] =
+    {
+        SORT_FUNCTION(Name),
+        SORT_FUNCTION(Attributes),
+        SORT_FUNCTION(GuidName),
+        SORT_FUNCTION(Guid),
+        SORT_FUNCTION(Length),
+        SORT_FUNCTION(Hash),
+        SORT_FUNCTION(Summary)
+    };
+    int (__cdecl *sortFunction)(void *, const void *, const void *);
+
+    if (!Context->EntryOrder && Context->EntryCount != 0)
+    {
+        Context->EntryOrder = PhAllocate(Context->EntryCount * sizeof(ULONG));
+
+        for (ULONG i = 0; i < Context->EntryCount; i++)
+            Context->EntryOrder[i] = i;
+    }
+
+    if (Context->EntryCount == 0 || Context->SortOrder == NoSortOrder)
+        return;
+
+    if (Context->SortColumn < RTL_NUMBER_OF(sortFunctions))
+        sortFunction = sortFunctions[Context->SortColumn];
+    else
+        sortFunction = SORT_FUNCTION(Name);
+
+    qsort_s(Context->EntryOrder, Context->EntryCount, sizeof(ULONG), sortFunction, Context);
+}
+
+/**
+ * Marks an entry for a background hash and summary. Entries are only queued when
+ * their row is drawn; the batch is sent by FlushFirmwareEntryDetails.
+ */
+VOID QueueFirmwareEntryDetails(
+    _Inout_ PUEFI_WINDOW_CONTEXT Context,
+    _In_ ULONG Index
+    )
+{
+    PEFI_ENTRY entry = &Context->Entries[Index];
+
+    if (entry->DetailsQueued)
+        return;
+
+    entry->DetailsQueued = TRUE;
+    PhAddItemList(Context->PendingDetails, UlongToPtr(Index));
+}
+
+VOID FlushFirmwareEntryDetails(
+    _Inout_ PUEFI_WINDOW_CONTEXT Context,
+    _In_ HWND WindowHandle
+    )
+{
+    PEFI_DETAILS_REQUEST request;
+    ULONG count = Context->PendingDetails->Count;
+
+    if (count == 0 || !Context->Snapshot)
+        return;
+
+    request = PhAllocate(FIELD_OFFSET(EFI_DETAILS_REQUEST, Items[count]));
+    request->WindowHandle = WindowHandle;
+    request->Generation = Context->Generation;
+    request->Snapshot = Context->Snapshot;
+    ReferenceFirmwareSnapshot(request->Snapshot);
+    request->Count = count;
+
+    for (ULONG i = 0; i < count; i++)
+    {
+        ULONG index = PtrToUlong(Context->PendingDetails->Items[i]);
+
+        request->Items[i].Index = index;
+        request->Items[i].Variable = Context->Entries[index].Variable;
+        request->Items[i].HashString = NULL;
+        request->Items[i].Summary = NULL;
+    }
+
+    PhClearList(Context->PendingDetails);
+    PhQueueItemWorkQueue(PhGetGlobalWorkQueue(), FirmwareDetailsWorker, request);
+}
+
+VOID ApplyFirmwareEntryDetails(
+    _Inout_ PUEFI_WINDOW_CONTEXT Context,
+    _In_ PEFI_DETAILS_REQUEST Request
+    )
+{
+    if (Request->Generation != Context->Generation)
+        return;
+
+    for (ULONG i = 0; i < Request->Count; i++)
+    {
+        PEFI_ENTRY entry = &Context->Entries[Request->Items[i].Index];
+
+        PhMoveReference(&entry->HashString, Request->Items[i].HashString);
+        PhMoveReference(&entry->Summary, Request->Items[i].Summary);
+        Request->Items[i].HashString = NULL;
+        Request->Items[i].Summary = NULL;
+    }
+}
+
+VOID DestroyFirmwareDetailsRequest(
+    _In_ PEFI_DETAILS_REQUEST Request
+    )
+{
+    for (ULONG i = 0; i < Request->Count; i++)
+    {
+        PhClearReference(&Request->Items[i].HashString);
+        PhClearReference(&Request->Items[i].Summary);
+    }
+
+    DereferenceFirmwareSnapshot(Request->Snapshot);
+    PhFree(Request);
+}
+
+NTSTATUS NTAPI FirmwareDetailsWorker(
+    _In_ PVOID Parameter
+    )
+{
+    PEFI_DETAILS_REQUEST request = Parameter;
+
+    // The snapshot already holds the values, so nothing is read from the firmware.
+    for (ULONG i = 0; i < request->Count; i++)
+    {
+        PEFI_DETAILS_ITEM item = &request->Items[i];
+        PVARIABLE_NAME_AND_VALUE variable = item->Variable;
+
+        item->HashString = PhFormatString(
+            L"%08lx",
+            PhCrc32(0, (PCHAR)variable + variable->ValueOffset, variable->ValueLength)
+            );
+        item->Summary = EfiFormatVariableSummary(variable);
+    }
+
+    if (!PostMessage(request->WindowHandle, WM_FIRMWARE_DETAILS_COMPLETE, 0, (LPARAM)request))
+        DestroyFirmwareDetailsRequest(request);
+
+    return STATUS_SUCCESS;
+}
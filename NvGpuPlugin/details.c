@@ -23,18 +23,19 @@
 #include "main.h"
 
 VOID NvUpdateDetails(
-    _In_ HWND DetailsHandle
+    _In_ HWND DetailsHandle,
+    _In_ PNVGPU_DEVICE Device
     )
 {
-    SetDlgItemText(DetailsHandle, IDC_EDIT1, ((PPH_STRING)PhAutoDereferenceObject(NvGpuQueryName()))->Buffer);
-    SetDlgItemText(DetailsHandle, IDC_EDIT2, ((PPH_STRING)PhAutoDereferenceObject(NvGpuQueryShortName()))->Buffer);
-    SetDlgItemText(DetailsHandle, IDC_EDIT3, ((PPH_STRING)PhAutoDereferenceObject(NvGpuQueryVbiosVersionString()))->Buffer);
-    SetDlgItemText(DetailsHandle, IDC_EDIT4, ((PPH_STRING)PhAutoDereferenceObject(NvGpuQueryRevision()))->Buffer);
-    SetDlgItemText(DetailsHandle, IDC_EDIT5, ((PPH_STRING)PhAutoDereferenceObject(NvGpuQueryDeviceId()))->Buffer);
-    SetDlgItemText(DetailsHandle, IDC_EDIT6, ((PPH_STRING)PhAutoDereferenceObject(NvGpuQueryRopsCount()))->Buffer);
-    SetDlgItemText(DetailsHandle, IDC_EDIT10, ((PPH_STRING)PhAutoDereferenceObject(NvGpuQueryDriverVersion()))->Buffer);
-    SetDlgItemText(DetailsHandle, IDC_EDIT14, ((PPH_STRING)PhAutoDereferenceObject(NvGpuQueryRamType()))->Buffer);
-    //SetDlgItemText(DetailsHandle, IDC_EDIT13, NvGpuDriverIsWHQL() ? L"WHQL" : L"");
+    SetDlgItemText(DetailsHandle, IDC_EDIT1, Device->Name->Buffer);
+    SetDlgItemText(DetailsHandle, IDC_EDIT2, Device->ShortName->Buffer);
+    SetDlgItemText(DetailsHandle, IDC_EDIT3, Device->VbiosVersion->Buffer);
+    SetDlgItemText(DetailsHandle, IDC_EDIT4, Device->Revision->Buffer);
+    SetDlgItemText(DetailsHandle, IDC_EDIT5, Device->DeviceId->Buffer);
+    SetDlgItemText(DetailsHandle, IDC_EDIT6, Device->RopsCount->Buffer);
+    SetDlgItemText(DetailsHandle, IDC_EDIT10, NvGpuDriverVersion->Buffer);
+    SetDlgItemText(DetailsHandle, IDC_EDIT14, Device->RamType->Buffer);
+    //SetDlgItemText(DetailsHandle, IDC_EDIT13, NvGpuDriverIsWHQL(Device) ? L"WHQL" : L"");
 }
 
 INT_PTR CALLBACK DetailsDlgProc(
@@ -69,10 +70,10 @@ INT_PTR CALLBACK DetailsDlgProc(
     {
     case WM_INITDIALOG:
         {
-            SetWindowText(hwndDlg, ((PPH_STRING)PhAutoDereferenceObject(NvGpuQueryName()))->Buffer);
+            SetWindowText(hwndDlg, context->Device->Name->Buffer);
             PhCenterWindow(hwndDlg, GetParent(hwndDlg));
 
-            NvUpdateDetails(hwndDlg);
+            NvUpdateDetails(hwndDlg, context->Device);
         }
         break;
     case WM_COMMAND:
@@ -0,0 +1,135 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Nvidia GPU Plugin
+ *
+ * Copyright (C) 2016 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include "gpujoin.h"
+
+void NvGpuJoinInitialize(
+    PNVGPU_JOIN Join,
+    PNVGPU_JOIN_ENTRY Entries,
+    size_t Capacity
+    )
+{
+    Join->Entries = Entries;
+    Join->Capacity = Capacity;
+    Join->Count = 0;
+}
+
+void NvGpuJoinReset(
+    PNVGPU_JOIN Join
+    )
+{
+    Join->Count = 0;
+}
+
+/**
+ * Adds the active-app list of one GPU. Call NvGpuJoinFinish once every GPU has been
+ * added.
+ *
+ * \return Zero if the table is full; the processes that fit are still added.
+ */
+int NvGpuJoinAddDevice(
+    PNVGPU_JOIN Join,
+    uint32_t DeviceIndex,
+    const uint32_t *ProcessIds,
+    size_t Count
+    )
+{
+    uint32_t mask = DeviceIndex < 32 ? (uint32_t)1 << DeviceIndex : 0;
+
+    for (size_t i = 0; i < Count; i++)
+    {
+        if (Join->Count == Join->Capacity)
+            return 0;
+
+        Join->Entries[Join->Count].ProcessId = ProcessIds[i];
+        Join->Entries[Join->Count].DeviceMask = mask;
+        Join->Count++;
+    }
+
+    return 1;
+}
+
+static int NvGpuJoinCompareFunction(
+    const void *elem1,
+    const void *elem2
+    )
+{
+    uint32_t processId1 = ((const NVGPU_JOIN_ENTRY *)elem1)->ProcessId;
+    uint32_t processId2 = ((const NVGPU_JOIN_ENTRY *)elem2)->ProcessId;
+
+    return (processId1 > processId2) - (processId1 < processId2);
+}
+
+/**
+ * Sorts the table by process ID and merges the entries of processes that appear on
+ * several GPUs, or more than once on the same GPU.
+ */
+void NvGpuJoinFinish(
+    PNVGPU_JOIN Join
+    )
+{
+    size_t count = 0;
+
+    if (Join->Count == 0)
+        return;
+
+    qsort(Join->Entries, Join->Count, sizeof(NVGPU_JOIN_ENTRY), NvGpuJoinCompareFunction);
+
+    for (size_t i = 1; i < Join->Count; i++)
+    {
+        if (Join->Entries[i].ProcessId == Join->Entries[count].ProcessId)
+            Join->Entries[count].DeviceMask |= Join->Entries[i].DeviceMask;
+        else
+            Join->Entries[++count] = Join->Entries[i];
+    }
+
+    Join->Count = count + 1;
+}
+
+/**
+ * Finds the GPUs a process has a context on.
+ *
+ * \return The device mask, or zero if the process is on no GPU.
+ */
+uint32_t NvGpuJoinLookup(
+    PNVGPU_JOIN Join,
+    uint32_t ProcessId
+    )
+{
+    size_t low = 0;
+    size_t high = Join->Count;
+
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+
+        if (Join->Entries[middle].ProcessId < ProcessId)
+            low = middle + 1;
+        else if (Join->Entries[middle].ProcessId > ProcessId)
+            high = middle;
+        else
+            return Join->Entries[middle].DeviceMask;
+    }
+
+    return 0;
+}
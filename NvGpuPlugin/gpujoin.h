@@ -0,0 +1,72 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Nvidia GPU Plugin
+ *
+ * Copyright (C) 2016 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GPUJOIN_H
+#define _GPUJOIN_H
+
+// Joins the per-GPU active-app lists into one process ID -> GPU mask table. This unit
+// only depends on the C runtime so that it can be tested on its own (see
+// tests\gpujoin_test.c).
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct _NVGPU_JOIN_ENTRY
+{
+    uint32_t ProcessId;
+    uint32_t DeviceMask; // bit n is set if the process has a context on GPU n (n < 32)
+} NVGPU_JOIN_ENTRY, *PNVGPU_JOIN_ENTRY;
+
+typedef struct _NVGPU_JOIN
+{
+    PNVGPU_JOIN_ENTRY Entries; // caller-owned
+    size_t Capacity;
+    size_t Count;
+} NVGPU_JOIN, *PNVGPU_JOIN;
+
+void NvGpuJoinInitialize(
+    PNVGPU_JOIN Join,
+    PNVGPU_JOIN_ENTRY Entries,
+    size_t Capacity
+    );
+
+void NvGpuJoinReset(
+    PNVGPU_JOIN Join
+    );
+
+int NvGpuJoinAddDevice(
+    PNVGPU_JOIN Join,
+    uint32_t DeviceIndex,
+    const uint32_t *ProcessIds,
+    size_t Count
+    );
+
+void NvGpuJoinFinish(
+    PNVGPU_JOIN Join
+    );
+
+uint32_t NvGpuJoinLookup(
+    PNVGPU_JOIN Join,
+    uint32_t ProcessId
+    );
+
+#endif
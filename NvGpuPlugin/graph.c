@@ -25,6 +25,24 @@
 static RECT NormalGraphTextMargin = { 5, 5, 5, 5 };
 static RECT NormalGraphTextPadding = { 3, 3, 3, 3 };
 
+static ULONG64 NvGpuZoomSpans[] =
+{
+    0,
+    10 * 60 * 1000,
+    60 * 60 * 1000,
+    6 * 60 * 60 * 1000,
+    HISTORY_MAXIMUM_SPAN
+};
+
+static PWSTR NvGpuZoomNames[] =
+{
+    L"Recent samples",
+    L"Last 10 minutes",
+    L"Last hour",
+    L"Last 6 hours",
+    L"Last 24 hours"
+};
+
 INT_PTR CALLBACK NvGpuPanelDialogProc(
     _In_ HWND hwndDlg,
     _In_ UINT uMsg,
@@ -258,6 +276,88 @@ VOID NvGpuLayoutGraphs(
     EndDeferWindowPos(deferHandle);
 }
 
+VOID NvGpuGetZoomedGraphData(
+    _In_ PPH_NVGPU_SYSINFO_CONTEXT Context,
+    _In_ PHISTORY_STORE Store,
+    _Inout_ PNVGPU_ZOOMED_GRAPH Graph,
+    _In_ FLOAT Scale,
+    _In_ PPH_GRAPH_DRAW_INFO DrawInfo,
+    _Out_writes_(DrawInfo->LineDataCount) PFLOAT Data1,
+    _Out_writes_(DrawInfo->LineDataCount) PFLOAT Data2
+    )
+{
+    if (Graph->PointCount != DrawInfo->LineDataCount)
+    {
+        if (Graph->Points)
+            PhFree(Graph->Points);
+
+        Graph->PointCount = DrawInfo->LineDataCount;
+        Graph->Points = Graph->PointCount ? PhAllocate(Graph->PointCount * sizeof(HISTORY_BUCKET)) : NULL;
+    }
+
+    HistoryQueryRange(Store, Context->HistoryEndTime, Context->HistorySpan, Graph->PointCount, Graph->Points);
+
+    // Each point covers many samples: draw the average, and the peak as the second line.
+
+    for (ULONG i = 0; i < DrawInfo->LineDataCount; i++)
+    {
+        Data1[i] = Graph->Points[i].Average;
+        Data2[i] = Graph->Points[i].Maximum;
+    }
+
+    if (Scale != 0 && Scale != 1)
+    {
+        PhDivideSinglesBySingle(Data1, Scale, DrawInfo->LineDataCount);
+        PhDivideSinglesBySingle(Data2, Scale, DrawInfo->LineDataCount);
+    }
+}
+
+PPH_STRING NvGpuGetZoomedTooltipText(
+    _In_ PPH_NVGPU_SYSINFO_CONTEXT Context,
+    _In_ PNVGPU_ZOOMED_GRAPH Graph,
+    _In_ ULONG Index,
+    _In_ BOOLEAN Memory
+    )
+{
+    PHISTORY_BUCKET point;
+    LARGE_INTEGER time;
+    SYSTEMTIME systemTime;
+    PPH_STRING timeString;
+
+    if (Index >= Graph->PointCount)
+        return PhReferenceEmptyString();
+
+    point = &Graph->Points[Index];
+    time.QuadPart = (Context->HistoryEndTime - Context->HistorySpan * Index / Graph->PointCount) * PH_TICKS_PER_MS;
+    PhLargeIntegerToLocalSystemTime(&systemTime, &time);
+    timeString = PH_AUTO(PhFormatDateTime(&systemTime));
+
+    if (point->Count == 0)
+    {
+        return PhFormatString(L"No data\n%s", timeString->Buffer);
+    }
+    else if (Memory)
+    {
+        return PhFormatString(
+            L"%s (min %s, max %s)\n%s",
+            PhaFormatSize((ULONG64)point->Average * 1024, -1)->Buffer,
+            PhaFormatSize((ULONG64)point->Minimum * 1024, -1)->Buffer,
+            PhaFormatSize((ULONG64)point->Maximum * 1024, -1)->Buffer,
+            timeString->Buffer
+            );
+    }
+    else
+    {
+        return PhFormatString(
+            L"%.0f%% (min %.0f%%, max %.0f%%)\n%s",
+            point->Average * 100,
+            point->Minimum * 100,
+            point->Maximum * 100,
+            timeString->Buffer
+            );
+    }
+}
+
 VOID NvGpuNotifyUsageGraph(
     _Inout_ PPH_NVGPU_SYSINFO_CONTEXT Context,
     _In_ NMHDR *Header
@@ -271,15 +371,24 @@ VOID NvGpuNotifyUsageGraph(
             PPH_GRAPH_DRAW_INFO drawInfo = getDrawInfo->DrawInfo;
 
             drawInfo->Flags = PH_GRAPH_USE_GRID_X | PH_GRAPH_USE_GRID_Y;
-            Context->Section->Parameters->ColorSetupFunction(drawInfo, PhGetIntegerSetting(L"ColorCpuKernel"), 0);
-            PhGraphStateGetDrawInfo(&Context->GpuGraphState, getDrawInfo, GpuUtilizationHistory.Count);
+            Context->Section->Parameters->ColorSetupFunction(drawInfo, PhGetIntegerSetting(L"ColorCpuKernel"), PhGetIntegerSetting(L"ColorCpuUser"));
+
+            if (Context->HistorySpan != 0)
+            {
+                drawInfo->Flags |= PH_GRAPH_USE_LINE_2;
+                PhGraphStateGetDrawInfo(&Context->GpuGraphState, getDrawInfo, ULONG_MAX);
+            }
+            else
+            {
+                PhGraphStateGetDrawInfo(&Context->GpuGraphState, getDrawInfo, Context->Device->UtilizationHistory.Count);
+            }
 
             if (PhGetIntegerSetting(L"GraphShowText"))
             {
                 HDC hdc = Graph_GetBufferedContext(Context->GpuGraphHandle);
 
                 PhMoveReference(&Context->GpuGraphState.Text,
-                    PhFormatString(L"%.0f%%", GpuCurrentGpuUsage * 100)
+                    PhFormatString(L"%.0f%%", Context->Device->GpuUsage * 100)
                     );
 
                 SelectObject(hdc, PhApplicationFont);
@@ -293,7 +402,15 @@ VOID NvGpuNotifyUsageGraph(
 
             if (!Context->GpuGraphState.Valid)
             {
-                PhCopyCircularBuffer_FLOAT(&GpuUtilizationHistory, Context->GpuGraphState.Data1, drawInfo->LineDataCount);
+                if (Context->HistorySpan != 0)
+                {
+                    NvGpuGetZoomedGraphData(Context, &Context->Device->UtilizationLongHistory, &Context->GpuZoom, 1, drawInfo, Context->GpuGraphState.Data1, Context->GpuGraphState.Data2);
+                }
+                else
+                {
+                    PhCopyCircularBuffer_FLOAT(&Context->Device->UtilizationHistory, Context->GpuGraphState.Data1, drawInfo->LineDataCount);
+                }
+
                 Context->GpuGraphState.Valid = TRUE;
             }
         }
@@ -306,15 +423,22 @@ VOID NvGpuNotifyUsageGraph(
             {
                 if (Context->GpuGraphState.TooltipIndex != getTooltipText->Index)
                 {
-                    FLOAT gpuUsageValue;
-
-                    gpuUsageValue = PhGetItemCircularBuffer_FLOAT(&GpuUtilizationHistory, getTooltipText->Index);
-
-                    PhMoveReference(&Context->GpuGraphState.TooltipText, PhFormatString(
-                        L"%.0f%%\n%s",
-                        gpuUsageValue * 100,
-                        ((PPH_STRING)PH_AUTO(PhGetStatisticsTimeString(NULL, getTooltipText->Index)))->Buffer
-                        ));
+                    if (Context->HistorySpan != 0)
+                    {
+                        PhMoveReference(&Context->GpuGraphState.TooltipText, NvGpuGetZoomedTooltipText(Context, &Context->GpuZoom, getTooltipText->Index, FALSE));
+                    }
+                    else
+                    {
+                        FLOAT gpuUsageValue;
+
+                        gpuUsageValue = PhGetItemCircularBuffer_FLOAT(&Context->Device->UtilizationHistory, getTooltipText->Index);
+
+                        PhMoveReference(&Context->GpuGraphState.TooltipText, PhFormatString(
+                            L"%.0f%%\n%s",
+                            gpuUsageValue * 100,
+                            ((PPH_STRING)PH_AUTO(PhGetStatisticsTimeString(NULL, getTooltipText->Index)))->Buffer
+                            ));
+                    }
                 }
 
                 getTooltipText->Text = Context->GpuGraphState.TooltipText->sr;
@@ -337,8 +461,17 @@ VOID NvGpuNotifyMemoryGraph(
             PPH_GRAPH_DRAW_INFO drawInfo = getDrawInfo->DrawInfo;
 
             drawInfo->Flags = PH_GRAPH_USE_GRID_X | PH_GRAPH_USE_GRID_Y;
-            Context->Section->Parameters->ColorSetupFunction(drawInfo, PhGetIntegerSetting(L"ColorPhysical"), 0);
-            PhGraphStateGetDrawInfo(&Context->MemGraphState, getDrawInfo, GpuMemoryHistory.Count);
+            Context->Section->Parameters->ColorSetupFunction(drawInfo, PhGetIntegerSetting(L"ColorPhysical"), PhGetIntegerSetting(L"ColorCpuUser"));
+
+            if (Context->HistorySpan != 0)
+            {
+                drawInfo->Flags |= PH_GRAPH_USE_LINE_2;
+                PhGraphStateGetDrawInfo(&Context->MemGraphState, getDrawInfo, ULONG_MAX);
+            }
+            else
+            {
+                PhGraphStateGetDrawInfo(&Context->MemGraphState, getDrawInfo, Context->Device->MemoryHistory.Count);
+            }
 
             if (PhGetIntegerSetting(L"GraphShowText"))
             {
@@ -346,9 +479,9 @@ VOID NvGpuNotifyMemoryGraph(
 
                 PhMoveReference(&Context->MemGraphState.Text, PhFormatString(
                     L"%s / %s (%.2f%%)", 
-                    PhaFormatSize(UInt32x32To64(GpuCurrentMemUsage, 1024), -1)->Buffer,
-                    PhaFormatSize(UInt32x32To64(GpuMemoryLimit, 1024), -1)->Buffer,
-                    (FLOAT)GpuCurrentMemUsage / GpuMemoryLimit * 100
+                    PhaFormatSize(UInt32x32To64(Context->Device->MemUsage, 1024), -1)->Buffer,
+                    PhaFormatSize(UInt32x32To64(Context->Device->MemoryLimit, 1024), -1)->Buffer,
+                    (FLOAT)Context->Device->MemUsage / Context->Device->MemoryLimit * 100
                     ));
 
                 SelectObject(hdc, PhApplicationFont);
@@ -362,19 +495,26 @@ VOID NvGpuNotifyMemoryGraph(
 
             if (!Context->MemGraphState.Valid)
             {
-                for (ULONG i = 0; i < drawInfo->LineDataCount; i++)
+                if (Context->HistorySpan != 0)
                 {
-                    Context->MemGraphState.Data1[i] = (FLOAT)PhGetItemCircularBuffer_ULONG(&GpuMemoryHistory, i);
+                    NvGpuGetZoomedGraphData(Context, &Context->Device->MemoryLongHistory, &Context->MemZoom, (FLOAT)Context->Device->MemoryLimit, drawInfo, Context->MemGraphState.Data1, Context->MemGraphState.Data2);
                 }
-
-                if (GpuMemoryLimit != 0)
+                else
                 {
-                    // Scale the data.
-                    PhDivideSinglesBySingle(
-                        Context->MemGraphState.Data1,
-                        (FLOAT)GpuMemoryLimit,
-                        drawInfo->LineDataCount
-                        );
+                    for (ULONG i = 0; i < drawInfo->LineDataCount; i++)
+                    {
+                        Context->MemGraphState.Data1[i] = (FLOAT)PhGetItemCircularBuffer_ULONG(&Context->Device->MemoryHistory, i);
+                    }
+
+                    if (Context->Device->MemoryLimit != 0)
+                    {
+                        // Scale the data.
+                        PhDivideSinglesBySingle(
+                            Context->MemGraphState.Data1,
+                            (FLOAT)Context->Device->MemoryLimit,
+                            drawInfo->LineDataCount
+                            );
+                    }
                 }
 
                 Context->MemGraphState.Valid = TRUE;
@@ -389,17 +529,24 @@ VOID NvGpuNotifyMemoryGraph(
             {
                 if (Context->MemGraphState.TooltipIndex != getTooltipText->Index)
                 {
-                    ULONG usedPages;
-
-                    usedPages = PhGetItemCircularBuffer_ULONG(&GpuMemoryHistory, getTooltipText->Index);
-
-                    PhMoveReference(&Context->MemGraphState.TooltipText, PhFormatString(
-                        L"%s / %s (%.2f%%)\n%s",
-                        PhaFormatSize(UInt32x32To64(usedPages, 1024), -1)->Buffer,
-                        PhaFormatSize(UInt32x32To64(GpuMemoryLimit, 1024), -1)->Buffer,
-                        (FLOAT)usedPages / GpuMemoryLimit * 100,
-                        ((PPH_STRING)PH_AUTO(PhGetStatisticsTimeString(NULL, getTooltipText->Index)))->Buffer
-                        ));
+                    if (Context->HistorySpan != 0)
+                    {
+                        PhMoveReference(&Context->MemGraphState.TooltipText, NvGpuGetZoomedTooltipText(Context, &Context->MemZoom, getTooltipText->Index, TRUE));
+                    }
+                    else
+                    {
+                        ULONG usedPages;
+
+                        usedPages = PhGetItemCircularBuffer_ULONG(&Context->Device->MemoryHistory, getTooltipText->Index);
+
+                        PhMoveReference(&Context->MemGraphState.TooltipText, PhFormatString(
+                            L"%s / %s (%.2f%%)\n%s",
+                            PhaFormatSize(UInt32x32To64(usedPages, 1024), -1)->Buffer,
+                            PhaFormatSize(UInt32x32To64(Context->Device->MemoryLimit, 1024), -1)->Buffer,
+                            (FLOAT)usedPages / Context->Device->MemoryLimit * 100,
+                            ((PPH_STRING)PH_AUTO(PhGetStatisticsTimeString(NULL, getTooltipText->Index)))->Buffer
+                            ));
+                    }
                 }
 
                 getTooltipText->Text = Context->MemGraphState.TooltipText->sr;
@@ -422,8 +569,17 @@ VOID NvGpuNotifySharedGraph(
             PPH_GRAPH_DRAW_INFO drawInfo = getDrawInfo->DrawInfo;
 
             drawInfo->Flags = PH_GRAPH_USE_GRID_X | PH_GRAPH_USE_GRID_Y;
-            Context->Section->Parameters->ColorSetupFunction(drawInfo, PhGetIntegerSetting(L"ColorCpuKernel"), 0);
-            PhGraphStateGetDrawInfo(&Context->SharedGraphState, getDrawInfo, GpuBoardHistory.Count);
+            Context->Section->Parameters->ColorSetupFunction(drawInfo, PhGetIntegerSetting(L"ColorCpuKernel"), PhGetIntegerSetting(L"ColorCpuUser"));
+
+            if (Context->HistorySpan != 0)
+            {
+                drawInfo->Flags |= PH_GRAPH_USE_LINE_2;
+                PhGraphStateGetDrawInfo(&Context->SharedGraphState, getDrawInfo, ULONG_MAX);
+            }
+            else
+            {
+                PhGraphStateGetDrawInfo(&Context->SharedGraphState, getDrawInfo, Context->Device->BoardHistory.Count);
+            }
 
             if (PhGetIntegerSetting(L"GraphShowText"))
             {
@@ -431,7 +587,7 @@ VOID NvGpuNotifySharedGraph(
 
                 PhMoveReference(&Context->SharedGraphState.Text, PhFormatString(
                     L"%.0f%%",
-                    (FLOAT)GpuCurrentCoreUsage * 100
+                    (FLOAT)Context->Device->CoreUsage * 100
                     ));
 
                 SelectObject(hdc, PhApplicationFont);
@@ -445,7 +601,15 @@ VOID NvGpuNotifySharedGraph(
 
             if (!Context->SharedGraphState.Valid)
             {
-                PhCopyCircularBuffer_FLOAT(&GpuBoardHistory, Context->SharedGraphState.Data1, drawInfo->LineDataCount);
+                if (Context->HistorySpan != 0)
+                {
+                    NvGpuGetZoomedGraphData(Context, &Context->Device->BoardLongHistory, &Context->SharedZoom, 1, drawInfo, Context->SharedGraphState.Data1, Context->SharedGraphState.Data2);
+                }
+                else
+                {
+                    PhCopyCircularBuffer_FLOAT(&Context->Device->BoardHistory, Context->SharedGraphState.Data1, drawInfo->LineDataCount);
+                }
+
                 Context->SharedGraphState.Valid = TRUE;
             }
         }
@@ -458,15 +622,22 @@ VOID NvGpuNotifySharedGraph(
             {
                 if (Context->SharedGraphState.TooltipIndex != getTooltipText->Index)
                 {
-                    FLOAT usedPages;
-
-                    usedPages = PhGetItemCircularBuffer_FLOAT(&GpuBoardHistory, getTooltipText->Index);
-
-                    PhMoveReference(&Context->SharedGraphState.TooltipText, PhFormatString(
-                        L"%.0f%%\n%s",
-                        usedPages * 100,
-                        ((PPH_STRING)PH_AUTO(PhGetStatisticsTimeString(NULL, getTooltipText->Index)))->Buffer
-                        ));
+                    if (Context->HistorySpan != 0)
+                    {
+                        PhMoveReference(&Context->SharedGraphState.TooltipText, NvGpuGetZoomedTooltipText(Context, &Context->SharedZoom, getTooltipText->Index, FALSE));
+                    }
+                    else
+                    {
+                        FLOAT usedPages;
+
+                        usedPages = PhGetItemCircularBuffer_FLOAT(&Context->Device->BoardHistory, getTooltipText->Index);
+
+                        PhMoveReference(&Context->SharedGraphState.TooltipText, PhFormatString(
+                            L"%.0f%%\n%s",
+                            usedPages * 100,
+                            ((PPH_STRING)PH_AUTO(PhGetStatisticsTimeString(NULL, getTooltipText->Index)))->Buffer
+                            ));
+                    }
                 }
 
                 getTooltipText->Text = Context->SharedGraphState.TooltipText->sr;
@@ -489,8 +660,17 @@ VOID NvGpuNotifyBusGraph(
             PPH_GRAPH_DRAW_INFO drawInfo = getDrawInfo->DrawInfo;
 
             drawInfo->Flags = PH_GRAPH_USE_GRID_X | PH_GRAPH_USE_GRID_Y;
-            Context->Section->Parameters->ColorSetupFunction(drawInfo, PhGetIntegerSetting(L"ColorCpuKernel"), 0);
-            PhGraphStateGetDrawInfo(&Context->BusGraphState, getDrawInfo, GpuBusHistory.Count);
+            Context->Section->Parameters->ColorSetupFunction(drawInfo, PhGetIntegerSetting(L"ColorCpuKernel"), PhGetIntegerSetting(L"ColorCpuUser"));
+
+            if (Context->HistorySpan != 0)
+            {
+                drawInfo->Flags |= PH_GRAPH_USE_LINE_2;
+                PhGraphStateGetDrawInfo(&Context->BusGraphState, getDrawInfo, ULONG_MAX);
+            }
+            else
+            {
+                PhGraphStateGetDrawInfo(&Context->BusGraphState, getDrawInfo, Context->Device->BusHistory.Count);
+            }
 
             if (PhGetIntegerSetting(L"GraphShowText"))
             {
@@ -498,7 +678,7 @@ VOID NvGpuNotifyBusGraph(
 
                 PhMoveReference(&Context->BusGraphState.Text, PhFormatString(
                     L"%.0f%%",
-                    (FLOAT)GpuCurrentBusUsage * 100
+                    (FLOAT)Context->Device->BusUsage * 100
                     ));
 
                 SelectObject(hdc, PhApplicationFont);
@@ -512,7 +692,15 @@ VOID NvGpuNotifyBusGraph(
 
             if (!Context->BusGraphState.Valid)
             {
-                PhCopyCircularBuffer_FLOAT(&GpuBusHistory, Context->BusGraphState.Data1, drawInfo->LineDataCount);
+                if (Context->HistorySpan != 0)
+                {
+                    NvGpuGetZoomedGraphData(Context, &Context->Device->BusLongHistory, &Context->BusZoom, 1, drawInfo, Context->BusGraphState.Data1, Context->BusGraphState.Data2);
+                }
+                else
+                {
+                    PhCopyCircularBuffer_FLOAT(&Context->Device->BusHistory, Context->BusGraphState.Data1, drawInfo->LineDataCount);
+                }
+
                 Context->BusGraphState.Valid = TRUE;
             }
         }
@@ -525,15 +713,22 @@ VOID NvGpuNotifyBusGraph(
             {
                 if (Context->BusGraphState.TooltipIndex != getTooltipText->Index)
                 {
-                    FLOAT busUsage;
-
-                    busUsage = PhGetItemCircularBuffer_FLOAT(&GpuBusHistory, getTooltipText->Index);
-
-                    PhMoveReference(&Context->BusGraphState.TooltipText, PhFormatString(
-                        L"%.0f%%\n%s",
-                        busUsage * 100,
-                        ((PPH_STRING)PH_AUTO(PhGetStatisticsTimeString(NULL, getTooltipText->Index)))->Buffer
-                        ));
+                    if (Context->HistorySpan != 0)
+                    {
+                        PhMoveReference(&Context->BusGraphState.TooltipText, NvGpuGetZoomedTooltipText(Context, &Context->BusZoom, getTooltipText->Index, FALSE));
+                    }
+                    else
+                    {
+                        FLOAT busUsage;
+
+                        busUsage = PhGetItemCircularBuffer_FLOAT(&Context->Device->BusHistory, getTooltipText->Index);
+
+                        PhMoveReference(&Context->BusGraphState.TooltipText, PhFormatString(
+                            L"%.0f%%\n%s",
+                            busUsage * 100,
+                            ((PPH_STRING)PH_AUTO(PhGetStatisticsTimeString(NULL, getTooltipText->Index)))->Buffer
+                            ));
+                    }
                 }
 
                 getTooltipText->Text = Context->BusGraphState.TooltipText->sr;
@@ -547,59 +742,126 @@ VOID NvGpuUpdateGraphs(
     _Inout_ PPH_NVGPU_SYSINFO_CONTEXT Context
     )
 {
+    if (Context->HistorySpan != 0)
+    {
+        LARGE_INTEGER systemTime;
+
+        // All four graphs are queried for the same range so their points line up.
+        PhQuerySystemTime(&systemTime);
+        Context->HistoryEndTime = systemTime.QuadPart / PH_TICKS_PER_MS;
+    }
+
     Context->GpuGraphState.Valid = FALSE;
     Context->GpuGraphState.TooltipIndex = -1;
-    Graph_MoveGrid(Context->GpuGraphHandle, 1);
+    if (Context->HistorySpan == 0)
+        Graph_MoveGrid(Context->GpuGraphHandle, 1);
     Graph_Draw(Context->GpuGraphHandle);
     Graph_UpdateTooltip(Context->GpuGraphHandle);
     InvalidateRect(Context->GpuGraphHandle, NULL, FALSE);
 
     Context->MemGraphState.Valid = FALSE;
     Context->MemGraphState.TooltipIndex = -1;
-    Graph_MoveGrid(Context->MemGraphHandle, 1);
+    if (Context->HistorySpan == 0)
+        Graph_MoveGrid(Context->MemGraphHandle, 1);
     Graph_Draw(Context->MemGraphHandle);
     Graph_UpdateTooltip(Context->MemGraphHandle);
     InvalidateRect(Context->MemGraphHandle, NULL, FALSE);
 
     Context->SharedGraphState.Valid = FALSE;
     Context->SharedGraphState.TooltipIndex = -1;
-    Graph_MoveGrid(Context->SharedGraphHandle, 1);
+    if (Context->HistorySpan == 0)
+        Graph_MoveGrid(Context->SharedGraphHandle, 1);
     Graph_Draw(Context->SharedGraphHandle);
     Graph_UpdateTooltip(Context->SharedGraphHandle);
     InvalidateRect(Context->SharedGraphHandle, NULL, FALSE);
 
     Context->BusGraphState.Valid = FALSE;
     Context->BusGraphState.TooltipIndex = -1;
-    Graph_MoveGrid(Context->BusGraphHandle, 1);
+    if (Context->HistorySpan == 0)
+        Graph_MoveGrid(Context->BusGraphHandle, 1);
     Graph_Draw(Context->BusGraphHandle);
     Graph_UpdateTooltip(Context->BusGraphHandle);
     InvalidateRect(Context->BusGraphHandle, NULL, FALSE);
 }
 
+VOID NvGpuShowZoomMenu(
+    _Inout_ PPH_NVGPU_SYSINFO_CONTEXT Context
+    )
+{
+    POINT cursorPos;
+    PPH_EMENU menu;
+    PPH_EMENU_ITEM selectedItem;
+
+    GetCursorPos(&cursorPos);
+
+    menu = PhCreateEMenu();
+
+    for (ULONG i = 0; i < RTL_NUMBER_OF(NvGpuZoomSpans); i++)
+    {
+        PhInsertEMenuItem(
+            menu,
+            PhCreateEMenuItem(Context->HistorySpan == NvGpuZoomSpans[i] ? PH_EMENU_CHECKED : 0, i + 1, NvGpuZoomNames[i], NULL, NULL),
+            -1
+            );
+    }
+
+    selectedItem = PhShowEMenu(
+        menu,
+        Context->WindowHandle,
+        PH_EMENU_SHOW_LEFTRIGHT,
+        PH_ALIGN_LEFT | PH_ALIGN_TOP,
+        cursorPos.x,
+        cursorPos.y
+        );
+
+    if (selectedItem && selectedItem->Id != 0 && selectedItem->Id <= RTL_NUMBER_OF(NvGpuZoomSpans))
+    {
+        Context->HistorySpan = NvGpuZoomSpans[selectedItem->Id - 1];
+        NvGpuUpdateGraphs(Context);
+    }
+
+    PhDestroyEMenu(menu);
+}
+
+VOID NvGpuDeleteZoomedGraph(
+    _Inout_ PNVGPU_ZOOMED_GRAPH Graph
+    )
+{
+    if (Graph->Points)
+    {
+        PhFree(Graph->Points);
+        Graph->Points = NULL;
+    }
+
+    Graph->PointCount = 0;
+}
+
 VOID NvGpuUpdatePanel(
     _Inout_ PPH_NVGPU_SYSINFO_CONTEXT Context
     )
 {
-    NvGpuUpdateVoltage();
+    PNVGPU_DEVICE device = Context->Device;
+
+    // Values come from the last provider tick; nothing here calls into the driver.
+    PhSetDialogItemText(Context->GpuPanel, IDC_FAN_PERCENT, ((PPH_STRING)PH_AUTO(NvGpuFormatFanSpeed(device)))->Buffer);
 
-    PhSetDialogItemText(Context->GpuPanel, IDC_CLOCK_CORE, PhaFormatString(L"%lu MHz", GpuCurrentCoreClock)->Buffer);
-    PhSetDialogItemText(Context->GpuPanel, IDC_CLOCK_MEMORY, PhaFormatString(L"%lu MHz", GpuCurrentMemoryClock)->Buffer);
-    PhSetDialogItemText(Context->GpuPanel, IDC_CLOCK_SHADER, PhaFormatString(L"%lu MHz", GpuCurrentShaderClock)->Buffer);
-    PhSetDialogItemText(Context->GpuPanel, IDC_FAN_PERCENT, ((PPH_STRING)PH_AUTO(NvGpuQueryFanSpeed()))->Buffer);
+    PhSetDialogItemText(Context->GpuPanel, IDC_CLOCK_CORE, PhaFormatString(L"%lu MHz", device->CoreClock)->Buffer);
+    PhSetDialogItemText(Context->GpuPanel, IDC_CLOCK_MEMORY, PhaFormatString(L"%lu MHz", device->MemoryClock)->Buffer);
+    PhSetDialogItemText(Context->GpuPanel, IDC_CLOCK_SHADER, PhaFormatString(L"%lu MHz", device->ShaderClock)->Buffer);
 
     if (PhGetIntegerSetting(SETTING_NAME_ENABLE_FAHRENHEIT))
     {
-        FLOAT fahrenheit = (FLOAT)(GpuCurrentCoreTemp * 1.8 + 32);
+        FLOAT fahrenheit = (FLOAT)(device->CoreTemp * 1.8 + 32);
 
         PhSetDialogItemText(Context->GpuPanel, IDC_TEMP_VALUE, PhaFormatString(L"%.1f\u00b0F", fahrenheit)->Buffer);
     }
     else
     {
-        PhSetDialogItemText(Context->GpuPanel, IDC_TEMP_VALUE, PhaFormatString(L"%lu\u00b0C", GpuCurrentCoreTemp)->Buffer);
+        PhSetDialogItemText(Context->GpuPanel, IDC_TEMP_VALUE, PhaFormatString(L"%lu\u00b0C", device->CoreTemp)->Buffer);
     }
 
     //PhSetDialogItemText(Context->GpuPanel, IDC_TEMP_VALUE, PhaFormatString(L"%s\u00b0C", PhaFormatUInt64(GpuCurrentBoardTemp, TRUE)->Buffer)->Buffer);
-    PhSetDialogItemText(Context->GpuPanel, IDC_VOLTAGE, PhaFormatString(L"%lu mV", GpuCurrentVoltage)->Buffer);
+    PhSetDialogItemText(Context->GpuPanel, IDC_VOLTAGE, PhaFormatString(L"%lu mV", device->Voltage)->Buffer);
 }
 
 INT_PTR CALLBACK NvGpuDialogProc(
@@ -630,6 +892,11 @@ INT_PTR CALLBACK NvGpuDialogProc(
             PhDeleteGraphState(&context->SharedGraphState);
             PhDeleteGraphState(&context->BusGraphState);
 
+            NvGpuDeleteZoomedGraph(&context->GpuZoom);
+            NvGpuDeleteZoomedGraph(&context->MemZoom);
+            NvGpuDeleteZoomedGraph(&context->SharedZoom);
+            NvGpuDeleteZoomedGraph(&context->BusZoom);
+
             if (context->GpuGraphHandle)
                 DestroyWindow(context->GpuGraphHandle);
             if (context->MemGraphHandle)
@@ -675,15 +942,18 @@ INT_PTR CALLBACK NvGpuDialogProc(
 
             SetWindowFont(GetDlgItem(hwndDlg, IDC_TITLE), context->Section->Parameters->LargeFont, FALSE);
             SetWindowFont(GetDlgItem(hwndDlg, IDC_GPUNAME), context->Section->Parameters->MediumFont, FALSE);
-            PhSetDialogItemText(hwndDlg, IDC_GPUNAME, context->GpuName->Buffer);
+            PhSetDialogItemText(hwndDlg, IDC_GPUNAME, context->Device->Name->Buffer);
 
             context->GpuPanel = CreateDialogParam(PluginInstance->DllBase, MAKEINTRESOURCE(IDD_GPU_PANEL), hwndDlg, NvGpuPanelDialogProc, (LPARAM)context);
             ShowWindow(context->GpuPanel, SW_SHOW);
             PhAddLayoutItemEx(&context->LayoutManager, context->GpuPanel, NULL, PH_ANCHOR_LEFT | PH_ANCHOR_RIGHT | PH_ANCHOR_BOTTOM, panelItem->Margin);
 
+            // The aggregate view has no single device to show details for.
+            if (context->Device->Aggregate)
+                ShowWindow(GetDlgItem(context->GpuPanel, IDC_DETAILS), SW_HIDE);
+
             NvGpuCreateGraphs(context);
 
-            NvGpuUpdateValues();
             NvGpuUpdateGraphs(context);
             NvGpuUpdatePanel(context);
         }
@@ -713,6 +983,19 @@ INT_PTR CALLBACK NvGpuDialogProc(
             }
         }
         break;
+    case WM_CONTEXTMENU:
+        {
+            HWND windowHandle = (HWND)wParam;
+
+            if (windowHandle == context->GpuGraphHandle ||
+                windowHandle == context->MemGraphHandle ||
+                windowHandle == context->SharedGraphHandle ||
+                windowHandle == context->BusGraphHandle)
+            {
+                NvGpuShowZoomMenu(context);
+            }
+        }
+        break;
     case MSG_UPDATE:
         {
             NvGpuUpdateGraphs(context);
@@ -739,8 +1022,8 @@ BOOLEAN NvGpuSectionCallback(
         return TRUE;
     case SysInfoDestroy:
         {
-            if (context->GpuName)
-                PhDereferenceObject(context->GpuName);
+            if (context->SectionName)
+                PhDereferenceObject(context->SectionName);
 
             PhFree(context);
         }
@@ -768,12 +1051,12 @@ BOOLEAN NvGpuSectionCallback(
             PPH_GRAPH_DRAW_INFO drawInfo = (PPH_GRAPH_DRAW_INFO)Parameter1;
 
             drawInfo->Flags = PH_GRAPH_USE_GRID_X | PH_GRAPH_USE_GRID_Y;
-            Section->Parameters->ColorSetupFunction(drawInfo, PhGetIntegerSetting(L"ColorCpuKernel"), 0);
-            PhGetDrawInfoGraphBuffers(&Section->GraphState.Buffers, drawInfo, GpuUtilizationHistory.Count);
+            Section->Parameters->ColorSetupFunction(drawInfo, PhGetIntegerSetting(L"ColorCpuKernel"), PhGetIntegerSetting(L"ColorCpuUser"));
+            PhGetDrawInfoGraphBuffers(&Section->GraphState.Buffers, drawInfo, context->Device->UtilizationHistory.Count);
 
             if (!Section->GraphState.Valid)
             {
-                PhCopyCircularBuffer_FLOAT(&GpuUtilizationHistory, Section->GraphState.Data1, drawInfo->LineDataCount);
+                PhCopyCircularBuffer_FLOAT(&context->Device->UtilizationHistory, Section->GraphState.Data1, drawInfo->LineDataCount);
                 Section->GraphState.Valid = TRUE;
             }
         }
@@ -783,7 +1066,7 @@ BOOLEAN NvGpuSectionCallback(
             FLOAT gpuUsageValue;
             PPH_SYSINFO_GRAPH_GET_TOOLTIP_TEXT getTooltipText = (PPH_SYSINFO_GRAPH_GET_TOOLTIP_TEXT)Parameter1;
 
-            gpuUsageValue = PhGetItemCircularBuffer_FLOAT(&GpuUtilizationHistory, getTooltipText->Index);
+            gpuUsageValue = PhGetItemCircularBuffer_FLOAT(&context->Device->UtilizationHistory, getTooltipText->Index);
 
             PhMoveReference(&Section->GraphState.TooltipText, PhFormatString(
                 L"%.0f%%\n%s",
@@ -801,7 +1084,7 @@ BOOLEAN NvGpuSectionCallback(
             drawPanel->Title = PhCreateString(Section->Name.Buffer);
             drawPanel->SubTitle = PhFormatString(
                 L"%.0f%%",
-                GpuCurrentGpuUsage * 100
+                context->Device->GpuUsage * 100
                 );
         }
         return TRUE;
@@ -810,8 +1093,9 @@ BOOLEAN NvGpuSectionCallback(
     return FALSE;
 }
 
-VOID NvGpuSysInfoInitializing(
-    _In_ PPH_PLUGIN_SYSINFO_POINTERS Pointers
+static VOID NvGpuCreateSection(
+    _In_ PPH_PLUGIN_SYSINFO_POINTERS Pointers,
+    _In_ PNVGPU_DEVICE Device
     )
 {
     PH_SYSINFO_SECTION section;
@@ -824,8 +1108,30 @@ VOID NvGpuSysInfoInitializing(
     section.Context = context;
     section.Callback = NvGpuSectionCallback;
 
-    context->GpuName = NvGpuQueryName();
-    PhInitializeStringRef(&section.Name, context->GpuName->Buffer);
+    context->Device = Device;
+
+    // Identical boards share a name, so number them when there is more than one.
+    if (NvGpuDeviceCount > 1 && !Device->Aggregate)
+        context->SectionName = PhFormatString(L"GPU %lu: %s", Device->Index, Device->Name->Buffer);
+    else
+        context->SectionName = PhReferenceObject(Device->Name);
+
+    PhInitializeStringRef(&section.Name, context->SectionName->Buffer);
 
     context->Section = Pointers->CreateSection(&section);
 }
+
+VOID NvGpuSysInfoInitializing(
+    _In_ PPH_PLUGIN_SYSINFO_POINTERS Pointers
+    )
+{
+    if (NvGpuDeviceCount > 1)
+    {
+        NvGpuCreateSection(Pointers, &NvGpuAggregate);
+    }
+
+    for (ULONG i = 0; i < NvGpuDeviceCount; i++)
+    {
+        NvGpuCreateSection(Pointers, &NvGpuDevices[i]);
+    }
+}
@@ -29,6 +29,11 @@ PH_CALLBACK_REGISTRATION PluginUnloadCallbackRegistration;
 PH_CALLBACK_REGISTRATION PluginShowOptionsCallbackRegistration;
 PH_CALLBACK_REGISTRATION ProcessesUpdatedCallbackRegistration;
 PH_CALLBACK_REGISTRATION SystemInformationInitializingCallbackRegistration;
+PH_CALLBACK_REGISTRATION TreeNewMessageCallbackRegistration;
+PH_CALLBACK_REGISTRATION ProcessTreeNewInitializingCallbackRegistration;
+PH_CALLBACK_REGISTRATION ProcessAddedCallbackRegistration;
+PH_CALLBACK_REGISTRATION ProcessRemovedCallbackRegistration;
+PH_CALLBACK_REGISTRATION GetProcessTooltipTextCallbackRegistration;
 
 VOID NTAPI LoadCallback(
     _In_opt_ PVOID Parameter,
@@ -38,6 +43,8 @@ VOID NTAPI LoadCallback(
     if (NvApiInitialized = InitializeNvApi())
     {
         NvGpuInitialize();
+        NvGpuProcessInitialize();
+        NvGpuStartPoller();
     }
 }
 
@@ -46,7 +53,10 @@ VOID NTAPI UnloadCallback(
     _In_opt_ PVOID Context
     )
 {
-    NOTHING;
+    if (NvApiInitialized)
+    {
+        NvGpuStopPoller();
+    }
 }
 
 VOID NTAPI ShowOptionsCallback(
@@ -81,6 +91,55 @@ VOID NTAPI SystemInformationInitializingCallback(
     }
 }
 
+VOID NTAPI TreeNewMessageCallback(
+    _In_opt_ PVOID Parameter,
+    _In_opt_ PVOID Context
+    )
+{
+    if (NvApiInitialized)
+    {
+        NvGpuProcessTreeNewMessage(Parameter);
+    }
+}
+
+VOID NTAPI ProcessTreeNewInitializingCallback(
+    _In_opt_ PVOID Parameter,
+    _In_opt_ PVOID Context
+    )
+{
+    if (NvApiInitialized)
+    {
+        NvGpuProcessTreeNewInitializing(Parameter);
+    }
+}
+
+VOID NTAPI GetProcessTooltipTextCallback(
+    _In_opt_ PVOID Parameter,
+    _In_opt_ PVOID Context
+    )
+{
+    if (NvApiInitialized)
+    {
+        NvGpuProcessGetTooltipText(Parameter);
+    }
+}
+
+VOID NTAPI ProcessAddedCallback(
+    _In_opt_ PVOID Parameter,
+    _In_opt_ PVOID Context
+    )
+{
+    NvGpuProcessAdded(Parameter);
+}
+
+VOID NTAPI ProcessRemovedCallback(
+    _In_opt_ PVOID Parameter,
+    _In_opt_ PVOID Context
+    )
+{
+    NvGpuProcessRemoved(Parameter);
+}
+
 LOGICAL DllMain(
     _In_ HINSTANCE Instance,
     _In_ ULONG Reason,
@@ -94,7 +153,9 @@ LOGICAL DllMain(
             PPH_PLUGIN_INFORMATION info;
             PH_SETTING_CREATE settings[] =
             {
-                { IntegerSettingType, SETTING_NAME_ENABLE_FAHRENHEIT, L"0" }
+                { IntegerSettingType, SETTING_NAME_ENABLE_FAHRENHEIT, L"0" },
+                { IntegerSettingType, SETTING_NAME_USAGE_POLL_INTERVAL, L"fa" },
+                { IntegerSettingType, SETTING_NAME_SENSOR_POLL_INTERVAL, L"3e8" }
             };
 
             PluginInstance = PhRegisterPlugin(PLUGIN_NAME, Instance, &info);
@@ -140,6 +201,45 @@ LOGICAL DllMain(
                 &SystemInformationInitializingCallbackRegistration
                 );
 
+            PhRegisterCallback(
+                PhGetPluginCallback(PluginInstance, PluginCallbackTreeNewMessage),
+                TreeNewMessageCallback,
+                NULL,
+                &TreeNewMessageCallbackRegistration
+                );
+            PhRegisterCallback(
+                PhGetGeneralCallback(GeneralCallbackProcessTreeNewInitializing),
+                ProcessTreeNewInitializingCallback,
+                NULL,
+                &ProcessTreeNewInitializingCallbackRegistration
+                );
+            PhRegisterCallback(
+                PhGetGeneralCallback(GeneralCallbackProcessProviderAddedEvent),
+                ProcessAddedCallback,
+                NULL,
+                &ProcessAddedCallbackRegistration
+                );
+            PhRegisterCallback(
+                PhGetGeneralCallback(GeneralCallbackProcessProviderRemovedEvent),
+                ProcessRemovedCallback,
+                NULL,
+                &ProcessRemovedCallbackRegistration
+                );
+            PhRegisterCallback(
+                PhGetGeneralCallback(GeneralCallbackGetProcessTooltipText),
+                GetProcessTooltipTextCallback,
+                NULL,
+                &GetProcessTooltipTextCallbackRegistration
+                );
+
+            PhPluginSetObjectExtension(
+                PluginInstance,
+                EmProcessItemType,
+                sizeof(NVGPU_PROCESS_EXTENSION),
+                NvGpuProcessItemCreate,
+                NULL
+                );
+
             PhAddSettings(settings, ARRAYSIZE(settings));
         }
         break;
@@ -25,6 +25,11 @@
 
 #define PLUGIN_NAME L"dmex.NvGpuPlugin"
 #define SETTING_NAME_ENABLE_FAHRENHEIT (PLUGIN_NAME L".EnableFahrenheit")
+#define SETTING_NAME_USAGE_POLL_INTERVAL (PLUGIN_NAME L".UsagePollInterval")
+#define SETTING_NAME_SENSOR_POLL_INTERVAL (PLUGIN_NAME L".SensorPollInterval")
+
+#define NVGPU_MINIMUM_POLL_INTERVAL 100
+#define NVGPU_MAX_ACTIVE_APPS 128 // NVAPI_MAX_PROCESSES
 
 #define CINTERFACE
 #define COBJMACROS
@@ -34,48 +39,140 @@
 #include <verify.h>
 #include <windowsx.h>
 #include "resource.h"
+#include "../common/history.h"
 
 #define MSG_UPDATE (WM_APP + 1)
 
 extern BOOLEAN NvApiInitialized;
 extern PPH_PLUGIN PluginInstance;
 
-extern ULONG GpuMemoryLimit;
-extern FLOAT GpuCurrentGpuUsage;
-extern FLOAT GpuCurrentCoreUsage;
-extern FLOAT GpuCurrentBusUsage;
-extern ULONG GpuCurrentMemUsage;
-extern ULONG GpuCurrentMemSharedUsage;
-extern ULONG GpuCurrentCoreTemp;
-extern ULONG GpuCurrentBoardTemp;
-extern ULONG GpuCurrentCoreClock;
-extern ULONG GpuCurrentMemoryClock;
-extern ULONG GpuCurrentShaderClock;
-extern ULONG GpuCurrentVoltage;
+// Values gathered by the poller thread. Usages and memory are polled at the usage interval;
+// everything else at the (slower) sensor interval and carried over in between.
+typedef struct _NVGPU_SAMPLE
+{
+    FLOAT GpuUsage;
+    FLOAT CoreUsage;
+    FLOAT BusUsage;
+    // Running totals so the provider tick can average every usage poll since the last tick.
+    DOUBLE GpuUsageTotal;
+    DOUBLE CoreUsageTotal;
+    DOUBLE BusUsageTotal;
+    ULONG64 UsageCount;
+
+    ULONG MemoryLimit;
+    ULONG MemUsage;
+    ULONG MemSharedUsage;
+
+    ULONG CoreTemp;
+    ULONG BoardTemp;
+    ULONG CoreClock;
+    ULONG MemoryClock;
+    ULONG ShaderClock;
+    ULONG Voltage;
+    ULONG FanRpm;
+    ULONG FanLevel;
+    BOOLEAN FanRpmValid;
+    BOOLEAN FanLevelValid;
+
+    // Processes with a context on the GPU, polled with the sensors.
+    ULONG ActiveAppCount;
+    HANDLE ActiveAppIds[NVGPU_MAX_ACTIVE_APPS];
+} NVGPU_SAMPLE, *PNVGPU_SAMPLE;
+
+typedef struct _NVGPU_DEVICE
+{
+    ULONG Index;
+    BOOLEAN Aggregate;
+    PVOID PhysicalHandle; // NvPhysicalGpuHandle
+    PVOID DisplayHandle; // NvDisplayHandle, NULL for headless GPUs
+    ULONG ArchType;
+
+    // Static information, queried once by NvGpuQueryStaticInfo.
+    PPH_STRING Name;
+    PPH_STRING ShortName;
+    PPH_STRING VbiosVersion;
+    PPH_STRING Revision;
+    PPH_STRING DeviceId;
+    PPH_STRING RopsCount;
+    PPH_STRING ShaderCount;
+    PPH_STRING RamType;
+    PPH_STRING Foundry;
+
+    // Seqlock-protected snapshot published by the poller thread. The sequence is odd while
+    // a write is in progress; readers retry until they see the same even value twice.
+    volatile LONG SampleSequence;
+    NVGPU_SAMPLE Sample;
+    NVGPU_SAMPLE PollerSample; // Owned by the poller thread.
+    NVGPU_SAMPLE TickSample; // Snapshot taken at the last provider tick.
+
+    // Values as of the last provider tick; these are what the UI displays.
+
+    ULONG MemoryLimit;
+    FLOAT GpuUsage;
+    FLOAT CoreUsage;
+    FLOAT BusUsage;
+    ULONG MemUsage;
+    ULONG MemSharedUsage;
+    ULONG CoreTemp;
+    ULONG BoardTemp;
+    ULONG CoreClock;
+    ULONG MemoryClock;
+    ULONG ShaderClock;
+    ULONG Voltage;
+    ULONG FanRpm;
+    ULONG FanLevel;
+    BOOLEAN FanRpmValid;
+    BOOLEAN FanLevelValid;
+
+    PH_CIRCULAR_BUFFER_FLOAT UtilizationHistory;
+    PH_CIRCULAR_BUFFER_ULONG MemoryHistory;
+    PH_CIRCULAR_BUFFER_FLOAT BoardHistory;
+    PH_CIRCULAR_BUFFER_FLOAT BusHistory;
+
+    // The same series rolled up for zoomed out graphs.
+    HISTORY_STORE UtilizationLongHistory;
+    HISTORY_STORE MemoryLongHistory;
+    HISTORY_STORE BoardLongHistory;
+    HISTORY_STORE BusLongHistory;
+} NVGPU_DEVICE, *PNVGPU_DEVICE;
+
+extern ULONG NvGpuDeviceCount;
+extern PNVGPU_DEVICE NvGpuDevices;
+extern NVGPU_DEVICE NvGpuAggregate;
+extern PPH_STRING NvGpuDriverVersion;
 
 BOOLEAN InitializeNvApi(VOID);
 BOOLEAN DestroyNvApi(VOID);
 PPH_STRING NvGpuQueryDriverVersion(VOID);
-PPH_STRING NvGpuQueryVbiosVersionString(VOID);
-PPH_STRING NvGpuQueryName(VOID);
-PPH_STRING NvGpuQueryShortName(VOID);
-PPH_STRING NvGpuQueryRevision(VOID);
-PPH_STRING NvGpuQueryRamType(VOID);
-PPH_STRING NvGpuQueryFoundry(VOID);
-PPH_STRING NvGpuQueryDeviceId(VOID);
-PPH_STRING NvGpuQueryRopsCount(VOID);
-PPH_STRING NvGpuQueryShaderCount(VOID);
-PPH_STRING NvGpuQueryPciInfo(VOID);
-PPH_STRING NvGpuQueryBusWidth(VOID);
-PPH_STRING NvGpuQueryDriverSettings(VOID);
-PPH_STRING NvGpuQueryFanSpeed(VOID);
-BOOLEAN NvGpuDriverIsWHQL(VOID);
-VOID NvGpuUpdateValues(VOID);
-VOID NvGpuUpdateVoltage(VOID);
+PPH_STRING NvGpuQueryVbiosVersionString(_In_ PNVGPU_DEVICE Device);
+PPH_STRING NvGpuQueryName(_In_ PNVGPU_DEVICE Device);
+PPH_STRING NvGpuQueryShortName(_In_ PNVGPU_DEVICE Device);
+PPH_STRING NvGpuQueryRevision(_In_ PNVGPU_DEVICE Device);
+PPH_STRING NvGpuQueryRamType(_In_ PNVGPU_DEVICE Device);
+PPH_STRING NvGpuQueryFoundry(_In_ PNVGPU_DEVICE Device);
+PPH_STRING NvGpuQueryDeviceId(_In_ PNVGPU_DEVICE Device);
+PPH_STRING NvGpuQueryRopsCount(_In_ PNVGPU_DEVICE Device);
+PPH_STRING NvGpuQueryShaderCount(_In_ PNVGPU_DEVICE Device);
+PPH_STRING NvGpuQueryPciInfo(_In_ PNVGPU_DEVICE Device);
+PPH_STRING NvGpuQueryBusWidth(_In_ PNVGPU_DEVICE Device);
+PPH_STRING NvGpuQueryDriverSettings(_In_ PNVGPU_DEVICE Device);
+PPH_STRING NvGpuFormatFanSpeed(_In_ PNVGPU_DEVICE Device);
+BOOLEAN NvGpuDriverIsWHQL(_In_ PNVGPU_DEVICE Device);
+VOID NvGpuQueryStaticInfo(_Inout_ PNVGPU_DEVICE Device);
+VOID NvGpuQueryUsages(_In_ PNVGPU_DEVICE Device, _Inout_ PNVGPU_SAMPLE Sample);
+VOID NvGpuQuerySensors(_In_ PNVGPU_DEVICE Device, _Inout_ PNVGPU_SAMPLE Sample);
+VOID NvGpuQueryActiveApps(_In_ PNVGPU_DEVICE Device, _Inout_ PNVGPU_SAMPLE Sample);
+
+typedef struct _NVGPU_ZOOMED_GRAPH
+{
+    ULONG PointCount;
+    PHISTORY_BUCKET Points;
+} NVGPU_ZOOMED_GRAPH, *PNVGPU_ZOOMED_GRAPH;
 
 typedef struct _PH_NVGPU_SYSINFO_CONTEXT
 {
-    PPH_STRING GpuName;
+    PNVGPU_DEVICE Device;
+    PPH_STRING SectionName;
     HWND WindowHandle;
     PPH_SYSINFO_SECTION Section;
     PH_LAYOUT_MANAGER LayoutManager;
@@ -97,12 +194,16 @@ typedef struct _PH_NVGPU_SYSINFO_CONTEXT
     PH_GRAPH_STATE MemGraphState;
     PH_GRAPH_STATE SharedGraphState;
     PH_GRAPH_STATE BusGraphState;
-} PH_NVGPU_SYSINFO_CONTEXT, *PPH_NVGPU_SYSINFO_CONTEXT;
 
-extern PH_CIRCULAR_BUFFER_FLOAT GpuUtilizationHistory;
-extern PH_CIRCULAR_BUFFER_ULONG GpuMemoryHistory;
-extern PH_CIRCULAR_BUFFER_FLOAT GpuBoardHistory;
-extern PH_CIRCULAR_BUFFER_FLOAT GpuBusHistory;
+    // Zoomed out view, queried from the long history. A span of zero shows the
+    // full-rate history.
+    ULONG64 HistorySpan;
+    ULONG64 HistoryEndTime;
+    NVGPU_ZOOMED_GRAPH GpuZoom;
+    NVGPU_ZOOMED_GRAPH MemZoom;
+    NVGPU_ZOOMED_GRAPH SharedZoom;
+    NVGPU_ZOOMED_GRAPH BusZoom;
+} PH_NVGPU_SYSINFO_CONTEXT, *PPH_NVGPU_SYSINFO_CONTEXT;
 
 VOID NvGpuInitialize(
     VOID
@@ -112,6 +213,67 @@ VOID NvGpuUpdate(
     VOID
     );
 
+VOID NvGpuStartPoller(
+    VOID
+    );
+
+VOID NvGpuStopPoller(
+    VOID
+    );
+
+// process.c
+
+typedef enum _NVGPU_PROCESS_COLUMN_ID
+{
+    COLUMN_ID_NVGPU_DEVICES = 1,
+    COLUMN_ID_NVGPU_MAXIMUM
+} NVGPU_PROCESS_COLUMN_ID;
+
+typedef struct _NVGPU_PROCESS_EXTENSION
+{
+    PPH_PROCESS_ITEM ProcessItem;
+    ULONG ListIndex;
+    ULONG DeviceMask; // written by the provider thread
+
+    // UI thread only.
+    ULONG DevicesTextMask;
+    WCHAR DevicesText[PH_INT64_STR_LEN_1 * 2];
+} NVGPU_PROCESS_EXTENSION, *PNVGPU_PROCESS_EXTENSION;
+
+VOID NvGpuProcessInitialize(
+    VOID
+    );
+
+VOID NvGpuUpdateProcesses(
+    VOID
+    );
+
+VOID NvGpuProcessTreeNewInitializing(
+    _In_ PPH_PLUGIN_TREENEW_INFORMATION Information
+    );
+
+VOID NvGpuProcessTreeNewMessage(
+    _In_ PPH_PLUGIN_TREENEW_MESSAGE Message
+    );
+
+VOID NvGpuProcessGetTooltipText(
+    _In_ PPH_PLUGIN_GET_TOOLTIP_TEXT GetTooltipText
+    );
+
+VOID NvGpuProcessItemCreate(
+    _In_ PVOID Object,
+    _In_ PH_EM_OBJECT_TYPE ObjectType,
+    _In_ PVOID Extension
+    );
+
+VOID NvGpuProcessAdded(
+    _In_ PPH_PROCESS_ITEM ProcessItem
+    );
+
+VOID NvGpuProcessRemoved(
+    _In_ PPH_PROCESS_ITEM ProcessItem
+    );
+
 VOID NvGpuSysInfoInitializing(
     _In_ PPH_PLUGIN_SYSINFO_POINTERS Pointers
     );
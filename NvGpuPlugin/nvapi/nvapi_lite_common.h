@@ -383,7 +383,7 @@ typedef NV_DISPLAY_DRIVER_MEMORY_INFO_V2 NV_DISPLAY_DRIVER_MEMORY_INFO;
 //!
 //!  \ingroup  driverapi
 ///////////////////////////////////////////////////////////////////////////////
-typedef NvAPI_Status (__cdecl *_NvAPI_GPU_GetMemoryInfo)(NvDisplayHandle hNvDisplay, NV_DISPLAY_DRIVER_MEMORY_INFO *pMemoryInfo);
+typedef NvAPI_Status (__cdecl *_NvAPI_GPU_GetMemoryInfo)(NvPhysicalGpuHandle hPhysicalGpu, NV_DISPLAY_DRIVER_MEMORY_INFO *pMemoryInfo);
 _NvAPI_GPU_GetMemoryInfo NvAPI_GPU_GetMemoryInfo;
 
 
@@ -22,10 +22,195 @@
 
 #include "main.h"
 
-PH_CIRCULAR_BUFFER_FLOAT GpuUtilizationHistory;
-PH_CIRCULAR_BUFFER_ULONG GpuMemoryHistory;
-PH_CIRCULAR_BUFFER_FLOAT GpuBoardHistory;
-PH_CIRCULAR_BUFFER_FLOAT GpuBusHistory;
+NVGPU_DEVICE NvGpuAggregate;
+static HANDLE NvGpuPollerStopEvent = NULL;
+static HANDLE NvGpuPollerThreadHandle = NULL;
+
+static VOID NvGpuPublishSample(
+    _Inout_ PNVGPU_DEVICE Device,
+    _In_ PNVGPU_SAMPLE Sample
+    )
+{
+    // The interlocked operations are full barriers, so the copy cannot move outside the
+    // odd (write in progress) window.
+    InterlockedIncrement(&Device->SampleSequence);
+    Device->Sample = *Sample;
+    InterlockedIncrement(&Device->SampleSequence);
+}
+
+static VOID NvGpuReadSample(
+    _In_ PNVGPU_DEVICE Device,
+    _Out_ PNVGPU_SAMPLE Sample
+    )
+{
+    LONG sequence;
+
+    for (;;)
+    {
+        sequence = Device->SampleSequence;
+        MemoryBarrier();
+
+        if (!(sequence & 1))
+        {
+            *Sample = Device->Sample;
+            MemoryBarrier();
+
+            if (Device->SampleSequence == sequence)
+                break;
+        }
+
+        YieldProcessor();
+    }
+}
+
+NTSTATUS NvGpuPollerThreadStart(
+    _In_ PVOID Parameter
+    )
+{
+    ULONG usageInterval;
+    ULONG sensorInterval;
+    ULONG sensorPollRatio;
+    ULONG pollCount = 0;
+    LARGE_INTEGER timeout;
+
+    usageInterval = PhGetIntegerSetting(SETTING_NAME_USAGE_POLL_INTERVAL);
+    sensorInterval = PhGetIntegerSetting(SETTING_NAME_SENSOR_POLL_INTERVAL);
+
+    if (usageInterval < NVGPU_MINIMUM_POLL_INTERVAL)
+        usageInterval = NVGPU_MINIMUM_POLL_INTERVAL;
+    if (sensorInterval < usageInterval)
+        sensorInterval = usageInterval;
+
+    // Sensors (clocks, thermals, voltage, fans) are polled every Nth usage poll.
+    sensorPollRatio = (sensorInterval + usageInterval / 2) / usageInterval;
+
+    do
+    {
+        BOOLEAN pollSensors = pollCount++ % sensorPollRatio == 0;
+
+        for (ULONG i = 0; i < NvGpuDeviceCount; i++)
+        {
+            PNVGPU_DEVICE device = &NvGpuDevices[i];
+
+            NvGpuQueryUsages(device, &device->PollerSample);
+
+            if (pollSensors)
+            {
+                NvGpuQuerySensors(device, &device->PollerSample);
+                NvGpuQueryActiveApps(device, &device->PollerSample);
+            }
+
+            NvGpuPublishSample(device, &device->PollerSample);
+        }
+    } while (NtWaitForSingleObject(
+        NvGpuPollerStopEvent,
+        FALSE,
+        PhTimeoutFromMilliseconds(&timeout, usageInterval)
+        ) == STATUS_TIMEOUT);
+
+    return STATUS_SUCCESS;
+}
+
+VOID NvGpuStartPoller(
+    VOID
+    )
+{
+    if (!NT_SUCCESS(NtCreateEvent(&NvGpuPollerStopEvent, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE)))
+        return;
+
+    NvGpuPollerThreadHandle = PhCreateThread(0, NvGpuPollerThreadStart, NULL);
+}
+
+VOID NvGpuStopPoller(
+    VOID
+    )
+{
+    if (NvGpuPollerStopEvent)
+        NtSetEvent(NvGpuPollerStopEvent, NULL);
+
+    // Wait so that NVAPI isn't called after the plugin starts tearing down.
+    if (NvGpuPollerThreadHandle)
+    {
+        NtWaitForSingleObject(NvGpuPollerThreadHandle, FALSE, NULL);
+        NtClose(NvGpuPollerThreadHandle);
+        NvGpuPollerThreadHandle = NULL;
+    }
+}
+
+static VOID NvGpuUpdateDevice(
+    _Inout_ PNVGPU_DEVICE Device
+    )
+{
+    NVGPU_SAMPLE sample;
+    ULONG64 usageCount;
+
+    NvGpuReadSample(Device, &sample);
+
+    // Average every usage poll since the previous tick; fall back to the latest value when
+    // the poller hasn't run in between.
+    usageCount = sample.UsageCount - Device->TickSample.UsageCount;
+
+    if (usageCount != 0)
+    {
+        Device->GpuUsage = (FLOAT)((sample.GpuUsageTotal - Device->TickSample.GpuUsageTotal) / usageCount);
+        Device->CoreUsage = (FLOAT)((sample.CoreUsageTotal - Device->TickSample.CoreUsageTotal) / usageCount);
+        Device->BusUsage = (FLOAT)((sample.BusUsageTotal - Device->TickSample.BusUsageTotal) / usageCount);
+    }
+    else
+    {
+        Device->GpuUsage = sample.GpuUsage;
+        Device->CoreUsage = sample.CoreUsage;
+        Device->BusUsage = sample.BusUsage;
+    }
+
+    Device->MemoryLimit = sample.MemoryLimit;
+    Device->MemUsage = sample.MemUsage;
+    Device->MemSharedUsage = sample.MemSharedUsage;
+    Device->CoreTemp = sample.CoreTemp;
+    Device->BoardTemp = sample.BoardTemp;
+    Device->CoreClock = sample.CoreClock;
+    Device->MemoryClock = sample.MemoryClock;
+    Device->ShaderClock = sample.ShaderClock;
+    Device->Voltage = sample.Voltage;
+    Device->FanRpm = sample.FanRpm;
+    Device->FanLevel = sample.FanLevel;
+    Device->FanRpmValid = sample.FanRpmValid;
+    Device->FanLevelValid = sample.FanLevelValid;
+
+    Device->TickSample = sample;
+}
+
+static VOID NvGpuInitializeDeviceHistory(
+    _Inout_ PNVGPU_DEVICE Device,
+    _In_ ULONG SampleCount
+    )
+{
+    PhInitializeCircularBuffer_FLOAT(&Device->UtilizationHistory, SampleCount);
+    PhInitializeCircularBuffer_ULONG(&Device->MemoryHistory, SampleCount);
+    PhInitializeCircularBuffer_FLOAT(&Device->BoardHistory, SampleCount);
+    PhInitializeCircularBuffer_FLOAT(&Device->BusHistory, SampleCount);
+
+    HistoryInitializeStore(&Device->UtilizationLongHistory);
+    HistoryInitializeStore(&Device->MemoryLongHistory);
+    HistoryInitializeStore(&Device->BoardLongHistory);
+    HistoryInitializeStore(&Device->BusLongHistory);
+}
+
+static VOID NvGpuAddDeviceHistory(
+    _Inout_ PNVGPU_DEVICE Device,
+    _In_ ULONG64 Time
+    )
+{
+    PhAddItemCircularBuffer_FLOAT(&Device->UtilizationHistory, Device->GpuUsage);
+    PhAddItemCircularBuffer_ULONG(&Device->MemoryHistory, Device->MemUsage);
+    PhAddItemCircularBuffer_FLOAT(&Device->BoardHistory, Device->CoreUsage);
+    PhAddItemCircularBuffer_FLOAT(&Device->BusHistory, Device->BusUsage);
+
+    HistoryAddSample(&Device->UtilizationLongHistory, Time, Device->GpuUsage);
+    HistoryAddSample(&Device->MemoryLongHistory, Time, (FLOAT)Device->MemUsage);
+    HistoryAddSample(&Device->BoardLongHistory, Time, Device->CoreUsage);
+    HistoryAddSample(&Device->BusLongHistory, Time, Device->BusUsage);
+}
 
 VOID NvGpuInitialize(
     VOID
@@ -34,10 +219,64 @@ VOID NvGpuInitialize(
     ULONG sampleCount;
 
     sampleCount = PhGetIntegerSetting(L"SampleCount");
-    PhInitializeCircularBuffer_FLOAT(&GpuUtilizationHistory, sampleCount);
-    PhInitializeCircularBuffer_ULONG(&GpuMemoryHistory, sampleCount);
-    PhInitializeCircularBuffer_FLOAT(&GpuBoardHistory, sampleCount);
-    PhInitializeCircularBuffer_FLOAT(&GpuBusHistory, sampleCount);
+
+    for (ULONG i = 0; i < NvGpuDeviceCount; i++)
+    {
+        NvGpuInitializeDeviceHistory(&NvGpuDevices[i], sampleCount);
+    }
+
+    memset(&NvGpuAggregate, 0, sizeof(NVGPU_DEVICE));
+    NvGpuAggregate.Aggregate = TRUE;
+    NvGpuAggregate.Name = PhFormatString(L"All GPUs (%lu)", NvGpuDeviceCount);
+    NvGpuInitializeDeviceHistory(&NvGpuAggregate, sampleCount);
+}
+
+static VOID NvGpuUpdateAggregate(
+    VOID
+    )
+{
+    PNVGPU_DEVICE total = &NvGpuAggregate;
+
+    // Utilization is averaged across devices; memory is summed; temperatures, clocks and
+    // voltages report the hottest/fastest device since an average of those means nothing.
+
+    total->GpuUsage = 0;
+    total->CoreUsage = 0;
+    total->BusUsage = 0;
+    total->MemoryLimit = 0;
+    total->MemUsage = 0;
+    total->MemSharedUsage = 0;
+    total->CoreTemp = 0;
+    total->BoardTemp = 0;
+    total->CoreClock = 0;
+    total->MemoryClock = 0;
+    total->ShaderClock = 0;
+    total->Voltage = 0;
+
+    for (ULONG i = 0; i < NvGpuDeviceCount; i++)
+    {
+        PNVGPU_DEVICE device = &NvGpuDevices[i];
+
+        total->GpuUsage += device->GpuUsage;
+        total->CoreUsage += device->CoreUsage;
+        total->BusUsage += device->BusUsage;
+        total->MemoryLimit += device->MemoryLimit;
+        total->MemUsage += device->MemUsage;
+        total->MemSharedUsage += device->MemSharedUsage;
+        total->CoreTemp = max(total->CoreTemp, device->CoreTemp);
+        total->BoardTemp = max(total->BoardTemp, device->BoardTemp);
+        total->CoreClock = max(total->CoreClock, device->CoreClock);
+        total->MemoryClock = max(total->MemoryClock, device->MemoryClock);
+        total->ShaderClock = max(total->ShaderClock, device->ShaderClock);
+        total->Voltage = max(total->Voltage, device->Voltage);
+    }
+
+    if (NvGpuDeviceCount != 0)
+    {
+        total->GpuUsage /= NvGpuDeviceCount;
+        total->CoreUsage /= NvGpuDeviceCount;
+        total->BusUsage /= NvGpuDeviceCount;
+    }
 }
 
 VOID NvGpuUpdate(
@@ -48,13 +287,23 @@ VOID NvGpuUpdate(
 
     if (runCount != 0)
     {
-        NvGpuUpdateValues();
+        LARGE_INTEGER systemTime;
+        ULONG64 time;
+
+        PhQuerySystemTime(&systemTime);
+        time = systemTime.QuadPart / PH_TICKS_PER_MS;
+
+        for (ULONG i = 0; i < NvGpuDeviceCount; i++)
+        {
+            NvGpuUpdateDevice(&NvGpuDevices[i]);
+            NvGpuAddDeviceHistory(&NvGpuDevices[i], time);
+        }
 
-        PhAddItemCircularBuffer_FLOAT(&GpuUtilizationHistory, GpuCurrentGpuUsage);
-        PhAddItemCircularBuffer_ULONG(&GpuMemoryHistory, GpuCurrentMemUsage);
-        PhAddItemCircularBuffer_FLOAT(&GpuBoardHistory, GpuCurrentCoreUsage);
-        PhAddItemCircularBuffer_FLOAT(&GpuBusHistory, GpuCurrentBusUsage);
+        NvGpuUpdateAggregate();
+        NvGpuAddDeviceHistory(&NvGpuAggregate, time);
+
+        NvGpuUpdateProcesses();
     }
 
     runCount++;
-}
\ No newline at end of file
+}
@@ -32,60 +32,100 @@
 #include <Ntddvdeo.h>
 
 static PVOID NvApiLibrary = NULL;
-static PPH_LIST NvGpuPhysicalHandleList = NULL;
-static PPH_LIST NvGpuDisplayHandleList = NULL;
-static NvU32 GpuArchType = 0;
-
-ULONG GpuMemoryLimit = 0;
-FLOAT GpuCurrentGpuUsage = 0.0f;
-FLOAT GpuCurrentCoreUsage = 0.0f;
-FLOAT GpuCurrentBusUsage = 0.0f;
-ULONG GpuCurrentMemUsage = 0;
-ULONG GpuCurrentMemSharedUsage = 0;
-ULONG GpuCurrentCoreTemp = 0;
-ULONG GpuCurrentBoardTemp = 0;
-ULONG GpuCurrentCoreClock = 0;
-ULONG GpuCurrentMemoryClock = 0;
-ULONG GpuCurrentShaderClock = 0;
-ULONG GpuCurrentVoltage = 0;
+static NvDisplayHandle NvGpuPrimaryDisplayHandle = NULL;
+static NV_ACTIVE_APP *NvGpuActiveAppBuffer = NULL; // Owned by the poller thread.
+
+ULONG NvGpuDeviceCount = 0;
+PNVGPU_DEVICE NvGpuDevices = NULL;
+PPH_STRING NvGpuDriverVersion = NULL;
 //NVAPI_GPU_PERF_DECREASE GpuPerfDecreaseReason = NV_GPU_PERF_DECREASE_NONE;
 
-VOID NvGpuEnumPhysicalHandles(VOID)
+static PNVGPU_DEVICE NvGpuFindDevice(
+    _In_ NvPhysicalGpuHandle PhysicalHandle
+    )
 {
-    NvU32 gpuCount = 0;
-    NvPhysicalGpuHandle gpuHandles[NVAPI_MAX_PHYSICAL_GPUS];
-
-    memset(gpuHandles, 0, sizeof(gpuHandles));
-
-    if (NvAPI_EnumPhysicalGPUs && NvAPI_EnumPhysicalGPUs(gpuHandles, &gpuCount) == NVAPI_OK)
+    for (ULONG i = 0; i < NvGpuDeviceCount; i++)
     {
-        PhAddItemsList(NvGpuPhysicalHandleList, gpuHandles, gpuCount);
+        if (NvGpuDevices[i].PhysicalHandle == PhysicalHandle)
+            return &NvGpuDevices[i];
     }
+
+    return NULL;
 }
 
-VOID NvGpuEnumDisplayHandles(VOID)
+static NvDisplayHandle NvGpuGetDisplayHandle(
+    _In_ PNVGPU_DEVICE Device
+    )
 {
-    if (!NvAPI_EnumNvidiaDisplayHandle)
+    // Driver-wide queries (registry path, driver version) only need some display handle;
+    // headless compute GPUs borrow the primary one.
+    return Device->DisplayHandle ? Device->DisplayHandle : NvGpuPrimaryDisplayHandle;
+}
+
+VOID NvGpuEnumDevices(VOID)
+{
+    NvU32 gpuCount = 0;
+    NvPhysicalGpuHandle gpuHandles[NVAPI_MAX_PHYSICAL_GPUS];
+
+    memset(gpuHandles, 0, sizeof(gpuHandles));
+
+    if (!NvAPI_EnumPhysicalGPUs || NvAPI_EnumPhysicalGPUs(gpuHandles, &gpuCount) != NVAPI_OK || gpuCount == 0)
         return;
 
-    for (NvU32 i = 0; i < NVAPI_MAX_DISPLAYS; i++)
+    NvGpuDevices = PhAllocate(sizeof(NVGPU_DEVICE) * gpuCount);
+    memset(NvGpuDevices, 0, sizeof(NVGPU_DEVICE) * gpuCount);
+    NvGpuDeviceCount = gpuCount;
+
+    for (NvU32 i = 0; i < gpuCount; i++)
     {
-        NvDisplayHandle displayHandle;
+        NvGpuDevices[i].Index = i;
+        NvGpuDevices[i].PhysicalHandle = gpuHandles[i];
+    }
 
-        if (NvAPI_EnumNvidiaDisplayHandle(i, &displayHandle) == NVAPI_END_ENUMERATION)
+    if (NvAPI_EnumNvidiaDisplayHandle)
+    {
+        for (NvU32 i = 0; i < NVAPI_MAX_DISPLAYS; i++)
         {
-            break;
+            NvDisplayHandle displayHandle;
+            NvU32 displayGpuCount = 0;
+            NvPhysicalGpuHandle displayGpuHandles[NVAPI_MAX_PHYSICAL_GPUS];
+
+            if (NvAPI_EnumNvidiaDisplayHandle(i, &displayHandle) != NVAPI_OK)
+                break;
+
+            if (!NvGpuPrimaryDisplayHandle)
+                NvGpuPrimaryDisplayHandle = displayHandle;
+
+            // Attach each display to the physical GPU(s) driving it. Displays spanning an SLI
+            // group map to every GPU in the group; the first display wins.
+            if (NvAPI_GetPhysicalGPUsFromDisplay && NvAPI_GetPhysicalGPUsFromDisplay(displayHandle, displayGpuHandles, &displayGpuCount) == NVAPI_OK)
+            {
+                for (NvU32 j = 0; j < displayGpuCount; j++)
+                {
+                    PNVGPU_DEVICE device = NvGpuFindDevice(displayGpuHandles[j]);
+
+                    if (device && !device->DisplayHandle)
+                        device->DisplayHandle = displayHandle;
+                }
+            }
         }
+    }
 
-        PhAddItemList(NvGpuDisplayHandleList, displayHandle);
+    // Static information never changes while the driver is loaded, so query it once here
+    // instead of every time the details dialog is opened.
+    for (NvU32 i = 0; i < gpuCount; i++)
+    {
+        NvGpuQueryStaticInfo(&NvGpuDevices[i]);
     }
+
+    NvGpuDriverVersion = NvGpuQueryDriverVersion();
 }
 
 BOOLEAN InitializeNvApi(VOID)
 {
-    NvGpuPhysicalHandleList = PhCreateList(1);
-    NvGpuDisplayHandleList = PhCreateList(1);
-
+#ifdef NVGPU_MOCK_NVAPI
+    NvAPI_QueryInterface = NvGpuMockQueryInterface;
+#else
 #ifdef _M_IX86
     if (!(NvApiLibrary = LoadLibrary(L"nvapi.dll")))
         return FALSE;
@@ -93,9 +133,10 @@ BOOLEAN InitializeNvApi(VOID)
     if (!(NvApiLibrary = LoadLibrary(L"nvapi64.dll")))
         return FALSE;
 #endif
-    
+
     if (!(NvAPI_QueryInterface = PhGetProcedureAddress(NvApiLibrary, "nvapi_QueryInterface", 0)))
         return FALSE;
+#endif
 
     if (!(NvAPI_Initialize = NvAPI_QueryInterface(0x150E828UL)))
         return FALSE;
@@ -113,7 +154,7 @@ BOOLEAN InitializeNvApi(VOID)
     NvAPI_GPU_GetFullName = NvAPI_QueryInterface(0xCEEE8E9FUL);
 
     // Query functions
-    NvAPI_GPU_GetMemoryInfo = NvAPI_QueryInterface(0x774AA982UL);
+    NvAPI_GPU_GetMemoryInfo = NvAPI_QueryInterface(0x07F9B368UL);
     NvAPI_GPU_GetThermalSettings = NvAPI_QueryInterface(0xE3640A56UL);
     NvAPI_GPU_GetCoolerSettings = NvAPI_QueryInterface(0xDA141340UL);
     NvAPI_GPU_GetPerfDecreaseInfo = NvAPI_QueryInterface(0x7F7F4600UL);
@@ -127,7 +168,7 @@ BOOLEAN InitializeNvApi(VOID)
 
     //NvAPI_GPU_GetPerfClocks = NvAPI_QueryInterface(0x1EA54A3B);
     //NvAPI_GPU_GetVoltages = NvAPI_QueryInterface(0x7D656244);
-    //NvAPI_GPU_QueryActiveApps = NvAPI_QueryInterface(0x65B1C5F5);
+    NvAPI_GPU_QueryActiveApps = NvAPI_QueryInterface(0x65B1C5F5UL);
     //NvAPI_GPU_GetShaderPipeCount = NvAPI_QueryInterface(0x63E2F56F);
     //NvAPI_GPU_GetShaderSubPipeCount = NvAPI_QueryInterface(0x0BE17923);
     NvAPI_GPU_GetRamBusWidth = NvAPI_QueryInterface(0x7975C581);  // ADD ME
@@ -136,8 +177,8 @@ BOOLEAN InitializeNvApi(VOID)
     NvAPI_GPU_GetRamMaker = NvAPI_QueryInterface(0x42AEA16AUL);
     NvAPI_GPU_GetFoundry = NvAPI_QueryInterface(0x5D857A00UL);
 
-    //NvAPI_GetDisplayDriverMemoryInfo = NvAPI_QueryInterface(0x774AA982);
-    //NvAPI_GetPhysicalGPUsFromDisplay = NvAPI_QueryInterface(0x34EF9506);
+    NvAPI_GetDisplayDriverMemoryInfo = NvAPI_QueryInterface(0x774AA982UL);
+    NvAPI_GetPhysicalGPUsFromDisplay = NvAPI_QueryInterface(0x34EF9506UL);
     NvAPI_GetDisplayDriverVersion = NvAPI_QueryInterface(0xF951A4D1UL);
     NvAPI_GetDisplayDriverRegistryPath = NvAPI_QueryInterface(0x0E24CEEEUL);
     //NvAPI_RestartDisplayDriver = NvAPI_QueryInterface(0xB4B26B65UL);
@@ -180,9 +221,8 @@ BOOLEAN InitializeNvApi(VOID)
 
     if (NvAPI_Initialize() == NVAPI_OK)
     {
-        NvGpuEnumPhysicalHandles();
-        NvGpuEnumDisplayHandles();
-        return TRUE;
+        NvGpuEnumDevices();
+        return NvGpuDeviceCount != 0;
     }
 
     return FALSE;
@@ -192,17 +232,34 @@ BOOLEAN DestroyNvApi(VOID)
 {
     NvApiInitialized = FALSE;
 
-    if (NvGpuDisplayHandleList)
+    if (NvGpuDevices)
     {
-        PhClearList(NvGpuDisplayHandleList);
-        PhDereferenceObject(NvGpuDisplayHandleList);
+        for (ULONG i = 0; i < NvGpuDeviceCount; i++)
+        {
+            PhClearReference(&NvGpuDevices[i].Name);
+            PhClearReference(&NvGpuDevices[i].ShortName);
+            PhClearReference(&NvGpuDevices[i].VbiosVersion);
+            PhClearReference(&NvGpuDevices[i].Revision);
+            PhClearReference(&NvGpuDevices[i].DeviceId);
+            PhClearReference(&NvGpuDevices[i].RopsCount);
+            PhClearReference(&NvGpuDevices[i].ShaderCount);
+            PhClearReference(&NvGpuDevices[i].RamType);
+            PhClearReference(&NvGpuDevices[i].Foundry);
+        }
+
+        PhFree(NvGpuDevices);
+        NvGpuDevices = NULL;
+        NvGpuDeviceCount = 0;
     }
 
-    if (NvGpuPhysicalHandleList)
+    NvGpuPrimaryDisplayHandle = NULL;
+
+    if (NvGpuActiveAppBuffer)
     {
-        PhClearList(NvGpuPhysicalHandleList);
-        PhDereferenceObject(NvGpuPhysicalHandleList);
+        PhFree(NvGpuActiveAppBuffer);
+        NvGpuActiveAppBuffer = NULL;
     }
+    PhClearReference(&NvGpuDriverVersion);
 
     if (NvAPI_Unload)
         NvAPI_Unload();
@@ -234,7 +291,7 @@ PPH_STRING NvGpuQueryDriverVersion(VOID)
     {
         NV_DISPLAY_DRIVER_VERSION nvDisplayDriverVersion = { NV_DISPLAY_DRIVER_VERSION_VER };
 
-        if (NvAPI_GetDisplayDriverVersion(NvGpuDisplayHandleList->Items[0], &nvDisplayDriverVersion) == NVAPI_OK)
+        if (NvGpuPrimaryDisplayHandle && NvAPI_GetDisplayDriverVersion(NvGpuPrimaryDisplayHandle, &nvDisplayDriverVersion) == NVAPI_OK)
         {
             return PhFormatString(L"%lu.%lu [%hs]", 
                 nvDisplayDriverVersion.drvVersion / 100, 
@@ -247,13 +304,15 @@ PPH_STRING NvGpuQueryDriverVersion(VOID)
     return PhCreateString(L"N/A");
 }
 
-PPH_STRING NvGpuQueryVbiosVersionString(VOID)
+PPH_STRING NvGpuQueryVbiosVersionString(
+    _In_ PNVGPU_DEVICE Device
+    )
 {
     if (NvAPI_GPU_GetVbiosVersionString)
     {
         NvAPI_ShortString biosRevision = "";
 
-        if (NvAPI_GPU_GetVbiosVersionString(NvGpuPhysicalHandleList->Items[0], biosRevision) == NVAPI_OK)
+        if (NvAPI_GPU_GetVbiosVersionString(Device->PhysicalHandle, biosRevision) == NVAPI_OK)
         {
             return PhConvertMultiByteToUtf16(biosRevision);
         }
@@ -262,13 +321,15 @@ PPH_STRING NvGpuQueryVbiosVersionString(VOID)
     return PhCreateString(L"N/A");
 }
 
-PPH_STRING NvGpuQueryName(VOID)
+PPH_STRING NvGpuQueryName(
+    _In_ PNVGPU_DEVICE Device
+    )
 {
     if (NvAPI_GPU_GetFullName)
     {
         NvAPI_ShortString nvNameAnsiString = "";
 
-        if (NvAPI_GPU_GetFullName(NvGpuPhysicalHandleList->Items[0], nvNameAnsiString) == NVAPI_OK)
+        if (NvAPI_GPU_GetFullName(Device->PhysicalHandle, nvNameAnsiString) == NVAPI_OK)
         {
             return PhConvertMultiByteToUtf16(nvNameAnsiString);
         }
@@ -277,13 +338,15 @@ PPH_STRING NvGpuQueryName(VOID)
     return PhCreateString(L"N/A");
 }
 
-PPH_STRING NvGpuQueryShortName(VOID)
+PPH_STRING NvGpuQueryShortName(
+    _In_ PNVGPU_DEVICE Device
+    )
 {
     if (NvAPI_GPU_GetShortName)
     {
         NvAPI_ShortString nvShortNameAnsiString = "";
 
-        if (NvAPI_GPU_GetShortName(NvGpuPhysicalHandleList->Items[0], nvShortNameAnsiString) == NVAPI_OK)
+        if (NvAPI_GPU_GetShortName(Device->PhysicalHandle, nvShortNameAnsiString) == NVAPI_OK)
         {
             return PhConvertMultiByteToUtf16(nvShortNameAnsiString);
         }
@@ -292,15 +355,17 @@ PPH_STRING NvGpuQueryShortName(VOID)
     return PhCreateString(L"N/A");
 }
 
-PPH_STRING NvGpuQueryRevision(VOID)
+PPH_STRING NvGpuQueryRevision(
+    _In_ PNVGPU_DEVICE Device
+    )
 {
     if (NvAPI_GPU_GetArchInfo)
     {
         NV_ARCH_INFO nvArchInfo = { NV_ARCH_INFO_VER };
 
-        if (NvAPI_GPU_GetArchInfo(NvGpuPhysicalHandleList->Items[0], &nvArchInfo) == NVAPI_OK)
+        if (NvAPI_GPU_GetArchInfo(Device->PhysicalHandle, &nvArchInfo) == NVAPI_OK)
         {
-            GpuArchType = nvArchInfo.unknown[0];
+            Device->ArchType = nvArchInfo.unknown[0];
 
             return PhFormatString(L"%02X", nvArchInfo.unknown[2]);
         }
@@ -309,7 +374,9 @@ PPH_STRING NvGpuQueryRevision(VOID)
     return PhCreateString(L"N/A");
 }
 
-PPH_STRING NvGpuQueryRamType(VOID)
+PPH_STRING NvGpuQueryRamType(
+    _In_ PNVGPU_DEVICE Device
+    )
 {
     PWSTR ramTypeString = NULL;
     PWSTR ramMakerString = NULL;
@@ -318,12 +385,12 @@ PPH_STRING NvGpuQueryRamType(VOID)
 
     if (NvAPI_GPU_GetRamType)
     {
-        NvAPI_GPU_GetRamType(NvGpuPhysicalHandleList->Items[0], &nvRamType);
+        NvAPI_GPU_GetRamType(Device->PhysicalHandle, &nvRamType);
     }
 
     if (NvAPI_GPU_GetRamMaker)
     {
-        NvAPI_GPU_GetRamMaker(NvGpuPhysicalHandleList->Items[0], &nvRamMaker);
+        NvAPI_GPU_GetRamMaker(Device->PhysicalHandle, &nvRamMaker);
     }
 
     switch (nvRamType)
@@ -400,13 +467,15 @@ PPH_STRING NvGpuQueryRamType(VOID)
     return PhFormatString(L"%s (%s)", ramTypeString, ramMakerString);
 }
 
-PPH_STRING NvGpuQueryFoundry(VOID)
+PPH_STRING NvGpuQueryFoundry(
+    _In_ PNVGPU_DEVICE Device
+    )
 {
     if (NvAPI_GPU_GetFoundry)
     {
         NV_FOUNDRY nvFoundryType = NV_FOUNDRY_NONE;
 
-        if (NvAPI_GPU_GetFoundry(NvGpuPhysicalHandleList->Items[0], &nvFoundryType) == NVAPI_OK)
+        if (NvAPI_GPU_GetFoundry(Device->PhysicalHandle, &nvFoundryType) == NVAPI_OK)
         {
             switch (nvFoundryType)
             {
@@ -431,7 +500,9 @@ PPH_STRING NvGpuQueryFoundry(VOID)
     return PhCreateString(L"N/A");
 }
 
-PPH_STRING NvGpuQueryDeviceId(VOID)
+PPH_STRING NvGpuQueryDeviceId(
+    _In_ PNVGPU_DEVICE Device
+    )
 {
     if (NvAPI_GPU_GetPCIIdentifiers)
     {
@@ -440,7 +511,7 @@ PPH_STRING NvGpuQueryDeviceId(VOID)
         NvU32 pRevisionId = 0;
         NvU32 pExtDeviceId = 0;
 
-        if (NvAPI_GPU_GetPCIIdentifiers(NvGpuPhysicalHandleList->Items[0], &pDeviceId, &pSubSystemId, &pRevisionId, &pExtDeviceId) == NVAPI_OK)
+        if (NvAPI_GPU_GetPCIIdentifiers(Device->PhysicalHandle, &pDeviceId, &pSubSystemId, &pRevisionId, &pExtDeviceId) == NVAPI_OK)
         {
             return PhFormatString(L"%04X - %04X", pDeviceId & 65535, pDeviceId >> 16);
         }
@@ -449,19 +520,21 @@ PPH_STRING NvGpuQueryDeviceId(VOID)
     return PhCreateString(L"N/A");
 }
 
-PPH_STRING NvGpuQueryRopsCount(VOID)
+PPH_STRING NvGpuQueryRopsCount(
+    _In_ PNVGPU_DEVICE Device
+    )
 {
     if (NvAPI_GPU_GetPartitionCount)
     {
         NvU32 value = 0;
 
-        if (NvAPI_GPU_GetPartitionCount(NvGpuPhysicalHandleList->Items[0], &value) == NVAPI_OK)
+        if (NvAPI_GPU_GetPartitionCount(Device->PhysicalHandle, &value) == NVAPI_OK)
         {
-            if (GpuArchType >= 0x120)
+            if (Device->ArchType >= 0x120)
             {
                 return PhFormatString(L"%lu", value * 16);
             }
-            else if (GpuArchType >= 0x0c0)
+            else if (Device->ArchType >= 0x0c0)
             {
                 return PhFormatString(L"%lu", value * 8);
             }
@@ -473,13 +546,15 @@ PPH_STRING NvGpuQueryRopsCount(VOID)
     return PhCreateString(L"N/A");
 }
 
-PPH_STRING NvGpuQueryShaderCount(VOID)
+PPH_STRING NvGpuQueryShaderCount(
+    _In_ PNVGPU_DEVICE Device
+    )
 {
     if (NvAPI_GPU_GetGpuCoreCount)
     {
         NvU32 value = 0;
 
-        if (NvAPI_GPU_GetGpuCoreCount(NvGpuPhysicalHandleList->Items[0], &value) == NVAPI_OK)
+        if (NvAPI_GPU_GetGpuCoreCount(Device->PhysicalHandle, &value) == NVAPI_OK)
         {
             return PhFormatString(L"%lu Unified", value);
         }
@@ -488,13 +563,15 @@ PPH_STRING NvGpuQueryShaderCount(VOID)
     return PhCreateString(L"N/A");
 }
 
-PPH_STRING NvGpuQueryPciInfo(VOID)
+PPH_STRING NvGpuQueryPciInfo(
+    _In_ PNVGPU_DEVICE Device
+    )
 {
     if (NvAPI_GPU_GetPCIEInfo)
     {
         NV_PCIE_INFO pciInfo = { NV_PCIE_INFO_VER };
 
-        if (NvAPI_GPU_GetPCIEInfo(NvGpuPhysicalHandleList->Items[0], &pciInfo) == NVAPI_OK)
+        if (NvAPI_GPU_GetPCIEInfo(Device->PhysicalHandle, &pciInfo) == NVAPI_OK)
         {
             return PhFormatString(L"%lu @ %lu %lu", 
                 pciInfo.info[1].unknown1,
@@ -507,14 +584,16 @@ PPH_STRING NvGpuQueryPciInfo(VOID)
     return PhCreateString(L"N/A");
 }
 
-PPH_STRING NvGpuQueryBusWidth(VOID)
+PPH_STRING NvGpuQueryBusWidth(
+    _In_ PNVGPU_DEVICE Device
+    )
 {
     if (NvAPI_GPU_GetFBWidthAndLocation)
     {
         NvU32 width = 0;
         NvU32 location = 0;
 
-        if (NvAPI_GPU_GetFBWidthAndLocation(NvGpuPhysicalHandleList->Items[0], &width, &location) == NVAPI_OK)
+        if (NvAPI_GPU_GetFBWidthAndLocation(Device->PhysicalHandle, &width, &location) == NVAPI_OK)
         {
             return PhFormatString(L"%lu Bit", width);
         }
@@ -524,13 +603,15 @@ PPH_STRING NvGpuQueryBusWidth(VOID)
 }
 
 
-PPH_STRING NvGpuQueryPcbValue(VOID)
+PPH_STRING NvGpuQueryPcbValue(
+    _In_ PNVGPU_DEVICE Device
+    )
 {
     if (NvAPI_GPU_ClientPowerTopologyGetStatus)
     {
         NV_POWER_TOPOLOGY_STATUS nvPowerTopologyStatus = { NV_POWER_TOPOLOGY_STATUS_VER };
 
-        if (NvAPI_GPU_ClientPowerTopologyGetStatus(NvGpuPhysicalHandleList->Items[0], &nvPowerTopologyStatus) == NVAPI_OK)
+        if (NvAPI_GPU_ClientPowerTopologyGetStatus(Device->PhysicalHandle, &nvPowerTopologyStatus) == NVAPI_OK)
         {
             for (NvU32 i = 0; i < nvPowerTopologyStatus.count; i++)
             {
@@ -545,13 +626,15 @@ PPH_STRING NvGpuQueryPcbValue(VOID)
 }
 
 
-PPH_STRING NvGpuQueryDriverSettings(VOID)
+PPH_STRING NvGpuQueryDriverSettings(
+    _In_ PNVGPU_DEVICE Device
+    )
 {
     if (NvAPI_GetDisplayDriverRegistryPath)
     {
         NvAPI_LongString nvKeyPathAnsiString = "";
 
-        if (NvAPI_GetDisplayDriverRegistryPath(NvGpuDisplayHandleList->Items[0], nvKeyPathAnsiString) == NVAPI_OK)
+        if (NvAPI_GetDisplayDriverRegistryPath(NvGpuGetDisplayHandle(Device), nvKeyPathAnsiString) == NVAPI_OK)
         {
             HANDLE keyHandle;
             PPH_STRING keyPath;
@@ -633,7 +716,9 @@ PPH_STRING NvGpuQueryDriverSettings(VOID)
 }
 
 
-BOOLEAN NvGpuDriverIsWHQL(VOID)
+BOOLEAN NvGpuDriverIsWHQL(
+    _In_ PNVGPU_DEVICE Device
+    )
 {
     BOOLEAN nvGpuDriverIsWHQL = FALSE;
     HANDLE keyHandle = NULL;
@@ -649,7 +734,7 @@ BOOLEAN NvGpuDriverIsWHQL(VOID)
     if (!NvAPI_GetDisplayDriverRegistryPath)
         goto CleanupExit;
 
-    if (NvAPI_GetDisplayDriverRegistryPath(NvGpuDisplayHandleList->Items[0], nvNameAnsiString) != NVAPI_OK)
+    if (NvAPI_GetDisplayDriverRegistryPath(NvGpuGetDisplayHandle(Device), nvNameAnsiString) != NVAPI_OK)
         goto CleanupExit;
 
     keyPath = PhConvertMultiByteToUtf16(nvNameAnsiString);
@@ -895,118 +980,167 @@ CleanupExit:
     return nvGpuDriverIsWHQL;
 }
 
-PPH_STRING NvGpuQueryFanSpeed(VOID)
+PPH_STRING NvGpuFormatFanSpeed(
+    _In_ PNVGPU_DEVICE Device
+    )
 {
-    NvU32 tachValue = 0;
-    NV_GPU_COOLER_SETTINGS coolerInfo = { NV_GPU_COOLER_SETTINGS_VER };
-
-    if (NvAPI_GPU_GetTachReading && NvAPI_GPU_GetTachReading(NvGpuPhysicalHandleList->Items[0], &tachValue) == NVAPI_OK)
-    {
-        if (NvAPI_GPU_GetCoolerSettings && NvAPI_GPU_GetCoolerSettings(NvGpuPhysicalHandleList->Items[0], NVAPI_COOLER_TARGET_ALL, &coolerInfo) == NVAPI_OK)
-        {
-            return PhFormatString(L"%lu RPM (%lu%%)", tachValue, coolerInfo.cooler[0].currentLevel);
-        }
-
-        return PhFormatString(L"%lu RPM", tachValue);
-    }
-    else
-    {
-        if (NvAPI_GPU_GetCoolerSettings && NvAPI_GPU_GetCoolerSettings(NvGpuPhysicalHandleList->Items[0], NVAPI_COOLER_TARGET_ALL, &coolerInfo) == NVAPI_OK)
-        {
-            return PhFormatString(L"%lu%%", coolerInfo.cooler[0].currentLevel);
-        }
-    }
+    if (Device->FanRpmValid && Device->FanLevelValid)
+        return PhFormatString(L"%lu RPM (%lu%%)", Device->FanRpm, Device->FanLevel);
+    if (Device->FanRpmValid)
+        return PhFormatString(L"%lu RPM", Device->FanRpm);
+    if (Device->FanLevelValid)
+        return PhFormatString(L"%lu%%", Device->FanLevel);
 
     return PhCreateString(L"N/A");
 }
 
-VOID NvGpuUpdateValues(VOID)
+VOID NvGpuQueryStaticInfo(
+    _Inout_ PNVGPU_DEVICE Device
+    )
+{
+    Device->Name = NvGpuQueryName(Device);
+    Device->ShortName = NvGpuQueryShortName(Device);
+    Device->VbiosVersion = NvGpuQueryVbiosVersionString(Device);
+    Device->Revision = NvGpuQueryRevision(Device); // Caches ArchType for NvGpuQueryRopsCount.
+    Device->DeviceId = NvGpuQueryDeviceId(Device);
+    Device->RopsCount = NvGpuQueryRopsCount(Device);
+    Device->ShaderCount = NvGpuQueryShaderCount(Device);
+    Device->RamType = NvGpuQueryRamType(Device);
+    Device->Foundry = NvGpuQueryFoundry(Device);
+}
+
+VOID NvGpuQueryUsages(
+    _In_ PNVGPU_DEVICE Device,
+    _Inout_ PNVGPU_SAMPLE Sample
+    )
 {
     NV_USAGES_INFO usagesInfo = { NV_USAGES_INFO_VER };
     NV_DISPLAY_DRIVER_MEMORY_INFO memoryInfo = { NV_DISPLAY_DRIVER_MEMORY_INFO_VER };
-    NV_GPU_THERMAL_SETTINGS thermalSettings = { NV_GPU_THERMAL_SETTINGS_VER };
-    NV_GPU_CLOCK_FREQUENCIES clkFreqs  = { NV_GPU_CLOCK_FREQUENCIES_VER };
-    NV_CLOCKS_INFO clocksInfo = { NV_CLOCKS_INFO_VER };
 
-    if (NvAPI_GPU_GetMemoryInfo(NvGpuDisplayHandleList->Items[0], &memoryInfo) == NVAPI_OK)
+    // NvAPI_GetDisplayDriverMemoryInfo takes a display handle, so on drivers without the
+    // per-GPU export it only works for GPUs that drive a display.
+    if ((NvAPI_GPU_GetMemoryInfo && NvAPI_GPU_GetMemoryInfo(Device->PhysicalHandle, &memoryInfo) == NVAPI_OK) ||
+        (!NvAPI_GPU_GetMemoryInfo && NvAPI_GetDisplayDriverMemoryInfo && Device->DisplayHandle &&
+        NvAPI_GetDisplayDriverMemoryInfo(Device->DisplayHandle, &memoryInfo) == NVAPI_OK))
     {
-        GpuMemoryLimit = memoryInfo.availableDedicatedVideoMemory;
-        GpuCurrentMemSharedUsage = memoryInfo.sharedSystemMemory;
-        GpuCurrentMemUsage = memoryInfo.availableDedicatedVideoMemory - memoryInfo.curAvailableDedicatedVideoMemory;
+        Sample->MemoryLimit = memoryInfo.availableDedicatedVideoMemory;
+        Sample->MemSharedUsage = memoryInfo.sharedSystemMemory;
+        Sample->MemUsage = memoryInfo.availableDedicatedVideoMemory - memoryInfo.curAvailableDedicatedVideoMemory;
     }
 
-    if (NvAPI_GPU_GetUsages(NvGpuPhysicalHandleList->Items[0], &usagesInfo) == NVAPI_OK)
+    if (NvAPI_GPU_GetUsages && NvAPI_GPU_GetUsages(Device->PhysicalHandle, &usagesInfo) == NVAPI_OK)
     {
-        GpuCurrentGpuUsage = (FLOAT)usagesInfo.usages[2] / 100;
-        GpuCurrentCoreUsage = (FLOAT)usagesInfo.usages[6] / 100;
-        GpuCurrentBusUsage = (FLOAT)usagesInfo.usages[14] / 100;
+        Sample->GpuUsage = (FLOAT)usagesInfo.usages[2] / 100;
+        Sample->CoreUsage = (FLOAT)usagesInfo.usages[6] / 100;
+        Sample->BusUsage = (FLOAT)usagesInfo.usages[14] / 100;
+
+        Sample->GpuUsageTotal += Sample->GpuUsage;
+        Sample->CoreUsageTotal += Sample->CoreUsage;
+        Sample->BusUsageTotal += Sample->BusUsage;
+        Sample->UsageCount++;
     }
+}
 
-    if (NvAPI_GPU_GetThermalSettings(NvGpuPhysicalHandleList->Items[0], NVAPI_THERMAL_TARGET_ALL, &thermalSettings) == NVAPI_OK)
+VOID NvGpuQuerySensors(
+    _In_ PNVGPU_DEVICE Device,
+    _Inout_ PNVGPU_SAMPLE Sample
+    )
+{
+    NvU32 tachValue = 0;
+    NV_GPU_THERMAL_SETTINGS thermalSettings = { NV_GPU_THERMAL_SETTINGS_VER };
+    NV_GPU_CLOCK_FREQUENCIES clkFreqs  = { NV_GPU_CLOCK_FREQUENCIES_VER };
+    NV_CLOCKS_INFO clocksInfo = { NV_CLOCKS_INFO_VER };
+    NV_GPU_COOLER_SETTINGS coolerInfo = { NV_GPU_COOLER_SETTINGS_VER };
+    NV_VOLTAGE_DOMAINS voltageDomains;
+    //Nv120 clockInfo = { NV_PERF_CLOCKS_INFO_VER };
+
+    if (NvAPI_GPU_GetThermalSettings && NvAPI_GPU_GetThermalSettings(Device->PhysicalHandle, NVAPI_THERMAL_TARGET_ALL, &thermalSettings) == NVAPI_OK)
     {
-        GpuCurrentCoreTemp = thermalSettings.sensor[0].currentTemp;
-        GpuCurrentBoardTemp = thermalSettings.sensor[1].currentTemp;
+        Sample->CoreTemp = thermalSettings.sensor[0].currentTemp;
+        Sample->BoardTemp = thermalSettings.sensor[1].currentTemp;
     }
 
-    if (NvAPI_GPU_GetAllClockFrequencies(NvGpuPhysicalHandleList->Items[0], &clkFreqs) == NVAPI_OK)
+    if (NvAPI_GPU_GetAllClockFrequencies && NvAPI_GPU_GetAllClockFrequencies(Device->PhysicalHandle, &clkFreqs) == NVAPI_OK)
     {
         //if (clkFreqs.domain[NVAPI_GPU_PUBLIC_CLOCK_GRAPHICS].bIsPresent)
-        GpuCurrentCoreClock = clkFreqs.domain[NVAPI_GPU_PUBLIC_CLOCK_GRAPHICS].frequency / 1000;
+        Sample->CoreClock = clkFreqs.domain[NVAPI_GPU_PUBLIC_CLOCK_GRAPHICS].frequency / 1000;
 
         //if (clkFreqs.domain[NVAPI_GPU_PUBLIC_CLOCK_MEMORY].bIsPresent)
-        GpuCurrentMemoryClock = clkFreqs.domain[NVAPI_GPU_PUBLIC_CLOCK_MEMORY].frequency / 1000;
+        Sample->MemoryClock = clkFreqs.domain[NVAPI_GPU_PUBLIC_CLOCK_MEMORY].frequency / 1000;
 
         //if (clkFreqs.domain[NVAPI_GPU_PUBLIC_CLOCK_PROCESSOR].bIsPresent)
-        GpuCurrentShaderClock = clkFreqs.domain[NVAPI_GPU_PUBLIC_CLOCK_PROCESSOR].frequency / 1000;
+        Sample->ShaderClock = clkFreqs.domain[NVAPI_GPU_PUBLIC_CLOCK_PROCESSOR].frequency / 1000;
     }
 
-    if (NvAPI_GPU_GetAllClocks(NvGpuPhysicalHandleList->Items[0], &clocksInfo) == NVAPI_OK)
+    if (NvAPI_GPU_GetAllClocks && NvAPI_GPU_GetAllClocks(Device->PhysicalHandle, &clocksInfo) == NVAPI_OK)
     {
-        if (GpuCurrentCoreClock == 0)
-            GpuCurrentCoreClock = clocksInfo.clocks[0] / 1000;
+        if (Sample->CoreClock == 0)
+            Sample->CoreClock = clocksInfo.clocks[0] / 1000;
 
-        if (GpuCurrentMemoryClock == 0)
-            GpuCurrentMemoryClock = clocksInfo.clocks[1] / 1000;
+        if (Sample->MemoryClock == 0)
+            Sample->MemoryClock = clocksInfo.clocks[1] / 1000;
 
-        if (GpuCurrentShaderClock == 0)
-            GpuCurrentShaderClock = clocksInfo.clocks[2] / 1000;
+        if (Sample->ShaderClock == 0)
+            Sample->ShaderClock = clocksInfo.clocks[2] / 1000;
 
         if (clocksInfo.clocks[30] != 0)
         {
-            if (GpuCurrentCoreClock == 0)
-                GpuCurrentCoreClock = (ULONG)(clocksInfo.clocks[30] * 0.0005f);
+            if (Sample->CoreClock == 0)
+                Sample->CoreClock = (ULONG)(clocksInfo.clocks[30] * 0.0005f);
 
-            if (GpuCurrentShaderClock == 0)
-                GpuCurrentShaderClock = (ULONG)(clocksInfo.clocks[30] * 0.001f);
+            if (Sample->ShaderClock == 0)
+                Sample->ShaderClock = (ULONG)(clocksInfo.clocks[30] * 0.001f);
         }
     }
-}
-
-VOID NvGpuUpdateVoltage(VOID)
-{
-    NV_VOLTAGE_DOMAINS voltageDomains;
-    //Nv120 clockInfo = { NV_PERF_CLOCKS_INFO_VER };
 
     memset(&voltageDomains, 0, sizeof(NV_VOLTAGE_DOMAINS));
     voltageDomains.version = NV_VOLTAGE_DOMAIN_INFO_VER;
 
-    if (NvAPI_GPU_GetVoltageDomainsStatus(NvGpuPhysicalHandleList->Items[0], &voltageDomains) == NVAPI_OK)
+    if (NvAPI_GPU_GetVoltageDomainsStatus && NvAPI_GPU_GetVoltageDomainsStatus(Device->PhysicalHandle, &voltageDomains) == NVAPI_OK)
     {
-        GpuCurrentVoltage = voltageDomains.domain[0].mvolt / 1000;
-
-        //for (NvU32 i = 0; i < voltageDomains.max; i++)
-        //{
-        //    if (voltageDomains.domain[i].domainId == NVAPI_GPU_PERF_VOLTAGE_INFO_DOMAIN_CORE)
-        //    {
-        //        OutputDebugString(PhaFormatString(L"Voltage: [%lu] %lu\r\n", i, voltageDomains.domain[0].mvolt / 1000))->Buffer);
-        //    }
-        //}
+        Sample->Voltage = voltageDomains.domain[0].mvolt / 1000;
     }
 
-    //if (NvAPI_GPU_GetPerfDecreaseInfo(NvGpuPhysicalHandleList->Items[0], &GpuPerfDecreaseReason) != NVAPI_OK)
+    Sample->FanRpmValid = NvAPI_GPU_GetTachReading && NvAPI_GPU_GetTachReading(Device->PhysicalHandle, &tachValue) == NVAPI_OK;
+    Sample->FanRpm = tachValue;
+
+    Sample->FanLevelValid = NvAPI_GPU_GetCoolerSettings && NvAPI_GPU_GetCoolerSettings(Device->PhysicalHandle, NVAPI_COOLER_TARGET_ALL, &coolerInfo) == NVAPI_OK;
+    Sample->FanLevel = coolerInfo.cooler[0].currentLevel;
+
+    //if (NvAPI_GPU_GetPerfDecreaseInfo(Device->PhysicalHandle, &GpuPerfDecreaseReason) != NVAPI_OK)
     //{
     //    GpuPerfDecreaseReason = NV_GPU_PERF_DECREASE_REASON_UNKNOWN;
     //}
 
-    //NvAPI_GPU_GetPerfClocks(NvGpuPhysicalHandleList->Items[0], 0, &clockInfo);
-}
\ No newline at end of file
+    //NvAPI_GPU_GetPerfClocks(Device->PhysicalHandle, 0, &clockInfo);
+}
+
+VOID NvGpuQueryActiveApps(
+    _In_ PNVGPU_DEVICE Device,
+    _Inout_ PNVGPU_SAMPLE Sample
+    )
+{
+    NvU32 total = NVAPI_MAX_PROCESSES;
+
+    Sample->ActiveAppCount = 0;
+
+    if (!NvAPI_GPU_QueryActiveApps)
+        return;
+
+    // Each entry carries a long string, so the array is too large for the stack.
+    if (!NvGpuActiveAppBuffer)
+        NvGpuActiveAppBuffer = PhAllocate(sizeof(NV_ACTIVE_APP) * NVAPI_MAX_PROCESSES);
+
+    for (NvU32 i = 0; i < NVAPI_MAX_PROCESSES; i++)
+        NvGpuActiveAppBuffer[i].version = NV_ACTIVE_APPS_INFO_VER;
+
+    if (NvAPI_GPU_QueryActiveApps(Device->PhysicalHandle, NvGpuActiveAppBuffer, &total) == NVAPI_OK)
+    {
+        total = min(total, min(NVAPI_MAX_PROCESSES, NVGPU_MAX_ACTIVE_APPS));
+
+        for (NvU32 i = 0; i < total; i++)
+            Sample->ActiveAppIds[i] = UlongToHandle(NvGpuActiveAppBuffer[i].processPID);
+
+        Sample->ActiveAppCount = total;
+    }
+}
@@ -598,5 +598,11 @@ typedef struct _NV_PCIE_INFO
 typedef NvAPI_Status (WINAPIV *_NvAPI_GPU_GetPCIEInfo)(_In_ NvPhysicalGpuHandle hPhysicalGPU, _Inout_ NV_PCIE_INFO* pPciInfo);
 _NvAPI_GPU_GetPCIEInfo NvAPI_GPU_GetPCIEInfo;
 
+#ifdef NVGPU_MOCK_NVAPI
+// nvmock.c
+PVOID WINAPIV NvGpuMockQueryInterface(
+    _In_ NvU32 FunctionOffset
+    );
+#endif
 
 #include <poppack.h>
\ No newline at end of file
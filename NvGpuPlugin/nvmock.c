@@ -0,0 +1,378 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Nvidia GPU Plugin
+ *
+ * Copyright (C) 2016 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Simulated NVAPI backend. Build with NVGPU_MOCK_NVAPI defined to run the plugin on
+// machines without an NVIDIA driver: InitializeNvApi resolves every function through
+// NvGpuMockQueryInterface instead of nvapi.dll. NVGPU_MOCK_DEVICE_COUNT physical GPUs
+// are reported; the first two drive a display and the remainder are headless, which
+// exercises the display-to-GPU mapping. Values follow deterministic per-device
+// waveforms so that each section's graphs are distinguishable. The active-app list
+// reports Process Hacker itself on every even-numbered GPU. Physical GPU and display
+// handles are distinct values and every function rejects the wrong kind, as the
+// driver does.
+
+#ifdef NVGPU_MOCK_NVAPI
+
+#include "main.h"
+#include "nvapi\nvapi.h"
+#include "nvidia.h"
+#include <stdio.h>
+
+#ifndef NVGPU_MOCK_DEVICE_COUNT
+#define NVGPU_MOCK_DEVICE_COUNT 4
+#endif
+
+#define NVGPU_MOCK_DISPLAY_COUNT min(2, NVGPU_MOCK_DEVICE_COUNT)
+#define NVGPU_MOCK_HANDLE_BASE 0x1000
+#define NVGPU_MOCK_MEMORY_KB (8 * 1024 * 1024)
+
+static ULONG NvGpuMockTick[NVGPU_MOCK_DEVICE_COUNT];
+
+static NvPhysicalGpuHandle NvGpuMockPhysicalHandle(
+    _In_ ULONG Index
+    )
+{
+    return (NvPhysicalGpuHandle)(ULONG_PTR)(NVGPU_MOCK_HANDLE_BASE + Index * 0x10);
+}
+
+static NvDisplayHandle NvGpuMockDisplayHandle(
+    _In_ ULONG Index
+    )
+{
+    return (NvDisplayHandle)(ULONG_PTR)(NVGPU_MOCK_HANDLE_BASE + Index * 0x10 + 0x8);
+}
+
+static BOOLEAN NvGpuMockDeviceIndex(
+    _In_ NvPhysicalGpuHandle PhysicalHandle,
+    _Out_ PULONG Index
+    )
+{
+    ULONG_PTR value = (ULONG_PTR)PhysicalHandle;
+
+    if (value < NVGPU_MOCK_HANDLE_BASE || (value - NVGPU_MOCK_HANDLE_BASE) % 0x10 != 0)
+        return FALSE;
+    if ((value - NVGPU_MOCK_HANDLE_BASE) / 0x10 >= NVGPU_MOCK_DEVICE_COUNT)
+        return FALSE;
+
+    *Index = (ULONG)((value - NVGPU_MOCK_HANDLE_BASE) / 0x10);
+    return TRUE;
+}
+
+// Triangle wave in [0, 100] with a per-device period and phase.
+static NvU32 NvGpuMockWave(
+    _In_ ULONG Index,
+    _In_ ULONG Tick
+    )
+{
+    ULONG period = 20 + Index * 10;
+    ULONG position = (Tick + Index * 7) % period;
+
+    if (position < period / 2)
+        return position * 200 / period;
+    else
+        return (period - position) * 200 / period;
+}
+
+static NvAPI_Status __cdecl NvGpuMockInitialize(VOID)
+{
+    return NVAPI_OK;
+}
+
+static NvAPI_Status __cdecl NvGpuMockUnload(VOID)
+{
+    return NVAPI_OK;
+}
+
+static NvAPI_Status __cdecl NvGpuMockGetErrorMessage(NvAPI_Status nr, NvAPI_ShortString szDesc)
+{
+    sprintf_s(szDesc, NVAPI_SHORT_STRING_MAX, "Mock NVAPI error %d", nr);
+    return NVAPI_OK;
+}
+
+static NvAPI_Status __cdecl NvGpuMockEnumPhysicalGPUs(NvPhysicalGpuHandle nvGPUHandle[NVAPI_MAX_PHYSICAL_GPUS], NvU32* pGpuCount)
+{
+    if (!nvGPUHandle || !pGpuCount)
+        return NVAPI_INVALID_ARGUMENT;
+
+    for (ULONG i = 0; i < NVGPU_MOCK_DEVICE_COUNT; i++)
+        nvGPUHandle[i] = NvGpuMockPhysicalHandle(i);
+
+    *pGpuCount = NVGPU_MOCK_DEVICE_COUNT;
+    return NVAPI_OK;
+}
+
+static NvAPI_Status __cdecl NvGpuMockEnumNvidiaDisplayHandle(NvU32 thisEnum, NvDisplayHandle *pNvDispHandle)
+{
+    if (!pNvDispHandle)
+        return NVAPI_INVALID_ARGUMENT;
+    if (thisEnum >= NVGPU_MOCK_DISPLAY_COUNT)
+        return NVAPI_END_ENUMERATION;
+
+    *pNvDispHandle = NvGpuMockDisplayHandle(thisEnum);
+    return NVAPI_OK;
+}
+
+static BOOLEAN NvGpuMockDisplayIndex(
+    _In_ NvDisplayHandle DisplayHandle,
+    _Out_ PULONG Index
+    )
+{
+    for (ULONG i = 0; i < NVGPU_MOCK_DISPLAY_COUNT; i++)
+    {
+        if (NvGpuMockDisplayHandle(i) == DisplayHandle)
+        {
+            *Index = i;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static NvAPI_Status __cdecl NvGpuMockGetPhysicalGPUsFromDisplay(NvDisplayHandle hNvDisp, NvPhysicalGpuHandle nvGPUHandle[NVAPI_MAX_PHYSICAL_GPUS], NvU32 *pGpuCount)
+{
+    ULONG index;
+
+    if (!NvGpuMockDisplayIndex(hNvDisp, &index))
+        return NVAPI_EXPECTED_DISPLAY_HANDLE;
+
+    nvGPUHandle[0] = NvGpuMockPhysicalHandle(index);
+    *pGpuCount = 1;
+    return NVAPI_OK;
+}
+
+static NvAPI_Status __cdecl NvGpuMockGetDriverAndBranchVersion(NvU32* pDriverVersion, NvAPI_ShortString szBuildBranchString)
+{
+    *pDriverVersion = 36847;
+    sprintf_s(szBuildBranchString, NVAPI_SHORT_STRING_MAX, "r368_00-mock");
+    return NVAPI_OK;
+}
+
+static NvAPI_Status __cdecl NvGpuMockGetFullName(NvPhysicalGpuHandle hPhysicalGpu, NvAPI_ShortString szName)
+{
+    ULONG index;
+
+    if (!NvGpuMockDeviceIndex(hPhysicalGpu, &index))
+        return NVAPI_EXPECTED_PHYSICAL_GPU_HANDLE;
+
+    sprintf_s(szName, NVAPI_SHORT_STRING_MAX, "Mock GeForce GPU #%lu", index);
+    return NVAPI_OK;
+}
+
+static VOID NvGpuMockFillMemoryInfo(
+    _In_ ULONG Index,
+    _Out_ NV_DISPLAY_DRIVER_MEMORY_INFO *pMemoryInfo
+    )
+{
+    pMemoryInfo->dedicatedVideoMemory = NVGPU_MOCK_MEMORY_KB;
+    pMemoryInfo->availableDedicatedVideoMemory = NVGPU_MOCK_MEMORY_KB;
+    pMemoryInfo->systemVideoMemory = 0;
+    pMemoryInfo->sharedSystemMemory = NVGPU_MOCK_MEMORY_KB / 2;
+    pMemoryInfo->curAvailableDedicatedVideoMemory = NVGPU_MOCK_MEMORY_KB -
+        NVGPU_MOCK_MEMORY_KB / 100 * NvGpuMockWave(Index, NvGpuMockTick[Index] / 4);
+}
+
+// Like the real exports, each memory query only accepts its own handle type, so passing
+// a display handle where a physical GPU handle is expected (or the reverse) fails here.
+static NvAPI_Status __cdecl NvGpuMockGetMemoryInfo(NvPhysicalGpuHandle hPhysicalGpu, NV_DISPLAY_DRIVER_MEMORY_INFO *pMemoryInfo)
+{
+    ULONG index;
+
+    if (!NvGpuMockDeviceIndex(hPhysicalGpu, &index))
+        return NVAPI_EXPECTED_PHYSICAL_GPU_HANDLE;
+
+    NvGpuMockFillMemoryInfo(index, pMemoryInfo);
+    return NVAPI_OK;
+}
+
+static NvAPI_Status __cdecl NvGpuMockGetDisplayDriverMemoryInfo(NvDisplayHandle hNvDisp, NV_DISPLAY_DRIVER_MEMORY_INFO *pMemoryInfo)
+{
+    ULONG index;
+
+    if (!NvGpuMockDisplayIndex(hNvDisp, &index))
+        return NVAPI_EXPECTED_DISPLAY_HANDLE;
+
+    // The display maps to the GPU with the same index (see NvGpuMockGetPhysicalGPUsFromDisplay).
+    NvGpuMockFillMemoryInfo(index, pMemoryInfo);
+    return NVAPI_OK;
+}
+
+static NvAPI_Status __cdecl NvGpuMockGetUsages(NvPhysicalGpuHandle hPhysicalGpu, NV_USAGES_INFO* pUsagesInfo)
+{
+    ULONG index;
+    ULONG tick;
+
+    if (!NvGpuMockDeviceIndex(hPhysicalGpu, &index))
+        return NVAPI_EXPECTED_PHYSICAL_GPU_HANDLE;
+
+    // Usages are sampled once per update, so this is where simulated time advances.
+    tick = NvGpuMockTick[index]++;
+
+    memset(pUsagesInfo->usages, 0, sizeof(pUsagesInfo->usages));
+    pUsagesInfo->usages[2] = NvGpuMockWave(index, tick);
+    pUsagesInfo->usages[6] = NvGpuMockWave(index, tick + 3) / 2;
+    pUsagesInfo->usages[14] = NvGpuMockWave(index, tick + 5) / 4;
+
+    return NVAPI_OK;
+}
+
+static NvAPI_Status __cdecl NvGpuMockGetThermalSettings(NvPhysicalGpuHandle hPhysicalGpu, NvU32 sensorIndex, NV_GPU_THERMAL_SETTINGS *pThermalSettings)
+{
+    ULONG index;
+
+    if (!NvGpuMockDeviceIndex(hPhysicalGpu, &index))
+        return NVAPI_EXPECTED_PHYSICAL_GPU_HANDLE;
+
+    pThermalSettings->count = 2;
+    pThermalSettings->sensor[0].currentTemp = 40 + NvGpuMockWave(index, NvGpuMockTick[index]) / 3;
+    pThermalSettings->sensor[1].currentTemp = 35 + NvGpuMockWave(index, NvGpuMockTick[index]) / 4;
+
+    return NVAPI_OK;
+}
+
+static NvAPI_Status __cdecl NvGpuMockGetAllClockFrequencies(NvPhysicalGpuHandle hPhysicalGPU, NV_GPU_CLOCK_FREQUENCIES* pClkFreqs)
+{
+    ULONG index;
+    NvU32 load;
+
+    if (!NvGpuMockDeviceIndex(hPhysicalGPU, &index))
+        return NVAPI_EXPECTED_PHYSICAL_GPU_HANDLE;
+
+    load = NvGpuMockWave(index, NvGpuMockTick[index]);
+
+    memset(pClkFreqs->domain, 0, sizeof(pClkFreqs->domain));
+    pClkFreqs->domain[NVAPI_GPU_PUBLIC_CLOCK_GRAPHICS].bIsPresent = TRUE;
+    pClkFreqs->domain[NVAPI_GPU_PUBLIC_CLOCK_GRAPHICS].frequency = (300 + load * 15) * 1000;
+    pClkFreqs->domain[NVAPI_GPU_PUBLIC_CLOCK_MEMORY].bIsPresent = TRUE;
+    pClkFreqs->domain[NVAPI_GPU_PUBLIC_CLOCK_MEMORY].frequency = (load ? 3500 : 405) * 1000;
+    pClkFreqs->domain[NVAPI_GPU_PUBLIC_CLOCK_PROCESSOR].bIsPresent = TRUE;
+    pClkFreqs->domain[NVAPI_GPU_PUBLIC_CLOCK_PROCESSOR].frequency = (600 + load * 30) * 1000;
+
+    return NVAPI_OK;
+}
+
+static NvAPI_Status __cdecl NvGpuMockGetVoltageDomainsStatus(NvPhysicalGpuHandle hPhysicalGPU, NV_VOLTAGE_DOMAINS* pVoltageDomainsStatus)
+{
+    ULONG index;
+
+    if (!NvGpuMockDeviceIndex(hPhysicalGPU, &index))
+        return NVAPI_EXPECTED_PHYSICAL_GPU_HANDLE;
+
+    pVoltageDomainsStatus->max = 1;
+    pVoltageDomainsStatus->domain[0].domainId = NVAPI_GPU_PERF_VOLTAGE_INFO_DOMAIN_CORE;
+    pVoltageDomainsStatus->domain[0].mvolt = (800 + NvGpuMockWave(index, NvGpuMockTick[index]) * 3) * 1000;
+
+    return NVAPI_OK;
+}
+
+static NvAPI_Status __cdecl NvGpuMockGetCoolerSettings(NvPhysicalGpuHandle hPhysicalGpu, NvU32 coolerIndex, NV_GPU_COOLER_SETTINGS* pCoolerInfo)
+{
+    ULONG index;
+
+    if (!NvGpuMockDeviceIndex(hPhysicalGpu, &index))
+        return NVAPI_EXPECTED_PHYSICAL_GPU_HANDLE;
+
+    pCoolerInfo->count = 1;
+    pCoolerInfo->cooler[0].currentLevel = 30 + NvGpuMockWave(index, NvGpuMockTick[index]) / 2;
+
+    return NVAPI_OK;
+}
+
+static NvAPI_Status __cdecl NvGpuMockGetTachReading(NvPhysicalGpuHandle hPhysicalGPU, NvU32 *pValue)
+{
+    ULONG index;
+
+    if (!NvGpuMockDeviceIndex(hPhysicalGPU, &index))
+        return NVAPI_EXPECTED_PHYSICAL_GPU_HANDLE;
+
+    *pValue = 1000 + NvGpuMockWave(index, NvGpuMockTick[index]) * 20;
+    return NVAPI_OK;
+}
+
+static NvAPI_Status __cdecl NvGpuMockQueryActiveApps(NvPhysicalGpuHandle hPhysicalGPU, NV_ACTIVE_APP pActiveApps[NVAPI_MAX_PROCESSES], NvU32* pTotal)
+{
+    ULONG index;
+
+    if (!NvGpuMockDeviceIndex(hPhysicalGPU, &index))
+        return NVAPI_EXPECTED_PHYSICAL_GPU_HANDLE;
+
+    if (index % 2 == 0)
+    {
+        pActiveApps[0].processPID = HandleToUlong(NtCurrentProcessId());
+        sprintf_s(pActiveApps[0].processName, NVAPI_LONG_STRING_MAX, "ProcessHacker.exe");
+        *pTotal = 1;
+    }
+    else
+    {
+        *pTotal = 0;
+    }
+
+    return NVAPI_OK;
+}
+
+PVOID WINAPIV NvGpuMockQueryInterface(
+    _In_ NvU32 FunctionOffset
+    )
+{
+    switch (FunctionOffset)
+    {
+    case 0x150E828UL:
+        return NvGpuMockInitialize;
+    case 0xD22BDD7EUL:
+        return NvGpuMockUnload;
+    case 0x6C2D048CUL:
+        return NvGpuMockGetErrorMessage;
+    case 0xE5AC921FUL:
+        return NvGpuMockEnumPhysicalGPUs;
+    case 0x9ABDD40DUL:
+        return NvGpuMockEnumNvidiaDisplayHandle;
+    case 0x34EF9506UL:
+        return NvGpuMockGetPhysicalGPUsFromDisplay;
+    case 0x2926AAADUL:
+        return NvGpuMockGetDriverAndBranchVersion;
+    case 0xCEEE8E9FUL:
+        return NvGpuMockGetFullName;
+    case 0x07F9B368UL:
+        return NvGpuMockGetMemoryInfo;
+    case 0x774AA982UL:
+        return NvGpuMockGetDisplayDriverMemoryInfo;
+    case 0x189A1FDFUL:
+        return NvGpuMockGetUsages;
+    case 0xE3640A56UL:
+        return NvGpuMockGetThermalSettings;
+    case 0xDCB616C3UL:
+        return NvGpuMockGetAllClockFrequencies;
+    case 0xC16C7E2CUL:
+        return NvGpuMockGetVoltageDomainsStatus;
+    case 0xDA141340UL:
+        return NvGpuMockGetCoolerSettings;
+    case 0x5F608315UL:
+        return NvGpuMockGetTachReading;
+    case 0x65B1C5F5UL:
+        return NvGpuMockQueryActiveApps;
+    }
+
+    // Everything else reports as unavailable, the same as an older driver would.
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,240 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Nvidia GPU Plugin
+ *
+ * Copyright (C) 2016 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "main.h"
+#include "gpujoin.h"
+
+// NVAPI only reports which processes have a context on each GPU, not how much of the GPU
+// or its memory they use, so that is all the process tree shows.
+
+// Both are only touched by the provider thread.
+static PPH_LIST NvGpuProcessList = NULL;
+static NVGPU_JOIN NvGpuProcessJoin;
+
+VOID NvGpuProcessInitialize(
+    VOID
+    )
+{
+    SIZE_T capacity = max(NvGpuDeviceCount, 1) * NVGPU_MAX_ACTIVE_APPS;
+
+    NvGpuProcessList = PhCreateList(64);
+    NvGpuJoinInitialize(&NvGpuProcessJoin, PhAllocate(capacity * sizeof(NVGPU_JOIN_ENTRY)), capacity);
+}
+
+static VOID NvGpuBuildProcessJoin(
+    VOID
+    )
+{
+    NvGpuJoinReset(&NvGpuProcessJoin);
+
+    for (ULONG i = 0; i < NvGpuDeviceCount; i++)
+    {
+        PNVGPU_DEVICE device = &NvGpuDevices[i];
+        uint32_t processIds[NVGPU_MAX_ACTIVE_APPS];
+        ULONG count = min(device->TickSample.ActiveAppCount, NVGPU_MAX_ACTIVE_APPS);
+
+        for (ULONG j = 0; j < count; j++)
+            processIds[j] = HandleToUlong(device->TickSample.ActiveAppIds[j]);
+
+        NvGpuJoinAddDevice(&NvGpuProcessJoin, i, processIds, count);
+    }
+
+    NvGpuJoinFinish(&NvGpuProcessJoin);
+}
+
+// Called on the UI thread. DeviceMask is written by the provider thread, so it is read
+// once and the text is always rebuilt from that copy.
+static PWSTR NvGpuFormatDeviceMask(
+    _Inout_ PNVGPU_PROCESS_EXTENSION Extension
+    )
+{
+    ULONG deviceMask = ReadULongAcquire(&Extension->DeviceMask);
+    PWCHAR buffer = Extension->DevicesText;
+    PH_FORMAT format[16];
+    ULONG count = 0;
+    SIZE_T returnLength;
+
+    if (Extension->DevicesTextMask == deviceMask && buffer[0] != UNICODE_NULL)
+        return buffer;
+
+    buffer[0] = UNICODE_NULL;
+
+    for (ULONG i = 0; i < 32 && count + 2 <= ARRAYSIZE(format); i++)
+    {
+        if (!(deviceMask & (1 << i)))
+            continue;
+
+        if (count != 0)
+            PhInitFormatS(&format[count++], L", ");
+
+        PhInitFormatU(&format[count++], i);
+    }
+
+    if (count != 0)
+        PhFormatToBuffer(format, count, buffer, sizeof(Extension->DevicesText), &returnLength);
+
+    Extension->DevicesTextMask = deviceMask;
+
+    return buffer;
+}
+
+VOID NvGpuUpdateProcesses(
+    VOID
+    )
+{
+    if (!NvGpuProcessList)
+        return;
+
+    NvGpuBuildProcessJoin();
+
+    for (ULONG i = 0; i < NvGpuProcessList->Count; i++)
+    {
+        PNVGPU_PROCESS_EXTENSION extension = NvGpuProcessList->Items[i];
+        ULONG deviceMask;
+
+        deviceMask = NvGpuJoinLookup(&NvGpuProcessJoin, HandleToUlong(extension->ProcessItem->ProcessId));
+
+        if (extension->DeviceMask != deviceMask)
+            WriteULongRelease(&extension->DeviceMask, deviceMask);
+    }
+}
+
+LONG NTAPI NvGpuProcessSortFunction(
+    _In_ PVOID Node1,
+    _In_ PVOID Node2,
+    _In_ ULONG SubId,
+    _In_ PH_SORT_ORDER SortOrder,
+    _In_ PVOID Context
+    )
+{
+    PPH_PROCESS_NODE node1 = Node1;
+    PPH_PROCESS_NODE node2 = Node2;
+    PNVGPU_PROCESS_EXTENSION extension1 = PhPluginGetObjectExtension(PluginInstance, node1->ProcessItem, EmProcessItemType);
+    PNVGPU_PROCESS_EXTENSION extension2 = PhPluginGetObjectExtension(PluginInstance, node2->ProcessItem, EmProcessItemType);
+
+    switch (SubId)
+    {
+    case COLUMN_ID_NVGPU_DEVICES:
+        return uintcmp(extension1->DeviceMask, extension2->DeviceMask);
+    }
+
+    return 0;
+}
+
+VOID NvGpuProcessTreeNewInitializing(
+    _In_ PPH_PLUGIN_TREENEW_INFORMATION Information
+    )
+{
+    PH_TREENEW_COLUMN column;
+
+    memset(&column, 0, sizeof(PH_TREENEW_COLUMN));
+    column.SortDescending = TRUE;
+    column.Width = 50;
+    column.Alignment = PH_ALIGN_LEFT;
+    column.TextFlags = DT_LEFT;
+    column.Text = L"Nvidia GPUs";
+    PhPluginAddTreeNewColumn(PluginInstance, Information->CmData, &column, COLUMN_ID_NVGPU_DEVICES, NULL, NvGpuProcessSortFunction);
+}
+
+VOID NvGpuProcessTreeNewMessage(
+    _In_ PPH_PLUGIN_TREENEW_MESSAGE Message
+    )
+{
+    if (Message->Message == TreeNewGetCellText)
+    {
+        PPH_TREENEW_GET_CELL_TEXT getCellText = Message->Parameter1;
+        PPH_PROCESS_NODE node = (PPH_PROCESS_NODE)getCellText->Node;
+        PNVGPU_PROCESS_EXTENSION extension;
+
+        if (Message->SubId != COLUMN_ID_NVGPU_DEVICES)
+            return;
+
+        extension = PhPluginGetObjectExtension(PluginInstance, node->ProcessItem, EmProcessItemType);
+
+        if (ReadULongAcquire(&extension->DeviceMask) != 0)
+            PhInitializeStringRefLongHint(&getCellText->Text, NvGpuFormatDeviceMask(extension));
+    }
+}
+
+VOID NvGpuProcessGetTooltipText(
+    _In_ PPH_PLUGIN_GET_TOOLTIP_TEXT GetTooltipText
+    )
+{
+    PPH_PROCESS_ITEM processItem = GetTooltipText->Parameter;
+    PNVGPU_PROCESS_EXTENSION extension;
+
+    extension = PhPluginGetObjectExtension(PluginInstance, processItem, EmProcessItemType);
+
+    if (extension->DeviceMask == 0)
+        return;
+
+    PhAppendFormatStringBuilder(
+        GetTooltipText->StringBuilder,
+        L"Nvidia GPU:\n    Context on GPU: %s\n",
+        NvGpuFormatDeviceMask(extension)
+        );
+}
+
+VOID NvGpuProcessItemCreate(
+    _In_ PVOID Object,
+    _In_ PH_EM_OBJECT_TYPE ObjectType,
+    _In_ PVOID Extension
+    )
+{
+    PNVGPU_PROCESS_EXTENSION extension = Extension;
+
+    memset(extension, 0, sizeof(NVGPU_PROCESS_EXTENSION));
+    extension->ProcessItem = Object;
+    extension->ListIndex = ULONG_MAX;
+}
+
+VOID NvGpuProcessAdded(
+    _In_ PPH_PROCESS_ITEM ProcessItem
+    )
+{
+    PNVGPU_PROCESS_EXTENSION extension = PhPluginGetObjectExtension(PluginInstance, ProcessItem, EmProcessItemType);
+
+    if (!NvGpuProcessList)
+        return;
+
+    extension->ListIndex = NvGpuProcessList->Count;
+    PhAddItemList(NvGpuProcessList, extension);
+}
+
+VOID NvGpuProcessRemoved(
+    _In_ PPH_PROCESS_ITEM ProcessItem
+    )
+{
+    PNVGPU_PROCESS_EXTENSION extension = PhPluginGetObjectExtension(PluginInstance, ProcessItem, EmProcessItemType);
+    PNVGPU_PROCESS_EXTENSION lastExtension;
+
+    if (!NvGpuProcessList || extension->ListIndex == ULONG_MAX)
+        return;
+
+    // Swap with the last entry so removal is O(1).
+    lastExtension = NvGpuProcessList->Items[NvGpuProcessList->Count - 1];
+    NvGpuProcessList->Items[extension->ListIndex] = lastExtension;
+    lastExtension->ListIndex = extension->ListIndex;
+    PhRemoveItemList(NvGpuProcessList, NvGpuProcessList->Count - 1);
+
+    extension->ListIndex = ULONG_MAX;
+}
@@ -0,0 +1,223 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Nvidia GPU Plugin
+ *
+ * Copyright (C) 2016 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Tests for the active-app join. They are not part of the plugin build.
+//
+//   gcc -g -O1 -fsanitize=address,undefined -I.. gpujoin_test.c ../gpujoin.c -o gpujoin_test
+//   ./gpujoin_test
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gpujoin.h"
+
+static int TestFailures = 0;
+
+#define CHECK(Expression) \
+    do { if (!(Expression)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #Expression); TestFailures++; } } while (0)
+
+#define TEST_CAPACITY 4096
+
+// Simulated NVAPI backend: the active-app list of each GPU for one poll.
+typedef struct _TEST_DEVICE
+{
+    size_t Count;
+    uint32_t ProcessIds[128];
+} TEST_DEVICE;
+
+static NVGPU_JOIN_ENTRY TestEntries[TEST_CAPACITY];
+
+static void TestBuild(
+    PNVGPU_JOIN Join,
+    TEST_DEVICE *Devices,
+    uint32_t DeviceCount
+    )
+{
+    NvGpuJoinReset(Join);
+
+    for (uint32_t i = 0; i < DeviceCount; i++)
+        CHECK(NvGpuJoinAddDevice(Join, i, Devices[i].ProcessIds, Devices[i].Count));
+
+    NvGpuJoinFinish(Join);
+}
+
+static void TestBasic(
+    void
+    )
+{
+    NVGPU_JOIN join;
+    TEST_DEVICE devices[3] =
+    {
+        { 3, { 100, 200, 300 } },
+        { 2, { 200, 400 } },
+        { 0 },
+    };
+
+    NvGpuJoinInitialize(&join, TestEntries, TEST_CAPACITY);
+    TestBuild(&join, devices, 3);
+
+    CHECK(join.Count == 4);
+    CHECK(NvGpuJoinLookup(&join, 100) == 0x1);
+    CHECK(NvGpuJoinLookup(&join, 200) == 0x3);
+    CHECK(NvGpuJoinLookup(&join, 300) == 0x1);
+    CHECK(NvGpuJoinLookup(&join, 400) == 0x2);
+    CHECK(NvGpuJoinLookup(&join, 0) == 0);
+    CHECK(NvGpuJoinLookup(&join, 250) == 0);
+    CHECK(NvGpuJoinLookup(&join, 0xffffffff) == 0);
+}
+
+static void TestDuplicatesAndEmpty(
+    void
+    )
+{
+    NVGPU_JOIN join;
+    TEST_DEVICE devices[2] =
+    {
+        { 4, { 8, 8, 4, 8 } },
+        { 1, { 8 } },
+    };
+
+    NvGpuJoinInitialize(&join, TestEntries, TEST_CAPACITY);
+
+    // Nothing added: every lookup misses.
+    NvGpuJoinFinish(&join);
+    CHECK(join.Count == 0);
+    CHECK(NvGpuJoinLookup(&join, 8) == 0);
+
+    TestBuild(&join, devices, 2);
+    CHECK(join.Count == 2);
+    CHECK(NvGpuJoinLookup(&join, 4) == 0x1);
+    CHECK(NvGpuJoinLookup(&join, 8) == 0x3);
+
+    // The next poll replaces the previous one; processes that left the GPUs are gone.
+    devices[0].Count = 1;
+    devices[0].ProcessIds[0] = 4;
+    devices[1].Count = 0;
+    TestBuild(&join, devices, 2);
+    CHECK(NvGpuJoinLookup(&join, 4) == 0x1);
+    CHECK(NvGpuJoinLookup(&join, 8) == 0);
+}
+
+static void TestHighDeviceIndex(
+    void
+    )
+{
+    NVGPU_JOIN join;
+    uint32_t processIds[] = { 12 };
+
+    NvGpuJoinInitialize(&join, TestEntries, TEST_CAPACITY);
+    NvGpuJoinAddDevice(&join, 31, processIds, 1);
+    NvGpuJoinAddDevice(&join, 32, processIds, 1);
+    NvGpuJoinAddDevice(&join, 40, processIds, 1);
+    NvGpuJoinFinish(&join);
+
+    // Only the first 32 GPUs fit in the mask; later ones must not shift into it.
+    CHECK(NvGpuJoinLookup(&join, 12) == 0x80000000);
+}
+
+static void TestCapacity(
+    void
+    )
+{
+    NVGPU_JOIN join;
+    NVGPU_JOIN_ENTRY entries[4];
+    uint32_t processIds[] = { 5, 1, 3, 7, 9, 11 };
+
+    NvGpuJoinInitialize(&join, entries, 4);
+    CHECK(!NvGpuJoinAddDevice(&join, 0, processIds, 6));
+    NvGpuJoinFinish(&join);
+
+    CHECK(join.Count == 4);
+    CHECK(NvGpuJoinLookup(&join, 1) == 0x1);
+    CHECK(NvGpuJoinLookup(&join, 7) == 0x1);
+    CHECK(NvGpuJoinLookup(&join, 9) == 0);
+}
+
+// Compares the join against a brute-force scan of the simulated backend.
+static void TestRandom(
+    void
+    )
+{
+    static TEST_DEVICE devices[8];
+    NVGPU_JOIN join;
+    uint32_t seed = 1;
+
+    NvGpuJoinInitialize(&join, TestEntries, TEST_CAPACITY);
+
+    for (uint32_t round = 0; round < 2000; round++)
+    {
+        uint32_t deviceCount = 1 + round % 8;
+
+        for (uint32_t i = 0; i < deviceCount; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            devices[i].Count = (seed >> 16) % 128;
+
+            for (size_t j = 0; j < devices[i].Count; j++)
+            {
+                seed = seed * 1103515245 + 12345;
+                devices[i].ProcessIds[j] = ((seed >> 16) % 300) * 4;
+            }
+        }
+
+        TestBuild(&join, devices, deviceCount);
+
+        for (uint32_t processId = 0; processId < 1300; processId += 2)
+        {
+            uint32_t expected = 0;
+
+            for (uint32_t i = 0; i < deviceCount; i++)
+            {
+                for (size_t j = 0; j < devices[i].Count; j++)
+                {
+                    if (devices[i].ProcessIds[j] == processId)
+                        expected |= 1u << i;
+                }
+            }
+
+            CHECK(NvGpuJoinLookup(&join, processId) == expected);
+        }
+
+        for (size_t i = 1; i < join.Count; i++)
+            CHECK(join.Entries[i - 1].ProcessId < join.Entries[i].ProcessId);
+    }
+}
+
+int main(
+    void
+    )
+{
+    TestBasic();
+    TestDuplicatesAndEmpty();
+    TestHighDeviceIndex();
+    TestCapacity();
+    TestRandom();
+
+    if (TestFailures)
+    {
+        printf("%d check(s) failed\n", TestFailures);
+        return 1;
+    }
+
+    printf("all tests passed\n");
+    return 0;
+}
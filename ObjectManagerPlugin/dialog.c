@@ -24,122 +24,115 @@
 
 static PH_STRINGREF RootDirectoryObject = PH_STRINGREF_INIT(L"\\");
 
-PPH_STRING GetSelectedTreeViewPath(
-    _In_ POBJ_CONTEXT Context
+static PDIRECTORY_NODE AddDirectoryTreeItem(
+    _In_ POBJ_CONTEXT Context,
+    _In_opt_ PDIRECTORY_NODE ParentNode,
+    _In_ PPH_STRINGREF Name
     )
 {
-    HTREEITEM treeItem;
-    PPH_STRING treePath = NULL;
-    WCHAR buffer[_MAX_FNAME] = L"";
+    PDIRECTORY_NODE node;
+    TV_INSERTSTRUCT insert;
 
-    treeItem = Context->SelectedTreeItem;
+    node = CreateDirectoryNode(ParentNode, Name);
 
-    while (treeItem != Context->RootTreeObject)
+    memset(&insert, 0, sizeof(TV_INSERTSTRUCT));
+    insert.item.mask = TVIF_TEXT | TVIF_PARAM | TVIF_CHILDREN;
+    insert.hInsertAfter = TVI_LAST;
+    insert.hParent = ParentNode ? ParentNode->TreeItem : TVI_ROOT;
+    insert.item.pszText = node->Name.Buffer;
+    insert.item.lParam = (LPARAM)node;
+    insert.item.cChildren = 1; // not known until the directory is enumerated
+
+    if (!ParentNode)
     {
-        TVITEM tvItem;
-        tvItem.mask = TVIF_PARAM | TVIF_HANDLE | TVIF_TEXT;
-        tvItem.hItem = treeItem;
-        tvItem.pszText = buffer;
-        tvItem.cchTextMax = ARRAYSIZE(buffer);
+        insert.item.mask |= TVIF_STATE;
+        insert.item.state = insert.item.stateMask = TVIS_EXPANDED;
+    }
 
-        if (!TreeView_GetItem(Context->TreeViewHandle, &tvItem))
-            break;
+    node->TreeItem = TreeView_InsertItem(Context->TreeViewHandle, &insert);
 
-        if (treePath)
-            treePath = PhaConcatStrings(3, buffer, L"\\", treePath->Buffer);
-        else
-            treePath = PhaCreateString(buffer);
+    return node;
+}
 
-        treeItem = TreeView_GetParent(Context->TreeViewHandle, treeItem);
-    }
+static VOID UpdateDirectoryTreeItem(
+    _In_ POBJ_CONTEXT Context,
+    _In_ PDIRECTORY_NODE Node
+    )
+{
+    TVITEM item;
 
-    return PhConcatStrings(2, L"\\", treePath->Buffer);
+    item.mask = TVIF_HANDLE | TVIF_CHILDREN;
+    item.hItem = Node->TreeItem;
+    item.cChildren = (Node->Children && Node->Children->Count != 0) ? 1 : 0;
+    TreeView_SetItem(Context->TreeViewHandle, &item);
+
+    TreeView_SortChildren(Context->TreeViewHandle, Node->TreeItem, FALSE);
 }
 
-HTREEITEM TreeViewAddItem(
-    _In_ HWND TreeViewHandle,
-    _In_ HTREEITEM Parent,
-    _In_ BOOLEAN Expanded,
-    _In_ PPH_STRINGREF Text
+static VOID EnumerateDirectoryNode(
+    _In_ POBJ_CONTEXT Context,
+    _In_ PDIRECTORY_NODE Node
     )
 {
-    TV_INSERTSTRUCT insert;
+    PPH_LIST names;
 
-    memset(&insert, 0, sizeof(TV_INSERTSTRUCT));
+    if (Node->Enumerated)
+        return;
 
-    insert.item.mask = TVIF_TEXT | TVIF_STATE;
-    insert.hInsertAfter = TVI_LAST;
-    insert.hParent = Parent;
-    insert.item.pszText = Text->Buffer;
+    Node->Enumerated = TRUE;
 
-    if (Expanded)
+    if (NT_SUCCESS(QueryDirectoryNames(&Node->Path->sr, &names)))
     {
-        insert.item.state = insert.item.stateMask = TVIS_EXPANDED;
+        for (ULONG i = 0; i < names->Count; i++)
+        {
+            PPH_STRING name = names->Items[i];
+
+            if (!FindChildDirectoryNode(Node, &name->sr))
+                AddDirectoryTreeItem(Context, Node, &name->sr);
+        }
+
+        FreeDirectoryNames(names);
     }
 
-    return TreeView_InsertItem(TreeViewHandle, &insert);
+    UpdateDirectoryTreeItem(Context, Node);
 }
 
-HTREEITEM TreeViewFindItem(
-    _In_ HWND TreeViewHandle, 
-    _In_ HTREEITEM ParentTreeItem, 
-    _In_ PWSTR Name
+static VOID ApplyDirectoryRefresh(
+    _In_ POBJ_CONTEXT Context,
+    _In_ PDIRECTORY_REFRESH Refresh
     )
 {
-    TVITEM treeItem;
-
-    for (
-        treeItem.hItem = TreeView_GetChild(TreeViewHandle, ParentTreeItem);
-        treeItem.hItem;
-        treeItem.hItem = TreeView_GetNextSibling(TreeViewHandle, treeItem.hItem)
-        )
+    for (ULONG i = 0; i < Refresh->Diffs->Count; i++)
     {
-        WCHAR itemText[_MAX_FNAME] = L"";
+        PDIRECTORY_DIFF diff = Refresh->Diffs->Items[i];
+        PDIRECTORY_NODE node;
 
-        treeItem.mask = TVIF_TEXT | TVIF_CHILDREN;
-        treeItem.pszText = itemText;
-        treeItem.cchTextMax = ARRAYSIZE(itemText);
+        // The directory may have been removed by an earlier diff.
+        if (!(node = FindDirectoryNodeByPath(Context->RootNode, &diff->Path->sr)))
+            continue;
 
-        if (TreeView_GetItem(TreeViewHandle, &treeItem))
+        for (ULONG j = 0; j < diff->Added->Count; j++)
         {
-            if (PhEqualStringZ(treeItem.pszText, Name, TRUE))
-            {
-                return treeItem.hItem;
-            }
+            PPH_STRING name = diff->Added->Items[j];
 
-            if (treeItem.cChildren)
-            {
-                HTREEITEM treeChildren;
-                
-                if (treeChildren = TreeViewFindItem(TreeViewHandle, treeItem.hItem, Name))
-                { 
-                    return treeChildren;
-                }
-            }
+            if (!FindChildDirectoryNode(node, &name->sr))
+                AddDirectoryTreeItem(Context, node, &name->sr);
         }
-    }
-
-    return NULL;
-}
 
-INT AddListViewItem(
-    _In_ HWND ListViewHandle,
-    _In_ INT Index,
-    _In_ INT Image,
-    _In_ PWSTR Text,
-    _In_opt_ PVOID Param
-    )
-{
-    LVITEM item;
+        for (ULONG j = 0; j < diff->Removed->Count; j++)
+        {
+            PPH_STRING name = diff->Removed->Items[j];
+            PDIRECTORY_NODE childNode;
 
-    item.mask = LVIF_TEXT | LVIF_PARAM | LVIF_IMAGE;
-    item.iItem = Index;
-    item.iSubItem = 0;
-    item.iImage = Image;
-    item.pszText = Text;
-    item.lParam = (LPARAM)Param;
+            if (childNode = FindChildDirectoryNode(node, &name->sr))
+            {
+                TreeView_DeleteItem(Context->TreeViewHandle, childNode->TreeItem);
+                DestroyDirectoryNode(childNode);
+            }
+        }
 
-    return ListView_InsertItem(ListViewHandle, &item);
+        UpdateDirectoryTreeItem(Context, node);
+    }
 }
 
 VOID InitializeTreeImages(
@@ -204,48 +197,6 @@ VOID InitializeListImages(
     DestroyIcon(icon);
 }
 
-static BOOLEAN NTAPI EnumDirectoryObjectsCallback(
-    _In_ PPH_STRINGREF Name,
-    _In_ PPH_STRINGREF TypeName,
-    _In_opt_ PVOID Context
-    )
-{
-    PDIRECTORY_ENUM_CONTEXT context = (PDIRECTORY_ENUM_CONTEXT)Context;
-
-    if (PhEqualStringZ(TypeName->Buffer, L"Directory", TRUE))
-    {
-        PPH_STRING childDirectoryPath;
-        HTREEITEM currentItem;
-
-        if (PhEqualStringRef(&context->DirectoryPath, &RootDirectoryObject, TRUE))
-        {
-            childDirectoryPath = PhConcatStringRef2(&context->DirectoryPath, Name);
-        }
-        else
-        {
-            childDirectoryPath = PhConcatStrings(3, context->DirectoryPath.Buffer, L"\\", Name->Buffer);
-        }
-
-        currentItem = TreeViewAddItem(
-            context->TreeViewHandle, 
-            context->RootTreeItem, 
-            FALSE, 
-            Name
-            );
-
-        // Recursively enumerate all subdirectories.
-        EnumDirectoryObjects(
-            context->TreeViewHandle, 
-            currentItem, 
-            PhGetStringRef(childDirectoryPath)
-            );
-
-        PhDereferenceObject(childDirectoryPath);
-    }
-
-    return TRUE;
-}
-
 static BOOLEAN NTAPI EnumCurrentDirectoryObjectsCallback(
     _In_ PPH_STRINGREF Name,
     _In_ PPH_STRINGREF TypeName,
@@ -256,139 +207,28 @@ static BOOLEAN NTAPI EnumCurrentDirectoryObjectsCallback(
 
     if (PhEqualStringZ(TypeName->Buffer, L"Directory", TRUE))
     {
-        if (!TreeViewFindItem(context->TreeViewHandle, context->SelectedTreeItem, Name->Buffer))
+        if (!FindChildDirectoryNode(context->SelectedNode, Name))
         {
-            TreeViewAddItem(context->TreeViewHandle, context->SelectedTreeItem, TRUE, Name);
+            AddDirectoryTreeItem(context, context->SelectedNode, Name);
         }
     }
     else
     {
-        INT index;
-        INT imageIndex;
-        POBJECT_ENTRY entry;
-        
-        entry = PhAllocate(sizeof(OBJECT_ENTRY));
-        memset(entry, 0, sizeof(OBJECT_ENTRY));
-
-        entry->Name = PhCreateString2(Name);
-        entry->TypeName = PhCreateString2(TypeName);
-      
-        if (PhEqualStringRef2(TypeName, L"ALPC Port", TRUE))
-        {
-            imageIndex = 6;
-        }
-        else if (PhEqualStringRef2(TypeName, L"Device", TRUE))
-        {
-            imageIndex = 2;
-        }
-        else if (PhEqualStringRef2(TypeName, L"Driver", TRUE))
-        {
-            imageIndex = 9;
-        }
-        else if (PhEqualStringRef2(TypeName, L"Event", TRUE))
-        {
-            imageIndex = 8;
-        }
-        else if (PhEqualStringRef2(TypeName, L"Key", TRUE))
-        {
-            imageIndex = 5;
-        }
-        else if (PhEqualStringRef2(TypeName, L"Mutant", TRUE))
-        {
-            imageIndex = 1;
-        }
-        else if (PhEqualStringRef2(TypeName, L"Section", TRUE))
-        {
-            imageIndex = 3;
-        }
-        else if (PhEqualStringRef2(TypeName, L"Session", TRUE))
-        {
-            imageIndex = 7;
-        }
-        else if (PhEqualStringRef2(TypeName, L"SymbolicLink", TRUE))
-        {
-            imageIndex = 4;
-        }
-        else
-        {
-            imageIndex = 0;
-        }
-
-        index = AddListViewItem(
-            context->ListViewHandle,
-            MAXINT,
-            imageIndex,
-            Name->Buffer,
-            entry
-            );
-
-        PhSetListViewSubItem(
-            context->ListViewHandle, 
-            index,
-            1, 
-            TypeName->Buffer
-            );
+        AddObjectEntry(context, Name, TypeName);
     }
 
     return TRUE;
 }
 
-NTSTATUS EnumDirectoryObjects(
-    _In_ HWND TreeViewHandle, 
-    _In_ HTREEITEM RootTreeItem,
-    _In_ PH_STRINGREF DirectoryPath
-    )
-{
-    HANDLE directoryHandle;
-    OBJECT_ATTRIBUTES oa;
-    UNICODE_STRING name;
-
-    PhStringRefToUnicodeString(&DirectoryPath, &name);
-
-    InitializeObjectAttributes(
-        &oa, 
-        &name, 
-        0, 
-        NULL, 
-        NULL
-        );
-
-    if (NT_SUCCESS(NtOpenDirectoryObject(
-        &directoryHandle, 
-        DIRECTORY_QUERY, 
-        &oa
-        )))
-    {
-        DIRECTORY_ENUM_CONTEXT enumContext;
-
-        enumContext.TreeViewHandle = TreeViewHandle;
-        enumContext.RootTreeItem = RootTreeItem;
-        enumContext.DirectoryPath = DirectoryPath;
-
-        PhEnumDirectoryObjects(
-            directoryHandle, 
-            EnumDirectoryObjectsCallback, 
-            &enumContext
-            );
-
-        NtClose(directoryHandle);
-    }
-
-    TreeView_SortChildren(TreeViewHandle, RootTreeItem, TRUE);
-
-    return STATUS_SUCCESS;
-}
-
 NTSTATUS EnumCurrentDirectoryObjects(
-    _In_ POBJ_CONTEXT Context,
-    _In_ PH_STRINGREF DirectoryPath
+    _In_ POBJ_CONTEXT Context
     )
 {
     HANDLE directoryHandle;
     OBJECT_ATTRIBUTES oa;
     UNICODE_STRING name;
 
-    PhStringRefToUnicodeString(&DirectoryPath, &name);
+    PhStringRefToUnicodeString(&Context->SelectedNode->Path->sr, &name);
 
     InitializeObjectAttributes(
         &oa, 
@@ -411,35 +251,44 @@ NTSTATUS EnumCurrentDirectoryObjects(
             );
 
         NtClose(directoryHandle);
+
+        // Listing the directory also found its subdirectories.
+        Context->SelectedNode->Enumerated = TRUE;
+        UpdateDirectoryTreeItem(Context, Context->SelectedNode);
     }
 
-    ExtendedListView_SortItems(Context->ListViewHandle);
+    SortObjectEntries(Context);
+    ListView_SetItemCountEx(Context->ListViewHandle, Context->ObjectCount, 0);
 
     return STATUS_SUCCESS;
 }
 
-INT NTAPI WinObjNameCompareFunction(
-    _In_ PVOID Item1,
-    _In_ PVOID Item2,
-    _In_opt_ PVOID Context
+static VOID UpdateObjectSearch(
+    _In_ POBJ_CONTEXT Context
     )
 {
-    POBJECT_ENTRY item1 = Item1;
-    POBJECT_ENTRY item2 = Item2;
+    PPH_STRING text;
 
-    return PhCompareStringZ(PhGetStringOrEmpty(item1->Name), PhGetStringOrEmpty(item2->Name), TRUE);
-}
+    text = PhGetWindowText(Context->SearchHandle);
 
-INT NTAPI WinObjTypeCompareFunction(
-    _In_ PVOID Item1,
-    _In_ PVOID Item2,
-    _In_opt_ PVOID Context
-    )
-{
-    POBJECT_ENTRY item1 = Item1;
-    POBJECT_ENTRY item2 = Item2;
+    if (text->Length != 0 && Context->Indexer)
+    {
+        // The list is replaced when WM_OBJMGR_SEARCH_COMPLETE arrives.
+        Context->SearchActive = TRUE;
+        QueueObjectSearch(Context, &text->sr);
+    }
+    else if (Context->SearchActive)
+    {
+        Context->SearchActive = FALSE;
+        Context->SearchGeneration++; // abandon searches that are still running
+        ListView_SetItemCountEx(Context->ListViewHandle, 0, 0);
+        ClearObjectEntries(Context);
 
-    return PhCompareStringZ(PhGetStringOrEmpty(item1->TypeName), PhGetStringOrEmpty(item2->TypeName), TRUE);
+        if (Context->SelectedNode)
+            EnumCurrentDirectoryObjects(Context);
+    }
+
+    PhDereferenceObject(text);
 }
 
 INT_PTR CALLBACK WinObjDlgProc(
@@ -455,6 +304,7 @@ INT_PTR CALLBACK WinObjDlgProc(
     {
         context = PhAllocate(sizeof(OBJ_CONTEXT));
         memset(context, 0, sizeof(OBJ_CONTEXT));
+        context->CancelContext = CreateCancelContext(hwndDlg);
 
         PhSetWindowContext(hwndDlg, PH_WINDOW_CONTEXT_DEFAULT, context);
     }
@@ -464,6 +314,41 @@ INT_PTR CALLBACK WinObjDlgProc(
 
         if (uMsg == WM_DESTROY)
         {
+            MSG message;
+
+            KillTimer(hwndDlg, OBJMGR_REFRESH_TIMER_ID);
+            KillTimer(hwndDlg, OBJMGR_SEARCH_TIMER_ID);
+
+            // Work that is still running frees its own results from now on; whatever
+            // was posted before this is drained below.
+            SignalCancelContext(context->CancelContext);
+
+            if (context->Indexer)
+                DestroyObjectIndexer(context->Indexer);
+
+            while (PeekMessage(&message, hwndDlg, WM_OBJMGR_SEARCH_COMPLETE, WM_OBJMGR_SEARCH_COMPLETE, PM_REMOVE))
+                DestroyObjectSearchRequest((POBJECT_SEARCH_REQUEST)message.lParam);
+
+            while (PeekMessage(&message, hwndDlg, WM_OBJMGR_REFRESH_COMPLETE, WM_OBJMGR_REFRESH_COMPLETE, PM_REMOVE))
+                DestroyDirectoryRefresh((PDIRECTORY_REFRESH)message.lParam);
+
+            while (PeekMessage(&message, hwndDlg, WM_OBJMGR_DETAILS_COMPLETE, WM_OBJMGR_DETAILS_COMPLETE, PM_REMOVE))
+                DestroyObjectDetailsRequest((POBJECT_DETAILS_REQUEST)message.lParam);
+
+            DereferenceCancelContext(context->CancelContext);
+
+            if (context->PendingDetails)
+            {
+                ClearObjectEntries(context);
+                PhDereferenceObject(context->PendingDetails);
+            }
+
+            if (context->ObjectEntries)
+                PhFree(context->ObjectEntries);
+
+            if (context->RootNode)
+                DestroyDirectoryNode(context->RootNode);
+
             if (context->TreeImageList)
                 ImageList_Destroy(context->TreeImageList);
 
@@ -490,6 +375,7 @@ INT_PTR CALLBACK WinObjDlgProc(
 
             context->TreeViewHandle = GetDlgItem(hwndDlg, IDC_TREE1);
             context->ListViewHandle = GetDlgItem(hwndDlg, IDC_FIREWALL_LIST);
+            context->SearchHandle = GetDlgItem(hwndDlg, IDC_SEARCH);
              
             PhRegisterDialog(hwndDlg);
             InitializeTreeImages(context);
@@ -498,31 +384,37 @@ INT_PTR CALLBACK WinObjDlgProc(
             PhSetControlTheme(context->TreeViewHandle, L"explorer");
             TreeView_SetExtendedStyle(context->TreeViewHandle, TVS_EX_DOUBLEBUFFER, TVS_EX_DOUBLEBUFFER);
             TreeView_SetImageList(context->TreeViewHandle, context->TreeImageList, TVSIL_NORMAL);
-            context->RootTreeObject = TreeViewAddItem(context->TreeViewHandle, TVI_ROOT, TRUE, &RootDirectoryObject);
 
             PhSetControlTheme(context->ListViewHandle, L"explorer");
             PhSetListViewStyle(context->ListViewHandle, FALSE, FALSE);
-            PhSetExtendedListView(context->ListViewHandle);
             ListView_SetImageList(context->ListViewHandle, context->ListImageList, LVSIL_SMALL);
             
             PhAddListViewColumn(context->ListViewHandle, 0, 0, 0, LVCFMT_LEFT, 620, L"Name");
             PhAddListViewColumn(context->ListViewHandle, 1, 1, 1, LVCFMT_LEFT, 150, L"Type");
+            PhAddListViewColumn(context->ListViewHandle, 2, 2, 2, LVCFMT_LEFT, 250, L"Details");
+
+            context->SortColumn = 0;
+            context->SortOrder = AscendingSortOrder;
+            context->PendingDetails = PhCreateList(64);
+            PhSetHeaderSortIcon(ListView_GetHeader(context->ListViewHandle), context->SortColumn, context->SortOrder);
 
-            ExtendedListView_SetSortFast(context->ListViewHandle, TRUE);
-            ExtendedListView_SetCompareFunction(context->ListViewHandle, 0, WinObjNameCompareFunction);
-            ExtendedListView_SetCompareFunction(context->ListViewHandle, 1, WinObjTypeCompareFunction);
+            Edit_SetCueBannerText(context->SearchHandle, L"Search all objects (Type: text)");
 
             PhInitializeLayoutManager(&context->LayoutManager, hwndDlg);
             PhAddLayoutItem(&context->LayoutManager, context->TreeViewHandle, NULL, PH_ANCHOR_LEFT | PH_ANCHOR_TOP | PH_ANCHOR_BOTTOM);
+            PhAddLayoutItem(&context->LayoutManager, context->SearchHandle, NULL, PH_ANCHOR_LEFT | PH_ANCHOR_TOP | PH_ANCHOR_RIGHT);
             PhAddLayoutItem(&context->LayoutManager, context->ListViewHandle, NULL, PH_ANCHOR_ALL);
             PhLoadWindowPlacementFromSetting(SETTING_NAME_WINDOW_POSITION, SETTING_NAME_WINDOW_SIZE, hwndDlg);
             PhLoadListViewColumnsFromSetting(SETTING_NAME_COLUMNS, context->ListViewHandle);       
             
-            EnumDirectoryObjects(
-                context->TreeViewHandle, 
-                context->RootTreeObject, 
-                RootDirectoryObject
-                );
+            // Only the root is enumerated here; other directories are enumerated when
+            // they are first expanded or selected.
+            context->RootNode = AddDirectoryTreeItem(context, NULL, &RootDirectoryObject);
+            EnumerateDirectoryNode(context, context->RootNode);
+            SetTimer(hwndDlg, OBJMGR_REFRESH_TIMER_ID, OBJMGR_REFRESH_INTERVAL, NULL);
+
+            // The whole namespace is indexed in the background for searching.
+            context->Indexer = CreateObjectIndexer(hwndDlg);
 
             SendMessage(hwndDlg, WM_NEXTDLGCTL, (WPARAM)context->TreeViewHandle, TRUE);
         }
@@ -530,6 +422,69 @@ INT_PTR CALLBACK WinObjDlgProc(
     case WM_SIZE:
         PhLayoutManagerLayout(&context->LayoutManager);
         break;
+    case WM_TIMER:
+        {
+            // Directories that have been enumerated are checked again in the background
+            // and only the differences are applied to the tree.
+            if (wParam == OBJMGR_REFRESH_TIMER_ID && !context->RefreshPending)
+            {
+                context->RefreshPending = TRUE;
+                PhQueueItemWorkQueue(PhGetGlobalWorkQueue(), DirectoryRefreshWorker, CreateDirectoryRefresh(context->RootNode, context->CancelContext));
+            }
+            else if (wParam == OBJMGR_SEARCH_TIMER_ID)
+            {
+                KillTimer(hwndDlg, OBJMGR_SEARCH_TIMER_ID);
+                UpdateObjectSearch(context);
+            }
+        }
+        break;
+    case WM_OBJMGR_INDEX_UPDATED:
+        {
+            if (context->SearchActive)
+                UpdateObjectSearch(context);
+        }
+        break;
+    case WM_OBJMGR_SEARCH_COMPLETE:
+        {
+            POBJECT_SEARCH_REQUEST request = (POBJECT_SEARCH_REQUEST)lParam;
+
+            // Only the latest search is shown.
+            if (context->SearchActive && request->Generation == context->SearchGeneration)
+            {
+                ListView_SetItemCountEx(context->ListViewHandle, 0, 0);
+                ApplyObjectSearch(context, request);
+                ListView_SetItemCountEx(context->ListViewHandle, context->ObjectCount, 0);
+            }
+
+            DestroyObjectSearchRequest(request);
+        }
+        break;
+    case WM_OBJMGR_FLUSH_DETAILS:
+        {
+            context->DetailsFlushPosted = FALSE;
+            FlushObjectDetails(context);
+        }
+        break;
+    case WM_OBJMGR_DETAILS_COMPLETE:
+        {
+            POBJECT_DETAILS_REQUEST request = (POBJECT_DETAILS_REQUEST)lParam;
+
+            ApplyObjectDetails(context, request);
+            DestroyObjectDetailsRequest(request);
+            InvalidateRect(context->ListViewHandle, NULL, FALSE);
+        }
+        break;
+    case WM_OBJMGR_REFRESH_COMPLETE:
+        {
+            PDIRECTORY_REFRESH refresh = (PDIRECTORY_REFRESH)lParam;
+
+            if (refresh->Diffs->Count != 0)
+                ApplyDirectoryRefresh(context, refresh);
+
+            DestroyDirectoryRefresh(refresh);
+            context->RefreshPending = FALSE;
+        }
+        break;
     case WM_COMMAND:
         {
             switch (LOWORD(wParam))
@@ -537,6 +492,13 @@ INT_PTR CALLBACK WinObjDlgProc(
             case IDCANCEL:
                 EndDialog(hwndDlg, IDOK);
                 break;
+            case IDC_SEARCH:
+                {
+                    // Wait until typing pauses.
+                    if (HIWORD(wParam) == EN_CHANGE)
+                        SetTimer(hwndDlg, OBJMGR_SEARCH_TIMER_ID, OBJMGR_SEARCH_DELAY, NULL);
+                }
+                break;
             }
         }
         break;
@@ -548,28 +510,107 @@ INT_PTR CALLBACK WinObjDlgProc(
             {
             case TVN_SELCHANGED:
                 {
-                    context->SelectedTreeItem = TreeView_GetSelection(context->TreeViewHandle);
+                    LPNMTREEVIEW treeView = (LPNMTREEVIEW)lParam;
 
-                    ExtendedListView_SetRedraw(context->ListViewHandle, FALSE);
-                    ListView_DeleteAllItems(context->ListViewHandle);
+                    if (!(context->SelectedNode = (PDIRECTORY_NODE)treeView->itemNew.lParam))
+                        break;
 
-                    if (context->SelectedTreeItem == context->RootTreeObject)
+                    if (context->SearchActive)
                     {
-                        EnumCurrentDirectoryObjects(context, RootDirectoryObject);
+                        context->SearchActive = FALSE;
+                        SetWindowText(context->SearchHandle, L"");
                     }
-                    else
+
+                    ListView_SetItemCountEx(context->ListViewHandle, 0, 0);
+                    ClearObjectEntries(context);
+                    EnumCurrentDirectoryObjects(context);
+                }
+                break;
+            case TVN_ITEMEXPANDING:
+                {
+                    LPNMTREEVIEW treeView = (LPNMTREEVIEW)lParam;
+
+                    if (treeView->action & TVE_EXPAND)
+                        EnumerateDirectoryNode(context, (PDIRECTORY_NODE)treeView->itemNew.lParam);
+                }
+                break;
+            case LVN_GETDISPINFO:
+                {
+                    NMLVDISPINFO* dispInfo = (NMLVDISPINFO*)header;
+                    POBJECT_ENTRY entry;
+                    POBJECT_TYPE_INFO typeInfo;
+                    ULONG index;
+
+                    if ((ULONG)dispInfo->item.iItem >= context->ObjectCount)
+                        break;
+
+                    index = context->ObjectOrder[dispInfo->item.iItem];
+                    entry = &context->ObjectEntries[index];
+                    typeInfo = GetObjectTypeInfo(entry->TypeIndex);
+
+                    if (dispInfo->item.mask & LVIF_IMAGE)
+                    {
+                        dispInfo->item.iImage = typeInfo->ImageIndex;
+                    }
+
+                    if (dispInfo->item.mask & LVIF_TEXT)
                     {
-                        PPH_STRING selectedPath = GetSelectedTreeViewPath(context);
+                        PPH_STRING text = NULL;
 
-                        EnumCurrentDirectoryObjects(
-                            context, 
-                            PhGetStringRef(selectedPath)
+                        switch (dispInfo->item.iSubItem)
+                        {
+                        case 0:
+                            text = entry->Name;
+                            break;
+                        case 1:
+                            text = typeInfo->Name;
+                            break;
+                        case 2:
+                            {
+                                // Only rows that are drawn are queried; requests are batched
+                                // until the list has finished painting.
+                                if (!entry->DetailsQueued)
+                                {
+                                    QueueObjectDetails(context, index);
+
+                                    if (!context->DetailsFlushPosted && context->PendingDetails->Count != 0)
+                                    {
+                                        context->DetailsFlushPosted = TRUE;
+                                        PostMessage(hwndDlg, WM_OBJMGR_FLUSH_DETAILS, 0, 0);
+                                    }
+                                }
+
+                                text = entry->Details;
+                            }
+                            break;
+                        }
+
+                        wcsncpy_s(
+                            dispInfo->item.pszText,
+                            dispInfo->item.cchTextMax,
+                            PhGetStringOrEmpty(text),
+                            _TRUNCATE
                             );
+                    }
+                }
+                break;
+            case LVN_COLUMNCLICK:
+                {
+                    LPNMLISTVIEW listView = (LPNMLISTVIEW)header;
 
-                        PhDereferenceObject(selectedPath);
+                    if ((ULONG)listView->iSubItem == context->SortColumn)
+                    {
+                        context->SortOrder = context->SortOrder == AscendingSortOrder ? DescendingSortOrder : AscendingSortOrder;
+                    }
+                    else
+                    {
+                        context->SortColumn = listView->iSubItem;
+                        context->SortOrder = AscendingSortOrder;
                     }
 
-                    ExtendedListView_SetRedraw(context->ListViewHandle, TRUE);
+                    PhSetHeaderSortIcon(ListView_GetHeader(context->ListViewHandle), context->SortColumn, context->SortOrder);
+                    SortObjectEntries(context);
+                    InvalidateRect(context->ListViewHandle, NULL, FALSE);
                 }
                 break;
             case NM_SETCURSOR:
@@ -5,6 +5,8 @@
 #include <settings.h>
 #include <workqueue.h>
 #include "resource.h"
+#include "objindex.h"
+#include "../common/cancel.h"
 
 #define WINOBJ_MENU_ITEM 1000
 #define PLUGIN_NAME L"dmex.ObjectManagerPlugin"
@@ -12,40 +14,262 @@
 #define SETTING_NAME_WINDOW_SIZE (PLUGIN_NAME L".WindowSize")
 #define SETTING_NAME_COLUMNS (PLUGIN_NAME L".WindowColumns")
 
+#define OBJMGR_REFRESH_TIMER_ID 1
+#define OBJMGR_REFRESH_INTERVAL 5000 // ms
+#define WM_OBJMGR_REFRESH_COMPLETE (WM_APP + 1)
+#define WM_OBJMGR_DETAILS_COMPLETE (WM_APP + 2)
+#define WM_OBJMGR_FLUSH_DETAILS (WM_APP + 3)
+#define WM_OBJMGR_INDEX_UPDATED (WM_APP + 4)
+#define WM_OBJMGR_SEARCH_COMPLETE (WM_APP + 5)
+
+#define OBJMGR_SEARCH_TIMER_ID 2
+#define OBJMGR_SEARCH_DELAY 250 // ms
+#define OBJMGR_INDEX_INTERVAL (60 * 1000) // ms
+#define OBJMGR_INDEX_MAX_THREADS 4
+
 extern PPH_PLUGIN PluginInstance;
 
+#define OBJECT_DETAILS_NONE 0
+#define OBJECT_DETAILS_SYMBOLICLINK 1
+#define OBJECT_DETAILS_SECTION 2
+#define OBJECT_DETAILS_EVENT 3
+
+typedef struct _OBJECT_TYPE_INFO
+{
+    PPH_STRING Name;
+    INT ImageIndex;
+    UCHAR DetailsKind;
+} OBJECT_TYPE_INFO, *POBJECT_TYPE_INFO;
+
+// An object in the selected directory. Entries are stored in one array per directory
+// and the list view is owner-data, so no per-row list view state is kept.
 typedef struct _OBJECT_ENTRY
 {
     PPH_STRING Name;
-    PPH_STRING TypeName;
+    PPH_STRING Details; // resolved in the background when the row is first drawn
+    USHORT TypeIndex; // see InternObjectType
+    BOOLEAN DetailsQueued;
 } OBJECT_ENTRY, *POBJECT_ENTRY;
 
+// A directory in the object namespace. Directories are enumerated the first time
+// their tree item is expanded or selected.
+typedef struct _DIRECTORY_NODE
+{
+    struct _DIRECTORY_NODE *Parent;
+    PPH_STRING Path;
+    PH_STRINGREF Name; // tail of Path
+    HTREEITEM TreeItem;
+    PPH_HASHTABLE Children; // PDIRECTORY_NODE, keyed by Name
+    BOOLEAN Enumerated;
+} DIRECTORY_NODE, *PDIRECTORY_NODE;
+
+// Background index of every object path in the namespace. See search.c.
+typedef struct _OBJECT_INDEXER
+{
+    volatile LONG RefCount;
+    volatile BOOLEAN Cancelled;
+    HANDLE WakeEventHandle;
+    ULONG Generation;
+
+    PH_QUEUED_LOCK Lock; // protects Index and WindowHandle
+    OBJECT_INDEX Index;
+    HWND WindowHandle;
+} OBJECT_INDEXER, *POBJECT_INDEXER;
+
 typedef struct _OBJ_CONTEXT
 {
     HWND ListViewHandle;
     HWND TreeViewHandle;
+    HWND SearchHandle;
     PH_LAYOUT_MANAGER LayoutManager;
 
-    HTREEITEM RootTreeObject;
-    HTREEITEM SelectedTreeItem;
+    PDIRECTORY_NODE RootNode;
+    PDIRECTORY_NODE SelectedNode;
+    BOOLEAN RefreshPending;
+
+    POBJECT_ENTRY ObjectEntries;
+    ULONG ObjectCount;
+    ULONG ObjectCapacity;
+    PULONG ObjectOrder; // entry index for each row
+    ULONG ObjectGeneration; // changes whenever the entries are replaced
+    ULONG SortColumn;
+    PH_SORT_ORDER SortOrder;
+    PPH_LIST PendingDetails; // entry indices
+    BOOLEAN DetailsFlushPosted;
+
+    PCANCEL_CONTEXT CancelContext; // shared with refreshes, details and searches
+    POBJECT_INDEXER Indexer;
+    BOOLEAN SearchActive; // the list shows search results instead of SelectedNode
+    ULONG SearchGeneration; // changes whenever a search is started or abandoned
 
     HIMAGELIST TreeImageList;
     HIMAGELIST ListImageList;
 } OBJ_CONTEXT, *POBJ_CONTEXT;
 
-typedef struct _DIRECTORY_ENUM_CONTEXT
+// namespace.c
+
+typedef struct _DIRECTORY_SNAPSHOT
 {
-    HWND TreeViewHandle;
-    HTREEITEM RootTreeItem;
-    PH_STRINGREF DirectoryPath;
-} DIRECTORY_ENUM_CONTEXT, *PDIRECTORY_ENUM_CONTEXT;
+    PPH_STRING Path;
+    PPH_LIST ChildPaths;
+} DIRECTORY_SNAPSHOT, *PDIRECTORY_SNAPSHOT;
+
+typedef struct _DIRECTORY_DIFF
+{
+    PPH_STRING Path;
+    PPH_LIST Added; // names
+    PPH_LIST Removed; // names
+} DIRECTORY_DIFF, *PDIRECTORY_DIFF;
+
+typedef struct _DIRECTORY_REFRESH
+{
+    PCANCEL_CONTEXT CancelContext;
+    PPH_LIST Snapshots; // PDIRECTORY_SNAPSHOT
+    PPH_LIST Diffs; // PDIRECTORY_DIFF
+} DIRECTORY_REFRESH, *PDIRECTORY_REFRESH;
 
-NTSTATUS EnumDirectoryObjects(
-    _In_ HWND TreeViewHandle,
-    _In_ HTREEITEM RootTreeItem,
-    _In_ PH_STRINGREF DirectoryPath
+PDIRECTORY_NODE CreateDirectoryNode(
+    _In_opt_ PDIRECTORY_NODE Parent,
+    _In_ PPH_STRINGREF Name
     );
 
+VOID DestroyDirectoryNode(
+    _In_ PDIRECTORY_NODE Node
+    );
+
+PDIRECTORY_NODE FindChildDirectoryNode(
+    _In_ PDIRECTORY_NODE Node,
+    _In_ PPH_STRINGREF Name
+    );
+
+PDIRECTORY_NODE FindDirectoryNodeByPath(
+    _In_ PDIRECTORY_NODE RootNode,
+    _In_ PPH_STRINGREF Path
+    );
+
+NTSTATUS QueryDirectoryNames(
+    _In_ PPH_STRINGREF Path,
+    _Out_ PPH_LIST *Names
+    );
+
+VOID FreeDirectoryNames(
+    _In_ PPH_LIST Names
+    );
+
+PDIRECTORY_REFRESH CreateDirectoryRefresh(
+    _In_ PDIRECTORY_NODE RootNode,
+    _In_ PCANCEL_CONTEXT CancelContext
+    );
+
+VOID DestroyDirectoryRefresh(
+    _In_ PDIRECTORY_REFRESH Refresh
+    );
+
+NTSTATUS NTAPI DirectoryRefreshWorker(
+    _In_ PVOID Parameter
+    );
+
+// objects.c
+
+typedef struct _OBJECT_DETAILS_ITEM
+{
+    ULONG Index;
+    UCHAR Kind;
+    PPH_STRING Name;
+    PPH_STRING Details;
+} OBJECT_DETAILS_ITEM, *POBJECT_DETAILS_ITEM;
+
+typedef struct _OBJECT_DETAILS_REQUEST
+{
+    PCANCEL_CONTEXT CancelContext;
+    ULONG Generation;
+    PPH_STRING DirectoryPath;
+    ULONG Count;
+    OBJECT_DETAILS_ITEM Items[ANYSIZE_ARRAY];
+} OBJECT_DETAILS_REQUEST, *POBJECT_DETAILS_REQUEST;
+
+USHORT InternObjectType(
+    _In_ PPH_STRINGREF TypeName
+    );
+
+POBJECT_TYPE_INFO GetObjectTypeInfo(
+    _In_ USHORT TypeIndex
+    );
+
+VOID AddObjectEntry(
+    _Inout_ POBJ_CONTEXT Context,
+    _In_ PPH_STRINGREF Name,
+    _In_ PPH_STRINGREF TypeName
+    );
+
+VOID ClearObjectEntries(
+    _Inout_ POBJ_CONTEXT Context
+    );
+
+VOID SortObjectEntries(
+    _Inout_ POBJ_CONTEXT Context
+    );
+
+VOID QueueObjectDetails(
+    _Inout_ POBJ_CONTEXT Context,
+    _In_ ULONG Index
+    );
+
+VOID FlushObjectDetails(
+    _Inout_ POBJ_CONTEXT Context
+    );
+
+VOID ApplyObjectDetails(
+    _Inout_ POBJ_CONTEXT Context,
+    _In_ POBJECT_DETAILS_REQUEST Request
+    );
+
+VOID DestroyObjectDetailsRequest(
+    _In_ POBJECT_DETAILS_REQUEST Request
+    );
+
+NTSTATUS NTAPI ObjectDetailsWorker(
+    _In_ PVOID Parameter
+    );
+
+// search.c
+
+// One search of the index, run on the global work queue and posted to the dialog
+// with WM_OBJMGR_SEARCH_COMPLETE.
+typedef struct _OBJECT_SEARCH_REQUEST
+{
+    POBJECT_INDEXER Indexer; // referenced until the search has run
+    PCANCEL_CONTEXT CancelContext;
+    ULONG Generation; // SearchGeneration when the search was started
+    PPH_STRING Text;
+    PPH_LIST Paths; // results
+    PPH_LIST TypeNames;
+} OBJECT_SEARCH_REQUEST, *POBJECT_SEARCH_REQUEST;
+
+POBJECT_INDEXER CreateObjectIndexer(
+    _In_ HWND WindowHandle
+    );
+
+VOID DestroyObjectIndexer(
+    _In_ POBJECT_INDEXER Indexer
+    );
+
+VOID QueueObjectSearch(
+    _Inout_ POBJ_CONTEXT Context,
+    _In_ PPH_STRINGREF Text
+    );
+
+VOID ApplyObjectSearch(
+    _Inout_ POBJ_CONTEXT Context,
+    _In_ POBJECT_SEARCH_REQUEST Request
+    );
+
+VOID DestroyObjectSearchRequest(
+    _In_ POBJECT_SEARCH_REQUEST Request
+    );
+
+// dialog.c
+
 INT_PTR CALLBACK WinObjDlgProc(
     _In_ HWND hwndDlg,
     _In_ UINT uMsg,
@@ -0,0 +1,431 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Object Manager Plugin
+ *
+ * Copyright (C) 2016 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "main.h"
+
+static PH_STRINGREF DirectoryTypeName = PH_STRINGREF_INIT(L"Directory");
+
+static BOOLEAN DirectoryNodeEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    PDIRECTORY_NODE node1 = *(PDIRECTORY_NODE *)Entry1;
+    PDIRECTORY_NODE node2 = *(PDIRECTORY_NODE *)Entry2;
+
+    return PhEqualStringRef(&node1->Name, &node2->Name, TRUE);
+}
+
+static ULONG DirectoryNodeHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    return PhHashStringRef(&(*(PDIRECTORY_NODE *)Entry)->Name, TRUE);
+}
+
+static BOOLEAN DirectoryNameEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    return PhEqualStringRef((PPH_STRINGREF)Entry1, (PPH_STRINGREF)Entry2, TRUE);
+}
+
+static ULONG DirectoryNameHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    return PhHashStringRef((PPH_STRINGREF)Entry, TRUE);
+}
+
+static VOID GetDirectoryNameFromPath(
+    _In_ PPH_STRING Path,
+    _Out_ PPH_STRINGREF Name
+    )
+{
+    PH_STRINGREF parentPath;
+
+    // The name is the tail of the path, so it stays null terminated.
+    if (!PhSplitStringRefAtLastChar(&Path->sr, OBJ_NAME_PATH_SEPARATOR, &parentPath, Name) || Name->Length == 0)
+        *Name = Path->sr;
+}
+
+PDIRECTORY_NODE CreateDirectoryNode(
+    _In_opt_ PDIRECTORY_NODE Parent,
+    _In_ PPH_STRINGREF Name
+    )
+{
+    static PH_STRINGREF separator = PH_STRINGREF_INIT(L"\\");
+    PDIRECTORY_NODE node;
+
+    node = PhAllocate(sizeof(DIRECTORY_NODE));
+    memset(node, 0, sizeof(DIRECTORY_NODE));
+
+    node->Parent = Parent;
+
+    if (!Parent)
+        node->Path = PhCreateString2(Name);
+    else if (Parent->Parent)
+        node->Path = PhConcatStringRef3(&Parent->Path->sr, &separator, Name);
+    else
+        node->Path = PhConcatStringRef2(&Parent->Path->sr, Name);
+
+    GetDirectoryNameFromPath(node->Path, &node->Name);
+
+    if (Parent)
+    {
+        if (!Parent->Children)
+        {
+            Parent->Children = PhCreateHashtable(
+                sizeof(PDIRECTORY_NODE),
+                DirectoryNodeEqualFunction,
+                DirectoryNodeHashFunction,
+                8
+                );
+        }
+
+        PhAddEntryHashtable(Parent->Children, &node);
+    }
+
+    return node;
+}
+
+/**
+ * Frees a directory node and all of its children.
+ *
+ * \remarks The caller removes the tree view items.
+ */
+VOID DestroyDirectoryNode(
+    _In_ PDIRECTORY_NODE Node
+    )
+{
+    if (Node->Children)
+    {
+        PH_HASHTABLE_ENUM_CONTEXT enumContext;
+        PDIRECTORY_NODE *entry;
+
+        PhBeginEnumHashtable(Node->Children, &enumContext);
+
+        while (entry = PhNextEnumHashtable(&enumContext))
+        {
+            // Don't let the child unlink itself from the table we are walking.
+            (*entry)->Parent = NULL;
+            DestroyDirectoryNode(*entry);
+        }
+
+        PhDereferenceObject(Node->Children);
+    }
+
+    if (Node->Parent)
+        PhRemoveEntryHashtable(Node->Parent->Children, &Node);
+
+    PhDereferenceObject(Node->Path);
+    PhFree(Node);
+}
+
+PDIRECTORY_NODE FindChildDirectoryNode(
+    _In_ PDIRECTORY_NODE Node,
+    _In_ PPH_STRINGREF Name
+    )
+{
+    DIRECTORY_NODE lookupNode;
+    PDIRECTORY_NODE lookupNodePtr = &lookupNode;
+    PDIRECTORY_NODE *entry;
+
+    if (!Node->Children)
+        return NULL;
+
+    lookupNode.Name = *Name;
+    entry = PhFindEntryHashtable(Node->Children, &lookupNodePtr);
+
+    if (entry)
+        return *entry;
+    else
+        return NULL;
+}
+
+PDIRECTORY_NODE FindDirectoryNodeByPath(
+    _In_ PDIRECTORY_NODE RootNode,
+    _In_ PPH_STRINGREF Path
+    )
+{
+    PDIRECTORY_NODE node = RootNode;
+    PH_STRINGREF remainingPart;
+    PH_STRINGREF part;
+
+    remainingPart = *Path;
+
+    while (node && remainingPart.Length != 0)
+    {
+        PhSplitStringRefAtChar(&remainingPart, OBJ_NAME_PATH_SEPARATOR, &part, &remainingPart);
+
+        if (part.Length != 0)
+            node = FindChildDirectoryNode(node, &part);
+    }
+
+    return node;
+}
+
+static BOOLEAN NTAPI QueryDirectoryNamesCallback(
+    _In_ PPH_STRINGREF Name,
+    _In_ PPH_STRINGREF TypeName,
+    _In_opt_ PVOID Context
+    )
+{
+    if (PhEqualStringRef(TypeName, &DirectoryTypeName, TRUE))
+        PhAddItemList((PPH_LIST)Context, PhCreateString2(Name));
+
+    return TRUE;
+}
+
+/**
+ * Enumerates the names of the directories directly below a directory.
+ *
+ * \param Path The full path of the directory.
+ * \param Names A variable which receives a list of strings. Free the list with
+ * FreeDirectoryNames.
+ */
+NTSTATUS QueryDirectoryNames(
+    _In_ PPH_STRINGREF Path,
+    _Out_ PPH_LIST *Names
+    )
+{
+    NTSTATUS status;
+    HANDLE directoryHandle;
+    OBJECT_ATTRIBUTES oa;
+    UNICODE_STRING name;
+    PPH_LIST names;
+
+    if (!PhStringRefToUnicodeString(Path, &name))
+        return STATUS_NAME_TOO_LONG;
+
+    InitializeObjectAttributes(
+        &oa,
+        &name,
+        0,
+        NULL,
+        NULL
+        );
+
+    status = NtOpenDirectoryObject(
+        &directoryHandle,
+        DIRECTORY_QUERY,
+        &oa
+        );
+
+    if (!NT_SUCCESS(status))
+        return status;
+
+    names = PhCreateList(16);
+    status = PhEnumDirectoryObjects(directoryHandle, QueryDirectoryNamesCallback, names);
+    NtClose(directoryHandle);
+
+    if (!NT_SUCCESS(status))
+    {
+        FreeDirectoryNames(names);
+        return status;
+    }
+
+    *Names = names;
+
+    return status;
+}
+
+VOID FreeDirectoryNames(
+    _In_ PPH_LIST Names
+    )
+{
+    for (ULONG i = 0; i < Names->Count; i++)
+        PhDereferenceObject(Names->Items[i]);
+
+    PhDereferenceObject(Names);
+}
+
+static VOID SnapshotDirectoryNode(
+    _In_ PDIRECTORY_REFRESH Refresh,
+    _In_ PDIRECTORY_NODE Node
+    )
+{
+    PDIRECTORY_SNAPSHOT snapshot;
+    PH_HASHTABLE_ENUM_CONTEXT enumContext;
+    PDIRECTORY_NODE *entry;
+
+    if (!Node->Enumerated)
+        return;
+
+    snapshot = PhAllocate(sizeof(DIRECTORY_SNAPSHOT));
+    snapshot->Path = PhReferenceObject(Node->Path);
+    snapshot->ChildPaths = PhCreateList(Node->Children ? Node->Children->Count : 1);
+    PhAddItemList(Refresh->Snapshots, snapshot);
+
+    if (!Node->Children)
+        return;
+
+    PhBeginEnumHashtable(Node->Children, &enumContext);
+
+    while (entry = PhNextEnumHashtable(&enumContext))
+    {
+        PhAddItemList(snapshot->ChildPaths, PhReferenceObject((*entry)->Path));
+        SnapshotDirectoryNode(Refresh, *entry);
+    }
+}
+
+/**
+ * Captures the enumerated part of the namespace for a background refresh.
+ *
+ * \param RootNode The root of the namespace model.
+ * \param CancelContext The context of the window that receives
+ * WM_OBJMGR_REFRESH_COMPLETE.
+ */
+PDIRECTORY_REFRESH CreateDirectoryRefresh(
+    _In_ PDIRECTORY_NODE RootNode,
+    _In_ PCANCEL_CONTEXT CancelContext
+    )
+{
+    PDIRECTORY_REFRESH refresh;
+
+    refresh = PhAllocate(sizeof(DIRECTORY_REFRESH));
+    refresh->CancelContext = ReferenceCancelContext(CancelContext);
+    refresh->Snapshots = PhCreateList(32);
+    refresh->Diffs = PhCreateList(4);
+
+    SnapshotDirectoryNode(refresh, RootNode);
+
+    return refresh;
+}
+
+VOID DestroyDirectoryRefresh(
+    _In_ PDIRECTORY_REFRESH Refresh
+    )
+{
+    for (ULONG i = 0; i < Refresh->Snapshots->Count; i++)
+    {
+        PDIRECTORY_SNAPSHOT snapshot = Refresh->Snapshots->Items[i];
+
+        FreeDirectoryNames(snapshot->ChildPaths);
+        PhDereferenceObject(snapshot->Path);
+        PhFree(snapshot);
+    }
+
+    for (ULONG i = 0; i < Refresh->Diffs->Count; i++)
+    {
+        PDIRECTORY_DIFF diff = Refresh->Diffs->Items[i];
+
+        FreeDirectoryNames(diff->Added);
+        FreeDirectoryNames(diff->Removed);
+        PhDereferenceObject(diff->Path);
+        PhFree(diff);
+    }
+
+    PhDereferenceObject(Refresh->Snapshots);
+    PhDereferenceObject(Refresh->Diffs);
+    DereferenceCancelContext(Refresh->CancelContext);
+    PhFree(Refresh);
+}
+
+static VOID DiffDirectorySnapshot(
+    _In_ PDIRECTORY_REFRESH Refresh,
+    _In_ PDIRECTORY_SNAPSHOT Snapshot
+    )
+{
+    PPH_LIST names;
+    PPH_HASHTABLE oldNames;
+    PPH_HASHTABLE newNames;
+    PDIRECTORY_DIFF diff;
+
+    // A directory that can no longer be opened is reported as removed by its parent.
+    if (!NT_SUCCESS(QueryDirectoryNames(&Snapshot->Path->sr, &names)))
+        return;
+
+    oldNames = PhCreateHashtable(sizeof(PH_STRINGREF), DirectoryNameEqualFunction, DirectoryNameHashFunction, Snapshot->ChildPaths->Count + 1);
+    newNames = PhCreateHashtable(sizeof(PH_STRINGREF), DirectoryNameEqualFunction, DirectoryNameHashFunction, names->Count + 1);
+
+    for (ULONG i = 0; i < Snapshot->ChildPaths->Count; i++)
+    {
+        PH_STRINGREF name;
+
+        GetDirectoryNameFromPath(Snapshot->ChildPaths->Items[i], &name);
+        PhAddEntryHashtable(oldNames, &name);
+    }
+
+    for (ULONG i = 0; i < names->Count; i++)
+        PhAddEntryHashtable(newNames, &((PPH_STRING)names->Items[i])->sr);
+
+    diff = PhAllocate(sizeof(DIRECTORY_DIFF));
+    diff->Path = NULL;
+    diff->Added = PhCreateList(1);
+    diff->Removed = PhCreateList(1);
+
+    for (ULONG i = 0; i < names->Count; i++)
+    {
+        PPH_STRING name = names->Items[i];
+
+        if (!PhFindEntryHashtable(oldNames, &name->sr))
+            PhAddItemList(diff->Added, PhReferenceObject(name));
+    }
+
+    for (ULONG i = 0; i < Snapshot->ChildPaths->Count; i++)
+    {
+        PH_STRINGREF name;
+
+        GetDirectoryNameFromPath(Snapshot->ChildPaths->Items[i], &name);
+
+        if (!PhFindEntryHashtable(newNames, &name))
+            PhAddItemList(diff->Removed, PhCreateString2(&name));
+    }
+
+    PhDereferenceObject(newNames);
+    PhDereferenceObject(oldNames);
+    FreeDirectoryNames(names);
+
+    if (diff->Added->Count != 0 || diff->Removed->Count != 0)
+    {
+        PhSetReference(&diff->Path, Snapshot->Path);
+        PhAddItemList(Refresh->Diffs, diff);
+    }
+    else
+    {
+        FreeDirectoryNames(diff->Added);
+        FreeDirectoryNames(diff->Removed);
+        PhFree(diff);
+    }
+}
+
+/**
+ * Enumerates the directories in a refresh snapshot and posts the changes to the
+ * window as WM_OBJMGR_REFRESH_COMPLETE. The window frees the refresh, unless it has
+ * been destroyed in the meantime.
+ */
+NTSTATUS NTAPI DirectoryRefreshWorker(
+    _In_ PVOID Parameter
+    )
+{
+    PDIRECTORY_REFRESH refresh = Parameter;
+
+    for (ULONG i = 0; i < refresh->Snapshots->Count && !IsCancelContextSignaled(refresh->CancelContext); i++)
+        DiffDirectorySnapshot(refresh, refresh->Snapshots->Items[i]);
+
+    if (!PostCancelContextMessage(refresh->CancelContext, WM_OBJMGR_REFRESH_COMPLETE, 0, (LPARAM)refresh))
+        DestroyDirectoryRefresh(refresh);
+
+    return STATUS_SUCCESS;
+}
@@ -0,0 +1,459 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Object Manager Plugin
+ *
+ * Copyright (C) 2016 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "main.h"
+
+#define SORT_FUNCTION(Column) ObjectEntryCompare##Column
+#define BEGIN_SORT_FUNCTION(Column) static int __cdecl ObjectEntryCompare##Column( \
+    _In_ void *_context, \
+    _In_ const void *_elem1, \
+    _In_ const void *_elem2 \
+    ) \
+{ \
+    POBJ_CONTEXT context = _context; \
+    POBJECT_ENTRY entry1 = &context->ObjectEntries[*(PULONG)_elem1]; \
+    POBJECT_ENTRY entry2 = &context->ObjectEntries[*(PULONG)_elem2]; \
+    int sortResult = 0;
+
+#define END_SORT_FUNCTION \
+    if (sortResult == 0) \
+        sortResult = PhCompareString(entry1->Name, entry2->Name, TRUE); \
+    \
+    return PhModifySort(sortResult, context->SortOrder); \
+}
+
+typedef struct _OBJECT_TYPE_ICON
+{
+    PH_STRINGREF TypeName;
+    INT ImageIndex; // see InitializeListImages
+    UCHAR DetailsKind;
+} OBJECT_TYPE_ICON, *POBJECT_TYPE_ICON;
+
+typedef struct _OBJECT_TYPE_HASH_ENTRY
+{
+    PH_STRINGREF Name;
+    USHORT TypeIndex;
+} OBJECT_TYPE_HASH_ENTRY, *POBJECT_TYPE_HASH_ENTRY;
+
+static OBJECT_TYPE_ICON ObjectTypeIcons[] =
+{
+    { PH_STRINGREF_INIT(L"ALPC Port"), 6, OBJECT_DETAILS_NONE },
+    { PH_STRINGREF_INIT(L"Device"), 2, OBJECT_DETAILS_NONE },
+    { PH_STRINGREF_INIT(L"Driver"), 9, OBJECT_DETAILS_NONE },
+    { PH_STRINGREF_INIT(L"Event"), 8, OBJECT_DETAILS_EVENT },
+    { PH_STRINGREF_INIT(L"Key"), 5, OBJECT_DETAILS_NONE },
+    { PH_STRINGREF_INIT(L"Mutant"), 1, OBJECT_DETAILS_NONE },
+    { PH_STRINGREF_INIT(L"Section"), 3, OBJECT_DETAILS_SECTION },
+    { PH_STRINGREF_INIT(L"Session"), 7, OBJECT_DETAILS_NONE },
+    { PH_STRINGREF_INIT(L"SymbolicLink"), 4, OBJECT_DETAILS_SYMBOLICLINK },
+};
+
+// Object types seen so far. Types are never removed, so an index stays valid for the
+// lifetime of the plugin. UI thread only.
+static PPH_LIST ObjectTypeList = NULL; // POBJECT_TYPE_INFO
+static PPH_HASHTABLE ObjectTypeHashtable = NULL; // OBJECT_TYPE_HASH_ENTRY
+
+static BOOLEAN ObjectTypeEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    return PhEqualStringRef(&((POBJECT_TYPE_HASH_ENTRY)Entry1)->Name, &((POBJECT_TYPE_HASH_ENTRY)Entry2)->Name, TRUE);
+}
+
+static ULONG ObjectTypeHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    return PhHashStringRef(&((POBJECT_TYPE_HASH_ENTRY)Entry)->Name, TRUE);
+}
+
+USHORT InternObjectType(
+    _In_ PPH_STRINGREF TypeName
+    )
+{
+    OBJECT_TYPE_HASH_ENTRY lookupEntry;
+    POBJECT_TYPE_HASH_ENTRY entry;
+    POBJECT_TYPE_INFO typeInfo;
+
+    if (!ObjectTypeHashtable)
+    {
+        ObjectTypeList = PhCreateList(32);
+        ObjectTypeHashtable = PhCreateHashtable(
+            sizeof(OBJECT_TYPE_HASH_ENTRY),
+            ObjectTypeEqualFunction,
+            ObjectTypeHashFunction,
+            32
+            );
+    }
+
+    lookupEntry.Name = *TypeName;
+
+    if (entry = PhFindEntryHashtable(ObjectTypeHashtable, &lookupEntry))
+        return entry->TypeIndex;
+
+    typeInfo = PhAllocate(sizeof(OBJECT_TYPE_INFO));
+    typeInfo->Name = PhCreateString2(TypeName);
+    typeInfo->ImageIndex = 0;
+    typeInfo->DetailsKind = OBJECT_DETAILS_NONE;
+
+    for (ULONG i = 0; i < RTL_NUMBER_OF(ObjectTypeIcons); i++)
+    {
+        if (PhEqualStringRef(&ObjectTypeIcons[i].TypeName, TypeName, TRUE))
+        {
+            typeInfo->ImageIndex = ObjectTypeIcons[i].ImageIndex;
+            typeInfo->DetailsKind = ObjectTypeIcons[i].DetailsKind;
+            break;
+        }
+    }
+
+    lookupEntry.Name = typeInfo->Name->sr;
+    lookupEntry.TypeIndex = (USHORT)ObjectTypeList->Count;
+    PhAddEntryHashtable(ObjectTypeHashtable, &lookupEntry);
+    PhAddItemList(ObjectTypeList, typeInfo);
+
+    return lookupEntry.TypeIndex;
+}
+
+POBJECT_TYPE_INFO GetObjectTypeInfo(
+    _In_ USHORT TypeIndex
+    )
+{
+    return ObjectTypeList->Items[TypeIndex];
+}
+
+VOID AddObjectEntry(
+    _Inout_ POBJ_CONTEXT Context,
+    _In_ PPH_STRINGREF Name,
+    _In_ PPH_STRINGREF TypeName
+    )
+{
+    POBJECT_ENTRY entry;
+
+    if (Context->ObjectCount == Context->ObjectCapacity)
+    {
+        Context->ObjectCapacity = Context->ObjectCapacity ? Context->ObjectCapacity * 2 : 64;
+
+        if (Context->ObjectEntries)
+            Context->ObjectEntries = PhReAllocate(Context->ObjectEntries, Context->ObjectCapacity * sizeof(OBJECT_ENTRY));
+        else
+            Context->ObjectEntries = PhAllocate(Context->ObjectCapacity * sizeof(OBJECT_ENTRY));
+    }
+
+    entry = &Context->ObjectEntries[Context->ObjectCount++];
+    entry->Name = PhCreateString2(Name);
+    entry->Details = NULL;
+    entry->TypeIndex = InternObjectType(TypeName);
+    entry->DetailsQueued = FALSE;
+}
+
+VOID ClearObjectEntries(
+    _Inout_ POBJ_CONTEXT Context
+    )
+{
+    for (ULONG i = 0; i < Context->ObjectCount; i++)
+    {
+        PhDereferenceObject(Context->ObjectEntries[i].Name);
+        PhClearReference(&Context->ObjectEntries[i].Details);
+    }
+
+    Context->ObjectCount = 0;
+
+    if (Context->ObjectOrder)
+    {
+        PhFree(Context->ObjectOrder);
+        Context->ObjectOrder = NULL;
+    }
+
+    // Results of detail requests for the old entries are dropped.
+    Context->ObjectGeneration++;
+    PhClearList(Context->PendingDetails);
+}
+
+BEGIN_SORT_FUNCTION(Name)
+{
+    sortResult = PhCompareString(entry1->Name, entry2->Name, TRUE);
+}
+END_SORT_FUNCTION
+
+BEGIN_SORT_FUNCTION(Type)
+{
+    sortResult = PhCompareString(GetObjectTypeInfo(entry1->TypeIndex)->Name, GetObjectTypeInfo(entry2->TypeIndex)->Name, TRUE);
+}
+END_SORT_FUNCTION
+
+BEGIN_SORT_FUNCTION(Details)
+{
+    sortResult = PhCompareStringWithNull(entry1->Details, entry2->Details, TRUE);
+}
+END_SORT_FUNCTION
+
+/**
+ * Rebuilds the display order of the object list. Entries are not moved, so indices
+ * held by detail requests stay valid.
+ */
+VOID SortObjectEntries(
+    _Inout_ POBJ_CONTEXT Context
+    )
+{
+    static PVOID sortFunctions[] =
+    {
+        SORT_FUNCTION(Name),
+        SORT_FUNCTION(Type),
+        SORT_FUNCTION(Details)
+    };
+    int (__cdecl *sortFunction)(void *, const void *, const void *);
+
+    if (!Context->ObjectOrder && Context->ObjectCount != 0)
+    {
+        Context->ObjectOrder = PhAllocate(Context->ObjectCount * sizeof(ULONG));
+
+        for (ULONG i = 0; i < Context->ObjectCount; i++)
+            Context->ObjectOrder[i] = i;
+    }
+
+    if (Context->ObjectCount == 0 || Context->SortOrder == NoSortOrder)
+        return;
+
+    if (Context->SortColumn < RTL_NUMBER_OF(sortFunctions))
+        sortFunction = sortFunctions[Context->SortColumn];
+    else
+        sortFunction = SORT_FUNCTION(Name);
+
+    qsort_s(Context->ObjectOrder, Context->ObjectCount, sizeof(ULONG), sortFunction, Context);
+}
+
+/**
+ * Marks an entry for a background detail query. Entries are only queued when their
+ * row is drawn; the batch is sent by FlushObjectDetails.
+ */
+VOID QueueObjectDetails(
+    _Inout_ POBJ_CONTEXT Context,
+    _In_ ULONG Index
+    )
+{
+    POBJECT_ENTRY entry = &Context->ObjectEntries[Index];
+
+    if (entry->DetailsQueued)
+        return;
+
+    entry->DetailsQueued = TRUE;
+
+    if (GetObjectTypeInfo(entry->TypeIndex)->DetailsKind == OBJECT_DETAILS_NONE)
+        return;
+
+    PhAddItemList(Context->PendingDetails, UlongToPtr(Index));
+}
+
+VOID FlushObjectDetails(
+    _Inout_ POBJ_CONTEXT Context
+    )
+{
+    POBJECT_DETAILS_REQUEST request;
+    PDIRECTORY_NODE directoryNode;
+    ULONG count = Context->PendingDetails->Count;
+
+    directoryNode = Context->SearchActive ? Context->RootNode : Context->SelectedNode;
+
+    if (count == 0 || !directoryNode)
+        return;
+
+    request = PhAllocate(FIELD_OFFSET(OBJECT_DETAILS_REQUEST, Items[count]));
+    request->CancelContext = ReferenceCancelContext(Context->CancelContext);
+    request->Generation = Context->ObjectGeneration;
+    request->DirectoryPath = PhReferenceObject(directoryNode->Path);
+    request->Count = count;
+
+    for (ULONG i = 0; i < count; i++)
+    {
+        ULONG index = PtrToUlong(Context->PendingDetails->Items[i]);
+        POBJECT_ENTRY entry = &Context->ObjectEntries[index];
+
+        request->Items[i].Index = index;
+        request->Items[i].Kind = GetObjectTypeInfo(entry->TypeIndex)->DetailsKind;
+        request->Items[i].Name = PhReferenceObject(entry->Name);
+        request->Items[i].Details = NULL;
+    }
+
+    PhClearList(Context->PendingDetails);
+    PhQueueItemWorkQueue(PhGetGlobalWorkQueue(), ObjectDetailsWorker, request);
+}
+
+VOID ApplyObjectDetails(
+    _Inout_ POBJ_CONTEXT Context,
+    _In_ POBJECT_DETAILS_REQUEST Request
+    )
+{
+    if (Request->Generation != Context->ObjectGeneration)
+        return;
+
+    for (ULONG i = 0; i < Request->Count; i++)
+    {
+        POBJECT_ENTRY entry = &Context->ObjectEntries[Request->Items[i].Index];
+
+        PhMoveReference(&entry->Details, Request->Items[i].Details);
+        Request->Items[i].Details = NULL;
+    }
+}
+
+VOID DestroyObjectDetailsRequest(
+    _In_ POBJECT_DETAILS_REQUEST Request
+    )
+{
+    for (ULONG i = 0; i < Request->Count; i++)
+    {
+        PhDereferenceObject(Request->Items[i].Name);
+        PhClearReference(&Request->Items[i].Details);
+    }
+
+    PhDereferenceObject(Request->DirectoryPath);
+    DereferenceCancelContext(Request->CancelContext);
+    PhFree(Request);
+}
+
+static PPH_STRING QuerySymbolicLinkDetails(
+    _In_ POBJECT_ATTRIBUTES ObjectAttributes
+    )
+{
+    PPH_STRING details = NULL;
+    HANDLE linkHandle;
+    UNICODE_STRING target;
+    WCHAR buffer[PAGE_SIZE / sizeof(WCHAR)];
+
+    if (!NT_SUCCESS(NtOpenSymbolicLinkObject(&linkHandle, SYMBOLIC_LINK_QUERY, ObjectAttributes)))
+        return NULL;
+
+    RtlInitEmptyUnicodeString(&target, buffer, sizeof(buffer));
+
+    if (NT_SUCCESS(NtQuerySymbolicLinkObject(linkHandle, &target, NULL)))
+        details = PhCreateStringFromUnicodeString(&target);
+
+    NtClose(linkHandle);
+
+    return details;
+}
+
+static PPH_STRING QuerySectionDetails(
+    _In_ POBJECT_ATTRIBUTES ObjectAttributes
+    )
+{
+    PPH_STRING details = NULL;
+    HANDLE sectionHandle;
+    SECTION_BASIC_INFORMATION basicInfo;
+
+    if (!NT_SUCCESS(NtOpenSection(&sectionHandle, SECTION_QUERY, ObjectAttributes)))
+        return NULL;
+
+    if (NT_SUCCESS(NtQuerySection(sectionHandle, SectionBasicInformation, &basicInfo, sizeof(SECTION_BASIC_INFORMATION), NULL)))
+    {
+        details = PhFormatSize(basicInfo.MaximumSize.QuadPart, -1);
+
+        if (basicInfo.AllocationAttributes & SEC_IMAGE)
+            PhMoveReference(&details, PhConcatStrings2(details->Buffer, L" (image)"));
+    }
+
+    NtClose(sectionHandle);
+
+    return details;
+}
+
+static PPH_STRING QueryEventDetails(
+    _In_ POBJECT_ATTRIBUTES ObjectAttributes
+    )
+{
+    PPH_STRING details = NULL;
+    HANDLE eventHandle;
+    EVENT_BASIC_INFORMATION basicInfo;
+
+    if (!NT_SUCCESS(NtOpenEvent(&eventHandle, EVENT_QUERY_STATE, ObjectAttributes)))
+        return NULL;
+
+    if (NT_SUCCESS(NtQueryEvent(eventHandle, EventBasicInformation, &basicInfo, sizeof(EVENT_BASIC_INFORMATION), NULL)))
+    {
+        details = PhFormatString(
+            L"%s, %s",
+            basicInfo.EventType == NotificationEvent ? L"Notification" : L"Synchronization",
+            basicInfo.EventState ? L"signaled" : L"not signaled"
+            );
+    }
+
+    NtClose(eventHandle);
+
+    return details;
+}
+
+NTSTATUS NTAPI ObjectDetailsWorker(
+    _In_ PVOID Parameter
+    )
+{
+    POBJECT_DETAILS_REQUEST request = Parameter;
+    HANDLE directoryHandle;
+    OBJECT_ATTRIBUTES oa;
+    UNICODE_STRING name;
+
+    // Objects are opened relative to their directory.
+    if (PhStringRefToUnicodeString(&request->DirectoryPath->sr, &name))
+    {
+        InitializeObjectAttributes(&oa, &name, 0, NULL, NULL);
+
+        if (NT_SUCCESS(NtOpenDirectoryObject(&directoryHandle, DIRECTORY_TRAVERSE, &oa)))
+        {
+            for (ULONG i = 0; i < request->Count; i++)
+            {
+                POBJECT_DETAILS_ITEM item = &request->Items[i];
+
+                if (!PhStringRefToUnicodeString(&item->Name->sr, &name))
+                    continue;
+
+                // Search results are full paths, and the directory is the root.
+                if (name.Length != 0 && name.Buffer[0] == OBJ_NAME_PATH_SEPARATOR)
+                {
+                    name.Buffer++;
+                    name.Length -= sizeof(WCHAR);
+                    name.MaximumLength -= sizeof(WCHAR);
+                }
+
+                InitializeObjectAttributes(&oa, &name, 0, directoryHandle, NULL);
+
+                switch (item->Kind)
+                {
+                case OBJECT_DETAILS_SYMBOLICLINK:
+                    item->Details = QuerySymbolicLinkDetails(&oa);
+                    break;
+                case OBJECT_DETAILS_SECTION:
+                    item->Details = QuerySectionDetails(&oa);
+                    break;
+                case OBJECT_DETAILS_EVENT:
+                    item->Details = QueryEventDetails(&oa);
+                    break;
+                }
+            }
+
+            NtClose(directoryHandle);
+        }
+    }
+
+    if (!PostCancelContextMessage(request->CancelContext, WM_OBJMGR_DETAILS_COMPLETE, 0, (LPARAM)request))
+        DestroyObjectDetailsRequest(request);
+
+    return STATUS_SUCCESS;
+}
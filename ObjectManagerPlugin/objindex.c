@@ -0,0 +1,456 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Object Manager Plugin
+ *
+ * Copyright (C) 2016 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <phdk.h>
+#include "objindex.h"
+
+typedef struct _OBJECT_INDEX_PATH_ENTRY
+{
+    PH_STRINGREF Path; // points into the entry's string
+    ULONG Id;
+} OBJECT_INDEX_PATH_ENTRY, *POBJECT_INDEX_PATH_ENTRY;
+
+typedef struct _OBJECT_INDEX_POSTING
+{
+    ULONG64 Trigram;
+    PULONG Ids; // ascending
+    ULONG Count;
+    ULONG Capacity;
+} OBJECT_INDEX_POSTING, *POBJECT_INDEX_POSTING;
+
+static BOOLEAN ObjectIndexPathEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    return PhEqualStringRef(&((POBJECT_INDEX_PATH_ENTRY)Entry1)->Path, &((POBJECT_INDEX_PATH_ENTRY)Entry2)->Path, TRUE);
+}
+
+static ULONG ObjectIndexPathHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    return PhHashStringRef(&((POBJECT_INDEX_PATH_ENTRY)Entry)->Path, TRUE);
+}
+
+static BOOLEAN ObjectIndexPostingEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    return ((POBJECT_INDEX_POSTING)Entry1)->Trigram == ((POBJECT_INDEX_POSTING)Entry2)->Trigram;
+}
+
+static ULONG ObjectIndexPostingHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    ULONG64 value = ((POBJECT_INDEX_POSTING)Entry)->Trigram;
+
+    value ^= value >> 29;
+    value *= 0xbf58476d1ce4e5b9;
+    value ^= value >> 32;
+
+    return (ULONG)value;
+}
+
+// Folds case the same way as PhFindStringInStringRef, which verifies the candidates.
+// Any other folding (e.g. towlower) disagrees on some characters and loses matches.
+FORCEINLINE WCHAR ObjectIndexFoldChar(
+    _In_ WCHAR Character
+    )
+{
+    return RtlUpcaseUnicodeChar(Character);
+}
+
+FORCEINLINE ULONG64 ObjectIndexTrigram(
+    _In_ PWCHAR Buffer
+    )
+{
+    return ((ULONG64)ObjectIndexFoldChar(Buffer[0]) << 32) |
+        ((ULONG64)ObjectIndexFoldChar(Buffer[1]) << 16) |
+        ObjectIndexFoldChar(Buffer[2]);
+}
+
+static VOID ObjectIndexCreateTables(
+    _Inout_ POBJECT_INDEX Index
+    )
+{
+    Index->PathHashtable = PhCreateHashtable(
+        sizeof(OBJECT_INDEX_PATH_ENTRY),
+        ObjectIndexPathEqualFunction,
+        ObjectIndexPathHashFunction,
+        1024
+        );
+    Index->TrigramHashtable = PhCreateHashtable(
+        sizeof(OBJECT_INDEX_POSTING),
+        ObjectIndexPostingEqualFunction,
+        ObjectIndexPostingHashFunction,
+        4096
+        );
+}
+
+static VOID ObjectIndexDeleteTables(
+    _Inout_ POBJECT_INDEX Index
+    )
+{
+    PH_HASHTABLE_ENUM_CONTEXT enumContext;
+    POBJECT_INDEX_POSTING posting;
+
+    PhBeginEnumHashtable(Index->TrigramHashtable, &enumContext);
+
+    while (posting = PhNextEnumHashtable(&enumContext))
+        PhFree(posting->Ids);
+
+    PhDereferenceObject(Index->TrigramHashtable);
+    PhDereferenceObject(Index->PathHashtable);
+}
+
+VOID ObjectIndexInitialize(
+    _Out_ POBJECT_INDEX Index
+    )
+{
+    memset(Index, 0, sizeof(OBJECT_INDEX));
+
+    ObjectIndexCreateTables(Index);
+    Index->TypeNames = PhCreateList(32);
+}
+
+VOID ObjectIndexDelete(
+    _Inout_ POBJECT_INDEX Index
+    )
+{
+    for (ULONG i = 0; i < Index->Count; i++)
+        PhDereferenceObject(Index->Entries[i].Path);
+
+    for (ULONG i = 0; i < Index->TypeNames->Count; i++)
+        PhDereferenceObject(Index->TypeNames->Items[i]);
+
+    if (Index->Entries)
+        PhFree(Index->Entries);
+
+    ObjectIndexDeleteTables(Index);
+    PhDereferenceObject(Index->TypeNames);
+}
+
+USHORT ObjectIndexFindType(
+    _In_ POBJECT_INDEX Index,
+    _In_ PPH_STRINGREF TypeName
+    )
+{
+    for (ULONG i = 0; i < Index->TypeNames->Count; i++)
+    {
+        if (PhEqualStringRef(&((PPH_STRING)Index->TypeNames->Items[i])->sr, TypeName, TRUE))
+            return (USHORT)i;
+    }
+
+    return OBJECT_INDEX_ANY_TYPE;
+}
+
+static USHORT ObjectIndexInternType(
+    _Inout_ POBJECT_INDEX Index,
+    _In_ PPH_STRINGREF TypeName
+    )
+{
+    USHORT typeIndex;
+
+    // There are only a few dozen object types.
+    if ((typeIndex = ObjectIndexFindType(Index, TypeName)) != OBJECT_INDEX_ANY_TYPE)
+        return typeIndex;
+
+    PhAddItemList(Index->TypeNames, PhCreateString2(TypeName));
+
+    return (USHORT)(Index->TypeNames->Count - 1);
+}
+
+static VOID ObjectIndexAddTrigrams(
+    _Inout_ POBJECT_INDEX Index,
+    _In_ ULONG Id
+    )
+{
+    PPH_STRING path = Index->Entries[Id].Path;
+    SIZE_T length = path->Length / sizeof(WCHAR);
+
+    for (SIZE_T i = 0; i + 3 <= length; i++)
+    {
+        OBJECT_INDEX_POSTING lookupPosting;
+        POBJECT_INDEX_POSTING posting;
+
+        lookupPosting.Trigram = ObjectIndexTrigram(&path->Buffer[i]);
+
+        if (!(posting = PhFindEntryHashtable(Index->TrigramHashtable, &lookupPosting)))
+        {
+            lookupPosting.Ids = NULL;
+            lookupPosting.Count = 0;
+            lookupPosting.Capacity = 0;
+            posting = PhAddEntryHashtableEx(Index->TrigramHashtable, &lookupPosting, NULL);
+        }
+
+        // Ids only grow, so a repeated trigram in the same path is always the last one.
+        if (posting->Count != 0 && posting->Ids[posting->Count - 1] == Id)
+            continue;
+
+        if (posting->Count == posting->Capacity)
+        {
+            if (posting->Ids)
+            {
+                posting->Capacity *= 2;
+                posting->Ids = PhReAllocate(posting->Ids, posting->Capacity * sizeof(ULONG));
+            }
+            else
+            {
+                posting->Capacity = 4;
+                posting->Ids = PhAllocate(posting->Capacity * sizeof(ULONG));
+            }
+        }
+
+        posting->Ids[posting->Count++] = Id;
+    }
+}
+
+static ULONG ObjectIndexAddEntry(
+    _Inout_ POBJECT_INDEX Index,
+    _In_ PPH_STRING Path,
+    _In_ USHORT TypeIndex,
+    _In_ ULONG Generation
+    )
+{
+    OBJECT_INDEX_PATH_ENTRY pathEntry;
+    POBJECT_INDEX_ENTRY entry;
+    ULONG id;
+
+    if (Index->Count == Index->Capacity)
+    {
+        if (Index->Entries)
+        {
+            Index->Capacity *= 2;
+            Index->Entries = PhReAllocate(Index->Entries, Index->Capacity * sizeof(OBJECT_INDEX_ENTRY));
+        }
+        else
+        {
+            Index->Capacity = 1024;
+            Index->Entries = PhAllocate(Index->Capacity * sizeof(OBJECT_INDEX_ENTRY));
+        }
+    }
+
+    id = Index->Count++;
+    entry = &Index->Entries[id];
+    entry->Path = Path;
+    entry->TypeIndex = TypeIndex;
+    entry->Deleted = FALSE;
+    entry->Generation = Generation;
+
+    pathEntry.Path = Path->sr;
+    pathEntry.Id = id;
+    PhAddEntryHashtable(Index->PathHashtable, &pathEntry);
+
+    ObjectIndexAddTrigrams(Index, id);
+
+    return id;
+}
+
+static VOID ObjectIndexRemoveEntry(
+    _Inout_ POBJECT_INDEX Index,
+    _In_ ULONG Id
+    )
+{
+    OBJECT_INDEX_PATH_ENTRY lookupEntry;
+
+    // Postings still refer to the entry; searches skip deleted entries.
+    lookupEntry.Path = Index->Entries[Id].Path->sr;
+    PhRemoveEntryHashtable(Index->PathHashtable, &lookupEntry);
+
+    Index->Entries[Id].Deleted = TRUE;
+    Index->DeletedCount++;
+}
+
+/**
+ * Adds a path to the index, or marks an existing path as seen.
+ *
+ * \param Index The index.
+ * \param Path The full path of the object.
+ * \param TypeName The object type name.
+ * \param Generation A value identifying the current walk of the namespace. See
+ * ObjectIndexRemoveStale.
+ */
+VOID ObjectIndexAdd(
+    _Inout_ POBJECT_INDEX Index,
+    _In_ PPH_STRINGREF Path,
+    _In_ PPH_STRINGREF TypeName,
+    _In_ ULONG Generation
+    )
+{
+    OBJECT_INDEX_PATH_ENTRY lookupEntry;
+    POBJECT_INDEX_PATH_ENTRY pathEntry;
+    USHORT typeIndex;
+
+    typeIndex = ObjectIndexInternType(Index, TypeName);
+    lookupEntry.Path = *Path;
+
+    if (pathEntry = PhFindEntryHashtable(Index->PathHashtable, &lookupEntry))
+    {
+        POBJECT_INDEX_ENTRY entry = &Index->Entries[pathEntry->Id];
+
+        if (entry->TypeIndex == typeIndex)
+        {
+            entry->Generation = Generation;
+            return;
+        }
+
+        // Same name, different object.
+        ObjectIndexRemoveEntry(Index, pathEntry->Id);
+    }
+
+    ObjectIndexAddEntry(Index, PhCreateString2(Path), typeIndex, Generation);
+}
+
+/**
+ * Removes every path that was not seen by ObjectIndexAdd calls with the specified
+ * generation.
+ *
+ * \return The number of paths removed.
+ */
+ULONG ObjectIndexRemoveStale(
+    _Inout_ POBJECT_INDEX Index,
+    _In_ ULONG Generation
+    )
+{
+    ULONG removed = 0;
+
+    for (ULONG i = 0; i < Index->Count; i++)
+    {
+        if (!Index->Entries[i].Deleted && Index->Entries[i].Generation != Generation)
+        {
+            ObjectIndexRemoveEntry(Index, i);
+            removed++;
+        }
+    }
+
+    return removed;
+}
+
+/**
+ * Rebuilds the index without its deleted entries. Entry ids change.
+ */
+VOID ObjectIndexCompact(
+    _Inout_ POBJECT_INDEX Index
+    )
+{
+    POBJECT_INDEX_ENTRY entries = Index->Entries;
+    ULONG count = Index->Count;
+
+    ObjectIndexDeleteTables(Index);
+    ObjectIndexCreateTables(Index);
+
+    Index->Entries = NULL;
+    Index->Count = 0;
+    Index->Capacity = 0;
+    Index->DeletedCount = 0;
+
+    for (ULONG i = 0; i < count; i++)
+    {
+        if (entries[i].Deleted)
+            PhDereferenceObject(entries[i].Path);
+        else
+            ObjectIndexAddEntry(Index, entries[i].Path, entries[i].TypeIndex, entries[i].Generation);
+    }
+
+    if (entries)
+        PhFree(entries);
+}
+
+static BOOLEAN ObjectIndexMatchEntry(
+    _In_ POBJECT_INDEX_ENTRY Entry,
+    _In_ PPH_STRINGREF Text,
+    _In_ USHORT TypeIndex
+    )
+{
+    if (Entry->Deleted)
+        return FALSE;
+    if (TypeIndex != OBJECT_INDEX_ANY_TYPE && Entry->TypeIndex != TypeIndex)
+        return FALSE;
+
+    return Text->Length == 0 || PhFindStringInStringRef(&Entry->Path->sr, Text, TRUE) != -1;
+}
+
+/**
+ * Finds the paths that contain a string.
+ *
+ * \param Index The index.
+ * \param Text The string to search for. The search is not case sensitive.
+ * \param TypeIndex The type to restrict the search to, or OBJECT_INDEX_ANY_TYPE.
+ * \param Results A variable which receives an array of entry ids. Free it with PhFree.
+ *
+ * \return The number of entries in \a Results.
+ */
+ULONG ObjectIndexSearch(
+    _In_ POBJECT_INDEX Index,
+    _In_ PPH_STRINGREF Text,
+    _In_ USHORT TypeIndex,
+    _Out_ PULONG *Results
+    )
+{
+    SIZE_T length = Text->Length / sizeof(WCHAR);
+    PULONG candidates = NULL;
+    ULONG candidateCount = Index->Count;
+    PULONG results;
+    ULONG resultCount = 0;
+
+    if (length >= 3)
+    {
+        // Any trigram of the text must occur in a match, so the shortest posting list
+        // is a complete set of candidates.
+        for (SIZE_T i = 0; i + 3 <= length; i++)
+        {
+            OBJECT_INDEX_POSTING lookupPosting;
+            POBJECT_INDEX_POSTING posting;
+
+            lookupPosting.Trigram = ObjectIndexTrigram(&Text->Buffer[i]);
+
+            if (!(posting = PhFindEntryHashtable(Index->TrigramHashtable, &lookupPosting)))
+            {
+                *Results = NULL;
+                return 0;
+            }
+
+            if (!candidates || posting->Count < candidateCount)
+            {
+                candidates = posting->Ids;
+                candidateCount = posting->Count;
+            }
+        }
+    }
+
+    results = PhAllocate(max(candidateCount, 1) * sizeof(ULONG));
+
+    for (ULONG i = 0; i < candidateCount; i++)
+    {
+        ULONG id = candidates ? candidates[i] : i;
+
+        if (ObjectIndexMatchEntry(&Index->Entries[id], Text, TypeIndex))
+            results[resultCount++] = id;
+    }
+
+    *Results = results;
+
+    return resultCount;
+}
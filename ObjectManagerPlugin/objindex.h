@@ -0,0 +1,92 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Object Manager Plugin
+ *
+ * Copyright (C) 2016 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _OBJINDEX_H
+#define _OBJINDEX_H
+
+// Substring index over object paths. Every path is split into trigrams of upper-case
+// characters and each trigram maps to the sorted list of entries containing it. A
+// search looks up the rarest trigram of the query and checks only those entries.
+//
+// Entries are append-only: removing a path marks its entry deleted, and a path that
+// comes back gets a new entry. ObjectIndexCompact rebuilds the index when too many
+// entries are dead. The index is not synchronized.
+
+#define OBJECT_INDEX_ANY_TYPE ((USHORT)-1)
+
+typedef struct _OBJECT_INDEX_ENTRY
+{
+    PPH_STRING Path;
+    USHORT TypeIndex;
+    BOOLEAN Deleted;
+    ULONG Generation; // last ObjectIndexAdd call that saw this path
+} OBJECT_INDEX_ENTRY, *POBJECT_INDEX_ENTRY;
+
+typedef struct _OBJECT_INDEX
+{
+    POBJECT_INDEX_ENTRY Entries;
+    ULONG Count;
+    ULONG Capacity;
+    ULONG DeletedCount;
+
+    PPH_HASHTABLE PathHashtable; // path -> entry
+    PPH_HASHTABLE TrigramHashtable; // trigram -> entries
+    PPH_LIST TypeNames; // PPH_STRING, indexed by TypeIndex
+} OBJECT_INDEX, *POBJECT_INDEX;
+
+VOID ObjectIndexInitialize(
+    _Out_ POBJECT_INDEX Index
+    );
+
+VOID ObjectIndexDelete(
+    _Inout_ POBJECT_INDEX Index
+    );
+
+USHORT ObjectIndexFindType(
+    _In_ POBJECT_INDEX Index,
+    _In_ PPH_STRINGREF TypeName
+    );
+
+VOID ObjectIndexAdd(
+    _Inout_ POBJECT_INDEX Index,
+    _In_ PPH_STRINGREF Path,
+    _In_ PPH_STRINGREF TypeName,
+    _In_ ULONG Generation
+    );
+
+ULONG ObjectIndexRemoveStale(
+    _Inout_ POBJECT_INDEX Index,
+    _In_ ULONG Generation
+    );
+
+VOID ObjectIndexCompact(
+    _Inout_ POBJECT_INDEX Index
+    );
+
+ULONG ObjectIndexSearch(
+    _In_ POBJECT_INDEX Index,
+    _In_ PPH_STRINGREF Text,
+    _In_ USHORT TypeIndex,
+    _Out_ PULONG *Results
+    );
+
+#endif
@@ -0,0 +1,410 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Object Manager Plugin
+ *
+ * Copyright (C) 2016 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "main.h"
+
+typedef struct _OBJECT_WALK
+{
+    POBJECT_INDEXER Indexer;
+    ULONG Generation;
+    PH_WORK_QUEUE WorkQueue;
+    volatile LONG PendingCount;
+    HANDLE CompletedEventHandle;
+} OBJECT_WALK, *POBJECT_WALK;
+
+typedef struct _OBJECT_WALK_ITEM
+{
+    POBJECT_WALK Walk;
+    PPH_STRING Path;
+    PPH_LIST Paths; // full paths of the objects found
+    PPH_LIST TypeNames;
+} OBJECT_WALK_ITEM, *POBJECT_WALK_ITEM;
+
+static PH_STRINGREF RootDirectoryPath = PH_STRINGREF_INIT(L"\\");
+static PH_STRINGREF DirectoryTypeName = PH_STRINGREF_INIT(L"Directory");
+
+static NTSTATUS NTAPI WalkDirectoryWorker(
+    _In_ PVOID Parameter
+    );
+
+static VOID QueueWalkDirectory(
+    _In_ POBJECT_WALK Walk,
+    _In_ PPH_STRING Path
+    )
+{
+    POBJECT_WALK_ITEM item;
+
+    item = PhAllocate(sizeof(OBJECT_WALK_ITEM));
+    item->Walk = Walk;
+    item->Path = Path;
+    item->Paths = NULL;
+    item->TypeNames = NULL;
+
+    InterlockedIncrement(&Walk->PendingCount);
+    PhQueueItemWorkQueue(&Walk->WorkQueue, WalkDirectoryWorker, item);
+}
+
+static BOOLEAN NTAPI WalkDirectoryCallback(
+    _In_ PPH_STRINGREF Name,
+    _In_ PPH_STRINGREF TypeName,
+    _In_opt_ PVOID Context
+    )
+{
+    static PH_STRINGREF separator = PH_STRINGREF_INIT(L"\\");
+    POBJECT_WALK_ITEM item = Context;
+    PPH_STRING path;
+
+    if (item->Path->Length == sizeof(WCHAR))
+        path = PhConcatStringRef2(&item->Path->sr, Name);
+    else
+        path = PhConcatStringRef3(&item->Path->sr, &separator, Name);
+
+    PhAddItemList(item->Paths, path);
+    PhAddItemList(item->TypeNames, PhCreateString2(TypeName));
+
+    // Subdirectories are enumerated by other threads of the walk.
+    if (PhEqualStringRef(TypeName, &DirectoryTypeName, TRUE))
+        QueueWalkDirectory(item->Walk, PhReferenceObject(path));
+
+    return !item->Walk->Indexer->Cancelled;
+}
+
+static NTSTATUS NTAPI WalkDirectoryWorker(
+    _In_ PVOID Parameter
+    )
+{
+    POBJECT_WALK_ITEM item = Parameter;
+    POBJECT_WALK walk = item->Walk;
+    POBJECT_INDEXER indexer = walk->Indexer;
+    HANDLE directoryHandle;
+    OBJECT_ATTRIBUTES oa;
+    UNICODE_STRING name;
+
+    if (!indexer->Cancelled && PhStringRefToUnicodeString(&item->Path->sr, &name))
+    {
+        InitializeObjectAttributes(&oa, &name, 0, NULL, NULL);
+
+        if (NT_SUCCESS(NtOpenDirectoryObject(&directoryHandle, DIRECTORY_QUERY, &oa)))
+        {
+            item->Paths = PhCreateList(64);
+            item->TypeNames = PhCreateList(64);
+
+            PhEnumDirectoryObjects(directoryHandle, WalkDirectoryCallback, item);
+            NtClose(directoryHandle);
+
+            // One short exclusive section per directory keeps searches responsive
+            // while the walk is running.
+            PhAcquireQueuedLockExclusive(&indexer->Lock);
+
+            for (ULONG i = 0; i < item->Paths->Count; i++)
+            {
+                ObjectIndexAdd(
+                    &indexer->Index,
+                    &((PPH_STRING)item->Paths->Items[i])->sr,
+                    &((PPH_STRING)item->TypeNames->Items[i])->sr,
+                    walk->Generation
+                    );
+            }
+
+            PhReleaseQueuedLockExclusive(&indexer->Lock);
+
+            for (ULONG i = 0; i < item->Paths->Count; i++)
+            {
+                PhDereferenceObject(item->Paths->Items[i]);
+                PhDereferenceObject(item->TypeNames->Items[i]);
+            }
+
+            PhDereferenceObject(item->Paths);
+            PhDereferenceObject(item->TypeNames);
+        }
+    }
+
+    PhDereferenceObject(item->Path);
+    PhFree(item);
+
+    if (InterlockedDecrement(&walk->PendingCount) == 0)
+        NtSetEvent(walk->CompletedEventHandle, NULL);
+
+    return STATUS_SUCCESS;
+}
+
+static BOOLEAN WalkObjectNamespace(
+    _In_ POBJECT_INDEXER Indexer
+    )
+{
+    OBJECT_WALK walk;
+    ULONG threadCount;
+
+    if (!NT_SUCCESS(NtCreateEvent(&walk.CompletedEventHandle, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE)))
+        return FALSE;
+
+    // Directories are independent, so the walk fans out across a private work queue.
+    threadCount = min(PhSystemBasicInformation.NumberOfProcessors, OBJMGR_INDEX_MAX_THREADS);
+
+    walk.Indexer = Indexer;
+    walk.Generation = ++Indexer->Generation;
+    walk.PendingCount = 0;
+    PhInitializeWorkQueue(&walk.WorkQueue, 0, max(threadCount, 1), 500);
+
+    QueueWalkDirectory(&walk, PhCreateString2(&RootDirectoryPath));
+    NtWaitForSingleObject(walk.CompletedEventHandle, FALSE, NULL);
+
+    PhDeleteWorkQueue(&walk.WorkQueue);
+    NtClose(walk.CompletedEventHandle);
+
+    return !Indexer->Cancelled;
+}
+
+static VOID DereferenceObjectIndexer(
+    _In_ POBJECT_INDEXER Indexer
+    )
+{
+    if (InterlockedDecrement(&Indexer->RefCount) == 0)
+    {
+        ObjectIndexDelete(&Indexer->Index);
+        NtClose(Indexer->WakeEventHandle);
+        PhFree(Indexer);
+    }
+}
+
+static NTSTATUS ObjectIndexerThreadStart(
+    _In_ PVOID Parameter
+    )
+{
+    POBJECT_INDEXER indexer = Parameter;
+    LARGE_INTEGER timeout;
+
+    do
+    {
+        // Each walk re-adds every path it finds; paths that were not seen are removed
+        // afterwards, so the index only changes where the namespace did.
+        if (!WalkObjectNamespace(indexer))
+            break;
+
+        PhAcquireQueuedLockExclusive(&indexer->Lock);
+
+        ObjectIndexRemoveStale(&indexer->Index, indexer->Generation);
+
+        if (indexer->Index.DeletedCount > indexer->Index.Count / 4)
+            ObjectIndexCompact(&indexer->Index);
+
+        if (indexer->WindowHandle)
+            PostMessage(indexer->WindowHandle, WM_OBJMGR_INDEX_UPDATED, 0, 0);
+
+        PhReleaseQueuedLockExclusive(&indexer->Lock);
+    } while (NtWaitForSingleObject(
+        indexer->WakeEventHandle,
+        FALSE,
+        PhTimeoutFromMilliseconds(&timeout, OBJMGR_INDEX_INTERVAL)
+        ) == STATUS_TIMEOUT);
+
+    DereferenceObjectIndexer(indexer);
+
+    return STATUS_SUCCESS;
+}
+
+/**
+ * Starts indexing the object namespace in the background.
+ *
+ * \param WindowHandle The window that receives WM_OBJMGR_INDEX_UPDATED after each walk
+ * of the namespace.
+ */
+POBJECT_INDEXER CreateObjectIndexer(
+    _In_ HWND WindowHandle
+    )
+{
+    POBJECT_INDEXER indexer;
+    HANDLE threadHandle;
+
+    indexer = PhAllocate(sizeof(OBJECT_INDEXER));
+    memset(indexer, 0, sizeof(OBJECT_INDEXER));
+
+    indexer->RefCount = 2; // the window and the indexer thread
+    indexer->WindowHandle = WindowHandle;
+    PhInitializeQueuedLock(&indexer->Lock);
+    ObjectIndexInitialize(&indexer->Index);
+
+    if (!NT_SUCCESS(NtCreateEvent(&indexer->WakeEventHandle, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE)))
+    {
+        ObjectIndexDelete(&indexer->Index);
+        PhFree(indexer);
+        return NULL;
+    }
+
+    if (threadHandle = PhCreateThread(0, ObjectIndexerThreadStart, indexer))
+    {
+        NtClose(threadHandle);
+    }
+    else
+    {
+        indexer->RefCount = 1;
+    }
+
+    return indexer;
+}
+
+/**
+ * Stops the indexer. The indexer is freed once its thread has exited.
+ */
+VOID DestroyObjectIndexer(
+    _In_ POBJECT_INDEXER Indexer
+    )
+{
+    Indexer->Cancelled = TRUE;
+
+    PhAcquireQueuedLockExclusive(&Indexer->Lock);
+    Indexer->WindowHandle = NULL;
+    PhReleaseQueuedLockExclusive(&Indexer->Lock);
+
+    NtSetEvent(Indexer->WakeEventHandle, NULL);
+    DereferenceObjectIndexer(Indexer);
+}
+
+static NTSTATUS NTAPI ObjectSearchWorker(
+    _In_ PVOID Parameter
+    )
+{
+    POBJECT_SEARCH_REQUEST request = Parameter;
+    POBJECT_INDEXER indexer = request->Indexer;
+    static PH_STRINGREF whitespace = PH_STRINGREF_INIT(L" ");
+    PH_STRINGREF text = request->Text->sr;
+    PH_STRINGREF typeName;
+    PH_STRINGREF remainingPart;
+    USHORT typeIndex = OBJECT_INDEX_ANY_TYPE;
+    PULONG results = NULL;
+    ULONG count;
+
+    PhAcquireQueuedLockShared(&indexer->Lock);
+
+    // Don't bother searching for a window that is already gone.
+    if (!IsCancelContextSignaled(request->CancelContext))
+    {
+        if (PhSplitStringRefAtChar(&request->Text->sr, L':', &typeName, &remainingPart))
+        {
+            PhTrimStringRef(&typeName, &whitespace, 0);
+
+            if ((typeIndex = ObjectIndexFindType(&indexer->Index, &typeName)) != OBJECT_INDEX_ANY_TYPE)
+            {
+                text = remainingPart;
+                PhTrimStringRef(&text, &whitespace, 0);
+            }
+        }
+
+        // Queries shorter than a trigram check every entry, which is why searches do
+        // not run on the UI thread.
+        count = ObjectIndexSearch(&indexer->Index, &text, typeIndex, &results);
+
+        request->Paths = PhCreateList(max(count, 1));
+        request->TypeNames = PhCreateList(max(count, 1));
+
+        for (ULONG i = 0; i < count; i++)
+        {
+            POBJECT_INDEX_ENTRY entry = &indexer->Index.Entries[results[i]];
+
+            PhAddItemList(request->Paths, PhReferenceObject(entry->Path));
+            PhAddItemList(request->TypeNames, PhReferenceObject(indexer->Index.TypeNames->Items[entry->TypeIndex]));
+        }
+    }
+
+    PhReleaseQueuedLockShared(&indexer->Lock);
+
+    if (results)
+        PhFree(results);
+
+    // If the window was destroyed in the meantime nobody will drain the request.
+    if (!request->Paths || !PostCancelContextMessage(request->CancelContext, WM_OBJMGR_SEARCH_COMPLETE, 0, (LPARAM)request))
+        DestroyObjectSearchRequest(request);
+
+    DereferenceObjectIndexer(indexer);
+
+    return STATUS_SUCCESS;
+}
+
+/**
+ * Starts searching the index for objects whose paths contain a string. The results
+ * are posted to the dialog with WM_OBJMGR_SEARCH_COMPLETE; earlier searches that
+ * have not completed yet are abandoned.
+ *
+ * \param Context The dialog context.
+ * \param Text The search text. A prefix that names an object type and ends with a
+ * colon restricts the search to that type, e.g. "ALPC Port:RPC Control\OLE".
+ */
+VOID QueueObjectSearch(
+    _Inout_ POBJ_CONTEXT Context,
+    _In_ PPH_STRINGREF Text
+    )
+{
+    POBJECT_SEARCH_REQUEST request;
+
+    request = PhAllocate(sizeof(OBJECT_SEARCH_REQUEST));
+    memset(request, 0, sizeof(OBJECT_SEARCH_REQUEST));
+    request->Indexer = Context->Indexer;
+    request->CancelContext = ReferenceCancelContext(Context->CancelContext);
+    request->Generation = ++Context->SearchGeneration;
+    request->Text = PhCreateString2(Text);
+
+    InterlockedIncrement(&Context->Indexer->RefCount);
+    PhQueueItemWorkQueue(PhGetGlobalWorkQueue(), ObjectSearchWorker, request);
+}
+
+/**
+ * Replaces the object list with the results of a search.
+ */
+VOID ApplyObjectSearch(
+    _Inout_ POBJ_CONTEXT Context,
+    _In_ POBJECT_SEARCH_REQUEST Request
+    )
+{
+    ClearObjectEntries(Context);
+
+    for (ULONG i = 0; i < Request->Paths->Count; i++)
+    {
+        AddObjectEntry(
+            Context,
+            &((PPH_STRING)Request->Paths->Items[i])->sr,
+            &((PPH_STRING)Request->TypeNames->Items[i])->sr
+            );
+    }
+
+    SortObjectEntries(Context);
+}
+
+VOID DestroyObjectSearchRequest(
+    _In_ POBJECT_SEARCH_REQUEST Request
+    )
+{
+    if (Request->Paths)
+    {
+        for (ULONG i = 0; i < Request->Paths->Count; i++)
+        {
+            PhDereferenceObject(Request->Paths->Items[i]);
+            PhDereferenceObject(Request->TypeNames->Items[i]);
+        }
+
+        PhDereferenceObject(Request->Paths);
+        PhDereferenceObject(Request->TypeNames);
+    }
+
+    PhDereferenceObject(Request->Text);
+    DereferenceCancelContext(Request->CancelContext);
+    PhFree(Request);
+}
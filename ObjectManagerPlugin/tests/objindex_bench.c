@@ -0,0 +1,243 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Object Manager Plugin
+ *
+ * Copyright (C) 2016 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Benchmark for the object path index with a million objects. Times a full walk
+// into an empty index, a walk that finds the same namespace again, and searches
+// with trigram queries and with queries shorter than a trigram, which check every
+// entry. A scan of every path with PhFindStringInStringRef is the baseline. It is
+// not part of the plugin build.
+//
+//   gcc -O2 -fshort-wchar -I../../common/tests/shim -I.. objindex_bench.c ../objindex.c -o objindex_bench
+//   ./objindex_bench [objects]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <phdk.h>
+#include "objindex.h"
+
+static uint64_t BenchRandomState = 0x9e3779b97f4a7c15;
+
+static uint32_t BenchRandom(
+    void
+    )
+{
+    BenchRandomState ^= BenchRandomState << 13;
+    BenchRandomState ^= BenchRandomState >> 7;
+    BenchRandomState ^= BenchRandomState << 17;
+
+    return (uint32_t)BenchRandomState;
+}
+
+static double BenchNow(
+    void
+    )
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+static PH_STRINGREF BenchDirectories[] =
+{
+    PH_STRINGREF_INIT(L"\\BaseNamedObjects\\"),
+    PH_STRINGREF_INIT(L"\\Sessions\\1\\BaseNamedObjects\\"),
+    PH_STRINGREF_INIT(L"\\Sessions\\1\\BaseNamedObjects\\Local\\"),
+    PH_STRINGREF_INIT(L"\\RPC Control\\"),
+    PH_STRINGREF_INIT(L"\\Device\\"),
+    PH_STRINGREF_INIT(L"\\Sessions\\0\\AppContainerNamedObjects\\S-1-15-2-1430448594-2639229838\\")
+};
+
+static PH_STRINGREF BenchPrefixes[] =
+{
+    PH_STRINGREF_INIT(L"SM0:"),
+    PH_STRINGREF_INIT(L"WilStaging_02_p0h_"),
+    PH_STRINGREF_INIT(L"OLE"),
+    PH_STRINGREF_INIT(L"LRPC-"),
+    PH_STRINGREF_INIT(L"HarddiskVolume"),
+    PH_STRINGREF_INIT(L"CicLoadWinStaWinSta0_"),
+    PH_STRINGREF_INIT(L"__ComCatalogCache__"),
+    PH_STRINGREF_INIT(L"msctf.SharedWinSta0Default")
+};
+
+static PH_STRINGREF BenchTypeNames[] =
+{
+    PH_STRINGREF_INIT(L"Event"),
+    PH_STRINGREF_INIT(L"Section"),
+    PH_STRINGREF_INIT(L"Mutant"),
+    PH_STRINGREF_INIT(L"ALPC Port"),
+    PH_STRINGREF_INIT(L"Semaphore"),
+    PH_STRINGREF_INIT(L"SymbolicLink")
+};
+
+// Directory, a common prefix and a random hexadecimal suffix, e.g.
+// "\Sessions\1\BaseNamedObjects\SM0:1A2F:304:WilStaging_02_p0h_C0FFEE17".
+static PPH_STRING BenchCreatePath(
+    void
+    )
+{
+    static const WCHAR hex[] = L"0123456789ABCDEF";
+    PPH_STRINGREF directory = &BenchDirectories[BenchRandom() % (sizeof(BenchDirectories) / sizeof(PH_STRINGREF))];
+    PPH_STRINGREF prefix = &BenchPrefixes[BenchRandom() % (sizeof(BenchPrefixes) / sizeof(PH_STRINGREF))];
+    SIZE_T suffixLength = 8 + BenchRandom() % 25;
+    PPH_STRING path;
+    PWCHAR buffer;
+
+    path = PhCreateStringEx(NULL, directory->Length + prefix->Length + suffixLength * sizeof(WCHAR));
+    buffer = path->Buffer;
+    memcpy(buffer, directory->Buffer, directory->Length);
+    buffer += directory->Length / sizeof(WCHAR);
+    memcpy(buffer, prefix->Buffer, prefix->Length);
+    buffer += prefix->Length / sizeof(WCHAR);
+
+    for (SIZE_T i = 0; i < suffixLength; i++)
+        buffer[i] = hex[BenchRandom() % 16];
+
+    return path;
+}
+
+static ULONG BenchScan(
+    PPH_STRING *Paths,
+    ULONG Count,
+    PPH_STRINGREF Text
+    )
+{
+    ULONG matches = 0;
+
+    for (ULONG i = 0; i < Count; i++)
+    {
+        if (PhFindStringInStringRef(&Paths[i]->sr, Text, TRUE) != (ULONG_PTR)-1)
+            matches++;
+    }
+
+    return matches;
+}
+
+static void BenchSearch(
+    POBJECT_INDEX Index,
+    PPH_STRING *Paths,
+    ULONG Count,
+    PPH_STRINGREF Text,
+    const char *Label
+    )
+{
+    double start;
+    double indexTime;
+    double scanTime;
+    PULONG results;
+    ULONG count;
+    ULONG scanCount;
+
+    start = BenchNow();
+    count = ObjectIndexSearch(Index, Text, OBJECT_INDEX_ANY_TYPE, &results);
+    indexTime = BenchNow() - start;
+
+    start = BenchNow();
+    scanCount = BenchScan(Paths, Count, Text);
+    scanTime = BenchNow() - start;
+
+    printf("  %-24s %8lu matches  index %9.3f ms  scan %9.3f ms%s\n",
+        Label, (unsigned long)count, indexTime, scanTime, count == scanCount ? "" : "  MISMATCH");
+
+    if (results)
+        PhFree(results);
+}
+
+int main(
+    int argc,
+    char *argv[]
+    )
+{
+    ULONG count = 1000000;
+    OBJECT_INDEX index;
+    PPH_STRING *paths;
+    PPH_STRING query;
+    PH_STRINGREF text;
+    double start;
+
+    if (argc > 1)
+        count = strtoul(argv[1], NULL, 10);
+
+    paths = PhAllocate(count * sizeof(PPH_STRING));
+
+    for (ULONG i = 0; i < count; i++)
+        paths[i] = BenchCreatePath();
+
+    ObjectIndexInitialize(&index);
+
+    start = BenchNow();
+
+    for (ULONG i = 0; i < count; i++)
+        ObjectIndexAdd(&index, &paths[i]->sr, &BenchTypeNames[i % (sizeof(BenchTypeNames) / sizeof(PH_STRINGREF))], 1);
+
+    printf("%lu objects\n", (unsigned long)count);
+    printf("first walk       %9.1f ms\n", BenchNow() - start);
+
+    start = BenchNow();
+
+    for (ULONG i = 0; i < count; i++)
+        ObjectIndexAdd(&index, &paths[i]->sr, &BenchTypeNames[i % (sizeof(BenchTypeNames) / sizeof(PH_STRINGREF))], 2);
+
+    ObjectIndexRemoveStale(&index, 2);
+    printf("unchanged walk   %9.1f ms\n", BenchNow() - start);
+
+    printf("search\n");
+
+    // A suffix of a random path: one match, found through a rare trigram.
+    query = paths[BenchRandom() % count];
+    text.Buffer = query->Buffer + query->Length / sizeof(WCHAR) - 8;
+    text.Length = 8 * sizeof(WCHAR);
+    BenchSearch(&index, paths, count, &text, "8-character suffix");
+
+    text.Buffer = L"wilstaging";
+    text.Length = 10 * sizeof(WCHAR);
+    BenchSearch(&index, paths, count, &text, "\"wilstaging\"");
+
+    text.Buffer = L"RPC Control\\LRPC-";
+    text.Length = 17 * sizeof(WCHAR);
+    BenchSearch(&index, paths, count, &text, "\"RPC Control\\LRPC-\"");
+
+    text.Buffer = L"ZZZ";
+    text.Length = 3 * sizeof(WCHAR);
+    BenchSearch(&index, paths, count, &text, "\"ZZZ\" (no trigram)");
+
+    // Shorter than a trigram: every entry is checked.
+    text.Buffer = L"C0";
+    text.Length = 2 * sizeof(WCHAR);
+    BenchSearch(&index, paths, count, &text, "\"C0\"");
+
+    text.Buffer = L"q";
+    text.Length = 1 * sizeof(WCHAR);
+    BenchSearch(&index, paths, count, &text, "\"q\"");
+
+    ObjectIndexDelete(&index);
+
+    for (ULONG i = 0; i < count; i++)
+        PhDereferenceObject(paths[i]);
+
+    PhFree(paths);
+
+    return 0;
+}
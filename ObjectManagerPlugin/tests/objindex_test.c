@@ -0,0 +1,329 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Object Manager Plugin
+ *
+ * Copyright (C) 2016 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Tests for the object path index. Random namespaces are indexed over several walks
+// and every search is checked against a scan with PhFindStringInStringRef. They are
+// not part of the plugin build; the shim directory stands in for phdk.h.
+//
+//   gcc -g -O1 -fshort-wchar -fsanitize=address,undefined -I../../common/tests/shim -I.. objindex_test.c ../objindex.c -o objindex_test
+//   ./objindex_test
+
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <phdk.h>
+#include "objindex.h"
+
+static int TestFailures = 0;
+
+#define CHECK(Expression) \
+    do { if (!(Expression)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #Expression); TestFailures++; } } while (0)
+
+#define TEST_POOL_SIZE 300
+#define TEST_MAX_PATH 24
+
+static uint64_t TestRandomState = 0x2545f4914f6cdd1d;
+
+static uint32_t TestRandom(
+    void
+    )
+{
+    TestRandomState ^= TestRandomState << 13;
+    TestRandomState ^= TestRandomState >> 7;
+    TestRandomState ^= TestRandomState << 17;
+
+    return (uint32_t)TestRandomState;
+}
+
+static PH_STRINGREF TestTypeNames[] =
+{
+    PH_STRINGREF_INIT(L"Event"),
+    PH_STRINGREF_INIT(L"Section"),
+    PH_STRINGREF_INIT(L"ALPC Port")
+};
+
+typedef struct _TEST_PATH
+{
+    WCHAR Buffer[TEST_MAX_PATH];
+    PH_STRINGREF Path;
+    ULONG TypeIndex; // into TestTypeNames
+    int Present;
+} TEST_PATH;
+
+static TEST_PATH TestPool[TEST_POOL_SIZE];
+
+// A small alphabet, so that trigrams are shared by many paths. U+017F (long s)
+// upper-cases to 'S' but lower-cases to itself.
+static const WCHAR TestAlphabet[] = { L'A', L'b', L'a', L'B', L's', L'S', 0x17f, L'\\', L'_' };
+
+static void TestRandomText(
+    PWCHAR Buffer,
+    SIZE_T Length
+    )
+{
+    for (SIZE_T i = 0; i < Length; i++)
+        Buffer[i] = TestAlphabet[TestRandom() % (sizeof(TestAlphabet) / sizeof(WCHAR))];
+}
+
+// Object names are case-insensitive, and so are the paths in the index.
+static int TestPathUnique(
+    ULONG Count,
+    TEST_PATH *Path
+    )
+{
+    for (ULONG i = 0; i < Count; i++)
+    {
+        if (PhEqualStringRef(&TestPool[i].Path, &Path->Path, TRUE))
+            return 0;
+    }
+
+    return 1;
+}
+
+static void TestBuildPool(
+    void
+    )
+{
+    for (ULONG i = 0; i < TEST_POOL_SIZE; i++)
+    {
+        TEST_PATH *path = &TestPool[i];
+
+        do
+        {
+            SIZE_T length = 1 + TestRandom() % (TEST_MAX_PATH - 2);
+
+            path->Buffer[0] = L'\\';
+            TestRandomText(&path->Buffer[1], length);
+            path->Path.Buffer = path->Buffer;
+            path->Path.Length = (length + 1) * sizeof(WCHAR);
+        } while (!TestPathUnique(i, path));
+
+        path->TypeIndex = TestRandom() % 3;
+    }
+}
+
+static USHORT TestFindType(
+    POBJECT_INDEX Index,
+    ULONG TypeIndex
+    )
+{
+    return ObjectIndexFindType(Index, &TestTypeNames[TypeIndex]);
+}
+
+static void TestCheckSearch(
+    POBJECT_INDEX Index,
+    PPH_STRINGREF Text,
+    ULONG TypeIndex // TEST_POOL_SIZE for any type
+    )
+{
+    USHORT typeIndex = OBJECT_INDEX_ANY_TYPE;
+    PULONG results;
+    ULONG count;
+    ULONG expectedCount = 0;
+
+    if (TypeIndex < 3 && (typeIndex = TestFindType(Index, TypeIndex)) == OBJECT_INDEX_ANY_TYPE)
+        return; // no path of this type was ever added
+
+    for (ULONG i = 0; i < TEST_POOL_SIZE; i++)
+    {
+        TEST_PATH *path = &TestPool[i];
+
+        if (path->Present && (TypeIndex >= 3 || path->TypeIndex == TypeIndex) &&
+            PhFindStringInStringRef(&path->Path, Text, TRUE) != (ULONG_PTR)-1)
+        {
+            expectedCount++;
+        }
+    }
+
+    count = ObjectIndexSearch(Index, Text, typeIndex, &results);
+    CHECK(count == expectedCount);
+
+    for (ULONG i = 0; i < count; i++)
+    {
+        POBJECT_INDEX_ENTRY entry = &Index->Entries[results[i]];
+        int found = 0;
+
+        CHECK(!entry->Deleted);
+        CHECK(i == 0 || results[i - 1] < results[i]);
+        CHECK(PhFindStringInStringRef(&entry->Path->sr, Text, TRUE) != (ULONG_PTR)-1);
+
+        for (ULONG j = 0; j < TEST_POOL_SIZE; j++)
+        {
+            if (TestPool[j].Present && PhEqualStringRef(&TestPool[j].Path, &entry->Path->sr, FALSE))
+            {
+                CHECK(TypeIndex >= 3 || TestPool[j].TypeIndex == TypeIndex);
+                found = 1;
+            }
+        }
+
+        CHECK(found);
+    }
+
+    if (results)
+        PhFree(results);
+}
+
+static void TestRandomQueries(
+    POBJECT_INDEX Index
+    )
+{
+    for (ULONG q = 0; q < 200; q++)
+    {
+        WCHAR buffer[TEST_MAX_PATH];
+        PH_STRINGREF text;
+        SIZE_T length = TestRandom() % 7;
+        TEST_PATH *path = &TestPool[TestRandom() % TEST_POOL_SIZE];
+        SIZE_T pathLength = path->Path.Length / sizeof(WCHAR);
+
+        if (q % 2 && length <= pathLength)
+        {
+            // A substring of a path, with the case of ASCII letters flipped at random.
+            SIZE_T start = TestRandom() % (pathLength - length + 1);
+
+            for (SIZE_T i = 0; i < length; i++)
+            {
+                WCHAR c = path->Buffer[start + i];
+
+                if (TestRandom() % 2 && c < 0x80)
+                    c = (WCHAR)(c ^ (c >= L'A' && c <= L'z' ? 0x20 : 0));
+
+                buffer[i] = c;
+            }
+        }
+        else
+        {
+            TestRandomText(buffer, length);
+        }
+
+        text.Buffer = buffer;
+        text.Length = length * sizeof(WCHAR);
+
+        TestCheckSearch(Index, &text, q % 4 == 0 ? TestRandom() % 3 : TEST_POOL_SIZE);
+    }
+}
+
+static void TestRandomWalks(
+    void
+    )
+{
+    OBJECT_INDEX index;
+
+    TestBuildPool();
+    ObjectIndexInitialize(&index);
+
+    for (ULONG generation = 1; generation <= 40; generation++)
+    {
+        ULONG presentCount = 0;
+
+        // Each walk sees most of the previous namespace; some objects are replaced by
+        // objects of another type with the same name.
+        for (ULONG i = 0; i < TEST_POOL_SIZE; i++)
+        {
+            TEST_PATH *path = &TestPool[i];
+
+            path->Present = TestRandom() % 8 != 0;
+
+            if (TestRandom() % 16 == 0)
+                path->TypeIndex = (path->TypeIndex + 1) % 3;
+
+            if (path->Present)
+            {
+                ObjectIndexAdd(&index, &path->Path, &TestTypeNames[path->TypeIndex], generation);
+                presentCount++;
+            }
+        }
+
+        ObjectIndexRemoveStale(&index, generation);
+        CHECK(index.Count - index.DeletedCount == presentCount);
+
+        if (generation % 5 == 0)
+        {
+            ObjectIndexCompact(&index);
+            CHECK(index.DeletedCount == 0);
+            CHECK(index.Count == presentCount);
+        }
+
+        TestRandomQueries(&index);
+    }
+
+    ObjectIndexDelete(&index);
+}
+
+static void TestCaseFolding(
+    void
+    )
+{
+    static PH_STRINGREF path = PH_STRINGREF_INIT(L"\\BaseNamedObjects\\Ma\x017fterMutex");
+    static PH_STRINGREF type = PH_STRINGREF_INIT(L"Mutant");
+    static PH_STRINGREF queries[] =
+    {
+        PH_STRINGREF_INIT(L"MASTER"),
+        PH_STRINGREF_INIT(L"master"),
+        PH_STRINGREF_INIT(L"ast"),
+        PH_STRINGREF_INIT(L"st"),
+        PH_STRINGREF_INIT(L"basenamedobjects\\ma\x017f")
+    };
+    OBJECT_INDEX index;
+    PULONG results;
+
+    // The index must agree with PhFindStringInStringRef, which upper-cases; folding to
+    // lower case would miss "ast" because U+017F lower-cases to itself.
+    CHECK(RtlUpcaseUnicodeChar(0x17f) == L'S');
+
+    ObjectIndexInitialize(&index);
+    ObjectIndexAdd(&index, &path, &type, 1);
+
+    for (ULONG i = 0; i < sizeof(queries) / sizeof(PH_STRINGREF); i++)
+    {
+        CHECK(ObjectIndexSearch(&index, &queries[i], OBJECT_INDEX_ANY_TYPE, &results) == 1);
+
+        if (results)
+            PhFree(results);
+    }
+
+    ObjectIndexDelete(&index);
+}
+
+int main(
+    void
+    )
+{
+    if (!setlocale(LC_CTYPE, "C.UTF-8"))
+    {
+        printf("C.UTF-8 locale not available\n");
+        return 1;
+    }
+
+    TestCaseFolding();
+    TestRandomWalks();
+
+    if (TestFailures)
+    {
+        printf("%d check(s) failed\n", TestFailures);
+        return 1;
+    }
+
+    printf("all tests passed\n");
+
+    return 0;
+}
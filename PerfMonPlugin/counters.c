@@ -22,24 +22,127 @@
 
 #include "perfmon.h"
 
+static HANDLE PerfMonSamplerThreadHandle = NULL;
+
+VOID PerfMonGetMachineName(
+    _In_ PPH_STRING CounterPath,
+    _Out_ PPH_STRINGREF MachineName
+    )
+{
+    static PH_STRINGREF machinePrefix = PH_STRINGREF_INIT(L"\\\\");
+    PH_STRINGREF remaining;
+    PH_STRINGREF counterName;
+
+    PhInitializeEmptyStringRef(MachineName);
+
+    // Counter paths that include a machine name start with \\machine\object...
+    if (!PhStartsWithStringRef(&CounterPath->sr, &machinePrefix, FALSE))
+        return;
+
+    remaining = CounterPath->sr;
+    PhSkipStringRef(&remaining, machinePrefix.Length);
+
+    if (PhSplitStringRefAtChar(&remaining, L'\\', MachineName, &counterName))
+        return;
+
+    PhInitializeEmptyStringRef(MachineName);
+}
+
+PPERF_QUERY_ENTRY PerfMonReferenceQuery(
+    _In_ PPH_STRINGREF MachineName
+    )
+{
+    PPERF_QUERY_ENTRY query;
+    HQUERY queryHandle;
+
+    for (ULONG i = 0; i < PerfQueryList->Count; i++)
+    {
+        query = PerfQueryList->Items[i];
+
+        if (PhEqualStringRef(&query->MachineName->sr, MachineName, TRUE))
+        {
+            query->ReferenceCount++;
+            return query;
+        }
+    }
+
+    if (PdhOpenQuery(NULL, 0, &queryHandle) != ERROR_SUCCESS)
+        return NULL;
+
+    query = PhAllocateZero(sizeof(PERF_QUERY_ENTRY));
+    query->MachineName = PhCreateString2(MachineName);
+    query->QueryHandle = queryHandle;
+    query->ReferenceCount = 1;
+
+    PhAddItemList(PerfQueryList, query);
+
+    return query;
+}
+
+VOID PerfMonDereferenceQuery(
+    _In_ PPERF_QUERY_ENTRY Query
+    )
+{
+    if (--Query->ReferenceCount != 0)
+        return;
+
+    PhRemoveItemList(PerfQueryList, PhFindItemList(PerfQueryList, Query));
+
+    PdhCloseQuery(Query->QueryHandle);
+    PhDereferenceObject(Query->MachineName);
+    PhFree(Query);
+}
+
 VOID PerfMonEntryDeleteProcedure(
     _In_ PVOID Object,
     _In_ ULONG Flags
     )
 {
     PPERF_COUNTER_ENTRY entry = Object;
-        
+
     PhAcquireQueuedLockExclusive(&PerfCounterListLock);
     PhRemoveItemList(PerfCounterList, PhFindItemList(PerfCounterList, entry));
     PhReleaseQueuedLockExclusive(&PerfCounterListLock);
 
+    // Only this counter is removed; the other counters in the shared query are untouched.
+    if (entry->Query)
+    {
+        PhAcquireQueuedLockExclusive(&PerfQueryListLock);
+
+        if (entry->PerfCounterHandle)
+        {
+            PdhRemoveCounter(entry->PerfCounterHandle);
+            entry->PerfCounterHandle = NULL;
+        }
+
+        PerfMonDereferenceQuery(entry->Query);
+        entry->Query = NULL;
+
+        PhReleaseQueuedLockExclusive(&PerfQueryListLock);
+    }
+
     DeletePerfCounterId(&entry->Id);
     PhDeleteCircularBuffer_ULONG64(&entry->HistoryBuffer);
+    HistoryDeleteStore(&entry->LongHistory);
 
-    if (entry->PerfQueryHandle)
+    if (entry->Wildcard)
     {
-        PdhCloseQuery(entry->PerfQueryHandle);
-        entry->PerfQueryHandle = NULL;
+        for (ULONG i = 0; i < entry->InstanceList->Count; i++)
+        {
+            PPERF_COUNTER_INSTANCE instance = entry->InstanceList->Items[i];
+
+            PhDereferenceObject(instance->Name);
+            PhFree(instance);
+        }
+
+        PhDereferenceObject(entry->InstanceList);
+        PhDereferenceObject(entry->InstanceHashtable);
+        PhDereferenceObject(entry->InstanceHistory.FreeColumns);
+        PhFree(entry->InstanceHistory.Data);
+        PhDeleteCircularBuffer_ULONG64(&entry->MaxHistoryBuffer);
+
+        if (entry->ItemBuffer)
+            PhFree(entry->ItemBuffer);
     }
 }
 
@@ -48,78 +151,628 @@ VOID PerfMonInitialize(
     )
 {
     PerfCounterList = PhCreateList(1);
+    PerfQueryList = PhCreateList(1);
     PerfCounterEntryType = PhCreateObjectType(L"PerfMonEntry", 0, PerfMonEntryDeleteProcedure);
 }
 
+VOID PerfMonAttachCounter(
+    _Inout_ PPERF_COUNTER_ENTRY Entry
+    )
+{
+    PH_STRINGREF machineName;
+    PPERF_QUERY_ENTRY query;
+
+    PerfMonGetMachineName(Entry->Id.PerfCounterPath, &machineName);
+
+    if (!(query = PerfMonReferenceQuery(&machineName)))
+    {
+        Entry->CounterAddFailed = TRUE;
+        return;
+    }
+
+    if (PdhAddCounter(query->QueryHandle, PhGetString(Entry->Id.PerfCounterPath), 0, &Entry->PerfCounterHandle) != ERROR_SUCCESS)
+    {
+        PerfMonDereferenceQuery(query);
+        Entry->PerfCounterHandle = NULL;
+        Entry->CounterAddFailed = TRUE;
+        return;
+    }
+
+    Entry->Query = query;
+}
+
+BOOLEAN NTAPI PerfMonInstanceEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    PPERF_COUNTER_INSTANCE instance1 = *(PPERF_COUNTER_INSTANCE *)Entry1;
+    PPERF_COUNTER_INSTANCE instance2 = *(PPERF_COUNTER_INSTANCE *)Entry2;
+
+    return PhEqualStringRef(&instance1->Key, &instance2->Key, TRUE);
+}
+
+ULONG NTAPI PerfMonInstanceHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    PPERF_COUNTER_INSTANCE instance = *(PPERF_COUNTER_INSTANCE *)Entry;
+
+    return PhHashStringRef(&instance->Key, TRUE);
+}
+
+ULONG PerfMonAllocateInstanceColumn(
+    _Inout_ PPERF_INSTANCE_HISTORY History
+    )
+{
+    ULONG column;
+
+    if (History->FreeColumns->Count != 0)
+    {
+        column = PtrToUlong(History->FreeColumns->Items[History->FreeColumns->Count - 1]);
+        PhRemoveItemList(History->FreeColumns, History->FreeColumns->Count - 1);
+    }
+    else
+    {
+        if (History->ColumnCount == History->ColumnCapacity)
+        {
+            History->ColumnCapacity *= 2;
+            History->Data = PhReAllocate(History->Data, (SIZE_T)History->ColumnCapacity * History->SampleCount * sizeof(ULONG64));
+        }
+
+        column = History->ColumnCount++;
+    }
+
+    // Samples from before the instance appeared read as zero.
+    memset(&History->Data[(SIZE_T)column * History->SampleCount], 0, History->SampleCount * sizeof(ULONG64));
+
+    return column;
+}
+
+ULONG64 PerfMonGetInstanceHistoryValue(
+    _In_ PPERF_INSTANCE_HISTORY History,
+    _In_ ULONG Column,
+    _In_ ULONG Index
+    )
+{
+    ULONG row;
+
+    if (Index >= History->Count)
+        return 0;
+
+    row = History->Index + Index;
+
+    if (row >= History->SampleCount)
+        row -= History->SampleCount;
+
+    return History->Data[(SIZE_T)Column * History->SampleCount + row];
+}
+
+PPERF_COUNTER_INSTANCE PerfMonReferenceInstance(
+    _Inout_ PPERF_COUNTER_ENTRY Entry,
+    _In_ PPH_STRINGREF Name
+    )
+{
+    PERF_COUNTER_INSTANCE lookupInstance;
+    PPERF_COUNTER_INSTANCE lookupInstancePtr = &lookupInstance;
+    PPERF_COUNTER_INSTANCE *instancePtr;
+    PPERF_COUNTER_INSTANCE instance;
+
+    lookupInstance.Key = *Name;
+    instancePtr = PhFindEntryHashtable(Entry->InstanceHashtable, &lookupInstancePtr);
+
+    if (instancePtr)
+        return *instancePtr;
+
+    instance = PhAllocateZero(sizeof(PERF_COUNTER_INSTANCE));
+    instance->Name = PhCreateString2(Name);
+    instance->Key = instance->Name->sr;
+    instance->Column = PerfMonAllocateInstanceColumn(&Entry->InstanceHistory);
+
+    PhAddEntryHashtable(Entry->InstanceHashtable, &instance);
+    PhAddItemList(Entry->InstanceList, instance);
+
+    return instance;
+}
+
+typedef struct _PERF_INSTANCE_NAME_COUNT
+{
+    PH_STRINGREF Name;
+    ULONG Count;
+} PERF_INSTANCE_NAME_COUNT, *PPERF_INSTANCE_NAME_COUNT;
+
+BOOLEAN NTAPI PerfMonInstanceNameCountEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    return PhEqualStringRef(&((PPERF_INSTANCE_NAME_COUNT)Entry1)->Name, &((PPERF_INSTANCE_NAME_COUNT)Entry2)->Name, TRUE);
+}
+
+ULONG NTAPI PerfMonInstanceNameCountHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    return PhHashStringRef(&((PPERF_INSTANCE_NAME_COUNT)Entry)->Name, TRUE);
+}
+
+BOOLEAN PerfMonUpdateInstances(
+    _Inout_ PPERF_COUNTER_ENTRY Entry,
+    _In_ ULONG RunCount,
+    _Out_ PULONG64 Total
+    )
+{
+    static PH_STRINGREF totalInstanceName = PH_STRINGREF_INIT(L"_Total");
+    PDH_STATUS status;
+    ULONG bufferSize;
+    ULONG itemCount = 0;
+    ULONG64 total = 0;
+
+    // Every instance is returned by a single call. The item buffer is kept between
+    // ticks and only grows when PDH asks for more space. It is only touched by the
+    // sampler thread, so InstanceLock is not held while PDH formats the values; the
+    // graphs only wait for the merge below.
+
+    bufferSize = Entry->ItemBufferSize;
+    status = PdhGetFormattedCounterArray(
+        Entry->PerfCounterHandle,
+        PDH_FMT_LARGE | PDH_FMT_NOSCALE | PDH_FMT_NOCAP100,
+        &bufferSize,
+        &itemCount,
+        Entry->ItemBuffer
+        );
+
+    if (status == PDH_MORE_DATA)
+    {
+        if (Entry->ItemBuffer)
+            PhFree(Entry->ItemBuffer);
+
+        Entry->ItemBufferSize = bufferSize;
+        Entry->ItemBuffer = PhAllocate(bufferSize);
+
+        status = PdhGetFormattedCounterArray(
+            Entry->PerfCounterHandle,
+            PDH_FMT_LARGE | PDH_FMT_NOSCALE | PDH_FMT_NOCAP100,
+            &bufferSize,
+            &itemCount,
+            Entry->ItemBuffer
+            );
+    }
+
+    if (status == ERROR_SUCCESS)
+    {
+        PPH_HASHTABLE nameCountHashtable;
+
+        nameCountHashtable = PhCreateHashtable(
+            sizeof(PERF_INSTANCE_NAME_COUNT),
+            PerfMonInstanceNameCountEqualFunction,
+            PerfMonInstanceNameCountHashFunction,
+            max(itemCount, 1)
+            );
+
+        PhAcquireQueuedLockExclusive(&Entry->InstanceLock);
+
+        for (ULONG i = 0; i < itemCount; i++)
+        {
+            PPDH_FMT_COUNTERVALUE_ITEM item = &Entry->ItemBuffer[i];
+            PPERF_COUNTER_INSTANCE instance;
+            PH_STRINGREF instanceName;
+            PERF_INSTANCE_NAME_COUNT lookupNameCount;
+            PPERF_INSTANCE_NAME_COUNT nameCount;
+            BOOLEAN added;
+
+            PhInitializeStringRefLongHint(&instanceName, item->szName);
+
+            // _Total would dominate the graph and is already the sum we compute below.
+            if (PhEqualStringRef(&instanceName, &totalInstanceName, TRUE))
+                continue;
+
+            // Wildcard counters such as \Process(*) return one item per process, so names
+            // repeat. Like Perfmon, the k-th duplicate becomes "name#k".
+            lookupNameCount.Name = instanceName;
+            lookupNameCount.Count = 0;
+            nameCount = PhAddEntryHashtableEx(nameCountHashtable, &lookupNameCount, &added);
+
+            if (added)
+            {
+                instance = PerfMonReferenceInstance(Entry, &instanceName);
+            }
+            else
+            {
+                PPH_STRING duplicateName;
+
+                duplicateName = PhFormatString(L"%.*s#%lu", (ULONG)(instanceName.Length / sizeof(WCHAR)), instanceName.Buffer, ++nameCount->Count);
+                instance = PerfMonReferenceInstance(Entry, &duplicateName->sr);
+                PhDereferenceObject(duplicateName);
+            }
+
+            instance->LastUpdate = RunCount;
+
+            if ((item->FmtValue.CStatus == PDH_CSTATUS_VALID_DATA || item->FmtValue.CStatus == PDH_CSTATUS_NEW_DATA) &&
+                item->FmtValue.largeValue > 0)
+            {
+                instance->Value = (ULONG64)item->FmtValue.largeValue;
+            }
+            else
+            {
+                instance->Value = 0;
+            }
+
+            // Accumulated until the next display tick, see PerfMonAddInstanceHistory.
+            instance->SampleSum += instance->Value;
+            instance->SampleCount++;
+        }
+
+        PhDereferenceObject(nameCountHashtable);
+
+        // Remove instances that have disappeared since the last tick.
+        for (ULONG i = 0; i < Entry->InstanceList->Count; )
+        {
+            PPERF_COUNTER_INSTANCE instance = Entry->InstanceList->Items[i];
+
+            if (instance->LastUpdate != RunCount)
+            {
+                PhRemoveEntryHashtable(Entry->InstanceHashtable, &instance);
+                PhRemoveItemList(Entry->InstanceList, i);
+                PhAddItemList(Entry->InstanceHistory.FreeColumns, UlongToPtr(instance->Column));
+
+                PhDereferenceObject(instance->Name);
+                PhFree(instance);
+            }
+            else
+            {
+                total += instance->Value;
+                i++;
+            }
+        }
+
+        PhReleaseQueuedLockExclusive(&Entry->InstanceLock);
+    }
+
+    *Total = total;
+
+    return status == ERROR_SUCCESS;
+}
+
+VOID PerfMonAddInstanceHistory(
+    _Inout_ PPERF_COUNTER_ENTRY Entry
+    )
+{
+    PPERF_INSTANCE_HISTORY history = &Entry->InstanceHistory;
+    ULONG64 total = 0;
+    ULONG64 largest = 0;
+
+    PhAcquireQueuedLockExclusive(&Entry->InstanceLock);
+
+    // Newest row is at Index, like PH_CIRCULAR_BUFFER.
+    if (history->Index == 0)
+        history->Index = history->SampleCount - 1;
+    else
+        history->Index--;
+
+    if (history->Count < history->SampleCount)
+        history->Count++;
+
+    for (ULONG i = 0; i < Entry->InstanceList->Count; i++)
+    {
+        PPERF_COUNTER_INSTANCE instance = Entry->InstanceList->Items[i];
+        ULONG64 value;
+
+        // Downsample to the display rate using the mean of the samples taken since the
+        // previous display tick.
+        if (instance->SampleCount != 0)
+            value = instance->SampleSum / instance->SampleCount;
+        else
+            value = instance->Value;
+
+        instance->SampleSum = 0;
+        instance->SampleCount = 0;
+
+        history->Data[(SIZE_T)instance->Column * history->SampleCount + history->Index] = value;
+
+        total += value;
+
+        if (largest < value)
+            largest = value;
+    }
+
+    PhAddItemCircularBuffer_ULONG64(&Entry->HistoryBuffer, total);
+    PhAddItemCircularBuffer_ULONG64(&Entry->MaxHistoryBuffer, largest);
+
+    PhReleaseQueuedLockExclusive(&Entry->InstanceLock);
+}
+
+ULONG PerfMonQueryTopInstances(
+    _In_ PPERF_COUNTER_ENTRY Entry,
+    _In_ ULONG Index,
+    _In_ ULONG Count,
+    _Out_writes_(Count) PPERF_COUNTER_INSTANCE *Instances,
+    _Out_writes_(Count) PULONG64 Values
+    )
+{
+    ULONG found = 0;
+
+    // The caller must hold InstanceLock. Keeps the Count largest values in descending
+    // order using insertion; Count is small.
+
+    for (ULONG i = 0; i < Entry->InstanceList->Count; i++)
+    {
+        PPERF_COUNTER_INSTANCE instance = Entry->InstanceList->Items[i];
+        ULONG64 value = PerfMonGetInstanceHistoryValue(&Entry->InstanceHistory, instance->Column, Index);
+        ULONG position;
+
+        if (value == 0)
+            continue;
+        if (found == Count && value <= Values[Count - 1])
+            continue;
+
+        position = found < Count ? found++ : Count - 1;
+
+        while (position != 0 && Values[position - 1] < value)
+        {
+            Values[position] = Values[position - 1];
+            Instances[position] = Instances[position - 1];
+            position--;
+        }
+
+        Values[position] = value;
+        Instances[position] = instance;
+    }
+
+    return found;
+}
+
+VOID PerfMonWriteSample(
+    _Inout_ PPERF_SAMPLE_RING Ring,
+    _In_ PLARGE_INTEGER Time,
+    _In_ ULONG64 Value
+    )
+{
+    LONG64 writeCount = ReadNoFence64(&Ring->WriteCount);
+    PPERF_SAMPLE sample = &Ring->Samples[writeCount & (PERF_SAMPLE_RING_SIZE - 1)];
+
+    // Single writer: fill the slot, then publish it by advancing the count. The count
+    // is 64-bit, so it must be stored atomically or a 32-bit reader can see it torn.
+    sample->Time = *Time;
+    sample->Value = Value;
+    WriteRelease64(&Ring->WriteCount, writeCount + 1);
+}
+
+BOOLEAN PerfMonReadSample(
+    _In_ PPERF_SAMPLE_RING Ring,
+    _In_ LONG64 Sequence,
+    _Out_ PPERF_SAMPLE Sample
+    )
+{
+    LONG64 writeCount;
+
+    writeCount = ReadAcquire64(&Ring->WriteCount);
+
+    if (Sequence < 0 || Sequence >= writeCount || writeCount - Sequence >= PERF_SAMPLE_RING_SIZE)
+        return FALSE;
+
+    *Sample = Ring->Samples[Sequence & (PERF_SAMPLE_RING_SIZE - 1)];
+    MemoryBarrier();
+
+    // The writer may have lapped the reader while the sample was being copied.
+    if (ReadAcquire64(&Ring->WriteCount) - Sequence >= PERF_SAMPLE_RING_SIZE)
+        return FALSE;
+
+    return TRUE;
+}
+
+BOOLEAN PerfMonGetLatestSample(
+    _In_ PPERF_COUNTER_ENTRY Entry,
+    _Out_ PPERF_SAMPLE Sample
+    )
+{
+    return PerfMonReadSample(&Entry->SampleRing, ReadAcquire64(&Entry->SampleRing.WriteCount) - 1, Sample);
+}
+
+VOID PerfMonSample(
+    _In_ ULONG SampleCount
+    )
+{
+    PPERF_COUNTER_ENTRY *entries;
+    ULONG numberOfEntries = 0;
+    PPERF_QUERY_ENTRY *queries;
+    ULONG numberOfQueries;
+    LARGE_INTEGER sampleTime;
+
+    // Take references to the entries so the list lock is not held while PDH is
+    // collecting; a slow provider then only delays this thread.
+
+    PhAcquireQueuedLockShared(&PerfCounterListLock);
+
+    entries = PhAllocate(sizeof(PPERF_COUNTER_ENTRY) * max(PerfCounterList->Count, 1));
+
+    for (ULONG i = 0; i < PerfCounterList->Count; i++)
+    {
+        PPERF_COUNTER_ENTRY entry = PhReferenceObjectSafe(PerfCounterList->Items[i]);
+
+        if (entry)
+            entries[numberOfEntries++] = entry;
+    }
+
+    PhReleaseQueuedLockShared(&PerfCounterListLock);
+
+    PhAcquireQueuedLockExclusive(&PerfQueryListLock);
+
+    // Add new counters to the shared query for their machine.
+    for (ULONG i = 0; i < numberOfEntries; i++)
+    {
+        if (!entries[i]->Query && !entries[i]->CounterAddFailed)
+            PerfMonAttachCounter(entries[i]);
+    }
+
+    // Reference the queries so they stay open while collecting without the lock. A slow
+    // or remote provider must not block counters being added or removed on the UI thread.
+    numberOfQueries = PerfQueryList->Count;
+    queries = PhAllocate(sizeof(PPERF_QUERY_ENTRY) * max(numberOfQueries, 1));
+
+    for (ULONG i = 0; i < numberOfQueries; i++)
+    {
+        queries[i] = PerfQueryList->Items[i];
+        queries[i]->ReferenceCount++;
+    }
+
+    PhReleaseQueuedLockExclusive(&PerfQueryListLock);
+
+    // Update the sample data for every counter with one collection per machine.
+    for (ULONG i = 0; i < numberOfQueries; i++)
+        PdhCollectQueryData(queries[i]->QueryHandle);
+
+    PhAcquireQueuedLockExclusive(&PerfQueryListLock);
+
+    for (ULONG i = 0; i < numberOfQueries; i++)
+        PerfMonDereferenceQuery(queries[i]);
+
+    PhReleaseQueuedLockExclusive(&PerfQueryListLock);
+
+    PhFree(queries);
+
+    PhQuerySystemTime(&sampleTime);
+
+    for (ULONG i = 0; i < numberOfEntries; i++)
+    {
+        PPERF_COUNTER_ENTRY entry = entries[i];
+        ULONG counterType = 0;
+        PDH_FMT_COUNTERVALUE displayValue = { 0 };
+        ULONG64 value;
+
+        if (entry->PerfCounterHandle)
+        {
+            if (entry->Wildcard)
+            {
+                if (PerfMonUpdateInstances(entry, SampleCount, &value))
+                    PerfMonWriteSample(&entry->SampleRing, &sampleTime, value);
+            }
+            else if (PdhGetFormattedCounterValue(
+                entry->PerfCounterHandle,
+                PDH_FMT_LARGE | PDH_FMT_NOSCALE | PDH_FMT_NOCAP100,
+                &counterType,
+                &displayValue
+                ) == ERROR_SUCCESS)
+            {
+                // PDH has already converted rate counters to per-second values.
+                value = displayValue.largeValue > 0 ? (ULONG64)displayValue.largeValue : 0;
+                PerfMonWriteSample(&entry->SampleRing, &sampleTime, value);
+            }
+        }
+
+        PhDereferenceObjectDeferDelete(entry);
+    }
+
+    PhFree(entries);
+}
+
+NTSTATUS PerfMonSamplerThreadStart(
+    _In_ PVOID Parameter
+    )
+{
+    ULONG sampleCount = 0;
+    ULONG interval;
+    LARGE_INTEGER timeout;
+
+    interval = PhGetIntegerSetting(SETTING_NAME_PERFMON_SAMPLE_INTERVAL);
+
+    if (interval < PERF_SAMPLE_MINIMUM_INTERVAL)
+        interval = PERF_SAMPLE_MINIMUM_INTERVAL;
+
+    while (NtWaitForSingleObject(
+        PerfMonSamplerStopEvent,
+        FALSE,
+        PhTimeoutFromMilliseconds(&timeout, interval)
+        ) == STATUS_TIMEOUT)
+    {
+        PerfMonSample(sampleCount++);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+VOID PerfMonStartSampler(
+    VOID
+    )
+{
+    if (!NT_SUCCESS(NtCreateEvent(&PerfMonSamplerStopEvent, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE)))
+        return;
+
+    PerfMonSamplerThreadHandle = PhCreateThread(0, PerfMonSamplerThreadStart, NULL);
+}
+
+VOID PerfMonStopSampler(
+    VOID
+    )
+{
+    if (PerfMonSamplerStopEvent)
+        NtSetEvent(PerfMonSamplerStopEvent, NULL);
+
+    // Wait so that PDH isn't called after the plugin starts tearing down.
+    if (PerfMonSamplerThreadHandle)
+    {
+        NtWaitForSingleObject(PerfMonSamplerThreadHandle, FALSE, NULL);
+        NtClose(PerfMonSamplerThreadHandle);
+        PerfMonSamplerThreadHandle = NULL;
+    }
+}
+
 VOID PerfMonUpdate(
     VOID
     )
 {
     static ULONG runCount = 0; // MUST keep in sync with runCount in process provider
+    LARGE_INTEGER systemTime;
+    ULONG64 time;
+
+    // Counters are sampled by the sampler thread at its own interval. Here the samples
+    // taken since the last tick are averaged into the display-rate history.
+
+    PhQuerySystemTime(&systemTime);
+    time = systemTime.QuadPart / PH_TICKS_PER_MS;
 
     PhAcquireQueuedLockShared(&PerfCounterListLock);
 
     for (ULONG i = 0; i < PerfCounterList->Count; i++)
     {
         PPERF_COUNTER_ENTRY entry;
-        ULONG counterType = 0;
-        PDH_FMT_COUNTERVALUE displayValue = { 0 };
+        LONG64 writeCount;
+        LONG64 sequence;
+        ULONG64 sum = 0;
+        ULONG count = 0;
 
         entry = PhReferenceObjectSafe(PerfCounterList->Items[i]);
 
         if (!entry)
             continue;
 
-        if (entry->HaveFirstSample)
-        {
-            if (!entry->PerfQueryHandle)
-            {               
-                if (PdhOpenQuery(NULL, 0, &entry->PerfQueryHandle) == ERROR_SUCCESS)
-                {
-                    if (PdhAddCounter(entry->PerfQueryHandle, PhGetString(entry->Id.PerfCounterPath), 0, &entry->PerfCounterHandle) == ERROR_SUCCESS)
-                    {
-                        //ULONG counterLength = 0;
-                        //PPDH_COUNTER_INFO perfCounterInfo;
-                        //
-                        //if (PdhGetCounterInfo(entry->PerfCounterHandle, TRUE, &counterLength, NULL) == PDH_MORE_DATA)
-                        //{
-                        //    perfCounterInfo = PhAllocate(counterLength);
-                        //    memset(perfCounterInfo, 0, counterLength);
-                        //}
-                        //
-                        //if (PdhGetCounterInfo(entry->PerfCounterHandle, TRUE, &counterLength, perfCounterInfo) == ERROR_SUCCESS)
-                        //{
-                        //    
-                        //}
-                        //PhFree(perfCounterInfo);
-                    }
-                }
-            }
+        writeCount = ReadAcquire64(&entry->SampleRing.WriteCount);
+        sequence = max(entry->DisplaySequence, writeCount - (PERF_SAMPLE_RING_SIZE - 1));
 
-            // Update the counter sample data
-            PdhCollectQueryData(entry->PerfQueryHandle);
+        for (; sequence < writeCount; sequence++)
+        {
+            PERF_SAMPLE sample;
 
-            // Get the counter value
-            if (PdhGetFormattedCounterValue(
-                entry->PerfCounterHandle,
-                PDH_FMT_LARGE | PDH_FMT_NOSCALE | PDH_FMT_NOCAP100,
-                &counterType,
-                &displayValue
-                ) == ERROR_SUCCESS && counterType == PERF_COUNTER_COUNTER)
+            if (PerfMonReadSample(&entry->SampleRing, sequence, &sample))
             {
-                PhUpdateDelta(&entry->HistoryDelta, displayValue.largeValue);
+                sum += sample.Value;
+                count++;
             }
         }
-        else
-        {
-            PhInitializeDelta(&entry->HistoryDelta); // The first sample must be zero
 
-            entry->HaveFirstSample = TRUE;
-        }
+        entry->DisplaySequence = writeCount;
+
+        if (count != 0)
+            entry->Value = sum / count;
 
         if (runCount != 0)
         {
-            PhAddItemCircularBuffer_ULONG64(&entry->HistoryBuffer, entry->HistoryDelta.Value);
+            if (entry->Wildcard)
+                PerfMonAddInstanceHistory(entry);
+            else
+                PhAddItemCircularBuffer_ULONG64(&entry->HistoryBuffer, entry->Value);
+
+            HistoryAddSample(&entry->LongHistory, time, (FLOAT)PhGetItemCircularBuffer_ULONG64(&entry->HistoryBuffer, 0));
         }
 
         PhDereferenceObjectDeferDelete(entry);
@@ -176,6 +829,27 @@ PPERF_COUNTER_ENTRY CreatePerfCounterEntry(
     CopyPerfCounterId(&entry->Id, Id);
 
     PhInitializeCircularBuffer_ULONG64(&entry->HistoryBuffer, PhGetIntegerSetting(L"SampleCount"));
+    HistoryInitializeStore(&entry->LongHistory);
+
+    if (PhFindCharInString(entry->Id.PerfCounterPath, 0, L'*') != -1)
+    {
+        entry->Wildcard = TRUE;
+
+        PhInitializeQueuedLock(&entry->InstanceLock);
+        entry->InstanceHashtable = PhCreateHashtable(
+            sizeof(PPERF_COUNTER_INSTANCE),
+            PerfMonInstanceEqualFunction,
+            PerfMonInstanceHashFunction,
+            16
+            );
+        entry->InstanceList = PhCreateList(16);
+
+        PhInitializeCircularBuffer_ULONG64(&entry->MaxHistoryBuffer, PhGetIntegerSetting(L"SampleCount"));
+        entry->InstanceHistory.SampleCount = entry->HistoryBuffer.Size;
+        entry->InstanceHistory.ColumnCapacity = 16;
+        entry->InstanceHistory.Data = PhAllocate((SIZE_T)entry->InstanceHistory.ColumnCapacity * entry->InstanceHistory.SampleCount * sizeof(ULONG64));
+        entry->InstanceHistory.FreeColumns = PhCreateList(16);
+    }
 
     PhAcquireQueuedLockExclusive(&PerfCounterListLock);
     PhAddItemList(PerfCounterList, entry);
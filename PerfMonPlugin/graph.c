@@ -24,6 +24,24 @@
 
 #define MSG_UPDATE (WM_APP + 1)
 
+static ULONG64 PerfCounterZoomSpans[] =
+{
+    0,
+    10 * 60 * 1000,
+    60 * 60 * 1000,
+    6 * 60 * 60 * 1000,
+    HISTORY_MAXIMUM_SPAN
+};
+
+static PWSTR PerfCounterZoomNames[] =
+{
+    L"Recent samples",
+    L"Last 10 minutes",
+    L"Last hour",
+    L"Last 6 hours",
+    L"Last 24 hours"
+};
+
 PPH_STRING PerfCounterLabelYFunction(
     _In_ PPH_GRAPH_DRAW_INFO DrawInfo,
     _In_ ULONG DataIndex,
@@ -45,6 +63,184 @@ PPH_STRING PerfCounterLabelYFunction(
     }
 }
 
+// Appends a line for each of the largest instances of a wildcard counter at a
+// history index, largest first.
+VOID PerfCounterAppendTopInstances(
+    _Inout_ PPH_STRING_BUILDER StringBuilder,
+    _In_ PPERF_COUNTER_ENTRY Entry,
+    _In_ ULONG Index
+    )
+{
+    PPERF_COUNTER_INSTANCE instances[32];
+    ULONG64 values[32];
+    ULONG count;
+
+    count = PhGetIntegerSetting(SETTING_NAME_PERFMON_TOP_INSTANCES);
+
+    if (count > RTL_NUMBER_OF(instances))
+        count = RTL_NUMBER_OF(instances);
+
+    PhAcquireQueuedLockShared(&Entry->InstanceLock);
+
+    if (count != 0)
+        count = PerfMonQueryTopInstances(Entry, Index, count, instances, values);
+
+    for (ULONG i = 0; i < count; i++)
+    {
+        PhAppendFormatStringBuilder(
+            StringBuilder,
+            L"\n%s: %s",
+            instances[i]->Name->Buffer,
+            PhaFormatUInt64(values[i], TRUE)->Buffer
+            );
+    }
+
+    PhReleaseQueuedLockShared(&Entry->InstanceLock);
+}
+
+PPH_STRING PerfCounterGetTooltipText(
+    _In_ PPERF_COUNTER_ENTRY Entry,
+    _In_ ULONG Index
+    )
+{
+    PH_STRING_BUILDER stringBuilder;
+    ULONG64 counterValue;
+
+    counterValue = PhGetItemCircularBuffer_ULONG64(&Entry->HistoryBuffer, Index);
+
+    PhInitializeStringBuilder(&stringBuilder, 100);
+    PhAppendStringBuilder2(&stringBuilder, PhaFormatUInt64(counterValue, TRUE)->Buffer);
+
+    if (Entry->Wildcard)
+        PerfCounterAppendTopInstances(&stringBuilder, Entry, Index);
+
+    PhAppendCharStringBuilder(&stringBuilder, L'\n');
+    PhAppendStringBuilder(&stringBuilder, &((PPH_STRING)PH_AUTO(PhGetStatisticsTimeString(NULL, Index)))->sr);
+
+    return PhFinalStringBuilderString(&stringBuilder);
+}
+
+VOID PerfCounterGetGraphData(
+    _In_ PPERF_COUNTER_ENTRY Entry,
+    _Inout_ PPH_GRAPH_DRAW_INFO DrawInfo,
+    _Out_writes_(DrawInfo->LineDataCount) PFLOAT Data1,
+    _Out_writes_(DrawInfo->LineDataCount) PFLOAT Data2
+    )
+{
+    FLOAT max = 0;
+
+    // Wildcard counters draw the sum of all instances and, as the second line, the
+    // largest single instance at each point.
+
+    for (ULONG i = 0; i < DrawInfo->LineDataCount; i++)
+    {
+        Data1[i] = (FLOAT)PhGetItemCircularBuffer_ULONG64(&Entry->HistoryBuffer, i);
+
+        if (Data1[i] > max)
+            max = Data1[i];
+
+        if (Entry->Wildcard)
+            Data2[i] = (FLOAT)PhGetItemCircularBuffer_ULONG64(&Entry->MaxHistoryBuffer, i);
+    }
+
+    if (max != 0)
+    {
+        // Scale the data.
+        PhDivideSinglesBySingle(Data1, max, DrawInfo->LineDataCount);
+
+        if (Entry->Wildcard)
+            PhDivideSinglesBySingle(Data2, max, DrawInfo->LineDataCount);
+    }
+
+    DrawInfo->LabelYFunction = PerfCounterLabelYFunction;
+    DrawInfo->LabelYFunctionParameter = max;
+}
+
+PPH_STRING PerfCounterGetZoomedTooltipText(
+    _In_ PPH_PERFMON_SYSINFO_CONTEXT Context,
+    _In_ ULONG Index
+    )
+{
+    PHISTORY_BUCKET point;
+    LARGE_INTEGER time;
+    SYSTEMTIME systemTime;
+
+    if (Index >= Context->HistoryPointCount)
+        return PhReferenceEmptyString();
+
+    point = &Context->HistoryPoints[Index];
+    time.QuadPart = (Context->HistoryEndTime - Context->HistorySpan * Index / Context->HistoryPointCount) * PH_TICKS_PER_MS;
+    PhLargeIntegerToLocalSystemTime(&systemTime, &time);
+
+    if (point->Count == 0)
+    {
+        return PhFormatString(
+            L"No data\n%s",
+            ((PPH_STRING)PH_AUTO(PhFormatDateTime(&systemTime)))->Buffer
+            );
+    }
+
+    return PhFormatString(
+        L"%s (min %s, max %s)\n%s",
+        PhaFormatUInt64((ULONG64)point->Average, TRUE)->Buffer,
+        PhaFormatUInt64((ULONG64)point->Minimum, TRUE)->Buffer,
+        PhaFormatUInt64((ULONG64)point->Maximum, TRUE)->Buffer,
+        ((PPH_STRING)PH_AUTO(PhFormatDateTime(&systemTime)))->Buffer
+        );
+}
+
+VOID PerfCounterGetZoomedGraphData(
+    _Inout_ PPH_PERFMON_SYSINFO_CONTEXT Context,
+    _Inout_ PPH_GRAPH_DRAW_INFO DrawInfo,
+    _Out_writes_(DrawInfo->LineDataCount) PFLOAT Data1,
+    _Out_writes_(DrawInfo->LineDataCount) PFLOAT Data2
+    )
+{
+    LARGE_INTEGER systemTime;
+    FLOAT max = 0;
+
+    if (Context->HistoryPointCount != DrawInfo->LineDataCount)
+    {
+        if (Context->HistoryPoints)
+            PhFree(Context->HistoryPoints);
+
+        Context->HistoryPointCount = DrawInfo->LineDataCount;
+        Context->HistoryPoints = Context->HistoryPointCount ? PhAllocate(Context->HistoryPointCount * sizeof(HISTORY_BUCKET)) : NULL;
+    }
+
+    PhQuerySystemTime(&systemTime);
+    Context->HistoryEndTime = systemTime.QuadPart / PH_TICKS_PER_MS;
+
+    HistoryQueryRange(
+        &Context->Entry->LongHistory,
+        Context->HistoryEndTime,
+        Context->HistorySpan,
+        Context->HistoryPointCount,
+        Context->HistoryPoints
+        );
+
+    // Each point covers many samples: draw the average, and the peak as the second line.
+
+    for (ULONG i = 0; i < DrawInfo->LineDataCount; i++)
+    {
+        Data1[i] = Context->HistoryPoints[i].Average;
+        Data2[i] = Context->HistoryPoints[i].Maximum;
+
+        if (Data2[i] > max)
+            max = Data2[i];
+    }
+
+    if (max != 0)
+    {
+        // Scale the data.
+        PhDivideSinglesBySingle(Data1, max, DrawInfo->LineDataCount);
+        PhDivideSinglesBySingle(Data2, max, DrawInfo->LineDataCount);
+    }
+
+    DrawInfo->LabelYFunction = PerfCounterLabelYFunction;
+    DrawInfo->LabelYFunctionParameter = max;
+}
+
 VOID NTAPI ProcessesUpdatedHandler(
     _In_opt_ PVOID Parameter,
     _In_opt_ PVOID Context
@@ -58,16 +254,82 @@ VOID NTAPI ProcessesUpdatedHandler(
     }
 }
 
+// Lists the largest instances of the newest sample under the graph.
+VOID PerfCounterUpdateTopInstances(
+    _Inout_ PPH_PERFMON_SYSINFO_CONTEXT Context
+    )
+{
+    PH_STRING_BUILDER stringBuilder;
+    PPH_STRING text;
+
+    if (!Context->Entry->Wildcard)
+        return;
+
+    PhInitializeStringBuilder(&stringBuilder, 100);
+    PerfCounterAppendTopInstances(&stringBuilder, Context->Entry, 0);
+
+    if (stringBuilder.String->Length != 0)
+        PhRemoveStringBuilder(&stringBuilder, 0, 1); // leading newline
+
+    text = PhFinalStringBuilderString(&stringBuilder);
+    PhSetDialogItemText(Context->WindowHandle, IDC_TOPINSTANCES, text->Buffer);
+    PhDereferenceObject(text);
+}
+
 VOID PerfCounterUpdateGraphs(
     _Inout_ PPH_PERFMON_SYSINFO_CONTEXT Context
     )
 {
     Context->GraphState.Valid = FALSE;
     Context->GraphState.TooltipIndex = ULONG_MAX;
-    Graph_MoveGrid(Context->GraphHandle, 1);
+
+    if (Context->HistorySpan == 0)
+        Graph_MoveGrid(Context->GraphHandle, 1);
+
     Graph_Draw(Context->GraphHandle);
     Graph_UpdateTooltip(Context->GraphHandle);
     InvalidateRect(Context->GraphHandle, NULL, FALSE);
+
+    PerfCounterUpdateTopInstances(Context);
+}
+
+VOID PerfCounterShowZoomMenu(
+    _Inout_ PPH_PERFMON_SYSINFO_CONTEXT Context
+    )
+{
+    POINT cursorPos;
+    PPH_EMENU menu;
+    PPH_EMENU_ITEM selectedItem;
+
+    GetCursorPos(&cursorPos);
+
+    menu = PhCreateEMenu();
+
+    for (ULONG i = 0; i < RTL_NUMBER_OF(PerfCounterZoomSpans); i++)
+    {
+        PhInsertEMenuItem(
+            menu,
+            PhCreateEMenuItem(Context->HistorySpan == PerfCounterZoomSpans[i] ? PH_EMENU_CHECKED : 0, i + 1, PerfCounterZoomNames[i], NULL, NULL),
+            -1
+            );
+    }
+
+    selectedItem = PhShowEMenu(
+        menu,
+        Context->WindowHandle,
+        PH_EMENU_SHOW_LEFTRIGHT,
+        PH_ALIGN_LEFT | PH_ALIGN_TOP,
+        cursorPos.x,
+        cursorPos.y
+        );
+
+    if (selectedItem && selectedItem->Id != 0 && selectedItem->Id <= RTL_NUMBER_OF(PerfCounterZoomSpans))
+    {
+        Context->HistorySpan = PerfCounterZoomSpans[selectedItem->Id - 1];
+        PerfCounterUpdateGraphs(Context);
+    }
+
+    PhDestroyEMenu(menu);
 }
 
 INT_PTR CALLBACK PerfCounterDialogProc(
@@ -93,6 +355,13 @@ INT_PTR CALLBACK PerfCounterDialogProc(
             PhDeleteLayoutManager(&context->LayoutManager);
             PhDeleteGraphState(&context->GraphState);
 
+            if (context->HistoryPoints)
+            {
+                PhFree(context->HistoryPoints);
+                context->HistoryPoints = NULL;
+                context->HistoryPointCount = 0;
+            }
+
             if (context->GraphHandle)
                 DestroyWindow(context->GraphHandle);
 
@@ -127,11 +396,39 @@ INT_PTR CALLBACK PerfCounterDialogProc(
             Graph_SetTooltip(context->GraphHandle, TRUE);
 
             PhInitializeGraphState(&context->GraphState);
+
+            // Only wildcard counters have instances to list; other counters give the
+            // space to the graph.
+            if (!context->Entry->Wildcard)
+            {
+                HWND topInstancesHandle = GetDlgItem(hwndDlg, IDC_TOPINSTANCES);
+                HWND graphLayoutHandle = GetDlgItem(hwndDlg, IDC_GRAPH_LAYOUT);
+                RECT topInstancesRect;
+                RECT graphLayoutRect;
+
+                GetWindowRect(topInstancesHandle, &topInstancesRect);
+                GetWindowRect(graphLayoutHandle, &graphLayoutRect);
+                MapWindowPoints(NULL, hwndDlg, (POINT *)&topInstancesRect, 2);
+                MapWindowPoints(NULL, hwndDlg, (POINT *)&graphLayoutRect, 2);
+
+                SetWindowPos(
+                    graphLayoutHandle,
+                    NULL,
+                    0,
+                    0,
+                    graphLayoutRect.right - graphLayoutRect.left,
+                    topInstancesRect.bottom - graphLayoutRect.top,
+                    SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE
+                    );
+                ShowWindow(topInstancesHandle, SW_HIDE);
+            }
+
             PhInitializeLayoutManager(&context->LayoutManager, hwndDlg);
 
             PhAddLayoutItem(&context->LayoutManager, GetDlgItem(hwndDlg, IDC_COUNTERNAME), NULL, PH_ANCHOR_LEFT | PH_ANCHOR_TOP | PH_ANCHOR_RIGHT | PH_LAYOUT_FORCE_INVALIDATE);
             panelItem = PhAddLayoutItem(&context->LayoutManager, GetDlgItem(hwndDlg, IDC_GRAPH_LAYOUT), NULL, PH_ANCHOR_ALL);
             PhAddLayoutItemEx(&context->LayoutManager, context->GraphHandle, NULL, PH_ANCHOR_ALL, panelItem->Margin);
+            PhAddLayoutItem(&context->LayoutManager, GetDlgItem(hwndDlg, IDC_TOPINSTANCES), NULL, PH_ANCHOR_LEFT | PH_ANCHOR_RIGHT | PH_ANCHOR_BOTTOM);
 
             SendMessage(GetDlgItem(hwndDlg, IDC_COUNTERNAME), WM_SETFONT, (WPARAM)context->SysinfoSection->Parameters->LargeFont, FALSE);
             PhSetDialogItemText(hwndDlg, IDC_COUNTERNAME, context->SysinfoSection->Name.Buffer);
@@ -163,36 +460,32 @@ INT_PTR CALLBACK PerfCounterDialogProc(
                         PPH_GRAPH_DRAW_INFO drawInfo = getDrawInfo->DrawInfo;
 
                         drawInfo->Flags = PH_GRAPH_USE_GRID_X | PH_GRAPH_USE_GRID_Y | PH_GRAPH_LABEL_MAX_Y;
-                        context->SysinfoSection->Parameters->ColorSetupFunction(drawInfo, PhGetIntegerSetting(L"ColorCpuKernel"), 0);
-                        PhGraphStateGetDrawInfo(&context->GraphState, getDrawInfo, context->Entry->HistoryBuffer.Count);
 
-                        if (!context->GraphState.Valid)
+                        if (context->Entry->Wildcard || context->HistorySpan != 0)
+                            drawInfo->Flags |= PH_GRAPH_USE_LINE_2;
+
+                        context->SysinfoSection->Parameters->ColorSetupFunction(drawInfo, PhGetIntegerSetting(L"ColorCpuKernel"), PhGetIntegerSetting(L"ColorCpuUser"));
+
+                        if (context->HistorySpan != 0)
                         {
-                            FLOAT max = 0;
+                            // The zoomed out view is limited only by the width of the graph.
+                            PhGraphStateGetDrawInfo(&context->GraphState, getDrawInfo, ULONG_MAX);
 
-                            for (ULONG i = 0; i < drawInfo->LineDataCount; i++)
+                            if (!context->GraphState.Valid)
                             {
-                                context->GraphState.Data1[i] = (FLOAT)PhGetItemCircularBuffer_ULONG64(&context->Entry->HistoryBuffer, i);
-
-                                if (context->GraphState.Data1[i] > max)
-                                    max = context->GraphState.Data1[i];
+                                PerfCounterGetZoomedGraphData(context, drawInfo, context->GraphState.Data1, context->GraphState.Data2);
+                                context->GraphState.Valid = TRUE;
                             }
+                        }
+                        else
+                        {
+                            PhGraphStateGetDrawInfo(&context->GraphState, getDrawInfo, context->Entry->HistoryBuffer.Count);
 
-
-                            if (max != 0)
+                            if (!context->GraphState.Valid)
                             {
-                                // Scale the data.
-                                PhDivideSinglesBySingle(
-                                    context->GraphState.Data1,
-                                    max,
-                                    drawInfo->LineDataCount
-                                    );
+                                PerfCounterGetGraphData(context->Entry, drawInfo, context->GraphState.Data1, context->GraphState.Data2);
+                                context->GraphState.Valid = TRUE;
                             }
-
-                            drawInfo->LabelYFunction = PerfCounterLabelYFunction;
-                            drawInfo->LabelYFunctionParameter = max;
-
-                            context->GraphState.Valid = TRUE;
                         }
                     }
                     break;
@@ -204,16 +497,12 @@ INT_PTR CALLBACK PerfCounterDialogProc(
                         {
                             if (context->GraphState.TooltipIndex != getTooltipText->Index)
                             {
-                                ULONG64 counterValue = PhGetItemCircularBuffer_ULONG64(
-                                    &context->Entry->HistoryBuffer,
-                                    getTooltipText->Index
+                                PhMoveReference(
+                                    &context->GraphState.TooltipText,
+                                    context->HistorySpan != 0 ?
+                                    PerfCounterGetZoomedTooltipText(context, getTooltipText->Index) :
+                                    PerfCounterGetTooltipText(context->Entry, getTooltipText->Index)
                                     );
-
-                                PhMoveReference(&context->GraphState.TooltipText, PhFormatString(
-                                    L"%s\n%s",
-                                    PhaFormatUInt64(counterValue, TRUE)->Buffer,
-                                    ((PPH_STRING)PH_AUTO(PhGetStatisticsTimeString(NULL, getTooltipText->Index)))->Buffer
-                                    ));
                             }
 
                             getTooltipText->Text = context->GraphState.TooltipText->sr;
@@ -224,6 +513,12 @@ INT_PTR CALLBACK PerfCounterDialogProc(
             }
         }
         break;
+    case WM_CONTEXTMENU:
+        {
+            if ((HWND)wParam == context->GraphHandle)
+                PerfCounterShowZoomMenu(context);
+        }
+        break;
     case MSG_UPDATE:
         PerfCounterUpdateGraphs(context);
         break;
@@ -264,35 +559,16 @@ BOOLEAN PerfCounterSectionCallback(
             PPH_GRAPH_DRAW_INFO drawInfo = (PPH_GRAPH_DRAW_INFO)Parameter1;
 
             drawInfo->Flags = PH_GRAPH_USE_GRID_X | PH_GRAPH_USE_GRID_Y | PH_GRAPH_LABEL_MAX_Y;
-            Section->Parameters->ColorSetupFunction(drawInfo, PhGetIntegerSetting(L"ColorCpuKernel"), 0);
+
+            if (context->Entry->Wildcard)
+                drawInfo->Flags |= PH_GRAPH_USE_LINE_2;
+
+            Section->Parameters->ColorSetupFunction(drawInfo, PhGetIntegerSetting(L"ColorCpuKernel"), PhGetIntegerSetting(L"ColorCpuUser"));
             PhGetDrawInfoGraphBuffers(&Section->GraphState.Buffers, drawInfo, context->Entry->HistoryBuffer.Count);
 
             if (!Section->GraphState.Valid)
             {
-                FLOAT max = 0;
-
-                for (ULONG i = 0; i < drawInfo->LineDataCount; i++)
-                {
-                    Section->GraphState.Data1[i] = (FLOAT)PhGetItemCircularBuffer_ULONG64(&context->Entry->HistoryBuffer, i);
-
-                    if (Section->GraphState.Data1[i] > max)
-                        max = Section->GraphState.Data1[i];
-                }
-
-                if (max != 0)
-                {
-                    // Scale the data.
-
-                    PhDivideSinglesBySingle(
-                        Section->GraphState.Data1,
-                        max,
-                        drawInfo->LineDataCount
-                        );
-                }
-
-                drawInfo->LabelYFunction = PerfCounterLabelYFunction;
-                drawInfo->LabelYFunctionParameter = max;
-
+                PerfCounterGetGraphData(context->Entry, drawInfo, Section->GraphState.Data1, Section->GraphState.Data2);
                 Section->GraphState.Valid = TRUE;
             }
         }
@@ -301,26 +577,26 @@ BOOLEAN PerfCounterSectionCallback(
         {
             PPH_SYSINFO_GRAPH_GET_TOOLTIP_TEXT getTooltipText = (PPH_SYSINFO_GRAPH_GET_TOOLTIP_TEXT)Parameter1;
 
-            ULONG64 counterValue = PhGetItemCircularBuffer_ULONG64(
-                &context->Entry->HistoryBuffer,
-                getTooltipText->Index
+            PhMoveReference(
+                &Section->GraphState.TooltipText,
+                PerfCounterGetTooltipText(context->Entry, getTooltipText->Index)
                 );
 
-            PhMoveReference(&Section->GraphState.TooltipText, PhFormatString(
-                L"%s\n%s",
-                PhaFormatUInt64(counterValue, TRUE)->Buffer,
-                ((PPH_STRING)PH_AUTO(PhGetStatisticsTimeString(NULL, getTooltipText->Index)))->Buffer
-                ));
-
             getTooltipText->Text = Section->GraphState.TooltipText->sr;
         }
         return TRUE;
     case SysInfoGraphDrawPanel:
         {
             PPH_SYSINFO_DRAW_PANEL drawPanel = (PPH_SYSINFO_DRAW_PANEL)Parameter1;
+            PERF_SAMPLE sample;
 
             drawPanel->Title = PhCreateString2(&Section->Name);
-            drawPanel->SubTitle = PhFormatUInt64(context->Entry->HistoryDelta.Value, TRUE);
+
+            // Show the most recent sample rather than the display-rate average.
+            if (PerfMonGetLatestSample(context->Entry, &sample))
+                drawPanel->SubTitle = PhFormatUInt64(sample.Value, TRUE);
+            else
+                drawPanel->SubTitle = PhFormatUInt64(context->Entry->Value, TRUE);
         }
         return TRUE;
     }
@@ -25,6 +25,9 @@
 PPH_LIST PerfCounterList = NULL;
 PPH_OBJECT_TYPE PerfCounterEntryType = NULL;
 PH_QUEUED_LOCK PerfCounterListLock = PH_QUEUED_LOCK_INIT;
+PPH_LIST PerfQueryList = NULL;
+PH_QUEUED_LOCK PerfQueryListLock = PH_QUEUED_LOCK_INIT;
+HANDLE PerfMonSamplerStopEvent = NULL;
 
 PPH_PLUGIN PluginInstance;
 PH_CALLBACK_REGISTRATION PluginLoadCallbackRegistration;
@@ -48,6 +51,7 @@ VOID NTAPI LoadCallback(
 {
     PerfMonInitialize();
     PerfMonLoadList();
+    PerfMonStartSampler();
 }
 
 VOID NTAPI UnloadCallback(
@@ -55,7 +59,7 @@ VOID NTAPI UnloadCallback(
     _In_opt_ PVOID Context
     )
 {
-    NOTHING;
+    PerfMonStopSampler();
 }
 
 VOID NTAPI ShowOptionsCallback(
@@ -110,7 +114,9 @@ LOGICAL DllMain(
             PPH_PLUGIN_INFORMATION info;
             PH_SETTING_CREATE settings[] =
             {
-                { StringSettingType, SETTING_NAME_PERFMON_LIST, L"" }
+                { StringSettingType, SETTING_NAME_PERFMON_LIST, L"" },
+                { IntegerSettingType, SETTING_NAME_PERFMON_TOP_INSTANCES, L"5" },
+                { IntegerSettingType, SETTING_NAME_PERFMON_SAMPLE_INTERVAL, L"3e8" } // 1000 ms
             };
 
             PluginInstance = PhRegisterPlugin(PLUGIN_NAME, Instance, &info);
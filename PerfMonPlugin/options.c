@@ -218,57 +218,21 @@ VOID PerfMonShowCounters(
 
         if (PhFindCharInString(counterPathString, 0, '*') != -1) // Check for wildcards
         {
-            PPH_STRING counterWildCardString;
             ULONG wildCardLength = 0;
 
-            PdhExpandWildCardPath(
-                NULL,
-                PhGetString(counterPathString),
-                NULL,
-                &wildCardLength,
-                0
-                );
-
-            counterWildCardString = PhCreateStringEx(NULL, wildCardLength * sizeof(WCHAR));
-
+            // Wildcard paths are added as a single counter; the instances are collected
+            // together each tick. Only check that the path currently expands to something.
             if (PdhExpandWildCardPath(
                 NULL,
                 PhGetString(counterPathString),
-                PhGetString(counterWildCardString),
+                NULL,
                 &wildCardLength,
                 0
-                ) == ERROR_SUCCESS)
+                ) != PDH_MORE_DATA)
             {
-                PH_STRINGREF part;
-                PH_STRINGREF remaining;
-
-                remaining = counterWildCardString->sr;
-
-                while (remaining.Length != 0)
-                {
-                    PPH_STRING counterPart;
-
-                    if (!PhSplitStringRefAtChar(&remaining, L'\0', &part, &remaining))
-                        break;
-                    if (remaining.Length == 0)
-                        break;
-
-                    counterPart = PhCreateString2(&part);
-
-                    if (PdhValidatePath(PhGetString(counterPart)) != ERROR_SUCCESS)
-                    {
-                        PhDereferenceObject(counterPart);
-                        PhDereferenceObject(counterWildCardString);
-                        PhDereferenceObject(counterPathString);
-                        continue;
-                    }
-
-                    PerfMonAddCounter(Context, counterPart);
-                    PhDereferenceObject(counterPart);
-                }
+                PhDereferenceObject(counterPathString);
+                continue;
             }
-
-            PhDereferenceObject(counterWildCardString);
         }
         else
         {
@@ -277,10 +241,9 @@ VOID PerfMonShowCounters(
                 PhDereferenceObject(counterPathString);
                 continue;
             }
-
-            PerfMonAddCounter(Context, counterPathString);
         }
 
+        PerfMonAddCounter(Context, counterPathString);
         PhDereferenceObject(counterPathString);
     }
 }
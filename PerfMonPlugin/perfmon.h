@@ -25,6 +25,8 @@
 
 #define PLUGIN_NAME L"dmex.PerfMonPlugin"
 #define SETTING_NAME_PERFMON_LIST (PLUGIN_NAME L".PerfMonList")
+#define SETTING_NAME_PERFMON_TOP_INSTANCES (PLUGIN_NAME L".TopInstanceCount")
+#define SETTING_NAME_PERFMON_SAMPLE_INTERVAL (PLUGIN_NAME L".SampleInterval")
 
 #define CINTERFACE
 #define COBJMACROS
@@ -35,21 +37,77 @@
 #include <pdhmsg.h>
 
 #include "resource.h"
+#include "../common/history.h"
 
 extern PPH_PLUGIN PluginInstance;
 extern PPH_LIST PerfCounterList;
 extern PPH_OBJECT_TYPE PerfCounterEntryType;
 extern PH_QUEUED_LOCK PerfCounterListLock;
+extern PPH_LIST PerfQueryList;
+extern PH_QUEUED_LOCK PerfQueryListLock;
+extern HANDLE PerfMonSamplerStopEvent;
+
+#define PERF_SAMPLE_MINIMUM_INTERVAL 100 // ms
+#define PERF_SAMPLE_RING_SIZE 256 // must be a power of two
 
 typedef struct _PERF_COUNTER_ID
 {
     PPH_STRING PerfCounterPath;
 } PERF_COUNTER_ID, *PPERF_COUNTER_ID;
 
+// One PDH query is shared by all counters on the same machine so a single
+// PdhCollectQueryData call refreshes all of them.
+typedef struct _PERF_QUERY_ENTRY
+{
+    PPH_STRING MachineName; // empty for the local machine
+    HQUERY QueryHandle;
+    ULONG ReferenceCount; // counters using the query, plus the sampler while it collects
+} PERF_QUERY_ENTRY, *PPERF_QUERY_ENTRY;
+
+typedef struct _PERF_COUNTER_INSTANCE
+{
+    PH_STRINGREF Key; // points into Name
+    PPH_STRING Name;
+    ULONG Column;
+    ULONG LastUpdate;
+    ULONG64 Value;
+    ULONG64 SampleSum;
+    ULONG SampleCount;
+} PERF_COUNTER_INSTANCE, *PPERF_COUNTER_INSTANCE;
+
+// History for the instances of a wildcard counter. Each instance owns a column of
+// SampleCount values and all columns share the same ring position, so one tick
+// writes a single row.
+typedef struct _PERF_INSTANCE_HISTORY
+{
+    ULONG SampleCount;
+    ULONG Count;
+    ULONG Index;
+    ULONG ColumnCount;
+    ULONG ColumnCapacity;
+    PULONG64 Data;
+    PPH_LIST FreeColumns;
+} PERF_INSTANCE_HISTORY, *PPERF_INSTANCE_HISTORY;
+
+typedef struct _PERF_SAMPLE
+{
+    LARGE_INTEGER Time;
+    ULONG64 Value;
+} PERF_SAMPLE, *PPERF_SAMPLE;
+
+// Samples written by the sampler thread. There is a single writer, and readers
+// never take a lock; WriteCount is always accessed with ReadAcquire64 and
+// WriteRelease64. See PerfMonReadSample.
+typedef struct _PERF_SAMPLE_RING
+{
+    volatile LONG64 WriteCount;
+    PERF_SAMPLE Samples[PERF_SAMPLE_RING_SIZE];
+} PERF_SAMPLE_RING, *PPERF_SAMPLE_RING;
+
 typedef struct _PERF_COUNTER_ENTRY
 {
     PERF_COUNTER_ID Id;
-    HQUERY PerfQueryHandle;
+    PPERF_QUERY_ENTRY Query;
     HCOUNTER PerfCounterHandle;
 
     union
@@ -58,13 +116,27 @@ typedef struct _PERF_COUNTER_ENTRY
         struct
         {
             BOOLEAN UserReference : 1;
-            BOOLEAN HaveFirstSample : 1;
-            BOOLEAN Spare : 6;
+            BOOLEAN CounterAddFailed : 1;
+            BOOLEAN Wildcard : 1;
+            BOOLEAN Spare : 5;
         };
     };
 
-    PH_UINT64_DELTA HistoryDelta;
+    PERF_SAMPLE_RING SampleRing;
+    LONG64 DisplaySequence;
+
+    ULONG64 Value; // mean over the last display tick; sum of all instances for wildcard counters
     PH_CIRCULAR_BUFFER_ULONG64 HistoryBuffer;
+    HISTORY_STORE LongHistory; // HistoryBuffer rolled up for zoomed out graphs
+
+    // Wildcard counters only. InstanceLock protects the instances and their history.
+    PH_QUEUED_LOCK InstanceLock;
+    PPH_HASHTABLE InstanceHashtable;
+    PPH_LIST InstanceList;
+    PERF_INSTANCE_HISTORY InstanceHistory;
+    PH_CIRCULAR_BUFFER_ULONG64 MaxHistoryBuffer;
+    PPDH_FMT_COUNTERVALUE_ITEM ItemBuffer; // sampler thread only; not protected by InstanceLock
+    ULONG ItemBufferSize;
 } PERF_COUNTER_ENTRY, *PPERF_COUNTER_ENTRY;
 
 VOID PerfMonInitialize(
@@ -75,6 +147,19 @@ VOID PerfMonUpdate(
     VOID
     );
 
+VOID PerfMonStartSampler(
+    VOID
+    );
+
+VOID PerfMonStopSampler(
+    VOID
+    );
+
+BOOLEAN PerfMonGetLatestSample(
+    _In_ PPERF_COUNTER_ENTRY Entry,
+    _Out_ PPERF_SAMPLE Sample
+    );
+
 VOID InitializePerfCounterId(
     _Out_ PPERF_COUNTER_ID Id,
     _In_ PPH_STRING PerfCounterPath
@@ -98,6 +183,20 @@ PPERF_COUNTER_ENTRY CreatePerfCounterEntry(
     _In_ PPERF_COUNTER_ID Id
     );
 
+ULONG64 PerfMonGetInstanceHistoryValue(
+    _In_ PPERF_INSTANCE_HISTORY History,
+    _In_ ULONG Column,
+    _In_ ULONG Index
+    );
+
+ULONG PerfMonQueryTopInstances(
+    _In_ PPERF_COUNTER_ENTRY Entry,
+    _In_ ULONG Index,
+    _In_ ULONG Count,
+    _Out_writes_(Count) PPERF_COUNTER_INSTANCE *Instances,
+    _Out_writes_(Count) PULONG64 Values
+    );
+
 VOID PerfMonLoadList(
     VOID
     );
@@ -130,6 +229,11 @@ typedef struct _PH_PERFMON_SYSINFO_CONTEXT
     PH_LAYOUT_MANAGER LayoutManager;
     PH_CALLBACK_REGISTRATION ProcessesUpdatedRegistration;
 
+    // Zoomed out view, queried from LongHistory. A span of zero shows HistoryBuffer.
+    ULONG64 HistorySpan;
+    ULONG64 HistoryEndTime;
+    ULONG HistoryPointCount;
+    PHISTORY_BUCKET HistoryPoints;
 } PH_PERFMON_SYSINFO_CONTEXT, *PPH_PERFMON_SYSINFO_CONTEXT;
 
 #define ITEM_CHECKED (INDEXTOSTATEIMAGEMASK(2))
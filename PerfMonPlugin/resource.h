@@ -9,6 +9,7 @@
 #define IDC_ADD_BUTTON                  1024
 #define IDC_REMOVE_BUTTON               1025
 #define IDC_COUNTERNAME                 1026
+#define IDC_TOPINSTANCES                1027
 
 // Next default values for new objects
 // 
@@ -16,7 +17,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        115
 #define _APS_NEXT_COMMAND_VALUE         40006
-#define _APS_NEXT_CONTROL_VALUE         1027
+#define _APS_NEXT_CONTROL_VALUE         1028
 #define _APS_NEXT_SYMED_VALUE           108
 #endif
 #endif
@@ -0,0 +1,231 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   NT Product Policy Plugin
+ *
+ * Copyright (C) 2017 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Fuzz harness for the policy blob parser. It is not part of the plugin build.
+//
+// libFuzzer:
+//   clang -g -O1 -fsanitize=fuzzer,address,undefined -I.. polblob_fuzz.c ../polblob.c -o polblob_fuzz
+//   ./polblob_fuzz corpus/
+//
+// Compilers without libFuzzer (define POLBLOB_FUZZ_STANDALONE); runs random and
+// generated inputs:
+//   gcc -g -O1 -fsanitize=address,undefined -DPOLBLOB_FUZZ_STANDALONE -I.. polblob_fuzz.c ../polblob.c -o polblob_fuzz
+//   ./polblob_fuzz [iterations]
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "polblob.h"
+
+typedef struct _FUZZ_CONTEXT
+{
+    const uint8_t *Blob;
+    size_t Length;
+    size_t Count;
+    uint8_t Last;
+} FUZZ_CONTEXT;
+
+static void FuzzEntryCallback(
+    void *Context,
+    size_t Index,
+    const POLICY_BLOB_ENTRY *Entry
+    )
+{
+    FUZZ_CONTEXT *context = Context;
+
+    if (Index != context->Count)
+        abort();
+    if (Entry->Name < context->Blob || Entry->NameLength > (size_t)(context->Blob + context->Length - Entry->Name))
+        abort();
+    if (Entry->Data < context->Blob || Entry->DataLength > (size_t)(context->Blob + context->Length - Entry->Data))
+        abort();
+
+    // Touch the name and data so the sanitizers check every byte the plugin would read.
+    for (size_t i = 0; i < Entry->NameLength; i++)
+        context->Last ^= Entry->Name[i];
+    for (size_t i = 0; i < Entry->DataLength; i++)
+        context->Last ^= Entry->Data[i];
+
+    context->Count++;
+}
+
+int LLVMFuzzerTestOneInput(
+    const uint8_t *Data,
+    size_t Size
+    )
+{
+    FUZZ_CONTEXT context = { 0 };
+    size_t count;
+    size_t count2;
+    uint8_t *copy;
+
+    // Use an exact-size heap copy so that reads past the end are caught.
+    if (!(copy = malloc(Size ? Size : 1)))
+        return 0;
+
+    memcpy(copy, Data, Size);
+
+    context.Blob = copy;
+    context.Length = Size;
+
+    if (PolicyParseBlob(copy, Size, NULL, NULL, &count))
+    {
+        // The plugin sizes its entry array from the first pass.
+        if (!PolicyParseBlob(copy, Size, FuzzEntryCallback, &context, &count2) || count2 != count || context.Count != count)
+            abort();
+    }
+    else
+    {
+        PolicyParseBlob(copy, Size, FuzzEntryCallback, &context, &count2);
+    }
+
+    free(copy);
+
+    return 0;
+}
+
+#ifdef POLBLOB_FUZZ_STANDALONE
+
+#include <stdio.h>
+
+static uint64_t FuzzRandomState = 0x9e3779b97f4a7c15;
+
+static uint32_t FuzzRandom(
+    void
+    )
+{
+    FuzzRandomState ^= FuzzRandomState << 13;
+    FuzzRandomState ^= FuzzRandomState >> 7;
+    FuzzRandomState ^= FuzzRandomState << 17;
+
+    return (uint32_t)FuzzRandomState;
+}
+
+static void FuzzWrite16(
+    uint8_t *Buffer,
+    size_t Value
+    )
+{
+    Buffer[0] = (uint8_t)Value;
+    Buffer[1] = (uint8_t)(Value >> 8);
+}
+
+static void FuzzWrite32(
+    uint8_t *Buffer,
+    size_t Value
+    )
+{
+    FuzzWrite16(Buffer, Value);
+    FuzzWrite16(Buffer + 2, Value >> 16);
+}
+
+// Builds a well formed blob so that the entry loop is reached, then damages it.
+static size_t FuzzGenerate(
+    uint8_t *Buffer,
+    size_t Size
+    )
+{
+    size_t offset = 20;
+
+    if (Size < 24)
+        return 0;
+
+    while (FuzzRandom() % 16)
+    {
+        size_t nameLength = (FuzzRandom() % 32) * 2;
+        size_t dataLength = FuzzRandom() % 32;
+        size_t entryLength = 16 + nameLength + dataLength + FuzzRandom() % 4;
+
+        if (offset + entryLength + 4 > Size)
+            break;
+
+        FuzzWrite16(Buffer + offset, entryLength);
+        FuzzWrite16(Buffer + offset + 2, nameLength);
+        FuzzWrite16(Buffer + offset + 4, FuzzRandom() % 5);
+        FuzzWrite16(Buffer + offset + 6, dataLength);
+        FuzzWrite32(Buffer + offset + 8, FuzzRandom());
+        FuzzWrite32(Buffer + offset + 12, 0);
+
+        for (size_t i = 16; i < entryLength; i++)
+            Buffer[offset + i] = (uint8_t)FuzzRandom();
+
+        offset += entryLength;
+    }
+
+    FuzzWrite32(Buffer + offset, 0x45);
+    offset += 4;
+
+    FuzzWrite32(Buffer, offset);
+    FuzzWrite32(Buffer + 4, offset - 24);
+    FuzzWrite32(Buffer + 8, 4);
+    FuzzWrite32(Buffer + 12, 0);
+    FuzzWrite32(Buffer + 16, 1);
+
+    // Flip a few bytes, including the size fields.
+    for (uint32_t i = FuzzRandom() % 4; i != 0; i--)
+        Buffer[FuzzRandom() % offset] = (uint8_t)FuzzRandom();
+
+    // Sometimes cut the blob short or leave trailing bytes.
+    if (FuzzRandom() % 8 == 0)
+        offset = FuzzRandom() % (offset + 1);
+    else if (FuzzRandom() % 8 == 0 && offset < Size)
+        offset += FuzzRandom() % (Size - offset);
+
+    return offset;
+}
+
+int main(
+    int argc,
+    char *argv[]
+    )
+{
+    static uint8_t buffer[0x2000];
+    unsigned long iterations = 1000000;
+
+    if (argc > 1)
+        iterations = strtoul(argv[1], NULL, 10);
+
+    for (unsigned long i = 0; i < iterations; i++)
+    {
+        size_t size;
+
+        if (i % 4 == 0)
+        {
+            size = FuzzRandom() % 256;
+
+            for (size_t j = 0; j < size; j++)
+                buffer[j] = (uint8_t)FuzzRandom();
+        }
+        else
+        {
+            size = FuzzGenerate(buffer, FuzzRandom() % sizeof(buffer));
+        }
+
+        LLVMFuzzerTestOneInput(buffer, size);
+    }
+
+    printf("%lu inputs\n", iterations);
+
+    return 0;
+}
+
+#endif
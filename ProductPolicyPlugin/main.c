@@ -24,65 +24,323 @@
 
 PPH_PLUGIN PluginInstance;
 HWND ListViewWndHandle;
+HWND SearchWndHandle;
 PH_LAYOUT_MANAGER LayoutManager;
 PH_CALLBACK_REGISTRATION PluginMenuItemCallbackRegistration;
 PH_CALLBACK_REGISTRATION MainMenuInitializingCallbackRegistration;
 PH_CALLBACK_REGISTRATION PluginShowOptionsCallbackRegistration;
 
-VOID LoadPolicyTable(VOID)
+PNT_POLICY_SNAPSHOT LiveSnapshot = NULL;
+PNT_POLICY_SNAPSHOT CompareSnapshot = NULL; // saved snapshot shown in compare mode
+PPH_STRING SearchText = NULL;
+PNT_POLICY_DIFF PolicyRows = NULL;
+ULONG PolicyRowCount = 0;
+ULONG SortColumn = 0;
+PH_SORT_ORDER SortOrder = AscendingSortOrder;
+
+#define BEGIN_SORT_FUNCTION(Column) static int __cdecl PolicyRowCompare##Column( \
+    _In_ void *_context, \
+    _In_ const void *_elem1, \
+    _In_ const void *_elem2 \
+    ) \
+{ \
+    PNT_POLICY_DIFF row1 = (PNT_POLICY_DIFF)_elem1; \
+    PNT_POLICY_DIFF row2 = (PNT_POLICY_DIFF)_elem2; \
+    PNT_POLICY_ENTRY entry1 = row1->NewEntry ? row1->NewEntry : row1->OldEntry; \
+    PNT_POLICY_ENTRY entry2 = row2->NewEntry ? row2->NewEntry : row2->OldEntry; \
+    int sortResult = 0;
+
+#define END_SORT_FUNCTION \
+    if (sortResult == 0) \
+        sortResult = PhCompareStringRef(&entry1->Name, &entry2->Name, TRUE); \
+    \
+    return PhModifySort(sortResult, SortOrder); \
+}
+
+#define SORT_FUNCTION(Column) PolicyRowCompare##Column
+
+static int PolicyCompareEntryValues(
+    _In_opt_ PNT_POLICY_ENTRY Entry1,
+    _In_opt_ PNT_POLICY_ENTRY Entry2
+    )
+{
+    if (!Entry1 || !Entry2)
+        return uintcmp(!!Entry1, !!Entry2);
+
+    return PhCompareString(PolicyGetEntryValue(Entry1), PolicyGetEntryValue(Entry2), TRUE);
+}
+
+BEGIN_SORT_FUNCTION(Name)
+{
+    NOTHING;
+}
+END_SORT_FUNCTION
+
+BEGIN_SORT_FUNCTION(Value)
+{
+    sortResult = PolicyCompareEntryValues(row1->NewEntry, row2->NewEntry);
+}
+END_SORT_FUNCTION
+
+BEGIN_SORT_FUNCTION(Change)
+{
+    sortResult = uintcmp(row1->Change, row2->Change);
+}
+END_SORT_FUNCTION
+
+BEGIN_SORT_FUNCTION(OldValue)
 {
-    PPH_LIST productPolicies;
+    sortResult = PolicyCompareEntryValues(row1->OldEntry, row2->OldEntry);
+}
+END_SORT_FUNCTION
 
-    ExtendedListView_SetRedraw(ListViewWndHandle, FALSE);
-    ListView_DeleteAllItems(ListViewWndHandle);
+static VOID SortPolicyRows(
+    VOID
+    )
+{
+    static PVOID sortFunctions[] =
+    {
+        SORT_FUNCTION(Name),
+        SORT_FUNCTION(Value),
+        SORT_FUNCTION(Change),
+        SORT_FUNCTION(OldValue)
+    };
+
+    // Rows are built in name order, which is the default sort.
+    if (SortColumn == 0 && SortOrder == AscendingSortOrder)
+        return;
+
+    if (SortColumn < ARRAYSIZE(sortFunctions) && PolicyRowCount != 0)
+        qsort_s(PolicyRows, PolicyRowCount, sizeof(NT_POLICY_DIFF), sortFunctions[SortColumn], NULL);
+}
 
-    if (productPolicies = QueryProductPolicies())
+static VOID AddPolicyRow(
+    _In_ PNT_POLICY_ENTRY Entry
+    )
+{
+    PolicyRows[PolicyRowCount].Change = PolicyUnchanged;
+    PolicyRows[PolicyRowCount].OldEntry = NULL;
+    PolicyRows[PolicyRowCount].NewEntry = Entry;
+    PolicyRowCount++;
+}
+
+/**
+ * Rebuilds the rows shown in the list from the live snapshot, the compare snapshot
+ * and the search text.
+ */
+VOID UpdatePolicyRows(
+    VOID
+    )
+{
+    if (PolicyRows)
     {
-        for (ULONG i = 0; i < productPolicies->Count; i++)
+        PhFree(PolicyRows);
+        PolicyRows = NULL;
+    }
+
+    PolicyRowCount = 0;
+
+    if (LiveSnapshot && CompareSnapshot)
+    {
+        ULONG count = PolicyDiffSnapshots(CompareSnapshot, LiveSnapshot, &PolicyRows);
+
+        for (ULONG i = 0; i < count; i++)
         {
-            PNT_POLICY_ENTRY entry = productPolicies->Items[i];
+            PNT_POLICY_ENTRY entry = PolicyRows[i].NewEntry ? PolicyRows[i].NewEntry : PolicyRows[i].OldEntry;
 
-            INT index = PhAddListViewItem(ListViewWndHandle, MAXINT, PhGetString(entry->Name), NULL);
-            PhSetListViewSubItem(ListViewWndHandle, index, 1, PhGetString(entry->Value));
+            if (!PhIsNullOrEmptyString(SearchText) && PhFindStringInStringRef(&entry->Name, &SearchText->sr, TRUE) == -1)
+                continue;
 
-            if (entry->Name)
-                PhDereferenceObject(entry->Name);
-            if (entry->Value)
-                PhDereferenceObject(entry->Value);
+            PolicyRows[PolicyRowCount++] = PolicyRows[i];
         }
+    }
+    else if (LiveSnapshot)
+    {
+        PolicyRows = PhAllocate(max(LiveSnapshot->Count, 1) * sizeof(NT_POLICY_DIFF));
+
+        if (PhIsNullOrEmptyString(SearchText))
+        {
+            for (ULONG i = 0; i < LiveSnapshot->Count; i++)
+                AddPolicyRow(&LiveSnapshot->Entries[i]);
+        }
+        else
+        {
+            ULONG firstIndex;
+            ULONG count;
 
-        PhDereferenceObject(productPolicies);
+            // Names that start with the text come from the index and are listed
+            // first, then names that only contain it.
+            count = PolicyFindEntriesByPrefix(LiveSnapshot, &SearchText->sr, &firstIndex);
+
+            for (ULONG i = 0; i < count; i++)
+                AddPolicyRow(&LiveSnapshot->Entries[firstIndex + i]);
+
+            for (ULONG i = 0; i < LiveSnapshot->Count; i++)
+            {
+                if (i >= firstIndex && i < firstIndex + count)
+                    continue;
+
+                if (PhFindStringInStringRef(&LiveSnapshot->Entries[i].Name, &SearchText->sr, TRUE) != -1)
+                    AddPolicyRow(&LiveSnapshot->Entries[i]);
+            }
+        }
     }
 
-    ExtendedListView_SetRedraw(ListViewWndHandle, TRUE);
+    SortPolicyRows();
+
+    ListView_SetItemCountEx(ListViewWndHandle, PolicyRowCount, 0);
+    InvalidateRect(ListViewWndHandle, NULL, FALSE);
 }
 
-PPH_STRING PhGetSelectedListViewSubItemText(
-    _In_ HWND hWnd
+VOID LoadPolicyTable(VOID)
+{
+    PNT_POLICY_SNAPSHOT oldSnapshot = LiveSnapshot;
+
+    if (!NT_SUCCESS(PolicyQueryLiveSnapshot(&LiveSnapshot)))
+        LiveSnapshot = NULL;
+
+    // Rows point into the old snapshot, so rebuild them before freeing it.
+    UpdatePolicyRows();
+
+    if (oldSnapshot)
+        PolicyFreeSnapshot(oldSnapshot);
+}
+
+VOID FreePolicyTable(VOID)
+{
+    ListView_SetItemCountEx(ListViewWndHandle, 0, 0);
+
+    if (PolicyRows)
+    {
+        PhFree(PolicyRows);
+        PolicyRows = NULL;
+    }
+
+    PolicyRowCount = 0;
+
+    if (LiveSnapshot)
+    {
+        PolicyFreeSnapshot(LiveSnapshot);
+        LiveSnapshot = NULL;
+    }
+
+    if (CompareSnapshot)
+    {
+        PolicyFreeSnapshot(CompareSnapshot);
+        CompareSnapshot = NULL;
+    }
+
+    PhClearReference(&SearchText);
+}
+
+PPH_STRING GetSelectedPolicyValueText(
+    VOID
     )
 {
-    INT index = PhFindListViewItemByFlags(
-        hWnd,
-        -1,
-        LVNI_SELECTED
-        );
+    INT index = ListView_GetNextItem(ListViewWndHandle, -1, LVNI_SELECTED);
+    PNT_POLICY_DIFF row;
+
+    if (index == -1 || (ULONG)index >= PolicyRowCount)
+        return NULL;
+
+    row = &PolicyRows[index];
+
+    if (row->OldEntry && row->NewEntry)
+    {
+        return PhFormatString(
+            L"Saved:\r\n%s\r\n\r\nCurrent:\r\n%s",
+            PolicyGetEntryValue(row->OldEntry)->Buffer,
+            PolicyGetEntryValue(row->NewEntry)->Buffer
+            );
+    }
+
+    return PhReferenceObject(PolicyGetEntryValue(row->NewEntry ? row->NewEntry : row->OldEntry));
+}
+
+VOID SavePolicySnapshot(
+    _In_ HWND hwndDlg
+    )
+{
+    static PH_FILETYPE_FILTER filters[] =
+    {
+        { L"Binary files (*.bin)", L"*.bin" },
+        { L"All files (*.*)", L"*.*" }
+    };
+    PVOID fileDialog;
+
+    if (!LiveSnapshot)
+        return;
+
+    fileDialog = PhCreateSaveFileDialog();
+
+    PhSetFileDialogFilter(fileDialog, filters, ARRAYSIZE(filters));
+    PhSetFileDialogFileName(fileDialog, L"ProductPolicy.bin");
+
+    if (PhShowFileDialog(hwndDlg, fileDialog))
+    {
+        NTSTATUS status;
+        PPH_STRING fileName;
+
+        fileName = PH_AUTO(PhGetFileDialogFileName(fileDialog));
+
+        if (!NT_SUCCESS(status = PolicySaveSnapshotToFile(LiveSnapshot, fileName->Buffer)))
+            PhShowStatus(hwndDlg, L"Unable to create the file", status, 0);
+    }
+
+    PhFreeFileDialog(fileDialog);
+}
+
+VOID ComparePolicySnapshot(
+    _In_ HWND hwndDlg
+    )
+{
+    static PH_FILETYPE_FILTER filters[] =
+    {
+        { L"Binary files (*.bin)", L"*.bin" },
+        { L"All files (*.*)", L"*.*" }
+    };
+    PVOID fileDialog;
+
+    if (CompareSnapshot)
+    {
+        PNT_POLICY_SNAPSHOT oldSnapshot = CompareSnapshot;
+
+        // Leave compare mode.
+        CompareSnapshot = NULL;
+        UpdatePolicyRows();
+        PolicyFreeSnapshot(oldSnapshot);
 
-    if (index != -1)
+        SetWindowText(GetDlgItem(hwndDlg, IDC_COMPARE), L"Compare...");
+        SetWindowText(hwndDlg, L"Product Policy");
+        return;
+    }
+
+    fileDialog = PhCreateOpenFileDialog();
+    PhSetFileDialogFilter(fileDialog, filters, ARRAYSIZE(filters));
+
+    if (PhShowFileDialog(hwndDlg, fileDialog))
     {
-        WCHAR buffer[DOS_MAX_PATH_LENGTH] = L"";
+        NTSTATUS status;
+        PPH_STRING fileName;
+        PNT_POLICY_SNAPSHOT snapshot;
 
-        LVITEM item;
-        item.mask = LVIF_TEXT;
-        item.iItem = index;
-        item.iSubItem = 1;
-        item.pszText = buffer;
-        item.cchTextMax = ARRAYSIZE(buffer);
+        fileName = PH_AUTO(PhGetFileDialogFileName(fileDialog));
 
-        if (ListView_GetItem(hWnd, &item))
-            return PhCreateString(buffer);
+        if (NT_SUCCESS(status = PolicyLoadSnapshotFromFile(fileName->Buffer, &snapshot)))
+        {
+            CompareSnapshot = snapshot;
+
+            SetWindowText(GetDlgItem(hwndDlg, IDC_COMPARE), L"End compare");
+            SetWindowText(hwndDlg, PhaFormatString(L"Product Policy - changes since %s", fileName->Buffer)->Buffer);
+            UpdatePolicyRows();
+        }
+        else
+        {
+            PhShowStatus(hwndDlg, L"Unable to load the policy snapshot", status, 0);
+        }
     }
 
-    return NULL;
+    PhFreeFileDialog(fileDialog);
 }
 
 INT_PTR CALLBACK ViewPolicyDlgProc(
@@ -144,10 +402,14 @@ INT_PTR CALLBACK MainWindowDlgProc(
         {
             PhCenterWindow(hwndDlg, PhMainWndHandle);
             ListViewWndHandle = GetDlgItem(hwndDlg, IDC_ATOMLIST);
+            SearchWndHandle = GetDlgItem(hwndDlg, IDC_SEARCH);
 
             PhInitializeLayoutManager(&LayoutManager, hwndDlg);
+            PhAddLayoutItem(&LayoutManager, SearchWndHandle, NULL, PH_ANCHOR_LEFT | PH_ANCHOR_TOP | PH_ANCHOR_RIGHT);
             PhAddLayoutItem(&LayoutManager, ListViewWndHandle, NULL, PH_ANCHOR_ALL);
             PhAddLayoutItem(&LayoutManager, GetDlgItem(hwndDlg, IDRETRY), NULL, PH_ANCHOR_BOTTOM | PH_ANCHOR_LEFT);
+            PhAddLayoutItem(&LayoutManager, GetDlgItem(hwndDlg, IDC_SAVE), NULL, PH_ANCHOR_BOTTOM | PH_ANCHOR_LEFT);
+            PhAddLayoutItem(&LayoutManager, GetDlgItem(hwndDlg, IDC_COMPARE), NULL, PH_ANCHOR_BOTTOM | PH_ANCHOR_LEFT);
             PhAddLayoutItem(&LayoutManager, GetDlgItem(hwndDlg, IDOK), NULL, PH_ANCHOR_BOTTOM | PH_ANCHOR_RIGHT);
 
             PhRegisterDialog(hwndDlg);
@@ -157,8 +419,11 @@ INT_PTR CALLBACK MainWindowDlgProc(
             PhSetControlTheme(ListViewWndHandle, L"explorer");
             PhAddListViewColumn(ListViewWndHandle, 0, 0, 0, LVCFMT_LEFT, 350, L"Name");
             PhAddListViewColumn(ListViewWndHandle, 1, 1, 1, LVCFMT_LEFT, 100, L"Value");
-            PhSetExtendedListView(ListViewWndHandle);
+            PhAddListViewColumn(ListViewWndHandle, 2, 2, 2, LVCFMT_LEFT, 70, L"Change");
+            PhAddListViewColumn(ListViewWndHandle, 3, 3, 3, LVCFMT_LEFT, 100, L"Saved value");
             PhLoadListViewColumnsFromSetting(SETTING_NAME_LISTVIEW_COLUMNS, ListViewWndHandle);
+            PhSetHeaderSortIcon(ListView_GetHeader(ListViewWndHandle), SortColumn, SortOrder);
+            Edit_SetCueBannerText(SearchWndHandle, L"Search policies");
 
             LoadPolicyTable();
         }
@@ -171,6 +436,7 @@ INT_PTR CALLBACK MainWindowDlgProc(
         PhSaveListViewColumnsToSetting(SETTING_NAME_LISTVIEW_COLUMNS, ListViewWndHandle);
         PhDeleteLayoutManager(&LayoutManager);
         PhUnregisterDialog(hwndDlg);
+        FreePolicyTable();
         break;
     case WM_COMMAND:
         {
@@ -183,6 +449,21 @@ INT_PTR CALLBACK MainWindowDlgProc(
             case IDRETRY:
                 LoadPolicyTable();
                 break;
+            case IDC_SAVE:
+                SavePolicySnapshot(hwndDlg);
+                break;
+            case IDC_COMPARE:
+                ComparePolicySnapshot(hwndDlg);
+                break;
+            case IDC_SEARCH:
+                {
+                    if (HIWORD(wParam) != EN_CHANGE)
+                        break;
+
+                    PhMoveReference(&SearchText, PhGetWindowText(SearchWndHandle));
+                    UpdatePolicyRows();
+                }
+                break;
             }
         }
         break;
@@ -196,20 +477,96 @@ INT_PTR CALLBACK MainWindowDlgProc(
                 {
                     if (hdr->hwndFrom == ListViewWndHandle)
                     {
-                        PPH_STRING subItemText = PhGetSelectedListViewSubItemText(ListViewWndHandle);
+                        PPH_STRING valueText;
+
+                        if (!(valueText = GetSelectedPolicyValueText()))
+                            break;
 
                         DialogBoxParam(
                             PluginInstance->DllBase, 
                             MAKEINTRESOURCE(IDD_POLICYVIEW), 
                             hwndDlg, 
                             ViewPolicyDlgProc, 
-                            (LPARAM)subItemText
+                            (LPARAM)valueText
                             );
 
-                        PhDereferenceObject(subItemText);
+                        PhDereferenceObject(valueText);
                     }
                 }
                 break;
+            case LVN_GETDISPINFO:
+                {
+                    NMLVDISPINFO* dispInfo = (NMLVDISPINFO*)hdr;
+                    PNT_POLICY_DIFF row;
+
+                    if ((ULONG)dispInfo->item.iItem >= PolicyRowCount)
+                        break;
+
+                    row = &PolicyRows[dispInfo->item.iItem];
+
+                    if (dispInfo->item.mask & LVIF_TEXT)
+                    {
+                        PPH_STRINGREF text = NULL;
+
+                        switch (dispInfo->item.iSubItem)
+                        {
+                        case 0:
+                            text = row->NewEntry ? &row->NewEntry->Name : &row->OldEntry->Name;
+                            break;
+                        case 1:
+                            if (row->NewEntry)
+                                text = &PolicyGetEntryValue(row->NewEntry)->sr;
+                            break;
+                        case 2:
+                            {
+                                static PH_STRINGREF changeStrings[] =
+                                {
+                                    PH_STRINGREF_INIT(L""),
+                                    PH_STRINGREF_INIT(L"Added"),
+                                    PH_STRINGREF_INIT(L"Removed"),
+                                    PH_STRINGREF_INIT(L"Changed")
+                                };
+
+                                text = &changeStrings[row->Change];
+                            }
+                            break;
+                        case 3:
+                            if (row->OldEntry)
+                                text = &PolicyGetEntryValue(row->OldEntry)->sr;
+                            break;
+                        }
+
+                        if (text)
+                        {
+                            // Names in the blob are not null terminated.
+                            wcsncpy_s(
+                                dispInfo->item.pszText,
+                                dispInfo->item.cchTextMax,
+                                text->Buffer,
+                                min(text->Length / sizeof(WCHAR), (SIZE_T)dispInfo->item.cchTextMax - 1)
+                                );
+                        }
+                    }
+                }
+                break;
+            case LVN_COLUMNCLICK:
+                {
+                    LPNMLISTVIEW listView = (LPNMLISTVIEW)hdr;
+
+                    if ((ULONG)listView->iSubItem == SortColumn)
+                    {
+                        SortOrder = SortOrder == AscendingSortOrder ? DescendingSortOrder : AscendingSortOrder;
+                    }
+                    else
+                    {
+                        SortColumn = listView->iSubItem;
+                        SortOrder = AscendingSortOrder;
+                    }
+
+                    PhSetHeaderSortIcon(ListView_GetHeader(ListViewWndHandle), SortColumn, SortOrder);
+                    UpdatePolicyRows();
+                }
+                break;
             }
         }
         break;
@@ -37,10 +37,68 @@
 
 typedef struct _NT_POLICY_ENTRY
 {
-    PPH_STRING Name;
-    PPH_STRING Value;
+    PH_STRINGREF Name; // points into the snapshot blob
+    ULONG DataType;
+    ULONG DataFlags;
+    PVOID Data; // points into the snapshot blob
+    ULONG DataLength;
+    PPH_STRING Value; // formatted on demand
 } NT_POLICY_ENTRY, *PNT_POLICY_ENTRY;
 
-PPH_LIST QueryProductPolicies(
-    VOID
+typedef struct _NT_POLICY_SNAPSHOT
+{
+    PVOID Buffer;
+    PVOID Blob;
+    ULONG BlobLength;
+    PNT_POLICY_ENTRY Entries; // sorted by name
+    ULONG Count;
+} NT_POLICY_SNAPSHOT, *PNT_POLICY_SNAPSHOT;
+
+typedef enum _NT_POLICY_CHANGE
+{
+    PolicyUnchanged,
+    PolicyAdded,
+    PolicyRemoved,
+    PolicyChanged
+} NT_POLICY_CHANGE;
+
+typedef struct _NT_POLICY_DIFF
+{
+    NT_POLICY_CHANGE Change;
+    PNT_POLICY_ENTRY OldEntry;
+    PNT_POLICY_ENTRY NewEntry;
+} NT_POLICY_DIFF, *PNT_POLICY_DIFF;
+
+NTSTATUS PolicyQueryLiveSnapshot(
+    _Out_ PNT_POLICY_SNAPSHOT *Snapshot
+    );
+
+NTSTATUS PolicyLoadSnapshotFromFile(
+    _In_ PWSTR FileName,
+    _Out_ PNT_POLICY_SNAPSHOT *Snapshot
+    );
+
+NTSTATUS PolicySaveSnapshotToFile(
+    _In_ PNT_POLICY_SNAPSHOT Snapshot,
+    _In_ PWSTR FileName
+    );
+
+VOID PolicyFreeSnapshot(
+    _In_ PNT_POLICY_SNAPSHOT Snapshot
+    );
+
+PPH_STRING PolicyGetEntryValue(
+    _Inout_ PNT_POLICY_ENTRY Entry
+    );
+
+ULONG PolicyFindEntriesByPrefix(
+    _In_ PNT_POLICY_SNAPSHOT Snapshot,
+    _In_ PPH_STRINGREF Prefix,
+    _Out_ PULONG FirstIndex
+    );
+
+ULONG PolicyDiffSnapshots(
+    _In_ PNT_POLICY_SNAPSHOT OldSnapshot,
+    _In_ PNT_POLICY_SNAPSHOT NewSnapshot,
+    _Out_ PNT_POLICY_DIFF *Differences
     );
\ No newline at end of file
@@ -0,0 +1,139 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   NT Product Policy Plugin
+ *
+ * Copyright (C) 2017 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "polblob.h"
+
+// Policy header
+// dmex: copied from https://github.com/vyvojar/poldump
+typedef struct _wind_pol_hdr
+{
+    uint32_t Size;          // Size of everything.
+    uint32_t DataLength;    // Always sz-0x18.
+    uint32_t Endpad;        // End padding. Usually 4.
+    uint32_t Tainted;       // 1 if tainted.
+    uint32_t Padding;       // Always 1
+} wind_pol_hdr;
+
+// Policy entry
+// dmex: modified based on https://github.com/vyvojar/poldump
+typedef struct _wind_pol_ent
+{
+    uint16_t Size;          // Size of whole entry.
+    uint16_t NameLength;    // Size of the following field, in bytes.
+    uint16_t DataType;      // Field type
+    uint16_t DataLength;    // Field size
+    uint32_t DataFlags;     // Field flags
+    uint32_t Padding;       // Always 0
+    uint16_t Name[1];       // WCHAR name, NOT zero terminated!
+} wind_pol_ent;
+
+#define POLICY_ENTRY_HEADER_SIZE offsetof(wind_pol_ent, Name)
+#define POLICY_END_MARKER_SIZE sizeof(uint32_t)
+#define POLICY_END_MARKER 0x45
+
+/**
+ * Walks the entries of a policy blob. Every size field is checked against the blob
+ * before it is used, and the header and entries are copied out with memcpy, so the
+ * blob does not need to be aligned.
+ *
+ * \param Blob The policy blob.
+ * \param Length The size of \a Blob in bytes.
+ * \param Callback A function called for each entry, or NULL to only count them.
+ * Entries before a malformed one are still reported, so callers that need all or
+ * nothing should count first.
+ * \param Context A value passed to \a Callback.
+ * \param Count The number of entries.
+ *
+ * \return Zero if the blob is malformed.
+ */
+int PolicyParseBlob(
+    const void *Blob,
+    size_t Length,
+    POLICY_BLOB_ENTRY_CALLBACK Callback,
+    void *Context,
+    size_t *Count
+    )
+{
+    const uint8_t *blob = Blob;
+    wind_pol_hdr header;
+    size_t offset;
+    size_t endOffset;
+    size_t count = 0;
+
+    *Count = 0;
+
+    if (Length < sizeof(wind_pol_hdr) + POLICY_END_MARKER_SIZE)
+        return 0;
+
+    memcpy(&header, blob, sizeof(wind_pol_hdr));
+
+    if (header.Size > Length || header.Size < sizeof(wind_pol_hdr) + POLICY_END_MARKER_SIZE)
+        return 0;
+    if (header.Endpad != POLICY_END_MARKER_SIZE)
+        return 0;
+    if (header.DataLength != header.Size - sizeof(wind_pol_hdr) - POLICY_END_MARKER_SIZE)
+        return 0;
+    if (blob[header.Size - POLICY_END_MARKER_SIZE] != POLICY_END_MARKER)
+        return 0;
+
+    offset = sizeof(wind_pol_hdr);
+    endOffset = offset + header.DataLength;
+
+    while (offset < endOffset)
+    {
+        wind_pol_ent entry;
+
+        if (endOffset - offset < POLICY_ENTRY_HEADER_SIZE)
+            return 0;
+
+        memcpy(&entry, blob + offset, POLICY_ENTRY_HEADER_SIZE);
+
+        if (entry.Size < POLICY_ENTRY_HEADER_SIZE || entry.Size > endOffset - offset)
+            return 0;
+        if ((size_t)entry.NameLength + entry.DataLength > entry.Size - POLICY_ENTRY_HEADER_SIZE)
+            return 0;
+        if (entry.NameLength % sizeof(uint16_t) != 0)
+            return 0;
+
+        if (Callback)
+        {
+            POLICY_BLOB_ENTRY blobEntry;
+
+            blobEntry.Name = blob + offset + POLICY_ENTRY_HEADER_SIZE;
+            blobEntry.NameLength = entry.NameLength;
+            blobEntry.DataType = entry.DataType;
+            blobEntry.DataFlags = entry.DataFlags;
+            blobEntry.Data = blob + offset + POLICY_ENTRY_HEADER_SIZE + entry.NameLength;
+            blobEntry.DataLength = entry.DataLength;
+
+            Callback(Context, count, &blobEntry);
+        }
+
+        count++;
+        offset += entry.Size;
+    }
+
+    *Count = count;
+
+    return 1;
+}
@@ -0,0 +1,58 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   NT Product Policy Plugin
+ *
+ * Copyright (C) 2017 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _POLBLOB_H
+#define _POLBLOB_H
+
+// Byte-level parsing of the ProductPolicy registry value. This unit only depends
+// on the C runtime so that it can be built and fuzzed on its own (see
+// fuzz\polblob_fuzz.c).
+
+#include <stddef.h>
+#include <stdint.h>
+
+// An entry of a policy blob. The pointers point into the blob.
+typedef struct _POLICY_BLOB_ENTRY
+{
+    const uint8_t *Name; // UTF-16, not null terminated
+    size_t NameLength; // in bytes
+    uint32_t DataType;
+    uint32_t DataFlags;
+    const uint8_t *Data;
+    size_t DataLength;
+} POLICY_BLOB_ENTRY, *PPOLICY_BLOB_ENTRY;
+
+typedef void (*POLICY_BLOB_ENTRY_CALLBACK)(
+    void *Context,
+    size_t Index,
+    const POLICY_BLOB_ENTRY *Entry
+    );
+
+int PolicyParseBlob(
+    const void *Blob,
+    size_t Length,
+    POLICY_BLOB_ENTRY_CALLBACK Callback,
+    void *Context,
+    size_t *Count
+    );
+
+#endif
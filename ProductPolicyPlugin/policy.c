@@ -21,59 +21,9 @@
  */
 
 #include "main.h"
+#include "polblob.h"
 
-// Policy header
-// dmex: copied from https://github.com/vyvojar/poldump
-typedef struct _wind_pol_hdr 
-{
-    ULONG Size; 	// Size of everything.
-    ULONG DataLength; 	// Always sz-0x18.
-    ULONG Endpad; 	// End padding. Usually 4.
-    ULONG Tainted; 	// 1 if tainted.
-    ULONG Padding; 	// Always 1
-} wind_pol_hdr;
-
-// Policy entry
-// dmex: modified based on https://github.com/vyvojar/poldump
-typedef struct _wind_pol_ent 
-{
-    USHORT Size; 	    // Size of whole entry.
-    USHORT NameLength;  // Size of the following field, in bytes.
-    USHORT DataType; 	// Field type
-    USHORT DataLength;  // Field size
-    ULONG DataFlags; 	// Field flags
-    ULONG Padding; 	    // Always 0
-    WCHAR Name[1]; 	    // WCHAR name, NOT zero terminated!
-} wind_pol_ent;
-
-// dmex: modified based on https://github.com/vyvojar/poldump
-static PPH_LIST wind_pol_unpack(_In_ PBYTE blob)
-{
-    PPH_LIST policyEntryList;
-    wind_pol_hdr* h = (PVOID)blob;
-    wind_pol_ent* e = PTR_ADD_OFFSET(h, sizeof(wind_pol_hdr));
-    PVOID endptr = PTR_ADD_OFFSET(e, h->DataLength);
-
-    if (h->Size >= USHRT_MAX)
-        return NULL;
-    if (h->Endpad != 0x4)
-        return NULL;
-    if (h->DataLength + 0x18 != h->Size)
-        return NULL;
-    if (blob[h->Size - 0x4] != 0x45)
-        return NULL;
-
-    policyEntryList = PhCreateList(0x200);
-
-    while ((PVOID)e < endptr)
-    {
-        PhAddItemList(policyEntryList, e);
-
-        e = PTR_ADD_OFFSET(e, e->Size);
-    }
-
-    return policyEntryList;
-}
+#define POLICY_MAXIMUM_FILE_SIZE (16 * 1024 * 1024)
 
 VOID QueryLicenseValue(_In_ PWSTR Name, _In_ ULONG Type)
 {
@@ -99,17 +49,106 @@ VOID QueryLicenseValue(_In_ PWSTR Name, _In_ ULONG Type)
     PhFree(buffer);
 }
 
-PPH_LIST QueryProductPolicies(VOID)
+static VOID PolicyAddEntryCallback(
+    _In_ PVOID Context,
+    _In_ size_t Index,
+    _In_ const POLICY_BLOB_ENTRY *Entry
+    )
+{
+    PNT_POLICY_ENTRY policyEntry = &((PNT_POLICY_ENTRY)Context)[Index];
+
+    policyEntry->Name.Buffer = (PWCHAR)Entry->Name;
+    policyEntry->Name.Length = Entry->NameLength;
+    policyEntry->DataType = Entry->DataType;
+    policyEntry->DataFlags = Entry->DataFlags;
+    policyEntry->Data = (PVOID)Entry->Data;
+    policyEntry->DataLength = (ULONG)Entry->DataLength;
+    policyEntry->Value = NULL;
+}
+
+static int __cdecl PolicyEntryCompareFunction(
+    _In_ const void *elem1,
+    _In_ const void *elem2
+    )
+{
+    PNT_POLICY_ENTRY entry1 = (PNT_POLICY_ENTRY)elem1;
+    PNT_POLICY_ENTRY entry2 = (PNT_POLICY_ENTRY)elem2;
+
+    return PhCompareStringRef(&entry1->Name, &entry2->Name, TRUE);
+}
+
+/**
+ * Creates a snapshot from a policy blob. The entries point into the blob; nothing
+ * is copied or formatted.
+ *
+ * \param Buffer The allocation that holds the blob. The snapshot takes ownership of
+ * it, even on failure.
+ * \param Blob The policy blob, inside \a Buffer.
+ * \param Length The size of \a Blob in bytes.
+ * \param Snapshot A variable which receives the snapshot.
+ */
+static NTSTATUS PolicyCreateSnapshot(
+    _In_ PVOID Buffer,
+    _In_reads_bytes_(Length) PVOID Blob,
+    _In_ ULONG Length,
+    _Out_ PNT_POLICY_SNAPSHOT *Snapshot
+    )
+{
+    PNT_POLICY_SNAPSHOT snapshot;
+    size_t count;
+
+    if (!PolicyParseBlob(Blob, Length, NULL, NULL, &count))
+    {
+        PhFree(Buffer);
+        return STATUS_FILE_CORRUPT_ERROR;
+    }
+
+    snapshot = PhAllocate(sizeof(NT_POLICY_SNAPSHOT));
+    memset(snapshot, 0, sizeof(NT_POLICY_SNAPSHOT));
+    snapshot->Buffer = Buffer;
+    snapshot->Blob = Blob;
+    snapshot->BlobLength = Length;
+
+    if (count != 0)
+    {
+        snapshot->Entries = PhAllocate(count * sizeof(NT_POLICY_ENTRY));
+        PolicyParseBlob(Blob, Length, PolicyAddEntryCallback, snapshot->Entries, &count);
+        snapshot->Count = (ULONG)count;
+
+        // The sorted array is the name index.
+        qsort(snapshot->Entries, snapshot->Count, sizeof(NT_POLICY_ENTRY), PolicyEntryCompareFunction);
+    }
+
+    *Snapshot = snapshot;
+
+    return STATUS_SUCCESS;
+}
+
+VOID PolicyFreeSnapshot(
+    _In_ PNT_POLICY_SNAPSHOT Snapshot
+    )
+{
+    for (ULONG i = 0; i < Snapshot->Count; i++)
+        PhClearReference(&Snapshot->Entries[i].Value);
+
+    if (Snapshot->Entries)
+        PhFree(Snapshot->Entries);
+
+    PhFree(Snapshot->Buffer);
+    PhFree(Snapshot);
+}
+
+NTSTATUS PolicyQueryLiveSnapshot(
+    _Out_ PNT_POLICY_SNAPSHOT *Snapshot
+    )
 {
     static PH_STRINGREF policyKeyName = PH_STRINGREF_INIT(L"System\\CurrentControlSet\\Control\\ProductOptions");
     static PH_STRINGREF policyValueName = PH_STRINGREF_INIT(L"ProductPolicy");
-    HANDLE keyHandle = NULL;
-    PVOID valueBuffer = NULL;
-    PKEY_VALUE_PARTIAL_INFORMATION buffer = NULL;
-    PPH_LIST policyList = NULL;
-    PPH_LIST policyEntries = NULL;
+    NTSTATUS status;
+    HANDLE keyHandle;
+    PKEY_VALUE_PARTIAL_INFORMATION buffer;
 
-    if (!NT_SUCCESS(PhOpenKey(
+    if (!NT_SUCCESS(status = PhOpenKey(
         &keyHandle,
         KEY_READ,
         PH_KEY_LOCAL_MACHINE,
@@ -117,73 +156,282 @@ PPH_LIST QueryProductPolicies(VOID)
         0
         )))
     {
-        goto CleanupExit;
+        return status;
     }
 
-    if (NT_SUCCESS(PhQueryValueKey(
+    status = PhQueryValueKey(
         keyHandle,
         &policyValueName,
         KeyValuePartialInformation,
         &buffer
-        )))
+        );
+    NtClose(keyHandle);
+
+    if (!NT_SUCCESS(status))
+        return status;
+
+    if (buffer->Type != REG_BINARY)
     {
-        if (buffer->Type == REG_BINARY && buffer->DataLength)
-        {
-            valueBuffer = PhAllocate(buffer->DataLength);
-            memset(valueBuffer, 0, buffer->DataLength);
-            memcpy(valueBuffer, buffer->Data, buffer->DataLength);
-        }
+        PhFree(buffer);
+        return STATUS_OBJECT_TYPE_MISMATCH;
     }
 
-    if (!valueBuffer)
-        goto CleanupExit;
+    // The entries point straight into the value buffer.
+    return PolicyCreateSnapshot(buffer, buffer->Data, buffer->DataLength, Snapshot);
+}
 
-    if (!(policyEntries = wind_pol_unpack(valueBuffer)))
-        goto CleanupExit;
+NTSTATUS PolicyLoadSnapshotFromFile(
+    _In_ PWSTR FileName,
+    _Out_ PNT_POLICY_SNAPSHOT *Snapshot
+    )
+{
+    NTSTATUS status;
+    HANDLE fileHandle;
+    LARGE_INTEGER fileSize;
+    IO_STATUS_BLOCK isb;
+    PVOID buffer;
 
-    policyList = PhCreateList(policyEntries->Count);
+    if (!NT_SUCCESS(status = PhCreateFileWin32(
+        &fileHandle,
+        FileName,
+        FILE_GENERIC_READ,
+        0,
+        FILE_SHARE_READ | FILE_SHARE_DELETE,
+        FILE_OPEN,
+        FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT
+        )))
+    {
+        return status;
+    }
 
-    for (ULONG i = 0; i < policyEntries->Count; i++)
+    if (!NT_SUCCESS(status = PhGetFileSize(fileHandle, &fileSize)))
     {
-        PNT_POLICY_ENTRY entry;
-        wind_pol_ent* e = policyEntries->Items[i];
+        NtClose(fileHandle);
+        return status;
+    }
 
-        //QueryLicenseValue(e->Name, e->DataType);
+    if (fileSize.QuadPart == 0 || fileSize.QuadPart > POLICY_MAXIMUM_FILE_SIZE)
+    {
+        NtClose(fileHandle);
+        return STATUS_FILE_CORRUPT_ERROR;
+    }
 
-        entry = PhAllocate(sizeof(NT_POLICY_ENTRY));
-        memset(entry, 0, sizeof(NT_POLICY_ENTRY));
+    buffer = PhAllocate((ULONG)fileSize.QuadPart);
+
+    status = NtReadFile(
+        fileHandle,
+        NULL,
+        NULL,
+        NULL,
+        &isb,
+        buffer,
+        (ULONG)fileSize.QuadPart,
+        NULL,
+        NULL
+        );
+    NtClose(fileHandle);
+
+    if (!NT_SUCCESS(status))
+    {
+        PhFree(buffer);
+        return status;
+    }
 
-        entry->Name = PhCreateStringEx(e->Name, e->NameLength);
+    return PolicyCreateSnapshot(buffer, buffer, (ULONG)isb.Information, Snapshot);
+}
 
-        switch (e->DataType)
+NTSTATUS PolicySaveSnapshotToFile(
+    _In_ PNT_POLICY_SNAPSHOT Snapshot,
+    _In_ PWSTR FileName
+    )
+{
+    NTSTATUS status;
+    PPH_FILE_STREAM fileStream;
+
+    if (NT_SUCCESS(status = PhCreateFileStream(
+        &fileStream,
+        FileName,
+        FILE_GENERIC_WRITE,
+        FILE_SHARE_READ,
+        FILE_OVERWRITE_IF,
+        0
+        )))
+    {
+        status = PhWriteFileStream(fileStream, Snapshot->Blob, Snapshot->BlobLength);
+        PhDereferenceObject(fileStream);
+    }
+
+    return status;
+}
+
+/**
+ * Formats the value of a policy entry. The string is created the first time it is
+ * needed and kept with the entry.
+ */
+PPH_STRING PolicyGetEntryValue(
+    _Inout_ PNT_POLICY_ENTRY Entry
+    )
+{
+    if (!Entry->Value)
+    {
+        switch (Entry->DataType)
         {
         case REG_DWORD:
-            entry->Value = PhFormatUInt64(*(ULONG*)PTR_ADD_OFFSET(e->Name, e->NameLength), TRUE);
+            {
+                ULONG value;
+
+                if (Entry->DataLength >= sizeof(ULONG))
+                {
+                    memcpy(&value, Entry->Data, sizeof(ULONG));
+                    Entry->Value = PhFormatUInt64(value, TRUE);
+                }
+            }
             break;
         case REG_SZ:
-            entry->Value = PhCreateStringEx((PWSTR)PTR_ADD_OFFSET(e->Name, e->NameLength), e->DataLength);
-            break;
-        case REG_BINARY:
-            entry->Value = PhBufferToHexString((PBYTE)PTR_ADD_OFFSET(e->Name, e->NameLength), e->DataLength);
+            {
+                PH_STRINGREF value;
+
+                value.Buffer = Entry->Data;
+                value.Length = Entry->DataLength & ~1;
+
+                while (value.Length != 0 && value.Buffer[value.Length / sizeof(WCHAR) - 1] == UNICODE_NULL)
+                    value.Length -= sizeof(WCHAR);
+
+                Entry->Value = PhCreateString2(&value);
+            }
             break;
         }
 
-        PhAddItemList(policyList, entry);
+        if (!Entry->Value)
+            Entry->Value = PhBufferToHexString(Entry->Data, Entry->DataLength);
     }
 
-CleanupExit:
+    return Entry->Value;
+}
 
-    if (keyHandle)
-        NtClose(keyHandle);
+/**
+ * Finds the entries whose names start with a prefix, using a binary search over the
+ * name index.
+ *
+ * \param Snapshot The snapshot.
+ * \param Prefix The prefix. The comparison is case-insensitive.
+ * \param FirstIndex A variable which receives the index of the first entry.
+ *
+ * \return The number of matching entries. They are consecutive.
+ */
+ULONG PolicyFindEntriesByPrefix(
+    _In_ PNT_POLICY_SNAPSHOT Snapshot,
+    _In_ PPH_STRINGREF Prefix,
+    _Out_ PULONG FirstIndex
+    )
+{
+    ULONG low = 0;
+    ULONG high = Snapshot->Count;
+    ULONG index;
 
-    if (valueBuffer)
-        PhFree(valueBuffer);
+    // Names with the prefix sort after everything less than the prefix, so the
+    // lower bound is the first candidate.
+    while (low < high)
+    {
+        ULONG middle = low + (high - low) / 2;
 
-    if (buffer)
-        PhFree(buffer);
+        if (PhCompareStringRef(&Snapshot->Entries[middle].Name, Prefix, TRUE) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
 
-    if (policyEntries)
-        PhDereferenceObject(policyEntries);
+    for (index = low; index < Snapshot->Count; index++)
+    {
+        if (!PhStartsWithStringRef(&Snapshot->Entries[index].Name, Prefix, TRUE))
+            break;
+    }
+
+    *FirstIndex = low;
+
+    return index - low;
+}
+
+static BOOLEAN PolicyEntryEqual(
+    _In_ PNT_POLICY_ENTRY Entry1,
+    _In_ PNT_POLICY_ENTRY Entry2
+    )
+{
+    return
+        Entry1->DataType == Entry2->DataType &&
+        Entry1->DataFlags == Entry2->DataFlags &&
+        Entry1->DataLength == Entry2->DataLength &&
+        memcmp(Entry1->Data, Entry2->Data, Entry1->DataLength) == 0;
+}
+
+/**
+ * Compares two snapshots by merging their name indexes.
+ *
+ * \param OldSnapshot The older snapshot.
+ * \param NewSnapshot The newer snapshot.
+ * \param Differences A variable which receives an array of the policies that were
+ * added, removed or changed, sorted by name. Free it with PhFree.
+ *
+ * \return The number of differences.
+ */
+ULONG PolicyDiffSnapshots(
+    _In_ PNT_POLICY_SNAPSHOT OldSnapshot,
+    _In_ PNT_POLICY_SNAPSHOT NewSnapshot,
+    _Out_ PNT_POLICY_DIFF *Differences
+    )
+{
+    PNT_POLICY_DIFF differences;
+    ULONG count = 0;
+    ULONG oldIndex = 0;
+    ULONG newIndex = 0;
 
-    return policyList;
-}
\ No newline at end of file
+    differences = PhAllocate(max(OldSnapshot->Count + NewSnapshot->Count, 1) * sizeof(NT_POLICY_DIFF));
+
+    while (oldIndex < OldSnapshot->Count || newIndex < NewSnapshot->Count)
+    {
+        PNT_POLICY_ENTRY oldEntry = oldIndex < OldSnapshot->Count ? &OldSnapshot->Entries[oldIndex] : NULL;
+        PNT_POLICY_ENTRY newEntry = newIndex < NewSnapshot->Count ? &NewSnapshot->Entries[newIndex] : NULL;
+        INT result;
+
+        if (!oldEntry)
+            result = 1;
+        else if (!newEntry)
+            result = -1;
+        else
+            result = PhCompareStringRef(&oldEntry->Name, &newEntry->Name, TRUE);
+
+        if (result < 0)
+        {
+            differences[count].Change = PolicyRemoved;
+            differences[count].OldEntry = oldEntry;
+            differences[count].NewEntry = NULL;
+            count++;
+            oldIndex++;
+        }
+        else if (result > 0)
+        {
+            differences[count].Change = PolicyAdded;
+            differences[count].OldEntry = NULL;
+            differences[count].NewEntry = newEntry;
+            count++;
+            newIndex++;
+        }
+        else
+        {
+            if (!PolicyEntryEqual(oldEntry, newEntry))
+            {
+                differences[count].Change = PolicyChanged;
+                differences[count].OldEntry = oldEntry;
+                differences[count].NewEntry = newEntry;
+                count++;
+            }
+
+            oldIndex++;
+            newIndex++;
+        }
+    }
+
+    *Differences = differences;
+
+    return count;
+}
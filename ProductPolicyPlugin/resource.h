@@ -6,6 +6,9 @@
 #define IDD_POLICYVIEW                  104
 #define IDC_ATOMLIST                    1001
 #define IDC_POLICYEDIT                  1002
+#define IDC_SEARCH                      1003
+#define IDC_SAVE                        1004
+#define IDC_COMPARE                     1005
 
 // Next default values for new objects
 // 
@@ -13,7 +16,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        106
 #define _APS_NEXT_COMMAND_VALUE         40006
-#define _APS_NEXT_CONTROL_VALUE         1003
+#define _APS_NEXT_CONTROL_VALUE         1006
 #define _APS_NEXT_SYMED_VALUE           103
 #endif
 #endif
@@ -37,13 +37,6 @@ typedef enum _TOOLS_MENU_ITEMS
     ID_SANDBOXED_RESUME
 } TOOLS_MENU_ITEMS;
 
-typedef struct _BOX_INFO
-{
-    WCHAR BoxName[34];
-    PH_STRINGREF IpcRoot;
-    WCHAR IpcRootBuffer[256];
-} BOX_INFO, *PBOX_INFO;
-
 typedef struct _BOXED_PROCESS
 {
     HANDLE ProcessId;
@@ -111,13 +104,14 @@ P_SbieApi_EnumBoxes SbieApi_EnumBoxes = NULL;
 P_SbieApi_EnumProcessEx SbieApi_EnumProcessEx = NULL;
 P_SbieDll_KillAll SbieDll_KillAll = NULL;
 
+// The map is built off-lock and swapped in under BoxedProcessesLock. Refreshes come from
+// both the timer queue and the UI thread, so RefreshLock keeps them from overlapping.
 PPH_HASHTABLE BoxedProcessesHashtable = NULL;
 PH_QUEUED_LOCK BoxedProcessesLock = PH_QUEUED_LOCK_INIT;
+PH_QUEUED_LOCK RefreshLock = PH_QUEUED_LOCK_INIT;
+PPH_LIST BoxedProcessesChanged = NULL; // PIDs whose nodes need invalidating
 BOOLEAN BoxedProcessesUpdated = FALSE;
 
-BOX_INFO BoxInfo[16] = { 0 };
-ULONG BoxInfoCount = 0;
-
 LOGICAL DllMain(
     _In_ HINSTANCE Instance,
     _In_ ULONG Reason,
@@ -212,6 +206,18 @@ ULONG NTAPI BoxedProcessesHashFunction(
     return HandleToUlong(((PBOXED_PROCESS)Entry)->ProcessId) / 4;
 }
 
+PPH_HASHTABLE CreateBoxedProcessesHashtable(
+    VOID
+    )
+{
+    return PhCreateHashtable(
+        sizeof(BOXED_PROCESS),
+        BoxedProcessesEqualFunction,
+        BoxedProcessesHashFunction,
+        32
+        );
+}
+
 VOID NTAPI LoadCallback(
     _In_opt_ PVOID Parameter,
     _In_opt_ PVOID Context
@@ -222,12 +228,8 @@ VOID NTAPI LoadCallback(
     HANDLE timerQueueHandle;
     HANDLE timerHandle;
 
-    BoxedProcessesHashtable = PhCreateHashtable(
-        sizeof(BOXED_PROCESS),
-        BoxedProcessesEqualFunction,
-        BoxedProcessesHashFunction,
-        32
-        );
+    BoxedProcessesHashtable = CreateBoxedProcessesHashtable();
+    BoxedProcessesChanged = PhCreateList(32);
 
     sbieDllPath = PhaGetStringSetting(SETTING_NAME_SBIE_DLL_PATH);
     sbieDllPath = PH_AUTO(PhExpandEnvironmentStrings(&sbieDllPath->sr));
@@ -362,29 +364,28 @@ VOID NTAPI ProcessesUpdatedCallback(
     _In_opt_ PVOID Context
     )
 {
-    PBOXED_PROCESS boxedProcess;
-    ULONG enumerationKey = 0;
+    PPH_LIST changedList;
 
     if (BoxedProcessesUpdated)
     {
-        // Invalidate the nodes of boxed processes (so they use the correct highlighting color).
+        // Invalidate the nodes of processes that entered, left or changed box (so they use the
+        // correct highlighting color).
 
-        PhAcquireQueuedLockShared(&BoxedProcessesLock);
+        PhAcquireQueuedLockExclusive(&BoxedProcessesLock);
+        changedList = BoxedProcessesChanged;
+        BoxedProcessesChanged = PhCreateList(changedList->AllocatedCount);
+        BoxedProcessesUpdated = FALSE;
+        PhReleaseQueuedLockExclusive(&BoxedProcessesLock);
 
-        if (BoxedProcessesUpdated)
+        for (ULONG i = 0; i < changedList->Count; i++)
         {
-            while (PhEnumHashtable(BoxedProcessesHashtable, &boxedProcess, &enumerationKey))
-            {
-                PPH_PROCESS_NODE processNode;
-
-                if (processNode = PhFindProcessNode(boxedProcess->ProcessId))
-                    PhUpdateProcessNode(processNode);
-            }
+            PPH_PROCESS_NODE processNode;
 
-            BoxedProcessesUpdated = FALSE;
+            if (processNode = PhFindProcessNode(changedList->Items[i]))
+                PhUpdateProcessNode(processNode);
         }
 
-        PhReleaseQueuedLockShared(&BoxedProcessesLock);
+        PhDereferenceObject(changedList);
     }
 }
 
@@ -439,35 +440,72 @@ VOID NTAPI GetProcessTooltipTextCallback(
     PhReleaseQueuedLockShared(&BoxedProcessesLock);
 }
 
+VOID DiffBoxedProcesses(
+    _In_ PPH_HASHTABLE OldHashtable,
+    _In_ PPH_HASHTABLE NewHashtable,
+    _Inout_ PPH_LIST ChangedList
+    )
+{
+    PBOXED_PROCESS boxedProcess;
+    PBOXED_PROCESS otherBoxedProcess;
+    ULONG enumerationKey;
+
+    enumerationKey = 0;
+
+    while (PhEnumHashtable(NewHashtable, &boxedProcess, &enumerationKey))
+    {
+        if (!(otherBoxedProcess = PhFindEntryHashtable(OldHashtable, boxedProcess)) ||
+            !PhEqualStringZ(otherBoxedProcess->BoxName, boxedProcess->BoxName, FALSE))
+        {
+            PhAddItemList(ChangedList, boxedProcess->ProcessId);
+        }
+    }
+
+    enumerationKey = 0;
+
+    while (PhEnumHashtable(OldHashtable, &boxedProcess, &enumerationKey))
+    {
+        if (!PhFindEntryHashtable(NewHashtable, boxedProcess))
+            PhAddItemList(ChangedList, boxedProcess->ProcessId);
+    }
+}
+
 VOID NTAPI RefreshSandboxieInfo(
     _In_opt_ PVOID Context,
     _In_ BOOLEAN TimerOrWaitFired
     )
 {
+    P_SbieApi_EnumBoxes sbieApi_EnumBoxes = SbieApi_EnumBoxes;
+    P_SbieApi_EnumProcessEx sbieApi_EnumProcessEx = SbieApi_EnumProcessEx;
     LONG index;
     WCHAR boxName[34];
-    ULONG pids[512];
-    PBOX_INFO boxInfo;
+    PULONG pids;
+    PPH_HASHTABLE newHashtable;
+    PPH_HASHTABLE oldHashtable;
+    PPH_LIST changedList;
 
-    if (!SbieApi_QueryBoxPath || !SbieApi_EnumBoxes || !SbieApi_EnumProcessEx)
+    if (!sbieApi_EnumBoxes || !sbieApi_EnumProcessEx)
         return;
 
-    PhAcquireQueuedLockExclusive(&BoxedProcessesLock);
+    // Only one refresh runs at a time; each one owns the map it swaps out until the diff is done.
+    PhAcquireQueuedLockExclusive(&RefreshLock);
 
-    PhClearHashtable(BoxedProcessesHashtable);
+    // Query everything without holding BoxedProcessesLock, so highlighting and tooltips never
+    // wait on Sandboxie.
 
-    BoxInfoCount = 0;
+    newHashtable = CreateBoxedProcessesHashtable();
+    pids = PhAllocate(SBIE_MAX_BOXED_PIDS * sizeof(ULONG));
 
     index = -1;
 
-    while ((index = SbieApi_EnumBoxes(index, boxName)) != -1)
+    while ((index = sbieApi_EnumBoxes(index, boxName)) != -1)
     {
-        if (SbieApi_EnumProcessEx(boxName, TRUE, 0, pids) == 0)
+        if (sbieApi_EnumProcessEx(boxName, TRUE, 0, pids) == 0)
         {
             ULONG count;
             PULONG pid;
 
-            count = pids[0];
+            count = min(pids[0], SBIE_MAX_BOXED_PIDS - 1);
             pid = &pids[1];
 
             while (count != 0)
@@ -477,64 +515,46 @@ VOID NTAPI RefreshSandboxieInfo(
                 boxedProcess.ProcessId = UlongToHandle(*pid);
                 memcpy(boxedProcess.BoxName, boxName, sizeof(boxName));
 
-                PhAddEntryHashtable(BoxedProcessesHashtable, &boxedProcess);
+                PhAddEntryHashtable(newHashtable, &boxedProcess);
 
                 count--;
                 pid++;
             }
         }
+    }
 
-        if (BoxInfoCount < 16)
-        {
-            ULONG filePathLength = 0;
-            ULONG keyPathLength = 0;
-            ULONG ipcPathLength = 0;
+    PhFree(pids);
 
-            boxInfo = &BoxInfo[BoxInfoCount++];
-            memcpy(boxInfo->BoxName, boxName, sizeof(boxName));
+    changedList = PhCreateList(16);
 
-            SbieApi_QueryBoxPath(
-                boxName,
-                NULL,
-                NULL,
-                NULL,
-                &filePathLength,
-                &keyPathLength,
-                &ipcPathLength
-                );
+    PhAcquireQueuedLockExclusive(&BoxedProcessesLock);
 
-            if (ipcPathLength < sizeof(boxInfo->IpcRootBuffer))
-            {
-                boxInfo->IpcRootBuffer[0] = 0;
-                SbieApi_QueryBoxPath(
-                    boxName,
-                    NULL,
-                    NULL,
-                    boxInfo->IpcRootBuffer,
-                    NULL,
-                    NULL,
-                    &ipcPathLength
-                    );
-
-                if (boxInfo->IpcRootBuffer[0] != 0)
-                {
-                    PhInitializeStringRef(&boxInfo->IpcRoot, boxInfo->IpcRootBuffer);
-                }
-                else
-                {
-                    BoxInfoCount--;
-                }
-            }
-            else
-            {
-                BoxInfoCount--;
-            }
-        }
+    oldHashtable = BoxedProcessesHashtable;
+    BoxedProcessesHashtable = newHashtable;
+
+    PhReleaseQueuedLockExclusive(&BoxedProcessesLock);
+
+    // The old map is ours now, and no other refresh can replace the new one while RefreshLock
+    // is held, so the diff can be done without BoxedProcessesLock as well.
+    DiffBoxedProcesses(oldHashtable, newHashtable, changedList);
+
+    PhDereferenceObject(oldHashtable);
+
+    if (changedList->Count != 0)
+    {
+        PhAcquireQueuedLockExclusive(&BoxedProcessesLock);
+
+        for (ULONG i = 0; i < changedList->Count; i++)
+            PhAddItemList(BoxedProcessesChanged, changedList->Items[i]);
+
+        BoxedProcessesUpdated = TRUE;
+
+        PhReleaseQueuedLockExclusive(&BoxedProcessesLock);
     }
 
-    BoxedProcessesUpdated = TRUE;
+    PhDereferenceObject(changedList);
 
-    PhReleaseQueuedLockExclusive(&BoxedProcessesLock);
+    PhReleaseQueuedLockExclusive(&RefreshLock);
 }
 
 VOID NTAPI ReloadSandboxieLibrary(
@@ -23,6 +23,9 @@ typedef LONG (__stdcall *P_SbieApi_EnumProcessEx)(
     ULONG which_session,
     ULONG *boxed_pids);         // pointer to ULONG [512]
 
+// boxed_pids[0] is the count, followed by at most 511 process IDs.
+#define SBIE_MAX_BOXED_PIDS 512
+
 typedef BOOLEAN (__stdcall *P_SbieDll_KillAll)(
     ULONG session_id,
     const WCHAR *box_name);
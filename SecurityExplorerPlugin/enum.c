@@ -0,0 +1,926 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   LSA Security Explorer Plugin
+ *
+ * Copyright (C) 2013 wj32
+ * Copyright (C) 2015-2016 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "explorer.h"
+
+// Rows posted to the window at a time while an enumeration is running.
+#define SX_ENUM_BATCH_SIZE 256
+// SIDs passed to a single LsaLookupSids call.
+#define SX_LOOKUP_CHUNK_SIZE 1000
+// Preferred size of a SAM enumeration page.
+#define SX_SAM_ENUM_LENGTH 0x10000
+
+typedef struct _SX_SID_NAME_ENTRY
+{
+    PSID Sid;
+    PPH_STRING Name; // NULL if the SID could not be mapped
+} SX_SID_NAME_ENTRY, *PSX_SID_NAME_ENTRY;
+
+typedef struct _SX_ENUM_CONTEXT
+{
+    SX_ENUM_TYPE Type;
+    PCANCEL_CONTEXT CancelContext;
+    ULONG Generation;
+    PSX_ENUM_BATCH Batch;
+} SX_ENUM_CONTEXT, *PSX_ENUM_CONTEXT;
+
+static PH_STRINGREF DomainSeparator = PH_STRINGREF_INIT(L"\\");
+static PPH_HASHTABLE SidNameCache = NULL;
+static PH_QUEUED_LOCK SidNameCacheLock = PH_QUEUED_LOCK_INIT;
+
+static BOOLEAN NTAPI SxpSidNameEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    return RtlEqualSid(((PSX_SID_NAME_ENTRY)Entry1)->Sid, ((PSX_SID_NAME_ENTRY)Entry2)->Sid);
+}
+
+static ULONG NTAPI SxpSidNameHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    PSID sid = ((PSX_SID_NAME_ENTRY)Entry)->Sid;
+
+    return PhHashBytes(sid, RtlLengthSid(sid));
+}
+
+static PPH_HASHTABLE SxpCreateSidNameHashtable(
+    _In_ ULONG InitialCapacity
+    )
+{
+    return PhCreateHashtable(
+        sizeof(SX_SID_NAME_ENTRY),
+        SxpSidNameEqualFunction,
+        SxpSidNameHashFunction,
+        InitialCapacity
+        );
+}
+
+static VOID SxpAddSidNameCacheEntry(
+    _In_ PSID Sid,
+    _In_opt_ PPH_STRING Name
+    )
+{
+    SX_SID_NAME_ENTRY entry;
+
+    PhAcquireQueuedLockExclusive(&SidNameCacheLock);
+
+    if (!SidNameCache)
+        SidNameCache = SxpCreateSidNameHashtable(64);
+
+    entry.Sid = Sid;
+
+    if (!PhFindEntryHashtable(SidNameCache, &entry))
+    {
+        entry.Sid = PhAllocateCopy(Sid, RtlLengthSid(Sid));
+        entry.Name = Name;
+
+        if (Name)
+            PhReferenceObject(Name);
+
+        PhAddEntryHashtable(SidNameCache, &entry);
+    }
+
+    PhReleaseQueuedLockExclusive(&SidNameCacheLock);
+}
+
+/**
+ * Empties the SID to name cache. Called when the explorer is opened so that
+ * renamed accounts are picked up.
+ */
+VOID SxClearSidNameCache(
+    VOID
+    )
+{
+    PSX_SID_NAME_ENTRY entry;
+    ULONG enumerationKey = 0;
+
+    PhAcquireQueuedLockExclusive(&SidNameCacheLock);
+
+    if (SidNameCache)
+    {
+        while (PhEnumHashtable(SidNameCache, &entry, &enumerationKey))
+        {
+            PhFree(entry->Sid);
+            PhClearReference(&entry->Name);
+        }
+
+        PhDereferenceObject(SidNameCache);
+        SidNameCache = NULL;
+    }
+
+    PhReleaseQueuedLockExclusive(&SidNameCacheLock);
+}
+
+static PPH_STRING SxpFormatSidFullName(
+    _In_ PLSA_REFERENCED_DOMAIN_LIST Domains,
+    _In_ PLSA_TRANSLATED_NAME Name
+    )
+{
+    PH_STRINGREF domainName;
+    PH_STRINGREF userName;
+
+    if (Name->Use == SidTypeInvalid || Name->Use == SidTypeUnknown)
+        return NULL;
+
+    PhInitializeEmptyStringRef(&domainName);
+    PhUnicodeStringToStringRef(&Name->Name, &userName);
+
+    if (Domains && Name->DomainIndex >= 0 && (ULONG)Name->DomainIndex < Domains->Entries)
+        PhUnicodeStringToStringRef(&Domains->Domains[Name->DomainIndex].Name, &domainName);
+
+    // Same format as PhGetSidFullName.
+    if (domainName.Length != 0 && userName.Length != 0)
+        return PhConcatStringRef3(&domainName, &DomainSeparator, &userName);
+    else if (domainName.Length != 0)
+        return PhCreateString2(&domainName);
+    else if (userName.Length != 0)
+        return PhCreateString2(&userName);
+    else
+        return NULL;
+}
+
+/**
+ * Resolves the names of any of the given SIDs that are not cached yet. Misses
+ * are looked up in batches with LsaLookupSids instead of one call per SID.
+ */
+VOID SxLookupSidFullNames(
+    _In_reads_(Count) PSID *Sids,
+    _In_ ULONG Count
+    )
+{
+    PPH_HASHTABLE missHashtable;
+    PSX_SID_NAME_ENTRY entry;
+    SX_SID_NAME_ENTRY lookupEntry;
+    PSID *missSids;
+    ULONG missCount;
+    ULONG enumerationKey;
+    LSA_HANDLE policyHandle;
+
+    missHashtable = SxpCreateSidNameHashtable(max(Count, 1));
+
+    PhAcquireQueuedLockShared(&SidNameCacheLock);
+
+    for (ULONG i = 0; i < Count; i++)
+    {
+        if (!Sids[i] || !RtlValidSid(Sids[i]))
+            continue;
+
+        lookupEntry.Sid = Sids[i];
+        lookupEntry.Name = NULL;
+
+        if (!SidNameCache || !PhFindEntryHashtable(SidNameCache, &lookupEntry))
+            PhAddEntryHashtable(missHashtable, &lookupEntry);
+    }
+
+    PhReleaseQueuedLockShared(&SidNameCacheLock);
+
+    if (missHashtable->Count == 0)
+    {
+        PhDereferenceObject(missHashtable);
+        return;
+    }
+
+    missSids = PhAllocate(missHashtable->Count * sizeof(PSID));
+    missCount = 0;
+    enumerationKey = 0;
+
+    while (PhEnumHashtable(missHashtable, &entry, &enumerationKey))
+        missSids[missCount++] = entry->Sid;
+
+    PhDereferenceObject(missHashtable);
+
+    if (NT_SUCCESS(PhOpenLsaPolicy(&policyHandle, POLICY_LOOKUP_NAMES, NULL)))
+    {
+        for (ULONG offset = 0; offset < missCount; offset += SX_LOOKUP_CHUNK_SIZE)
+        {
+            ULONG chunkCount = min(missCount - offset, SX_LOOKUP_CHUNK_SIZE);
+            NTSTATUS status;
+            PLSA_REFERENCED_DOMAIN_LIST referencedDomains = NULL;
+            PLSA_TRANSLATED_NAME names = NULL;
+
+            status = LsaLookupSids(
+                policyHandle,
+                chunkCount,
+                &missSids[offset],
+                &referencedDomains,
+                &names
+                );
+
+            for (ULONG i = 0; i < chunkCount; i++)
+            {
+                PPH_STRING name = NULL;
+
+                if (NT_SUCCESS(status) && names)
+                    name = SxpFormatSidFullName(referencedDomains, &names[i]);
+
+                // Unmapped SIDs are cached as well so they are not looked up again.
+                SxpAddSidNameCacheEntry(missSids[offset + i], name);
+                PhClearReference(&name);
+            }
+
+            if (referencedDomains)
+                LsaFreeMemory(referencedDomains);
+            if (names)
+                LsaFreeMemory(names);
+        }
+
+        LsaClose(policyHandle);
+    }
+
+    PhFree(missSids);
+}
+
+/**
+ * Gets the full name of a SID through the shared cache.
+ *
+ * \return A referenced string, or NULL if the SID could not be mapped.
+ */
+PPH_STRING SxGetSidFullName(
+    _In_ PSID Sid
+    )
+{
+    SX_SID_NAME_ENTRY lookupEntry;
+    PSX_SID_NAME_ENTRY entry;
+    PPH_STRING name = NULL;
+    BOOLEAN found = FALSE;
+
+    lookupEntry.Sid = Sid;
+
+    for (ULONG attempt = 0; attempt < 2 && !found; attempt++)
+    {
+        if (attempt != 0)
+            SxLookupSidFullNames(&Sid, 1);
+
+        PhAcquireQueuedLockShared(&SidNameCacheLock);
+
+        if (SidNameCache && (entry = PhFindEntryHashtable(SidNameCache, &lookupEntry)))
+        {
+            PhSetReference(&name, entry->Name);
+            found = TRUE;
+        }
+
+        PhReleaseQueuedLockShared(&SidNameCacheLock);
+    }
+
+    return name;
+}
+
+static PSX_ROW SxpCreateRow(
+    _In_opt_ PSID Sid,
+    _In_ ULONG RelativeId
+    )
+{
+    PSX_ROW row;
+
+    row = PhAllocate(sizeof(SX_ROW));
+    memset(row, 0, sizeof(SX_ROW));
+
+    if (Sid)
+        row->Sid = PhAllocateCopy(Sid, RtlLengthSid(Sid));
+
+    row->RelativeId = RelativeId;
+
+    return row;
+}
+
+static VOID SxpDestroyRow(
+    _In_ PSX_ROW Row
+    )
+{
+    for (ULONG i = 0; i < SX_ROW_MAX_COLUMNS; i++)
+        PhClearReference(&Row->Text[i]);
+
+    if (Row->Sid)
+        PhFree(Row->Sid);
+
+    PhFree(Row);
+}
+
+static PSX_ENUM_BATCH SxpCreateEnumBatch(
+    _In_ ULONG Generation
+    )
+{
+    PSX_ENUM_BATCH batch;
+
+    batch = PhAllocate(sizeof(SX_ENUM_BATCH));
+    memset(batch, 0, sizeof(SX_ENUM_BATCH));
+    batch->Generation = Generation;
+    batch->Rows = PhCreateList(SX_ENUM_BATCH_SIZE);
+
+    return batch;
+}
+
+/**
+ * Frees a batch along with any rows it still owns.
+ */
+VOID SxDestroyEnumBatch(
+    _In_ PSX_ENUM_BATCH Batch
+    )
+{
+    for (ULONG i = 0; i < Batch->Rows->Count; i++)
+        SxpDestroyRow(Batch->Rows->Items[i]);
+
+    PhDereferenceObject(Batch->Rows);
+    PhFree(Batch);
+}
+
+static VOID SxpPostEnumBatch(
+    _Inout_ PSX_ENUM_CONTEXT Context,
+    _In_ BOOLEAN Final
+    )
+{
+    PSX_ENUM_BATCH batch = Context->Batch;
+
+    if (!Final && batch->Rows->Count < SX_ENUM_BATCH_SIZE)
+        return;
+
+    if (Context->Type == SxEnumSessions)
+    {
+        PSID *sids;
+
+        // Resolve the whole batch with as few LSA calls as possible.
+        sids = PhAllocate(max(batch->Rows->Count, 1) * sizeof(PSID));
+
+        for (ULONG i = 0; i < batch->Rows->Count; i++)
+            sids[i] = ((PSX_ROW)batch->Rows->Items[i])->Sid;
+
+        SxLookupSidFullNames(sids, batch->Rows->Count);
+        PhFree(sids);
+
+        for (ULONG i = 0; i < batch->Rows->Count; i++)
+        {
+            PSX_ROW row = batch->Rows->Items[i];
+
+            if (row->Sid)
+                row->Text[1] = SxGetSidFullName(row->Sid);
+        }
+    }
+
+    batch->Final = Final;
+
+    // Once the page is gone nobody will drain the batch, so free it here.
+    if (!PostCancelContextMessage(Context->CancelContext, WM_SX_ENUM_BATCH, 0, (LPARAM)batch))
+        SxDestroyEnumBatch(batch);
+
+    Context->Batch = Final ? NULL : SxpCreateEnumBatch(Context->Generation);
+}
+
+static VOID SxpEnumerateSessions(
+    _Inout_ PSX_ENUM_CONTEXT Context
+    )
+{
+    NTSTATUS status;
+    ULONG logonSessionCount = 0;
+    PLUID logonSessionList = NULL;
+
+    if (!NT_SUCCESS(status = LsaEnumerateLogonSessions(
+        &logonSessionCount,
+        &logonSessionList
+        )))
+    {
+        Context->Batch->Status = status;
+        return;
+    }
+
+    for (ULONG i = 0; i < logonSessionCount && !IsCancelContextSignaled(Context->CancelContext); i++)
+    {
+        PSECURITY_LOGON_SESSION_DATA logonSessionData;
+
+        if (NT_SUCCESS(LsaGetLogonSessionData(&logonSessionList[i], &logonSessionData)))
+        {
+            WCHAR logonSessionLuid[PH_INT64_STR_LEN_1];
+            PSX_ROW row;
+
+            if (logonSessionData->Sid && RtlValidSid(logonSessionData->Sid))
+            {
+                row = SxpCreateRow(logonSessionData->Sid, 0);
+                row->Text[2] = PhSidToStringSid(row->Sid);
+            }
+            else
+            {
+                row = SxpCreateRow(NULL, 0);
+            }
+
+            PhPrintPointer(logonSessionLuid, UlongToPtr(logonSessionData->LogonId.LowPart));
+            row->Text[0] = PhCreateString(logonSessionLuid);
+            PhAddItemList(Context->Batch->Rows, row);
+
+            LsaFreeReturnBuffer(logonSessionData);
+
+            SxpPostEnumBatch(Context, FALSE);
+        }
+    }
+
+    LsaFreeReturnBuffer(logonSessionList);
+}
+
+static NTSTATUS SxpOpenAccountDomain(
+    _Out_ PSAM_HANDLE ServerHandle,
+    _Out_ PSAM_HANDLE DomainHandle,
+    _Out_ PPOLICY_ACCOUNT_DOMAIN_INFO *PolicyDomainInfo
+    )
+{
+    NTSTATUS status;
+    LSA_HANDLE policyHandle = NULL;
+
+    *ServerHandle = NULL;
+    *DomainHandle = NULL;
+    *PolicyDomainInfo = NULL;
+
+    if (!NT_SUCCESS(status = PhOpenLsaPolicy(
+        &policyHandle,
+        POLICY_VIEW_LOCAL_INFORMATION,
+        NULL
+        )))
+    {
+        goto CleanupExit;
+    }
+
+    if (!NT_SUCCESS(status = LsaQueryInformationPolicy(
+        policyHandle,
+        PolicyAccountDomainInformation,
+        PolicyDomainInfo
+        )))
+    {
+        goto CleanupExit;
+    }
+
+    if (!NT_SUCCESS(status = SamConnect(
+        NULL,
+        ServerHandle,
+        SAM_SERVER_CONNECT | SAM_SERVER_LOOKUP_DOMAIN,
+        NULL
+        )))
+    {
+        goto CleanupExit;
+    }
+
+    status = SamOpenDomain(
+        *ServerHandle,
+        DOMAIN_LIST_ACCOUNTS | DOMAIN_LOOKUP,
+        (*PolicyDomainInfo)->DomainSid,
+        DomainHandle
+        );
+
+CleanupExit:
+
+    if (!NT_SUCCESS(status))
+    {
+        if (*ServerHandle)
+        {
+            SamCloseHandle(*ServerHandle);
+            *ServerHandle = NULL;
+        }
+
+        if (*PolicyDomainInfo)
+        {
+            LsaFreeMemory(*PolicyDomainInfo);
+            *PolicyDomainInfo = NULL;
+        }
+    }
+
+    if (policyHandle)
+    {
+        LsaClose(policyHandle);
+    }
+
+    return status;
+}
+
+static VOID SxpEnumerateUsers(
+    _Inout_ PSX_ENUM_CONTEXT Context
+    )
+{
+    NTSTATUS status;
+    SAM_HANDLE serverHandle;
+    SAM_HANDLE domainHandle;
+    SAM_ENUMERATE_HANDLE enumContext = 0;
+    PPOLICY_ACCOUNT_DOMAIN_INFO policyDomainInfo;
+    PH_STRINGREF domainName;
+
+    if (!NT_SUCCESS(status = SxpOpenAccountDomain(&serverHandle, &domainHandle, &policyDomainInfo)))
+    {
+        Context->Batch->Status = status;
+        return;
+    }
+
+    PhUnicodeStringToStringRef(&policyDomainInfo->DomainName, &domainName);
+
+    do
+    {
+        PSAM_RID_ENUMERATION enumBuffer;
+        ULONG enumBufferLength;
+
+        status = SamEnumerateUsersInDomain(
+            domainHandle,
+            &enumContext,
+            0, // USER_ACCOUNT_TYPE_MASK
+            &enumBuffer,
+            SX_SAM_ENUM_LENGTH,
+            &enumBufferLength
+            );
+
+        if (!NT_SUCCESS(status))
+        {
+            Context->Batch->Status = status;
+            break;
+        }
+
+        // The enumeration already returns the account name, and the SID is just the
+        // domain SID plus the RID, so there is no need to open each user.
+        for (ULONG i = 0; i < enumBufferLength; i++)
+        {
+            PSID userSid;
+            PSX_ROW row;
+            PH_STRINGREF userName;
+
+            if (!NT_SUCCESS(SamRidToSid(domainHandle, enumBuffer[i].RelativeId, &userSid)))
+                continue;
+
+            PhUnicodeStringToStringRef(&enumBuffer[i].Name, &userName);
+
+            row = SxpCreateRow(userSid, enumBuffer[i].RelativeId);
+
+            if (domainName.Length != 0)
+                row->Text[0] = PhConcatStringRef3(&domainName, &DomainSeparator, &userName);
+            else
+                row->Text[0] = PhCreateString2(&userName);
+
+            row->Text[1] = PhSidToStringSid(row->Sid);
+            PhAddItemList(Context->Batch->Rows, row);
+
+            // Let the other tabs use the name without a lookup.
+            SxpAddSidNameCacheEntry(row->Sid, row->Text[0]);
+
+            SamFreeMemory(userSid);
+        }
+
+        SamFreeMemory(enumBuffer);
+
+        SxpPostEnumBatch(Context, FALSE);
+    } while (status == STATUS_MORE_ENTRIES && !IsCancelContextSignaled(Context->CancelContext));
+
+    SamCloseHandle(domainHandle);
+    SamCloseHandle(serverHandle);
+    LsaFreeMemory(policyDomainInfo);
+}
+
+static VOID SxpEnumerateGroups(
+    _Inout_ PSX_ENUM_CONTEXT Context
+    )
+{
+    NTSTATUS status;
+    SAM_HANDLE serverHandle;
+    SAM_HANDLE domainHandle;
+    SAM_ENUMERATE_HANDLE enumContext = 0;
+    PPOLICY_ACCOUNT_DOMAIN_INFO policyDomainInfo;
+
+    if (!NT_SUCCESS(status = SxpOpenAccountDomain(&serverHandle, &domainHandle, &policyDomainInfo)))
+    {
+        Context->Batch->Status = status;
+        return;
+    }
+
+    do
+    {
+        PSAM_RID_ENUMERATION enumBuffer;
+        ULONG enumBufferLength;
+
+        status = SamEnumerateGroupsInDomain(
+            domainHandle,
+            &enumContext,
+            &enumBuffer,
+            SX_SAM_ENUM_LENGTH,
+            &enumBufferLength
+            );
+
+        if (!NT_SUCCESS(status))
+        {
+            Context->Batch->Status = status;
+            break;
+        }
+
+        for (ULONG i = 0; i < enumBufferLength; i++)
+        {
+            SAM_HANDLE groupHandle;
+            PGROUP_ADM_COMMENT_INFORMATION groupComment;
+            PSX_ROW row;
+
+            row = SxpCreateRow(NULL, enumBuffer[i].RelativeId);
+            row->Text[0] = PhCreateStringFromUnicodeString(&enumBuffer[i].Name);
+
+            // The name comes with the enumeration; only the comment has to be queried.
+            if (NT_SUCCESS(SamOpenGroup(
+                domainHandle,
+                GROUP_READ_INFORMATION,
+                enumBuffer[i].RelativeId,
+                &groupHandle
+                )))
+            {
+                if (NT_SUCCESS(SamQueryInformationGroup(
+                    groupHandle,
+                    GroupAdminCommentInformation,
+                    &groupComment
+                    )))
+                {
+                    row->Text[1] = PhCreateStringFromUnicodeString(&groupComment->AdminComment);
+                    SamFreeMemory(groupComment);
+                }
+
+                SamCloseHandle(groupHandle);
+            }
+
+            PhAddItemList(Context->Batch->Rows, row);
+        }
+
+        SamFreeMemory(enumBuffer);
+
+        SxpPostEnumBatch(Context, FALSE);
+    } while (status == STATUS_MORE_ENTRIES && !IsCancelContextSignaled(Context->CancelContext));
+
+    SamCloseHandle(domainHandle);
+    SamCloseHandle(serverHandle);
+    LsaFreeMemory(policyDomainInfo);
+}
+
+static NTSTATUS NTAPI SxpEnumerationWorker(
+    _In_ PVOID Parameter
+    )
+{
+    PSX_ENUM_CONTEXT context = Parameter;
+
+    switch (context->Type)
+    {
+    case SxEnumSessions:
+        SxpEnumerateSessions(context);
+        break;
+    case SxEnumUsers:
+        SxpEnumerateUsers(context);
+        break;
+    case SxEnumGroups:
+        SxpEnumerateGroups(context);
+        break;
+    }
+
+    SxpPostEnumBatch(context, TRUE);
+    DereferenceCancelContext(context->CancelContext);
+    PhFree(context);
+
+    return STATUS_SUCCESS;
+}
+
+/**
+ * Initializes an owner-data list view backed by rows from a background
+ * enumeration.
+ */
+VOID SxInitializeRowList(
+    _Out_ PSX_ROW_LIST List,
+    _In_ HWND ListViewHandle,
+    _In_ HWND WindowHandle,
+    _In_ SX_ENUM_TYPE Type
+    )
+{
+    memset(List, 0, sizeof(SX_ROW_LIST));
+    List->ListViewHandle = ListViewHandle;
+    List->WindowHandle = WindowHandle;
+    List->Type = Type;
+    List->CancelContext = CreateCancelContext(WindowHandle);
+    List->Rows = PhCreateList(64);
+    List->SortColumn = 0;
+    List->SortOrder = AscendingSortOrder;
+
+    PhSetHeaderSortIcon(ListView_GetHeader(ListViewHandle), List->SortColumn, List->SortOrder);
+}
+
+static VOID SxpClearRows(
+    _Inout_ PSX_ROW_LIST List
+    )
+{
+    for (ULONG i = 0; i < List->Rows->Count; i++)
+        SxpDestroyRow(List->Rows->Items[i]);
+
+    PhClearList(List->Rows);
+}
+
+/**
+ * Frees the rows of a list, and any batches still queued for its window.
+ */
+VOID SxDeleteRowList(
+    _Inout_ PSX_ROW_LIST List
+    )
+{
+    MSG message;
+
+    // Enumerations that are still running free their own batches from now on; the
+    // ones already posted are in the queue.
+    List->Generation++;
+    SignalCancelContext(List->CancelContext);
+
+    while (PeekMessage(&message, List->WindowHandle, WM_SX_ENUM_BATCH, WM_SX_ENUM_BATCH, PM_REMOVE))
+        SxDestroyEnumBatch((PSX_ENUM_BATCH)message.lParam);
+
+    DereferenceCancelContext(List->CancelContext);
+
+    SxpClearRows(List);
+    PhDereferenceObject(List->Rows);
+}
+
+/**
+ * Clears the list and starts a new enumeration on the global work queue. Rows
+ * arrive as WM_SX_ENUM_BATCH messages and are added by SxApplyEnumBatch.
+ */
+VOID SxRefreshRowList(
+    _Inout_ PSX_ROW_LIST List
+    )
+{
+    PSX_ENUM_CONTEXT context;
+
+    List->Generation++;
+    List->Loading = TRUE;
+    SxpClearRows(List);
+    ListView_SetItemCountEx(List->ListViewHandle, 0, 0);
+
+    context = PhAllocate(sizeof(SX_ENUM_CONTEXT));
+    context->Type = List->Type;
+    context->CancelContext = ReferenceCancelContext(List->CancelContext);
+    context->Generation = List->Generation;
+    context->Batch = SxpCreateEnumBatch(List->Generation);
+
+    PhQueueItemWorkQueue(PhGetGlobalWorkQueue(), SxpEnumerationWorker, context);
+}
+
+#define SORT_FUNCTION(Column) SxpRowListCompare##Column
+
+#define BEGIN_SORT_FUNCTION(Column) static int __cdecl SxpRowListCompare##Column( \
+    _In_ void *_context, \
+    _In_ const void *_elem1, \
+    _In_ const void *_elem2 \
+    ) \
+{ \
+    PSX_ROW_LIST context = _context; \
+    PSX_ROW row1 = *(PSX_ROW *)_elem1; \
+    PSX_ROW row2 = *(PSX_ROW *)_elem2; \
+    int sortResult = 0;
+
+#define END_SORT_FUNCTION \
+    return PhModifySort(sortResult, context->SortOrder); \
+}
+
+BEGIN_SORT_FUNCTION(Text)
+{
+    sortResult = PhCompareStringWithNull(row1->Text[context->SortColumn], row2->Text[context->SortColumn], TRUE);
+}
+END_SORT_FUNCTION
+
+static VOID SxpSortRowList(
+    _Inout_ PSX_ROW_LIST List
+    )
+{
+    if (List->SortColumn >= SX_ROW_MAX_COLUMNS)
+        return;
+
+    qsort_s(List->Rows->Items, List->Rows->Count, sizeof(PVOID), SORT_FUNCTION(Text), List);
+}
+
+/**
+ * Adds the rows of a batch to the list. The batch is always consumed.
+ */
+VOID SxApplyEnumBatch(
+    _Inout_ PSX_ROW_LIST List,
+    _In_ PSX_ENUM_BATCH Batch
+    )
+{
+    if (Batch->Generation != List->Generation)
+    {
+        SxDestroyEnumBatch(Batch);
+        return;
+    }
+
+    for (ULONG i = 0; i < Batch->Rows->Count; i++)
+        PhAddItemList(List->Rows, Batch->Rows->Items[i]);
+
+    PhClearList(Batch->Rows);
+
+    // Rows are shown in arrival order while streaming and sorted once at the end, so the
+    // list does not jump around under the user.
+    if (Batch->Final)
+    {
+        List->Loading = FALSE;
+        SxpSortRowList(List);
+
+        if (!NT_SUCCESS(Batch->Status) && List->Rows->Count == 0)
+            PhShowStatus(List->WindowHandle, L"Unable to enumerate the list", Batch->Status, 0);
+    }
+
+    ListView_SetItemCountEx(List->ListViewHandle, List->Rows->Count, LVSICF_NOSCROLL);
+
+    if (Batch->Final)
+        InvalidateRect(List->ListViewHandle, NULL, FALSE);
+
+    SxDestroyEnumBatch(Batch);
+}
+
+/**
+ * Gets the row of the single selected item, or NULL.
+ */
+PSX_ROW SxGetSelectedRow(
+    _In_ PSX_ROW_LIST List
+    )
+{
+    INT index;
+
+    if (ListView_GetSelectedCount(List->ListViewHandle) != 1)
+        return NULL;
+
+    index = ListView_GetNextItem(List->ListViewHandle, -1, LVNI_SELECTED);
+
+    if (index < 0 || (ULONG)index >= List->Rows->Count)
+        return NULL;
+
+    return List->Rows->Items[index];
+}
+
+/**
+ * Handles LVN_GETDISPINFO and LVN_COLUMNCLICK for the list view.
+ *
+ * \return TRUE if the notification was handled.
+ */
+BOOLEAN SxHandleRowListNotify(
+    _Inout_ PSX_ROW_LIST List,
+    _In_ LPNMHDR Header
+    )
+{
+    if (Header->hwndFrom != List->ListViewHandle)
+        return FALSE;
+
+    switch (Header->code)
+    {
+    case LVN_GETDISPINFO:
+        {
+            NMLVDISPINFO* dispInfo = (NMLVDISPINFO*)Header;
+            PSX_ROW row;
+
+            if ((ULONG)dispInfo->item.iItem >= List->Rows->Count)
+                break;
+
+            row = List->Rows->Items[dispInfo->item.iItem];
+
+            if ((dispInfo->item.mask & LVIF_TEXT) && (ULONG)dispInfo->item.iSubItem < SX_ROW_MAX_COLUMNS)
+            {
+                wcsncpy_s(
+                    dispInfo->item.pszText,
+                    dispInfo->item.cchTextMax,
+                    PhGetStringOrDefault(row->Text[dispInfo->item.iSubItem], L"(unknown)"),
+                    _TRUNCATE
+                    );
+            }
+        }
+        return TRUE;
+    case LVN_COLUMNCLICK:
+        {
+            LPNMLISTVIEW listView = (LPNMLISTVIEW)Header;
+
+            if ((ULONG)listView->iSubItem == List->SortColumn)
+            {
+                List->SortOrder = List->SortOrder == AscendingSortOrder ? DescendingSortOrder : AscendingSortOrder;
+            }
+            else
+            {
+                List->SortColumn = listView->iSubItem;
+                List->SortOrder = AscendingSortOrder;
+            }
+
+            PhSetHeaderSortIcon(ListView_GetHeader(List->ListViewHandle), List->SortColumn, List->SortOrder);
+
+            if (!List->Loading)
+                SxpSortRowList(List);
+
+            InvalidateRect(List->ListViewHandle, NULL, FALSE);
+        }
+        return TRUE;
+    }
+
+    return FALSE;
+}
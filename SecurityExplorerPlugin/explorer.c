@@ -44,6 +44,9 @@ VOID SxShowExplorer()
     propSheetHeader.nStartPage = 0;
     propSheetHeader.phpage = pages;
 
+    // Pick up accounts renamed since the explorer was last opened.
+    SxClearSidNameCache();
+
     // LSA page
     memset(&propSheetPage, 0, sizeof(PROPSHEETPAGE));
     propSheetPage.dwSize = sizeof(PROPSHEETPAGE);
@@ -136,7 +139,7 @@ VOID SxpRefreshAccounts()
                 sid = PhAllocateCopy(accounts[i].Sid, RtlLengthSid(accounts[i].Sid));
                 PhAddItemList(AccountsList, sid);
 
-                name = PH_AUTO(PhGetSidFullName(sid, TRUE, NULL));
+                name = PH_AUTO(SxGetSidFullName(sid));
                 lvItemIndex = PhAddListViewItem(AccountsLv, MAXINT, PhGetStringOrDefault(name, L"(unknown)"), sid);
 
                 sidString = PH_AUTO(PhSidToStringSid(sid));
@@ -198,341 +201,6 @@ VOID SxpRefreshPrivileges()
     ExtendedListView_SortItems(PrivilegesLv);
 }
 
-VOID SxpRefreshSessions(
-    _In_ HWND ListViewHandle
-    )
-{
-    ULONG logonSessionCount = 0;
-    PLUID logonSessionList = NULL;
-
-    if (AccountsList)
-    {
-        SxpFreeAccounts();
-    }
-    else
-    {
-        AccountsList = PhCreateList(40);
-    }
-
-    ListView_DeleteAllItems(ListViewHandle);
-
-    if (NT_SUCCESS(LsaEnumerateLogonSessions(
-        &logonSessionCount,
-        &logonSessionList
-        )))
-    {
-        for (ULONG i = 0; i < logonSessionCount; i++)
-        {
-            PSECURITY_LOGON_SESSION_DATA logonSessionData;
-
-            if (NT_SUCCESS(LsaGetLogonSessionData(&logonSessionList[i], &logonSessionData)))
-            {
-                WCHAR logonSessionLuid[PH_INT64_STR_LEN_1];
-
-                if (RtlValidSid(logonSessionData->Sid))
-                {
-                    INT lvItemIndex;
-                    PSID sid = NULL;
-                    PPH_STRING name;
-                    PPH_STRING sidString;
-
-                    sid = PhAllocateCopy(logonSessionData->Sid, RtlLengthSid(logonSessionData->Sid));
-                    PhAddItemList(AccountsList, sid);
-
-                    PhPrintPointer(logonSessionLuid, UlongToPtr(logonSessionData->LogonId.LowPart));
-                    lvItemIndex = PhAddListViewItem(ListViewHandle, MAXINT, logonSessionLuid, sid);
-
-                    name = PH_AUTO(PhGetSidFullName(sid, TRUE, NULL));
-                    PhSetListViewSubItem(ListViewHandle, lvItemIndex, 1, PhGetStringOrDefault(name, L"(unknown)"));
-
-                    sidString = PH_AUTO(PhSidToStringSid(sid));
-                    PhSetListViewSubItem(ListViewHandle, lvItemIndex, 2, PhGetStringOrDefault(sidString, L"(unknown)"));
-                }
-                else
-                {
-                    PhPrintPointer(logonSessionLuid, UlongToPtr(logonSessionData->LogonId.LowPart));
-                    PhAddListViewItem(ListViewHandle, MAXINT, logonSessionLuid, NULL);
-                }
-
-                LsaFreeReturnBuffer(logonSessionData);
-            }
-        }
-
-        LsaFreeReturnBuffer(logonSessionList);
-    }
-
-    ExtendedListView_SortItems(ListViewHandle);
-}
-
-VOID SxpRefreshUsers(
-    _In_ HWND ListViewHandle
-    )
-{
-    NTSTATUS status;
-    LSA_HANDLE policyHandle = NULL;
-    SAM_HANDLE serverHandle = NULL;
-    SAM_HANDLE domainHandle = NULL;
-    SAM_HANDLE userHandle = NULL;
-    SAM_ENUMERATE_HANDLE enumContext = 0;
-    ULONG enumBufferLength = 0;
-    PSAM_RID_ENUMERATION enumBuffer = NULL;
-    PPOLICY_ACCOUNT_DOMAIN_INFO policyDomainInfo = NULL;
-
-    if (!NT_SUCCESS(status = PhOpenLsaPolicy(
-        &policyHandle,
-        POLICY_VIEW_LOCAL_INFORMATION,
-        NULL
-        )))
-    {
-        goto CleanupExit;
-    }
-
-    if (!NT_SUCCESS(status = LsaQueryInformationPolicy(
-        policyHandle,
-        PolicyAccountDomainInformation,
-        &policyDomainInfo
-        )))
-    {
-        goto CleanupExit;
-    }
-
-    if (!NT_SUCCESS(status = SamConnect(
-        NULL,
-        &serverHandle,
-        SAM_SERVER_CONNECT | SAM_SERVER_LOOKUP_DOMAIN,
-        NULL
-        )))
-    {
-        goto CleanupExit;
-    }
-
-    if (!NT_SUCCESS(status = SamOpenDomain(
-        serverHandle,
-        DOMAIN_LIST_ACCOUNTS | DOMAIN_LOOKUP,
-        policyDomainInfo->DomainSid,
-        &domainHandle
-        )))
-    {
-        goto CleanupExit;
-    }
-
-    if (!NT_SUCCESS(status = SamEnumerateUsersInDomain(
-        domainHandle,
-        &enumContext,
-        0, // USER_ACCOUNT_TYPE_MASK
-        &enumBuffer,
-        -1,
-        &enumBufferLength
-        )))
-    {
-        goto CleanupExit;
-    }
-
-    for (ULONG i = 0; i < enumBufferLength; i++)
-    {
-        PSID userSid = NULL;
-        PUSER_ALL_INFORMATION userInfo = NULL;
-
-        if (!NT_SUCCESS(status = SamOpenUser(
-            domainHandle,
-            USER_ALL_ACCESS,
-            enumBuffer[i].RelativeId,
-            &userHandle
-            )))
-        {
-            continue;
-        }
-
-        if (!NT_SUCCESS(status = SamQueryInformationUser(
-            userHandle,
-            UserAllInformation,
-            &userInfo
-            )))
-        {
-            SamCloseHandle(userHandle);
-            continue;
-        }
-
-        if (NT_SUCCESS(status = SamRidToSid(
-            userHandle,
-            enumBuffer[i].RelativeId,
-            &userSid
-            )))
-        {
-            INT lvItemIndex;
-            PSID sid;
-            PPH_STRING name;
-            PPH_STRING sidString;
-
-            sid = PhAllocateCopy(userSid, RtlLengthSid(userSid));
-            PhAddItemList(AccountsList, sid);
-
-            name = PH_AUTO(PhGetSidFullName(sid, TRUE, NULL));
-            lvItemIndex = PhAddListViewItem(ListViewHandle, MAXINT, PhGetStringOrDefault(name, L"(unknown)"), UlongToPtr(enumBuffer[i].RelativeId));
-
-            sidString = PH_AUTO(PhSidToStringSid(sid));
-            PhSetListViewSubItem(ListViewHandle, lvItemIndex, 1, PhGetStringOrDefault(sidString, L"(unknown)"));
-        }
-
-        SamCloseHandle(userHandle);
-        SamFreeMemory(userInfo);
-    }
-
-CleanupExit:
-
-    if (enumBuffer)
-    {
-        SamFreeMemory(enumBuffer);
-    }
-
-    if (domainHandle)
-    {
-        SamCloseHandle(domainHandle);
-    }
-
-    if (serverHandle)
-    {
-        SamCloseHandle(serverHandle);
-    }
-
-    if (policyDomainInfo)
-    {
-        LsaFreeMemory(policyDomainInfo);
-    }
-
-    if (policyHandle)
-    {
-        LsaClose(policyHandle);
-    }
-}
-
-VOID SxpRefreshGroups(
-    _In_ HWND ListViewHandle
-)
-{
-    NTSTATUS status;
-    LSA_HANDLE policyHandle = NULL;
-    SAM_HANDLE serverHandle = NULL;
-    SAM_HANDLE domainHandle = NULL;
-    SAM_HANDLE groupHandle = NULL;
-    SAM_ENUMERATE_HANDLE enumContext = 0;
-    ULONG enumBufferLength = 0;
-    PSAM_RID_ENUMERATION enumBuffer = NULL;
-    PPOLICY_ACCOUNT_DOMAIN_INFO policyDomainInfo = NULL;
-
-    if (!NT_SUCCESS(status = PhOpenLsaPolicy(
-        &policyHandle,
-        POLICY_VIEW_LOCAL_INFORMATION,
-        NULL
-        )))
-    {
-        goto CleanupExit;
-    }
-
-    if (!NT_SUCCESS(status = LsaQueryInformationPolicy(
-        policyHandle,
-        PolicyAccountDomainInformation,
-        &policyDomainInfo
-        )))
-    {
-        goto CleanupExit;
-    }
-
-    if (!NT_SUCCESS(status = SamConnect(
-        NULL,
-        &serverHandle,
-        SAM_SERVER_CONNECT | SAM_SERVER_LOOKUP_DOMAIN,
-        NULL
-        )))
-    {
-        goto CleanupExit;
-    }
-
-    if (!NT_SUCCESS(status = SamOpenDomain(
-        serverHandle,
-        DOMAIN_LIST_ACCOUNTS | DOMAIN_LOOKUP,
-        policyDomainInfo->DomainSid,
-        &domainHandle
-        )))
-    {
-        goto CleanupExit;
-    }
-
-    if (!NT_SUCCESS(status = SamEnumerateGroupsInDomain(
-        domainHandle,
-        &enumContext,
-        &enumBuffer,
-        -1,
-        &enumBufferLength
-        )))
-    {
-        goto CleanupExit;
-    }
-
-    for (ULONG i = 0; i < enumBufferLength; i++)
-    {
-        PGROUP_GENERAL_INFORMATION groupInfo = NULL;
-
-        if (!NT_SUCCESS(status = SamOpenGroup(
-            domainHandle,
-            GROUP_ALL_ACCESS,
-            enumBuffer[i].RelativeId,
-            &groupHandle
-            )))
-        {
-            continue;
-        }
-
-        if (NT_SUCCESS(status = SamQueryInformationGroup(
-            groupHandle,
-            GroupGeneralInformation,
-            &groupInfo
-            )))
-        {
-            INT lvItemIndex;
-            PPH_STRING groupName;
-            PPH_STRING groupComment;
-
-            groupName = PH_AUTO(PhCreateStringFromUnicodeString(&groupInfo->Name));
-            groupComment = PH_AUTO(PhCreateStringFromUnicodeString(&groupInfo->AdminComment));
-
-            lvItemIndex = PhAddListViewItem(ListViewHandle, MAXINT, PhGetStringOrDefault(groupName, L"(unknown)"), NULL);
-            PhSetListViewSubItem(ListViewHandle, lvItemIndex, 1, PhGetStringOrDefault(groupComment, L"(unknown)"));
-
-            SamFreeMemory(groupInfo);
-        }
-
-        SamCloseHandle(groupHandle);
-    }
-
-CleanupExit:
-
-    if (enumBuffer)
-    {
-        SamFreeMemory(enumBuffer);
-    }
-
-    if (domainHandle)
-    {
-        SamCloseHandle(domainHandle);
-    }
-
-    if (serverHandle)
-    {
-        SamCloseHandle(serverHandle);
-    }
-
-    if (policyDomainInfo)
-    {
-        LsaFreeMemory(policyDomainInfo);
-    }
-
-    if (policyHandle)
-    {
-        LsaClose(policyHandle);
-    }
-}
-
 INT_PTR CALLBACK SxLsaDlgProc(
     _In_ HWND hwndDlg,
     _In_ UINT uMsg,
@@ -33,6 +33,7 @@
 #include <Sddl.h>
 
 #include "resource.h"
+#include "../common/cancel.h"
 
 extern PPH_PLUGIN PluginInstance;
 extern PSID SelectedAccount;
@@ -57,16 +58,90 @@ _Callback_ NTSTATUS SxpOpenSelectedSamAccount(
 
 VOID SxShowExplorer();
 
-VOID SxpRefreshSessions(
-    _In_ HWND ListViewHandle
+// enum
+
+#define WM_SX_ENUM_BATCH (WM_APP + 1)
+#define SX_ROW_MAX_COLUMNS 3
+
+typedef enum _SX_ENUM_TYPE
+{
+    SxEnumSessions,
+    SxEnumUsers,
+    SxEnumGroups
+} SX_ENUM_TYPE;
+
+typedef struct _SX_ROW
+{
+    PPH_STRING Text[SX_ROW_MAX_COLUMNS];
+    PSID Sid;
+    ULONG RelativeId;
+} SX_ROW, *PSX_ROW;
+
+typedef struct _SX_ENUM_BATCH
+{
+    ULONG Generation;
+    BOOLEAN Final;
+    NTSTATUS Status;
+    PPH_LIST Rows;
+} SX_ENUM_BATCH, *PSX_ENUM_BATCH;
+
+typedef struct _SX_ROW_LIST
+{
+    HWND ListViewHandle;
+    HWND WindowHandle;
+    PCANCEL_CONTEXT CancelContext; // shared with running enumerations
+    SX_ENUM_TYPE Type;
+    ULONG Generation;
+    BOOLEAN Loading;
+    PPH_LIST Rows;
+    ULONG SortColumn;
+    PH_SORT_ORDER SortOrder;
+} SX_ROW_LIST, *PSX_ROW_LIST;
+
+VOID SxClearSidNameCache(
+    VOID
     );
 
-VOID SxpRefreshUsers(
-    _In_ HWND ListViewHandle
+VOID SxLookupSidFullNames(
+    _In_reads_(Count) PSID *Sids,
+    _In_ ULONG Count
     );
 
-VOID SxpRefreshGroups(
-    _In_ HWND ListViewHandle
+PPH_STRING SxGetSidFullName(
+    _In_ PSID Sid
+    );
+
+VOID SxDestroyEnumBatch(
+    _In_ PSX_ENUM_BATCH Batch
+    );
+
+VOID SxInitializeRowList(
+    _Out_ PSX_ROW_LIST List,
+    _In_ HWND ListViewHandle,
+    _In_ HWND WindowHandle,
+    _In_ SX_ENUM_TYPE Type
+    );
+
+VOID SxDeleteRowList(
+    _Inout_ PSX_ROW_LIST List
+    );
+
+VOID SxRefreshRowList(
+    _Inout_ PSX_ROW_LIST List
+    );
+
+VOID SxApplyEnumBatch(
+    _Inout_ PSX_ROW_LIST List,
+    _In_ PSX_ENUM_BATCH Batch
+    );
+
+PSX_ROW SxGetSelectedRow(
+    _In_ PSX_ROW_LIST List
+    );
+
+BOOLEAN SxHandleRowListNotify(
+    _Inout_ PSX_ROW_LIST List,
+    _In_ LPNMHDR Header
     );
 
 INT_PTR CALLBACK SxLsaDlgProc(
@@ -24,6 +24,7 @@
 
 static HWND GroupsLv = NULL;
 static PH_LAYOUT_MANAGER LayoutManager;
+static SX_ROW_LIST GroupRows;
 
 INT_PTR CALLBACK SxGroupsDlgProc(
     _In_ HWND hwndDlg,
@@ -41,23 +42,35 @@ INT_PTR CALLBACK SxGroupsDlgProc(
             PhSetListViewStyle(GroupsLv, FALSE, TRUE);
             PhSetControlTheme(GroupsLv, L"explorer");
             PhAddListViewColumn(GroupsLv, 0, 0, 0, LVCFMT_LEFT, 200, L"Name");
-            PhAddListViewColumn(GroupsLv, 1, 1, 1, LVCFMT_LEFT, 300, L"SID");
-            PhSetExtendedListView(GroupsLv);
+            PhAddListViewColumn(GroupsLv, 1, 1, 1, LVCFMT_LEFT, 300, L"Comment");
+            SxInitializeRowList(&GroupRows, GroupsLv, hwndDlg, SxEnumGroups);
 
             PhInitializeLayoutManager(&LayoutManager, hwndDlg);
             PhAddLayoutItem(&LayoutManager, GroupsLv, NULL, PH_ANCHOR_ALL);
 
-            SxpRefreshGroups(GroupsLv);
+            SxRefreshRowList(&GroupRows);
         }
         break;
     case WM_DESTROY:
         {
+            SxDeleteRowList(&GroupRows);
             PhDeleteLayoutManager(&LayoutManager);
         }
         break;
     case WM_SIZE:
         PhLayoutManagerLayout(&LayoutManager);
         break;
+    case WM_NOTIFY:
+        {
+            if (SxHandleRowListNotify(&GroupRows, (LPNMHDR)lParam))
+                return TRUE;
+        }
+        break;
+    case WM_SX_ENUM_BATCH:
+        {
+            SxApplyEnumBatch(&GroupRows, (PSX_ENUM_BATCH)lParam);
+        }
+        break;
     }
 
     return FALSE;
@@ -24,6 +24,7 @@
 
 static HWND SessionsLv = NULL;
 static PH_LAYOUT_MANAGER LayoutManager;
+static SX_ROW_LIST SessionRows;
 
 INT_PTR CALLBACK SxSessionsDlgProc(
     _In_ HWND hwndDlg,
@@ -43,16 +44,17 @@ INT_PTR CALLBACK SxSessionsDlgProc(
             PhAddListViewColumn(SessionsLv, 0, 0, 0, LVCFMT_LEFT, 80, L"LogonId");
             PhAddListViewColumn(SessionsLv, 1, 1, 1, LVCFMT_LEFT, 200, L"Name");
             PhAddListViewColumn(SessionsLv, 2, 2, 2, LVCFMT_LEFT, 300, L"SID");
-            PhSetExtendedListView(SessionsLv);
+            SxInitializeRowList(&SessionRows, SessionsLv, hwndDlg, SxEnumSessions);
 
             PhInitializeLayoutManager(&LayoutManager, hwndDlg);
             PhAddLayoutItem(&LayoutManager, SessionsLv, NULL, PH_ANCHOR_ALL);
 
-            SxpRefreshSessions(SessionsLv);
+            SxRefreshRowList(&SessionRows);
         }
         break;
     case WM_DESTROY:
         {
+            SxDeleteRowList(&SessionRows);
             PhDeleteLayoutManager(&LayoutManager);
         }
         break;
@@ -65,7 +67,9 @@ INT_PTR CALLBACK SxSessionsDlgProc(
             {
             case IDC_ACCOUNT_DELETE:
                 {
-                    if (!SelectedAccount)
+                    PSX_ROW row;
+
+                    if (!(row = SxGetSelectedRow(&SessionRows)) || !row->Sid)
                         return FALSE;
 
                     if (PhShowConfirmMessage(
@@ -84,7 +88,7 @@ INT_PTR CALLBACK SxSessionsDlgProc(
                         {
                             if (NT_SUCCESS(status = LsaOpenAccount(
                                 policyHandle,
-                                SelectedAccount,
+                                row->Sid,
                                 ACCOUNT_VIEW | DELETE, // ACCOUNT_VIEW is needed as well for some reason
                                 &accountHandle
                                 )))
@@ -97,7 +101,7 @@ INT_PTR CALLBACK SxSessionsDlgProc(
                         }
 
                         if (NT_SUCCESS(status))
-                            SxpRefreshSessions(SessionsLv);
+                            SxRefreshRowList(&SessionRows);
                         else
                             PhShowStatus(hwndDlg, L"Unable to delete the session", status, 0);
                     }
@@ -105,23 +109,19 @@ INT_PTR CALLBACK SxSessionsDlgProc(
                 break;
             case IDC_ACCOUNT_SECURITY:
                 {
-                    PPH_STRING name;
+                    PSX_ROW row;
 
-                    if (!SelectedAccount)
+                    if (!(row = SxGetSelectedRow(&SessionRows)) || !row->Sid)
                         return FALSE;
 
-                    name = PhGetSidFullName(SelectedAccount, TRUE, NULL);
-
                     PhEditSecurity(
                         hwndDlg,
-                        PhGetStringOrDefault(name, L"(unknown)"),
+                        PhGetStringOrDefault(row->Text[1], L"(unknown)"),
                         L"LsaAccount",
                         SxpOpenSelectedLsaAccount,
                         NULL,
-                        SelectedAccount
+                        row->Sid
                         );
-
-                    PhClearReference(&name);
                 }
                 break;
             }
@@ -129,26 +129,13 @@ INT_PTR CALLBACK SxSessionsDlgProc(
         break;
     case WM_NOTIFY:
         {
-            LPNMHDR header = (LPNMHDR)lParam;
-
-            switch (header->code)
-            {
-            case LVN_ITEMCHANGED:
-                {
-                    if (header->hwndFrom == SessionsLv)
-                    {
-                        if (ListView_GetSelectedCount(SessionsLv) == 1)
-                        {
-                            SelectedAccount = PhGetSelectedListViewItemParam(SessionsLv);
-                        }
-                        else
-                        {
-                            SelectedAccount = NULL;
-                        }
-                    }
-                }
-                break;
-            }
+            if (SxHandleRowListNotify(&SessionRows, (LPNMHDR)lParam))
+                return TRUE;
+        }
+        break;
+    case WM_SX_ENUM_BATCH:
+        {
+            SxApplyEnumBatch(&SessionRows, (PSX_ENUM_BATCH)lParam);
         }
         break;
     }
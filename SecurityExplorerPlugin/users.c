@@ -22,9 +22,9 @@
 
 #include "explorer.h"
 
-static ULONG RelativeId = 0;
 static HWND UsersLv = NULL;
 static PH_LAYOUT_MANAGER LayoutManager;
+static SX_ROW_LIST UserRows;
 
 INT_PTR CALLBACK SxUsersDlgProc(
     _In_ HWND hwndDlg,
@@ -43,16 +43,17 @@ INT_PTR CALLBACK SxUsersDlgProc(
             PhSetControlTheme(UsersLv, L"explorer");
             PhAddListViewColumn(UsersLv, 0, 0, 0, LVCFMT_LEFT, 200, L"Name");
             PhAddListViewColumn(UsersLv, 1, 1, 1, LVCFMT_LEFT, 300, L"SID");
-            PhSetExtendedListView(UsersLv);
+            SxInitializeRowList(&UserRows, UsersLv, hwndDlg, SxEnumUsers);
 
             PhInitializeLayoutManager(&LayoutManager, hwndDlg);
             PhAddLayoutItem(&LayoutManager, UsersLv, NULL, PH_ANCHOR_ALL);
 
-            SxpRefreshUsers(UsersLv);
+            SxRefreshRowList(&UserRows);
         }
         break;
     case WM_DESTROY:
         {
+            SxDeleteRowList(&UserRows);
             PhDeleteLayoutManager(&LayoutManager);
         }
         break;
@@ -105,23 +106,19 @@ INT_PTR CALLBACK SxUsersDlgProc(
                 break;
             case IDC_ACCOUNT_SECURITY:
                 {
-                    PPH_STRING name;
+                    PSX_ROW row;
 
-                    if (!SelectedAccount)
+                    if (!(row = SxGetSelectedRow(&UserRows)))
                         return FALSE;
 
-                    name = PhGetSidFullName(SelectedAccount, TRUE, NULL);
-
                     PhEditSecurity(
                         hwndDlg,
-                        PhGetStringOrDefault(name, L"(unknown)"),
+                        PhGetStringOrDefault(row->Text[0], L"(unknown)"),
                         L"SamUser",
                         SxpOpenSelectedSamAccount,
                         NULL,
-                        UlongToPtr(RelativeId)
+                        UlongToPtr(row->RelativeId)
                         );
-
-                    PhClearReference(&name);
                 }
                 break;
             }
@@ -129,26 +126,13 @@ INT_PTR CALLBACK SxUsersDlgProc(
         break;
     case WM_NOTIFY:
         {
-            LPNMHDR header = (LPNMHDR)lParam;
-
-            switch (header->code)
-            {
-            case LVN_ITEMCHANGED:
-                {
-                    if (header->hwndFrom == UsersLv)
-                    {
-                        if (ListView_GetSelectedCount(UsersLv) == 1)
-                        {
-                            RelativeId = PtrToUlong(PhGetSelectedListViewItemParam(UsersLv));
-                        }
-                        else
-                        {
-                            RelativeId = 0;
-                        }
-                    }
-                }
-                break;
-            }
+            if (SxHandleRowListNotify(&UserRows, (LPNMHDR)lParam))
+                return TRUE;
+        }
+        break;
+    case WM_SX_ENUM_BATCH:
+        {
+            SxApplyEnumBatch(&UserRows, (PSX_ENUM_BATCH)lParam);
         }
         break;
     }
@@ -31,6 +31,7 @@ static PH_CALLBACK_REGISTRATION ProcessesUpdatedCallbackRegistration;
 
 static TASKBAR_ICON TaskbarIconType = TASKBAR_ICON_NONE;
 static ULONG ProcessesUpdatedCount = 0;
+static volatile BOOLEAN OverlayIconInvalid = TRUE;
 static UINT TaskbarButtonCreatedMsgId = 0;
 static ITaskbarList3* TaskbarListClass = NULL;
 static WNDPROC MainWindowHookProc = NULL;
@@ -38,55 +39,57 @@ static HICON BlackIcon = NULL;
 static HIMAGELIST ButtonsImageList = NULL;
 static THUMBBUTTON ButtonsArray[4] = { 0 }; // maximum 8
 
+/*
+ * Makes the next update re-read the icon type and republish the overlay in full.
+ */
+VOID InvalidateOverlayIcon(
+    VOID
+    )
+{
+    OverlayIconInvalid = TRUE;
+}
+
 VOID NTAPI ProcessesUpdatedCallback(
     _In_opt_ PVOID Parameter,
     _In_opt_ PVOID Context
     )
 {
-    HICON overlayIcon = NULL;
-    ULONG taskbarIconType = TASKBAR_ICON_NONE;
+    HICON overlayIcon;
     PH_PLUGIN_SYSTEM_STATISTICS statistics;
 
     ProcessesUpdatedCount++;
 
     if (ProcessesUpdatedCount < 2)
         return;
-    
-    PhPluginGetSystemStatistics(&statistics);
 
-    // Check if we need to clear the icon
-    taskbarIconType = PhGetIntegerSetting(SETTING_NAME_TASKBAR_ICON_TYPE);
-    if (taskbarIconType != TaskbarIconType && taskbarIconType == TASKBAR_ICON_NONE)
+    if (OverlayIconInvalid)
     {
-        // Clear the icon
-        if (TaskbarListClass)
+        ULONG taskbarIconType;
+
+        OverlayIconInvalid = FALSE;
+
+        // Check if we need to clear the icon
+        taskbarIconType = PhGetIntegerSetting(SETTING_NAME_TASKBAR_ICON_TYPE);
+        if (taskbarIconType != TaskbarIconType && taskbarIconType == TASKBAR_ICON_NONE)
         {
-            ITaskbarList3_SetOverlayIcon(TaskbarListClass, PhMainWndHandle, NULL, NULL);
+            // Clear the icon
+            if (TaskbarListClass)
+            {
+                ITaskbarList3_SetOverlayIcon(TaskbarListClass, PhMainWndHandle, NULL, NULL);
+            }
         }
+
+        TaskbarIconType = taskbarIconType;
+        PhResetOverlayIcon();
     }
 
-    TaskbarIconType = taskbarIconType;
+    if (TaskbarIconType == TASKBAR_ICON_NONE)
+        return;
 
-    switch (TaskbarIconType)
-    {
-    case TASKBAR_ICON_CPU_HISTORY:
-        overlayIcon = PhUpdateIconCpuHistory(statistics);
-        break;
-    case TASKBAR_ICON_IO_HISTORY:
-        overlayIcon = PhUpdateIconIoHistory(statistics);
-        break;
-    case TASKBAR_ICON_COMMIT_HISTORY:
-        overlayIcon = PhUpdateIconCommitHistory(statistics);
-        break;
-    case TASKBAR_ICON_PHYSICAL_HISTORY:
-        overlayIcon = PhUpdateIconPhysicalHistory(statistics);
-        break;
-    case TASKBAR_ICON_CPU_USAGE:
-        overlayIcon = PhUpdateIconCpuUsage(statistics);
-        break;
-    }
+    PhPluginGetSystemStatistics(&statistics);
 
-    if (overlayIcon)
+    // Only hand the taskbar a new icon when the pixels actually changed.
+    if (overlayIcon = PhUpdateOverlayIcon(TaskbarIconType, &statistics))
     {
         if (TaskbarListClass)
         {
@@ -161,6 +164,9 @@ LRESULT CALLBACK MainWndSubclassProc(
                 // Set the initial ThumbBar icon
                 ITaskbarList3_SetOverlayIcon(TaskbarListClass, PhMainWndHandle, BlackIcon, NULL);
             }
+
+            // The taskbar button was (re)created, so the overlay has to be sent again.
+            InvalidateOverlayIcon();
         }
     }
 
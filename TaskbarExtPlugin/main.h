@@ -59,24 +59,17 @@ HICON PhGetBlackIcon(
     VOID
     );
 
-HICON PhUpdateIconCpuHistory(
-    _In_ PH_PLUGIN_SYSTEM_STATISTICS Statistics
-    );
-
-HICON PhUpdateIconIoHistory(
-    _In_ PH_PLUGIN_SYSTEM_STATISTICS Statistics
-    );
-
-HICON PhUpdateIconCommitHistory(
-    _In_ PH_PLUGIN_SYSTEM_STATISTICS Statistics
+VOID PhResetOverlayIcon(
+    VOID
     );
 
-HICON PhUpdateIconPhysicalHistory(
-    _In_ PH_PLUGIN_SYSTEM_STATISTICS Statistics
+HICON PhUpdateOverlayIcon(
+    _In_ TASKBAR_ICON IconType,
+    _In_ PPH_PLUGIN_SYSTEM_STATISTICS Statistics
     );
 
-HICON PhUpdateIconCpuUsage(
-    _In_ PH_PLUGIN_SYSTEM_STATISTICS Statistics
+VOID InvalidateOverlayIcon(
+    VOID
     );
 
 #endif _TB_EXT_H_
@@ -23,6 +23,11 @@
 
 #include "main.h"
 
+#define PH_NF_ICON_SIZE 16
+#define PH_NF_HISTORY_STEP 2
+// Samples redrawn on each tick: the new one, plus the two it connects to.
+#define PH_NF_HISTORY_TAIL_COUNT 3
+
 typedef struct _PH_NF_BITMAP
 {
     BOOLEAN Initialized;
@@ -32,10 +37,32 @@ typedef struct _PH_NF_BITMAP
     PVOID Bits;
 } PH_NF_BITMAP, *PPH_NF_BITMAP;
 
+// State kept between ticks so the overlay can be redrawn incrementally.
+typedef struct _PH_NF_OVERLAY_STATE
+{
+    TASKBAR_ICON IconType;
+    BOOLEAN Published; // PublishedBits holds what the taskbar is showing
+    BOOLEAN HistoryValid; // HistoryData holds the newest samples of the bitmap
+    ULONG HistoryDataCount;
+    FLOAT HistoryScale; // value the samples were normalized by
+    FLOAT HistoryData1[PH_NF_HISTORY_TAIL_COUNT];
+    FLOAT HistoryData2[PH_NF_HISTORY_TAIL_COUNT];
+
+    COLORREF CpuKernelColor;
+    COLORREF CpuUserColor;
+    COLORREF IoReadOtherColor;
+    COLORREF IoWriteColor;
+    COLORREF PrivateColor;
+    COLORREF PhysicalColor;
+
+    ULONG PublishedBits[PH_NF_ICON_SIZE * PH_NF_ICON_SIZE];
+} PH_NF_OVERLAY_STATE, *PPH_NF_OVERLAY_STATE;
+
 static PH_NF_BITMAP PhDefaultBitmapContext = { 0 };
 static PH_NF_BITMAP PhBlackBitmapContext = { 0 };
 static HBITMAP PhBlackBitmap = NULL;
 static HICON PhBlackIcon = NULL;
+static PH_NF_OVERLAY_STATE PhOverlayState = { 0 };
 
 static VOID PhBeginBitmap2(
     _Inout_ PPH_NF_BITMAP Context,
@@ -133,16 +160,131 @@ HICON PhGetBlackIcon(
     return PhBlackIcon;
 }
 
-HICON PhUpdateIconCpuHistory(
-    _In_ PH_PLUGIN_SYSTEM_STATISTICS Statistics
+/*
+ * Reads the graph colors. Returns TRUE if any of them changed.
+ */
+static BOOLEAN PhLoadOverlayColors(
+    _Inout_ PPH_NF_OVERLAY_STATE State
+    )
+{
+    COLORREF cpuKernelColor = PhGetIntegerSetting(L"ColorCpuKernel");
+    COLORREF cpuUserColor = PhGetIntegerSetting(L"ColorCpuUser");
+    COLORREF ioReadOtherColor = PhGetIntegerSetting(L"ColorIoReadOther");
+    COLORREF ioWriteColor = PhGetIntegerSetting(L"ColorIoWrite");
+    COLORREF privateColor = PhGetIntegerSetting(L"ColorPrivate");
+    COLORREF physicalColor = PhGetIntegerSetting(L"ColorPhysical");
+
+    if (State->CpuKernelColor == cpuKernelColor &&
+        State->CpuUserColor == cpuUserColor &&
+        State->IoReadOtherColor == ioReadOtherColor &&
+        State->IoWriteColor == ioWriteColor &&
+        State->PrivateColor == privateColor &&
+        State->PhysicalColor == physicalColor)
+    {
+        return FALSE;
+    }
+
+    State->CpuKernelColor = cpuKernelColor;
+    State->CpuUserColor = cpuUserColor;
+    State->IoReadOtherColor = ioReadOtherColor;
+    State->IoWriteColor = ioWriteColor;
+    State->PrivateColor = privateColor;
+    State->PhysicalColor = physicalColor;
+
+    return TRUE;
+}
+
+/*
+ * Draws a history graph into the overlay bitmap. When the data is the previous
+ * tick's data shifted by one sample, the bitmap is scrolled left by one step and
+ * only the newest segments are drawn; otherwise (first draw, new scale, history
+ * still filling up) the whole graph is redrawn. Scale is the value the samples
+ * were normalized by; comparing the newest samples alone cannot detect a change
+ * of scale when they are zero.
+ */
+static VOID PhDrawHistoryGraph(
+    _In_ HDC Hdc,
+    _In_ PULONG Bits,
+    _Inout_ PPH_GRAPH_DRAW_INFO DrawInfo,
+    _In_ ULONG MaxDataCount,
+    _In_ FLOAT Scale
+    )
+{
+    PPH_NF_OVERLAY_STATE state = &PhOverlayState;
+    BOOLEAN scroll = FALSE;
+    ULONG tailCount;
+    ULONG i;
+
+    if (state->HistoryValid && state->HistoryScale == Scale &&
+        DrawInfo->LineDataCount == MaxDataCount && state->HistoryDataCount == MaxDataCount)
+    {
+        scroll = TRUE;
+
+        for (i = 0; i < PH_NF_HISTORY_TAIL_COUNT - 1; i++)
+        {
+            if (DrawInfo->LineData1[i + 1] != state->HistoryData1[i] ||
+                (DrawInfo->LineData2 && DrawInfo->LineData2[i + 1] != state->HistoryData2[i]))
+            {
+                scroll = FALSE;
+                break;
+            }
+        }
+    }
+
+    if (scroll)
+    {
+        ULONG tailWidth = (PH_NF_HISTORY_TAIL_COUNT - 1) * PH_NF_HISTORY_STEP;
+        ULONG tailBits[(PH_NF_HISTORY_TAIL_COUNT - 1) * PH_NF_HISTORY_STEP * PH_NF_ICON_SIZE];
+        PH_GRAPH_DRAW_INFO tailDrawInfo;
+        ULONG y;
+
+        for (y = 0; y < PH_NF_ICON_SIZE; y++)
+        {
+            PULONG row = Bits + y * PH_NF_ICON_SIZE;
+
+            memmove(row, row + PH_NF_HISTORY_STEP, (PH_NF_ICON_SIZE - PH_NF_HISTORY_STEP) * sizeof(ULONG));
+        }
+
+        tailDrawInfo = *DrawInfo;
+        tailDrawInfo.Width = tailWidth;
+        tailDrawInfo.LineDataCount = PH_NF_HISTORY_TAIL_COUNT;
+        PhDrawGraphDirect(Hdc, tailBits, &tailDrawInfo);
+
+        for (y = 0; y < PH_NF_ICON_SIZE; y++)
+        {
+            memcpy(
+                Bits + y * PH_NF_ICON_SIZE + PH_NF_ICON_SIZE - tailWidth,
+                tailBits + y * tailWidth,
+                tailWidth * sizeof(ULONG)
+                );
+        }
+    }
+    else
+    {
+        PhDrawGraphDirect(Hdc, Bits, DrawInfo);
+    }
+
+    tailCount = min(DrawInfo->LineDataCount, PH_NF_HISTORY_TAIL_COUNT);
+    memcpy(state->HistoryData1, DrawInfo->LineData1, tailCount * sizeof(FLOAT));
+    if (DrawInfo->LineData2)
+        memcpy(state->HistoryData2, DrawInfo->LineData2, tailCount * sizeof(FLOAT));
+    state->HistoryDataCount = DrawInfo->LineDataCount;
+    state->HistoryScale = Scale;
+    state->HistoryValid = TRUE;
+}
+
+static VOID PhDrawIconCpuHistory(
+    _In_ PPH_PLUGIN_SYSTEM_STATISTICS Statistics,
+    _In_ HDC Hdc,
+    _In_ PVOID Bits
     )
 {
     static PH_GRAPH_DRAW_INFO drawInfo =
     {
-        16,
-        16,
+        PH_NF_ICON_SIZE,
+        PH_NF_ICON_SIZE,
         PH_GRAPH_USE_LINE_2,
-        2,
+        PH_NF_HISTORY_STEP,
         RGB(0x00, 0x00, 0x00),
         16,
         NULL,
@@ -154,51 +296,37 @@ HICON PhUpdateIconCpuHistory(
     };
     ULONG maxDataCount;
     ULONG lineDataCount;
-    PFLOAT lineData1;
-    PFLOAT lineData2;
-    HBITMAP bitmap;
-    PVOID bits;
-    HDC hdc;
-    HBITMAP oldBitmap;
-    HICON icon;
-
-    // Icon
-    PhBeginBitmap(&drawInfo.Width, &drawInfo.Height, &bitmap, &bits, &hdc, &oldBitmap);
-    maxDataCount = drawInfo.Width / 2 + 1;
-    lineData1 = _alloca(maxDataCount * sizeof(FLOAT));
-    lineData2 = _alloca(maxDataCount * sizeof(FLOAT));
+    FLOAT lineData1[PH_NF_ICON_SIZE / PH_NF_HISTORY_STEP + 1];
+    FLOAT lineData2[PH_NF_ICON_SIZE / PH_NF_HISTORY_STEP + 1];
 
-    lineDataCount = min(maxDataCount, Statistics.CpuKernelHistory->Count);
-    PhCopyCircularBuffer_FLOAT(Statistics.CpuKernelHistory, lineData1, lineDataCount);
-    PhCopyCircularBuffer_FLOAT(Statistics.CpuUserHistory, lineData2, lineDataCount);
+    maxDataCount = PH_NF_ICON_SIZE / PH_NF_HISTORY_STEP + 1;
+    lineDataCount = min(maxDataCount, Statistics->CpuKernelHistory->Count);
+    PhCopyCircularBuffer_FLOAT(Statistics->CpuKernelHistory, lineData1, lineDataCount);
+    PhCopyCircularBuffer_FLOAT(Statistics->CpuUserHistory, lineData2, lineDataCount);
 
     drawInfo.LineDataCount = lineDataCount;
     drawInfo.LineData1 = lineData1;
     drawInfo.LineData2 = lineData2;
-    drawInfo.LineColor1 = PhGetIntegerSetting(L"ColorCpuKernel");
-    drawInfo.LineColor2 = PhGetIntegerSetting(L"ColorCpuUser");
+    drawInfo.LineColor1 = PhOverlayState.CpuKernelColor;
+    drawInfo.LineColor2 = PhOverlayState.CpuUserColor;
     drawInfo.LineBackColor1 = PhHalveColorBrightness(drawInfo.LineColor1);
     drawInfo.LineBackColor2 = PhHalveColorBrightness(drawInfo.LineColor2);
 
-    if (bits)
-        PhDrawGraphDirect(hdc, bits, &drawInfo);
-
-    SelectObject(hdc, oldBitmap);
-    icon = PhBitmapToIcon(bitmap);
-
-    return icon;
+    PhDrawHistoryGraph(Hdc, Bits, &drawInfo, maxDataCount, 1);
 }
 
-HICON PhUpdateIconIoHistory(
-    _In_ PH_PLUGIN_SYSTEM_STATISTICS Statistics
+static VOID PhDrawIconIoHistory(
+    _In_ PPH_PLUGIN_SYSTEM_STATISTICS Statistics,
+    _In_ HDC Hdc,
+    _In_ PVOID Bits
     )
 {
     static PH_GRAPH_DRAW_INFO drawInfo =
     {
-        16,
-        16,
+        PH_NF_ICON_SIZE,
+        PH_NF_ICON_SIZE,
         PH_GRAPH_USE_LINE_2,
-        2,
+        PH_NF_HISTORY_STEP,
         RGB(0x00, 0x00, 0x00),
         16,
         NULL,
@@ -210,65 +338,52 @@ HICON PhUpdateIconIoHistory(
     };
     ULONG maxDataCount;
     ULONG lineDataCount;
-    PFLOAT lineData1;
-    PFLOAT lineData2;
+    FLOAT lineData1[PH_NF_ICON_SIZE / PH_NF_HISTORY_STEP + 1];
+    FLOAT lineData2[PH_NF_ICON_SIZE / PH_NF_HISTORY_STEP + 1];
     FLOAT max;
     ULONG i;
-    HBITMAP bitmap;
-    PVOID bits;
-    HDC hdc;
-    HBITMAP oldBitmap;
-    HICON icon;
 
-    // Icon
-    PhBeginBitmap(&drawInfo.Width, &drawInfo.Height, &bitmap, &bits, &hdc, &oldBitmap);
-    maxDataCount = drawInfo.Width / 2 + 1;
-    lineData1 = _alloca(maxDataCount * sizeof(FLOAT));
-    lineData2 = _alloca(maxDataCount * sizeof(FLOAT));
-
-    lineDataCount = min(maxDataCount, Statistics.IoReadHistory->Count);
+    maxDataCount = PH_NF_ICON_SIZE / PH_NF_HISTORY_STEP + 1;
+    lineDataCount = min(maxDataCount, Statistics->IoReadHistory->Count);
     max = 1024 * 1024; // minimum scaling of 1 MB.
 
     for (i = 0; i < lineDataCount; i++)
     {
-        lineData1[i] = (FLOAT)PhGetItemCircularBuffer_ULONG64(Statistics.IoReadHistory, i) 
-                     + (FLOAT)PhGetItemCircularBuffer_ULONG64(Statistics.IoOtherHistory, i);
-        lineData2[i] = (FLOAT)PhGetItemCircularBuffer_ULONG64(Statistics.IoWriteHistory, i);
+        lineData1[i] = (FLOAT)PhGetItemCircularBuffer_ULONG64(Statistics->IoReadHistory, i)
+                     + (FLOAT)PhGetItemCircularBuffer_ULONG64(Statistics->IoOtherHistory, i);
+        lineData2[i] = (FLOAT)PhGetItemCircularBuffer_ULONG64(Statistics->IoWriteHistory, i);
 
         if (max < lineData1[i] + lineData2[i])
             max = lineData1[i] + lineData2[i];
     }
 
+    // A new maximum, including one from an old burst leaving the window, forces a full redraw.
     PhDivideSinglesBySingle(lineData1, max, lineDataCount);
     PhDivideSinglesBySingle(lineData2, max, lineDataCount);
 
     drawInfo.LineDataCount = lineDataCount;
     drawInfo.LineData1 = lineData1;
     drawInfo.LineData2 = lineData2;
-    drawInfo.LineColor1 = PhGetIntegerSetting(L"ColorIoReadOther");
-    drawInfo.LineColor2 = PhGetIntegerSetting(L"ColorIoWrite");
+    drawInfo.LineColor1 = PhOverlayState.IoReadOtherColor;
+    drawInfo.LineColor2 = PhOverlayState.IoWriteColor;
     drawInfo.LineBackColor1 = PhHalveColorBrightness(drawInfo.LineColor1);
     drawInfo.LineBackColor2 = PhHalveColorBrightness(drawInfo.LineColor2);
 
-    if (bits)
-        PhDrawGraphDirect(hdc, bits, &drawInfo);
-
-    SelectObject(hdc, oldBitmap);
-    icon = PhBitmapToIcon(bitmap);
-
-    return icon;
+    PhDrawHistoryGraph(Hdc, Bits, &drawInfo, maxDataCount, max);
 }
 
-HICON PhUpdateIconCommitHistory(
-    _In_ PH_PLUGIN_SYSTEM_STATISTICS Statistics
+static VOID PhDrawIconCommitHistory(
+    _In_ PPH_PLUGIN_SYSTEM_STATISTICS Statistics,
+    _In_ HDC Hdc,
+    _In_ PVOID Bits
     )
 {
     static PH_GRAPH_DRAW_INFO drawInfo =
     {
-        16,
-        16,
+        PH_NF_ICON_SIZE,
+        PH_NF_ICON_SIZE,
         0,
-        2,
+        PH_NF_HISTORY_STEP,
         RGB(0x00, 0x00, 0x00),
         16,
         NULL,
@@ -280,50 +395,37 @@ HICON PhUpdateIconCommitHistory(
     };
     ULONG maxDataCount;
     ULONG lineDataCount;
-    PFLOAT lineData1;
+    FLOAT lineData1[PH_NF_ICON_SIZE / PH_NF_HISTORY_STEP + 1];
     ULONG i;
-    HBITMAP bitmap;
-    PVOID bits;
-    HDC hdc;
-    HBITMAP oldBitmap;
-    HICON icon;
-
-    // Icon
-    PhBeginBitmap(&drawInfo.Width, &drawInfo.Height, &bitmap, &bits, &hdc, &oldBitmap);
-    maxDataCount = drawInfo.Width / 2 + 1;
-    lineData1 = _alloca(maxDataCount * sizeof(FLOAT));
 
-    lineDataCount = min(maxDataCount, Statistics.CommitHistory->Count);
+    maxDataCount = PH_NF_ICON_SIZE / PH_NF_HISTORY_STEP + 1;
+    lineDataCount = min(maxDataCount, Statistics->CommitHistory->Count);
 
     for (i = 0; i < lineDataCount; i++)
-        lineData1[i] = (FLOAT)PhGetItemCircularBuffer_ULONG(Statistics.CommitHistory, i);
+        lineData1[i] = (FLOAT)PhGetItemCircularBuffer_ULONG(Statistics->CommitHistory, i);
 
-    PhDivideSinglesBySingle(lineData1, (FLOAT)Statistics.Performance->CommitLimit, lineDataCount);
+    PhDivideSinglesBySingle(lineData1, (FLOAT)Statistics->Performance->CommitLimit, lineDataCount);
 
     drawInfo.LineDataCount = lineDataCount;
     drawInfo.LineData1 = lineData1;
-    drawInfo.LineColor1 = PhGetIntegerSetting(L"ColorPrivate");
+    drawInfo.LineColor1 = PhOverlayState.PrivateColor;
     drawInfo.LineBackColor1 = PhHalveColorBrightness(drawInfo.LineColor1);
 
-    if (bits)
-        PhDrawGraphDirect(hdc, bits, &drawInfo);
-
-    SelectObject(hdc, oldBitmap);
-    icon = PhBitmapToIcon(bitmap);
-
-    return icon;
+    PhDrawHistoryGraph(Hdc, Bits, &drawInfo, maxDataCount, (FLOAT)Statistics->Performance->CommitLimit);
 }
 
-HICON PhUpdateIconPhysicalHistory(
-    _In_ PH_PLUGIN_SYSTEM_STATISTICS Statistics
+static VOID PhDrawIconPhysicalHistory(
+    _In_ PPH_PLUGIN_SYSTEM_STATISTICS Statistics,
+    _In_ HDC Hdc,
+    _In_ PVOID Bits
     )
 {
     static PH_GRAPH_DRAW_INFO drawInfo =
     {
-        16,
-        16,
+        PH_NF_ICON_SIZE,
+        PH_NF_ICON_SIZE,
         0,
-        2,
+        PH_NF_HISTORY_STEP,
         RGB(0x00, 0x00, 0x00),
         16,
         NULL,
@@ -335,62 +437,44 @@ HICON PhUpdateIconPhysicalHistory(
     };
     ULONG maxDataCount;
     ULONG lineDataCount;
-    PFLOAT lineData1;
+    FLOAT lineData1[PH_NF_ICON_SIZE / PH_NF_HISTORY_STEP + 1];
     ULONG i;
-    HBITMAP bitmap;
-    PVOID bits;
-    HDC hdc;
-    HBITMAP oldBitmap;
-    HICON icon;
 
-    // Icon
-    PhBeginBitmap(&drawInfo.Width, &drawInfo.Height, &bitmap, &bits, &hdc, &oldBitmap);
-    maxDataCount = drawInfo.Width / 2 + 1;
-    lineData1 = _alloca(maxDataCount * sizeof(FLOAT));
-
-    lineDataCount = min(maxDataCount, Statistics.CommitHistory->Count);
+    maxDataCount = PH_NF_ICON_SIZE / PH_NF_HISTORY_STEP + 1;
+    lineDataCount = min(maxDataCount, Statistics->PhysicalHistory->Count);
 
     for (i = 0; i < lineDataCount; i++)
-        lineData1[i] = (FLOAT)PhGetItemCircularBuffer_ULONG(Statistics.PhysicalHistory, i);
+        lineData1[i] = (FLOAT)PhGetItemCircularBuffer_ULONG(Statistics->PhysicalHistory, i);
 
     PhDivideSinglesBySingle(lineData1, (FLOAT)PhSystemBasicInformation.NumberOfPhysicalPages, lineDataCount);
 
     drawInfo.LineDataCount = lineDataCount;
     drawInfo.LineData1 = lineData1;
-    drawInfo.LineColor1 = PhGetIntegerSetting(L"ColorPhysical");
+    drawInfo.LineColor1 = PhOverlayState.PhysicalColor;
     drawInfo.LineBackColor1 = PhHalveColorBrightness(drawInfo.LineColor1);
 
-    if (bits)
-        PhDrawGraphDirect(hdc, bits, &drawInfo);
-
-    SelectObject(hdc, oldBitmap);
-    icon = PhBitmapToIcon(bitmap);
-
-    return icon;
+    PhDrawHistoryGraph(Hdc, Bits, &drawInfo, maxDataCount, (FLOAT)PhSystemBasicInformation.NumberOfPhysicalPages);
 }
 
-HICON PhUpdateIconCpuUsage(
-    _In_ PH_PLUGIN_SYSTEM_STATISTICS Statistics
+static VOID PhDrawIconCpuUsage(
+    _In_ PPH_PLUGIN_SYSTEM_STATISTICS Statistics,
+    _In_ HDC Hdc,
+    _In_ ULONG Width,
+    _In_ ULONG Height
     )
 {
-    ULONG width;
-    ULONG height;
-    HBITMAP bitmap;
-    HDC hdc;
-    HBITMAP oldBitmap;
-    HICON icon;
-
-    // Icon
-    PhBeginBitmap(&width, &height, &bitmap, NULL, &hdc, &oldBitmap);
+    HDC hdc = Hdc;
+    ULONG width = Width;
+    ULONG height = Height;
 
     // This stuff is copied from CpuUsageIcon.cs (PH 1.x).
     {
-        COLORREF kColor = PhGetIntegerSetting(L"ColorCpuKernel");
-        COLORREF uColor = PhGetIntegerSetting(L"ColorCpuUser");
+        COLORREF kColor = PhOverlayState.CpuKernelColor;
+        COLORREF uColor = PhOverlayState.CpuUserColor;
         COLORREF kbColor = PhHalveColorBrightness(kColor);
         COLORREF ubColor = PhHalveColorBrightness(uColor);
-        FLOAT k = Statistics.CpuKernelUsage;
-        FLOAT u = Statistics.CpuUserUsage;
+        FLOAT k = Statistics->CpuKernelUsage;
+        FLOAT u = Statistics->CpuUserUsage;
         LONG kl = (LONG)(k * height);
         LONG ul = (LONG)(u * height);
         RECT rect;
@@ -457,8 +541,90 @@ HICON PhUpdateIconCpuUsage(
         }
     }
 
+    GdiFlush();
+}
+
+/*
+ * Forgets the incremental drawing state, so that the next update redraws and
+ * republishes the overlay in full.
+ */
+VOID PhResetOverlayIcon(
+    VOID
+    )
+{
+    PhOverlayState.Published = FALSE;
+    PhOverlayState.HistoryValid = FALSE;
+}
+
+/*
+ * Draws the overlay for IconType into the persistent bitmap. Returns a new icon
+ * only if the pixels differ from what was last returned, otherwise NULL.
+ */
+HICON PhUpdateOverlayIcon(
+    _In_ TASKBAR_ICON IconType,
+    _In_ PPH_PLUGIN_SYSTEM_STATISTICS Statistics
+    )
+{
+    PPH_NF_OVERLAY_STATE state = &PhOverlayState;
+    ULONG width;
+    ULONG height;
+    HBITMAP bitmap;
+    PVOID bits;
+    HDC hdc;
+    HBITMAP oldBitmap;
+    HICON icon = NULL;
+
+    if (state->IconType != IconType)
+    {
+        state->IconType = IconType;
+        state->Published = FALSE;
+        state->HistoryValid = FALSE;
+    }
+
+    // The graph colors are set in the main options window, which does not tell
+    // plugins when it closes. Reading six settings per update is cheap next to
+    // drawing, and a scrolled graph would keep the old colors.
+    if (PhLoadOverlayColors(state))
+        state->HistoryValid = FALSE;
+
+    PhBeginBitmap(&width, &height, &bitmap, &bits, &hdc, &oldBitmap);
+
+    if (!bits)
+    {
+        SelectObject(hdc, oldBitmap);
+        return NULL;
+    }
+
+    switch (IconType)
+    {
+    case TASKBAR_ICON_CPU_HISTORY:
+        PhDrawIconCpuHistory(Statistics, hdc, bits);
+        break;
+    case TASKBAR_ICON_IO_HISTORY:
+        PhDrawIconIoHistory(Statistics, hdc, bits);
+        break;
+    case TASKBAR_ICON_COMMIT_HISTORY:
+        PhDrawIconCommitHistory(Statistics, hdc, bits);
+        break;
+    case TASKBAR_ICON_PHYSICAL_HISTORY:
+        PhDrawIconPhysicalHistory(Statistics, hdc, bits);
+        break;
+    case TASKBAR_ICON_CPU_USAGE:
+        PhDrawIconCpuUsage(Statistics, hdc, width, height);
+        break;
+    default:
+        SelectObject(hdc, oldBitmap);
+        return NULL;
+    }
+
     SelectObject(hdc, oldBitmap);
-    icon = PhBitmapToIcon(bitmap);
+
+    if (!state->Published || memcmp(bits, state->PublishedBits, sizeof(state->PublishedBits)) != 0)
+    {
+        memcpy(state->PublishedBits, bits, sizeof(state->PublishedBits));
+        state->Published = TRUE;
+        icon = PhBitmapToIcon(bitmap);
+    }
 
     return icon;
-}
\ No newline at end of file
+}
@@ -104,6 +104,7 @@ INT_PTR CALLBACK OptionsDlgProc(
 
             graphTypeString = PH_AUTO(PhGetWindowText(GetDlgItem(hwndDlg, IDC_GRAPH_TYPE)));
             PhSetIntegerSetting(SETTING_NAME_TASKBAR_ICON_TYPE, GraphTypeGetTypeInteger(graphTypeString->Buffer));
+            InvalidateOverlayIcon();
         }
         break;
     }
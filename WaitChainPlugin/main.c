@@ -27,133 +27,225 @@
 
 static PPH_PLUGIN PluginInstance;
 static PH_CALLBACK_REGISTRATION PluginMenuItemCallbackRegistration;
+static PH_CALLBACK_REGISTRATION MainMenuInitializingCallbackRegistration;
 static PH_CALLBACK_REGISTRATION ProcessMenuInitializingCallbackRegistration;
 static PH_CALLBACK_REGISTRATION ThreadMenuInitializingCallbackRegistration;
 
-BOOLEAN WaitChainRegisterCallbacks(
-    _Inout_ PWCT_CONTEXT Context
+static BOOLEAN WaitChainRegisterCallbacks(
+    _Inout_ PWCT_COLLECTION Collection
     )
 {
     PCOGETCALLSTATE coGetCallStateCallback = NULL;
     PCOGETACTIVATIONSTATE coGetActivationStateCallback = NULL;
 
-    if (!(Context->Ole32ModuleHandle = LoadLibrary(L"ole32.dll")))
+    if (!(Collection->Ole32ModuleHandle = LoadLibrary(L"ole32.dll")))
         return FALSE;
 
-    if (!(coGetCallStateCallback = PhGetProcedureAddress(Context->Ole32ModuleHandle, "CoGetCallState", 0)))
+    if (!(coGetCallStateCallback = PhGetProcedureAddress(Collection->Ole32ModuleHandle, "CoGetCallState", 0)))
         return FALSE;
 
-    if (!(coGetActivationStateCallback = PhGetProcedureAddress(Context->Ole32ModuleHandle, "CoGetActivationState", 0)))
+    if (!(coGetActivationStateCallback = PhGetProcedureAddress(Collection->Ole32ModuleHandle, "CoGetActivationState", 0)))
         return FALSE;
 
     RegisterWaitChainCOMCallback(coGetCallStateCallback, coGetActivationStateCallback);
     return TRUE;
 }
 
-VOID WaitChainCheckThread(
-    _Inout_ PWCT_CONTEXT Context,
+VOID WaitChainDereferenceCollection(
+    _In_ PWCT_COLLECTION Collection
+    )
+{
+    if (InterlockedDecrement(&Collection->RefCount) != 0)
+        return;
+
+    if (Collection->WctSessionHandle)
+        CloseThreadWaitChainSession(Collection->WctSessionHandle);
+    if (Collection->SlotSemaphoreHandle)
+        NtClose(Collection->SlotSemaphoreHandle);
+    if (Collection->Ole32ModuleHandle)
+        FreeLibrary(Collection->Ole32ModuleHandle);
+    if (Collection->ProcessItem)
+        PhDereferenceObject(Collection->ProcessItem);
+
+    PhFree(Collection);
+}
+
+static VOID CALLBACK WaitChainCallback(
+    _In_ HWCT WctHandle,
+    _In_ DWORD_PTR Context,
+    _In_ DWORD CallbackStatus,
+    _In_ LPDWORD NodeCount,
+    _In_ PWAITCHAIN_NODE_INFO NodeInfoArray,
+    _In_ LPBOOL IsCycle
+    )
+{
+    PWCT_REQUEST request = (PWCT_REQUEST)Context;
+    PWCT_COLLECTION collection = request->Collection;
+    BOOLEAN posted = FALSE;
+
+    request->Status = CallbackStatus;
+
+    if (CallbackStatus == ERROR_SUCCESS)
+    {
+        if (NodeCount)
+            request->NodeCount = *NodeCount;
+        if (IsCycle)
+            request->IsDeadLocked = *IsCycle;
+
+        // Check if the wait chain is too big for the array we passed in.
+        if (request->NodeCount > WCT_MAX_NODE_COUNT)
+            request->NodeCount = WCT_MAX_NODE_COUNT;
+
+        if (NodeInfoArray && NodeInfoArray != request->NodeInfoArray)
+            memcpy(request->NodeInfoArray, NodeInfoArray, request->NodeCount * sizeof(WAITCHAIN_NODE_INFO));
+    }
+
+    // The dialog owns the request from here on. Holding the lock keeps the dialog from
+    // draining its queue while a result is being posted.
+    PhAcquireQueuedLockShared(&collection->WindowLock);
+
+    if (collection->WindowHandle)
+        posted = !!PostMessage(collection->WindowHandle, WM_WCT_RESULT, 0, (LPARAM)request);
+
+    PhReleaseQueuedLockShared(&collection->WindowLock);
+
+    if (!posted)
+        PhFree(request);
+
+    NtReleaseSemaphore(collection->SlotSemaphoreHandle, 1, NULL);
+    WaitChainDereferenceCollection(collection);
+}
+
+PWCT_COLLECTION WaitChainCreateCollection(
+    _In_ PWCT_CONTEXT Context,
+    _In_ HWND WindowHandle
+    )
+{
+    PWCT_COLLECTION collection;
+
+    collection = PhAllocate(sizeof(WCT_COLLECTION));
+    memset(collection, 0, sizeof(WCT_COLLECTION));
+
+    collection->RefCount = 1;
+    PhInitializeQueuedLock(&collection->WindowLock);
+    collection->WindowHandle = WindowHandle;
+    collection->IsSystemScan = Context->IsSystemScan;
+    collection->IsProcessItem = Context->IsProcessItem;
+
+    if (Context->IsProcessItem)
+        PhSetReference(&collection->ProcessItem, Context->ProcessItem);
+    else if (!Context->IsSystemScan)
+        collection->ThreadId = Context->ThreadItem->ThreadId;
+
+    if (!WaitChainRegisterCallbacks(collection))
+        goto CleanupExit;
+
+    if (!NT_SUCCESS(NtCreateSemaphore(
+        &collection->SlotSemaphoreHandle,
+        SEMAPHORE_ALL_ACCESS,
+        NULL,
+        WCT_MAXIMUM_PENDING_REQUESTS,
+        WCT_MAXIMUM_PENDING_REQUESTS
+        )))
+    {
+        goto CleanupExit;
+    }
+
+    // Asynchronous WCT session: results are delivered to WaitChainCallback.
+    if (!(collection->WctSessionHandle = OpenThreadWaitChainSession(WCT_ASYNC_OPEN_FLAG, WaitChainCallback)))
+        goto CleanupExit;
+
+    return collection;
+
+CleanupExit:
+    WaitChainDereferenceCollection(collection);
+    return NULL;
+}
+
+static VOID WaitChainQueueRequest(
+    _In_ PWCT_COLLECTION Collection,
     _In_ HANDLE ThreadId
     )
 {
-    BOOL isDeadLocked = FALSE;
-    ULONG nodeInfoLength = WCT_MAX_NODE_COUNT;
-    WAITCHAIN_NODE_INFO nodeInfoArray[WCT_MAX_NODE_COUNT];
-    PWCT_ROOT_NODE rootNode = NULL;
+    PWCT_REQUEST request;
+    LARGE_INTEGER timeout;
+
+    // Wait for a free slot. The wait is short so that cancellation is noticed.
+    while (NtWaitForSingleObject(
+        Collection->SlotSemaphoreHandle,
+        FALSE,
+        PhTimeoutFromMilliseconds(&timeout, WCT_UPDATE_INTERVAL)
+        ) == STATUS_TIMEOUT)
+    {
+        if (Collection->Cancelled)
+            return;
+    }
 
-    memset(nodeInfoArray, 0, sizeof(nodeInfoArray));
+    if (Collection->Cancelled)
+    {
+        NtReleaseSemaphore(Collection->SlotSemaphoreHandle, 1, NULL);
+        return;
+    }
+
+    request = PhAllocate(sizeof(WCT_REQUEST));
+    memset(request, 0, sizeof(WCT_REQUEST));
+    request->Collection = Collection;
+    request->NodeCount = WCT_MAX_NODE_COUNT;
+
+    InterlockedIncrement(&Collection->RefCount);
 
-    // Retrieve the thread wait chain.
     if (!GetThreadWaitChain(
-        Context->WctSessionHandle,
-        0,
+        Collection->WctSessionHandle,
+        (DWORD_PTR)request,
         WCT_GETINFO_ALL_FLAGS,
         HandleToUlong(ThreadId),
-        &nodeInfoLength,
-        nodeInfoArray,
-        &isDeadLocked
-        ))
+        &request->NodeCount,
+        request->NodeInfoArray,
+        &request->IsDeadLocked
+        ) && GetLastError() != ERROR_IO_PENDING)
     {
+        // The callback is never invoked for requests that fail to start.
+        PhFree(request);
+        NtReleaseSemaphore(Collection->SlotSemaphoreHandle, 1, NULL);
+        InterlockedDecrement(&Collection->RefCount);
         return;
     }
 
-    // Check if the wait chain is too big for the array we passed in.
-    if (nodeInfoLength > WCT_MAX_NODE_COUNT)
-        nodeInfoLength = WCT_MAX_NODE_COUNT;
+    InterlockedIncrement(&Collection->IssuedCount);
+}
 
+NTSTATUS WaitChainCollectionThread(
+    _In_ PVOID Parameter
+    )
+{
+    PWCT_COLLECTION collection = (PWCT_COLLECTION)Parameter;
+    LARGE_INTEGER timeout;
 
-    for (ULONG i = 0; i < nodeInfoLength; i++)
+    if (collection->IsSystemScan)
     {
-        PWAITCHAIN_NODE_INFO wctNode = &nodeInfoArray[i];
+        PVOID processes;
+        PSYSTEM_PROCESS_INFORMATION process;
 
-        if (wctNode->ObjectType == WctThreadType)
+        if (NT_SUCCESS(PhEnumProcesses(&processes)))
         {
-            rootNode = WeAddWindowNode(&Context->TreeContext);
-
-            rootNode->ObjectType = wctNode->ObjectType;
-            rootNode->ObjectStatus = wctNode->ObjectStatus;
-            rootNode->Alertable = wctNode->LockObject.Alertable;
-            rootNode->ThreadId = UlongToHandle(wctNode->ThreadObject.ThreadId);
-            rootNode->ProcessId = UlongToHandle(wctNode->ThreadObject.ProcessId);
-            rootNode->ThreadIdString = PhFormatString(L"%lu", wctNode->ThreadObject.ThreadId);
-            rootNode->ProcessIdString = PhFormatString(L"%lu", wctNode->ThreadObject.ProcessId);
-            rootNode->WaitTimeString = PhFormatString(L"%lu", wctNode->ThreadObject.WaitTime);
-            rootNode->ContextSwitchesString = PhFormatString(L"%lu", wctNode->ThreadObject.ContextSwitches);
-            rootNode->TimeoutString = PhFormatString(L"%I64d", wctNode->LockObject.Timeout.QuadPart);
-
-            if (wctNode->LockObject.ObjectName[0] != '\0')
+            process = PH_FIRST_PROCESS(processes);
+
+            do
             {
-                // -- ProcessID --
-                //wctNode->LockObject.ObjectName[0]
-                // -- ThreadID --
-                //wctNode->LockObject.ObjectName[2]
-                // -- Unknown --
-                //wctNode->LockObject.ObjectName[4]
-                // -- ContextSwitches --
-                //wctNode->LockObject.ObjectName[6]
-
-                if (PhIsDigitCharacter(wctNode->LockObject.ObjectName[0]))
+                // Skip the idle process and ourselves.
+                if (!process->UniqueProcessId || process->UniqueProcessId == NtCurrentProcessId())
+                    continue;
+
+                for (ULONG i = 0; i < process->NumberOfThreads && !collection->Cancelled; i++)
                 {
-                    rootNode->ObjectNameString = PhFormatString(L"%s", wctNode->LockObject.ObjectName);
+                    WaitChainQueueRequest(collection, process->Threads[i].ClientId.UniqueThread);
                 }
-                //else
-                //{
-                //    rootNode->ObjectNameString = PhFormatString(L"[%lu, %lu]",
-                //        wctNode.LockObject.ObjectName[0],
-                //        wctNode.LockObject.ObjectName[2]
-                //        );
-                //}
-            }
-
-            rootNode->Node.Expanded = TRUE;
-            rootNode->HasChildren = TRUE;
+            } while (!collection->Cancelled && (process = PH_NEXT_PROCESS(process)));
 
-            // This is a root node.
-            PhAddItemList(Context->TreeContext.NodeRootList, rootNode);
-        }
-        else
-        {
-            WctAddChildWindowNode(&Context->TreeContext, rootNode, wctNode, isDeadLocked);
+            PhFree(processes);
         }
     }
-}
-
-NTSTATUS WaitChainCallbackThread(
-    _In_ PVOID Parameter
-    )
-{
-    NTSTATUS status = STATUS_SUCCESS;
-    PWCT_CONTEXT context = (PWCT_CONTEXT)Parameter;
-
-    if (!WaitChainRegisterCallbacks(context))
-        return NTSTATUS_FROM_WIN32(GetLastError());
-
-    // Synchronous WCT session
-    if (!(context->WctSessionHandle = OpenThreadWaitChainSession(0, NULL)))
-        return NTSTATUS_FROM_WIN32(GetLastError());
-
-    //TreeNew_SetRedraw(context->TreeNewHandle, FALSE);
-    
-    if (context->IsProcessItem)
+    else if (collection->IsProcessItem)
     {
         NTSTATUS status;
         HANDLE threadHandle;
@@ -161,7 +253,7 @@ NTSTATUS WaitChainCallbackThread(
         THREAD_BASIC_INFORMATION basicInfo;
 
         status = NtGetNextThread(
-            context->ProcessItem->QueryHandle,
+            collection->ProcessItem->QueryHandle,
             NULL,
             THREAD_QUERY_LIMITED_INFORMATION,
             0,
@@ -171,17 +263,23 @@ NTSTATUS WaitChainCallbackThread(
 
         while (NT_SUCCESS(status))
         {
+            if (collection->Cancelled)
+            {
+                NtClose(threadHandle);
+                break;
+            }
+
             if (NT_SUCCESS(PhGetThreadBasicInformation(threadHandle, &basicInfo)))
             {
-                WaitChainCheckThread(context, basicInfo.ClientId.UniqueThread);
+                WaitChainQueueRequest(collection, basicInfo.ClientId.UniqueThread);
             }
 
             status = NtGetNextThread(
-                context->ProcessItem->QueryHandle, 
-                threadHandle, 
+                collection->ProcessItem->QueryHandle,
+                threadHandle,
                 THREAD_QUERY_LIMITED_INFORMATION,
-                0, 
-                0, 
+                0,
+                0,
                 &newThreadHandle
                 );
 
@@ -191,23 +289,176 @@ NTSTATUS WaitChainCallbackThread(
     }
     else
     {
-        WaitChainCheckThread(context, context->ThreadItem->ThreadId);
+        WaitChainQueueRequest(collection, collection->ThreadId);
+    }
+
+    if (collection->Cancelled)
+    {
+        // Closing the session cancels the requests that are still outstanding.
+        CloseThreadWaitChainSession(collection->WctSessionHandle);
+        collection->WctSessionHandle = NULL;
+    }
+
+    // Wait for the outstanding requests by taking back every slot. The requests hold
+    // their own references, so giving up after a cancel is safe.
+    for (ULONG i = 0; i < WCT_MAXIMUM_PENDING_REQUESTS; i++)
+    {
+        if (NtWaitForSingleObject(
+            collection->SlotSemaphoreHandle,
+            FALSE,
+            collection->Cancelled ? PhTimeoutFromMilliseconds(&timeout, 5000) : NULL
+            ) != STATUS_SUCCESS)
+        {
+            break;
+        }
+    }
+
+    // Close the session here rather than on the last dereference, which may happen
+    // inside a WCT callback.
+    if (collection->WctSessionHandle)
+    {
+        CloseThreadWaitChainSession(collection->WctSessionHandle);
+        collection->WctSessionHandle = NULL;
+    }
+
+    PhAcquireQueuedLockShared(&collection->WindowLock);
+
+    if (collection->WindowHandle)
+        PostMessage(collection->WindowHandle, WM_WCT_FINISHED, 0, 0);
+
+    PhReleaseQueuedLockShared(&collection->WindowLock);
+
+    WaitChainDereferenceCollection(collection);
+
+    return STATUS_SUCCESS;
+}
+
+static PWAIT_GRAPH_NODE WaitChainAddGraphNode(
+    _Inout_ PWCT_CONTEXT Context,
+    _In_ PWAITCHAIN_NODE_INFO WctNode
+    )
+{
+    PH_STRINGREF objectName;
+
+    if (WctNode->ObjectType == WctThreadType)
+    {
+        return WaitGraphAddThread(
+            &Context->Graph,
+            WctNode->ObjectType,
+            UlongToHandle(WctNode->ThreadObject.ThreadId),
+            UlongToHandle(WctNode->ThreadObject.ProcessId)
+            );
+    }
+
+    // Locks are matched between chains by type and name. Unnamed locks (most critical
+    // sections) only join the chain they were reported in.
+    objectName.Buffer = WctNode->LockObject.ObjectName;
+    objectName.Length = PhCountStringZ(WctNode->LockObject.ObjectName) * sizeof(WCHAR);
+
+    return WaitGraphAddObject(&Context->Graph, WctNode->ObjectType, &objectName);
+}
+
+VOID WaitChainAddChain(
+    _Inout_ PWCT_CONTEXT Context,
+    _In_ PWCT_REQUEST Request
+    )
+{
+    PWCT_ROOT_NODE rootNode = NULL;
+    PWAIT_GRAPH_NODE previousGraphNode = NULL;
+
+    for (ULONG i = 0; i < Request->NodeCount; i++)
+    {
+        PWAITCHAIN_NODE_INFO wctNode = &Request->NodeInfoArray[i];
+        PWAIT_GRAPH_NODE graphNode;
+
+        // Each node in a chain waits on the node that follows it.
+        graphNode = WaitChainAddGraphNode(Context, wctNode);
+
+        if (previousGraphNode)
+            WaitGraphAddEdge(&Context->Graph, previousGraphNode, graphNode);
+
+        previousGraphNode = graphNode;
+
+        if (wctNode->ObjectType == WctThreadType)
+        {
+            // Threads start a new root; the objects they wait on are listed under them.
+            rootNode = WctAddChildWindowNode(&Context->TreeContext, NULL, wctNode, !!Request->IsDeadLocked);
+            rootNode->GraphNode = graphNode;
+        }
+        else
+        {
+            PWCT_ROOT_NODE childNode;
+
+            childNode = WctAddChildWindowNode(&Context->TreeContext, rootNode, wctNode, !!Request->IsDeadLocked);
+            childNode->GraphNode = graphNode;
+        }
     }
+}
+
+static VOID WaitChainUpdateGraph(
+    _Inout_ PWCT_CONTEXT Context
+    )
+{
+    if (!Context->Graph.Dirty)
+        return;
 
-    if (context->WctSessionHandle)
+    WaitGraphAnalyze(&Context->Graph);
+
+    // Cycle membership decides the node color.
+    for (ULONG i = 0; i < Context->TreeContext.NodeList->Count; i++)
     {
-        CloseThreadWaitChainSession(context->WctSessionHandle);
+        PWCT_ROOT_NODE node = Context->TreeContext.NodeList->Items[i];
+
+        PhInvalidateTreeNewNode(&node->Node, TN_CACHE_COLOR);
     }
 
-    if (context->Ole32ModuleHandle)
+    InvalidateRect(Context->TreeNewHandle, NULL, FALSE);
+}
+
+static VOID WaitChainUpdateStatus(
+    _In_ PWCT_CONTEXT Context
+    )
+{
+    PH_STRING_BUILDER stringBuilder;
+    PPH_STRING status;
+    ULONG issuedCount = Context->Collection ? Context->Collection->IssuedCount : 0;
+    PWAIT_GRAPH_NODE chainHead;
+
+    PhInitializeStringBuilder(&stringBuilder, 100);
+
+    if (!Context->Finished)
+        PhAppendFormatStringBuilder(&stringBuilder, L"Analyzing threads... %lu of %lu complete", Context->CompletedCount, issuedCount);
+    else if (Context->Collection && Context->Collection->Cancelled)
+        PhAppendFormatStringBuilder(&stringBuilder, L"Stopped after %lu of %lu threads.", Context->CompletedCount, issuedCount);
+    else
+        PhAppendFormatStringBuilder(&stringBuilder, L"Analyzed %lu threads.", Context->CompletedCount);
+
+    if (Context->Graph.CycleCount != 0)
     {
-        FreeLibrary(context->Ole32ModuleHandle);
+        PhAppendFormatStringBuilder(
+            &stringBuilder,
+            L" %lu deadlock(s), %lu cross-process.",
+            Context->Graph.CycleCount,
+            Context->Graph.CrossProcessCycleCount
+            );
     }
 
-    //TreeNew_SetRedraw(context->TreeNewHandle, TRUE);
-    TreeNew_NodesStructured(context->TreeNewHandle);
+    chainHead = Context->Graph.LongestChainHead;
 
-    return status;
+    if (chainHead && chainHead->IsThread && Context->Graph.LongestChainLength > 1)
+    {
+        PhAppendFormatStringBuilder(
+            &stringBuilder,
+            L" Longest chain: %lu threads behind thread %lu (process %lu).",
+            Context->Graph.LongestChainLength,
+            HandleToUlong((HANDLE)chainHead->Id),
+            HandleToUlong(chainHead->ProcessId)
+            );
+    }
+
+    status = PhFinalStringBuilderString(&stringBuilder);
+    PhSetDialogItemText(Context->DialogHandle, IDC_STATUS, status->Buffer);
+    PhDereferenceObject(status);
 }
 
 INT_PTR CALLBACK WaitChainDlgProc(
@@ -230,10 +481,32 @@ INT_PTR CALLBACK WaitChainDlgProc(
 
         if (uMsg == WM_DESTROY)
         {
+            KillTimer(hwndDlg, WCT_UPDATE_TIMER_ID);
+
+            if (context->Collection)
+            {
+                MSG message;
+
+                // Stop the collection and make sure no more results are posted, then free
+                // the ones that are already queued.
+                InterlockedExchange(&context->Collection->Cancelled, TRUE);
+
+                PhAcquireQueuedLockExclusive(&context->Collection->WindowLock);
+                context->Collection->WindowHandle = NULL;
+                PhReleaseQueuedLockExclusive(&context->Collection->WindowLock);
+
+                while (PeekMessage(&message, hwndDlg, WM_WCT_RESULT, WM_WCT_RESULT, PM_REMOVE))
+                    PhFree((PWCT_REQUEST)message.lParam);
+
+                WaitChainDereferenceCollection(context->Collection);
+                context->Collection = NULL;
+            }
+
             PhUnregisterDialog(hwndDlg);
             PhSaveWindowPlacementToSetting(SETTING_NAME_WINDOW_POSITION, SETTING_NAME_WINDOW_SIZE, hwndDlg);
             PhDeleteLayoutManager(&context->LayoutManager);
             WtcDeleteWindowTree(&context->TreeContext);
+            WaitGraphDelete(&context->Graph);
 
             PhRemoveWindowContext(hwndDlg, PH_WINDOW_CONTEXT_DEFAULT);
             PhFree(context);
@@ -249,17 +522,91 @@ INT_PTR CALLBACK WaitChainDlgProc(
         {
             HANDLE threadHandle = NULL;
 
+            context->DialogHandle = hwndDlg;
             context->TreeNewHandle = GetDlgItem(hwndDlg, IDC_CUSTOM1);
 
+            if (context->IsSystemScan)
+                PhSetWindowText(hwndDlg, L"Wait Chain Traversal - All processes");
+
             PhRegisterDialog(hwndDlg);
+            WaitGraphInitialize(&context->Graph);
             WtcInitializeWindowTree(hwndDlg, context->TreeNewHandle, &context->TreeContext);
             PhInitializeLayoutManager(&context->LayoutManager, hwndDlg);
             PhAddLayoutItem(&context->LayoutManager, context->TreeNewHandle, NULL, PH_ANCHOR_ALL);
+            PhAddLayoutItem(&context->LayoutManager, GetDlgItem(hwndDlg, IDC_STATUS), NULL, PH_ANCHOR_LEFT | PH_ANCHOR_RIGHT | PH_ANCHOR_BOTTOM);
+            PhAddLayoutItem(&context->LayoutManager, GetDlgItem(hwndDlg, IDC_STOP), NULL, PH_ANCHOR_BOTTOM | PH_ANCHOR_RIGHT);
             PhAddLayoutItem(&context->LayoutManager, GetDlgItem(hwndDlg, IDOK), NULL, PH_ANCHOR_BOTTOM | PH_ANCHOR_RIGHT);
             PhLoadWindowPlacementFromSetting(SETTING_NAME_WINDOW_POSITION, SETTING_NAME_WINDOW_SIZE, hwndDlg);
 
-            if (threadHandle = PhCreateThread(0, WaitChainCallbackThread, (PVOID)context))
+            if (!(context->Collection = WaitChainCreateCollection(context, hwndDlg)))
+            {
+                PhSetDialogItemText(hwndDlg, IDC_STATUS, L"Unable to start a wait chain session.");
+                EnableWindow(GetDlgItem(hwndDlg, IDC_STOP), FALSE);
+                context->Finished = TRUE;
+                break;
+            }
+
+            // The collection thread holds its own reference.
+            InterlockedIncrement(&context->Collection->RefCount);
+
+            if (threadHandle = PhCreateThread(0, WaitChainCollectionThread, context->Collection))
+            {
                 NtClose(threadHandle);
+            }
+            else
+            {
+                WaitChainDereferenceCollection(context->Collection);
+                PostMessage(hwndDlg, WM_WCT_FINISHED, 0, 0);
+            }
+
+            SetTimer(hwndDlg, WCT_UPDATE_TIMER_ID, WCT_UPDATE_INTERVAL, NULL);
+            WaitChainUpdateStatus(context);
+        }
+        break;
+    case WM_WCT_RESULT:
+        {
+            PWCT_REQUEST request = (PWCT_REQUEST)lParam;
+
+            // Results are batched; the tree is restructured on the next timer tick.
+            if (request->Status == ERROR_SUCCESS)
+            {
+                WaitChainAddChain(context, request);
+                context->TreeDirty = TRUE;
+            }
+
+            context->CompletedCount++;
+            PhFree(request);
+        }
+        break;
+    case WM_WCT_FINISHED:
+        {
+            KillTimer(hwndDlg, WCT_UPDATE_TIMER_ID);
+            context->Finished = TRUE;
+
+            if (context->TreeDirty)
+            {
+                TreeNew_NodesStructured(context->TreeNewHandle);
+                context->TreeDirty = FALSE;
+            }
+
+            WaitChainUpdateGraph(context);
+            EnableWindow(GetDlgItem(hwndDlg, IDC_STOP), FALSE);
+            WaitChainUpdateStatus(context);
+        }
+        break;
+    case WM_TIMER:
+        {
+            if (wParam == WCT_UPDATE_TIMER_ID)
+            {
+                if (context->TreeDirty)
+                {
+                    TreeNew_NodesStructured(context->TreeNewHandle);
+                    context->TreeDirty = FALSE;
+                }
+
+                WaitChainUpdateGraph(context);
+                WaitChainUpdateStatus(context);
+            }
         }
         break;
     case WM_SIZE:
@@ -273,6 +620,14 @@ INT_PTR CALLBACK WaitChainDlgProc(
             case IDOK:
                 EndDialog(hwndDlg, IDOK);
                 break;
+            case IDC_STOP:
+                {
+                    if (context->Collection)
+                        InterlockedExchange(&context->Collection->Cancelled, TRUE);
+
+                    EnableWindow(GetDlgItem(hwndDlg, IDC_STOP), FALSE);
+                }
+                break;
             case ID_WCTSHOWCONTEXTMENU:
                 {
                     POINT point;
@@ -386,9 +741,43 @@ VOID NTAPI MenuItemCallback(
                 );
         }
         break;
+    case IDD_WCT_SYSTEM_MENUITEM:
+        {
+            PWCT_CONTEXT context;
+
+            context = PhAllocate(sizeof(WCT_CONTEXT));
+            memset(context, 0, sizeof(WCT_CONTEXT));
+            context->IsSystemScan = TRUE;
+
+            DialogBoxParam(
+                PluginInstance->DllBase,
+                MAKEINTRESOURCE(IDD_WCT_DIALOG),
+                NULL,
+                WaitChainDlgProc,
+                (LPARAM)context
+                );
+        }
+        break;
     }
 }
 
+VOID NTAPI MainMenuInitializingCallback(
+    _In_opt_ PVOID Parameter,
+    _In_opt_ PVOID Context
+    )
+{
+    PPH_PLUGIN_MENU_INFORMATION menuInfo = Parameter;
+    PPH_EMENU_ITEM menuItem;
+
+    if (menuInfo->u.MainMenu.SubMenuIndex != PH_MENU_ITEM_LOCATION_TOOLS)
+        return;
+
+    PhInsertEMenuItem(menuInfo->Menu, menuItem = PhPluginCreateEMenuItem(PluginInstance, 0, IDD_WCT_SYSTEM_MENUITEM, L"Find &deadlocks...", NULL), -1);
+
+    if (!PhGetOwnTokenAttributes().Elevated)
+        menuItem->Flags |= PH_EMENU_DISABLED;
+}
+
 VOID NTAPI ProcessMenuInitializingCallback(
     _In_opt_ PVOID Parameter,
     _In_opt_ PVOID Context
@@ -493,7 +882,7 @@ LOGICAL DllMain(
 
             info->DisplayName = L"Wait Chain Traversal";
             info->Author = L"dmex";
-            info->Description = L"Plugin for Wait Chain analysis via right-click Miscellaneous > Wait Chain Traversal or individual threads via Process properties > Threads tab > Analyze > Wait Chain Traversal.";
+            info->Description = L"Plugin for Wait Chain analysis via right-click Miscellaneous > Wait Chain Traversal or individual threads via Process properties > Threads tab > Analyze > Wait Chain Traversal. Tools > Find deadlocks scans every process.";
             info->HasOptions = FALSE;
 
             PhRegisterCallback(
@@ -502,6 +891,12 @@ LOGICAL DllMain(
                 NULL,
                 &PluginMenuItemCallbackRegistration
                 );
+            PhRegisterCallback(
+                PhGetGeneralCallback(GeneralCallbackMainMenuInitializing),
+                MainMenuInitializingCallback,
+                NULL,
+                &MainMenuInitializingCallbackRegistration
+                );
             PhRegisterCallback(
                 PhGetGeneralCallback(GeneralCallbackProcessMenuInitializing),
                 ProcessMenuInitializingCallback,
@@ -31,10 +31,49 @@
 #include <wct.h>
 #include <psapi.h>
 #include "resource.h"
+#include "waitgraph.h"
 #include "wndtree.h"
 
 #define IDD_WCT_MENUITEM 1000
+#define IDD_WCT_SYSTEM_MENUITEM 1001
 #define WCT_GETINFO_ALL_FLAGS (WCT_OUT_OF_PROC_FLAG|WCT_OUT_OF_PROC_COM_FLAG|WCT_OUT_OF_PROC_CS_FLAG|WCT_NETWORK_IO_FLAG)
+#define WCT_MAXIMUM_PENDING_REQUESTS 16
+#define WCT_UPDATE_TIMER_ID 1
+#define WCT_UPDATE_INTERVAL 100 // ms
+#define WM_WCT_RESULT (WM_APP + 1)
+#define WM_WCT_FINISHED (WM_APP + 2)
+
+// State shared by the collection thread and the asynchronous WCT callbacks. Requests can
+// still be outstanding after the dialog closes, so each one holds a reference.
+typedef struct _WCT_COLLECTION
+{
+    volatile LONG RefCount;
+    volatile LONG Cancelled;
+    volatile LONG IssuedCount;
+
+    PH_QUEUED_LOCK WindowLock;
+    HWND WindowHandle; // NULL once the dialog is gone
+
+    BOOLEAN IsSystemScan;
+    BOOLEAN IsProcessItem;
+    PPH_PROCESS_ITEM ProcessItem;
+    HANDLE ThreadId;
+
+    HWCT WctSessionHandle;
+    HANDLE SlotSemaphoreHandle; // one count per request that may be in flight
+    HMODULE Ole32ModuleHandle;
+} WCT_COLLECTION, *PWCT_COLLECTION;
+
+// One GetThreadWaitChain call. The request is posted to the dialog with WM_WCT_RESULT
+// when the chain completes and the dialog frees it.
+typedef struct _WCT_REQUEST
+{
+    PWCT_COLLECTION Collection;
+    ULONG Status;
+    ULONG NodeCount;
+    BOOL IsDeadLocked;
+    WAITCHAIN_NODE_INFO NodeInfoArray[WCT_MAX_NODE_COUNT];
+} WCT_REQUEST, *PWCT_REQUEST;
 
 typedef struct _WCT_CONTEXT
 {
@@ -46,21 +85,31 @@ typedef struct _WCT_CONTEXT
     WCT_TREE_CONTEXT TreeContext;
     PH_LAYOUT_MANAGER LayoutManager;
 
+    BOOLEAN IsSystemScan; // every thread of every process
     BOOLEAN IsProcessItem;
     PPH_THREAD_ITEM ThreadItem;
     PPH_PROCESS_ITEM ProcessItem;
 
-    HWCT WctSessionHandle;
-    HMODULE Ole32ModuleHandle;
+    PWCT_COLLECTION Collection;
+    ULONG CompletedCount;
+    BOOLEAN TreeDirty;
+    BOOLEAN Finished;
+
+    WAIT_GRAPH Graph; // all chains collected so far
 } WCT_CONTEXT, *PWCT_CONTEXT;
 
-BOOLEAN WaitChainRegisterCallbacks(
-    _Inout_ PWCT_CONTEXT Context
+PWCT_COLLECTION WaitChainCreateCollection(
+    _In_ PWCT_CONTEXT Context,
+    _In_ HWND WindowHandle
+    );
+
+VOID WaitChainDereferenceCollection(
+    _In_ PWCT_COLLECTION Collection
     );
 
-VOID WaitChainCheckThread(
+VOID WaitChainAddChain(
     _Inout_ PWCT_CONTEXT Context,
-    _In_ HANDLE ThreadId
+    _In_ PWCT_REQUEST Request
     );
 
 #endif
\ No newline at end of file
@@ -0,0 +1,256 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Wait Chain Traversal (WCT) Plugin
+ *
+ * Copyright (C) 2013-2015 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Benchmark for the wait-for graph analysis on a system-wide scan of 100k threads.
+// Chains arrive in batches as the WCT callbacks complete, and the graph is analyzed
+// after every batch. The incremental analysis is compared against a full recompute
+// after every batch. It is not part of the plugin build.
+//
+//   gcc -O2 -I../../common/tests/shim -I.. waitgraph_bench.c ../waitanalyze.c -o waitgraph_bench
+//   ./waitgraph_bench [threads] [batch size]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <phdk.h>
+#include "waitgraph.h"
+
+static void TestInitializeGraph(
+    PWAIT_GRAPH Graph,
+    PPH_LIST NodeList
+    )
+{
+    memset(Graph, 0, sizeof(WAIT_GRAPH));
+    memset(NodeList, 0, sizeof(PH_LIST));
+    Graph->NodeList = NodeList;
+}
+
+// Same as WaitGraphpCreateNode, without the hashtable.
+static PWAIT_GRAPH_NODE TestAddNode(
+    PWAIT_GRAPH Graph,
+    BOOLEAN IsThread,
+    ULONG ProcessId
+    )
+{
+    PPH_LIST list = Graph->NodeList;
+    PWAIT_GRAPH_NODE node;
+
+    node = PhAllocate(sizeof(WAIT_GRAPH_NODE));
+    memset(node, 0, sizeof(WAIT_GRAPH_NODE));
+    node->IsThread = IsThread;
+    node->Id = list->Count;
+    node->ProcessId = IsThread ? (HANDLE)(ULONG_PTR)ProcessId : NULL;
+    node->Index = list->Count;
+
+    if (list->Count == list->AllocatedCount)
+    {
+        list->AllocatedCount = list->AllocatedCount ? list->AllocatedCount * 2 : 16;
+        list->Items = PhReAllocate(list->Items, list->AllocatedCount * sizeof(PVOID));
+    }
+
+    list->Items[list->Count++] = node;
+    Graph->Dirty = TRUE;
+
+    return node;
+}
+
+static void TestDeleteGraph(
+    PWAIT_GRAPH Graph
+    )
+{
+    for (ULONG i = 0; i < Graph->NodeList->Count; i++)
+    {
+        PWAIT_GRAPH_NODE node = Graph->NodeList->Items[i];
+
+        PhFree(node->Edges);
+        PhFree(node->Waiters);
+        PhFree(node);
+    }
+
+    PhFree(Graph->NodeList->Items);
+    PhFree(Graph->ChangedNodes);
+    PhFree(Graph->RegionIndex);
+}
+
+static uint64_t BenchRandomState = 0x9e3779b97f4a7c15;
+
+static uint32_t BenchRandom(
+    void
+    )
+{
+    BenchRandomState ^= BenchRandomState << 13;
+    BenchRandomState ^= BenchRandomState >> 7;
+    BenchRandomState ^= BenchRandomState << 17;
+
+    return (uint32_t)BenchRandomState;
+}
+
+static double BenchNow(
+    void
+    )
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+typedef struct _BENCH_RESULT
+{
+    double Total;
+    double Worst;
+    ULONG CycleCount;
+    ULONG LongestChainLength;
+} BENCH_RESULT;
+
+// Builds the same scan every time: 100 threads per process, and a lock for every
+// fourth thread, owned by a random thread. Most threads are not waiting; a waiting
+// thread's chain is thread -> lock -> owner, and the owner's own chain follows in a
+// later request, as with WCT. A few pairs of threads deadlock.
+static void BenchRun(
+    ULONG ThreadCount,
+    ULONG BatchSize,
+    int FullRecompute,
+    BENCH_RESULT *Result
+    )
+{
+    WAIT_GRAPH graph;
+    PH_LIST nodeList;
+    PWAIT_GRAPH_NODE *threads;
+    PWAIT_GRAPH_NODE *locks;
+    PULONG lockOwners;
+    ULONG lockCount = ThreadCount / 4;
+    ULONG batch = 0;
+
+    BenchRandomState = 0x9e3779b97f4a7c15;
+    memset(Result, 0, sizeof(BENCH_RESULT));
+    TestInitializeGraph(&graph, &nodeList);
+
+    threads = PhAllocate(ThreadCount * sizeof(PWAIT_GRAPH_NODE));
+    locks = PhAllocate(lockCount * sizeof(PWAIT_GRAPH_NODE));
+    lockOwners = PhAllocate(lockCount * sizeof(ULONG));
+    memset(threads, 0, ThreadCount * sizeof(PWAIT_GRAPH_NODE));
+    memset(locks, 0, lockCount * sizeof(PWAIT_GRAPH_NODE));
+
+    for (ULONG i = 0; i < lockCount; i++)
+        lockOwners[i] = BenchRandom() % ThreadCount;
+
+    for (ULONG i = 0; i < ThreadCount; i++)
+    {
+        if (!threads[i])
+            threads[i] = TestAddNode(&graph, TRUE, 4 + i / 100 * 4);
+
+        // A quarter of the threads wait on a lock.
+        if (BenchRandom() % 4 == 0)
+        {
+            ULONG lock = BenchRandom() % lockCount;
+            ULONG owner = lockOwners[lock];
+
+            if (!locks[lock])
+                locks[lock] = TestAddNode(&graph, FALSE, 0);
+            if (!threads[owner])
+                threads[owner] = TestAddNode(&graph, TRUE, 4 + owner / 100 * 4);
+
+            WaitGraphAddEdge(&graph, threads[i], locks[lock]);
+            WaitGraphAddEdge(&graph, locks[lock], threads[owner]);
+        }
+
+        // Every thousand threads, two neighbours deadlock on a pair of private locks.
+        if (i % 1000 == 1)
+        {
+            PWAIT_GRAPH_NODE first = TestAddNode(&graph, FALSE, 0);
+            PWAIT_GRAPH_NODE second = TestAddNode(&graph, FALSE, 0);
+
+            WaitGraphAddEdge(&graph, threads[i - 1], first);
+            WaitGraphAddEdge(&graph, first, threads[i]);
+            WaitGraphAddEdge(&graph, threads[i], second);
+            WaitGraphAddEdge(&graph, second, threads[i - 1]);
+        }
+
+        if (++batch == BatchSize || i == ThreadCount - 1)
+        {
+            double start;
+            double elapsed;
+
+            if (FullRecompute)
+                graph.AnalyzedCount = 0;
+
+            start = BenchNow();
+            WaitGraphAnalyze(&graph);
+            elapsed = BenchNow() - start;
+
+            Result->Total += elapsed;
+
+            if (Result->Worst < elapsed)
+                Result->Worst = elapsed;
+
+            batch = 0;
+        }
+    }
+
+    Result->CycleCount = graph.CycleCount;
+    Result->LongestChainLength = graph.LongestChainLength;
+
+    PhFree(lockOwners);
+    PhFree(locks);
+    PhFree(threads);
+    TestDeleteGraph(&graph);
+}
+
+int main(
+    int argc,
+    char *argv[]
+    )
+{
+    ULONG threadCount = 100000;
+    ULONG batchSize = 256;
+    BENCH_RESULT incremental;
+    BENCH_RESULT full;
+
+    if (argc > 1)
+        threadCount = strtoul(argv[1], NULL, 10);
+    if (argc > 2)
+        batchSize = strtoul(argv[2], NULL, 10);
+
+    if (threadCount < 4 || batchSize == 0)
+        return 1;
+
+    BenchRun(threadCount, batchSize, 0, &incremental);
+    BenchRun(threadCount, batchSize, 1, &full);
+
+    printf("%lu threads, %lu per batch, %lu batches\n", (unsigned long)threadCount, (unsigned long)batchSize,
+        (unsigned long)((threadCount + batchSize - 1) / batchSize));
+    printf("incremental:    %9.2f ms total, %7.3f ms worst batch\n", incremental.Total, incremental.Worst);
+    printf("full recompute: %9.2f ms total, %7.3f ms worst batch\n", full.Total, full.Worst);
+    printf("%lu deadlocks, longest chain %lu\n", (unsigned long)incremental.CycleCount, (unsigned long)incremental.LongestChainLength);
+
+    // Both must agree.
+    if (incremental.CycleCount != full.CycleCount || incremental.LongestChainLength != full.LongestChainLength)
+    {
+        printf("results differ\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,419 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Wait Chain Traversal (WCT) Plugin
+ *
+ * Copyright (C) 2013-2015 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Tests for the wait-for graph analysis. Graphs are grown in batches and analyzed
+// after every batch, and each result is checked against a brute force computation
+// from the reachability matrix. They are not part of the plugin build; the shim
+// directory stands in for phdk.h.
+//
+//   gcc -g -O1 -fsanitize=address,undefined -I../../common/tests/shim -I.. waitgraph_test.c ../waitanalyze.c -o waitgraph_test
+//   ./waitgraph_test
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <phdk.h>
+#include "waitgraph.h"
+
+static int TestFailures = 0;
+
+#define CHECK(Expression) \
+    do { if (!(Expression)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #Expression); TestFailures++; } } while (0)
+
+#define TEST_MAX_NODES 64
+
+static void TestInitializeGraph(
+    PWAIT_GRAPH Graph,
+    PPH_LIST NodeList
+    )
+{
+    memset(Graph, 0, sizeof(WAIT_GRAPH));
+    memset(NodeList, 0, sizeof(PH_LIST));
+    Graph->NodeList = NodeList;
+}
+
+// Same as WaitGraphpCreateNode, without the hashtable.
+static PWAIT_GRAPH_NODE TestAddNode(
+    PWAIT_GRAPH Graph,
+    BOOLEAN IsThread,
+    ULONG ProcessId
+    )
+{
+    PPH_LIST list = Graph->NodeList;
+    PWAIT_GRAPH_NODE node;
+
+    node = PhAllocate(sizeof(WAIT_GRAPH_NODE));
+    memset(node, 0, sizeof(WAIT_GRAPH_NODE));
+    node->IsThread = IsThread;
+    node->Id = list->Count;
+    node->ProcessId = IsThread ? (HANDLE)(ULONG_PTR)ProcessId : NULL;
+    node->Index = list->Count;
+
+    if (list->Count == list->AllocatedCount)
+    {
+        list->AllocatedCount = list->AllocatedCount ? list->AllocatedCount * 2 : 16;
+        list->Items = PhReAllocate(list->Items, list->AllocatedCount * sizeof(PVOID));
+    }
+
+    list->Items[list->Count++] = node;
+    Graph->Dirty = TRUE;
+
+    return node;
+}
+
+static void TestDeleteGraph(
+    PWAIT_GRAPH Graph
+    )
+{
+    for (ULONG i = 0; i < Graph->NodeList->Count; i++)
+    {
+        PWAIT_GRAPH_NODE node = Graph->NodeList->Items[i];
+
+        PhFree(node->Edges);
+        PhFree(node->Waiters);
+        PhFree(node);
+    }
+
+    PhFree(Graph->NodeList->Items);
+    PhFree(Graph->ChangedNodes);
+    PhFree(Graph->RegionIndex);
+}
+
+static uint64_t TestRandomState = 0x853c49e6748fea9b;
+
+static uint32_t TestRandom(
+    void
+    )
+{
+    TestRandomState ^= TestRandomState << 13;
+    TestRandomState ^= TestRandomState >> 7;
+    TestRandomState ^= TestRandomState << 17;
+
+    return (uint32_t)TestRandomState;
+}
+
+typedef struct _TEST_REFERENCE
+{
+    ULONG Count;
+    uint64_t Reach[TEST_MAX_NODES]; // bit j: j can be reached from i in one or more steps
+    ULONG Component[TEST_MAX_NODES]; // lowest index in the component
+    ULONG Threads[TEST_MAX_NODES]; // by component
+    int Cycle[TEST_MAX_NODES];
+    int CrossProcess[TEST_MAX_NODES];
+    int Sink[TEST_MAX_NODES];
+    ULONG Length[TEST_MAX_NODES];
+    int LengthDone[TEST_MAX_NODES];
+} TEST_REFERENCE;
+
+static ULONG TestReferenceLength(
+    TEST_REFERENCE *Reference,
+    PWAIT_GRAPH_NODE *Nodes,
+    ULONG Component
+    )
+{
+    ULONG length = 0;
+
+    if (Reference->LengthDone[Component])
+        return Reference->Length[Component];
+
+    // The longest chain of any component that waits directly on this one.
+    for (ULONG i = 0; i < Reference->Count; i++)
+    {
+        if (Reference->Component[i] == Component)
+            continue;
+
+        for (ULONG e = 0; e < Nodes[i]->EdgeCount; e++)
+        {
+            if (Reference->Component[Nodes[i]->Edges[e]] == Component)
+            {
+                ULONG predecessor = TestReferenceLength(Reference, Nodes, Reference->Component[i]);
+
+                if (length < predecessor)
+                    length = predecessor;
+            }
+        }
+    }
+
+    Reference->Length[Component] = length + Reference->Threads[Component];
+    Reference->LengthDone[Component] = 1;
+
+    return Reference->Length[Component];
+}
+
+static void TestCheckGraph(
+    PWAIT_GRAPH Graph
+    )
+{
+    static TEST_REFERENCE reference;
+    PWAIT_GRAPH_NODE *nodes = (PWAIT_GRAPH_NODE *)Graph->NodeList->Items;
+    ULONG count = Graph->NodeList->Count;
+    ULONG componentCount = 0;
+    ULONG cycleCount = 0;
+    ULONG crossProcessCycleCount = 0;
+    ULONG longest = 0;
+
+    memset(&reference, 0, sizeof(reference));
+    reference.Count = count;
+
+    for (ULONG i = 0; i < count; i++)
+    {
+        for (ULONG e = 0; e < nodes[i]->EdgeCount; e++)
+            reference.Reach[i] |= 1ULL << nodes[i]->Edges[e];
+    }
+
+    for (ULONG k = 0; k < count; k++)
+    {
+        for (ULONG i = 0; i < count; i++)
+        {
+            if (reference.Reach[i] & (1ULL << k))
+                reference.Reach[i] |= reference.Reach[k];
+        }
+    }
+
+    for (ULONG i = 0; i < count; i++)
+    {
+        reference.Component[i] = i;
+
+        for (ULONG j = 0; j < i; j++)
+        {
+            if ((reference.Reach[i] & (1ULL << j)) && (reference.Reach[j] & (1ULL << i)))
+            {
+                reference.Component[i] = j;
+                break;
+            }
+        }
+    }
+
+    for (ULONG i = 0; i < count; i++)
+    {
+        ULONG c = reference.Component[i];
+        ULONG firstProcess = 0;
+
+        if (c == i)
+        {
+            componentCount++;
+            reference.Sink[c] = 1;
+            reference.Cycle[c] = !!(reference.Reach[i] & (1ULL << i));
+        }
+
+        if (nodes[i]->IsThread)
+            reference.Threads[c]++;
+
+        for (ULONG e = 0; e < nodes[i]->EdgeCount; e++)
+        {
+            if (reference.Component[nodes[i]->Edges[e]] != c)
+                reference.Sink[c] = 0;
+        }
+
+        // Threads of more than one process.
+        for (ULONG j = 0; j < count; j++)
+        {
+            ULONG processId = (ULONG)(ULONG_PTR)nodes[j]->ProcessId;
+
+            if (reference.Component[j] != c || !nodes[j]->IsThread)
+                continue;
+
+            if (!firstProcess)
+                firstProcess = processId;
+            else if (processId != firstProcess)
+                reference.CrossProcess[c] = 1;
+        }
+    }
+
+    for (ULONG i = 0; i < count; i++)
+    {
+        ULONG c = reference.Component[i];
+
+        if (c != i)
+            continue;
+
+        if (reference.Cycle[c])
+        {
+            cycleCount++;
+
+            if (reference.CrossProcess[c])
+                crossProcessCycleCount++;
+        }
+
+        if (reference.Sink[c] && longest < TestReferenceLength(&reference, nodes, c))
+            longest = TestReferenceLength(&reference, nodes, c);
+    }
+
+    for (ULONG i = 0; i < count; i++)
+    {
+        ULONG c = reference.Component[i];
+
+        CHECK(nodes[i]->InCycle == reference.Cycle[c]);
+        CHECK(nodes[i]->CrossProcess == reference.CrossProcess[c]);
+        CHECK(nodes[i]->ChainLength == TestReferenceLength(&reference, nodes, c));
+
+        for (ULONG j = 0; j < i; j++)
+            CHECK((nodes[i]->Component == nodes[j]->Component) == (c == reference.Component[j]));
+    }
+
+    CHECK(Graph->ComponentCount == componentCount);
+    CHECK(Graph->CycleCount == cycleCount);
+    CHECK(Graph->CrossProcessCycleCount == crossProcessCycleCount);
+    CHECK(Graph->LongestChainLength == longest);
+
+    if (longest != 0)
+    {
+        PWAIT_GRAPH_NODE head = Graph->LongestChainHead;
+
+        CHECK(head != NULL);
+
+        if (head)
+        {
+            CHECK(reference.Sink[reference.Component[head->Index]]);
+            CHECK(head->ChainLength == longest);
+        }
+    }
+}
+
+// T1 (process 1) -> L1 -> T2 (process 2) -> L2 -> T1, then T3 -> L3 -> T1.
+static void TestDeadlock(
+    void
+    )
+{
+    WAIT_GRAPH graph;
+    PH_LIST nodeList;
+    PWAIT_GRAPH_NODE t1, t2, t3, l1, l2, l3;
+
+    TestInitializeGraph(&graph, &nodeList);
+
+    t1 = TestAddNode(&graph, TRUE, 1);
+    l1 = TestAddNode(&graph, FALSE, 0);
+    t2 = TestAddNode(&graph, TRUE, 2);
+    l2 = TestAddNode(&graph, FALSE, 0);
+    WaitGraphAddEdge(&graph, t1, l1);
+    WaitGraphAddEdge(&graph, l1, t2);
+    WaitGraphAddEdge(&graph, t2, l2);
+    WaitGraphAnalyze(&graph);
+
+    CHECK(graph.CycleCount == 0);
+    CHECK(graph.LongestChainLength == 2);
+    CHECK(graph.LongestChainHead == l2); // the sink; it waits on nothing
+    CHECK(!graph.Dirty);
+    TestCheckGraph(&graph);
+
+    // Duplicate edges are ignored and do not dirty the graph.
+    WaitGraphAddEdge(&graph, t1, l1);
+    CHECK(!graph.Dirty);
+
+    WaitGraphAddEdge(&graph, l2, t1);
+    WaitGraphAnalyze(&graph);
+
+    CHECK(graph.CycleCount == 1);
+    CHECK(graph.CrossProcessCycleCount == 1);
+    CHECK(t1->InCycle && l1->InCycle && t2->InCycle && l2->InCycle);
+    CHECK(t1->Component == l2->Component);
+    CHECK(graph.ComponentCount == 1);
+    TestCheckGraph(&graph);
+
+    t3 = TestAddNode(&graph, TRUE, 1);
+    l3 = TestAddNode(&graph, FALSE, 0);
+    WaitGraphAddEdge(&graph, t3, l3);
+    WaitGraphAddEdge(&graph, l3, t1);
+    WaitGraphAnalyze(&graph);
+
+    CHECK(graph.CycleCount == 1);
+    CHECK(graph.ComponentCount == 3);
+    CHECK(!t3->InCycle && t3->ChainLength == 1);
+    CHECK(t1->ChainLength == 3);
+    CHECK(graph.LongestChainLength == 3);
+    CHECK(graph.LongestChainHead == t1 || graph.LongestChainHead == t2);
+    TestCheckGraph(&graph);
+
+    TestDeleteGraph(&graph);
+}
+
+static void TestRandomBatches(
+    void
+    )
+{
+    for (ULONG round = 0; round < 3000; round++)
+    {
+        WAIT_GRAPH graph;
+        PH_LIST nodeList;
+        ULONG target = 2 + TestRandom() % (TEST_MAX_NODES - 1);
+        ULONG edgesPerBatch = 1 + TestRandom() % 6;
+
+        TestInitializeGraph(&graph, &nodeList);
+
+        while (nodeList.Count < target)
+        {
+            ULONG newNodes = TestRandom() % 4;
+            ULONG newEdges = TestRandom() % (edgesPerBatch + 1);
+
+            for (ULONG i = 0; i < newNodes && nodeList.Count < target; i++)
+                TestAddNode(&graph, TestRandom() % 3 != 0, 1 + TestRandom() % 3);
+
+            if (nodeList.Count == 0)
+                continue;
+
+            // Edges between any two nodes, old or new, including self waits.
+            for (ULONG i = 0; i < newEdges; i++)
+            {
+                PWAIT_GRAPH_NODE from = nodeList.Items[TestRandom() % nodeList.Count];
+                PWAIT_GRAPH_NODE to = nodeList.Items[TestRandom() % nodeList.Count];
+
+                if (from != to || TestRandom() % 8 == 0)
+                    WaitGraphAddEdge(&graph, from, to);
+            }
+
+            if (graph.Dirty && TestRandom() % 4 != 0)
+            {
+                WaitGraphAnalyze(&graph);
+                TestCheckGraph(&graph);
+            }
+        }
+
+        if (graph.Dirty)
+        {
+            WaitGraphAnalyze(&graph);
+            TestCheckGraph(&graph);
+        }
+
+        TestDeleteGraph(&graph);
+
+        if (TestFailures)
+            break;
+    }
+}
+
+int main(
+    void
+    )
+{
+    TestDeadlock();
+    TestRandomBatches();
+
+    if (TestFailures)
+    {
+        printf("%d checks failed\n", TestFailures);
+        return 1;
+    }
+
+    printf("all tests passed\n");
+
+    return 0;
+}
@@ -0,0 +1,441 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Wait Chain Traversal (WCT) Plugin
+ *
+ * Copyright (C) 2013-2015 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <phdk.h>
+#include "waitgraph.h"
+
+// Edges and the strongly connected component analysis of the wait-for graph. This
+// part only needs the node list, so it can be built and benchmarked on its own (see
+// tests\waitgraph_bench.c).
+
+typedef struct _WAIT_GRAPH_FRAME
+{
+    ULONG Node;
+    ULONG Edge;
+} WAIT_GRAPH_FRAME, *PWAIT_GRAPH_FRAME;
+
+static VOID WaitGraphpAppendIndex(
+    _Inout_ PULONG *Array,
+    _Inout_ PULONG Count,
+    _Inout_ PULONG Capacity,
+    _In_ ULONG Value
+    )
+{
+    if (*Count == *Capacity)
+    {
+        *Capacity = *Capacity ? *Capacity * 2 : 2;
+
+        if (*Array)
+            *Array = PhReAllocate(*Array, *Capacity * sizeof(ULONG));
+        else
+            *Array = PhAllocate(*Capacity * sizeof(ULONG));
+    }
+
+    (*Array)[(*Count)++] = Value;
+}
+
+VOID WaitGraphAddEdge(
+    _Inout_ PWAIT_GRAPH Graph,
+    _In_ PWAIT_GRAPH_NODE From,
+    _In_ PWAIT_GRAPH_NODE To
+    )
+{
+    // Nodes rarely wait on more than one thing, so a linear check is enough.
+    for (ULONG i = 0; i < From->EdgeCount; i++)
+    {
+        if (From->Edges[i] == To->Index)
+            return;
+    }
+
+    WaitGraphpAppendIndex(&From->Edges, &From->EdgeCount, &From->EdgeCapacity, To->Index);
+    WaitGraphpAppendIndex(&To->Waiters, &To->WaiterCount, &To->WaiterCapacity, From->Index);
+
+    // The waiter may stop being the head of a chain, and everything it now reaches may
+    // join a cycle or a longer chain. Nodes added since the last analysis are visited
+    // anyway.
+    if (From->Index < Graph->AnalyzedCount)
+        WaitGraphpAppendIndex(&Graph->ChangedNodes, &Graph->ChangedCount, &Graph->ChangedCapacity, From->Index);
+
+    Graph->EdgeCount++;
+    Graph->Dirty = TRUE;
+}
+
+static VOID WaitGraphpAddRegionNode(
+    _Inout_ PWAIT_GRAPH Graph,
+    _Inout_ PULONG *Region,
+    _Inout_ PULONG RegionCount,
+    _Inout_ PULONG RegionCapacity,
+    _In_ ULONG Node
+    )
+{
+    if (Graph->RegionIndex[Node] != ULONG_MAX)
+        return;
+
+    Graph->RegionIndex[Node] = *RegionCount;
+    WaitGraphpAppendIndex(Region, RegionCount, RegionCapacity, Node);
+}
+
+/**
+ * Computes the strongly connected components of the graph and the longest chain of
+ * waiters behind each node.
+ *
+ * \remarks Only the nodes reachable from what changed since the previous call are
+ * analyzed again, using an iterative form of Tarjan's algorithm, so a batch costs
+ * O(V + E) of that region rather than of the whole graph. Nothing in the region waits
+ * on a node outside of it, so the components and chains outside of it are unchanged.
+ * The results of the previous call stay valid until the next one.
+ */
+VOID WaitGraphAnalyze(
+    _Inout_ PWAIT_GRAPH Graph
+    )
+{
+    ULONG count = Graph->NodeList->Count;
+    PWAIT_GRAPH_NODE *nodes = (PWAIT_GRAPH_NODE *)Graph->NodeList->Items;
+    PULONG regionIndex;
+    PULONG region = NULL;
+    ULONG regionCount = 0;
+    ULONG regionCapacity = 0;
+    PULONG index;
+    PULONG lowLink;
+    PULONG stack;
+    PBOOLEAN onStack;
+    PWAIT_GRAPH_FRAME frames;
+    ULONG stackCount = 0;
+    ULONG nextIndex = 0;
+    ULONG componentCount = 0;
+    PULONG componentThreads;
+    PULONG componentLength;
+    PHANDLE componentProcess;
+    PBOOLEAN componentCycle;
+    PBOOLEAN componentCrossProcess;
+    PULONG order;
+    PULONG componentStart;
+
+    Graph->Dirty = FALSE;
+
+    if (Graph->RegionIndexCount < count)
+    {
+        ULONG newCount = max(count, Graph->RegionIndexCount * 2);
+
+        if (Graph->RegionIndex)
+            Graph->RegionIndex = PhReAllocate(Graph->RegionIndex, newCount * sizeof(ULONG));
+        else
+            Graph->RegionIndex = PhAllocate(newCount * sizeof(ULONG));
+
+        memset(Graph->RegionIndex + Graph->RegionIndexCount, 0xff, (newCount - Graph->RegionIndexCount) * sizeof(ULONG));
+        Graph->RegionIndexCount = newCount;
+    }
+
+    regionIndex = Graph->RegionIndex;
+
+    // The region is everything reachable from a changed node.
+
+    for (ULONG i = 0; i < Graph->ChangedCount; i++)
+        WaitGraphpAddRegionNode(Graph, &region, &regionCount, &regionCapacity, Graph->ChangedNodes[i]);
+    for (ULONG i = Graph->AnalyzedCount; i < count; i++)
+        WaitGraphpAddRegionNode(Graph, &region, &regionCount, &regionCapacity, i);
+
+    for (ULONG i = 0; i < regionCount; i++)
+    {
+        PWAIT_GRAPH_NODE node = nodes[region[i]];
+
+        for (ULONG e = 0; e < node->EdgeCount; e++)
+            WaitGraphpAddRegionNode(Graph, &region, &regionCount, &regionCapacity, node->Edges[e]);
+    }
+
+    Graph->ChangedCount = 0;
+    Graph->AnalyzedCount = count;
+
+    if (regionCount == 0)
+        return;
+
+    // Take back what the region contributed to the totals. Every component lies either
+    // entirely inside the region or entirely outside of it.
+
+    for (ULONG i = 0; i < regionCount; i++)
+    {
+        PWAIT_GRAPH_NODE node = nodes[region[i]];
+
+        if (node->ComponentHead)
+        {
+            node->ComponentHead = FALSE;
+            Graph->ComponentCount--;
+
+            if (node->InCycle)
+            {
+                Graph->CycleCount--;
+
+                if (node->CrossProcess)
+                    Graph->CrossProcessCycleCount--;
+            }
+        }
+    }
+
+    // Chains only grow as the graph grows, so a longest chain whose head is outside of
+    // the region is still the longest unless the region has a longer one.
+    if (Graph->LongestChainHead && regionIndex[Graph->LongestChainHead->Index] != ULONG_MAX)
+    {
+        Graph->LongestChainHead = NULL;
+        Graph->LongestChainLength = 0;
+    }
+
+    index = PhAllocate(regionCount * sizeof(ULONG));
+    lowLink = PhAllocate(regionCount * sizeof(ULONG));
+    stack = PhAllocate(regionCount * sizeof(ULONG));
+    onStack = PhAllocate(regionCount * sizeof(BOOLEAN));
+    frames = PhAllocate(regionCount * sizeof(WAIT_GRAPH_FRAME));
+
+    memset(index, 0xff, regionCount * sizeof(ULONG));
+    memset(onStack, 0, regionCount * sizeof(BOOLEAN));
+
+    // From here on nodes are numbered by their position in the region, and Component
+    // holds the component within the region.
+
+    for (ULONG root = 0; root < regionCount; root++)
+    {
+        ULONG frameCount = 0;
+
+        if (index[root] != ULONG_MAX)
+            continue;
+
+        frames[frameCount].Node = root;
+        frames[frameCount].Edge = 0;
+        frameCount++;
+        index[root] = lowLink[root] = nextIndex++;
+        stack[stackCount++] = root;
+        onStack[root] = TRUE;
+
+        while (frameCount != 0)
+        {
+            PWAIT_GRAPH_FRAME frame = &frames[frameCount - 1];
+            PWAIT_GRAPH_NODE node = nodes[region[frame->Node]];
+
+            if (frame->Edge < node->EdgeCount)
+            {
+                ULONG next = regionIndex[node->Edges[frame->Edge++]];
+
+                if (index[next] == ULONG_MAX)
+                {
+                    index[next] = lowLink[next] = nextIndex++;
+                    stack[stackCount++] = next;
+                    onStack[next] = TRUE;
+
+                    frames[frameCount].Node = next;
+                    frames[frameCount].Edge = 0;
+                    frameCount++;
+                }
+                else if (onStack[next])
+                {
+                    lowLink[frame->Node] = min(lowLink[frame->Node], index[next]);
+                }
+
+                continue;
+            }
+
+            // All edges visited; pop the frame.
+            if (lowLink[frame->Node] == index[frame->Node])
+            {
+                ULONG member;
+
+                do
+                {
+                    member = stack[--stackCount];
+                    onStack[member] = FALSE;
+                    nodes[region[member]]->Component = componentCount;
+                } while (member != frame->Node);
+
+                componentCount++;
+            }
+
+            frameCount--;
+
+            if (frameCount != 0)
+            {
+                ULONG parent = frames[frameCount - 1].Node;
+
+                lowLink[parent] = min(lowLink[parent], lowLink[frame->Node]);
+            }
+        }
+    }
+
+    PhFree(frames);
+    PhFree(onStack);
+    PhFree(stack);
+    PhFree(lowLink);
+
+    // Components are numbered in reverse topological order: every edge between two
+    // components points from a higher number to a lower one. Group the nodes by
+    // component with a counting sort.
+
+    componentStart = PhAllocate((componentCount + 1) * sizeof(ULONG));
+    order = index; // reuse
+    memset(componentStart, 0, (componentCount + 1) * sizeof(ULONG));
+
+    for (ULONG i = 0; i < regionCount; i++)
+        componentStart[nodes[region[i]]->Component + 1]++;
+    for (ULONG i = 0; i < componentCount; i++)
+        componentStart[i + 1] += componentStart[i];
+
+    {
+        PULONG position = PhAllocate(componentCount * sizeof(ULONG));
+
+        memcpy(position, componentStart, componentCount * sizeof(ULONG));
+
+        for (ULONG i = 0; i < regionCount; i++)
+            order[position[nodes[region[i]]->Component]++] = region[i];
+
+        PhFree(position);
+    }
+
+    componentThreads = PhAllocate(componentCount * sizeof(ULONG));
+    componentLength = PhAllocate(componentCount * sizeof(ULONG));
+    componentProcess = PhAllocate(componentCount * sizeof(HANDLE));
+    componentCycle = PhAllocate(componentCount * sizeof(BOOLEAN));
+    componentCrossProcess = PhAllocate(componentCount * sizeof(BOOLEAN));
+
+    memset(componentThreads, 0, componentCount * sizeof(ULONG));
+    memset(componentLength, 0, componentCount * sizeof(ULONG));
+    memset(componentProcess, 0, componentCount * sizeof(HANDLE));
+    memset(componentCycle, 0, componentCount * sizeof(BOOLEAN));
+    memset(componentCrossProcess, 0, componentCount * sizeof(BOOLEAN));
+
+    for (ULONG c = 0; c < componentCount; c++)
+    {
+        ULONG size = componentStart[c + 1] - componentStart[c];
+
+        for (ULONG i = componentStart[c]; i < componentStart[c + 1]; i++)
+        {
+            PWAIT_GRAPH_NODE node = nodes[order[i]];
+
+            if (node->IsThread)
+            {
+                componentThreads[c]++;
+
+                if (!componentProcess[c])
+                    componentProcess[c] = node->ProcessId;
+                else if (node->ProcessId && componentProcess[c] != node->ProcessId)
+                    componentCrossProcess[c] = TRUE;
+            }
+
+            // A single node is a cycle only if it waits on itself.
+            if (size == 1)
+            {
+                for (ULONG e = 0; e < node->EdgeCount; e++)
+                {
+                    if (node->Edges[e] == node->Index)
+                        componentCycle[c] = TRUE;
+                }
+            }
+
+            // Chains that reach the region from outside of it.
+            for (ULONG w = 0; w < node->WaiterCount; w++)
+            {
+                PWAIT_GRAPH_NODE waiter = nodes[node->Waiters[w]];
+
+                if (regionIndex[waiter->Index] == ULONG_MAX && componentLength[c] < waiter->ChainLength)
+                    componentLength[c] = waiter->ChainLength;
+            }
+        }
+
+        if (size > 1)
+            componentCycle[c] = TRUE;
+
+        nodes[order[componentStart[c]]]->ComponentHead = TRUE;
+
+        if (componentCycle[c])
+        {
+            Graph->CycleCount++;
+
+            if (componentCrossProcess[c])
+                Graph->CrossProcessCycleCount++;
+        }
+    }
+
+    // Longest chain of waiters: visit components from sources to sinks. componentLength
+    // first holds the longest chain of any predecessor and then the chain through c.
+
+    for (ULONG c = componentCount; c-- != 0;)
+    {
+        BOOLEAN isSink = TRUE;
+
+        componentLength[c] += componentThreads[c];
+
+        for (ULONG i = componentStart[c]; i < componentStart[c + 1]; i++)
+        {
+            PWAIT_GRAPH_NODE node = nodes[order[i]];
+
+            for (ULONG e = 0; e < node->EdgeCount; e++)
+            {
+                ULONG target = nodes[node->Edges[e]]->Component;
+
+                if (target != c)
+                {
+                    isSink = FALSE;
+
+                    if (componentLength[target] < componentLength[c])
+                        componentLength[target] = componentLength[c];
+                }
+            }
+        }
+
+        // The head of a chain is the component that is not waiting on anything else.
+        if (isSink && componentLength[c] > Graph->LongestChainLength)
+        {
+            Graph->LongestChainLength = componentLength[c];
+            Graph->LongestChainHead = nodes[order[componentStart[c]]];
+
+            for (ULONG i = componentStart[c]; i < componentStart[c + 1]; i++)
+            {
+                if (nodes[order[i]]->IsThread)
+                {
+                    Graph->LongestChainHead = nodes[order[i]];
+                    break;
+                }
+            }
+        }
+    }
+
+    for (ULONG i = 0; i < regionCount; i++)
+    {
+        PWAIT_GRAPH_NODE node = nodes[region[i]];
+        ULONG c = node->Component;
+
+        node->ChainLength = componentLength[c];
+        node->InCycle = componentCycle[c];
+        node->CrossProcess = componentCrossProcess[c];
+        node->Component = Graph->NextComponent + c;
+
+        regionIndex[region[i]] = ULONG_MAX;
+    }
+
+    Graph->ComponentCount += componentCount;
+    Graph->NextComponent += componentCount;
+
+    PhFree(componentCrossProcess);
+    PhFree(componentCycle);
+    PhFree(componentProcess);
+    PhFree(componentLength);
+    PhFree(componentThreads);
+    PhFree(componentStart);
+    PhFree(index);
+    PhFree(region);
+}
@@ -0,0 +1,195 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Wait Chain Traversal (WCT) Plugin
+ *
+ * Copyright (C) 2013-2015 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <phdk.h>
+#include "waitgraph.h"
+
+static BOOLEAN WaitGraphpNodeEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    PWAIT_GRAPH_NODE node1 = *(PWAIT_GRAPH_NODE *)Entry1;
+    PWAIT_GRAPH_NODE node2 = *(PWAIT_GRAPH_NODE *)Entry2;
+
+    if (node1->IsThread != node2->IsThread || node1->Id != node2->Id)
+        return FALSE;
+
+    if (node1->IsThread)
+        return TRUE;
+
+    return node1->Type == node2->Type && PhEqualString(node1->Name, node2->Name, FALSE);
+}
+
+static ULONG WaitGraphpNodeHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    PWAIT_GRAPH_NODE node = *(PWAIT_GRAPH_NODE *)Entry;
+
+    return (ULONG)node->Id ^ (node->Type << 24);
+}
+
+VOID WaitGraphInitialize(
+    _Out_ PWAIT_GRAPH Graph
+    )
+{
+    memset(Graph, 0, sizeof(WAIT_GRAPH));
+
+    Graph->NodeHashtable = PhCreateHashtable(
+        sizeof(PWAIT_GRAPH_NODE),
+        WaitGraphpNodeEqualFunction,
+        WaitGraphpNodeHashFunction,
+        256
+        );
+    Graph->NodeList = PhCreateList(256);
+}
+
+VOID WaitGraphDelete(
+    _Inout_ PWAIT_GRAPH Graph
+    )
+{
+    for (ULONG i = 0; i < Graph->NodeList->Count; i++)
+    {
+        PWAIT_GRAPH_NODE node = Graph->NodeList->Items[i];
+
+        if (node->Name)
+            PhDereferenceObject(node->Name);
+        if (node->Edges)
+            PhFree(node->Edges);
+        if (node->Waiters)
+            PhFree(node->Waiters);
+
+        PhFree(node);
+    }
+
+    if (Graph->ChangedNodes)
+        PhFree(Graph->ChangedNodes);
+    if (Graph->RegionIndex)
+        PhFree(Graph->RegionIndex);
+
+    PhDereferenceObject(Graph->NodeHashtable);
+    PhDereferenceObject(Graph->NodeList);
+}
+
+static PWAIT_GRAPH_NODE WaitGraphpCreateNode(
+    _Inout_ PWAIT_GRAPH Graph
+    )
+{
+    PWAIT_GRAPH_NODE node;
+
+    node = PhAllocate(sizeof(WAIT_GRAPH_NODE));
+    memset(node, 0, sizeof(WAIT_GRAPH_NODE));
+    node->Index = Graph->NodeList->Count;
+
+    PhAddItemList(Graph->NodeList, node);
+    Graph->Dirty = TRUE;
+
+    return node;
+}
+
+PWAIT_GRAPH_NODE WaitGraphAddThread(
+    _Inout_ PWAIT_GRAPH Graph,
+    _In_ ULONG Type,
+    _In_ HANDLE ThreadId,
+    _In_ HANDLE ProcessId
+    )
+{
+    WAIT_GRAPH_NODE lookupNode;
+    PWAIT_GRAPH_NODE lookupNodePtr = &lookupNode;
+    PWAIT_GRAPH_NODE *entry;
+    PWAIT_GRAPH_NODE node;
+
+    lookupNode.Type = Type;
+    lookupNode.IsThread = TRUE;
+    lookupNode.Id = (ULONG_PTR)ThreadId;
+
+    if (entry = PhFindEntryHashtable(Graph->NodeHashtable, &lookupNodePtr))
+    {
+        // Chains that only saw the thread ID (for example from another process) may not
+        // have known the owning process.
+        if (!(*entry)->ProcessId)
+            (*entry)->ProcessId = ProcessId;
+
+        return *entry;
+    }
+
+    node = WaitGraphpCreateNode(Graph);
+    node->Type = Type;
+    node->IsThread = TRUE;
+    node->Id = (ULONG_PTR)ThreadId;
+    node->ProcessId = ProcessId;
+    PhAddEntryHashtable(Graph->NodeHashtable, &node);
+
+    return node;
+}
+
+/**
+ * Finds or creates a node for a synchronization object.
+ *
+ * \param Graph The graph.
+ * \param Type The object type.
+ * \param Name The object name. Objects without a name cannot be matched between chains,
+ * so each call creates a new node.
+ */
+PWAIT_GRAPH_NODE WaitGraphAddObject(
+    _Inout_ PWAIT_GRAPH Graph,
+    _In_ ULONG Type,
+    _In_opt_ PPH_STRINGREF Name
+    )
+{
+    WAIT_GRAPH_NODE lookupNode;
+    PWAIT_GRAPH_NODE lookupNodePtr = &lookupNode;
+    PWAIT_GRAPH_NODE *entry;
+    PWAIT_GRAPH_NODE node;
+    ULONG_PTR id;
+
+    if (!Name || Name->Length == 0)
+    {
+        node = WaitGraphpCreateNode(Graph);
+        node->Type = Type;
+        return node;
+    }
+
+    id = PhHashStringRef(Name, FALSE);
+
+    lookupNode.Type = Type;
+    lookupNode.IsThread = FALSE;
+    lookupNode.Id = id;
+    lookupNode.Name = PhCreateString2(Name);
+
+    entry = PhFindEntryHashtable(Graph->NodeHashtable, &lookupNodePtr);
+
+    if (entry)
+    {
+        PhDereferenceObject(lookupNode.Name);
+        return *entry;
+    }
+
+    node = WaitGraphpCreateNode(Graph);
+    node->Type = Type;
+    node->Id = id;
+    node->Name = lookupNode.Name;
+    PhAddEntryHashtable(Graph->NodeHashtable, &node);
+
+    return node;
+}
@@ -0,0 +1,111 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Wait Chain Traversal (WCT) Plugin
+ *
+ * Copyright (C) 2013-2015 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _WAITGRAPH_H_
+#define _WAITGRAPH_H_
+
+// Wait-for graph built from wait chains. An edge points from a waiter to the object
+// or thread it waits on, so a thread blocked on a lock owned by another thread is
+// thread -> lock -> thread. Nodes are merged by ID, so chains collected separately
+// (including from different processes) join into one graph.
+
+typedef struct _WAIT_GRAPH_NODE
+{
+    ULONG Type; // caller defined; WCT_OBJECT_TYPE in this plugin
+    BOOLEAN IsThread;
+    ULONG_PTR Id; // thread ID, or a hash of Name
+    PPH_STRING Name;
+    HANDLE ProcessId; // threads only
+    ULONG Index;
+
+    PULONG Edges; // indices of the nodes this node waits on
+    ULONG EdgeCount;
+    ULONG EdgeCapacity;
+    PULONG Waiters; // indices of the nodes waiting on this node
+    ULONG WaiterCount;
+    ULONG WaiterCapacity;
+
+    // Results of the last WaitGraphAnalyze.
+    ULONG Component;
+    ULONG ChainLength; // threads in the longest chain ending at this node
+    BOOLEAN InCycle;
+    BOOLEAN CrossProcess; // the cycle spans more than one process
+    BOOLEAN ComponentHead; // exactly one node of each component; it is counted in the totals
+} WAIT_GRAPH_NODE, *PWAIT_GRAPH_NODE;
+
+typedef struct _WAIT_GRAPH
+{
+    PPH_HASHTABLE NodeHashtable;
+    PPH_LIST NodeList;
+    ULONG EdgeCount;
+    BOOLEAN Dirty; // changed since the last WaitGraphAnalyze
+
+    // Nodes from AnalyzedCount on and the sources of edges added since the last
+    // WaitGraphAnalyze. Only what can be reached from them is analyzed again.
+    ULONG AnalyzedCount;
+    PULONG ChangedNodes;
+    ULONG ChangedCount;
+    ULONG ChangedCapacity;
+    PULONG RegionIndex; // per node; ULONG_MAX outside of WaitGraphAnalyze
+    ULONG RegionIndexCount;
+    ULONG NextComponent;
+
+    // Results of the last WaitGraphAnalyze.
+    ULONG ComponentCount;
+    ULONG CycleCount;
+    ULONG CrossProcessCycleCount;
+    PWAIT_GRAPH_NODE LongestChainHead;
+    ULONG LongestChainLength;
+} WAIT_GRAPH, *PWAIT_GRAPH;
+
+VOID WaitGraphInitialize(
+    _Out_ PWAIT_GRAPH Graph
+    );
+
+VOID WaitGraphDelete(
+    _Inout_ PWAIT_GRAPH Graph
+    );
+
+PWAIT_GRAPH_NODE WaitGraphAddThread(
+    _Inout_ PWAIT_GRAPH Graph,
+    _In_ ULONG Type,
+    _In_ HANDLE ThreadId,
+    _In_ HANDLE ProcessId
+    );
+
+PWAIT_GRAPH_NODE WaitGraphAddObject(
+    _Inout_ PWAIT_GRAPH Graph,
+    _In_ ULONG Type,
+    _In_opt_ PPH_STRINGREF Name
+    );
+
+VOID WaitGraphAddEdge(
+    _Inout_ PWAIT_GRAPH Graph,
+    _In_ PWAIT_GRAPH_NODE From,
+    _In_ PWAIT_GRAPH_NODE To
+    );
+
+VOID WaitGraphAnalyze(
+    _Inout_ PWAIT_GRAPH Graph
+    );
+
+#endif
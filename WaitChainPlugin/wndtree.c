@@ -52,23 +52,12 @@ VOID WepDestroyWindowNode(
     _In_ PWCT_ROOT_NODE WindowNode
     )
 {
-    PhDereferenceObject(WindowNode->Children);
+    if (WindowNode->Children)
+        PhDereferenceObject(WindowNode->Children);
 
     if (WindowNode->TimeoutString)
         PhDereferenceObject(WindowNode->TimeoutString);
 
-    if (WindowNode->ProcessIdString)
-        PhDereferenceObject(WindowNode->ProcessIdString);
-
-    if (WindowNode->ThreadIdString)
-        PhDereferenceObject(WindowNode->ThreadIdString);
-
-    if (WindowNode->WaitTimeString)
-        PhDereferenceObject(WindowNode->WaitTimeString);
-
-    if (WindowNode->ContextSwitchesString)
-        PhDereferenceObject(WindowNode->ContextSwitchesString);
-
     if (WindowNode->ObjectNameString)
         PhDereferenceObject(WindowNode->ObjectNameString);
 
@@ -111,6 +100,8 @@ VOID WtcInitializeWindowTree(
     PhAddTreeNewColumn(hwnd, TREE_COLUMN_ITEM_TIMEOUT, TRUE, L"Timeout", 60, PH_ALIGN_LEFT, 6, 0);
     PhAddTreeNewColumn(hwnd, TREE_COLUMN_ITEM_ALERTABLE, TRUE, L"Alertable", 50, PH_ALIGN_LEFT, 7, 0);
     PhAddTreeNewColumn(hwnd, TREE_COLUMN_ITEM_NAME, TRUE, L"Name", 100, PH_ALIGN_LEFT, 8, 0);
+    PhAddTreeNewColumn(hwnd, TREE_COLUMN_ITEM_CYCLE, TRUE, L"Cycle", 80, PH_ALIGN_LEFT, 9, 0);
+    PhAddTreeNewColumn(hwnd, TREE_COLUMN_ITEM_CHAINLENGTH, TRUE, L"Chain length", 50, PH_ALIGN_LEFT, 10, 0);
 
     TreeNew_SetTriState(hwnd, TRUE);
     TreeNew_SetSort(hwnd, 0, NoSortOrder);
@@ -150,12 +141,9 @@ PWCT_ROOT_NODE WeAddWindowNode(
     memset(windowNode, 0, sizeof(WCT_ROOT_NODE));
     PhInitializeTreeNewNode(&windowNode->Node);
 
-    memset(windowNode->TextCache, 0, sizeof(PH_STRINGREF) * TREE_COLUMN_ITEM_MAXIMUM);
     windowNode->Node.TextCache = windowNode->TextCache;
     windowNode->Node.TextCacheSize = TREE_COLUMN_ITEM_MAXIMUM;
 
-    windowNode->Children = PhCreateList(1);
-
     PhAddEntryHashtable(Context->NodeHashtable, &windowNode);
     PhAddItemList(Context->NodeList, windowNode);
 
@@ -164,7 +152,7 @@ PWCT_ROOT_NODE WeAddWindowNode(
     return windowNode;
 }
 
-VOID WctAddChildWindowNode(
+PWCT_ROOT_NODE WctAddChildWindowNode(
     _In_ PWCT_TREE_CONTEXT Context,
     _In_opt_ PWCT_ROOT_NODE ParentNode,
     _In_ PWAITCHAIN_NODE_INFO WctNode,
@@ -175,52 +163,45 @@ VOID WctAddChildWindowNode(
 
     childNode = WeAddWindowNode(Context);
 
-    childNode->IsDeadLocked = TRUE;
+    childNode->IsDeadLocked = IsDeadLocked;
     childNode->ObjectType = WctNode->ObjectType;
     childNode->ObjectStatus = WctNode->ObjectStatus;
-    childNode->Alertable = WctNode->LockObject.Alertable;
-    childNode->ThreadId = UlongToHandle(WctNode->ThreadObject.ThreadId);
-    childNode->ProcessIdString = PhFormatString(L"%lu", WctNode->ThreadObject.ProcessId);
-    childNode->ThreadIdString = PhFormatString(L"%lu", WctNode->ThreadObject.ThreadId);
-    childNode->WaitTimeString = PhFormatString(L"%lu", WctNode->ThreadObject.WaitTime);
-    childNode->ContextSwitchesString = PhFormatString(L"%lu", WctNode->ThreadObject.ContextSwitches);
-
-    if (WctNode->LockObject.ObjectName[0] != L'\0')
-        childNode->ObjectNameString = PhFormatString(L"%s", WctNode->LockObject.ObjectName);
 
-    if (WctNode->LockObject.Timeout.QuadPart > 0)
+    // ThreadObject and LockObject share storage, so only one of them is valid.
+    if (WctNode->ObjectType == WctThreadType)
     {
-        SYSTEMTIME systemTime;
-        PPH_STRING dateString = NULL;
-        PPH_STRING timeString = NULL;
-
-        PhLargeIntegerToLocalSystemTime(&systemTime, &WctNode->LockObject.Timeout);
-
-        dateString = PhFormatDate(&systemTime, NULL);
-        timeString = PhFormatTime(&systemTime, NULL);
-
-        childNode->TimeoutString = PhFormatString(L"%s %s", dateString->Buffer, timeString->Buffer);
+        childNode->ProcessId = UlongToHandle(WctNode->ThreadObject.ProcessId);
+        childNode->ThreadId = UlongToHandle(WctNode->ThreadObject.ThreadId);
+        childNode->WaitTime = WctNode->ThreadObject.WaitTime;
+        childNode->ContextSwitches = WctNode->ThreadObject.ContextSwitches;
+    }
+    else
+    {
+        childNode->Alertable = WctNode->LockObject.Alertable;
+        childNode->Timeout = WctNode->LockObject.Timeout;
 
-        PhDereferenceObject(dateString);
-        PhDereferenceObject(timeString);
+        if (WctNode->LockObject.ObjectName[0] != L'\0')
+            childNode->ObjectNameString = PhCreateString(WctNode->LockObject.ObjectName);
     }
 
     if (ParentNode)
     {
-        childNode->HasChildren = FALSE;
-
         // This is a child node.
+        if (!ParentNode->Children)
+            ParentNode->Children = PhCreateList(2);
+
         childNode->Parent = ParentNode;
         PhAddItemList(ParentNode->Children, childNode);
     }
     else
     {
-        childNode->HasChildren = TRUE;
         childNode->Node.Expanded = TRUE;
 
         // This is a root node.
         PhAddItemList(Context->NodeRootList, childNode);
     }
+
+    return childNode;
 }
 
 PWCT_ROOT_NODE WeFindWindowNode(
@@ -295,7 +276,7 @@ BOOLEAN NTAPI WepWindowTreeNewCallback(
                     getChildren->Children = (PPH_TREENEW_NODE *)context->NodeRootList->Items;
                     getChildren->NumberOfChildren = context->NodeRootList->Count;
                 }
-                else
+                else if (node->Children)
                 {
                     getChildren->Children = (PPH_TREENEW_NODE *)node->Children->Items;
                     getChildren->NumberOfChildren = node->Children->Count;
@@ -318,7 +299,7 @@ BOOLEAN NTAPI WepWindowTreeNewCallback(
             node = (PWCT_ROOT_NODE)isLeaf->Node;
 
             if (context->TreeNewSortOrder == NoSortOrder)
-                isLeaf->IsLeaf = !node->HasChildren;
+                isLeaf->IsLeaf = !node->Children;
             else
                 isLeaf->IsLeaf = TRUE;
         }
@@ -419,7 +400,20 @@ BOOLEAN NTAPI WepWindowTreeNewCallback(
                 getCellText->Text = PhGetStringRef(node->ObjectNameString);
                 break;
             case TREE_COLUMN_ITEM_TIMEOUT:
-                getCellText->Text = PhGetStringRef(node->TimeoutString);
+                {
+                    if (node->Timeout.QuadPart > 0)
+                    {
+                        if (!node->TimeoutString)
+                        {
+                            SYSTEMTIME systemTime;
+
+                            PhLargeIntegerToLocalSystemTime(&systemTime, &node->Timeout);
+                            node->TimeoutString = PhFormatDateTime(&systemTime);
+                        }
+
+                        getCellText->Text = node->TimeoutString->sr;
+                    }
+                }
                 break;
             case TREE_COLUMN_ITEM_ALERTABLE:
                 {
@@ -437,7 +431,8 @@ BOOLEAN NTAPI WepWindowTreeNewCallback(
                 {
                     if (node->ObjectType == WctThreadType)
                     {
-                        getCellText->Text = PhGetStringRef(node->ProcessIdString);
+                        PhPrintUInt32(node->ProcessIdString, HandleToUlong(node->ProcessId));
+                        PhInitializeStringRef(&getCellText->Text, node->ProcessIdString);
                     }
                 }
                 break;
@@ -445,7 +440,8 @@ BOOLEAN NTAPI WepWindowTreeNewCallback(
                 {
                     if (node->ObjectType == WctThreadType)
                     {
-                        getCellText->Text = PhGetStringRef(node->ThreadIdString);
+                        PhPrintUInt32(node->ThreadIdString, HandleToUlong(node->ThreadId));
+                        PhInitializeStringRef(&getCellText->Text, node->ThreadIdString);
                     }
                 }
                 break;
@@ -453,7 +449,8 @@ BOOLEAN NTAPI WepWindowTreeNewCallback(
                 {
                     if (node->ObjectType == WctThreadType)
                     {
-                        getCellText->Text = PhGetStringRef(node->WaitTimeString);
+                        PhPrintUInt32(node->WaitTimeString, node->WaitTime);
+                        PhInitializeStringRef(&getCellText->Text, node->WaitTimeString);
                     }
                 }
                 break;
@@ -461,10 +458,32 @@ BOOLEAN NTAPI WepWindowTreeNewCallback(
                 {
                     if (node->ObjectType == WctThreadType)
                     {
-                        getCellText->Text = PhGetStringRef(node->ContextSwitchesString);
+                        PhPrintUInt32(node->ContextSwitchesString, node->ContextSwitches);
+                        PhInitializeStringRef(&getCellText->Text, node->ContextSwitchesString);
                     }
                 }
                 break;
+            case TREE_COLUMN_ITEM_CYCLE:
+                {
+                    // The graph is analyzed again as chains arrive, so these are not cached.
+                    if (node->GraphNode && node->GraphNode->InCycle)
+                    {
+                        if (node->GraphNode->CrossProcess)
+                            PhInitializeStringRef(&getCellText->Text, L"Cross-process");
+                        else
+                            PhInitializeStringRef(&getCellText->Text, L"Yes");
+                    }
+                }
+                return TRUE;
+            case TREE_COLUMN_ITEM_CHAINLENGTH:
+                {
+                    if (node->GraphNode && node->GraphNode->ChainLength != 0)
+                    {
+                        PhPrintUInt32(node->ChainLengthString, node->GraphNode->ChainLength);
+                        PhInitializeStringRef(&getCellText->Text, node->ChainLengthString);
+                    }
+                }
+                return TRUE;
             default:
                 return FALSE;
             }
@@ -477,7 +496,7 @@ BOOLEAN NTAPI WepWindowTreeNewCallback(
             PPH_TREENEW_GET_NODE_COLOR getNodeColor = (PPH_TREENEW_GET_NODE_COLOR)Parameter1;
             node = (PWCT_ROOT_NODE)getNodeColor->Node;
 
-            if (node->IsDeadLocked)
+            if (node->IsDeadLocked || (node->GraphNode && node->GraphNode->InCycle))
             {
                 getNodeColor->ForeColor = RGB(255, 0, 0);
             }
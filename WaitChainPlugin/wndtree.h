@@ -40,33 +40,43 @@ typedef enum _WCT_TREE_COLUMN_ITEM_NAME
     TREE_COLUMN_ITEM_THREADID = 6,
     TREE_COLUMN_ITEM_WAITTIME = 7,
     TREE_COLUMN_ITEM_CONTEXTSWITCH = 8,
+    TREE_COLUMN_ITEM_CYCLE = 9,
+    TREE_COLUMN_ITEM_CHAINLENGTH = 10,
     TREE_COLUMN_ITEM_MAXIMUM
 } WCT_TREE_COLUMN_ITEM_NAME;
 
+// Nodes keep the raw values from the wait chain; cell text is formatted into the
+// string buffers below the first time a column is drawn.
 typedef struct _WCT_ROOT_NODE
 {
     PH_TREENEW_NODE Node;
     struct _WCT_ROOT_NODE* Parent;
-    PPH_LIST Children;
-    BOOLEAN HasChildren;
+    PPH_LIST Children; // created when the first child is added
 
     BOOLEAN Alertable;
+    BOOLEAN IsDeadLocked;
     WCT_OBJECT_TYPE ObjectType;
     WCT_OBJECT_STATUS ObjectStatus;
-    PPH_STRING TimeoutString;
-    PPH_STRING ProcessIdString;
-    PPH_STRING ThreadIdString;
-    PPH_STRING WaitTimeString;
-    PPH_STRING ContextSwitchesString;
-    PPH_STRING ObjectNameString;
-
-    BOOLEAN IsDeadLocked;
+    PWAIT_GRAPH_NODE GraphNode;
 
+    // Thread nodes
     HANDLE ProcessId;
     HANDLE ThreadId;
+    ULONG WaitTime;
+    ULONG ContextSwitches;
+
+    // Lock nodes
+    LARGE_INTEGER Timeout;
+    PPH_STRING ObjectNameString;
+    PPH_STRING TimeoutString;
 
     PH_STRINGREF TextCache[TREE_COLUMN_ITEM_MAXIMUM];
     WCHAR WindowHandleString[PH_PTR_STR_LEN_1];
+    WCHAR ProcessIdString[PH_INT32_STR_LEN_1];
+    WCHAR ThreadIdString[PH_INT32_STR_LEN_1];
+    WCHAR WaitTimeString[PH_INT32_STR_LEN_1];
+    WCHAR ContextSwitchesString[PH_INT32_STR_LEN_1];
+    WCHAR ChainLengthString[PH_INT32_STR_LEN_1];
 } WCT_ROOT_NODE, *PWCT_ROOT_NODE;
 
 typedef struct _WCT_TREE_CONTEXT
@@ -91,7 +101,7 @@ VOID WtcDeleteWindowTree(
     _In_ PWCT_TREE_CONTEXT Context
     );
 
-VOID WctAddChildWindowNode(
+PWCT_ROOT_NODE WctAddChildWindowNode(
     _In_ PWCT_TREE_CONTEXT Context,
     _In_opt_ PWCT_ROOT_NODE ParentNode,
     _In_ PWAITCHAIN_NODE_INFO WctNode,
@@ -0,0 +1,112 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Cancel Context
+ *
+ * Copyright (C) 2016 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <phdk.h>
+#include "cancel.h"
+
+/**
+ * Creates a cancel context for a window. The caller owns the initial reference
+ * and releases it after signaling the context.
+ */
+PCANCEL_CONTEXT CreateCancelContext(
+    _In_ HWND WindowHandle
+    )
+{
+    PCANCEL_CONTEXT context;
+
+    context = PhAllocate(sizeof(CANCEL_CONTEXT));
+    context->RefCount = 1;
+    PhInitializeQueuedLock(&context->Lock);
+    context->WindowHandle = WindowHandle;
+
+    return context;
+}
+
+/**
+ * Adds a reference for a work item. The work item releases it when it has
+ * finished posting.
+ */
+PCANCEL_CONTEXT ReferenceCancelContext(
+    _In_ PCANCEL_CONTEXT Context
+    )
+{
+    InterlockedIncrement(&Context->RefCount);
+
+    return Context;
+}
+
+VOID DereferenceCancelContext(
+    _In_ PCANCEL_CONTEXT Context
+    )
+{
+    if (InterlockedDecrement(&Context->RefCount) == 0)
+        PhFree(Context);
+}
+
+/**
+ * Stops further posts to the window. Every message posted before this returns is
+ * already in the window's queue, so the window can drain the queue afterwards and
+ * free what it finds.
+ */
+VOID SignalCancelContext(
+    _In_ PCANCEL_CONTEXT Context
+    )
+{
+    PhAcquireQueuedLockExclusive(&Context->Lock);
+    Context->WindowHandle = NULL;
+    PhReleaseQueuedLockExclusive(&Context->Lock);
+}
+
+/**
+ * Checks whether the window has gone away, so that work can stop early.
+ */
+BOOLEAN IsCancelContextSignaled(
+    _In_ PCANCEL_CONTEXT Context
+    )
+{
+    return ReadPointerAcquire((PVOID volatile *)&Context->WindowHandle) == NULL;
+}
+
+/**
+ * Posts a message to the window unless the context has been signaled.
+ *
+ * \return TRUE if the message was posted and the window now owns \a lParam, or
+ * FALSE if the caller must free it.
+ */
+BOOLEAN PostCancelContextMessage(
+    _In_ PCANCEL_CONTEXT Context,
+    _In_ UINT Message,
+    _In_ WPARAM wParam,
+    _In_ LPARAM lParam
+    )
+{
+    BOOLEAN posted = FALSE;
+
+    PhAcquireQueuedLockShared(&Context->Lock);
+
+    if (Context->WindowHandle)
+        posted = !!PostMessage(Context->WindowHandle, Message, wParam, lParam);
+
+    PhReleaseQueuedLockShared(&Context->Lock);
+
+    return posted;
+}
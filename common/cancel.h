@@ -0,0 +1,66 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Cancel Context
+ *
+ * Copyright (C) 2016 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CANCEL_H_
+#define _CANCEL_H_
+
+// Lets background work post its results to a window that may be destroyed while the
+// work is running. The window and each work item hold a reference. When the window
+// is destroyed it signals the context and then drains its message queue; work that
+// posts afterwards is told so and frees its own results. Used by the Security
+// Explorer and Object Manager plugins.
+
+typedef struct _CANCEL_CONTEXT
+{
+    volatile LONG RefCount;
+    PH_QUEUED_LOCK Lock; // protects WindowHandle
+    HWND WindowHandle; // NULL once signaled
+} CANCEL_CONTEXT, *PCANCEL_CONTEXT;
+
+PCANCEL_CONTEXT CreateCancelContext(
+    _In_ HWND WindowHandle
+    );
+
+PCANCEL_CONTEXT ReferenceCancelContext(
+    _In_ PCANCEL_CONTEXT Context
+    );
+
+VOID DereferenceCancelContext(
+    _In_ PCANCEL_CONTEXT Context
+    );
+
+VOID SignalCancelContext(
+    _In_ PCANCEL_CONTEXT Context
+    );
+
+BOOLEAN IsCancelContextSignaled(
+    _In_ PCANCEL_CONTEXT Context
+    );
+
+BOOLEAN PostCancelContextMessage(
+    _In_ PCANCEL_CONTEXT Context,
+    _In_ UINT Message,
+    _In_ WPARAM wParam,
+    _In_ LPARAM lParam
+    );
+
+#endif
@@ -0,0 +1,258 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Graph History
+ *
+ * Copyright (C) 2015-2019 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <phdk.h>
+#include "history.h"
+
+// 10 second buckets for the last hour, 1 minute buckets for the last day.
+static const struct
+{
+    ULONG64 Duration;
+    ULONG Size;
+} HistoryTierLayout[HISTORY_TIER_COUNT] =
+{
+    { 10 * 1000, 360 },
+    { 60 * 1000, 1440 }
+};
+
+VOID HistoryInitializeStore(
+    _Out_ PHISTORY_STORE Store
+    )
+{
+    memset(Store, 0, sizeof(HISTORY_STORE));
+    PhInitializeQueuedLock(&Store->Lock);
+
+    for (ULONG i = 0; i < HISTORY_TIER_COUNT; i++)
+    {
+        PHISTORY_TIER tier = &Store->Tiers[i];
+
+        tier->Duration = HistoryTierLayout[i].Duration;
+        tier->Size = HistoryTierLayout[i].Size;
+        tier->Buckets = PhAllocate(tier->Size * sizeof(HISTORY_BUCKET));
+    }
+}
+
+VOID HistoryDeleteStore(
+    _Inout_ PHISTORY_STORE Store
+    )
+{
+    for (ULONG i = 0; i < HISTORY_TIER_COUNT; i++)
+    {
+        if (Store->Tiers[i].Buckets)
+        {
+            PhFree(Store->Tiers[i].Buckets);
+            Store->Tiers[i].Buckets = NULL;
+        }
+    }
+}
+
+static VOID HistorypAddTierSample(
+    _Inout_ PHISTORY_TIER Tier,
+    _In_ ULONG64 Time,
+    _In_ FLOAT Value
+    )
+{
+    ULONG64 startTime = Time - Time % Tier->Duration;
+    PHISTORY_BUCKET bucket;
+
+    if (Tier->Count == 0 || startTime > Tier->StartTime)
+    {
+        ULONG64 steps;
+
+        if (Tier->Count != 0)
+            steps = min((startTime - Tier->StartTime) / Tier->Duration, Tier->Size);
+        else
+            steps = 1;
+
+        // Buckets that were skipped over (for example while the machine was asleep)
+        // are left empty so they show up as gaps.
+        while (steps--)
+        {
+            Tier->Index = (Tier->Index == 0 ? Tier->Size : Tier->Index) - 1;
+            memset(&Tier->Buckets[Tier->Index], 0, sizeof(HISTORY_BUCKET));
+
+            if (Tier->Count < Tier->Size)
+                Tier->Count++;
+        }
+
+        Tier->StartTime = startTime;
+        Tier->Sum = 0;
+    }
+
+    // A sample that is older than the newest bucket (the clock moved backwards) is
+    // folded into the newest bucket.
+    bucket = &Tier->Buckets[Tier->Index];
+
+    if (bucket->Count == 0)
+    {
+        bucket->Minimum = Value;
+        bucket->Maximum = Value;
+    }
+    else
+    {
+        if (bucket->Minimum > Value)
+            bucket->Minimum = Value;
+        if (bucket->Maximum < Value)
+            bucket->Maximum = Value;
+    }
+
+    bucket->Count++;
+    Tier->Sum += Value;
+    bucket->Average = (FLOAT)(Tier->Sum / bucket->Count);
+}
+
+VOID HistoryAddSample(
+    _Inout_ PHISTORY_STORE Store,
+    _In_ ULONG64 Time,
+    _In_ FLOAT Value
+    )
+{
+    PhAcquireQueuedLockExclusive(&Store->Lock);
+
+    for (ULONG i = 0; i < HISTORY_TIER_COUNT; i++)
+    {
+        HistorypAddTierSample(&Store->Tiers[i], Time, Value);
+    }
+
+    PhReleaseQueuedLockExclusive(&Store->Lock);
+}
+
+/**
+ * Resamples a time range into evenly spaced points.
+ *
+ * \param Store The history store.
+ * \param EndTime The end of the range.
+ * \param Span The length of the range. Spans longer than the coarsest tier are only
+ * partly covered.
+ * \param Count The number of points to produce.
+ * \param Points Receives the points, newest first. Point i covers the interval ending
+ * at EndTime - Span * i / Count. Points with no samples have a Count of zero.
+ *
+ * \return The number of points up to and including the oldest point that has data.
+ */
+ULONG HistoryQueryRange(
+    _In_ PHISTORY_STORE Store,
+    _In_ ULONG64 EndTime,
+    _In_ ULONG64 Span,
+    _In_ ULONG Count,
+    _Out_writes_(Count) PHISTORY_BUCKET Points
+    )
+{
+    PHISTORY_TIER tier;
+    ULONG64 newestStart;
+    ULONG64 duration;
+    ULONG result = 0;
+
+    if (Count == 0)
+        return 0;
+
+    memset(Points, 0, Count * sizeof(HISTORY_BUCKET));
+
+    if (Span == 0)
+        return 0;
+
+    PhAcquireQueuedLockShared(&Store->Lock);
+
+    // Use the finest tier that still reaches back far enough.
+    tier = &Store->Tiers[HISTORY_TIER_COUNT - 1];
+
+    for (ULONG i = 0; i < HISTORY_TIER_COUNT; i++)
+    {
+        if (Store->Tiers[i].Duration * Store->Tiers[i].Size >= Span)
+        {
+            tier = &Store->Tiers[i];
+            break;
+        }
+    }
+
+    if (tier->Count == 0)
+    {
+        PhReleaseQueuedLockShared(&Store->Lock);
+        return 0;
+    }
+
+    newestStart = tier->StartTime;
+    duration = tier->Duration;
+
+    for (ULONG i = 0; i < Count; i++)
+    {
+        ULONG64 slotEnd;
+        ULONG64 slotStart;
+        ULONG64 first;
+        ULONG64 last;
+        DOUBLE sum = 0;
+        PHISTORY_BUCKET point = &Points[i];
+
+        if (Span * (i + 1) / Count > EndTime)
+            break;
+
+        slotEnd = EndTime - Span * i / Count;
+        slotStart = EndTime - Span * (i + 1) / Count;
+
+        // Bucket k covers [newestStart - k * duration, newestStart - (k - 1) * duration).
+        if (slotStart >= newestStart + duration)
+            continue;
+
+        first = newestStart >= slotEnd ? (newestStart - slotEnd) / duration + 1 : 0;
+        last = (newestStart + duration - slotStart - 1) / duration;
+
+        if (first >= tier->Count)
+            break;
+
+        if (last >= tier->Count)
+            last = tier->Count - 1;
+
+        for (ULONG64 k = first; k <= last; k++)
+        {
+            PHISTORY_BUCKET bucket = &tier->Buckets[(tier->Index + k) % tier->Size];
+
+            if (bucket->Count == 0)
+                continue;
+
+            if (point->Count == 0)
+            {
+                point->Minimum = bucket->Minimum;
+                point->Maximum = bucket->Maximum;
+            }
+            else
+            {
+                if (point->Minimum > bucket->Minimum)
+                    point->Minimum = bucket->Minimum;
+                if (point->Maximum < bucket->Maximum)
+                    point->Maximum = bucket->Maximum;
+            }
+
+            point->Count += bucket->Count;
+            sum += (DOUBLE)bucket->Average * bucket->Count;
+        }
+
+        if (point->Count != 0)
+        {
+            point->Average = (FLOAT)(sum / point->Count);
+            result = i + 1;
+        }
+    }
+
+    PhReleaseQueuedLockShared(&Store->Lock);
+
+    return result;
+}
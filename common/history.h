@@ -0,0 +1,84 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Graph History
+ *
+ * Copyright (C) 2015-2019 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HISTORY_H_
+#define _HISTORY_H_
+
+// Long-horizon graph history, shared by the PerfMon and NvGpu plugins. Every sample
+// is folded into the current bucket of each tier, so a series costs the same amount
+// of memory however long it runs. Times are in milliseconds and are supplied by the
+// caller.
+//
+// A store is filled by a provider thread and queried by the graphs on the UI thread;
+// Lock serializes the two.
+
+#define HISTORY_TIER_COUNT 2
+#define HISTORY_MAXIMUM_SPAN (24 * 60 * 60 * 1000ULL)
+
+typedef struct _HISTORY_BUCKET
+{
+    FLOAT Minimum;
+    FLOAT Maximum;
+    FLOAT Average;
+    ULONG Count; // zero for a gap
+} HISTORY_BUCKET, *PHISTORY_BUCKET;
+
+typedef struct _HISTORY_TIER
+{
+    ULONG64 Duration; // of one bucket
+    ULONG Size;
+    ULONG Count;
+    ULONG Index; // newest bucket
+    ULONG64 StartTime; // of the newest bucket
+    DOUBLE Sum; // of the newest bucket
+    PHISTORY_BUCKET Buckets;
+} HISTORY_TIER, *PHISTORY_TIER;
+
+typedef struct _HISTORY_STORE
+{
+    PH_QUEUED_LOCK Lock;
+    HISTORY_TIER Tiers[HISTORY_TIER_COUNT]; // finest first
+} HISTORY_STORE, *PHISTORY_STORE;
+
+VOID HistoryInitializeStore(
+    _Out_ PHISTORY_STORE Store
+    );
+
+VOID HistoryDeleteStore(
+    _Inout_ PHISTORY_STORE Store
+    );
+
+VOID HistoryAddSample(
+    _Inout_ PHISTORY_STORE Store,
+    _In_ ULONG64 Time,
+    _In_ FLOAT Value
+    );
+
+ULONG HistoryQueryRange(
+    _In_ PHISTORY_STORE Store,
+    _In_ ULONG64 EndTime,
+    _In_ ULONG64 Span,
+    _In_ ULONG Count,
+    _Out_writes_(Count) PHISTORY_BUCKET Points
+    );
+
+#endif
@@ -0,0 +1,130 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Graph History
+ *
+ * Copyright (C) 2015-2019 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Benchmark for the history store: the cost of adding a sample on the provider thread,
+// of a graph query on the UI thread, and of adding while a graph is querying. It is
+// not part of the plugin build.
+//
+//   gcc -O2 -Ishim -I.. history_bench.c ../history.c -o history_bench -lpthread
+//   ./history_bench
+
+#include <stdio.h>
+#include <time.h>
+#include <phdk.h>
+#include "history.h"
+
+#define SECOND 1000ULL
+#define HOUR (3600 * SECOND)
+#define DAY (24 * HOUR)
+
+static double BenchNow(
+    void
+    )
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+typedef struct _BENCH_CONTEXT
+{
+    HISTORY_STORE Store;
+    volatile int Done;
+    ULONG Queries;
+} BENCH_CONTEXT;
+
+static void *BenchGraphThread(
+    void *Parameter
+    )
+{
+    static HISTORY_BUCKET points[1000];
+    BENCH_CONTEXT *context = Parameter;
+
+    // Redraw continuously, far more often than a real graph.
+    while (!__atomic_load_n(&context->Done, __ATOMIC_ACQUIRE))
+    {
+        HistoryQueryRange(&context->Store, 2 * DAY, DAY, 1000, points);
+        context->Queries++;
+    }
+
+    return NULL;
+}
+
+int main(
+    void
+    )
+{
+    static HISTORY_BUCKET points[1000];
+    const ULONG addCount = 10000000;
+    const ULONG queryCount = 20000;
+    BENCH_CONTEXT context;
+    pthread_t thread;
+    volatile float sink = 0;
+    double start;
+    double elapsed;
+
+    // Two days of samples at 60 Hz, so that both tiers are full.
+    HistoryInitializeStore(&context.Store);
+    start = BenchNow();
+
+    for (ULONG i = 0; i < addCount; i++)
+        HistoryAddSample(&context.Store, (ULONG64)i * 2 * DAY / addCount, (FLOAT)(i % 100));
+
+    printf("add:              %7.1f ns/sample\n", (BenchNow() - start) / addCount);
+
+    for (ULONG pass = 0; pass < 2; pass++)
+    {
+        ULONG64 span = pass ? DAY : HOUR;
+
+        start = BenchNow();
+
+        for (ULONG i = 0; i < queryCount; i++)
+        {
+            HistoryQueryRange(&context.Store, 2 * DAY, span, 1000, points);
+            sink += points[0].Average;
+        }
+
+        printf("query %s, 1000 points: %7.1f us\n", pass ? "1 day " : "1 hour", (BenchNow() - start) / queryCount / 1000);
+    }
+
+    // The provider thread's cost while a graph holds the lock shared.
+    context.Done = 0;
+    context.Queries = 0;
+    pthread_create(&thread, NULL, BenchGraphThread, &context);
+    start = BenchNow();
+
+    for (ULONG i = 0; i < addCount / 10; i++)
+        HistoryAddSample(&context.Store, 2 * DAY + (ULONG64)i * 10, (FLOAT)(i % 100));
+
+    elapsed = BenchNow() - start;
+    __atomic_store_n(&context.Done, 1, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+
+    printf("add, contended:   %7.1f ns/sample (%lu queries)\n", elapsed / (addCount / 10), (unsigned long)context.Queries);
+
+    HistoryDeleteStore(&context.Store);
+
+    return sink < 0;
+}
@@ -0,0 +1,365 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Graph History
+ *
+ * Copyright (C) 2015-2019 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Tests for the history store rollups. They are not part of the plugin build; the
+// shim directory stands in for phdk.h.
+//
+//   gcc -g -O1 -fsanitize=address,undefined -Ishim -I.. history_test.c ../history.c -o history_test -lpthread -lm
+//   gcc -g -O1 -fsanitize=thread -Ishim -I.. history_test.c ../history.c -o history_test -lpthread -lm
+//   ./history_test
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <phdk.h>
+#include "history.h"
+
+static int TestFailures = 0;
+
+#define CHECK(Expression) \
+    do { if (!(Expression)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #Expression); TestFailures++; } } while (0)
+
+#define SECOND 1000ULL
+#define HOUR (3600 * SECOND)
+#define DAY (24 * HOUR)
+
+static uint64_t TestRandomState = 0x2545f4914f6cdd1d;
+
+static uint32_t TestRandom(
+    void
+    )
+{
+    TestRandomState ^= TestRandomState << 13;
+    TestRandomState ^= TestRandomState >> 7;
+    TestRandomState ^= TestRandomState << 17;
+
+    return (uint32_t)TestRandomState;
+}
+
+static int TestNear(
+    double Value,
+    double Expected
+    )
+{
+    return fabs(Value - Expected) <= 1e-3 * (fabs(Expected) + 1);
+}
+
+static void TestBucketAggregation(
+    void
+    )
+{
+    HISTORY_STORE store;
+    HISTORY_BUCKET points[360];
+    ULONG result;
+
+    HistoryInitializeStore(&store);
+
+    // Ten samples in one 10 second bucket.
+    for (ULONG i = 0; i < 10; i++)
+        HistoryAddSample(&store, 100 * SECOND + i * SECOND, (FLOAT)(i + 1));
+
+    CHECK(store.Tiers[0].Count == 1);
+    CHECK(store.Tiers[0].StartTime == 100 * SECOND);
+    CHECK(store.Tiers[1].Count == 1);
+    CHECK(store.Tiers[1].StartTime == 60 * SECOND);
+
+    result = HistoryQueryRange(&store, 110 * SECOND, HOUR, 360, points);
+    CHECK(result == 1);
+    CHECK(points[0].Count == 10);
+    CHECK(points[0].Minimum == 1);
+    CHECK(points[0].Maximum == 10);
+    CHECK(TestNear(points[0].Average, 5.5));
+    CHECK(points[1].Count == 0);
+
+    // The next sample opens a new bucket.
+    HistoryAddSample(&store, 110 * SECOND, 20);
+    CHECK(store.Tiers[0].Count == 2);
+    CHECK(store.Tiers[1].Count == 1);
+
+    result = HistoryQueryRange(&store, 120 * SECOND, HOUR, 360, points);
+    CHECK(result == 2);
+    CHECK(points[0].Count == 1 && points[0].Average == 20);
+    CHECK(points[1].Count == 10);
+
+    // Both buckets fold into one point when a point covers a minute.
+    result = HistoryQueryRange(&store, 120 * SECOND, HOUR, 60, points);
+    CHECK(result == 1);
+    CHECK(points[0].Count == 11);
+    CHECK(points[0].Minimum == 1);
+    CHECK(points[0].Maximum == 20);
+    CHECK(TestNear(points[0].Average, (55.0 + 20.0) / 11));
+
+    // No data, no span, no points.
+    CHECK(HistoryQueryRange(&store, 120 * SECOND, 0, 60, points) == 0);
+    CHECK(HistoryQueryRange(&store, 120 * SECOND, HOUR, 0, points) == 0);
+
+    HistoryDeleteStore(&store);
+}
+
+static void TestGapsAndWrap(
+    void
+    )
+{
+    HISTORY_STORE store;
+    HISTORY_BUCKET points[360];
+    ULONG result;
+
+    HistoryInitializeStore(&store);
+
+    // A 100 second gap (sleep) leaves nine empty buckets.
+    HistoryAddSample(&store, 1000 * SECOND, 1);
+    HistoryAddSample(&store, 1100 * SECOND, 2);
+    CHECK(store.Tiers[0].Count == 11);
+
+    result = HistoryQueryRange(&store, 1110 * SECOND, HOUR, 360, points);
+    CHECK(result == 11);
+    CHECK(points[0].Count == 1 && points[0].Maximum == 2);
+
+    for (ULONG i = 1; i < 10; i++)
+        CHECK(points[i].Count == 0);
+
+    CHECK(points[10].Count == 1 && points[10].Maximum == 1);
+
+    // A sample from the past (the clock moved backwards) folds into the newest bucket.
+    HistoryAddSample(&store, 500 * SECOND, 8);
+    CHECK(store.Tiers[0].Count == 11);
+    result = HistoryQueryRange(&store, 1110 * SECOND, HOUR, 360, points);
+    CHECK(points[0].Count == 2 && points[0].Maximum == 8 && points[0].Minimum == 2);
+
+    // Gaps longer than a tier clear it without stepping through every bucket.
+    HistoryAddSample(&store, 1100 * SECOND + 10 * DAY, 3);
+    CHECK(store.Tiers[0].Count == store.Tiers[0].Size);
+    CHECK(store.Tiers[1].Count == store.Tiers[1].Size);
+
+    result = HistoryQueryRange(&store, 1110 * SECOND + 10 * DAY, HOUR, 360, points);
+    CHECK(result == 1);
+    CHECK(points[0].Count == 1 && points[0].Maximum == 3);
+
+    // Two hours of samples every second: the finest tier keeps only the last hour.
+    HistoryDeleteStore(&store);
+    HistoryInitializeStore(&store);
+
+    for (ULONG64 t = 0; t < 2 * HOUR; t += SECOND)
+        HistoryAddSample(&store, t, (FLOAT)(t / SECOND));
+
+    CHECK(store.Tiers[0].Count == 360);
+    CHECK(store.Tiers[1].Count == 120);
+
+    result = HistoryQueryRange(&store, 2 * HOUR, HOUR, 360, points);
+    CHECK(result == 360);
+    CHECK(points[0].Minimum == 7190 && points[0].Maximum == 7199 && points[0].Count == 10);
+    CHECK(points[359].Minimum == 3600 && points[359].Count == 10);
+
+    HistoryDeleteStore(&store);
+}
+
+typedef struct _TEST_SAMPLE
+{
+    ULONG64 Time;
+    FLOAT Value;
+} TEST_SAMPLE;
+
+// Compares a query whose points line up with bucket boundaries against the raw samples.
+static void TestCompareRange(
+    PHISTORY_STORE Store,
+    TEST_SAMPLE *Samples,
+    size_t SampleCount,
+    ULONG64 EndTime,
+    ULONG64 Span,
+    ULONG Count
+    )
+{
+    static HISTORY_BUCKET points[1440];
+    ULONG result;
+    ULONG expectedResult = 0;
+    ULONG64 slot = Span / Count;
+
+    result = HistoryQueryRange(Store, EndTime, Span, Count, points);
+
+    for (ULONG i = 0; i < Count; i++)
+    {
+        ULONG64 slotEnd = EndTime - slot * i;
+        ULONG64 slotStart = EndTime - slot * (i + 1);
+        ULONG count = 0;
+        FLOAT minimum = 0;
+        FLOAT maximum = 0;
+        double sum = 0;
+
+        if (slot * (i + 1) > EndTime)
+            break;
+
+        for (size_t j = 0; j < SampleCount; j++)
+        {
+            if (Samples[j].Time < slotStart || Samples[j].Time >= slotEnd)
+                continue;
+
+            if (count == 0 || minimum > Samples[j].Value)
+                minimum = Samples[j].Value;
+            if (count == 0 || maximum < Samples[j].Value)
+                maximum = Samples[j].Value;
+
+            sum += Samples[j].Value;
+            count++;
+        }
+
+        CHECK(points[i].Count == count);
+
+        if (count != 0)
+        {
+            CHECK(points[i].Minimum == minimum);
+            CHECK(points[i].Maximum == maximum);
+            CHECK(TestNear(points[i].Average, sum / count));
+            expectedResult = i + 1;
+        }
+    }
+
+    CHECK(result == expectedResult);
+}
+
+static void TestRandomRollups(
+    void
+    )
+{
+    static TEST_SAMPLE samples[20000];
+
+    for (ULONG round = 0; round < 20; round++)
+    {
+        HISTORY_STORE store;
+        size_t count = 0;
+        ULONG64 time = (ULONG64)(TestRandom() % 1000) * SECOND;
+
+        HistoryInitializeStore(&store);
+
+        while (count < sizeof(samples) / sizeof(samples[0]))
+        {
+            // Mostly steady sampling with the occasional stall or sleep.
+            switch (TestRandom() % 16)
+            {
+            case 0:
+                time += (ULONG64)(TestRandom() % 600) * SECOND;
+                break;
+            case 1:
+                time += (ULONG64)(TestRandom() % 4) * HOUR;
+                break;
+            default:
+                time += 1 + TestRandom() % (2 * SECOND);
+                break;
+            }
+
+            samples[count].Time = time;
+            samples[count].Value = (FLOAT)(TestRandom() % 10000) / 100;
+            HistoryAddSample(&store, samples[count].Time, samples[count].Value);
+            count++;
+        }
+
+        // One point per bucket, several buckets per point, for both tiers.
+        TestCompareRange(&store, samples, count, store.Tiers[0].StartTime + 10 * SECOND, HOUR, 360);
+        TestCompareRange(&store, samples, count, store.Tiers[0].StartTime + 10 * SECOND, HOUR, 60);
+        TestCompareRange(&store, samples, count, store.Tiers[1].StartTime + 60 * SECOND, DAY, 1440);
+        TestCompareRange(&store, samples, count, store.Tiers[1].StartTime + 60 * SECOND, DAY, 96);
+
+        HistoryDeleteStore(&store);
+    }
+}
+
+typedef struct _TEST_THREAD_CONTEXT
+{
+    HISTORY_STORE Store;
+    volatile int Done;
+    ULONG Queries;
+    ULONG Violations;
+} TEST_THREAD_CONTEXT;
+
+static void *TestProviderThread(
+    void *Parameter
+    )
+{
+    TEST_THREAD_CONTEXT *context = Parameter;
+
+    for (ULONG64 i = 0; i < 400000; i++)
+        HistoryAddSample(&context->Store, i * 250, (FLOAT)(i % 1000));
+
+    __atomic_store_n(&context->Done, 1, __ATOMIC_RELEASE);
+
+    return NULL;
+}
+
+// The provider thread fills the store while the graph queries it. Every point must be
+// internally consistent; ThreadSanitizer reports any access outside the lock.
+static void TestConcurrentQueries(
+    void
+    )
+{
+    static HISTORY_BUCKET points[500];
+    TEST_THREAD_CONTEXT context;
+    pthread_t thread;
+
+    memset(&context, 0, sizeof(context));
+    HistoryInitializeStore(&context.Store);
+    CHECK(pthread_create(&thread, NULL, TestProviderThread, &context) == 0);
+
+    while (!__atomic_load_n(&context.Done, __ATOMIC_ACQUIRE))
+    {
+        ULONG result = HistoryQueryRange(&context.Store, 400000 * 250, context.Queries % 2 ? HOUR : DAY, 500, points);
+
+        for (ULONG i = 0; i < result; i++)
+        {
+            if (points[i].Count == 0)
+                continue;
+
+            if (points[i].Minimum > points[i].Maximum ||
+                points[i].Average < points[i].Minimum - 1e-3f ||
+                points[i].Average > points[i].Maximum + 1e-3f)
+            {
+                context.Violations++;
+            }
+        }
+
+        context.Queries++;
+    }
+
+    pthread_join(thread, NULL);
+    CHECK(context.Violations == 0);
+    HistoryDeleteStore(&context.Store);
+}
+
+int main(
+    void
+    )
+{
+    TestBucketAggregation();
+    TestGapsAndWrap();
+    TestRandomRollups();
+    TestConcurrentQueries();
+
+    if (TestFailures)
+    {
+        printf("%d checks failed\n", TestFailures);
+        return 1;
+    }
+
+    printf("all tests passed\n");
+
+    return 0;
+}
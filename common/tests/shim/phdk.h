@@ -0,0 +1,712 @@
+/*
+ * Process Hacker Extra Plugins -
+ *   Graph History
+ *
+ * Copyright (C) 2015-2019 dmex
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _PHDK_SHIM_H
+#define _PHDK_SHIM_H
+
+// The subset of phdk.h used by the portable units (common\history.c,
+// WaitChainPlugin\waitanalyze.c, ObjectManagerPlugin\objindex.c and
+// FirmwarePlugin\efinames.c), so that their
+// tests and benchmarks can be built with gcc or clang outside of the SDK. Queued locks
+// map to pthread reader/writer locks, and strings, lists and hashtables are minimal
+// reimplementations with the same interface. Not part of any plugin build.
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wctype.h>
+
+#define _In_
+#define _In_opt_
+#define _Out_
+#define _Out_opt_
+#define _Inout_
+#define _Out_writes_(Count)
+
+#define NTAPI
+#define FORCEINLINE static inline
+#define VOID void
+#define TRUE 1
+#define FALSE 0
+typedef void *PVOID;
+typedef void *HANDLE, **PHANDLE;
+typedef unsigned char BOOLEAN, *PBOOLEAN, UCHAR, *PUCHAR;
+typedef uint16_t USHORT, WCHAR, *PWCHAR, *PWCH, *PWSTR;
+typedef int32_t LONG;
+typedef uint32_t ULONG, *PULONG;
+typedef uint64_t ULONG64;
+typedef uintptr_t ULONG_PTR;
+typedef size_t SIZE_T;
+typedef float FLOAT;
+typedef double DOUBLE;
+
+// ULONG is 32 bits wide on Windows.
+#undef ULONG_MAX
+#define ULONG_MAX 0xffffffffUL
+
+#define ARRAYSIZE(Array) (sizeof(Array) / sizeof((Array)[0]))
+
+#ifndef min
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+static inline void *PhAllocate(size_t Size)
+{
+    void *buffer = malloc(Size);
+
+    if (!buffer)
+        abort();
+
+    return buffer;
+}
+
+static inline void *PhReAllocate(void *Memory, size_t Size)
+{
+    void *buffer = realloc(Memory, Size);
+
+    if (!buffer)
+        abort();
+
+    return buffer;
+}
+
+static inline void PhFree(void *Memory)
+{
+    free(Memory);
+}
+
+typedef pthread_rwlock_t PH_QUEUED_LOCK, *PPH_QUEUED_LOCK;
+
+#define PhInitializeQueuedLock(Lock) pthread_rwlock_init((Lock), NULL)
+#define PhAcquireQueuedLockExclusive(Lock) pthread_rwlock_wrlock(Lock)
+#define PhReleaseQueuedLockExclusive(Lock) pthread_rwlock_unlock(Lock)
+#define PhAcquireQueuedLockShared(Lock) pthread_rwlock_rdlock(Lock)
+#define PhReleaseQueuedLockShared(Lock) pthread_rwlock_unlock(Lock)
+
+typedef struct _PH_INITONCE
+{
+    pthread_mutex_t Mutex;
+    BOOLEAN Done;
+} PH_INITONCE, *PPH_INITONCE;
+
+#define PH_INITONCE_INIT { PTHREAD_MUTEX_INITIALIZER, FALSE }
+
+// Returns TRUE for the caller that must initialize; it then calls PhEndInitOnce.
+static inline BOOLEAN PhBeginInitOnce(
+    PPH_INITONCE InitOnce
+    )
+{
+    pthread_mutex_lock(&InitOnce->Mutex);
+
+    if (!InitOnce->Done)
+        return TRUE;
+
+    pthread_mutex_unlock(&InitOnce->Mutex);
+
+    return FALSE;
+}
+
+static inline void PhEndInitOnce(
+    PPH_INITONCE InitOnce
+    )
+{
+    InitOnce->Done = TRUE;
+    pthread_mutex_unlock(&InitOnce->Mutex);
+}
+
+typedef struct _GUID
+{
+    uint32_t Data1;
+    uint16_t Data2;
+    uint16_t Data3;
+    uint8_t Data4[8];
+} GUID, *PGUID;
+
+static inline int IsEqualGUID(
+    const GUID *Guid1,
+    const GUID *Guid2
+    )
+{
+    return memcmp(Guid1, Guid2, sizeof(GUID)) == 0;
+}
+
+static inline ULONG PhHashBytes(
+    PUCHAR Bytes,
+    SIZE_T Length
+    )
+{
+    ULONG hash = 2166136261u;
+
+    for (SIZE_T i = 0; i < Length; i++)
+    {
+        hash ^= Bytes[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+// Objects. A reference count and a delete procedure precede the body.
+
+typedef struct _PH_SHIM_OBJECT_HEADER
+{
+    LONG RefCount;
+    void (*DeleteProcedure)(PVOID Object);
+    uint64_t Align;
+} PH_SHIM_OBJECT_HEADER;
+
+static inline PVOID PhShimCreateObject(
+    SIZE_T Size,
+    void (*DeleteProcedure)(PVOID Object)
+    )
+{
+    PH_SHIM_OBJECT_HEADER *header = PhAllocate(sizeof(PH_SHIM_OBJECT_HEADER) + Size);
+
+    header->RefCount = 1;
+    header->DeleteProcedure = DeleteProcedure;
+
+    return header + 1;
+}
+
+static inline PVOID PhReferenceObject(
+    PVOID Object
+    )
+{
+    ((PH_SHIM_OBJECT_HEADER *)Object - 1)->RefCount++;
+
+    return Object;
+}
+
+static inline void PhDereferenceObject(
+    PVOID Object
+    )
+{
+    PH_SHIM_OBJECT_HEADER *header = (PH_SHIM_OBJECT_HEADER *)Object - 1;
+
+    if (--header->RefCount == 0)
+    {
+        if (header->DeleteProcedure)
+            header->DeleteProcedure(Object);
+
+        PhFree(header);
+    }
+}
+
+// Strings. L"" literals are only UTF-16 with -fshort-wchar. RtlUpcaseUnicodeChar
+// follows the C library, so tests that need more than ASCII must set a UTF-8 locale.
+
+typedef struct _PH_STRINGREF
+{
+    SIZE_T Length; // in bytes
+    PWCH Buffer;
+} PH_STRINGREF, *PPH_STRINGREF;
+
+#define PH_STRINGREF_INIT(String) { sizeof(String) - sizeof(WCHAR), (String) }
+
+typedef struct _PH_STRING
+{
+    union
+    {
+        PH_STRINGREF sr;
+        struct
+        {
+            SIZE_T Length;
+            PWCH Buffer;
+        };
+    };
+    WCHAR Data[1];
+} PH_STRING, *PPH_STRING;
+
+static inline WCHAR RtlUpcaseUnicodeChar(
+    WCHAR Character
+    )
+{
+    wint_t upper = towupper(Character);
+
+    return upper <= 0xffff ? (WCHAR)upper : Character;
+}
+
+static inline PPH_STRING PhCreateStringEx(
+    PWCHAR Buffer,
+    SIZE_T Length
+    )
+{
+    PPH_STRING string = PhShimCreateObject(sizeof(PH_STRING) + Length, NULL);
+
+    string->Length = Length;
+    string->Buffer = string->Data;
+
+    if (Buffer)
+        memcpy(string->Buffer, Buffer, Length);
+
+    string->Buffer[Length / sizeof(WCHAR)] = 0;
+
+    return string;
+}
+
+static inline PPH_STRING PhCreateString2(
+    PPH_STRINGREF String
+    )
+{
+    return PhCreateStringEx(String->Buffer, String->Length);
+}
+
+static inline BOOLEAN PhEqualStringRef(
+    PPH_STRINGREF String1,
+    PPH_STRINGREF String2,
+    BOOLEAN IgnoreCase
+    )
+{
+    if (String1->Length != String2->Length)
+        return FALSE;
+
+    for (SIZE_T i = 0; i < String1->Length / sizeof(WCHAR); i++)
+    {
+        WCHAR c1 = String1->Buffer[i];
+        WCHAR c2 = String2->Buffer[i];
+
+        if (IgnoreCase ? RtlUpcaseUnicodeChar(c1) != RtlUpcaseUnicodeChar(c2) : c1 != c2)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static inline ULONG PhHashStringRef(
+    PPH_STRINGREF String,
+    BOOLEAN IgnoreCase
+    )
+{
+    ULONG hash = 2166136261u;
+
+    for (SIZE_T i = 0; i < String->Length / sizeof(WCHAR); i++)
+    {
+        hash ^= IgnoreCase ? RtlUpcaseUnicodeChar(String->Buffer[i]) : String->Buffer[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static inline ULONG_PTR PhFindStringInStringRef(
+    PPH_STRINGREF String,
+    PPH_STRINGREF SubString,
+    BOOLEAN IgnoreCase
+    )
+{
+    SIZE_T length = String->Length / sizeof(WCHAR);
+    SIZE_T subLength = SubString->Length / sizeof(WCHAR);
+
+    for (SIZE_T i = 0; i + subLength <= length; i++)
+    {
+        SIZE_T j;
+
+        for (j = 0; j < subLength; j++)
+        {
+            WCHAR c1 = String->Buffer[i + j];
+            WCHAR c2 = SubString->Buffer[j];
+
+            if (IgnoreCase ? RtlUpcaseUnicodeChar(c1) != RtlUpcaseUnicodeChar(c2) : c1 != c2)
+                break;
+        }
+
+        if (j == subLength)
+            return i;
+    }
+
+    return (ULONG_PTR)-1;
+}
+
+static inline BOOLEAN PhEndsWithStringRef2(
+    PPH_STRINGREF String,
+    PWSTR Suffix,
+    BOOLEAN IgnoreCase
+    )
+{
+    PH_STRINGREF suffix;
+    PH_STRINGREF end;
+
+    suffix.Buffer = Suffix;
+    suffix.Length = 0;
+
+    while (Suffix[suffix.Length / sizeof(WCHAR)])
+        suffix.Length += sizeof(WCHAR);
+
+    if (String->Length < suffix.Length)
+        return FALSE;
+
+    end.Buffer = String->Buffer + (String->Length - suffix.Length) / sizeof(WCHAR);
+    end.Length = suffix.Length;
+
+    return PhEqualStringRef(&end, &suffix, IgnoreCase);
+}
+
+// String builders. The string is reallocated as it grows, as with phlib.
+
+typedef struct _PH_STRING_BUILDER
+{
+    SIZE_T AllocatedLength;
+    PPH_STRING String;
+} PH_STRING_BUILDER, *PPH_STRING_BUILDER;
+
+static inline void PhInitializeStringBuilder(
+    PPH_STRING_BUILDER StringBuilder,
+    SIZE_T InitialCapacity
+    )
+{
+    StringBuilder->AllocatedLength = max(InitialCapacity, sizeof(WCHAR));
+    StringBuilder->String = PhCreateStringEx(NULL, StringBuilder->AllocatedLength);
+    StringBuilder->String->Length = 0;
+    StringBuilder->String->Buffer[0] = 0;
+}
+
+static inline void PhAppendStringBuilderEx(
+    PPH_STRING_BUILDER StringBuilder,
+    PWCHAR String,
+    SIZE_T Length
+    )
+{
+    PPH_STRING string = StringBuilder->String;
+
+    if (string->Length + Length > StringBuilder->AllocatedLength)
+    {
+        PPH_STRING newString;
+
+        StringBuilder->AllocatedLength = max(StringBuilder->AllocatedLength * 2, string->Length + Length);
+        newString = PhCreateStringEx(NULL, StringBuilder->AllocatedLength);
+        memcpy(newString->Buffer, string->Buffer, string->Length);
+        newString->Length = string->Length;
+        PhDereferenceObject(string);
+        StringBuilder->String = string = newString;
+    }
+
+    memcpy((char *)string->Buffer + string->Length, String, Length);
+    string->Length += Length;
+    string->Buffer[string->Length / sizeof(WCHAR)] = 0;
+}
+
+static inline void PhAppendStringBuilder2(
+    PPH_STRING_BUILDER StringBuilder,
+    PWSTR String
+    )
+{
+    SIZE_T length = 0;
+
+    while (String[length])
+        length++;
+
+    PhAppendStringBuilderEx(StringBuilder, String, length * sizeof(WCHAR));
+}
+
+static inline void PhRemoveEndStringBuilder(
+    PPH_STRING_BUILDER StringBuilder,
+    SIZE_T Count
+    )
+{
+    StringBuilder->String->Length -= Count * sizeof(WCHAR);
+    StringBuilder->String->Buffer[StringBuilder->String->Length / sizeof(WCHAR)] = 0;
+}
+
+static inline PPH_STRING PhFinalStringBuilderString(
+    PPH_STRING_BUILDER StringBuilder
+    )
+{
+    return StringBuilder->String;
+}
+
+// Lists.
+
+typedef struct _PH_LIST
+{
+    ULONG Count;
+    ULONG AllocatedCount;
+    PVOID *Items;
+} PH_LIST, *PPH_LIST;
+
+static inline void PhShimDeleteList(
+    PVOID Object
+    )
+{
+    PhFree(((PPH_LIST)Object)->Items);
+}
+
+static inline PPH_LIST PhCreateList(
+    ULONG InitialCapacity
+    )
+{
+    PPH_LIST list = PhShimCreateObject(sizeof(PH_LIST), PhShimDeleteList);
+
+    list->Count = 0;
+    list->AllocatedCount = max(InitialCapacity, 1);
+    list->Items = PhAllocate(list->AllocatedCount * sizeof(PVOID));
+
+    return list;
+}
+
+static inline void PhAddItemList(
+    PPH_LIST List,
+    PVOID Item
+    )
+{
+    if (List->Count == List->AllocatedCount)
+    {
+        List->AllocatedCount *= 2;
+        List->Items = PhReAllocate(List->Items, List->AllocatedCount * sizeof(PVOID));
+    }
+
+    List->Items[List->Count++] = Item;
+}
+
+// Hashtables. Entries are stored by value, and pointers to them are only valid until
+// the next add, as with phlib.
+
+typedef BOOLEAN (*PPH_HASHTABLE_EQUAL_FUNCTION)(PVOID Entry1, PVOID Entry2);
+typedef ULONG (*PPH_HASHTABLE_HASH_FUNCTION)(PVOID Entry);
+
+typedef struct _PH_HASHTABLE
+{
+    ULONG EntrySize;
+    PPH_HASHTABLE_EQUAL_FUNCTION EqualFunction;
+    PPH_HASHTABLE_HASH_FUNCTION HashFunction;
+    ULONG BucketCount; // power of two
+    PULONG Buckets; // entry index, or ULONG_MAX
+    char *Entries; // ULONG next, ULONG hash (ULONG_MAX when free), then the entry
+    ULONG Count;
+    ULONG NextEntry;
+    ULONG AllocatedEntries;
+    ULONG FreeEntry;
+} PH_HASHTABLE, *PPH_HASHTABLE;
+
+typedef struct _PH_HASHTABLE_ENUM_CONTEXT
+{
+    PPH_HASHTABLE Hashtable;
+    ULONG Index;
+} PH_HASHTABLE_ENUM_CONTEXT, *PPH_HASHTABLE_ENUM_CONTEXT;
+
+#define PH_SHIM_HASHTABLE_ENTRY_SIZE(Hashtable) (2 * sizeof(ULONG) + (((Hashtable)->EntrySize + 7) & ~7u))
+#define PH_SHIM_HASHTABLE_ENTRY(Hashtable, Index) ((PULONG)((Hashtable)->Entries + (SIZE_T)(Index) * PH_SHIM_HASHTABLE_ENTRY_SIZE(Hashtable)))
+
+static inline void PhShimDeleteHashtable(
+    PVOID Object
+    )
+{
+    PhFree(((PPH_HASHTABLE)Object)->Buckets);
+    PhFree(((PPH_HASHTABLE)Object)->Entries);
+}
+
+static inline PPH_HASHTABLE PhCreateHashtable(
+    ULONG EntrySize,
+    PPH_HASHTABLE_EQUAL_FUNCTION EqualFunction,
+    PPH_HASHTABLE_HASH_FUNCTION HashFunction,
+    ULONG InitialCapacity
+    )
+{
+    PPH_HASHTABLE hashtable = PhShimCreateObject(sizeof(PH_HASHTABLE), PhShimDeleteHashtable);
+
+    hashtable->EntrySize = EntrySize;
+    hashtable->EqualFunction = EqualFunction;
+    hashtable->HashFunction = HashFunction;
+    hashtable->BucketCount = 16;
+
+    while (hashtable->BucketCount < InitialCapacity)
+        hashtable->BucketCount *= 2;
+
+    hashtable->Buckets = PhAllocate(hashtable->BucketCount * sizeof(ULONG));
+    memset(hashtable->Buckets, 0xff, hashtable->BucketCount * sizeof(ULONG));
+    hashtable->AllocatedEntries = hashtable->BucketCount;
+    hashtable->Entries = PhAllocate(hashtable->AllocatedEntries * PH_SHIM_HASHTABLE_ENTRY_SIZE(hashtable));
+    hashtable->Count = 0;
+    hashtable->NextEntry = 0;
+    hashtable->FreeEntry = ULONG_MAX;
+
+    return hashtable;
+}
+
+static inline PVOID PhFindEntryHashtable(
+    PPH_HASHTABLE Hashtable,
+    PVOID Entry
+    )
+{
+    ULONG hash = Hashtable->HashFunction(Entry) & 0x7fffffff;
+
+    for (ULONG i = Hashtable->Buckets[hash & (Hashtable->BucketCount - 1)]; i != ULONG_MAX; i = PH_SHIM_HASHTABLE_ENTRY(Hashtable, i)[0])
+    {
+        PULONG entry = PH_SHIM_HASHTABLE_ENTRY(Hashtable, i);
+
+        if (entry[1] == hash && Hashtable->EqualFunction(entry + 2, Entry))
+            return entry + 2;
+    }
+
+    return NULL;
+}
+
+static inline void PhShimResizeHashtable(
+    PPH_HASHTABLE Hashtable
+    )
+{
+    Hashtable->BucketCount *= 2;
+    Hashtable->Buckets = PhReAllocate(Hashtable->Buckets, Hashtable->BucketCount * sizeof(ULONG));
+    memset(Hashtable->Buckets, 0xff, Hashtable->BucketCount * sizeof(ULONG));
+
+    for (ULONG i = 0; i < Hashtable->NextEntry; i++)
+    {
+        PULONG entry = PH_SHIM_HASHTABLE_ENTRY(Hashtable, i);
+        ULONG bucket;
+
+        if (entry[1] == ULONG_MAX)
+            continue;
+
+        bucket = entry[1] & (Hashtable->BucketCount - 1);
+        entry[0] = Hashtable->Buckets[bucket];
+        Hashtable->Buckets[bucket] = i;
+    }
+}
+
+static inline PVOID PhAddEntryHashtableEx(
+    PPH_HASHTABLE Hashtable,
+    PVOID Entry,
+    PBOOLEAN Added
+    )
+{
+    ULONG hash;
+    ULONG index;
+    PULONG entry;
+    PVOID existing;
+
+    existing = PhFindEntryHashtable(Hashtable, Entry);
+
+    if (existing)
+    {
+        if (Added)
+            *Added = FALSE;
+
+        return existing;
+    }
+
+    if (Hashtable->FreeEntry != ULONG_MAX)
+    {
+        index = Hashtable->FreeEntry;
+        Hashtable->FreeEntry = PH_SHIM_HASHTABLE_ENTRY(Hashtable, index)[0];
+    }
+    else
+    {
+        if (Hashtable->NextEntry == Hashtable->AllocatedEntries)
+        {
+            Hashtable->AllocatedEntries *= 2;
+            Hashtable->Entries = PhReAllocate(Hashtable->Entries, Hashtable->AllocatedEntries * PH_SHIM_HASHTABLE_ENTRY_SIZE(Hashtable));
+        }
+
+        index = Hashtable->NextEntry++;
+    }
+
+    hash = Hashtable->HashFunction(Entry) & 0x7fffffff;
+    entry = PH_SHIM_HASHTABLE_ENTRY(Hashtable, index);
+    entry[0] = Hashtable->Buckets[hash & (Hashtable->BucketCount - 1)];
+    entry[1] = hash;
+    memcpy(entry + 2, Entry, Hashtable->EntrySize);
+    Hashtable->Buckets[hash & (Hashtable->BucketCount - 1)] = index;
+    Hashtable->Count++;
+
+    if (Hashtable->Count > Hashtable->BucketCount)
+    {
+        PhShimResizeHashtable(Hashtable);
+        entry = PH_SHIM_HASHTABLE_ENTRY(Hashtable, index);
+    }
+
+    if (Added)
+        *Added = TRUE;
+
+    return entry + 2;
+}
+
+static inline PVOID PhAddEntryHashtable(
+    PPH_HASHTABLE Hashtable,
+    PVOID Entry
+    )
+{
+    BOOLEAN added;
+    PVOID entry = PhAddEntryHashtableEx(Hashtable, Entry, &added);
+
+    return added ? entry : NULL;
+}
+
+static inline BOOLEAN PhRemoveEntryHashtable(
+    PPH_HASHTABLE Hashtable,
+    PVOID Entry
+    )
+{
+    ULONG hash = Hashtable->HashFunction(Entry) & 0x7fffffff;
+    PULONG link = &Hashtable->Buckets[hash & (Hashtable->BucketCount - 1)];
+
+    while (*link != ULONG_MAX)
+    {
+        ULONG index = *link;
+        PULONG entry = PH_SHIM_HASHTABLE_ENTRY(Hashtable, index);
+
+        if (entry[1] == hash && Hashtable->EqualFunction(entry + 2, Entry))
+        {
+            *link = entry[0];
+            entry[0] = Hashtable->FreeEntry;
+            entry[1] = ULONG_MAX;
+            Hashtable->FreeEntry = index;
+            Hashtable->Count--;
+
+            return TRUE;
+        }
+
+        link = &entry[0];
+    }
+
+    return FALSE;
+}
+
+static inline void PhBeginEnumHashtable(
+    PPH_HASHTABLE Hashtable,
+    PPH_HASHTABLE_ENUM_CONTEXT Context
+    )
+{
+    Context->Hashtable = Hashtable;
+    Context->Index = 0;
+}
+
+static inline PVOID PhNextEnumHashtable(
+    PPH_HASHTABLE_ENUM_CONTEXT Context
+    )
+{
+    while (Context->Index < Context->Hashtable->NextEntry)
+    {
+        PULONG entry = PH_SHIM_HASHTABLE_ENTRY(Context->Hashtable, Context->Index++);
+
+        if (entry[1] != ULONG_MAX)
+            return entry + 2;
+    }
+
+    return NULL;
+}
+
+#endif